@@ -21,12 +21,11 @@ using namespace std::chrono;
 static const std::string key(KEYLENGTH, 'a');
 static const std::string value(VALUELENGTH, 'a');
 
-void BenchSet() {
+void BenchSet(const BlackwidowOptions& bw_options,
+              const std::string& db_path) {
   printf("====== Set ======\n");
-  blackwidow::Options options;
-  options.create_if_missing = true;
   blackwidow::BlackWidow db;
-  blackwidow::Status s = db.Open(options, "./db");
+  blackwidow::Status s = db.Open(bw_options, db_path);
 
   if (!s.ok()) {
     printf("Open db failed, error: %s\n", s.ToString().c_str());
@@ -75,12 +74,11 @@ void BenchSet() {
     << cost << "s QPS: " << (THREADNUM * kv_num) / cost << std::endl;
 }
 
-void BenchHGetall() {
+void BenchHGetall(const BlackwidowOptions& bw_options,
+                  const std::string& db_path) {
   printf("====== HGetall ======\n");
-  blackwidow::Options options;
-  options.create_if_missing = true;
   blackwidow::BlackWidow db;
-  blackwidow::Status s = db.Open(options, "./db");
+  blackwidow::Status s = db.Open(bw_options, db_path);
 
   if (!s.ok()) {
     printf("Open db failed, error: %s\n", s.ToString().c_str());
@@ -88,10 +86,10 @@ void BenchHGetall() {
   }
 
   int32_t ret = 0;
-  BlackWidow::FieldValue fv;
+  FieldValue fv;
   std::vector<std::string> fields;
-  std::vector<BlackWidow::FieldValue> fvs_in;
-  std::vector<BlackWidow::FieldValue> fvs_out;
+  std::vector<FieldValue> fvs_in;
+  std::vector<FieldValue> fvs_out;
 
   // 1. Create the hash table then insert hash table 10000 field
   // 2. HGetall the hash table 10000 field (statistics cost time)
@@ -124,8 +122,8 @@ void BenchHGetall() {
     fvs_in.push_back(fv);
   }
   db.HMSet("HGETALL_KEY2", fvs_in);
-  std::vector<Slice> del_keys({"HGETALL_KEY2"});
-  std::map<BlackWidow::DataType, Status> type_status;
+  std::vector<std::string> del_keys({"HGETALL_KEY2"});
+  std::map<DataType, Status> type_status;
   db.Del(del_keys, &type_status);
   fvs_in.clear();
   for (size_t i = 0; i < 10000; ++i) {
@@ -170,12 +168,11 @@ void BenchHGetall() {
     << " Field HashTable Cost: "<< cost << "ms" << std::endl;
 }
 
-void BenchScan() {
+void BenchScan(const BlackwidowOptions& bw_options,
+               const std::string& db_path) {
   printf("====== Scan ======\n");
-  blackwidow::Options options;
-  options.create_if_missing = true;
   blackwidow::BlackWidow db;
-  blackwidow::Status s = db.Open(options, "./db");
+  blackwidow::Status s = db.Open(bw_options, db_path);
 
   if (!s.ok()) {
     printf("Open db failed, error: %s\n", s.ToString().c_str());
@@ -207,7 +204,7 @@ void BenchScan() {
   // Scan 100000
   std::vector<std::string> keys;
   start = system_clock::now();
-  db.Scan(0, "*", 100000, &keys);
+  db.Scan(DataType::kStrings, 0, "*", 100000, &keys);
   end = system_clock::now();
   elapsed_seconds = end - start;
   cost = duration_cast<seconds>(elapsed_seconds).count();
@@ -217,7 +214,7 @@ void BenchScan() {
   // Scan 10000000
   keys.clear();
   start = system_clock::now();
-  db.Scan(0, "*", kv_num, &keys);
+  db.Scan(DataType::kStrings, 0, "*", kv_num, &keys);
   end = system_clock::now();
   elapsed_seconds = end - start;
   cost = duration_cast<seconds>(elapsed_seconds).count();
@@ -226,13 +223,28 @@ void BenchScan() {
 }
 
 
-int main(int argc, char** argv) {
+void RunBenchmarks(const BlackwidowOptions& bw_options,
+                   const std::string& db_path) {
   // keys
-  BenchSet();
+  BenchSet(bw_options, db_path);
 
   // hashes
-  BenchHGetall();
+  BenchHGetall(bw_options, db_path);
 
   // Iterator
-  BenchScan();
+  BenchScan(bw_options, db_path);
+}
+
+int main(int argc, char** argv) {
+  // Run the same cases against both storage backends so the
+  // numbers can be compared side by side
+  BlackwidowOptions rocksdb_options;
+  rocksdb_options.options.create_if_missing = true;
+  printf("############ RocksDB Backend ############\n");
+  RunBenchmarks(rocksdb_options, "./db");
+
+  BlackwidowOptions memory_options;
+  memory_options.storage_backend = kMemoryBackend;
+  printf("############ Memory Backend ############\n");
+  RunBenchmarks(memory_options, "./memory_db");
 }
@@ -0,0 +1,229 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+// Measure the compression ratio and the decompression cpu of a column family
+// of a live blackwidow dataset under several compression settings, to pick
+// ColumnFamilyProfile::compression_dict_bytes.
+//
+// The data is sampled from a read-only instance, written into sst files with
+// each setting, and read back with the block cache disabled so that every
+// block is decompressed again.
+//
+// Usage: compression_bench <db_path> <hashes|sets|strings|zsets>
+//                          [sample_entries] [dict_bytes]
+
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "rocksdb/db.h"
+#include "rocksdb/env.h"
+#include "rocksdb/options.h"
+#include "rocksdb/table.h"
+#include "rocksdb/sst_file_reader.h"
+#include "rocksdb/sst_file_writer.h"
+
+const size_t DEFAULT_SAMPLE_ENTRIES = 1000000;
+const uint32_t DEFAULT_DICT_BYTES = 16 * 1024;
+const int READ_ROUNDS = 5;
+
+struct Setting {
+  std::string name;
+  rocksdb::CompressionType compression;
+  uint32_t dict_bytes;
+  uint32_t train_bytes;
+};
+
+struct KeyValue {
+  std::string key;
+  std::string value;
+};
+
+// Only the column families with the default bytewise comparator,
+// the sst files written here use it
+static std::string ColumnFamilyName(const std::string& type) {
+  if (type == "hashes" || type == "zsets") {
+    return "data_cf";
+  } else if (type == "sets") {
+    return "member_cf";
+  } else if (type == "strings") {
+    return rocksdb::kDefaultColumnFamilyName;
+  }
+  return std::string();
+}
+
+static rocksdb::Status Sample(const std::string& path,
+                              const std::string& cf_name,
+                              size_t sample_entries,
+                              std::vector<KeyValue>* kvs,
+                              uint64_t* total_entries) {
+  rocksdb::DB* db;
+  std::vector<rocksdb::ColumnFamilyHandle*> handles;
+  std::vector<rocksdb::ColumnFamilyDescriptor> column_families;
+  column_families.push_back(rocksdb::ColumnFamilyDescriptor(
+      rocksdb::kDefaultColumnFamilyName, rocksdb::ColumnFamilyOptions()));
+  if (cf_name != rocksdb::kDefaultColumnFamilyName) {
+    column_families.push_back(rocksdb::ColumnFamilyDescriptor(
+        cf_name, rocksdb::ColumnFamilyOptions()));
+  }
+  rocksdb::DBOptions db_ops;
+  db_ops.max_open_files = -1;
+  rocksdb::Status s = rocksdb::DB::OpenForReadOnly(db_ops, path,
+      column_families, &handles, &db);
+  if (!s.ok()) {
+    return s;
+  }
+
+  // Spread the samples over the whole key space
+  uint64_t num_keys = 0;
+  db->GetIntProperty(handles.back(), "rocksdb.estimate-num-keys", &num_keys);
+  uint64_t stride = num_keys / sample_entries + 1;
+
+  rocksdb::ReadOptions read_options;
+  read_options.fill_cache = false;
+  rocksdb::Iterator* iter = db->NewIterator(read_options, handles.back());
+  uint64_t count = 0;
+  for (iter->SeekToFirst();
+       iter->Valid() && kvs->size() < sample_entries;
+       iter->Next(), count++) {
+    if (count % stride == 0) {
+      kvs->push_back({iter->key().ToString(), iter->value().ToString()});
+    }
+  }
+  s = iter->status();
+  delete iter;
+  *total_entries = num_keys;
+
+  for (auto handle : handles) {
+    delete handle;
+  }
+  delete db;
+  return s;
+}
+
+static void Measure(const Setting& setting,
+                    const std::vector<KeyValue>& kvs,
+                    const std::string& file_path) {
+  rocksdb::Options options;
+  rocksdb::BlockBasedTableOptions table_options;
+  table_options.no_block_cache = true;
+  options.table_factory.reset(
+      rocksdb::NewBlockBasedTableFactory(table_options));
+  options.compression = setting.compression;
+  options.bottommost_compression = setting.compression;
+  options.compression_opts.max_dict_bytes = setting.dict_bytes;
+  options.compression_opts.zstd_max_train_bytes = setting.train_bytes;
+  options.bottommost_compression_opts = options.compression_opts;
+  options.bottommost_compression_opts.enabled = true;
+
+  uint64_t raw_size = 0;
+  rocksdb::SstFileWriter writer(rocksdb::EnvOptions(), options);
+  rocksdb::Status s = writer.Open(file_path);
+  std::clock_t start = std::clock();
+  for (const auto& kv : kvs) {
+    if (s.ok()) {
+      s = writer.Put(kv.key, kv.value);
+      raw_size += kv.key.size() + kv.value.size();
+    }
+  }
+  rocksdb::ExternalSstFileInfo file_info;
+  if (s.ok()) {
+    s = writer.Finish(&file_info);
+  }
+  double write_cpu = static_cast<double>(std::clock() - start)
+    / CLOCKS_PER_SEC;
+  if (!s.ok()) {
+    printf("%-24s %s\n", setting.name.c_str(), s.ToString().c_str());
+    return;
+  }
+
+  rocksdb::SstFileReader reader(options);
+  s = reader.Open(file_path);
+  if (!s.ok()) {
+    printf("%-24s %s\n", setting.name.c_str(), s.ToString().c_str());
+    return;
+  }
+  rocksdb::ReadOptions read_options;
+  read_options.fill_cache = false;
+  read_options.verify_checksums = false;
+  start = std::clock();
+  for (int i = 0; i < READ_ROUNDS; i++) {
+    rocksdb::Iterator* iter = reader.NewIterator(read_options);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    }
+    delete iter;
+  }
+  double read_cpu = static_cast<double>(std::clock() - start)
+    / CLOCKS_PER_SEC;
+
+  printf("%-24s %12lu %8.2fx %10.1f %14.1f\n", setting.name.c_str(),
+         file_info.file_size,
+         static_cast<double>(raw_size) / file_info.file_size,
+         write_cpu * 1e9 / raw_size,
+         read_cpu * 1e9 / (raw_size * READ_ROUNDS));
+  rocksdb::Env::Default()->DeleteFile(file_path);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    printf("Usage: %s <db_path> <hashes|sets|strings|zsets>"
+           " [sample_entries] [dict_bytes]\n", argv[0]);
+    return -1;
+  }
+  std::string db_path(argv[1]);
+  std::string type(argv[2]);
+  size_t sample_entries = argc > 3 ? strtoull(argv[3], NULL, 10)
+    : DEFAULT_SAMPLE_ENTRIES;
+  uint32_t dict_bytes = argc > 4 ? strtoul(argv[4], NULL, 10)
+    : DEFAULT_DICT_BYTES;
+
+  std::string cf_name = ColumnFamilyName(type);
+  if (cf_name.empty()) {
+    printf("Unsupported type: %s\n", type.c_str());
+    return -1;
+  }
+
+  std::vector<KeyValue> kvs;
+  uint64_t total_entries = 0;
+  rocksdb::Status s = Sample(db_path + "/" + type, cf_name,
+                             sample_entries, &kvs, &total_entries);
+  if (!s.ok()) {
+    printf("Sample failed, error: %s\n", s.ToString().c_str());
+    return -1;
+  }
+  uint64_t raw_size = 0;
+  for (const auto& kv : kvs) {
+    raw_size += kv.key.size() + kv.value.size();
+  }
+  printf("%s %s: sampled %lu of ~%lu entries, %lu bytes,"
+         " %.1f bytes per entry\n", type.c_str(), cf_name.c_str(),
+         kvs.size(), total_entries, raw_size,
+         kvs.empty() ? 0.0 : static_cast<double>(raw_size) / kvs.size());
+  if (kvs.empty()) {
+    return 0;
+  }
+
+  std::vector<Setting> settings = {
+    {"none", rocksdb::kNoCompression, 0, 0},
+    {"snappy", rocksdb::kSnappyCompression, 0, 0},
+    {"lz4", rocksdb::kLZ4Compression, 0, 0},
+    {"zstd", rocksdb::kZSTD, 0, 0},
+    {"zstd+raw dict " + std::to_string(dict_bytes),
+      rocksdb::kZSTD, dict_bytes, 0},
+    {"zstd+trained dict " + std::to_string(dict_bytes),
+      rocksdb::kZSTD, dict_bytes, dict_bytes * 100}
+  };
+
+  printf("%-24s %12s %9s %10s %14s\n", "setting", "file bytes", "ratio",
+         "write ns/B", "read ns/B");
+  std::string file_path = "./compression_bench.sst";
+  for (const auto& setting : settings) {
+    Measure(setting, kvs, file_path);
+  }
+  return 0;
+}
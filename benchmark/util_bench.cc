@@ -0,0 +1,169 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+
+#include "blackwidow/util.h"
+
+const int ROUNDS = 10;
+
+using namespace blackwidow;
+using namespace std::chrono;
+
+// The implementations before the fast paths
+static int LegacyStrToLongDouble(const char* s, size_t slen,
+                                 long double* ldval) {
+  char *pEnd;
+  std::string t(s, slen);
+  if (t.find(" ") != std::string::npos) {
+    return -1;
+  }
+  long double d = strtold(s, &pEnd);
+  if (pEnd != s + slen)
+    return -1;
+  if (ldval != NULL) *ldval = d;
+  return 0;
+}
+
+static int LegacyLongDoubleToStr(long double ldval, std::string* value) {
+  char buf[256];
+  int len;
+  if (std::isnan(ldval) || std::isinf(ldval)) {
+    return -1;
+  }
+  len = snprintf(buf, sizeof(buf), "%.17Lf", ldval);
+  if (strchr(buf, '.') != NULL) {
+    char *p = buf+len-1;
+    while (*p == '0') {
+      p--;
+      len--;
+    }
+    if (*p == '.') len--;
+  }
+  value->assign(buf, len);
+  return 0;
+}
+
+static void Report(const std::string& name, size_t num,
+                   const system_clock::time_point& start) {
+  auto cost = duration_cast<nanoseconds>(system_clock::now() - start).count();
+  std::cout << name << ": " << num << " ops, "
+    << static_cast<double>(cost) / num << " ns/op" << std::endl;
+}
+
+void BenchParse(const std::vector<std::string>& strs) {
+  printf("====== Parse ======\n");
+  long double ldval, ldsum = 0;
+  double dval, dsum = 0;
+
+  auto start = system_clock::now();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (const auto& str : strs) {
+      LegacyStrToLongDouble(str.data(), str.size(), &ldval);
+      ldsum += ldval;
+    }
+  }
+  Report("Legacy StrToLongDouble", ROUNDS * strs.size(), start);
+
+  start = system_clock::now();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (const auto& str : strs) {
+      StrToLongDouble(str.data(), str.size(), &ldval);
+      ldsum += ldval;
+    }
+  }
+  Report("StrToLongDouble", ROUNDS * strs.size(), start);
+
+  start = system_clock::now();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (const auto& str : strs) {
+      dval = strtod(str.c_str(), NULL);
+      dsum += dval;
+    }
+  }
+  Report("strtod", ROUNDS * strs.size(), start);
+
+  start = system_clock::now();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (const auto& str : strs) {
+      StrToDouble(str.data(), str.size(), &dval);
+      dsum += dval;
+    }
+  }
+  Report("StrToDouble", ROUNDS * strs.size(), start);
+  std::cout << "(checksum " << static_cast<double>(ldsum) + dsum << ")"
+    << std::endl;
+}
+
+void BenchFormat(const std::string& name,
+                 const std::vector<long double>& values) {
+  printf("====== Format %s ======\n", name.c_str());
+  std::string str;
+  size_t total_len = 0;
+  char buf[64];
+
+  auto start = system_clock::now();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (const auto& value : values) {
+      LegacyLongDoubleToStr(value, &str);
+      total_len += str.size();
+    }
+  }
+  Report("Legacy LongDoubleToStr", ROUNDS * values.size(), start);
+
+  start = system_clock::now();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (const auto& value : values) {
+      LongDoubleToStr(value, &str);
+      total_len += str.size();
+    }
+  }
+  Report("LongDoubleToStr", ROUNDS * values.size(), start);
+
+  start = system_clock::now();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (const auto& value : values) {
+      total_len += snprintf(buf, sizeof(buf), "%.17g",
+                            static_cast<double>(value));
+    }
+  }
+  Report("snprintf %.17g", ROUNDS * values.size(), start);
+
+  start = system_clock::now();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (const auto& value : values) {
+      total_len += DoubleToStr(buf, sizeof(buf), static_cast<double>(value));
+    }
+  }
+  Report("DoubleToStr", ROUNDS * values.size(), start);
+  std::cout << "(checksum " << total_len << ")" << std::endl;
+}
+
+int main(int argc, char** argv) {
+  std::mt19937_64 rng(2017);
+  std::vector<std::string> strs;
+  std::vector<long double> counters, scores;
+  for (int i = 0; i < 1000000; i++) {
+    // Typical INCRBYFLOAT arguments and zset scores
+    int64_t integral = rng() % 100000;
+    int64_t fraction = rng() % 1000;
+    strs.push_back(std::to_string(integral) + "." + std::to_string(fraction));
+    counters.push_back(static_cast<long double>(integral) + 0.5L);
+    long double score;
+    StrToLongDouble(strs.back().data(), strs.back().size(), &score);
+    scores.push_back(score);
+  }
+
+  BenchParse(strs);
+  BenchFormat("Counters", counters);
+  BenchFormat("Scores", scores);
+  return 0;
+}
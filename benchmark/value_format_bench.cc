@@ -0,0 +1,279 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+
+#include "blackwidow/blackwidow.h"
+#include "src/base_meta_value_format.h"
+
+const int ROUNDS = 10;
+
+using namespace blackwidow;
+using namespace std::chrono;
+
+// The meta value codecs before the templates, virtual and decoding every
+// field in the constructor
+class LegacyInternalValue {
+ public:
+  explicit LegacyInternalValue(const Slice& user_value) :
+    start_(nullptr),
+    user_value_(user_value),
+    version_(0),
+    timestamp_(0) {
+  }
+  virtual ~LegacyInternalValue() {
+    if (start_ != space_) {
+      delete[] start_;
+    }
+  }
+  void set_timestamp(int32_t timestamp = 0) {
+    timestamp_ = timestamp;
+  }
+  void set_version(int32_t version = 0) {
+    version_ = version;
+  }
+  static const size_t kDefaultValueSuffixLength = sizeof(int32_t) * 2;
+  virtual const Slice Encode() {
+    size_t usize = user_value_.size();
+    size_t needed = usize + kDefaultValueSuffixLength;
+    char* dst;
+    if (needed <= sizeof(space_)) {
+      dst = space_;
+    } else {
+      dst = new char[needed];
+      if (start_ != space_) {
+        delete[] start_;
+      }
+    }
+    start_ = dst;
+    size_t len = AppendTimestampAndVersion();
+    return Slice(start_, len);
+  }
+  virtual size_t AppendTimestampAndVersion() = 0;
+
+ protected:
+  char space_[200];
+  char* start_;
+  Slice user_value_;
+  int32_t version_;
+  int32_t timestamp_;
+};
+
+class LegacyBaseMetaValue : public LegacyInternalValue {
+ public:
+  explicit LegacyBaseMetaValue(const Slice& user_value) :
+    LegacyInternalValue(user_value) {
+  }
+  size_t AppendTimestampAndVersion() override {
+    size_t usize = user_value_.size();
+    char* dst = start_;
+    memcpy(dst, user_value_.data(), usize);
+    dst += usize;
+    EncodeFixed32(dst, version_);
+    dst += sizeof(int32_t);
+    EncodeFixed32(dst, timestamp_);
+    return usize + 2 * sizeof(int32_t);
+  }
+};
+
+class LegacyParsedBaseMetaValue {
+ public:
+  explicit LegacyParsedBaseMetaValue(const Slice& value) :
+    version_(0),
+    timestamp_(0),
+    count_(0),
+    capped_(false),
+    cap_(0),
+    has_origin_(false),
+    last_own_version_(0) {
+    if (value.size() >= kBaseMetaValueSuffixLength) {
+      user_value_ = Slice(value.data(),
+          value.size() - kBaseMetaValueSuffixLength);
+      version_ = DecodeFixed32(value.data() +
+            value.size() - sizeof(int32_t) * 2);
+      timestamp_ = DecodeFixed32(value.data() +
+            value.size() - sizeof(int32_t));
+    }
+    DecodeCount(value.data());
+    DecodeOrigin();
+  }
+  virtual ~LegacyParsedBaseMetaValue() = default;
+
+  static const size_t kBaseMetaValueSuffixLength = 2 * sizeof(int32_t);
+  static const uint32_t kCappedFlag = 0x80000000;
+
+  int32_t version() {
+    return version_;
+  }
+
+  int32_t count() {
+    return count_;
+  }
+
+  bool IsStale() {
+    if (timestamp_ == 0) {
+      return false;
+    }
+    int64_t unix_time;
+    rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+    return timestamp_ < unix_time;
+  }
+
+  virtual void StripSuffix() {
+  }
+
+ private:
+  void DecodeCount(const char* ptr) {
+    uint32_t count = DecodeFixed32(ptr);
+    capped_ = (count & kCappedFlag) != 0;
+    count_ = count & ~kCappedFlag;
+    cap_ = capped_ ? DecodeFixed32(ptr + sizeof(int32_t)) : 0;
+  }
+
+  void DecodeOrigin() {
+    size_t offset = capped_ ? sizeof(int32_t) * 2 : sizeof(int32_t);
+    has_origin_ = user_value_.size() >= offset + sizeof(int32_t) * 2;
+    if (has_origin_) {
+      const char* end = user_value_.data() + user_value_.size();
+      last_own_version_ = DecodeFixed32(end - sizeof(int32_t));
+      uint32_t origin_len = DecodeFixed32(end - sizeof(int32_t) * 2);
+      origin_ = Slice(end - sizeof(int32_t) * 2 - origin_len, origin_len);
+    }
+  }
+
+  Slice user_value_;
+  int32_t version_;
+  int32_t timestamp_;
+  int32_t count_;
+  bool capped_;
+  int32_t cap_;
+  bool has_origin_;
+  Slice origin_;
+  int32_t last_own_version_;
+};
+
+static void Report(const std::string& name, size_t num,
+                   const system_clock::time_point& start) {
+  auto cost = duration_cast<nanoseconds>(system_clock::now() - start).count();
+  std::cout << name << ": " << num << " ops, "
+    << static_cast<double>(cost) / num << " ns/op" << std::endl;
+}
+
+// What the compaction filters of the meta column families ask for
+void BenchFilter(const std::vector<std::string>& metas) {
+  printf("====== Filter ======\n");
+  size_t stale = 0;
+
+  auto start = system_clock::now();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (const auto& meta : metas) {
+      LegacyParsedBaseMetaValue parsed_meta_value(meta);
+      stale += parsed_meta_value.IsStale();
+    }
+  }
+  Report("Legacy IsStale", ROUNDS * metas.size(), start);
+
+  start = system_clock::now();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (const auto& meta : metas) {
+      ParsedBaseMetaValue parsed_meta_value((Slice(meta)));
+      stale += parsed_meta_value.IsStale();
+    }
+  }
+  Report("IsStale", ROUNDS * metas.size(), start);
+  std::cout << "(checksum " << stale << ")" << std::endl;
+}
+
+// What the read commands ask for
+void BenchRead(const std::vector<std::string>& metas) {
+  printf("====== Read ======\n");
+  int64_t sum = 0;
+
+  auto start = system_clock::now();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (const auto& meta : metas) {
+      LegacyParsedBaseMetaValue parsed_meta_value(meta);
+      if (!parsed_meta_value.IsStale()) {
+        sum += parsed_meta_value.count() + parsed_meta_value.version();
+      }
+    }
+  }
+  Report("Legacy count & version", ROUNDS * metas.size(), start);
+
+  start = system_clock::now();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (const auto& meta : metas) {
+      ParsedBaseMetaValue parsed_meta_value((Slice(meta)));
+      if (!parsed_meta_value.IsStale()) {
+        sum += parsed_meta_value.count() + parsed_meta_value.version();
+      }
+    }
+  }
+  Report("count & version", ROUNDS * metas.size(), start);
+  std::cout << "(checksum " << sum << ")" << std::endl;
+}
+
+void BenchEncode(size_t num) {
+  printf("====== Encode ======\n");
+  size_t total_len = 0;
+  char buf[sizeof(int32_t)];
+
+  auto start = system_clock::now();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (size_t i = 0; i < num; i++) {
+      EncodeFixed32(buf, static_cast<uint32_t>(i));
+      LegacyBaseMetaValue meta_value(Slice(buf, sizeof(buf)));
+      meta_value.set_version(static_cast<int32_t>(i));
+      Slice encoded = meta_value.Encode();
+      total_len += encoded.size() + encoded.data()[sizeof(buf)];
+    }
+  }
+  Report("Legacy Encode", ROUNDS * num, start);
+
+  start = system_clock::now();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (size_t i = 0; i < num; i++) {
+      EncodeFixed32(buf, static_cast<uint32_t>(i));
+      BaseMetaValue meta_value(Slice(buf, sizeof(buf)));
+      meta_value.set_version(static_cast<int32_t>(i));
+      Slice encoded = meta_value.Encode();
+      total_len += encoded.size() + encoded.data()[sizeof(buf)];
+    }
+  }
+  Report("Encode", ROUNDS * num, start);
+  std::cout << "(checksum " << total_len << ")" << std::endl;
+}
+
+int main(int argc, char** argv) {
+  std::mt19937_64 rng(2017);
+  int64_t unix_time;
+  rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+  std::vector<std::string> metas;
+  for (int i = 0; i < 1000000; i++) {
+    // Mostly permanent collections, some with a ttl, a few renamed
+    char buf[sizeof(int32_t)];
+    EncodeFixed32(buf, rng() % 100000);
+    BaseMetaValue meta_value(Slice(buf, sizeof(buf)));
+    meta_value.UpdateVersion();
+    if (rng() % 10 == 0) {
+      meta_value.set_timestamp(static_cast<int32_t>(unix_time)
+          + static_cast<int32_t>(rng() % 7200) - 3600);
+    }
+    metas.push_back(meta_value.Encode().ToString());
+    if (rng() % 100 == 0) {
+      ParsedBaseMetaValue parsed_meta_value(&metas.back());
+      parsed_meta_value.SetOrigin("origin_key", parsed_meta_value.version());
+    }
+  }
+
+  BenchFilter(metas);
+  BenchRead(metas);
+  BenchEncode(metas.size());
+  return 0;
+}
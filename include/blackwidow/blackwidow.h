@@ -10,6 +10,7 @@
 #include <map>
 #include <list>
 #include <queue>
+#include <memory>
 #include <vector>
 #include <unistd.h>
 
@@ -37,6 +38,7 @@ const std::string HASHES_DB = "hashes";
 const std::string LISTS_DB = "lists";
 const std::string ZSETS_DB = "zsets";
 const std::string SETS_DB = "sets";
+const std::string STREAMS_DB = "streams";
 
 const size_t BATCH_DELETE_LIMIT = 100;
 const size_t COMPACT_THRESHOLD_COUNT = 2000;
@@ -47,16 +49,122 @@ using Status = rocksdb::Status;
 using Slice = rocksdb::Slice;
 
 class Mutex;
+class Redis;
 class RedisStrings;
 class RedisHashes;
 class RedisSets;
 class RedisLists;
 class RedisZSets;
+class RedisStreams;
 class HyperLogLog;
+class KeyDetector;
+class CounterBuffer;
+class AccessClock;
+class SlotTaggedKey;
 
 template <typename T1, typename T2>
 class LRUCache;
 
+enum OpenMode {
+  kOpenReadWrite = 0,
+  // Open every type db with DB::OpenForReadOnly, the view is fixed
+  // at the moment the instance is opened
+  kOpenReadOnly,
+  // Open every type db with DB::OpenAsSecondary, the view follows the
+  // primary instance by TryCatchUpWithPrimary
+  kOpenSecondary,
+  // Open every type db read-only for serving an immutable dataset, built
+  // offline by a read-write instance and finished by Compact(kAll, true).
+  // The table files are mmap'ed and kept opened with their index and
+  // filter blocks, the data block hash indexes of strings_profile and
+  // meta_profile answer the point lookups, no WAL is written and no
+  // compaction runs. SwapDataset switches to another dataset
+  kOpenServing
+};
+
+enum StorageBackend {
+  kRocksDBBackend = 0,
+  // Serve every type db from ordered in-memory maps, without WAL,
+  // memtables, table files or LSM compactions, for the cache tier where
+  // durability is irrelevant, nothing survives Close. The change stream
+  // and strings_ttl_cf are not available
+  kMemoryBackend
+};
+
+enum EvictionPolicy {
+  // Evict the keys accessed least recently
+  kEvictLRU = 0,
+  // Evict the keys accessed least frequently, recent accesses
+  // weigh more than old ones
+  kEvictLFU
+};
+
+enum WritePressure {
+  kWritePressureNormal = 0,
+  // Close to a stall, see write_pressure_ratio, the bulk writers
+  // should back off before the writes of every client are delayed
+  kWritePressureHigh,
+  // rocksdb delays the writes to let the flushes and compactions
+  // catch up
+  kWritePressureDelayed,
+  // rocksdb blocks the writes until the flushes or compactions
+  // bring a column family back below its stop triggers
+  kWritePressureStopped
+};
+
+// Tuning of one column family, applied on top of BlackwidowOptions::options
+// and BlackwidowOptions::table_options
+struct ColumnFamilyProfile {
+  // 0 keeps table_options.block_size
+  size_t block_size;
+  // 0 disables the filter, for the column families only served by scans
+  double filter_bits_per_key;
+  // Ribbon filter saves about 30% memory of bloom filter with
+  // the same false positive rate, at more cpu cost when building
+  bool use_ribbon_filter;
+  // Hash index inside the data blocks, speeds up point lookups
+  bool data_block_hash_index;
+  // Do not build filters for the last level, only for the column
+  // families where nearly every lookup hits
+  bool optimize_filters_for_hits;
+  // Empty keeps options.compression for all levels
+  std::vector<rocksdb::CompressionType> compression_per_level;
+  // Max size of the zstd dictionary built for every sst file from its own
+  // data blocks and stored inside the file, 0 disables it. Switches the
+  // column family to kZSTD, small values that look alike across keys
+  // (json fragments) compress several times better than block by block
+  uint32_t compression_dict_bytes;
+  // Bytes of sampled blocks the dictionary is trained from with zstd,
+  // about 100 times compression_dict_bytes, 0 uses the samples as the
+  // dictionary directly without training
+  uint32_t compression_dict_train_bytes;
+  // Whole key bloom filter of the memtable, as a ratio of
+  // write_buffer_size, 0 disables it
+  double memtable_bloom_size_ratio;
+  // Keep index and filter blocks in block cache and pin those of L0,
+  // ignored unless a block cache is configured
+  bool pin_l0_filter_and_index_blocks;
+  // Storage tiers of the column family, fastest first. The sst files fill
+  // up the target_size of one path before they go to the next, so the
+  // upper levels stay on the first tiers and the bottom levels land on
+  // the last one, works best with level_compaction_dynamic_level_bytes
+  // off. Every type db keeps its files in its own sub directory of a
+  // path, empty keeps the files in the db directory. The paths must be
+  // the same every time a database is opened
+  std::vector<rocksdb::DbPath> paths;
+
+  ColumnFamilyProfile()
+      : block_size(0),
+        filter_bits_per_key(10),
+        use_ribbon_filter(false),
+        data_block_hash_index(false),
+        optimize_filters_for_hits(false),
+        compression_dict_bytes(0),
+        compression_dict_train_bytes(0),
+        memtable_bloom_size_ratio(0),
+        pin_l0_filter_and_index_blocks(false) {}
+};
+
 struct BlackwidowOptions {
   rocksdb::Options options;
   rocksdb::BlockBasedTableOptions table_options;
@@ -65,11 +173,154 @@ struct BlackwidowOptions {
   size_t statistics_max_size;
   size_t small_compaction_threshold;
 
+  StorageBackend storage_backend;
+
+  // For read-only replicas, all write commands return NotSupported
+  // when open_mode is not kOpenReadWrite
+  OpenMode open_mode;
+  // Where the secondary instance keeps its own info log and MANIFEST
+  // copies, must be different from the primary db path
+  std::string secondary_path;
+  // The interval of catching up with the primary, 0 means the caller
+  // drives TryCatchUpWithPrimary by itself
+  uint32_t catch_up_interval_ms;
+  // Sample one of hot_key_sample_rate single key commands into the
+  // access frequency sketch, 0 disables the hot key detection
+  uint32_t hot_key_sample_rate;
+  // Hashes, sets, zsets and lists with more elements than
+  // big_key_threshold are reported as big keys, 0 disables
+  // the background big key sampler
+  uint64_t big_key_threshold;
+  // How many hot keys and big keys are kept for every data type
+  size_t key_detector_top_k;
+  // Every interval the access counters are halved and the big key
+  // sampler scans the next batch of meta keys
+  uint32_t key_detector_interval_ms;
+
+  // Buffer the increments of hot counters in memory and write them as
+  // one increment per counter every counter_flush_interval_ms, which is
+  // also how much of them a crash can lose. 0 disables the buffer
+  uint32_t counter_flush_interval_ms;
+  // Besides the keys given to BufferCounter, buffer the strings, hashes
+  // and zsets found hot by the hot key detection
+  bool buffer_hot_counters;
+
+  // Evict keys of any type once the live data of all the type dbs (sst
+  // files and memtables) grows beyond max_data_size bytes, to run as a
+  // self-managing cache. Bounds the disk with kRocksDBBackend and the
+  // memory with kMemoryBackend, 0 disables the eviction
+  uint64_t max_data_size;
+  EvictionPolicy eviction_policy;
+  // Keys sampled from every type db for each eviction, more samples
+  // get closer to the exact policy at more cpu cost
+  uint32_t eviction_samples;
+  // Slots of the access clock, 4 bytes each, keys sharing a slot
+  // share their recency and frequency
+  size_t access_clock_slots;
+  // How often the data size is checked against max_data_size
+  uint32_t eviction_interval_ms;
+
+  // The write pressure is high once the L0 files, the pending compaction
+  // bytes or the memtables of a column family reach this ratio of where
+  // rocksdb starts to delay the writes
+  double write_pressure_ratio;
+
+  // Route the strings with ttl into a dedicated column family with FIFO
+  // compaction, its table files are dropped as a whole once all their
+  // entries expired instead of being rewritten down the levels. The
+  // column family can not be turned off once it has been created.
+  // The files are dropped oldest first, so one entry with a long ttl
+  // keeps its file and every newer file of ttl_cf until it expires,
+  // mixing ttls of days with ttls of seconds wastes the space
+  bool strings_ttl_cf;
+
+  // A persistent cache of the blocks evicted from the block cache, kept
+  // in secondary_cache_path on a local ssd and shared by all the type
+  // dbs, empty disables it
+  std::string secondary_cache_path;
+  uint64_t secondary_cache_size;
+
+  // Dump refuses to serialize and Restore refuses to load a value
+  // larger than max_dump_size bytes
+  size_t max_dump_size;
+
+  // Store every key behind its redis cluster hash slot, so that the keys
+  // of one slot are a key range of each type db and can be listed,
+  // counted and deleted as such by the Slot Commands. Keys, Scan and
+  // the change records still return the plain keys, PKScanRange and
+  // PKRScanRange are not supported. The layout must be the same every
+  // time a database is opened
+  bool slot_tagged_keys;
+
+  // Logical databases sharing the type dbs, as the redis SELECT
+  // namespaces. With more than one every key is stored behind the id of
+  // its database, so that a database is a key range of each type db. The
+  // commands of a thread run in the database it selected by Select or
+  // by a DBContext, 0 until then. Keys, Scan and the change records return the plain keys,
+  // the hot keys and big keys add up the keys of the same name in all
+  // the databases, buffer_hot_counters only covers database 0. At most
+  // 16383, not supported with slot_tagged_keys (redis cluster only has
+  // database 0 either). Whether there is more than one database must be
+  // the same every time a database is opened
+  uint32_t databases;
+
+  // Per column family tuning, the defaults follow the access pattern:
+  // strings are point lookup heavy, the meta column families of all
+  // the collections are tiny and hot, the zsets score_cf is only
+  // range scanned, the lists data_cf is read by existing indexes and
+  // the streams data_cf is range scanned by id
+  ColumnFamilyProfile strings_profile;
+  ColumnFamilyProfile meta_profile;
+  ColumnFamilyProfile hashes_data_profile;
+  ColumnFamilyProfile sets_member_profile;
+  ColumnFamilyProfile lists_data_profile;
+  ColumnFamilyProfile zsets_data_profile;
+  ColumnFamilyProfile zsets_score_profile;
+  ColumnFamilyProfile streams_data_profile;
+
   explicit BlackwidowOptions()
       : block_cache_size(0),
         share_block_cache(false),
         statistics_max_size(0),
-        small_compaction_threshold(5000) {}
+        small_compaction_threshold(5000),
+        storage_backend(kRocksDBBackend),
+        open_mode(kOpenReadWrite),
+        catch_up_interval_ms(1000),
+        hot_key_sample_rate(0),
+        big_key_threshold(0),
+        key_detector_top_k(16),
+        key_detector_interval_ms(10000),
+        counter_flush_interval_ms(0),
+        buffer_hot_counters(false),
+        max_data_size(0),
+        eviction_policy(kEvictLRU),
+        eviction_samples(5),
+        access_clock_slots(1 << 20),
+        eviction_interval_ms(1000),
+        write_pressure_ratio(0.8),
+        strings_ttl_cf(false),
+        secondary_cache_size(0),
+        max_dump_size(512 << 20),
+        slot_tagged_keys(false),
+        databases(1) {
+    strings_profile.data_block_hash_index = true;
+    strings_profile.memtable_bloom_size_ratio = 0.02;
+
+    meta_profile.data_block_hash_index = true;
+    meta_profile.memtable_bloom_size_ratio = 0.02;
+    meta_profile.pin_l0_filter_and_index_blocks = true;
+
+    hashes_data_profile.data_block_hash_index = true;
+    sets_member_profile.data_block_hash_index = true;
+    zsets_data_profile.data_block_hash_index = true;
+
+    lists_data_profile.optimize_filters_for_hits = true;
+
+    zsets_score_profile.block_size = 16 * 1024;
+    zsets_score_profile.filter_bits_per_key = 0;
+
+    streams_data_profile.block_size = 16 * 1024;
+  }
 };
 
 struct KeyValue {
@@ -90,6 +341,69 @@ struct KeyInfo {
   uint64_t invaild_keys;
 };
 
+struct KeyCount {
+  std::string key;
+  // estimated accesses of a hot key, or element count of a big key
+  uint64_t count;
+};
+
+struct CounterBufferStats {
+  // Keys whose increments are buffered
+  uint64_t keys;
+  // Counters and increments not written yet
+  uint64_t dirty_counters;
+  uint64_t dirty_increments;
+  // Age of the oldest increment not written yet
+  uint64_t oldest_dirty_ms;
+  // Increments a crash may lose at most this long after they returned
+  uint32_t flush_interval_ms;
+  uint64_t flushed_increments;
+  uint64_t flush_errors;
+};
+
+struct EvictionStats {
+  uint64_t max_data_size;
+  // Live data size as last checked by the evictor
+  uint64_t data_size;
+  uint64_t evicted_keys;
+  // Estimated from the average entry size of the type dbs, the space
+  // is reclaimed once the compaction drops the evicted entries
+  uint64_t evicted_bytes;
+  // Checks that found the data size beyond max_data_size
+  uint64_t eviction_rounds;
+};
+
+struct StorageTierStats {
+  // Where the sst files of one type db are kept
+  std::string path;
+  uint64_t files;
+  uint64_t bytes;
+  // Reads of the files, sampled by rocksdb
+  uint64_t sampled_reads;
+};
+
+struct TieredStorageStats {
+  std::vector<StorageTierStats> tiers;
+  // Counted only with options.statistics
+  uint64_t block_cache_hits;
+  uint64_t block_cache_misses;
+  uint64_t secondary_cache_hits;
+  uint64_t secondary_cache_misses;
+};
+
+struct WritePressureStats {
+  WritePressure pressure;
+  // Of the column family closest to a stall, as a ratio of where
+  // rocksdb starts to delay the writes
+  double slowdown_ratio;
+  // The largest of all the column families
+  uint64_t l0_files;
+  uint64_t pending_compaction_bytes;
+  uint64_t immutable_memtables;
+  // Times the writes of a column family were delayed or stopped
+  uint64_t stalls;
+};
+
 struct ValueStatus {
   std::string value;
   Status status;
@@ -122,6 +436,61 @@ struct ScoreMember {
   }
 };
 
+// The id of a stream entry, the unix time in milliseconds the entry was
+// added at and its sequence number among the entries of that millisecond
+struct StreamID {
+  uint64_t ms;
+  uint64_t seq;
+  StreamID(uint64_t _ms = 0, uint64_t _seq = 0) : ms(_ms), seq(_seq) {}
+  bool operator == (const StreamID& id) const {
+    return (id.ms == ms && id.seq == seq);
+  }
+  bool operator < (const StreamID& id) const {
+    return ms < id.ms || (ms == id.ms && seq < id.seq);
+  }
+  std::string ToString() const {
+    return std::to_string(ms) + "-" + std::to_string(seq);
+  }
+};
+
+struct StreamEntry {
+  StreamID id;
+  std::vector<FieldValue> fvs;
+  bool operator == (const StreamEntry& entry) const {
+    return (entry.id == id && entry.fvs == fvs);
+  }
+};
+
+// A member of a geo set found by a search, longitude and latitude are in
+// degrees and distance is in meters from the center of the search
+struct GeoPoint {
+  std::string member;
+  double longitude;
+  double latitude;
+  double distance;
+  bool operator == (const GeoPoint& gp) const {
+    return (gp.member == member && gp.longitude == longitude
+      && gp.latitude == latitude && gp.distance == distance);
+  }
+};
+
+struct GeoPosStatus {
+  double longitude;
+  double latitude;
+  Status status;
+};
+
+// The area of a geo search around the center, a circle of radius meters if
+// by_radius, otherwise a box of width by height meters
+struct GeoShape {
+  double longitude;
+  double latitude;
+  bool by_radius;
+  double radius;
+  double width;
+  double height;
+};
+
 enum BeforeOrAfter {
   Before,
   After
@@ -133,11 +502,12 @@ enum DataType {
   kHashes,
   kLists,
   kZSets,
-  kSets
+  kSets,
+  kStreams
 };
 
 const char DataTypeTag[] = {
-  'a', 'k', 'h', 'l', 'z','s'
+  'a', 'k', 'h', 'l', 'z','s', 'x'
 };
 
 enum ColumnFamilyType {
@@ -146,6 +516,54 @@ enum ColumnFamilyType {
   kMetaAndData
 };
 
+enum ChangeOperation {
+  kChangePut = 0,
+  kChangeDelete,
+  kChangeDeleteRange
+};
+
+// A logical operation decoded from the WAL of one type db, meta records
+// (cf_type == kMeta) describe the whole key, data records (cf_type == kData)
+// describe one field/member/element of the key's current version
+struct ChangeRecord {
+  DataType type;
+  ColumnFamilyType cf_type;
+  ChangeOperation operation;
+  uint64_t sequence;
+  std::string key;
+  // hashes field, sets/zsets member, lists index, or the end key of
+  // a kChangeDeleteRange record
+  std::string field;
+  // strings value, hashes value, zsets score, lists element,
+  // or the element count of a meta record
+  std::string value;
+  int32_t version;
+  // absolute expire time in seconds, 0 means persistent
+  int32_t timestamp;
+
+  ChangeRecord() : type(kAll), cf_type(kMeta), operation(kChangePut),
+      sequence(0), version(0), timestamp(0) {}
+};
+
+struct InconsistentKey {
+  DataType type;
+  std::string key;
+  // The count of the meta value and the data keys found for it
+  uint64_t meta_count;
+  uint64_t data_count;
+  bool repaired;
+};
+
+struct ConsistencyReport {
+  // The collections checked, a collection checked in a range of the
+  // meta column family while it was written may be reported by mistake
+  uint64_t checked_keys;
+  uint64_t inconsistent_keys;
+  uint64_t repaired_keys;
+  // The first inconsistent keys found, at most 1000
+  std::vector<InconsistentKey> samples;
+};
+
 enum AGGREGATE {
   SUM,
   MIN,
@@ -160,6 +578,41 @@ enum BitOpType {
   kBitOpDefault
 };
 
+enum BitFieldOpType {
+  kBitFieldGet,
+  kBitFieldSet,
+  kBitFieldIncrby
+};
+
+// How SET and INCRBY of BITFIELD handle a value out of the range of the
+// field, it wraps around, saturates at the limit, or the operation fails
+enum BitFieldOverflow {
+  kBitFieldWrap,
+  kBitFieldSat,
+  kBitFieldFail
+};
+
+// One operation of BITFIELD on the field of bits bits at bit offset, an
+// unsigned field is 1 to 63 bits and a signed one 1 to 64 bits. value is
+// the value of SET or the increment of INCRBY
+struct BitFieldOp {
+  BitFieldOpType type;
+  bool is_signed;
+  uint32_t bits;
+  int64_t offset;
+  int64_t value;
+  BitFieldOverflow overflow;
+};
+
+// The result of one operation of BITFIELD, nil if it failed on overflow
+struct BitFieldValue {
+  int64_t value;
+  bool nil;
+  bool operator == (const BitFieldValue& bv) const {
+    return (bv.value == value && bv.nil == nil);
+  }
+};
+
 enum Operation {
   kNone = 0,
   kCleanAll,
@@ -168,7 +621,9 @@ enum Operation {
   kCleanZSets,
   kCleanSets,
   kCleanLists,
-  kCompactKey
+  kCleanStreams,
+  kCompactKey,
+  kDropExpiredFiles
 };
 
 struct BGTask {
@@ -284,6 +739,14 @@ class BlackWidow {
                 int64_t start_offset, int64_t end_offset,
                 int64_t* ret);
 
+  // Performs the GET, SET and INCRBY operations on the integer fields of
+  // the string value stored at key in order, rets[i] is the result of
+  // ops[i]: the value of GET, the old value of SET, the new value of
+  // INCRBY. A missing key is an empty string, and the string is padded
+  // with zero bytes to hold the fields set
+  Status BitField(const Slice& key, const std::vector<BitFieldOp>& ops,
+                  std::vector<BitFieldValue>* rets);
+
   // Decrements the number stored at key by decrement
   // return the value of key after the decrement
   Status Decrby(const Slice& key, int64_t value, int64_t* ret);
@@ -616,6 +1079,19 @@ class BlackWidow {
   // performed when key does not yet exist.
   Status RPushx(const Slice& key, const Slice& value, uint64_t* len);
 
+  // Like LPUSH, and makes the list keep at most cap elements from now on,
+  // the elements beyond the cap are evicted from the tail in the same write.
+  // LPUSH, RPUSH, LPUSHX and RPUSHX on a capped list evict the elements beyond
+  // the cap from the end opposite to the push. The cap is dropped with the
+  // list, COPY and DUMP do not carry it.
+  Status LPushCapped(const Slice& key, const std::vector<std::string>& values,
+                     uint64_t cap, uint64_t* ret);
+
+  // Like RPUSH, the elements beyond the cap are evicted from the head, see
+  // LPushCapped.
+  Status RPushCapped(const Slice& key, const std::vector<std::string>& values,
+                     uint64_t cap, uint64_t* ret);
+
   // Removes the first count occurrences of elements equal to value from the
   // list stored at key. The count argument influences the operation in the
   // following ways:
@@ -688,6 +1164,14 @@ class BlackWidow {
               const std::vector<ScoreMember>& score_members,
               int32_t* ret);
 
+  // Like ZADD, and makes the sorted set keep at most cap members from now on,
+  // the lowest ranked members beyond the cap are evicted in the same write.
+  // ZADD and ZINCRBY on a capped sorted set evict the same way. The cap is
+  // dropped with the sorted set, COPY and DUMP do not carry it.
+  Status ZAddCapped(const Slice& key,
+                    const std::vector<ScoreMember>& score_members,
+                    int32_t cap, int32_t* ret);
+
   // Returns the sorted set cardinality (number of elements) of the sorted set
   // stored at key.
   Status ZCard(const Slice& key, int32_t* ret);
@@ -984,6 +1468,73 @@ class BlackWidow {
   Status ZScan(const Slice& key, int64_t cursor, const std::string& pattern,
                int64_t count, std::vector<ScoreMember>* score_members, int64_t* next_cursor);
 
+  // Geo Commands, a geo set is a sorted set whose scores are the 52 bit
+  // geohashes of the positions of its members
+
+  // Adds the members at their longitude and latitude to the geo set at key,
+  // ret is the number of members added. Nothing is added if a position is
+  // out of the range of longitude -180..180 and latitude -85.05..85.05
+  Status GeoAdd(const Slice& key, const std::vector<GeoPoint>& points,
+                int32_t* ret);
+
+  // The positions of members in the geo set at key, the status of a
+  // missing member is NotFound
+  Status GeoPos(const Slice& key, const std::vector<std::string>& members,
+                std::vector<GeoPosStatus>* positions);
+
+  // The distance in meters between two members of the geo set at key
+  Status GeoDist(const Slice& key, const Slice& member1,
+                 const Slice& member2, double* distance);
+
+  // The members of the geo set at key in shape, nearest first, at most
+  // count of them if count is positive. Only the score ranges of the
+  // geohash cells around shape are read
+  Status GeoSearch(const Slice& key, const GeoShape& shape, int64_t count,
+                   std::vector<GeoPoint>* points);
+
+  // Streams Commands
+
+  // Appends the entry with the specified fields and values to the stream
+  // stored at key, creating it if it does not exist. The id is "*" for an
+  // id generated from the current time in milliseconds, "<ms>-*" for a
+  // generated sequence number, or an explicit "<ms>-<seq>", and it must be
+  // greater than every id ever added to the stream, the added id is
+  // returned in added_id
+  Status XAdd(const Slice& key, const std::string& id,
+              const std::vector<FieldValue>& fvs, StreamID* added_id);
+
+  // Returns the number of entries inside the stream stored at key
+  Status XLen(const Slice& key, uint64_t* len);
+
+  // Returns the entries of the stream stored at key with ids between start
+  // and end, "-" and "+" are the smallest and the greatest ids, "<ms>"
+  // covers every sequence number of the millisecond and a "(" prefix makes
+  // a bound exclusive. At most count entries are returned unless count is
+  // not positive
+  Status XRange(const Slice& key, const std::string& start,
+                const std::string& end, int64_t count,
+                std::vector<StreamEntry>* entries);
+
+  // Like XRANGE, with the entries returned in reverse order, the end
+  // bound comes first
+  Status XRevrange(const Slice& key, const std::string& end,
+                   const std::string& start, int64_t count,
+                   std::vector<StreamEntry>* entries);
+
+  // Removes the entries with the specified ids from the stream stored at
+  // key, ret is the number of the entries actually removed
+  Status XDel(const Slice& key, const std::vector<std::string>& ids,
+              int32_t* ret);
+
+  // Evicts the oldest entries of the stream stored at key until it has no
+  // more than maxlen entries, ret is the number of the evicted entries
+  Status XTrim(const Slice& key, uint64_t maxlen, int64_t* ret);
+
+  // Evicts the entries of the stream stored at key with ids lower than
+  // min_id, ret is the number of the evicted entries
+  Status XTrimMinid(const Slice& key, const std::string& min_id,
+                    int64_t* ret);
+
   // Keys Commands
 
   // Note:
@@ -1080,6 +1631,43 @@ class BlackWidow {
   std::map<DataType, int64_t> TTL(const Slice& key,
                                   std::map<DataType, Status>* type_status);
 
+  // Renames key to newkey in every data type key exists in, newkey of
+  // the same data type is overwritten and the timeout of key is kept.
+  // The elements of a collection are not moved, newkey keeps reading
+  // them until it is overwritten or deleted
+  // return NotFound if key does not exist
+  Status Rename(const Slice& key, const Slice& newkey);
+
+  // Renames key to newkey if newkey does not yet exist in any data type
+  // return NotFound if key does not exist
+  // return ret 1 if key was renamed to newkey
+  // return ret 0 if newkey already exists
+  Status RenameNx(const Slice& key, const Slice& newkey, int32_t* ret);
+
+  // Copies the value of key to newkey in every data type key exists in,
+  // the copy is independent of key
+  // return ret 1 if key was copied
+  // return ret 0 if key does not exist, or newkey exists and replace
+  // is false
+  Status Copy(const Slice& key, const Slice& newkey, bool replace,
+              int32_t* ret);
+
+  // Serialize the value stored at key in a blackwidow specific format,
+  // the dump carries the data type, a format version and a checksum,
+  // it is read back by Restore, see src/dump_format.h
+  // return NotFound if key does not exist
+  // return InvalidArgument if the dump is larger than max_dump_size
+  Status Dump(const Slice& key, std::string* dump);
+
+  // Create key with the value of a dump produced by Dump, ttl in
+  // seconds, 0 means the key is persistent. With replace key is removed
+  // from all the data types first. The elements of a big collection are
+  // written in several batches and become visible all at once
+  // return Busy if key already exists and replace is false
+  // return Corruption if the dump is malformed
+  Status Restore(const Slice& key, const Slice& dump, int32_t ttl,
+                 bool replace);
+
   // Reutrns the data type of the key
   Status Type(const std::string& key, std::string* type);
 
@@ -1091,6 +1679,37 @@ class BlackWidow {
   // Iterate through all the data in the database.
   void ScanDatabase(const DataType& type);
 
+  // Slot Commands, only supported with slot_tagged_keys
+
+  // Scan at most count keys of data_type in slot from start_key, an empty
+  // start_key starts from the first key of the slot, next_key is empty
+  // once the slot is finished
+  Status SlotScan(const DataType& data_type, uint32_t slot,
+                  const std::string& start_key, int64_t count,
+                  std::vector<std::string>* keys, std::string* next_key);
+
+  // The number of keys of all the data types in slot
+  Status SlotKeyCount(uint32_t slot, int64_t* count);
+
+  // Delete all the keys of slot by a range deletion in each type db, the
+  // elements of the collections are dropped by the following compactions
+  Status DelSlot(uint32_t slot);
+
+  // Logical Databases, see databases
+
+  // Run the following commands of the calling thread in db, see
+  // DBContext for a selection bound to a scope
+  Status Select(uint32_t db);
+  uint32_t SelectedDB() const;
+
+  // Delete all the keys of db by a range deletion in each type db, the
+  // elements of the collections are dropped by the following compactions,
+  // a collection created again right away starts empty
+  Status FlushDB(uint32_t db);
+
+  // The number of keys of all the data types in db
+  Status DBSize(uint32_t db, int64_t* count);
+
   // HyperLogLog
   enum {
     kMaxKeys = 255,
@@ -1111,6 +1730,32 @@ class BlackWidow {
   // HyperLogLog structures.
   Status PfMerge(const std::vector<std::string>& keys);
 
+  // Bloom filter, a member added to it is always reported present, other
+  // members are reported present with about error_rate probability while
+  // no more than capacity members were added
+  enum {
+    kBloomDefaultCapacity = 100,
+  };
+  static const double kBloomDefaultErrorRate;
+
+  // Create an empty Bloom filter at key, which must not exist
+  Status BfReserve(const Slice& key, double error_rate, uint64_t capacity);
+
+  // Add member to the Bloom filter at key, ret is 1 if it was not present,
+  // a missing filter is created with the default capacity and error rate
+  Status BfAdd(const Slice& key, const std::string& member, int32_t* ret);
+
+  // Add all the members, rets[i] is the BfAdd result of members[i]
+  Status BfMAdd(const Slice& key, const std::vector<std::string>& members,
+                std::vector<int32_t>* rets);
+
+  // ret is 1 if member may have been added to the Bloom filter at key
+  Status BfExists(const Slice& key, const std::string& member, int32_t* ret);
+
+  // rets[i] is the BfExists result of members[i]
+  Status BfMExists(const Slice& key, const std::vector<std::string>& members,
+                   std::vector<int32_t>* rets);
+
   // Admin Commands
   Status StartBGThread();
   Status RunBGTask();
@@ -1130,17 +1775,149 @@ class BlackWidow {
   uint64_t GetProperty(const std::string& db_type, const std::string& property);
 
   Status GetKeyNum(std::vector<KeyInfo>* key_infos);
+  // Check every hash, set, zset and list of type against its data keys:
+  // the meta count against the fields or members, the left and right
+  // index of a list against its elements, the member to score entries of
+  // a zset against its score entries. The meta column family of each type
+  // db is split into ranges checked in parallel by threads workers, all
+  // against one snapshot of the type db. With repair the meta count of
+  // an inconsistent key is rewritten from its data keys, which are read
+  // again under the lock of the key, the lists with holes and the zsets
+  // whose two column families disagree can not be repaired
+  Status CheckConsistency(const DataType& type, int32_t threads,
+                          bool repair, ConsistencyReport* report);
+  // The sst files on every storage tier of every type db, and the hits
+  // of the block cache and the secondary cache
+  Status GetTieredStorageStats(TieredStorageStats* stats);
   Status StopScanKeyNum();
 
+  // Change data capture, decode the write batches committed to the type
+  // db since since_sequence into logical operations, complete write batches
+  // are returned until about count records are collected, next_sequence is
+  // where the next call should resume from. The WAL files are only kept
+  // for as long as options.WAL_ttl_seconds / WAL_size_limit_MB allow,
+  // a consumer gets NotFound once it falls further behind and has to
+  // do a full sync again
+  Status GetUpdatesSince(const DataType& type, uint64_t since_sequence,
+                         int64_t count, std::vector<ChangeRecord>* records,
+                         uint64_t* next_sequence);
+  Status GetLatestSequenceNumber(const DataType& type, uint64_t* sequence);
+
+  // Hot keys and big keys of the type, sorted by count in
+  // descending order
+  Status GetHotKeys(const DataType& type, std::vector<KeyCount>* hot_keys);
+  Status GetBigKeys(const DataType& type, std::vector<KeyCount>* big_keys);
+  Status StartKeyDetectorThread();
+  Status RunKeyDetectorTask();
+
+  // Buffer the Incrby/Decrby of a string, the HIncrby of a hash or the
+  // ZIncrby of a zset in memory, see counter_flush_interval_ms. Reads
+  // of the counter see the buffered increments, any other command of
+  // the key writes them first. A buffered expiration takes effect when
+  // the increments are written, a counter created in the buffer shows
+  // up in Keys and Scan after that
+  Status BufferCounter(const DataType& type, const Slice& key);
+  Status UnbufferCounter(const DataType& type, const Slice& key);
+  Status GetCounterBufferStats(CounterBufferStats* stats);
+  Status StartCounterBufferThread();
+  Status RunCounterBufferTask();
+
+  // Size-bounded eviction, see max_data_size
+  Status GetEvictionStats(EvictionStats* stats);
+  Status StartEvictionThread();
+  Status RunEvictionTask();
+
+  // Whether the writes of type are about to stall or stalled, without
+  // blocking, so that a server can shed or delay its bulk writers before
+  // the latency critical writes wait in rocksdb. kAll returns the highest
+  // pressure of all the type dbs
+  Status GetWritePressure(const DataType& type, WritePressureStats* stats);
+
+  // Replay the new MANIFEST and WAL records written by the primary
+  // instance, only available when opened with kOpenSecondary
+  Status TryCatchUpWithPrimary();
+  Status StartCatchUpThread();
+  Status RunCatchUpTask();
+  // Open the dataset built in db_path and serve it instead of the current
+  // one without blocking any command, only available when opened with
+  // kOpenServing. The current dataset is closed once the commands still
+  // reading it return, it is kept if the new one fails to open
+  Status SwapDataset(const std::string& db_path);
+  bool IsReadOnly() const;
+
   rocksdb::DB* GetDBByType(const std::string& type);
 
  private:
-  RedisStrings* strings_db_;
-  RedisHashes* hashes_db_;
-  RedisSets* sets_db_;
-  RedisZSets* zsets_db_;
-  RedisLists* lists_db_;
+  // The type dbs of one dataset, closed with it. SwapDataset publishes
+  // a new dataset, the commands still reading the former one keep it
+  // until they return
+  struct Dataset {
+    RedisStrings* strings_db;
+    RedisHashes* hashes_db;
+    RedisSets* sets_db;
+    RedisZSets* zsets_db;
+    RedisLists* lists_db;
+    RedisStreams* streams_db;
+    Dataset();
+    ~Dataset();
+    // strings, hashes, sets, lists, zsets and streams
+    std::vector<Redis*> dbs() const;
+  };
+
+  // A type db of the served dataset, used as a pointer to it. In serving
+  // mode a call through -> holds the dataset until the call returns, a
+  // command calling several type dbs takes CurrentDataset() instead
+  template <typename T>
+  class DatasetDB {
+   public:
+    class Pin {
+     public:
+      Pin(const std::shared_ptr<Dataset>& dataset, T* db)
+        : dataset_(dataset), db_(db) {
+      }
+      T* operator->() const {
+        return db_;
+      }
+
+     private:
+      std::shared_ptr<Dataset> dataset_;
+      T* db_;
+    };
+
+    DatasetDB(const BlackWidow* bw, T* Dataset::* member)
+      : bw_(bw), member_(member) {
+    }
+    Pin operator->() const {
+      if (bw_->open_mode_ != kOpenServing) {
+        return Pin(std::shared_ptr<Dataset>(), bw_->dataset_.get()->*member_);
+      }
+      std::shared_ptr<Dataset> dataset = bw_->CurrentDataset();
+      return Pin(dataset, dataset.get()->*member_);
+    }
+
+   private:
+    const BlackWidow* const bw_;
+    T* Dataset::* const member_;
+  };
+
+  // Only replaced by SwapDataset, read through CurrentDataset()
+  std::shared_ptr<Dataset> dataset_;
+  DatasetDB<RedisStrings> strings_db_;
+  DatasetDB<RedisHashes> hashes_db_;
+  DatasetDB<RedisSets> sets_db_;
+  DatasetDB<RedisZSets> zsets_db_;
+  DatasetDB<RedisLists> lists_db_;
+  DatasetDB<RedisStreams> streams_db_;
   std::atomic<bool> is_opened_;
+  OpenMode open_mode_;
+  size_t max_dump_size_;
+  double write_pressure_ratio_;
+  bool slot_tagged_keys_;
+  uint32_t databases_;
+  // The database selected by every thread
+  pthread_key_t selected_db_key_;
+  // Owns the files of all type dbs with kMemoryBackend
+  rocksdb::Env* mem_env_;
 
   LRUCache<std::string, std::string>* cursors_store_;
 
@@ -1153,9 +1930,108 @@ class BlackWidow {
   std::atomic<int> current_task_type_;
   std::atomic<bool> bg_tasks_should_exit_;
 
+  // Secondary instance catch up with the primary periodically
+  bool catch_up_thread_started_;
+  pthread_t catch_up_thread_id_;
+  uint32_t catch_up_interval_ms_;
+  slash::Mutex catch_up_mutex_;
+  slash::CondVar catch_up_cond_var_;
+  std::atomic<bool> catch_up_should_exit_;
+
+  // The options of the served datasets, SwapDataset one at a time
+  BlackwidowOptions serving_options_;
+  slash::Mutex serving_mutex_;
+
+  // Hot key and big key detection
+  KeyDetector* key_detector_;
+  bool key_detector_thread_started_;
+  pthread_t key_detector_thread_id_;
+  uint32_t key_detector_interval_ms_;
+  uint64_t big_key_threshold_;
+  slash::Mutex key_detector_mutex_;
+  slash::CondVar key_detector_cond_var_;
+  std::atomic<bool> key_detector_should_exit_;
+
+  // Write-behind buffer of hot counters, nullptr if disabled
+  CounterBuffer* counter_buffer_;
+  bool counter_buffer_thread_started_;
+  pthread_t counter_buffer_thread_id_;
+  uint32_t counter_flush_interval_ms_;
+  bool buffer_hot_counters_;
+  slash::Mutex counter_buffer_mutex_;
+  slash::CondVar counter_buffer_cond_var_;
+  std::atomic<bool> counter_buffer_should_exit_;
+
+  // Evict sampled keys when the data size exceeds max_data_size_
+  AccessClock* access_clock_;
+  bool eviction_thread_started_;
+  pthread_t eviction_thread_id_;
+  uint32_t eviction_interval_ms_;
+  uint64_t max_data_size_;
+  EvictionPolicy eviction_policy_;
+  uint32_t eviction_samples_;
+  slash::Mutex eviction_mutex_;
+  slash::CondVar eviction_cond_var_;
+  std::atomic<bool> eviction_should_exit_;
+  std::atomic<uint64_t> data_size_;
+  std::atomic<uint64_t> evicted_keys_;
+  std::atomic<uint64_t> evicted_bytes_;
+  std::atomic<uint64_t> eviction_rounds_;
+
   // For scan keys in data base
   std::atomic<bool> scan_keynum_exit_;
 
+  // The keys as stored in the type dbs, see slot_tagged_keys and
+  // databases, the vector versions return the input itself if neither
+  // layout is enabled
+  bool IsKeyTagged() const;
+  SlotTaggedKey TagKey(const Slice& key) const;
+  const std::vector<std::string>& TagKeys(
+      const std::vector<std::string>& keys,
+      std::vector<std::string>* tagged_keys) const;
+  const std::vector<KeyValue>& TagKeys(
+      const std::vector<KeyValue>& kvs,
+      std::vector<KeyValue>* tagged_kvs) const;
+  std::string TagPattern(const std::string& pattern) const;
+
+  std::shared_ptr<Dataset> CurrentDataset() const;
+
+  // Write the buffered increments of the stored keys before a command
+  // only reading them, kAll for the reads of every type. The counters
+  // stay buffered, the writes go through ScopeCounterWrite
+  void FlushBufferedCounter(const DataType& type, const Slice& key);
+  void FlushBufferedCounters(const DataType& type,
+                             const std::vector<std::string>& keys);
+
+  // Evict the sampled keys of the lowest rank until about bytes_to_free
+  // bytes are freed or no key is left
+  uint64_t EvictKeys(uint64_t bytes_to_free,
+                     std::vector<std::string>* cursors);
+
+};
+
+// Run the commands of the calling thread in db while the context lives,
+// the database selected before is selected again when it goes away, so
+// a pooled thread does not carry the database of one request into the
+// next one. status() is InvalidArgument if db is out of range, the
+// selection is left unchanged then
+class DBContext {
+ public:
+  DBContext(BlackWidow* bw, uint32_t db);
+  ~DBContext();
+
+  Status status() const {
+    return status_;
+  }
+
+ private:
+  BlackWidow* const bw_;
+  uint32_t former_db_;
+  Status status_;
+
+  // No copying allowed
+  DBContext(const DBContext&);
+  void operator=(const DBContext&);
 };
 
 }  //  namespace blackwidow
@@ -15,6 +15,9 @@
 
 namespace blackwidow {
 
+  // Number of the hash slots of redis cluster
+  const uint32_t kClusterSlots = 16384;
+
   uint32_t Digits10(uint64_t v);
   int Int64ToStr(char* dst, size_t dstlen, int64_t svalue);
   int StrToInt64(const char *s, size_t slen, int64_t *value);
@@ -22,6 +25,8 @@ namespace blackwidow {
                   int string_len, int nocase);
   int StrToLongDouble(const char* s, size_t slen, long double* ldval);
   int LongDoubleToStr(long double ldval, std::string* value);
+  int StrToDouble(const char* s, size_t slen, double* dval);
+  int DoubleToStr(char* dst, size_t dstlen, double dval);
   int do_mkdir(const char *path, mode_t mode);
   int mkpath(const char *path, mode_t mode);
   int delete_dir(const char* dirname);
@@ -29,6 +34,8 @@ namespace blackwidow {
   int CalculateMetaStartAndEndKey(const std::string& key, std::string* meta_start_key, std::string* meta_end_key);
   int CalculateDataStartAndEndKey(const std::string& key, std::string* data_start_key, std::string* data_end_key);
   bool isTailWildcard(const std::string& pattern);
+  uint16_t Crc16(const char* buf, size_t len);
+  uint32_t KeyHashSlot(const char* key, size_t len);
 }
 
 #endif  //  SRC_UTIL_H_
@@ -0,0 +1,89 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/access_clock.h"
+
+#include <random>
+
+#include "rocksdb/env.h"
+#include "src/murmurhash.h"
+
+namespace blackwidow {
+
+AccessClock::AccessClock(size_t slots)
+    : start_micros_(rocksdb::Env::Default()->NowMicros()) {
+  size_t size = 1;
+  while (size < slots) {
+    size <<= 1;
+  }
+  mask_ = size - 1;
+  slots_ = new std::atomic<uint32_t>[size];
+  for (size_t idx = 0; idx < size; ++idx) {
+    slots_[idx].store(0, std::memory_order_relaxed);
+  }
+}
+
+AccessClock::~AccessClock() {
+  delete[] slots_;
+}
+
+uint32_t AccessClock::Now() const {
+  uint64_t seconds = (rocksdb::Env::Default()->NowMicros()
+      - start_micros_) / 1000000;
+  return static_cast<uint32_t>(seconds & kClockMask);
+}
+
+std::atomic<uint32_t>* AccessClock::Slot(const DataType& type,
+                                         const Slice& key) {
+  // Different data types with the same key are different keys
+  uint64_t hash = MurmurHash(key.data(), static_cast<int>(key.size()), type);
+  return &slots_[hash & mask_];
+}
+
+uint32_t AccessClock::DecayedCounter(uint32_t slot, uint32_t now) const {
+  uint32_t counter = slot & kCounterMax;
+  uint32_t idle_minutes = ((now - (slot >> kCounterBits)) & kClockMask) / 60;
+  uint32_t decay = idle_minutes / kDecayMinutes;
+  return decay < counter ? counter - decay : 0;
+}
+
+void AccessClock::Touch(const DataType& type, const Slice& key) {
+  std::atomic<uint32_t>* slot = Slot(type, key);
+  uint32_t now = Now();
+  uint32_t value = slot->load(std::memory_order_relaxed);
+  uint32_t counter = kInitCounter;
+  if (value != 0) {
+    counter = DecayedCounter(value, now);
+    if (counter < kCounterMax) {
+      static thread_local std::minstd_rand engine(
+          static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&counter)));
+      uint32_t base = counter > kInitCounter ? counter - kInitCounter : 0;
+      std::uniform_int_distribution<uint32_t> dist(0, base * kLogFactor);
+      if (dist(engine) == 0) {
+        counter++;
+      }
+    }
+  }
+  // Lost updates of concurrent accesses are fine for an estimate
+  slot->store((now << kCounterBits) | counter, std::memory_order_relaxed);
+}
+
+uint32_t AccessClock::IdleSeconds(const DataType& type, const Slice& key) {
+  uint32_t value = Slot(type, key)->load(std::memory_order_relaxed);
+  if (value == 0) {
+    return kClockMask;
+  }
+  return (Now() - (value >> kCounterBits)) & kClockMask;
+}
+
+uint32_t AccessClock::Frequency(const DataType& type, const Slice& key) {
+  uint32_t value = Slot(type, key)->load(std::memory_order_relaxed);
+  if (value == 0) {
+    return 0;
+  }
+  return DecayedCounter(value, Now());
+}
+
+}  //  namespace blackwidow
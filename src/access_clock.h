@@ -0,0 +1,62 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_ACCESS_CLOCK_H_
+#define SRC_ACCESS_CLOCK_H_
+
+#include <atomic>
+#include <string>
+
+#include "rocksdb/slice.h"
+
+#include "blackwidow/blackwidow.h"
+
+namespace blackwidow {
+using Slice = rocksdb::Slice;
+
+// Approximate recency and frequency of the accesses to every key for the
+// evictor, kept in a fixed array of 32 bit slots indexed by the key hash,
+// keys sharing a slot share their statistics:
+// | last access in seconds (24 bits) | logarithmic access counter (8 bits) |
+// The counter grows with probability 1 / (counter * kLogFactor + 1)
+// and loses one every kDecayMinutes without access, as the redis LFU
+class AccessClock {
+ public:
+  explicit AccessClock(size_t slots);
+  ~AccessClock();
+
+  void Touch(const DataType& type, const Slice& key);
+
+  // Seconds since the last access, the maximum for the keys not
+  // accessed since the clock started
+  uint32_t IdleSeconds(const DataType& type, const Slice& key);
+  // The decayed access counter, 0 for the keys not accessed since
+  // the clock started
+  uint32_t Frequency(const DataType& type, const Slice& key);
+
+ private:
+  static const uint32_t kClockMask = 0xFFFFFF;
+  static const uint32_t kCounterBits = 8;
+  static const uint32_t kCounterMax = 255;
+  // New keys start above 0 so that they are not the first victims
+  static const uint32_t kInitCounter = 5;
+  static const uint32_t kLogFactor = 10;
+  static const uint32_t kDecayMinutes = 1;
+
+  uint64_t start_micros_;
+  size_t mask_;
+  std::atomic<uint32_t>* slots_;
+
+  uint32_t Now() const;
+  std::atomic<uint32_t>* Slot(const DataType& type, const Slice& key);
+  uint32_t DecayedCounter(uint32_t slot, uint32_t now) const;
+
+  // No copying allowed
+  AccessClock(const AccessClock&);
+  void operator=(const AccessClock&);
+};
+
+}  //  namespace blackwidow
+#endif  //  SRC_ACCESS_CLOCK_H_
@@ -129,9 +129,26 @@ class ParsedZSetsMemberKey : public ParsedBaseDataKey {
   }
 };
 
+// The entries of origin_cf, the renamed keys which read the data keys
+// of (origin, version)
+class ParsedOriginRefKey : public ParsedBaseDataKey {
+ public:
+  explicit ParsedOriginRefKey(const std::string* key)
+              : ParsedBaseDataKey(key) {}
+  explicit ParsedOriginRefKey(const Slice& key)
+              : ParsedBaseDataKey(key) {}
+  Slice origin() {
+    return key_;
+  }
+  Slice referrer() {
+    return data_;
+  }
+};
+
 typedef BaseDataKey HashesDataKey;
 typedef BaseDataKey SetsMemberKey;
 typedef BaseDataKey ZSetsMemberKey;
+typedef BaseDataKey OriginRefKey;
 
 }  //  namespace blackwidow
 #endif  // SRC_BASE_DATA_KEY_FORMAT_H_
@@ -13,6 +13,7 @@
 #include "src/debug.h"
 #include "src/base_meta_value_format.h"
 #include "src/base_data_key_format.h"
+#include "src/origin_filter.h"
 #include "rocksdb/compaction_filter.h"
 
 namespace blackwidow {
@@ -74,7 +75,9 @@ class BaseDataFilter : public rocksdb::CompactionFilter {
     cur_key_(""),
     meta_not_found_(false),
     cur_meta_version_(0),
-    cur_meta_timestamp_(0) {}
+    cur_meta_timestamp_(0),
+    cur_meta_has_origin_(false),
+    origin_ref_reader_(db, cf_handles_ptr) {}
 
   bool Filter(int level, const Slice& key,
               const rocksdb::Slice& value,
@@ -100,6 +103,7 @@ class BaseDataFilter : public rocksdb::CompactionFilter {
         ParsedBaseMetaValue parsed_base_meta_value(&meta_value);
         cur_meta_version_ = parsed_base_meta_value.version();
         cur_meta_timestamp_ = parsed_base_meta_value.timestamp();
+        cur_meta_has_origin_ = parsed_base_meta_value.has_origin();
       } else if (s.IsNotFound()) {
         meta_not_found_ = true;
       } else {
@@ -109,25 +113,30 @@ class BaseDataFilter : public rocksdb::CompactionFilter {
       }
     }
 
-    if (meta_not_found_) {
-      Trace("Drop[Meta key not exist]");
-      return true;
-    }
-
     int64_t unix_time;
     rocksdb::Env::Default()->GetCurrentTime(&unix_time);
-    if (cur_meta_timestamp_ != 0
+    const char* drop_reason = nullptr;
+    if (meta_not_found_) {
+      drop_reason = "Drop[Meta key not exist]";
+    } else if (cur_meta_has_origin_) {
+      drop_reason = "Drop[Meta key renamed from origin]";
+    } else if (cur_meta_timestamp_ != 0
       && cur_meta_timestamp_ < static_cast<int32_t>(unix_time)) {
-      Trace("Drop[Timeout]");
-      return true;
+      drop_reason = "Drop[Timeout]";
+    } else if (cur_meta_version_ > parsed_base_data_key.version()) {
+      drop_reason = "Drop[data_key_version < cur_meta_version]";
     }
 
-    if (cur_meta_version_ > parsed_base_data_key.version()) {
-      Trace("Drop[data_key_version < cur_meta_version]");
-      return true;
-    } else {
+    if (drop_reason == nullptr) {
       Trace("Reserve[data_key_version == cur_meta_version]");
       return false;
+    } else if (origin_ref_reader_.IsReferenced(parsed_base_data_key.key(),
+                 parsed_base_data_key.version())) {
+      Trace("Reserve[Read by renamed key]");
+      return false;
+    } else {
+      Trace("%s", drop_reason);
+      return true;
     }
   }
 
@@ -141,6 +150,8 @@ class BaseDataFilter : public rocksdb::CompactionFilter {
   mutable bool meta_not_found_;
   mutable int32_t cur_meta_version_;
   mutable int32_t cur_meta_timestamp_;
+  mutable bool cur_meta_has_origin_;
+  mutable OriginRefReader<ParsedBaseMetaValue> origin_ref_reader_;
 };
 
 class BaseDataFilterFactory : public rocksdb::CompactionFilterFactory {
@@ -178,5 +189,9 @@ typedef BaseMetaFilterFactory ZSetsMetaFilterFactory;
 typedef BaseDataFilter ZSetsDataFilter;
 typedef BaseDataFilterFactory ZSetsDataFilterFactory;
 
+typedef OriginRefFilterFactory<ParsedBaseMetaValue> HashesOriginFilterFactory;
+typedef OriginRefFilterFactory<ParsedBaseMetaValue> SetsOriginFilterFactory;
+typedef OriginRefFilterFactory<ParsedBaseMetaValue> ZSetsOriginFilterFactory;
+
 }  //  namespace blackwidow
 #endif  // SRC_BASE_FILTER_H_
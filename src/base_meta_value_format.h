@@ -12,128 +12,399 @@
 
 namespace blackwidow {
 
-class BaseMetaValue : public InternalValue {
+/*
+ * The meta values of all the collections share one layout, a count of
+ * CountType in front and kExtraLength bytes of their own behind the
+ * timestamp:
+ *
+ * | count | cap | origin | origin_len | last_own_version | version | timestamp | extra |
+ *
+ * The highest bit of the count marks a capped collection, whose cap is
+ * recorded right behind the count, if the format is kCappable, and the
+ * next bit a hash holding a Bloom filter instead of fields. A renamed
+ * collection keeps the data keys written under its former key, the origin
+ * is recorded behind the count (and the cap)
+ */
+template <typename CountType>
+struct MetaCountCoding;
+
+template <>
+struct MetaCountCoding<int32_t> {
+  typedef uint32_t Word;
+  static Word Decode(const char* ptr) {
+    return DecodeFixed32(ptr);
+  }
+  static void Encode(char* dst, Word word) {
+    EncodeFixed32(dst, word);
+  }
+};
+
+template <>
+struct MetaCountCoding<uint64_t> {
+  typedef uint64_t Word;
+  static Word Decode(const char* ptr) {
+    return DecodeFixed64(ptr);
+  }
+  static void Encode(char* dst, Word word) {
+    EncodeFixed64(dst, word);
+  }
+};
+
+// A Format of MetaValue writes its extra bytes in AppendExtra(char* dst)
+template <typename Format, size_t kExtraLength>
+class MetaValue : public InternalValue<Format> {
  public:
-  explicit BaseMetaValue(const Slice& user_value) :
-    InternalValue(user_value) {
+  explicit MetaValue(const Slice& user_value) :
+    InternalValue<Format>(user_value) {
   }
-  size_t AppendTimestampAndVersion() override {
-    size_t usize = user_value_.size();
-    char* dst = start_;
-    memcpy(dst, user_value_.data(), usize);
+
+  static const size_t kValueSuffixLength =
+    2 * sizeof(int32_t) + kExtraLength;
+
+  size_t AppendTimestampAndVersion() {
+    size_t usize = this->user_value_.size();
+    char* dst = this->start_;
+    memcpy(dst, this->user_value_.data(), usize);
     dst += usize;
-    EncodeFixed32(dst, version_);
+    EncodeFixed32(dst, this->version_);
     dst += sizeof(int32_t);
-    EncodeFixed32(dst, timestamp_);
-    return usize + 2 * sizeof(int32_t);
-  }
-
-  int32_t UpdateVersion() {
-    int64_t unix_time;
-    rocksdb::Env::Default()->GetCurrentTime(&unix_time);
-    if (version_ >= static_cast<int32_t>(unix_time)) {
-      version_++;
-    } else {
-      version_ = static_cast<int32_t>(unix_time);
-    }
-    return version_;
+    EncodeFixed32(dst, this->timestamp_);
+    dst += sizeof(int32_t);
+    static_cast<Format*>(this)->AppendExtra(dst);
+    return usize + kValueSuffixLength;
   }
 };
 
-class ParsedBaseMetaValue : public ParsedInternalValue {
+// A Format of ParsedMetaValue decodes its extra fields in DecodeExtra()
+// and resets them in InitialExtra()
+template <typename Format, typename CountType,
+          size_t kExtraLength, bool kCappable>
+class ParsedMetaValue : public ParsedInternalValue<Format> {
  public:
+  typedef MetaCountCoding<CountType> CountCoding;
+  typedef typename CountCoding::Word CountWord;
+
   // Use this constructor after rocksdb::DB::Get();
-  explicit ParsedBaseMetaValue(std::string* internal_value_str) :
-    ParsedInternalValue(internal_value_str) {
-    if (internal_value_str->size() >= kBaseMetaValueSuffixLength) {
-      user_value_ = Slice(internal_value_str->data(),
-          internal_value_str->size() - kBaseMetaValueSuffixLength);
-      version_ = DecodeFixed32(internal_value_str->data() +
-            internal_value_str->size() - sizeof(int32_t) * 2);
-      timestamp_ = DecodeFixed32(internal_value_str->data() +
-            internal_value_str->size() - sizeof(int32_t));
-    }
-    count_ = DecodeFixed32(internal_value_str->data());
+  explicit ParsedMetaValue(std::string* internal_value_str) :
+    ParsedInternalValue<Format>(internal_value_str),
+    count_(0),
+    capped_(false),
+    bloom_(false),
+    cap_(0),
+    has_origin_(false),
+    last_own_version_(0) {
   }
 
   // Use this constructor in rocksdb::CompactionFilter::Filter();
-  explicit ParsedBaseMetaValue(const Slice& internal_value_slice) :
-    ParsedInternalValue(internal_value_slice) {
-    if (internal_value_slice.size() >= kBaseMetaValueSuffixLength) {
-      user_value_ = Slice(internal_value_slice.data(),
-          internal_value_slice.size() - kBaseMetaValueSuffixLength);
-      version_ = DecodeFixed32(internal_value_slice.data() +
-            internal_value_slice.size() - sizeof(int32_t) * 2);
-      timestamp_ = DecodeFixed32(internal_value_slice.data() +
-            internal_value_slice.size() - sizeof(int32_t));
-    }
-    count_ = DecodeFixed32(internal_value_slice.data());
+  explicit ParsedMetaValue(const Slice& internal_value_slice) :
+    ParsedInternalValue<Format>(internal_value_slice),
+    count_(0),
+    capped_(false),
+    bloom_(false),
+    cap_(0),
+    has_origin_(false),
+    last_own_version_(0) {
   }
 
-  void StripSuffix() override {
-    if (value_ != nullptr) {
-      value_->erase(value_->size() - kBaseMetaValueSuffixLength,
-          kBaseMetaValueSuffixLength);
+  static const size_t kMetaValueSuffixLength =
+    2 * sizeof(int32_t) + kExtraLength;
+  static const CountWord kCappedFlag =
+    static_cast<CountWord>(1) << (sizeof(CountWord) * 8 - 1);
+  static const CountWord kBloomFlag = kCappedFlag >> 1;
+
+  void StripSuffix() {
+    this->version();
+    this->timestamp();
+    DecodeOrigin();
+    this->format()->DecodeExtra();
+    if (this->value_ != nullptr) {
+      this->value_->erase(this->value_->size() - kMetaValueSuffixLength,
+          kMetaValueSuffixLength);
     }
   }
 
-  void SetVersionToValue() override {
-    if (value_ != nullptr) {
-      char* dst = const_cast<char*>(value_->data()) + value_->size() -
-        kBaseMetaValueSuffixLength;
-      EncodeFixed32(dst, version_);
+  int32_t DecodeVersion() {
+    const char* suffix = Suffix();
+    return suffix != nullptr ? DecodeFixed32(suffix) : 0;
+  }
+
+  int32_t DecodeTimestamp() {
+    const char* suffix = Suffix();
+    return suffix != nullptr ? DecodeFixed32(suffix + sizeof(int32_t)) : 0;
+  }
+
+  void SetVersionToValue() {
+    if (this->value_ != nullptr) {
+      char* dst = const_cast<char*>(this->value_->data())
+        + this->value_->size() - kMetaValueSuffixLength;
+      EncodeFixed32(dst, this->version_);
     }
   }
 
-  void SetTimestampToValue() override {
-    if (value_ != nullptr) {
-      char* dst = const_cast<char*>(value_->data()) + value_->size() -
-        sizeof(int32_t);
-      EncodeFixed32(dst, timestamp_);
+  void SetTimestampToValue() {
+    if (this->value_ != nullptr) {
+      char* dst = const_cast<char*>(this->value_->data())
+        + this->value_->size() - kMetaValueSuffixLength + sizeof(int32_t);
+      EncodeFixed32(dst, this->timestamp_);
     }
   }
-  static const size_t kBaseMetaValueSuffixLength = 2 * sizeof(int32_t);
 
-  int32_t InitialMetaValue() {
+  int32_t InitialMetaValue(int32_t floor = 0) {
+    if (kCappable) {
+      this->set_cap(0);
+      this->set_bloom(false);
+    }
     this->set_count(0);
+    this->format()->InitialExtra();
     this->set_timestamp(0);
-    return this->UpdateVersion();
+    return this->UpdateVersion(floor);
   }
 
-  int32_t count() {
+  CountType count() {
+    DecodeCount();
     return count_;
   }
 
-  void set_count(int32_t count) {
+  void set_count(CountType count) {
+    DecodeCount();
     count_ = count;
-    if (value_ != nullptr) {
-      char* dst = const_cast<char*>(value_->data());
-      EncodeFixed32(dst, count_);
-    }
+    SetCountToValue();
   }
 
-  void ModifyCount(int32_t delta) {
+  void ModifyCount(CountType delta) {
+    DecodeCount();
     count_ += delta;
-    if (value_ != nullptr) {
-      char* dst = const_cast<char*>(value_->data());
-      EncodeFixed32(dst, count_);
+    SetCountToValue();
+  }
+
+  bool capped() {
+    DecodeCount();
+    return capped_;
+  }
+
+  // Whether the hash holds a Bloom filter, its fields are not accessible
+  // to the hash commands
+  bool bloom() {
+    DecodeCount();
+    return bloom_;
+  }
+
+  void set_bloom(bool bloom) {
+    DecodeCount();
+    bloom_ = bloom;
+    SetCountToValue();
+  }
+
+  // The most members a capped collection keeps
+  CountType cap() {
+    DecodeCount();
+    return cap_;
+  }
+
+  // A cap of 0 makes the collection unbounded again
+  void set_cap(CountType cap) {
+    DecodeCount();
+    if (this->value_ != nullptr) {
+      if (cap > 0 && capped_) {
+        char* dst = const_cast<char*>(this->value_->data())
+          + sizeof(CountWord);
+        CountCoding::Encode(dst, cap);
+      } else if (cap > 0) {
+        char buf[sizeof(CountWord)];
+        CountCoding::Encode(buf, cap);
+        this->value_->insert(sizeof(CountWord), buf, sizeof(buf));
+      } else if (capped_) {
+        this->value_->erase(sizeof(CountWord), sizeof(CountWord));
+      }
+      capped_ = cap > 0;
+      cap_ = capped_ ? cap : 0;
+      SetCountToValue();
+      this->decoded_ &= ~kOriginDecoded;
     }
   }
 
-  int32_t UpdateVersion() {
-    int64_t unix_time;
-    rocksdb::Env::Default()->GetCurrentTime(&unix_time);
-    if (version_ >= static_cast<int32_t>(unix_time)) {
-      version_++;
-    } else {
-      version_ = static_cast<int32_t>(unix_time);
+  // A new version is always used by the data keys of the key itself
+  int32_t UpdateVersion(int32_t floor = 0) {
+    if (has_origin()) {
+      StripOrigin();
+    }
+    int32_t version = VersionAfter(this->version(), floor);
+    this->set_version(version);
+    return version;
+  }
+
+  bool has_origin() {
+    DecodeOrigin();
+    return has_origin_;
+  }
+
+  Slice origin() {
+    DecodeOrigin();
+    return origin_;
+  }
+
+  // The key the data keys of this collection are encoded with
+  Slice data_owner(const Slice& key) {
+    return has_origin() ? origin_ : key;
+  }
+
+  // The last version used by the data keys of the key itself, a new
+  // version of the key must be greater than it
+  int32_t last_own_version() {
+    return has_origin() ? last_own_version_ : this->version();
+  }
+
+  // Make the collection read the data keys of origin from now on, the
+  // version must be the version of those data keys
+  void SetOrigin(const std::string& origin, int32_t last_own_version) {
+    DecodeCount();
+    if (this->value_ != nullptr) {
+      std::string origin_value(origin);
+      char buf[sizeof(int32_t) * 2];
+      EncodeFixed32(buf, origin.size());
+      EncodeFixed32(buf + sizeof(int32_t), last_own_version);
+      origin_value.append(buf, sizeof(buf));
+      this->value_->replace(OriginOffset(),
+          UserValueSize(Slice(*this->value_)) - OriginOffset(), origin_value);
+      this->decoded_ &= ~kOriginDecoded;
     }
-    SetVersionToValue();
-    return version_;
+  }
+
+ protected:
+  // The bits of decoded_, the formats use the bits from kExtraDecoded on
+  enum {
+    kCountDecoded = ParsedInternalValue<Format>::kFormatDecoded,
+    kOriginDecoded = ParsedInternalValue<Format>::kFormatDecoded << 1,
+    kExtraDecoded = ParsedInternalValue<Format>::kFormatDecoded << 2
+  };
+
+  // The extra bytes of the format, nullptr if the value is malformed
+  const char* Extra() {
+    Slice encoded = this->Encoded();
+    return encoded.size() >= kMetaValueSuffixLength
+      ? encoded.data() + encoded.size() - kExtraLength : nullptr;
   }
 
  private:
-  int32_t count_;
+  const char* Suffix() {
+    Slice encoded = this->Encoded();
+    return encoded.size() >= kMetaValueSuffixLength
+      ? encoded.data() + encoded.size() - kMetaValueSuffixLength : nullptr;
+  }
+
+  static size_t UserValueSize(const Slice& encoded) {
+    return encoded.size() >= kMetaValueSuffixLength
+      ? encoded.size() - kMetaValueSuffixLength : 0;
+  }
+
+  void DecodeCount() {
+    if (this->decoded_ & kCountDecoded) {
+      return;
+    }
+    this->decoded_ |= kCountDecoded;
+    Slice encoded = this->Encoded();
+    if (encoded.size() < sizeof(CountWord)) {
+      return;
+    }
+    CountWord count = CountCoding::Decode(encoded.data());
+    if (kCappable) {
+      capped_ = (count & kCappedFlag) != 0;
+      bloom_ = (count & kBloomFlag) != 0;
+      count &= ~(kCappedFlag | kBloomFlag);
+    }
+    count_ = static_cast<CountType>(count);
+    cap_ = capped_ ? static_cast<CountType>(
+        CountCoding::Decode(encoded.data() + sizeof(CountWord))) : 0;
+  }
+
+  void SetCountToValue() {
+    if (this->value_ != nullptr) {
+      char* dst = const_cast<char*>(this->value_->data());
+      CountWord count = static_cast<CountWord>(count_);
+      if (capped_) {
+        count |= kCappedFlag;
+      }
+      if (bloom_) {
+        count |= kBloomFlag;
+      }
+      CountCoding::Encode(dst, count);
+    }
+  }
+
+  size_t OriginOffset() {
+    return capped_ ? sizeof(CountWord) * 2 : sizeof(CountWord);
+  }
+
+  void DecodeOrigin() {
+    if (this->decoded_ & kOriginDecoded) {
+      return;
+    }
+    this->decoded_ |= kOriginDecoded;
+    DecodeCount();
+    Slice encoded = this->Encoded();
+    size_t user_value_size = UserValueSize(encoded);
+    has_origin_ = user_value_size >= OriginOffset() + sizeof(int32_t) * 2;
+    if (has_origin_) {
+      const char* end = encoded.data() + user_value_size;
+      last_own_version_ = DecodeFixed32(end - sizeof(int32_t));
+      uint32_t origin_len = DecodeFixed32(end - sizeof(int32_t) * 2);
+      origin_ = Slice(end - sizeof(int32_t) * 2 - origin_len, origin_len);
+    } else {
+      origin_ = Slice();
+    }
+  }
+
+  // Back to the data keys of the key itself
+  void StripOrigin() {
+    this->version_ = last_own_version_;
+    this->decoded_ |= ParsedInternalValue<Format>::kVersionDecoded;
+    if (this->value_ != nullptr) {
+      this->value_->erase(OriginOffset(),
+          UserValueSize(Slice(*this->value_)) - OriginOffset());
+    }
+    has_origin_ = false;
+    origin_ = Slice();
+  }
+
+  CountType count_;
+  bool capped_;
+  bool bloom_;
+  CountType cap_;
+  bool has_origin_;
+  Slice origin_;
+  int32_t last_own_version_;
+};
+
+class BaseMetaValue : public MetaValue<BaseMetaValue, 0> {
+ public:
+  explicit BaseMetaValue(const Slice& user_value) :
+    MetaValue(user_value) {
+  }
+
+  void AppendExtra(char* dst) {
+  }
+};
+
+class ParsedBaseMetaValue
+    : public ParsedMetaValue<ParsedBaseMetaValue, int32_t, 0, true> {
+ public:
+  // Use this constructor after rocksdb::DB::Get();
+  explicit ParsedBaseMetaValue(std::string* internal_value_str) :
+    ParsedMetaValue(internal_value_str) {
+  }
+
+  // Use this constructor in rocksdb::CompactionFilter::Filter();
+  explicit ParsedBaseMetaValue(const Slice& internal_value_slice) :
+    ParsedMetaValue(internal_value_slice) {
+  }
+
+  static const size_t kBaseMetaValueSuffixLength = kMetaValueSuffixLength;
+
+  void DecodeExtra() {
+  }
+
+  void InitialExtra() {
+  }
 };
 
 typedef BaseMetaValue HashesMetaValue;
@@ -7,6 +7,7 @@
 #define SRC_BASE_VALUE_FORMAT_H_
 
 #include <string>
+#include <limits>
 
 #include "src/coding.h"
 #include "rocksdb/env.h"
@@ -14,6 +15,43 @@
 
 namespace blackwidow {
 
+// The expire time ttl seconds from now, saturated to the int32 range
+// instead of wrapping around into the past
+inline int32_t TimestampAfter(int32_t ttl) {
+  int64_t unix_time;
+  rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+  int64_t timestamp = unix_time + ttl;
+  if (timestamp > std::numeric_limits<int32_t>::max()) {
+    return std::numeric_limits<int32_t>::max();
+  } else if (timestamp < std::numeric_limits<int32_t>::min()) {
+    return std::numeric_limits<int32_t>::min();
+  }
+  return static_cast<int32_t>(timestamp);
+}
+
+// The version after version, the current time unless the key got a
+// version of this second already, and never below floor
+inline int32_t VersionAfter(int32_t version, int32_t floor) {
+  int64_t unix_time;
+  rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+  if (version >= static_cast<int32_t>(unix_time)) {
+    version++;
+  } else {
+    version = static_cast<int32_t>(unix_time);
+  }
+  return version < floor ? floor : version;
+}
+
+/*
+ * The value codecs are templates on their concrete Format, which the base
+ * classes reach by static_cast instead of virtual functions, so encoding
+ * and parsing inline into the commands and the compaction filters.
+ *
+ * A Format of InternalValue provides:
+ *   static const size_t kValueSuffixLength;   the bytes behind user_value
+ *   size_t AppendTimestampAndVersion();       writes the value to start_
+ */
+template <typename Format>
 class InternalValue {
  public:
   explicit InternalValue(const Slice& user_value) :
@@ -22,7 +60,7 @@ class InternalValue {
     version_(0),
     timestamp_(0) {
   }
-  virtual ~InternalValue() {
+  ~InternalValue() {
     if (start_ != space_) {
       delete[] start_;
     }
@@ -31,33 +69,36 @@ class InternalValue {
     timestamp_ = timestamp;
   }
   void SetRelativeTimestamp(int32_t ttl) {
-    int64_t unix_time;
-    rocksdb::Env::Default()->GetCurrentTime(&unix_time);
-    timestamp_ = static_cast<int32_t>(unix_time) + ttl;
+    timestamp_ = TimestampAfter(ttl);
   }
   void set_version(int32_t version = 0) {
     version_ = version;
   }
-  static const size_t kDefaultValueSuffixLength = sizeof(int32_t) * 2;
-  virtual const Slice Encode() {
+  const Slice Encode() {
     size_t usize = user_value_.size();
-    size_t needed = usize + kDefaultValueSuffixLength;
+    size_t needed = usize + Format::kValueSuffixLength;
     char* dst;
     if (needed <= sizeof(space_)) {
       dst = space_;
     } else {
       dst = new char[needed];
+    }
 
-      // Need to allocate space, delete previous space
-      if (start_ != space_) {
-        delete[] start_;
-      }
+    // Need to allocate space, delete previous space
+    if (start_ != nullptr && start_ != space_) {
+      delete[] start_;
     }
     start_ = dst;
-    size_t len = AppendTimestampAndVersion();
+    size_t len = static_cast<Format*>(this)->AppendTimestampAndVersion();
     return Slice(start_, len);
   }
-  virtual size_t AppendTimestampAndVersion() = 0;
+
+  // floor is the lowest version the key may take, see
+  // Redis::version_floor()
+  int32_t UpdateVersion(int32_t floor = 0) {
+    version_ = VersionAfter(version_, floor);
+    return version_;
+  }
 
  protected:
   char space_[200];
@@ -67,6 +108,19 @@ class InternalValue {
   int32_t timestamp_;
 };
 
+/*
+ * The parsed values decode a field the first time it is asked for, a
+ * compaction filter that only checks IsStale() reads the timestamp and
+ * nothing else.
+ *
+ * A Format of ParsedInternalValue provides:
+ *   int32_t DecodeVersion();
+ *   int32_t DecodeTimestamp();
+ *   void SetVersionToValue();
+ *   void SetTimestampToValue();
+ *   void StripSuffix();
+ */
+template <typename Format>
 class ParsedInternalValue {
  public:
   // Use this constructor after rocksdb::DB::Get(), since we use this in
@@ -74,6 +128,8 @@ class ParsedInternalValue {
   // original value suffix, so the value_ must point to the string
   explicit ParsedInternalValue(std::string* value) :
     value_(value),
+    encoded_(*value),
+    decoded_(0),
     version_(0),
     timestamp_(0) {
   }
@@ -84,47 +140,50 @@ class ParsedInternalValue {
   // set to nullptr
   explicit ParsedInternalValue(const Slice& value) :
     value_(nullptr),
+    encoded_(value),
+    decoded_(0),
     version_(0),
     timestamp_(0) {
   }
 
-  virtual ~ParsedInternalValue() = default;
-
-  Slice user_value() {
-    return user_value_;
-  }
-
   int32_t version() {
+    if (!(decoded_ & kVersionDecoded)) {
+      version_ = format()->DecodeVersion();
+      decoded_ |= kVersionDecoded;
+    }
     return version_;
   }
 
   void set_version(int32_t version) {
     version_ = version;
-    SetVersionToValue();
+    decoded_ |= kVersionDecoded;
+    format()->SetVersionToValue();
   }
 
   int32_t timestamp() {
+    if (!(decoded_ & kTimestampDecoded)) {
+      timestamp_ = format()->DecodeTimestamp();
+      decoded_ |= kTimestampDecoded;
+    }
     return timestamp_;
   }
 
   void set_timestamp(int32_t timestamp) {
     timestamp_ = timestamp;
-    SetTimestampToValue();
+    decoded_ |= kTimestampDecoded;
+    format()->SetTimestampToValue();
   }
 
   void SetRelativeTimestamp(int32_t ttl) {
-    int64_t unix_time;
-    rocksdb::Env::Default()->GetCurrentTime(&unix_time);
-    timestamp_ = static_cast<int32_t>(unix_time) + ttl;
-    SetTimestampToValue();
+    set_timestamp(TimestampAfter(ttl));
   }
 
   bool IsPermanentSurvival() {
-    return timestamp_ == 0;
+    return timestamp() == 0;
   }
 
   bool IsStale() {
-    if (timestamp_ == 0) {
+    if (timestamp() == 0) {
       return false;
     }
     int64_t unix_time;
@@ -132,13 +191,27 @@ class ParsedInternalValue {
     return timestamp_ < unix_time;
   }
 
-  virtual void StripSuffix() = 0;
-
  protected:
-  virtual void SetVersionToValue() = 0;
-  virtual void SetTimestampToValue() = 0;
+  // The bits of decoded_, the formats use the bits from kFormatDecoded on
+  enum {
+    kVersionDecoded = 1 << 0,
+    kTimestampDecoded = 1 << 1,
+    kFormatDecoded = 1 << 2
+  };
+
+  Format* format() {
+    return static_cast<Format*>(this);
+  }
+
+  // The value the fields are decoded from, the string a command may have
+  // changed since, or the slice of a compaction filter
+  Slice Encoded() {
+    return value_ != nullptr ? Slice(*value_) : encoded_;
+  }
+
   std::string* value_;
-  Slice user_value_;
+  Slice encoded_;
+  uint32_t decoded_;
   int32_t version_;
   int32_t timestamp_;
 };
@@ -3,30 +3,102 @@
 //  LICENSE file in the root directory of this source tree. An additional grant
 //  of patent rights can be found in the PATENTS file in the same directory.
 
+#include <climits>
+#include <thread>
+#include <algorithm>
+
 #include "blackwidow/blackwidow.h"
 #include "blackwidow/util.h"
 
+#include "rocksdb/env.h"
+#include "rocksdb/persistent_cache.h"
+#include "rocksdb/statistics.h"
+
 #include "src/mutex_impl.h"
 #include "src/redis_strings.h"
 #include "src/redis_hashes.h"
 #include "src/redis_sets.h"
 #include "src/redis_lists.h"
 #include "src/redis_zsets.h"
+#include "src/redis_streams.h"
 #include "src/redis_hyperloglog.h"
+#include "src/geohash.h"
 #include "src/lru_cache.h"
+#include "src/key_detector.h"
+#include "src/counter_buffer.h"
+#include "src/access_clock.h"
+#include "src/dump_format.h"
+#include "src/slot_key_format.h"
 
 namespace blackwidow {
 
+BlackWidow::Dataset::Dataset()
+    : strings_db(nullptr),
+      hashes_db(nullptr),
+      sets_db(nullptr),
+      zsets_db(nullptr),
+      lists_db(nullptr),
+      streams_db(nullptr) {
+}
+
+BlackWidow::Dataset::~Dataset() {
+  delete strings_db;
+  delete hashes_db;
+  delete sets_db;
+  delete lists_db;
+  delete zsets_db;
+  delete streams_db;
+}
+
+std::vector<Redis*> BlackWidow::Dataset::dbs() const {
+  return {strings_db, hashes_db, sets_db, lists_db, zsets_db, streams_db};
+}
+
 BlackWidow::BlackWidow() :
-  strings_db_(nullptr),
-  hashes_db_(nullptr),
-  sets_db_(nullptr),
-  zsets_db_(nullptr),
-  lists_db_(nullptr),
+  strings_db_(this, &Dataset::strings_db),
+  hashes_db_(this, &Dataset::hashes_db),
+  sets_db_(this, &Dataset::sets_db),
+  zsets_db_(this, &Dataset::zsets_db),
+  lists_db_(this, &Dataset::lists_db),
+  streams_db_(this, &Dataset::streams_db),
   is_opened_(false),
+  open_mode_(kOpenReadWrite),
+  max_dump_size_(0),
+  write_pressure_ratio_(0),
+  slot_tagged_keys_(false),
+  databases_(1),
+  mem_env_(nullptr),
   bg_tasks_cond_var_(&bg_tasks_mutex_),
   current_task_type_(kNone),
   bg_tasks_should_exit_(false),
+  catch_up_thread_started_(false),
+  catch_up_interval_ms_(0),
+  catch_up_cond_var_(&catch_up_mutex_),
+  catch_up_should_exit_(false),
+  key_detector_(nullptr),
+  key_detector_thread_started_(false),
+  key_detector_interval_ms_(0),
+  big_key_threshold_(0),
+  key_detector_cond_var_(&key_detector_mutex_),
+  key_detector_should_exit_(false),
+  counter_buffer_(nullptr),
+  counter_buffer_thread_started_(false),
+  counter_flush_interval_ms_(0),
+  buffer_hot_counters_(false),
+  counter_buffer_cond_var_(&counter_buffer_mutex_),
+  counter_buffer_should_exit_(false),
+  access_clock_(nullptr),
+  eviction_thread_started_(false),
+  eviction_interval_ms_(0),
+  max_data_size_(0),
+  eviction_policy_(kEvictLRU),
+  eviction_samples_(0),
+  eviction_cond_var_(&eviction_mutex_),
+  eviction_should_exit_(false),
+  data_size_(0),
+  evicted_keys_(0),
+  evicted_bytes_(0),
+  eviction_rounds_(0),
   scan_keynum_exit_(false) {
   cursors_store_ = new LRUCache<std::string, std::string>();
   cursors_store_->SetCapacity(5000);
@@ -43,25 +115,72 @@ BlackWidow::~BlackWidow() {
   bg_tasks_should_exit_ = true;
   bg_tasks_cond_var_.Signal();
 
+  int ret = 0;
+  if (counter_buffer_thread_started_) {
+    counter_buffer_mutex_.Lock();
+    counter_buffer_should_exit_ = true;
+    counter_buffer_cond_var_.Signal();
+    counter_buffer_mutex_.Unlock();
+    if ((ret = pthread_join(counter_buffer_thread_id_, NULL)) != 0) {
+      fprintf(stderr, "pthread_join failed with counter buffer thread error %d\n", ret);
+    }
+  }
+  if (counter_buffer_ != nullptr) {
+    counter_buffer_->FlushAll();
+  }
+
+  if (eviction_thread_started_) {
+    eviction_mutex_.Lock();
+    eviction_should_exit_ = true;
+    eviction_cond_var_.Signal();
+    eviction_mutex_.Unlock();
+    if ((ret = pthread_join(eviction_thread_id_, NULL)) != 0) {
+      fprintf(stderr, "pthread_join failed with eviction thread error %d\n", ret);
+    }
+  }
+
   if (is_opened_) {
     rocksdb::CancelAllBackgroundWork(strings_db_->GetDB(), true);
     rocksdb::CancelAllBackgroundWork(hashes_db_->GetDB(), true);
     rocksdb::CancelAllBackgroundWork(sets_db_->GetDB(), true);
     rocksdb::CancelAllBackgroundWork(lists_db_->GetDB(), true);
     rocksdb::CancelAllBackgroundWork(zsets_db_->GetDB(), true);
+    rocksdb::CancelAllBackgroundWork(streams_db_->GetDB(), true);
   }
 
-  int ret = 0;
   if ((ret = pthread_join(bg_tasks_thread_id_, NULL)) != 0) {
     fprintf(stderr, "pthread_join failed with bgtask thread error %d\n", ret);
   }
 
-  delete strings_db_;
-  delete hashes_db_;
-  delete sets_db_;
-  delete lists_db_;
-  delete zsets_db_;
+  if (catch_up_thread_started_) {
+    catch_up_mutex_.Lock();
+    catch_up_should_exit_ = true;
+    catch_up_cond_var_.Signal();
+    catch_up_mutex_.Unlock();
+    if ((ret = pthread_join(catch_up_thread_id_, NULL)) != 0) {
+      fprintf(stderr, "pthread_join failed with catch up thread error %d\n", ret);
+    }
+  }
+
+  if (key_detector_thread_started_) {
+    key_detector_mutex_.Lock();
+    key_detector_should_exit_ = true;
+    key_detector_cond_var_.Signal();
+    key_detector_mutex_.Unlock();
+    if ((ret = pthread_join(key_detector_thread_id_, NULL)) != 0) {
+      fprintf(stderr, "pthread_join failed with key detector thread error %d\n", ret);
+    }
+  }
+
+  dataset_.reset();
   delete cursors_store_;
+  delete key_detector_;
+  delete access_clock_;
+  delete counter_buffer_;
+  delete mem_env_;
+  if (databases_ > 1) {
+    pthread_key_delete(selected_db_key_);
+  }
 }
 
 static std::string AppendSubDirectory(const std::string& db_path,
@@ -73,11 +192,75 @@ static std::string AppendSubDirectory(const std::string& db_path,
   }
 }
 
-Status BlackWidow::Open(const BlackwidowOptions& bw_options,
+Status BlackWidow::Open(const BlackwidowOptions& options,
                         const std::string& db_path) {
-  mkpath(db_path.c_str(), 0755);
+  BlackwidowOptions bw_options(options);
+  if (bw_options.databases == 0 || bw_options.databases > kMaxDatabases) {
+    return Status::InvalidArgument("databases is out of range");
+  } else if (bw_options.databases > 1 && bw_options.slot_tagged_keys) {
+    return Status::InvalidArgument(
+        "slot_tagged_keys only supports one database");
+  }
+  if (bw_options.storage_backend == kMemoryBackend) {
+    if (bw_options.open_mode != kOpenReadWrite) {
+      return Status::InvalidArgument(
+          "memory backend can only be opened read-write");
+    }
+    mem_env_ = rocksdb::NewMemEnv(rocksdb::Env::Default());
+    bw_options.options.env = mem_env_;
+    bw_options.options.create_if_missing = true;
+    // ttl_cf drops the expired strings with their table files, there
+    // are none in memory, the strings filter expires them instead
+    bw_options.strings_ttl_cf = false;
+  } else if (bw_options.open_mode == kOpenSecondary) {
+    if (bw_options.secondary_path.empty()) {
+      return Status::InvalidArgument("secondary_path is empty");
+    }
+    mkpath(bw_options.secondary_path.c_str(), 0755);
+  }
+  if (bw_options.storage_backend == kRocksDBBackend
+    && bw_options.open_mode == kOpenReadWrite) {
+    mkpath(db_path.c_str(), 0755);
+  }
+  if (!bw_options.secondary_cache_path.empty()) {
+    if (bw_options.storage_backend == kMemoryBackend) {
+      return Status::InvalidArgument(
+          "memory backend can not have a secondary cache");
+    }
+    mkpath(bw_options.secondary_cache_path.c_str(), 0755);
+    Status s = rocksdb::NewPersistentCache(rocksdb::Env::Default(),
+        bw_options.secondary_cache_path, bw_options.secondary_cache_size,
+        bw_options.options.info_log, false,
+        &bw_options.table_options.persistent_cache);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  open_mode_ = bw_options.open_mode;
+  if (open_mode_ == kOpenServing) {
+    serving_options_ = bw_options;
+  }
+  max_dump_size_ = bw_options.max_dump_size;
+  write_pressure_ratio_ = bw_options.write_pressure_ratio;
+  slot_tagged_keys_ = bw_options.slot_tagged_keys;
+  if (bw_options.databases > 1) {
+    int ret = pthread_key_create(&selected_db_key_, NULL);
+    if (ret != 0) {
+      char msg[128];
+      snprintf(msg, sizeof(msg), "pthread key create: %s", strerror(ret));
+      return Status::Corruption(msg);
+    }
+    databases_ = bw_options.databases;
+  }
+  key_detector_ = new KeyDetector(bw_options.hot_key_sample_rate,
+                                  bw_options.key_detector_top_k);
+  if (open_mode_ == kOpenReadWrite && bw_options.max_data_size > 0) {
+    access_clock_ = new AccessClock(bw_options.access_clock_slots);
+    key_detector_->SetAccessClock(access_clock_);
+  }
 
-  strings_db_ = new RedisStrings(this, kStrings);
+  dataset_ = std::make_shared<Dataset>();
+  dataset_->strings_db = new RedisStrings(this, kStrings);
   Status s = strings_db_->Open(
       bw_options, AppendSubDirectory(db_path, "strings"));
   if (!s.ok()) {
@@ -86,7 +269,7 @@ Status BlackWidow::Open(const BlackwidowOptions& bw_options,
     exit(-1);
   }
 
-  hashes_db_ = new RedisHashes(this, kHashes);
+  dataset_->hashes_db = new RedisHashes(this, kHashes);
   s = hashes_db_->Open(bw_options, AppendSubDirectory(db_path, "hashes"));
   if (!s.ok()) {
     fprintf(stderr,
@@ -94,7 +277,7 @@ Status BlackWidow::Open(const BlackwidowOptions& bw_options,
     exit(-1);
   }
 
-  sets_db_ = new RedisSets(this, kSets);
+  dataset_->sets_db = new RedisSets(this, kSets);
   s = sets_db_->Open(bw_options, AppendSubDirectory(db_path, "sets"));
   if (!s.ok()) {
     fprintf(stderr,
@@ -102,7 +285,7 @@ Status BlackWidow::Open(const BlackwidowOptions& bw_options,
     exit(-1);
   }
 
-  lists_db_ = new RedisLists(this, kLists);
+  dataset_->lists_db = new RedisLists(this, kLists);
   s = lists_db_->Open(bw_options, AppendSubDirectory(db_path, "lists"));
   if (!s.ok()) {
     fprintf(stderr,
@@ -110,231 +293,521 @@ Status BlackWidow::Open(const BlackwidowOptions& bw_options,
     exit(-1);
   }
 
-  zsets_db_ = new RedisZSets(this, kZSets);
+  dataset_->zsets_db = new RedisZSets(this, kZSets);
   s = zsets_db_->Open(bw_options, AppendSubDirectory(db_path, "zsets"));
   if (!s.ok()) {
     fprintf(stderr,
         "[FATAL] open zset db failed, %s\n", s.ToString().c_str());
     exit(-1);
   }
+
+  dataset_->streams_db = new RedisStreams(this, kStreams);
+  s = streams_db_->Open(bw_options, AppendSubDirectory(db_path, "streams"));
+  if (!s.ok()) {
+    fprintf(stderr,
+        "[FATAL] open stream db failed, %s\n", s.ToString().c_str());
+    exit(-1);
+  }
   is_opened_.store(true);
+
+  if (open_mode_ == kOpenSecondary && bw_options.catch_up_interval_ms > 0) {
+    catch_up_interval_ms_ = bw_options.catch_up_interval_ms;
+    s = StartCatchUpThread();
+    if (!s.ok()) {
+      fprintf(stderr,
+          "[FATAL] start catch up thread failed, %s\n", s.ToString().c_str());
+      exit(-1);
+    }
+  }
+
+  if ((bw_options.hot_key_sample_rate > 0 || bw_options.big_key_threshold > 0)
+    && bw_options.key_detector_interval_ms > 0) {
+    key_detector_interval_ms_ = bw_options.key_detector_interval_ms;
+    big_key_threshold_ = bw_options.big_key_threshold;
+    s = StartKeyDetectorThread();
+    if (!s.ok()) {
+      fprintf(stderr,
+          "[FATAL] start key detector thread failed, %s\n", s.ToString().c_str());
+      exit(-1);
+    }
+  }
+
+  if (open_mode_ == kOpenReadWrite && bw_options.counter_flush_interval_ms > 0) {
+    counter_flush_interval_ms_ = bw_options.counter_flush_interval_ms;
+    buffer_hot_counters_ = bw_options.buffer_hot_counters;
+    counter_buffer_ = new CounterBuffer(dataset_->strings_db,
+                                        dataset_->hashes_db,
+                                        dataset_->zsets_db);
+    s = StartCounterBufferThread();
+    if (!s.ok()) {
+      fprintf(stderr,
+          "[FATAL] start counter buffer thread failed, %s\n", s.ToString().c_str());
+      exit(-1);
+    }
+  }
+
+  if (access_clock_ != nullptr && bw_options.eviction_interval_ms > 0) {
+    eviction_interval_ms_ = bw_options.eviction_interval_ms;
+    max_data_size_ = bw_options.max_data_size;
+    eviction_policy_ = bw_options.eviction_policy;
+    eviction_samples_ = std::max(bw_options.eviction_samples, 1U);
+    s = StartEvictionThread();
+    if (!s.ok()) {
+      fprintf(stderr,
+          "[FATAL] start eviction thread failed, %s\n", s.ToString().c_str());
+      exit(-1);
+    }
+  }
   return Status::OK();
 }
 
-Status BlackWidow::GetStartKey(const DataType& dtype, int64_t cursor, std::string* start_key) {
+// The same cursor of different databases leads to different keys
+static std::string CursorIndexKey(const DataType& dtype, int64_t cursor,
+                                  uint32_t db) {
   std::string index_key = DataTypeTag[dtype] + std::to_string(cursor);
+  if (db != 0) {
+    index_key.append("@" + std::to_string(db));
+  }
+  return index_key;
+}
+
+Status BlackWidow::GetStartKey(const DataType& dtype, int64_t cursor, std::string* start_key) {
+  std::string index_key = CursorIndexKey(dtype, cursor, SelectedDB());
   return cursors_store_->Lookup(index_key, start_key);
 }
 
 Status BlackWidow::StoreCursorStartKey(const DataType& dtype, int64_t cursor,
                                        const std::string& next_key) {
-  std::string index_key = DataTypeTag[dtype] + std::to_string(cursor);
+  std::string index_key = CursorIndexKey(dtype, cursor, SelectedDB());
   return cursors_store_->Insert(index_key, next_key);
 }
 
+bool BlackWidow::IsKeyTagged() const {
+  return slot_tagged_keys_ || databases_ > 1;
+}
+
+SlotTaggedKey BlackWidow::TagKey(const Slice& key) const {
+  if (databases_ > 1) {
+    return SlotTaggedKey(SelectedDB(), key);
+  }
+  return SlotTaggedKey(slot_tagged_keys_, key);
+}
+
+const std::vector<std::string>& BlackWidow::TagKeys(
+    const std::vector<std::string>& keys,
+    std::vector<std::string>* tagged_keys) const {
+  if (!IsKeyTagged()) {
+    return keys;
+  }
+  for (const auto& key : keys) {
+    tagged_keys->push_back(TagKey(key).ToString());
+  }
+  return *tagged_keys;
+}
+
+const std::vector<KeyValue>& BlackWidow::TagKeys(
+    const std::vector<KeyValue>& kvs,
+    std::vector<KeyValue>* tagged_kvs) const {
+  if (!IsKeyTagged()) {
+    return kvs;
+  }
+  for (const auto& kv : kvs) {
+    tagged_kvs->push_back({TagKey(kv.key).ToString(), kv.value});
+  }
+  return *tagged_kvs;
+}
+
+// The glob '?' matches any byte, the pattern skips the slot tag. The
+// database tag is matched as it is, a tail wildcard pattern becomes a
+// prefix of the database and the scan seeks right to it
+std::string BlackWidow::TagPattern(const std::string& pattern) const {
+  if (databases_ > 1) {
+    return DBStartKey(SelectedDB()) + pattern;
+  }
+  return slot_tagged_keys_ ? "??" + pattern : pattern;
+}
+
+void BlackWidow::FlushBufferedCounter(const DataType& type, const Slice& key) {
+  if (counter_buffer_ != nullptr) {
+    counter_buffer_->Flush(type, key);
+  }
+}
+
+void BlackWidow::FlushBufferedCounters(const DataType& type,
+                                       const std::vector<std::string>& keys) {
+  if (counter_buffer_ != nullptr) {
+    for (const auto& key : keys) {
+      counter_buffer_->Flush(type, key);
+    }
+  }
+}
+
 // Strings Commands
 Status BlackWidow::Set(const Slice& key,
                        const Slice& value) {
-  return strings_db_->Set(key, value);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  return strings_db_->Set(tagged_key, value);
 }
 
 Status BlackWidow::Setxx(const Slice& key,
                          const Slice& value,
                          int32_t* ret,
                          const int32_t ttl) {
-  return strings_db_->Setxx(key, value, ret, ttl);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  return strings_db_->Setxx(tagged_key, value, ret, ttl);
 }
 
 Status BlackWidow::Get(const Slice& key, std::string* value) {
-  return strings_db_->Get(key, value);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  if (counter_buffer_ != nullptr && counter_buffer_->Get(tagged_key, value)) {
+    return Status::OK();
+  }
+  return strings_db_->Get(tagged_key, value);
 }
 
 Status BlackWidow::GetSet(const Slice& key, const Slice& value,
                           std::string* old_value) {
-  return strings_db_->GetSet(key, value, old_value);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  return strings_db_->GetSet(tagged_key, value, old_value);
 }
 
 Status BlackWidow::SetBit(const Slice& key, int64_t offset,
                           int32_t value, int32_t* ret) {
-  return strings_db_->SetBit(key, offset, value, ret);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  return strings_db_->SetBit(tagged_key, offset, value, ret);
 }
 
 Status BlackWidow::GetBit(const Slice& key, int64_t offset, int32_t* ret) {
-  return strings_db_->GetBit(key, offset, ret);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kStrings, tagged_key);
+  return strings_db_->GetBit(tagged_key, offset, ret);
 }
 
 Status BlackWidow::MSet(const std::vector<KeyValue>& kvs) {
-  return strings_db_->MSet(kvs);
+  std::vector<KeyValue> tagged_kvs;
+  const std::vector<KeyValue>& store_kvs = TagKeys(kvs, &tagged_kvs);
+  std::vector<std::string> store_keys;
+  for (const auto& kv : store_kvs) {
+    store_keys.push_back(kv.key);
+  }
+  ScopeCounterWrite cw(counter_buffer_, kStrings, store_keys);
+  return strings_db_->MSet(store_kvs);
 }
 
 Status BlackWidow::MGet(const std::vector<std::string>& keys,
                         std::vector<ValueStatus>* vss) {
-  return strings_db_->MGet(keys, vss);
+  std::vector<std::string> tagged_keys;
+  const std::vector<std::string>& store_keys = TagKeys(keys, &tagged_keys);
+  FlushBufferedCounters(kStrings, store_keys);
+  return strings_db_->MGet(store_keys, vss);
 }
 
 Status BlackWidow::Setnx(const Slice& key, const Slice& value,
                          int32_t* ret, const int32_t ttl) {
-  return strings_db_->Setnx(key, value, ret, ttl);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  return strings_db_->Setnx(tagged_key, value, ret, ttl);
 }
 
 Status BlackWidow::MSetnx(const std::vector<KeyValue>& kvs,
                           int32_t* ret) {
-  return strings_db_->MSetnx(kvs, ret);
+  std::vector<KeyValue> tagged_kvs;
+  const std::vector<KeyValue>& store_kvs = TagKeys(kvs, &tagged_kvs);
+  std::vector<std::string> store_keys;
+  for (const auto& kv : store_kvs) {
+    store_keys.push_back(kv.key);
+  }
+  ScopeCounterWrite cw(counter_buffer_, kStrings, store_keys);
+  return strings_db_->MSetnx(store_kvs, ret);
 }
 
 Status BlackWidow::Setvx(const Slice& key, const Slice& value,
                          const Slice& new_value, int32_t* ret,
                          const int32_t ttl) {
-  return strings_db_->Setvx(key, value, new_value, ret, ttl);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  return strings_db_->Setvx(tagged_key, value, new_value, ret, ttl);
 }
 
 Status BlackWidow::Delvx(const Slice& key, const Slice& value, int32_t* ret) {
-  return strings_db_->Delvx(key, value, ret);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  return strings_db_->Delvx(tagged_key, value, ret);
 }
 
 Status BlackWidow::Setrange(const Slice& key, int64_t start_offset,
                             const Slice& value, int32_t* ret) {
-  return strings_db_->Setrange(key, start_offset, value, ret);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  return strings_db_->Setrange(tagged_key, start_offset, value, ret);
 }
 
 Status BlackWidow::Getrange(const Slice& key, int64_t start_offset,
                             int64_t end_offset, std::string* ret) {
-  return strings_db_->Getrange(key, start_offset, end_offset, ret);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kStrings, tagged_key);
+  return strings_db_->Getrange(tagged_key, start_offset, end_offset, ret);
 }
 
 Status BlackWidow::Append(const Slice& key, const Slice& value, int32_t* ret) {
-  return strings_db_->Append(key, value, ret);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  return strings_db_->Append(tagged_key, value, ret);
 }
 
 Status BlackWidow::BitCount(const Slice& key, int64_t start_offset,
                             int64_t end_offset, int32_t *ret, bool have_range) {
-  return strings_db_->BitCount(key, start_offset, end_offset, ret, have_range);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kStrings, tagged_key);
+  return strings_db_->BitCount(tagged_key, start_offset, end_offset,
+                               ret, have_range);
 }
 
 Status BlackWidow::BitOp(BitOpType op, const std::string& dest_key,
                          const std::vector<std::string>& src_keys,
                          int64_t* ret) {
-  return strings_db_->BitOp(op, dest_key, src_keys, ret);
+  SlotTaggedKey tagged_dest_key = TagKey(dest_key);
+  ScopeCounterWrite dest_cw(counter_buffer_, kStrings, tagged_dest_key);
+  std::vector<std::string> tagged_keys;
+  const std::vector<std::string>& store_keys = TagKeys(src_keys,
+                                                       &tagged_keys);
+  FlushBufferedCounters(kStrings, store_keys);
+  return strings_db_->BitOp(op, tagged_dest_key.ToString(),
+                            store_keys, ret);
 }
 
 Status BlackWidow::BitPos(const Slice& key, int32_t bit,
                           int64_t* ret) {
-  return strings_db_->BitPos(key, bit, ret);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kStrings, tagged_key);
+  return strings_db_->BitPos(tagged_key, bit, ret);
 }
 
 Status BlackWidow::BitPos(const Slice& key, int32_t bit,
                           int64_t start_offset, int64_t* ret) {
-  return strings_db_->BitPos(key, bit, start_offset, ret);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kStrings, tagged_key);
+  return strings_db_->BitPos(tagged_key, bit, start_offset, ret);
 }
 
 Status BlackWidow::BitPos(const Slice& key, int32_t bit,
                           int64_t start_offset, int64_t end_offset,
                           int64_t* ret) {
-  return strings_db_->BitPos(key, bit, start_offset, end_offset, ret);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kStrings, tagged_key);
+  return strings_db_->BitPos(tagged_key, bit, start_offset, end_offset, ret);
+}
+
+Status BlackWidow::BitField(const Slice& key,
+                            const std::vector<BitFieldOp>& ops,
+                            std::vector<BitFieldValue>* rets) {
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  return strings_db_->BitField(tagged_key, ops, rets);
 }
 
 Status BlackWidow::Decrby(const Slice& key, int64_t value, int64_t* ret) {
-  return strings_db_->Decrby(key, value, ret);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  if (counter_buffer_ != nullptr && value != LLONG_MIN
+    && counter_buffer_->Incrby(tagged_key, -value, ret)) {
+    return Status::OK();
+  }
+  // Not buffered, no counter of key is loaded during the write
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  return strings_db_->Decrby(tagged_key, value, ret);
 }
 
 Status BlackWidow::Incrby(const Slice& key, int64_t value, int64_t* ret) {
-  return strings_db_->Incrby(key, value, ret);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  if (counter_buffer_ != nullptr
+    && counter_buffer_->Incrby(tagged_key, value, ret)) {
+    return Status::OK();
+  }
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  return strings_db_->Incrby(tagged_key, value, ret);
 }
 
 Status BlackWidow::Incrbyfloat(const Slice& key, const Slice& value,
                                std::string* ret) {
-  return strings_db_->Incrbyfloat(key, value, ret);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  return strings_db_->Incrbyfloat(tagged_key, value, ret);
 }
 
 Status BlackWidow::Setex(const Slice& key, const Slice& value, int32_t ttl) {
-  return strings_db_->Setex(key, value, ttl);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  return strings_db_->Setex(tagged_key, value, ttl);
 }
 
 Status BlackWidow::Strlen(const Slice& key, int32_t* len) {
-  return strings_db_->Strlen(key, len);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kStrings, tagged_key);
+  return strings_db_->Strlen(tagged_key, len);
 }
 
 Status BlackWidow::PKSetexAt(const Slice& key,
                              const Slice& value,
                              int32_t timestamp) {
-  return strings_db_->PKSetexAt(key, value, timestamp);
+  key_detector_->RecordAccess(kStrings, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  return strings_db_->PKSetexAt(tagged_key, value, timestamp);
 }
 
 // Hashes Commands
 Status BlackWidow::HSet(const Slice& key, const Slice& field,
     const Slice& value, int32_t* res) {
-  return hashes_db_->HSet(key, field, value, res);
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kHashes, tagged_key);
+  return hashes_db_->HSet(tagged_key, field, value, res);
 }
 
 Status BlackWidow::HGet(const Slice& key, const Slice& field,
     std::string* value) {
-  return hashes_db_->HGet(key, field, value);
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  if (counter_buffer_ != nullptr
+    && counter_buffer_->HGet(tagged_key, field, value)) {
+    return Status::OK();
+  }
+  return hashes_db_->HGet(tagged_key, field, value);
 }
 
 Status BlackWidow::HMSet(const Slice& key,
                          const std::vector<FieldValue>& fvs) {
-  return hashes_db_->HMSet(key, fvs);
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kHashes, tagged_key);
+  return hashes_db_->HMSet(tagged_key, fvs);
 }
 
 Status BlackWidow::HMGet(const Slice& key,
                          const std::vector<std::string>& fields,
                          std::vector<ValueStatus>* vss) {
-  return hashes_db_->HMGet(key, fields, vss);
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kHashes, tagged_key);
+  return hashes_db_->HMGet(tagged_key, fields, vss);
 }
 
 Status BlackWidow::HGetall(const Slice& key,
                            std::vector<FieldValue>* fvs) {
-  return hashes_db_->HGetall(key, fvs);
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kHashes, tagged_key);
+  return hashes_db_->HGetall(tagged_key, fvs);
 }
 
 Status BlackWidow::HKeys(const Slice& key,
                          std::vector<std::string>* fields) {
-  return hashes_db_->HKeys(key, fields);
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kHashes, tagged_key);
+  return hashes_db_->HKeys(tagged_key, fields);
 }
 
 Status BlackWidow::HVals(const Slice& key,
                          std::vector<std::string>* values) {
-  return hashes_db_->HVals(key, values);
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kHashes, tagged_key);
+  return hashes_db_->HVals(tagged_key, values);
 }
 
 Status BlackWidow::HSetnx(const Slice& key, const Slice& field,
                           const Slice& value, int32_t* ret) {
-  return hashes_db_->HSetnx(key, field, value, ret);
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kHashes, tagged_key);
+  return hashes_db_->HSetnx(tagged_key, field, value, ret);
 }
 
 Status BlackWidow::HLen(const Slice& key, int32_t* ret) {
-  return hashes_db_->HLen(key, ret);
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kHashes, tagged_key);
+  return hashes_db_->HLen(tagged_key, ret);
 }
 
 Status BlackWidow::HStrlen(const Slice& key, const Slice& field, int32_t* len) {
-  return hashes_db_->HStrlen(key, field, len);
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kHashes, tagged_key);
+  return hashes_db_->HStrlen(tagged_key, field, len);
 }
 
 Status BlackWidow::HExists(const Slice& key, const Slice& field) {
-  return hashes_db_->HExists(key, field);
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kHashes, tagged_key);
+  return hashes_db_->HExists(tagged_key, field);
 }
 
 Status BlackWidow::HIncrby(const Slice& key, const Slice& field, int64_t value,
                            int64_t* ret) {
-  return hashes_db_->HIncrby(key, field, value, ret);
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  if (counter_buffer_ != nullptr
+    && counter_buffer_->HIncrby(tagged_key, field, value, ret)) {
+    return Status::OK();
+  }
+  ScopeCounterWrite cw(counter_buffer_, kHashes, tagged_key);
+  return hashes_db_->HIncrby(tagged_key, field, value, ret);
 }
 
 Status BlackWidow::HIncrbyfloat(const Slice& key, const Slice& field,
                                 const Slice& by, std::string* new_value) {
-  return hashes_db_->HIncrbyfloat(key, field, by, new_value);
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kHashes, tagged_key);
+  return hashes_db_->HIncrbyfloat(tagged_key, field, by, new_value);
 }
 
 Status BlackWidow::HDel(const Slice& key,
                         const std::vector<std::string>& fields,
                         int32_t* ret) {
-  return hashes_db_->HDel(key, fields, ret);
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kHashes, tagged_key);
+  return hashes_db_->HDel(tagged_key, fields, ret);
 }
 
 Status BlackWidow::HScan(const Slice& key, int64_t cursor,
                          const std::string& pattern, int64_t count,
                          std::vector<FieldValue>* field_values,
                          int64_t* next_cursor) {
-  return hashes_db_->HScan(key, cursor,
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kHashes, tagged_key);
+  return hashes_db_->HScan(tagged_key, cursor,
       pattern, count, field_values, next_cursor);
 }
 
@@ -342,7 +815,10 @@ Status BlackWidow::HScanx(const Slice& key, const std::string start_field,
                           const std::string& pattern, int64_t count,
                           std::vector<FieldValue>* field_values,
                           std::string* next_field) {
-  return hashes_db_->HScanx(key, start_field,
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kHashes, tagged_key);
+  return hashes_db_->HScanx(tagged_key, start_field,
       pattern, count, field_values, next_field);
 }
 
@@ -351,7 +827,10 @@ Status BlackWidow::PKHScanRange(const Slice& key, const Slice& field_start,
                                 const Slice& pattern, int32_t limit,
                                 std::vector<FieldValue>* field_values,
                                 std::string* next_field) {
-  return hashes_db_->PKHScanRange(key, field_start,
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kHashes, tagged_key);
+  return hashes_db_->PKHScanRange(tagged_key, field_start,
       field_end, pattern, limit, field_values, next_field);
 }
 
@@ -360,7 +839,10 @@ Status BlackWidow::PKHRScanRange(const Slice& key, const Slice& field_start,
                                  const Slice& pattern, int32_t limit,
                                  std::vector<FieldValue>* field_values,
                                  std::string* next_field) {
-  return hashes_db_->PKHRScanRange(key, field_start,
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kHashes, tagged_key);
+  return hashes_db_->PKHRScanRange(tagged_key, field_start,
       field_end, pattern, limit, field_values, next_field);
 }
 
@@ -368,54 +850,66 @@ Status BlackWidow::PKHRScanRange(const Slice& key, const Slice& field_start,
 Status BlackWidow::SAdd(const Slice& key,
                         const std::vector<std::string>& members,
                         int32_t* ret) {
-  return sets_db_->SAdd(key, members, ret);
+  key_detector_->RecordAccess(kSets, key);
+  return sets_db_->SAdd(TagKey(key), members, ret);
 }
 
 Status BlackWidow::SCard(const Slice& key,
                          int32_t* ret) {
-  return sets_db_->SCard(key, ret);
+  key_detector_->RecordAccess(kSets, key);
+  return sets_db_->SCard(TagKey(key), ret);
 }
 
 Status BlackWidow::SDiff(const std::vector<std::string>& keys,
                          std::vector<std::string>* members) {
-  return sets_db_->SDiff(keys, members);
+  std::vector<std::string> tagged_keys;
+  return sets_db_->SDiff(TagKeys(keys, &tagged_keys), members);
 }
 
 Status BlackWidow::SDiffstore(const Slice& destination,
                               const std::vector<std::string>& keys,
                               int32_t* ret) {
-  return sets_db_->SDiffstore(destination, keys, ret);
+  std::vector<std::string> tagged_keys;
+  return sets_db_->SDiffstore(TagKey(destination),
+                              TagKeys(keys, &tagged_keys), ret);
 }
 
 Status BlackWidow::SInter(const std::vector<std::string>& keys,
                           std::vector<std::string>* members) {
-  return sets_db_->SInter(keys, members);
+  std::vector<std::string> tagged_keys;
+  return sets_db_->SInter(TagKeys(keys, &tagged_keys), members);
 }
 
 Status BlackWidow::SInterstore(const Slice& destination,
                                const std::vector<std::string>& keys,
                                int32_t* ret) {
-  return sets_db_->SInterstore(destination, keys, ret);
+  std::vector<std::string> tagged_keys;
+  return sets_db_->SInterstore(TagKey(destination),
+                               TagKeys(keys, &tagged_keys), ret);
 }
 
 Status BlackWidow::SIsmember(const Slice& key, const Slice& member,
                              int32_t* ret) {
-  return sets_db_->SIsmember(key, member, ret);
+  key_detector_->RecordAccess(kSets, key);
+  return sets_db_->SIsmember(TagKey(key), member, ret);
 }
 
 Status BlackWidow::SMembers(const Slice& key,
                             std::vector<std::string>* members) {
-  return sets_db_->SMembers(key, members);
+  key_detector_->RecordAccess(kSets, key);
+  return sets_db_->SMembers(TagKey(key), members);
 }
 
 Status BlackWidow::SMove(const Slice& source, const Slice& destination,
                          const Slice& member, int32_t* ret) {
-  return sets_db_->SMove(source, destination, member, ret);
+  key_detector_->RecordAccess(kSets, source);
+  return sets_db_->SMove(TagKey(source), TagKey(destination), member, ret);
 }
 
 Status BlackWidow::SPop(const Slice& key, std::string* member) {
+  key_detector_->RecordAccess(kSets, key);
   bool need_compact = false;
-  Status status = sets_db_->SPop(key, member, &need_compact);
+  Status status = sets_db_->SPop(TagKey(key), member, &need_compact);
   if (need_compact) {
     AddBGTask({kSets, kCompactKey, key.ToString()});
   }
@@ -424,70 +918,85 @@ Status BlackWidow::SPop(const Slice& key, std::string* member) {
 
 Status BlackWidow::SRandmember(const Slice& key, int32_t count,
                                std::vector<std::string>* members) {
-  return sets_db_->SRandmember(key, count, members);
+  key_detector_->RecordAccess(kSets, key);
+  return sets_db_->SRandmember(TagKey(key), count, members);
 }
 
 Status BlackWidow::SRem(const Slice& key,
                         const std::vector<std::string>& members,
                         int32_t* ret) {
-  return sets_db_->SRem(key, members, ret);
+  key_detector_->RecordAccess(kSets, key);
+  return sets_db_->SRem(TagKey(key), members, ret);
 }
 
 Status BlackWidow::SUnion(const std::vector<std::string>& keys,
                           std::vector<std::string>* members) {
-  return sets_db_->SUnion(keys, members);
+  std::vector<std::string> tagged_keys;
+  return sets_db_->SUnion(TagKeys(keys, &tagged_keys), members);
 }
 
 Status BlackWidow::SUnionstore(const Slice& destination,
                                const std::vector<std::string>& keys,
                                int32_t* ret) {
-  return sets_db_->SUnionstore(destination, keys, ret);
+  std::vector<std::string> tagged_keys;
+  return sets_db_->SUnionstore(TagKey(destination),
+                               TagKeys(keys, &tagged_keys), ret);
 }
 
 Status BlackWidow::SScan(const Slice& key, int64_t cursor,
                          const std::string& pattern, int64_t count,
                          std::vector<std::string>* members,
                          int64_t* next_cursor) {
-  return sets_db_->SScan(key, cursor, pattern, count, members, next_cursor);
+  key_detector_->RecordAccess(kSets, key);
+  return sets_db_->SScan(TagKey(key), cursor, pattern, count,
+                         members, next_cursor);
 }
 
 Status BlackWidow::LPush(const Slice& key,
                          const std::vector<std::string>& values,
                          uint64_t* ret) {
-  return lists_db_->LPush(key, values, ret);
+  key_detector_->RecordAccess(kLists, key);
+  return lists_db_->LPush(TagKey(key), values, ret);
 }
 
 Status BlackWidow::RPush(const Slice& key,
                          const std::vector<std::string>& values,
                          uint64_t* ret) {
-  return lists_db_->RPush(key, values, ret);
+  key_detector_->RecordAccess(kLists, key);
+  return lists_db_->RPush(TagKey(key), values, ret);
 }
 
 Status BlackWidow::LRange(const Slice& key, int64_t start, int64_t stop,
                           std::vector<std::string>* ret) {
-  return lists_db_->LRange(key, start, stop, ret);
+  key_detector_->RecordAccess(kLists, key);
+  return lists_db_->LRange(TagKey(key), start, stop, ret);
 }
 
 Status BlackWidow::LTrim(const Slice& key, int64_t start, int64_t stop) {
-  return lists_db_->LTrim(key, start, stop);
+  key_detector_->RecordAccess(kLists, key);
+  return lists_db_->LTrim(TagKey(key), start, stop);
 }
 
 Status BlackWidow::LLen(const Slice& key, uint64_t* len) {
-  return lists_db_->LLen(key, len);
+  key_detector_->RecordAccess(kLists, key);
+  return lists_db_->LLen(TagKey(key), len);
 }
 
 Status BlackWidow::LPop(const Slice& key, std::string* element) {
-  return lists_db_->LPop(key, element);
+  key_detector_->RecordAccess(kLists, key);
+  return lists_db_->LPop(TagKey(key), element);
 }
 
 Status BlackWidow::RPop(const Slice& key, std::string* element) {
-  return lists_db_->RPop(key, element);
+  key_detector_->RecordAccess(kLists, key);
+  return lists_db_->RPop(TagKey(key), element);
 }
 
 Status BlackWidow::LIndex(const Slice& key,
                           int64_t index,
                           std::string* element) {
-  return lists_db_->LIndex(key, index, element);
+  key_detector_->RecordAccess(kLists, key);
+  return lists_db_->LIndex(TagKey(key), index, element);
 }
 
 Status BlackWidow::LInsert(const Slice& key,
@@ -495,53 +1004,94 @@ Status BlackWidow::LInsert(const Slice& key,
                            const std::string& pivot,
                            const std::string& value,
                            int64_t* ret) {
-  return lists_db_->LInsert(key, before_or_after, pivot, value, ret);
+  key_detector_->RecordAccess(kLists, key);
+  return lists_db_->LInsert(TagKey(key), before_or_after, pivot, value, ret);
 }
 
 Status BlackWidow::LPushx(const Slice& key, const Slice& value, uint64_t* len) {
-  return lists_db_->LPushx(key, value, len);
+  key_detector_->RecordAccess(kLists, key);
+  return lists_db_->LPushx(TagKey(key), value, len);
 }
 
 Status BlackWidow::RPushx(const Slice& key, const Slice& value, uint64_t* len) {
-  return lists_db_->RPushx(key, value, len);
+  key_detector_->RecordAccess(kLists, key);
+  return lists_db_->RPushx(TagKey(key), value, len);
+}
+
+Status BlackWidow::LPushCapped(const Slice& key,
+                               const std::vector<std::string>& values,
+                               uint64_t cap, uint64_t* ret) {
+  key_detector_->RecordAccess(kLists, key);
+  return lists_db_->LPushCapped(TagKey(key), values, cap, ret);
+}
+
+Status BlackWidow::RPushCapped(const Slice& key,
+                               const std::vector<std::string>& values,
+                               uint64_t cap, uint64_t* ret) {
+  key_detector_->RecordAccess(kLists, key);
+  return lists_db_->RPushCapped(TagKey(key), values, cap, ret);
 }
 
 Status BlackWidow::LRem(const Slice& key, int64_t count,
                         const Slice& value, uint64_t* ret) {
-  return lists_db_->LRem(key, count, value, ret);
+  key_detector_->RecordAccess(kLists, key);
+  return lists_db_->LRem(TagKey(key), count, value, ret);
 }
 
 Status BlackWidow::LSet(const Slice& key, int64_t index, const Slice& value) {
-  return lists_db_->LSet(key, index, value);
+  key_detector_->RecordAccess(kLists, key);
+  return lists_db_->LSet(TagKey(key), index, value);
 }
 
 Status BlackWidow::RPoplpush(const Slice& source,
                              const Slice& destination,
                              std::string* element) {
-  return lists_db_->RPoplpush(source, destination, element);
+  key_detector_->RecordAccess(kLists, source);
+  return lists_db_->RPoplpush(TagKey(source), TagKey(destination), element);
 }
 
 Status BlackWidow::ZPopMax(const Slice& key,
 			   const int64_t count,
 			   std::vector<ScoreMember>* score_members){
-  return zsets_db_->ZPopMax(key, count, score_members);
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kZSets, tagged_key);
+  return zsets_db_->ZPopMax(tagged_key, count, score_members);
 }
 
 Status BlackWidow::ZPopMin(const Slice& key,
 			   const int64_t count,
                            std::vector<ScoreMember>* score_members){
-  return zsets_db_->ZPopMin(key, count, score_members);
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kZSets, tagged_key);
+  return zsets_db_->ZPopMin(tagged_key, count, score_members);
 }
 
 Status BlackWidow::ZAdd(const Slice& key,
                         const std::vector<ScoreMember>& score_members,
                         int32_t* ret) {
-  return zsets_db_->ZAdd(key, score_members, ret);
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kZSets, tagged_key);
+  return zsets_db_->ZAdd(tagged_key, score_members, ret);
+}
+
+Status BlackWidow::ZAddCapped(const Slice& key,
+                              const std::vector<ScoreMember>& score_members,
+                              int32_t cap, int32_t* ret) {
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kZSets, tagged_key);
+  return zsets_db_->ZAddCapped(tagged_key, score_members, cap, ret);
 }
 
 Status BlackWidow::ZCard(const Slice& key,
                          int32_t* ret) {
-  return zsets_db_->ZCard(key, ret);
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kZSets, tagged_key);
+  return zsets_db_->ZCard(tagged_key, ret);
 }
 
 Status BlackWidow::ZCount(const Slice& key,
@@ -550,21 +1100,34 @@ Status BlackWidow::ZCount(const Slice& key,
                           bool left_close,
                           bool right_close,
                           int32_t* ret) {
-  return zsets_db_->ZCount(key, min, max, left_close, right_close, ret);
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kZSets, tagged_key);
+  return zsets_db_->ZCount(tagged_key, min, max, left_close, right_close, ret);
 }
 
 Status BlackWidow::ZIncrby(const Slice& key,
                            const Slice& member,
                            double increment,
                            double* ret) {
-  return zsets_db_->ZIncrby(key, member, increment, ret);
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  if (counter_buffer_ != nullptr
+    && counter_buffer_->ZIncrby(tagged_key, member, increment, ret)) {
+    return Status::OK();
+  }
+  ScopeCounterWrite cw(counter_buffer_, kZSets, tagged_key);
+  return zsets_db_->ZIncrby(tagged_key, member, increment, ret);
 }
 
 Status BlackWidow::ZRange(const Slice& key,
                           int32_t start,
                           int32_t stop,
                           std::vector<ScoreMember>* score_members) {
-  return zsets_db_->ZRange(key, start, stop, score_members);
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kZSets, tagged_key);
+  return zsets_db_->ZRange(tagged_key, start, stop, score_members);
 }
 
 Status BlackWidow::ZRangebyscore(const Slice& key,
@@ -573,27 +1136,39 @@ Status BlackWidow::ZRangebyscore(const Slice& key,
                                  bool left_close,
                                  bool right_close,
                                  std::vector<ScoreMember>* score_members) {
-  return zsets_db_->ZRangebyscore(key, min, max,
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kZSets, tagged_key);
+  return zsets_db_->ZRangebyscore(tagged_key, min, max,
       left_close, right_close, score_members);
 }
 
 Status BlackWidow::ZRank(const Slice& key,
                          const Slice& member,
                          int32_t* rank) {
-  return zsets_db_->ZRank(key, member, rank);
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kZSets, tagged_key);
+  return zsets_db_->ZRank(tagged_key, member, rank);
 }
 
 Status BlackWidow::ZRem(const Slice& key,
                         std::vector<std::string> members,
                         int32_t* ret) {
-  return zsets_db_->ZRem(key, members, ret);
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kZSets, tagged_key);
+  return zsets_db_->ZRem(tagged_key, members, ret);
 }
 
 Status BlackWidow::ZRemrangebyrank(const Slice& key,
                                    int32_t start,
                                    int32_t stop,
                                    int32_t* ret) {
-  return zsets_db_->ZRemrangebyrank(key, start, stop, ret);
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kZSets, tagged_key);
+  return zsets_db_->ZRemrangebyrank(tagged_key, start, stop, ret);
 }
 
 Status BlackWidow::ZRemrangebyscore(const Slice& key,
@@ -602,7 +1177,10 @@ Status BlackWidow::ZRemrangebyscore(const Slice& key,
                                     bool left_close,
                                     bool right_close,
                                     int32_t* ret) {
-  return zsets_db_->ZRemrangebyscore(key, min, max,
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kZSets, tagged_key);
+  return zsets_db_->ZRemrangebyscore(tagged_key, min, max,
       left_close, right_close, ret);
 }
 
@@ -610,7 +1188,10 @@ Status BlackWidow::ZRevrange(const Slice& key,
                              int32_t start,
                              int32_t stop,
                              std::vector<ScoreMember>* score_members) {
-  return zsets_db_->ZRevrange(key, start, stop, score_members);
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kZSets, tagged_key);
+  return zsets_db_->ZRevrange(tagged_key, start, stop, score_members);
 }
 
 Status BlackWidow::ZRevrangebyscore(const Slice& key,
@@ -619,20 +1200,32 @@ Status BlackWidow::ZRevrangebyscore(const Slice& key,
                                     bool left_close,
                                     bool right_close,
                                     std::vector<ScoreMember>* score_members) {
-  return zsets_db_->ZRevrangebyscore(key, min, max,
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kZSets, tagged_key);
+  return zsets_db_->ZRevrangebyscore(tagged_key, min, max,
       left_close, right_close, score_members);
 }
 
 Status BlackWidow::ZRevrank(const Slice& key,
                             const Slice& member,
                             int32_t* rank) {
-  return zsets_db_->ZRevrank(key, member, rank);
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kZSets, tagged_key);
+  return zsets_db_->ZRevrank(tagged_key, member, rank);
 }
 
 Status BlackWidow::ZScore(const Slice& key,
                           const Slice& member,
                           double* ret) {
-  return zsets_db_->ZScore(key, member, ret);
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  if (counter_buffer_ != nullptr
+    && counter_buffer_->ZScore(tagged_key, member, ret)) {
+    return Status::OK();
+  }
+  return zsets_db_->ZScore(tagged_key, member, ret);
 }
 
 Status BlackWidow::ZUnionstore(const Slice& destination,
@@ -640,7 +1233,13 @@ Status BlackWidow::ZUnionstore(const Slice& destination,
                                const std::vector<double>& weights,
                                const AGGREGATE agg,
                                int32_t* ret) {
-  return zsets_db_->ZUnionstore(destination, keys, weights, agg, ret);
+  SlotTaggedKey tagged_destination = TagKey(destination);
+  ScopeCounterWrite dest_cw(counter_buffer_, kZSets, tagged_destination);
+  std::vector<std::string> tagged_keys;
+  const std::vector<std::string>& store_keys = TagKeys(keys, &tagged_keys);
+  FlushBufferedCounters(kZSets, store_keys);
+  return zsets_db_->ZUnionstore(tagged_destination,
+      store_keys, weights, agg, ret);
 }
 
 Status BlackWidow::ZInterstore(const Slice& destination,
@@ -648,7 +1247,13 @@ Status BlackWidow::ZInterstore(const Slice& destination,
                                const std::vector<double>& weights,
                                const AGGREGATE agg,
                                int32_t* ret) {
-  return zsets_db_->ZInterstore(destination, keys, weights, agg, ret);
+  SlotTaggedKey tagged_destination = TagKey(destination);
+  ScopeCounterWrite dest_cw(counter_buffer_, kZSets, tagged_destination);
+  std::vector<std::string> tagged_keys;
+  const std::vector<std::string>& store_keys = TagKeys(keys, &tagged_keys);
+  FlushBufferedCounters(kZSets, store_keys);
+  return zsets_db_->ZInterstore(tagged_destination,
+      store_keys, weights, agg, ret);
 }
 
 Status BlackWidow::ZRangebylex(const Slice& key,
@@ -657,7 +1262,10 @@ Status BlackWidow::ZRangebylex(const Slice& key,
                                bool left_close,
                                bool right_close,
                                std::vector<std::string>* members) {
-  return zsets_db_->ZRangebylex(key, min, max,
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kZSets, tagged_key);
+  return zsets_db_->ZRangebylex(tagged_key, min, max,
       left_close, right_close, members);
 }
 
@@ -667,7 +1275,11 @@ Status BlackWidow::ZLexcount(const Slice& key,
                              bool left_close,
                              bool right_close,
                              int32_t* ret) {
-  return zsets_db_->ZLexcount(key, min, max, left_close, right_close, ret);
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kZSets, tagged_key);
+  return zsets_db_->ZLexcount(tagged_key, min, max,
+                              left_close, right_close, ret);
 }
 
 Status BlackWidow::ZRemrangebylex(const Slice& key,
@@ -676,26 +1288,156 @@ Status BlackWidow::ZRemrangebylex(const Slice& key,
                                   bool left_close,
                                   bool right_close,
                                   int32_t* ret) {
-  return zsets_db_->ZRemrangebylex(key, min, max, left_close, right_close, ret);
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kZSets, tagged_key);
+  return zsets_db_->ZRemrangebylex(tagged_key, min, max,
+                                   left_close, right_close, ret);
 }
 
 Status BlackWidow::ZScan(const Slice& key, int64_t cursor,
                          const std::string& pattern, int64_t count,
                          std::vector<ScoreMember>* score_members,
                          int64_t* next_cursor) {
-  return zsets_db_->ZScan(key, cursor,
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kZSets, tagged_key);
+  return zsets_db_->ZScan(tagged_key, cursor,
       pattern, count, score_members, next_cursor);
 }
 
+// Geo Commands
+Status BlackWidow::GeoAdd(const Slice& key,
+                          const std::vector<GeoPoint>& points,
+                          int32_t* ret) {
+  *ret = 0;
+  uint64_t bits;
+  std::vector<ScoreMember> score_members;
+  for (const auto& point : points) {
+    if (!GeoHashEncode(point.longitude, point.latitude, &bits)) {
+      return Status::InvalidArgument("invalid longitude,latitude pair "
+          + std::to_string(point.longitude) + ","
+          + std::to_string(point.latitude));
+    }
+    score_members.push_back({static_cast<double>(bits), point.member});
+  }
+  return ZAdd(key, score_members, ret);
+}
+
+Status BlackWidow::GeoPos(const Slice& key,
+                          const std::vector<std::string>& members,
+                          std::vector<GeoPosStatus>* positions) {
+  positions->clear();
+  double score;
+  GeoPosStatus position;
+  for (const auto& member : members) {
+    position.longitude = 0;
+    position.latitude = 0;
+    position.status = ZScore(key, member, &score);
+    if (position.status.ok()) {
+      GeoHashDecode(static_cast<uint64_t>(score),
+          &position.longitude, &position.latitude);
+    } else if (!position.status.IsNotFound()) {
+      positions->clear();
+      return position.status;
+    }
+    positions->push_back(position);
+  }
+  return Status::OK();
+}
+
+Status BlackWidow::GeoDist(const Slice& key, const Slice& member1,
+                           const Slice& member2, double* distance) {
+  double score1, score2;
+  Status s = ZScore(key, member1, &score1);
+  if (!s.ok()) {
+    return s;
+  }
+  s = ZScore(key, member2, &score2);
+  if (!s.ok()) {
+    return s;
+  }
+  double longitude1, latitude1, longitude2, latitude2;
+  GeoHashDecode(static_cast<uint64_t>(score1), &longitude1, &latitude1);
+  GeoHashDecode(static_cast<uint64_t>(score2), &longitude2, &latitude2);
+  *distance = GeoHashDistance(longitude1, latitude1, longitude2, latitude2);
+  return Status::OK();
+}
+
+Status BlackWidow::GeoSearch(const Slice& key, const GeoShape& shape,
+                             int64_t count, std::vector<GeoPoint>* points) {
+  points->clear();
+  if (!(shape.longitude >= kGeoLongitudeMin
+    && shape.longitude <= kGeoLongitudeMax
+    && shape.latitude >= kGeoLatitudeMin
+    && shape.latitude <= kGeoLatitudeMax)) {
+    return Status::InvalidArgument("invalid longitude,latitude pair");
+  }
+  if ((shape.by_radius && !(shape.radius >= 0))
+    || (!shape.by_radius && !(shape.width >= 0 && shape.height >= 0))) {
+    return Status::InvalidArgument("radius or box size cannot be negative");
+  }
+  key_detector_->RecordAccess(kZSets, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kZSets, tagged_key);
+  return zsets_db_->GeoSearch(tagged_key, shape, count, points);
+}
+
+// Streams Commands
+Status BlackWidow::XAdd(const Slice& key, const std::string& id,
+                        const std::vector<FieldValue>& fvs,
+                        StreamID* added_id) {
+  key_detector_->RecordAccess(kStreams, key);
+  return streams_db_->XAdd(TagKey(key), id, fvs, added_id);
+}
+
+Status BlackWidow::XLen(const Slice& key, uint64_t* len) {
+  key_detector_->RecordAccess(kStreams, key);
+  return streams_db_->XLen(TagKey(key), len);
+}
+
+Status BlackWidow::XRange(const Slice& key, const std::string& start,
+                          const std::string& end, int64_t count,
+                          std::vector<StreamEntry>* entries) {
+  key_detector_->RecordAccess(kStreams, key);
+  return streams_db_->XRange(TagKey(key), start, end, count, entries);
+}
+
+Status BlackWidow::XRevrange(const Slice& key, const std::string& end,
+                             const std::string& start, int64_t count,
+                             std::vector<StreamEntry>* entries) {
+  key_detector_->RecordAccess(kStreams, key);
+  return streams_db_->XRevrange(TagKey(key), end, start, count, entries);
+}
+
+Status BlackWidow::XDel(const Slice& key, const std::vector<std::string>& ids,
+                        int32_t* ret) {
+  key_detector_->RecordAccess(kStreams, key);
+  return streams_db_->XDel(TagKey(key), ids, ret);
+}
+
+Status BlackWidow::XTrim(const Slice& key, uint64_t maxlen, int64_t* ret) {
+  key_detector_->RecordAccess(kStreams, key);
+  return streams_db_->XTrim(TagKey(key), maxlen, ret);
+}
+
+Status BlackWidow::XTrimMinid(const Slice& key, const std::string& min_id,
+                              int64_t* ret) {
+  key_detector_->RecordAccess(kStreams, key);
+  return streams_db_->XTrimMinid(TagKey(key), min_id, ret);
+}
+
 
 // Keys Commands
 int32_t BlackWidow::Expire(const Slice& key, int32_t ttl,
                            std::map<DataType, Status>* type_status) {
   int32_t ret = 0;
   bool is_corruption = false;
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kAll, tagged_key);
 
   // Strings
-  Status s = strings_db_->Expire(key, ttl);
+  Status s = strings_db_->Expire(tagged_key, ttl);
   if (s.ok()) {
     ret++;
   } else if (!s.IsNotFound()) {
@@ -704,7 +1446,7 @@ int32_t BlackWidow::Expire(const Slice& key, int32_t ttl,
   }
 
   // Hash
-  s = hashes_db_->Expire(key, ttl);
+  s = hashes_db_->Expire(tagged_key, ttl);
   if (s.ok()) {
     ret++;
   } else if (!s.IsNotFound()) {
@@ -713,7 +1455,7 @@ int32_t BlackWidow::Expire(const Slice& key, int32_t ttl,
   }
 
   // Sets
-  s = sets_db_->Expire(key, ttl);
+  s = sets_db_->Expire(tagged_key, ttl);
   if (s.ok()) {
     ret++;
   } else if (!s.IsNotFound()) {
@@ -722,7 +1464,7 @@ int32_t BlackWidow::Expire(const Slice& key, int32_t ttl,
   }
 
   // Lists
-  s = lists_db_->Expire(key, ttl);
+  s = lists_db_->Expire(tagged_key, ttl);
   if (s.ok()) {
     ret++;
   } else if (!s.IsNotFound()) {
@@ -731,7 +1473,7 @@ int32_t BlackWidow::Expire(const Slice& key, int32_t ttl,
   }
 
   // Zsets
-  s = zsets_db_->Expire(key, ttl);
+  s = zsets_db_->Expire(tagged_key, ttl);
   if (s.ok()) {
     ret++;
   } else if (!s.IsNotFound()) {
@@ -739,6 +1481,15 @@ int32_t BlackWidow::Expire(const Slice& key, int32_t ttl,
     (*type_status)[DataType::kZSets] = s;
   }
 
+  // Streams
+  s = streams_db_->Expire(tagged_key, ttl);
+  if (s.ok()) {
+    ret++;
+  } else if (!s.IsNotFound()) {
+    is_corruption = true;
+    (*type_status)[DataType::kStreams] = s;
+  }
+
   if (is_corruption) {
     return -1;
   } else {
@@ -753,8 +1504,10 @@ int64_t BlackWidow::Del(const std::vector<std::string>& keys,
   bool is_corruption = false;
 
   for (const auto& key : keys) {
+    SlotTaggedKey tagged_key = TagKey(key);
+    ScopeCounterWrite cw(counter_buffer_, kAll, tagged_key);
     // Strings
-    Status s = strings_db_->Del(key);
+    Status s = strings_db_->Del(tagged_key);
     if (s.ok()) {
       count++;
     } else if (!s.IsNotFound()) {
@@ -763,7 +1516,7 @@ int64_t BlackWidow::Del(const std::vector<std::string>& keys,
     }
 
     // Hashes
-    s = hashes_db_->Del(key);
+    s = hashes_db_->Del(tagged_key);
     if (s.ok()) {
       count++;
     } else if (!s.IsNotFound()) {
@@ -772,7 +1525,7 @@ int64_t BlackWidow::Del(const std::vector<std::string>& keys,
     }
 
     // Sets
-    s = sets_db_->Del(key);
+    s = sets_db_->Del(tagged_key);
     if (s.ok()) {
       count++;
     } else if (!s.IsNotFound()) {
@@ -781,7 +1534,7 @@ int64_t BlackWidow::Del(const std::vector<std::string>& keys,
     }
 
     // Lists
-    s = lists_db_->Del(key);
+    s = lists_db_->Del(tagged_key);
     if (s.ok()) {
       count++;
     } else if (!s.IsNotFound()) {
@@ -790,13 +1543,22 @@ int64_t BlackWidow::Del(const std::vector<std::string>& keys,
     }
 
     // ZSets
-    s = zsets_db_->Del(key);
+    s = zsets_db_->Del(tagged_key);
     if (s.ok()) {
       count++;
     } else if (!s.IsNotFound()) {
       is_corruption = true;
       (*type_status)[DataType::kZSets] = s;
     }
+
+    // Streams
+    s = streams_db_->Del(tagged_key);
+    if (s.ok()) {
+      count++;
+    } else if (!s.IsNotFound()) {
+      is_corruption = true;
+      (*type_status)[DataType::kStreams] = s;
+    }
   }
 
   if (is_corruption) {
@@ -813,11 +1575,13 @@ int64_t BlackWidow::DelByType(const std::vector<std::string>& keys,
   bool is_corruption = false;
 
   for (const auto& key : keys) {
+    SlotTaggedKey tagged_key = TagKey(key);
+    ScopeCounterWrite cw(counter_buffer_, type, tagged_key);
     switch (type) {
       // Strings
       case DataType::kStrings:
       {
-        s = strings_db_->Del(key);
+        s = strings_db_->Del(tagged_key);
         if (s.ok()) {
           count++;
         } else if (!s.IsNotFound()) {
@@ -828,7 +1592,7 @@ int64_t BlackWidow::DelByType(const std::vector<std::string>& keys,
       // Hashes
       case DataType::kHashes:
       {
-        s = hashes_db_->Del(key);
+        s = hashes_db_->Del(tagged_key);
         if (s.ok()) {
           count++;
         } else if (!s.IsNotFound()) {
@@ -839,7 +1603,7 @@ int64_t BlackWidow::DelByType(const std::vector<std::string>& keys,
       // Sets
       case DataType::kSets:
       {
-        s = sets_db_->Del(key);
+        s = sets_db_->Del(tagged_key);
         if (s.ok()) {
           count++;
         } else if (!s.IsNotFound()) {
@@ -850,7 +1614,7 @@ int64_t BlackWidow::DelByType(const std::vector<std::string>& keys,
       // Lists
       case DataType::kLists:
       {
-        s = lists_db_->Del(key);
+        s = lists_db_->Del(tagged_key);
         if (s.ok()) {
           count++;
         } else if (!s.IsNotFound()) {
@@ -861,7 +1625,18 @@ int64_t BlackWidow::DelByType(const std::vector<std::string>& keys,
       // ZSets
       case DataType::kZSets:
       {
-        s = zsets_db_->Del(key);
+        s = zsets_db_->Del(tagged_key);
+        if (s.ok()) {
+          count++;
+        } else if (!s.IsNotFound()) {
+          is_corruption = true;
+        }
+        break;
+      }
+      // Streams
+      case DataType::kStreams:
+      {
+        s = streams_db_->Del(tagged_key);
         if (s.ok()) {
           count++;
         } else if (!s.IsNotFound()) {
@@ -889,12 +1664,15 @@ int64_t BlackWidow::Exists(const std::vector<std::string>& keys,
   int64_t count = 0;
   int32_t ret;
   uint64_t llen;
+  bool is_bloom;
   std::string value;
   Status s;
   bool is_corruption = false;
 
   for (const auto& key : keys) {
-    s = strings_db_->Get(key, &value);
+    SlotTaggedKey tagged_key = TagKey(key);
+    FlushBufferedCounter(kAll, tagged_key);
+    s = strings_db_->Get(tagged_key, &value);
     if (s.ok()) {
       count++;
     } else if (!s.IsNotFound()) {
@@ -902,7 +1680,8 @@ int64_t BlackWidow::Exists(const std::vector<std::string>& keys,
       (*type_status)[DataType::kStrings] = s;
     }
 
-    s = hashes_db_->HLen(key, &ret);
+    // A hash or a Bloom filter
+    s = hashes_db_->IsBloomFilter(tagged_key, &is_bloom);
     if (s.ok()) {
       count++;
     } else if (!s.IsNotFound()) {
@@ -910,7 +1689,7 @@ int64_t BlackWidow::Exists(const std::vector<std::string>& keys,
       (*type_status)[DataType::kHashes] = s;
     }
 
-    s = sets_db_->SCard(key, &ret);
+    s = sets_db_->SCard(tagged_key, &ret);
     if (s.ok()) {
       count++;
     } else if (!s.IsNotFound()) {
@@ -918,7 +1697,7 @@ int64_t BlackWidow::Exists(const std::vector<std::string>& keys,
       (*type_status)[DataType::kSets] = s;
     }
 
-    s = lists_db_->LLen(key, &llen);
+    s = lists_db_->LLen(tagged_key, &llen);
     if (s.ok()) {
       count++;
     } else if (!s.IsNotFound()) {
@@ -926,13 +1705,21 @@ int64_t BlackWidow::Exists(const std::vector<std::string>& keys,
       (*type_status)[DataType::kLists] = s;
     }
 
-    s = zsets_db_->ZCard(key, &ret);
+    s = zsets_db_->ZCard(tagged_key, &ret);
     if (s.ok()) {
       count++;
     } else if (!s.IsNotFound()) {
       is_corruption = true;
       (*type_status)[DataType::kZSets] = s;
     }
+
+    s = streams_db_->XLen(tagged_key, &llen);
+    if (s.ok()) {
+      count++;
+    } else if (!s.IsNotFound()) {
+      is_corruption = true;
+      (*type_status)[DataType::kStreams] = s;
+    }
   }
 
   if (is_corruption) {
@@ -950,9 +1737,10 @@ int64_t BlackWidow::Scan(const DataType& dtype, int64_t cursor,
   int64_t leftover_visits = count;
   int64_t step_length = count, cursor_ret = 0;
   std::string start_key, next_key, prefix;
+  std::string match = TagPattern(pattern);
 
-  prefix = isTailWildcard(pattern) ?
-    pattern.substr(0, pattern.size() - 1) : "";
+  prefix = isTailWildcard(match) ?
+    match.substr(0, match.size() - 1) : "";
 
   if (cursor < 0) {
     return cursor_ret;
@@ -970,7 +1758,7 @@ int64_t BlackWidow::Scan(const DataType& dtype, int64_t cursor,
   start_key.erase(start_key.begin());
   switch (key_type) {
     case 'k':
-      is_finish = strings_db_->Scan(start_key, pattern,
+      is_finish = strings_db_->Scan(start_key, match,
                                     keys, &leftover_visits, &next_key);
       if (!leftover_visits && !is_finish) {
         cursor_ret = cursor + step_length;
@@ -988,7 +1776,7 @@ int64_t BlackWidow::Scan(const DataType& dtype, int64_t cursor,
       }
       start_key = prefix;
     case 'h':
-      is_finish = hashes_db_->Scan(start_key, pattern,
+      is_finish = hashes_db_->Scan(start_key, match,
                                    keys, &leftover_visits, &next_key);
       if (!leftover_visits && !is_finish) {
         cursor_ret = cursor + step_length;
@@ -1006,7 +1794,7 @@ int64_t BlackWidow::Scan(const DataType& dtype, int64_t cursor,
       }
       start_key = prefix;
     case 's':
-      is_finish = sets_db_->Scan(start_key, pattern,
+      is_finish = sets_db_->Scan(start_key, match,
                                  keys, &leftover_visits, &next_key);
       if (!leftover_visits && !is_finish) {
         cursor_ret = cursor + step_length;
@@ -1024,7 +1812,7 @@ int64_t BlackWidow::Scan(const DataType& dtype, int64_t cursor,
       }
       start_key = prefix;
     case 'l':
-      is_finish = lists_db_->Scan(start_key, pattern,
+      is_finish = lists_db_->Scan(start_key, match,
                                   keys, &leftover_visits, &next_key);
       if (!leftover_visits && !is_finish) {
         cursor_ret = cursor + step_length;
@@ -1042,17 +1830,38 @@ int64_t BlackWidow::Scan(const DataType& dtype, int64_t cursor,
       }
       start_key = prefix;
     case 'z':
-      is_finish = zsets_db_->Scan(start_key, pattern,
+      is_finish = zsets_db_->Scan(start_key, match,
                                   keys, &leftover_visits, &next_key);
       if (!leftover_visits && !is_finish) {
         cursor_ret = cursor + step_length;
         StoreCursorStartKey(dtype, cursor_ret, std::string("z") + next_key);
         break;
+      } else if (is_finish) {
+        if (DataType::kZSets == dtype) {
+          cursor_ret = 0;
+          break;
+        } else if (!leftover_visits) {
+          cursor_ret = cursor + step_length;
+          StoreCursorStartKey(dtype, cursor_ret, std::string("x") + prefix);
+          break;
+        }
+      }
+      start_key = prefix;
+    case 'x':
+      is_finish = streams_db_->Scan(start_key, match,
+                                    keys, &leftover_visits, &next_key);
+      if (!leftover_visits && !is_finish) {
+        cursor_ret = cursor + step_length;
+        StoreCursorStartKey(dtype, cursor_ret, std::string("x") + next_key);
+        break;
       } else if (is_finish) {
         cursor_ret = 0;
         break;
       }
   }
+  if (IsKeyTagged()) {
+    StripSlotTags(keys);
+  }
   return cursor_ret;
 }
 
@@ -1065,6 +1874,9 @@ Status BlackWidow::PKScanRange(const DataType& data_type,
   Status s;
   keys->clear();
   next_key->clear();
+  if (IsKeyTagged()) {
+    return Status::NotSupported("Key range of the tagged keys");
+  }
   switch (data_type) {
     case DataType::kStrings:
       s = strings_db_->PKScanRange(key_start, key_end,
@@ -1102,6 +1914,9 @@ Status BlackWidow::PKRScanRange(const DataType& data_type,
   Status s;
   keys->clear();
   next_key->clear();
+  if (IsKeyTagged()) {
+    return Status::NotSupported("Key range of the tagged keys");
+  }
   switch (data_type) {
     case DataType::kStrings:
       s = strings_db_->PKRScanRange(key_start, key_end,
@@ -1133,22 +1948,33 @@ Status BlackWidow::PKRScanRange(const DataType& data_type,
 Status BlackWidow::PKPatternMatchDel(const DataType& data_type,
                                      const std::string& pattern,
                                      int32_t* ret) {
+  if (IsReadOnly()) {
+    *ret = 0;
+    return Status::NotSupported("Not supported in read-only mode");
+  }
+
+  // The counters of the matched keys must not outlive them
+  ScopeCounterWrite cw(counter_buffer_);
   Status s;
+  std::string match = TagPattern(pattern);
   switch (data_type) {
     case DataType::kStrings:
-      s = strings_db_->PKPatternMatchDel(pattern, ret);
+      s = strings_db_->PKPatternMatchDel(match, ret);
       break;
     case DataType::kHashes:
-      s = hashes_db_->PKPatternMatchDel(pattern, ret);
+      s = hashes_db_->PKPatternMatchDel(match, ret);
       break;
     case DataType::kLists:
-      s = lists_db_->PKPatternMatchDel(pattern, ret);
+      s = lists_db_->PKPatternMatchDel(match, ret);
       break;
     case DataType::kZSets:
-      s = zsets_db_->PKPatternMatchDel(pattern, ret);
+      s = zsets_db_->PKPatternMatchDel(match, ret);
       break;
     case DataType::kSets:
-      s = sets_db_->PKPatternMatchDel(pattern, ret);
+      s = sets_db_->PKPatternMatchDel(match, ret);
+      break;
+    case DataType::kStreams:
+      s = streams_db_->PKPatternMatchDel(match, ret);
       break;
     default:
       s = Status::Corruption("Unsupported data type");
@@ -1166,26 +1992,39 @@ Status BlackWidow::Scanx(const DataType& data_type,
   Status s;
   keys->clear();
   next_key->clear();
+  std::string match = TagPattern(pattern);
+  // An empty start_key starts from the first key of the database
+  std::string start_point = start_key.empty() && databases_ <= 1
+    ? start_key : TagKey(start_key).ToString();
   switch (data_type) {
     case DataType::kStrings:
-      strings_db_->Scan(start_key, pattern, keys, &count, next_key);
+      strings_db_->Scan(start_point, match, keys, &count, next_key);
       break;
     case DataType::kHashes:
-      hashes_db_->Scan(start_key, pattern, keys, &count, next_key);
+      hashes_db_->Scan(start_point, match, keys, &count, next_key);
       break;
     case DataType::kLists:
-      lists_db_->Scan(start_key, pattern, keys, &count, next_key);
+      lists_db_->Scan(start_point, match, keys, &count, next_key);
       break;
     case DataType::kZSets:
-      zsets_db_->Scan(start_key, pattern, keys, &count, next_key);
+      zsets_db_->Scan(start_point, match, keys, &count, next_key);
       break;
     case DataType::kSets:
-      sets_db_->Scan(start_key, pattern, keys, &count, next_key);
+      sets_db_->Scan(start_point, match, keys, &count, next_key);
+      break;
+    case DataType::kStreams:
+      streams_db_->Scan(start_point, match, keys, &count, next_key);
       break;
     default:
       Status::Corruption("Unsupported data types");
       break;
   }
+  if (IsKeyTagged()) {
+    StripSlotTags(keys);
+    if (!next_key->empty()) {
+      next_key->erase(0, kSlotTagLength);
+    }
+  }
   return s;
 }
 
@@ -1194,8 +2033,10 @@ int32_t BlackWidow::Expireat(const Slice& key, int32_t timestamp,
   Status s;
   int32_t count = 0;
   bool is_corruption = false;
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kAll, tagged_key);
 
-  s = strings_db_->Expireat(key, timestamp);
+  s = strings_db_->Expireat(tagged_key, timestamp);
   if (s.ok()) {
     count++;
   } else if (!s.IsNotFound()) {
@@ -1203,7 +2044,7 @@ int32_t BlackWidow::Expireat(const Slice& key, int32_t timestamp,
     (*type_status)[DataType::kStrings] = s;
   }
 
-  s = hashes_db_->Expireat(key, timestamp);
+  s = hashes_db_->Expireat(tagged_key, timestamp);
   if (s.ok()) {
     count++;
   } else if (!s.IsNotFound()) {
@@ -1211,7 +2052,7 @@ int32_t BlackWidow::Expireat(const Slice& key, int32_t timestamp,
     (*type_status)[DataType::kHashes] = s;
   }
 
-  s = sets_db_->Expireat(key, timestamp);
+  s = sets_db_->Expireat(tagged_key, timestamp);
   if (s.ok()) {
     count++;
   } else if (!s.IsNotFound()) {
@@ -1219,7 +2060,7 @@ int32_t BlackWidow::Expireat(const Slice& key, int32_t timestamp,
     (*type_status)[DataType::kSets] = s;
   }
 
-  s = lists_db_->Expireat(key, timestamp);
+  s = lists_db_->Expireat(tagged_key, timestamp);
   if (s.ok()) {
     count++;
   } else if (!s.IsNotFound()) {
@@ -1227,7 +2068,7 @@ int32_t BlackWidow::Expireat(const Slice& key, int32_t timestamp,
     (*type_status)[DataType::kLists] = s;
   }
 
-  s = zsets_db_->Expireat(key, timestamp);
+  s = zsets_db_->Expireat(tagged_key, timestamp);
   if (s.ok()) {
     count++;
   } else if (!s.IsNotFound()) {
@@ -1235,6 +2076,14 @@ int32_t BlackWidow::Expireat(const Slice& key, int32_t timestamp,
     (*type_status)[DataType::kLists] = s;
   }
 
+  s = streams_db_->Expireat(tagged_key, timestamp);
+  if (s.ok()) {
+    count++;
+  } else if (!s.IsNotFound()) {
+    is_corruption = true;
+    (*type_status)[DataType::kStreams] = s;
+  }
+
   if (is_corruption) {
     return -1;
   } else {
@@ -1247,8 +2096,10 @@ int32_t BlackWidow::Persist(const Slice& key,
   Status s;
   int32_t count = 0;
   bool is_corruption = false;
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kAll, tagged_key);
 
-  s = strings_db_->Persist(key);
+  s = strings_db_->Persist(tagged_key);
   if (s.ok()) {
     count++;
   } else if (!s.IsNotFound()) {
@@ -1256,7 +2107,7 @@ int32_t BlackWidow::Persist(const Slice& key,
     (*type_status)[DataType::kStrings] = s;
   }
 
-  s = hashes_db_->Persist(key);
+  s = hashes_db_->Persist(tagged_key);
   if (s.ok()) {
     count++;
   } else if (!s.IsNotFound()) {
@@ -1264,7 +2115,7 @@ int32_t BlackWidow::Persist(const Slice& key,
     (*type_status)[DataType::kHashes] = s;
   }
 
-  s = sets_db_->Persist(key);
+  s = sets_db_->Persist(tagged_key);
   if (s.ok()) {
     count++;
   } else if (!s.IsNotFound()) {
@@ -1272,7 +2123,7 @@ int32_t BlackWidow::Persist(const Slice& key,
     (*type_status)[DataType::kSets] = s;
   }
 
-  s = lists_db_->Persist(key);
+  s = lists_db_->Persist(tagged_key);
   if (s.ok()) {
     count++;
   } else if (!s.IsNotFound()) {
@@ -1280,7 +2131,7 @@ int32_t BlackWidow::Persist(const Slice& key,
     (*type_status)[DataType::kLists] = s;
   }
 
-  s = zsets_db_->Persist(key);
+  s = zsets_db_->Persist(tagged_key);
   if (s.ok()) {
     count++;
   } else if (!s.IsNotFound()) {
@@ -1288,6 +2139,14 @@ int32_t BlackWidow::Persist(const Slice& key,
     (*type_status)[DataType::kLists] = s;
   }
 
+  s = streams_db_->Persist(tagged_key);
+  if (s.ok()) {
+    count++;
+  } else if (!s.IsNotFound()) {
+    is_corruption = true;
+    (*type_status)[DataType::kStreams] = s;
+  }
+
   if (is_corruption) {
     return -1;
   } else {
@@ -1300,8 +2159,10 @@ std::map<DataType, int64_t> BlackWidow::TTL(const Slice& key,
   Status s;
   std::map<DataType, int64_t> ret;
   int64_t timestamp = 0;
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kAll, tagged_key);
 
-  s = strings_db_->TTL(key, &timestamp);
+  s = strings_db_->TTL(tagged_key, &timestamp);
   if (s.ok() || s.IsNotFound()) {
     ret[DataType::kStrings] = timestamp;
   } else if (!s.IsNotFound()) {
@@ -1309,7 +2170,7 @@ std::map<DataType, int64_t> BlackWidow::TTL(const Slice& key,
     (*type_status)[DataType::kStrings] = s;
   }
 
-  s = hashes_db_->TTL(key, &timestamp);
+  s = hashes_db_->TTL(tagged_key, &timestamp);
   if (s.ok() || s.IsNotFound()) {
     ret[DataType::kHashes] = timestamp;
   } else if (!s.IsNotFound()) {
@@ -1317,7 +2178,7 @@ std::map<DataType, int64_t> BlackWidow::TTL(const Slice& key,
     (*type_status)[DataType::kHashes] = s;
   }
 
-  s = lists_db_->TTL(key, &timestamp);
+  s = lists_db_->TTL(tagged_key, &timestamp);
   if (s.ok() || s.IsNotFound()) {
     ret[DataType::kLists] = timestamp;
   } else if (!s.IsNotFound()) {
@@ -1325,7 +2186,7 @@ std::map<DataType, int64_t> BlackWidow::TTL(const Slice& key,
     (*type_status)[DataType::kLists] = s;
   }
 
-  s = sets_db_->TTL(key, &timestamp);
+  s = sets_db_->TTL(tagged_key, &timestamp);
   if (s.ok() || s.IsNotFound()) {
     ret[DataType::kSets] = timestamp;
   } else if (!s.IsNotFound()) {
@@ -1333,101 +2194,319 @@ std::map<DataType, int64_t> BlackWidow::TTL(const Slice& key,
     (*type_status)[DataType::kSets] = s;
   }
 
-  s = zsets_db_->TTL(key, &timestamp);
+  s = zsets_db_->TTL(tagged_key, &timestamp);
   if (s.ok() || s.IsNotFound()) {
     ret[DataType::kZSets] = timestamp;
   } else if (!s.IsNotFound()) {
     ret[DataType::kZSets] = -3;
     (*type_status)[DataType::kZSets] = s;
   }
+
+  s = streams_db_->TTL(tagged_key, &timestamp);
+  if (s.ok() || s.IsNotFound()) {
+    ret[DataType::kStreams] = timestamp;
+  } else if (!s.IsNotFound()) {
+    ret[DataType::kStreams] = -3;
+    (*type_status)[DataType::kStreams] = s;
+  }
   return ret;
 }
 
-// the sequence is kv, hash, list, zset, set
-Status BlackWidow::Type(const std::string &key, std::string* type) {
-  type->clear();
-
+Status BlackWidow::Rename(const Slice& key, const Slice& newkey) {
+  SlotTaggedKey tagged_key = TagKey(key);
+  SlotTaggedKey tagged_newkey = TagKey(newkey);
+  ScopeCounterWrite cw(counter_buffer_, kAll, tagged_key);
+  ScopeCounterWrite new_cw(counter_buffer_, kAll, tagged_newkey);
   Status s;
-  std::string value;
-  s = strings_db_->Get(key, &value);
-  if (s.ok()) {
-    *type = "string";
-    return s;
-  } else if (!s.IsNotFound()) {
-    return s;
+  bool is_found = false;
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs = dataset->dbs();
+  std::vector<Redis*> other_dbs;
+  for (const auto& db : dbs) {
+    s = db->Rename(tagged_key, tagged_newkey, false);
+    if (s.ok()) {
+      is_found = true;
+    } else if (s.IsNotFound()) {
+      other_dbs.push_back(db);
+    } else {
+      return s;
+    }
   }
-
-  int32_t hashes_len = 0;
-  s = hashes_db_->HLen(key, &hashes_len);
-  if (s.ok() && hashes_len != 0) {
-    *type = "hash";
-    return s;
-  } else if (!s.IsNotFound()) {
-    return s;
+  if (!is_found) {
+    return Status::NotFound();
   }
-
-  uint64_t lists_len = 0;
-  s = lists_db_->LLen(key, &lists_len);
-  if (s.ok() && lists_len != 0) {
-    *type = "list";
-    return s;
-  } else if (!s.IsNotFound()) {
-    return s;
+  // newkey is overwritten whatever data type it held
+  for (const auto& db : other_dbs) {
+    s = db->Del(tagged_newkey);
+    if (!s.ok() && !s.IsNotFound()) {
+      return s;
+    }
   }
+  return Status::OK();
+}
 
-  int32_t zsets_size = 0;
-  s = zsets_db_->ZCard(key, &zsets_size);
-  if (s.ok() && zsets_size != 0) {
-    *type = "zset";
-    return s;
-  } else if (!s.IsNotFound()) {
-    return s;
+Status BlackWidow::RenameNx(const Slice& key, const Slice& newkey,
+                            int32_t* ret) {
+  *ret = 0;
+  std::map<DataType, Status> type_status;
+  int64_t count = Exists({key.ToString()}, &type_status);
+  if (count < 0) {
+    return type_status.begin()->second;
+  } else if (count == 0) {
+    return Status::NotFound();
+  }
+  // The check of the other data types is not atomic with the rename,
+  // every data type checks newkey again under its record locks
+  count = Exists({newkey.ToString()}, &type_status);
+  if (count < 0) {
+    return type_status.begin()->second;
+  } else if (count > 0) {
+    return Status::OK();
+  }
+
+  SlotTaggedKey tagged_key = TagKey(key);
+  SlotTaggedKey tagged_newkey = TagKey(newkey);
+  ScopeCounterWrite cw(counter_buffer_, kAll, tagged_key);
+  ScopeCounterWrite new_cw(counter_buffer_, kAll, tagged_newkey);
+  Status s;
+  bool is_found = false;
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs = dataset->dbs();
+  for (const auto& db : dbs) {
+    s = db->Rename(tagged_key, tagged_newkey, true);
+    if (s.ok()) {
+      is_found = true;
+    } else if (s.IsBusy()) {
+      return Status::OK();
+    } else if (!s.IsNotFound()) {
+      return s;
+    }
   }
-
-  int32_t sets_size = 0;
-  s = sets_db_->SCard(key, &sets_size);
-  if (s.ok() && sets_size != 0) {
-    *type = "set";
-    return s;
-  } else if (!s.IsNotFound()) {
-    return s;
+  if (!is_found) {
+    return Status::NotFound();
   }
-
-  *type = "none";
+  *ret = 1;
   return Status::OK();
 }
 
-Status BlackWidow::Keys(const DataType& data_type,
-                        const std::string& pattern,
-                        std::vector<std::string>* keys) {
+Status BlackWidow::Copy(const Slice& key, const Slice& newkey, bool replace,
+                        int32_t* ret) {
+  *ret = 0;
+  if (key == newkey) {
+    return Status::InvalidArgument("source and destination are the same");
+  }
+  if (!replace) {
+    std::map<DataType, Status> type_status;
+    int64_t count = Exists({newkey.ToString()}, &type_status);
+    if (count < 0) {
+      return type_status.begin()->second;
+    } else if (count > 0) {
+      return Status::OK();
+    }
+  }
+
+  SlotTaggedKey tagged_key = TagKey(key);
+  SlotTaggedKey tagged_newkey = TagKey(newkey);
+  ScopeCounterWrite cw(counter_buffer_, kAll, tagged_key);
+  ScopeCounterWrite new_cw(counter_buffer_, kAll, tagged_newkey);
   Status s;
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs = dataset->dbs();
+  std::vector<Redis*> other_dbs;
+  for (const auto& db : dbs) {
+    s = db->Copy(tagged_key, tagged_newkey, replace);
+    if (s.ok()) {
+      *ret = 1;
+    } else if (s.IsBusy()) {
+      return Status::OK();
+    } else if (s.IsNotFound()) {
+      other_dbs.push_back(db);
+    } else {
+      return s;
+    }
+  }
+  // A replaced newkey goes whatever data type it held
+  if (*ret == 1 && replace) {
+    for (const auto& db : other_dbs) {
+      s = db->Del(tagged_newkey);
+      if (!s.ok() && !s.IsNotFound()) {
+        return s;
+      }
+    }
+  }
+  return Status::OK();
+}
+
+Status BlackWidow::Dump(const Slice& key, std::string* dump) {
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kAll, tagged_key);
+  DumpWriter writer(dump, max_dump_size_);
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs = dataset->dbs();
+  for (const auto& db : dbs) {
+    Status s = db->Dump(tagged_key, &writer);
+    if (s.ok()) {
+      return writer.Finish();
+    } else if (!s.IsNotFound()) {
+      dump->clear();
+      return s;
+    }
+  }
+  return Status::NotFound();
+}
+
+Status BlackWidow::Restore(const Slice& key, const Slice& dump, int32_t ttl,
+                           bool replace) {
+  if (ttl < 0) {
+    return Status::InvalidArgument("invalid expire time");
+  }
+  DumpReader reader(dump);
+  Status s = reader.Verify(max_dump_size_);
+  if (!s.ok()) {
+    return s;
+  }
+
+  std::map<DataType, Status> type_status;
+  if (replace) {
+    if (Del({key.ToString()}, &type_status) < 0) {
+      return type_status.begin()->second;
+    }
+  } else {
+    // The data type of the dump checks key again under its record lock
+    int64_t count = Exists({key.ToString()}, &type_status);
+    if (count < 0) {
+      return type_status.begin()->second;
+    } else if (count > 0) {
+      return Status::Busy("Target key name already exists");
+    }
+  }
+
+  SlotTaggedKey tagged_key = TagKey(key);
+  switch (reader.type()) {
+    case DataType::kStrings:
+      return strings_db_->Restore(tagged_key, &reader, ttl, replace);
+    case DataType::kHashes:
+      return hashes_db_->Restore(tagged_key, &reader, ttl, replace);
+    case DataType::kSets:
+      return sets_db_->Restore(tagged_key, &reader, ttl, replace);
+    case DataType::kLists:
+      return lists_db_->Restore(tagged_key, &reader, ttl, replace);
+    case DataType::kZSets:
+      return zsets_db_->Restore(tagged_key, &reader, ttl, replace);
+    case DataType::kStreams:
+      return streams_db_->Restore(tagged_key, &reader, ttl, replace);
+    default:
+      return Status::Corruption("Unsupported data types");
+  }
+}
+
+// the sequence is kv, hash, list, zset, set, stream
+Status BlackWidow::Type(const std::string &key, std::string* type) {
+  type->clear();
+
+  Status s;
+  std::string value;
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kAll, tagged_key);
+  s = strings_db_->Get(tagged_key, &value);
+  if (s.ok()) {
+    *type = "string";
+    return s;
+  } else if (!s.IsNotFound()) {
+    return s;
+  }
+
+  // A Bloom filter is reported as RedisBloom does
+  bool is_bloom = false;
+  s = hashes_db_->IsBloomFilter(tagged_key, &is_bloom);
+  if (s.ok()) {
+    *type = is_bloom ? "MBbloom--" : "hash";
+    return s;
+  } else if (!s.IsNotFound()) {
+    return s;
+  }
+
+  uint64_t lists_len = 0;
+  s = lists_db_->LLen(tagged_key, &lists_len);
+  if (s.ok() && lists_len != 0) {
+    *type = "list";
+    return s;
+  } else if (!s.IsNotFound()) {
+    return s;
+  }
+
+  int32_t zsets_size = 0;
+  s = zsets_db_->ZCard(tagged_key, &zsets_size);
+  if (s.ok() && zsets_size != 0) {
+    *type = "zset";
+    return s;
+  } else if (!s.IsNotFound()) {
+    return s;
+  }
+
+  int32_t sets_size = 0;
+  s = sets_db_->SCard(tagged_key, &sets_size);
+  if (s.ok() && sets_size != 0) {
+    *type = "set";
+    return s;
+  } else if (!s.IsNotFound()) {
+    return s;
+  }
+
+  uint64_t streams_len = 0;
+  s = streams_db_->XLen(tagged_key, &streams_len);
+  if (s.ok() && streams_len != 0) {
+    *type = "stream";
+    return s;
+  } else if (!s.IsNotFound()) {
+    return s;
+  }
+
+  *type = "none";
+  return Status::OK();
+}
+
+Status BlackWidow::Keys(const DataType& data_type,
+                        const std::string& pattern,
+                        std::vector<std::string>* keys) {
+  Status s;
+  size_t start_pos = keys->size();
+  std::string match = TagPattern(pattern);
   if (data_type == DataType::kStrings) {
-    s = strings_db_->ScanKeys(pattern, keys);
+    s = strings_db_->ScanKeys(match, keys);
     if (!s.ok()) return s;
   } else if (data_type == DataType::kHashes) {
-    s = hashes_db_->ScanKeys(pattern, keys);
+    s = hashes_db_->ScanKeys(match, keys);
     if (!s.ok()) return s;
   } else if (data_type == DataType::kZSets) {
-    s = zsets_db_->ScanKeys(pattern, keys);
+    s = zsets_db_->ScanKeys(match, keys);
     if (!s.ok()) return s;
   } else if (data_type == DataType::kSets) {
-    s = sets_db_->ScanKeys(pattern, keys);
+    s = sets_db_->ScanKeys(match, keys);
     if (!s.ok()) return s;
   } else if (data_type == DataType::kLists) {
-    s = lists_db_->ScanKeys(pattern, keys);
+    s = lists_db_->ScanKeys(match, keys);
+    if (!s.ok()) return s;
+  } else if (data_type == DataType::kStreams) {
+    s = streams_db_->ScanKeys(match, keys);
     if (!s.ok()) return s;
   } else {
-    s = strings_db_->ScanKeys(pattern, keys);
+    s = strings_db_->ScanKeys(match, keys);
+    if (!s.ok()) return s;
+    s = hashes_db_->ScanKeys(match, keys);
     if (!s.ok()) return s;
-    s = hashes_db_->ScanKeys(pattern, keys);
+    s = zsets_db_->ScanKeys(match, keys);
     if (!s.ok()) return s;
-    s = zsets_db_->ScanKeys(pattern, keys);
+    s = sets_db_->ScanKeys(match, keys);
     if (!s.ok()) return s;
-    s = sets_db_->ScanKeys(pattern, keys);
+    s = lists_db_->ScanKeys(match, keys);
     if (!s.ok()) return s;
-    s = lists_db_->ScanKeys(pattern, keys);
+    s = streams_db_->ScanKeys(match, keys);
     if (!s.ok()) return s;
   }
+  if (IsKeyTagged()) {
+    StripSlotTags(keys, start_pos);
+  }
   return s;
 }
 
@@ -1448,16 +2527,196 @@ void BlackWidow::ScanDatabase(const DataType& type) {
     case kLists:
         lists_db_->ScanDatabase();
         break;
+    case kStreams:
+        streams_db_->ScanDatabase();
+        break;
     case kAll:
         strings_db_->ScanDatabase();
         hashes_db_->ScanDatabase();
         sets_db_->ScanDatabase();
         zsets_db_->ScanDatabase();
         lists_db_->ScanDatabase();
+        streams_db_->ScanDatabase();
         break;
   }
 }
 
+Status BlackWidow::SlotScan(const DataType& data_type, uint32_t slot,
+                            const std::string& start_key, int64_t count,
+                            std::vector<std::string>* keys,
+                            std::string* next_key) {
+  keys->clear();
+  next_key->clear();
+  if (!slot_tagged_keys_) {
+    return Status::NotSupported("slot_tagged_keys is disabled");
+  } else if (slot >= kClusterSlots) {
+    return Status::InvalidArgument("Invalid slot");
+  }
+
+  std::string slot_start = SlotStartKey(slot);
+  std::string slot_end = SlotStartKey(slot + 1);
+  std::string start_point;
+  if (!start_key.empty()) {
+    start_point = slot_start + start_key;
+  }
+  Status s;
+  switch (data_type) {
+    case DataType::kStrings:
+      s = strings_db_->ScanRangeKeys(slot_start, slot_end, start_point,
+                                     count, keys, next_key);
+      break;
+    case DataType::kHashes:
+      s = hashes_db_->ScanRangeKeys(slot_start, slot_end, start_point,
+                                    count, keys, next_key);
+      break;
+    case DataType::kLists:
+      s = lists_db_->ScanRangeKeys(slot_start, slot_end, start_point,
+                                   count, keys, next_key);
+      break;
+    case DataType::kZSets:
+      s = zsets_db_->ScanRangeKeys(slot_start, slot_end, start_point,
+                                   count, keys, next_key);
+      break;
+    case DataType::kSets:
+      s = sets_db_->ScanRangeKeys(slot_start, slot_end, start_point,
+                                  count, keys, next_key);
+      break;
+    case DataType::kStreams:
+      s = streams_db_->ScanRangeKeys(slot_start, slot_end, start_point,
+                                     count, keys, next_key);
+      break;
+    default:
+      return Status::InvalidArgument("Unsupported data type");
+  }
+  StripSlotTags(keys);
+  if (!next_key->empty()) {
+    next_key->erase(0, kSlotTagLength);
+  }
+  return s;
+}
+
+Status BlackWidow::SlotKeyCount(uint32_t slot, int64_t* count) {
+  *count = 0;
+  if (!slot_tagged_keys_) {
+    return Status::NotSupported("slot_tagged_keys is disabled");
+  } else if (slot >= kClusterSlots) {
+    return Status::InvalidArgument("Invalid slot");
+  }
+
+  int64_t type_count;
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs = dataset->dbs();
+  for (const auto& db : dbs) {
+    Status s = db->RangeKeyCount(SlotStartKey(slot), SlotStartKey(slot + 1),
+                                 &type_count);
+    if (!s.ok()) {
+      return s;
+    }
+    *count += type_count;
+  }
+  return Status::OK();
+}
+
+Status BlackWidow::DelSlot(uint32_t slot) {
+  if (IsReadOnly()) {
+    return Status::NotSupported("Not supported in read-only mode");
+  } else if (!slot_tagged_keys_) {
+    return Status::NotSupported("slot_tagged_keys is disabled");
+  } else if (slot >= kClusterSlots) {
+    return Status::InvalidArgument("Invalid slot");
+  }
+
+  // The counters of the slot keys must not outlive them
+  ScopeCounterWrite cw(counter_buffer_);
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs = dataset->dbs();
+  for (const auto& db : dbs) {
+    Status s = db->DelKeyRange(SlotStartKey(slot), SlotStartKey(slot + 1));
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  return Status::OK();
+}
+
+Status BlackWidow::Select(uint32_t db) {
+  if (db >= databases_) {
+    return Status::InvalidArgument("DB index is out of range");
+  }
+  if (databases_ > 1) {
+    pthread_setspecific(selected_db_key_,
+                        reinterpret_cast<void*>(static_cast<uintptr_t>(db)));
+  }
+  return Status::OK();
+}
+
+uint32_t BlackWidow::SelectedDB() const {
+  if (databases_ <= 1) {
+    return 0;
+  }
+  return static_cast<uint32_t>(
+      reinterpret_cast<uintptr_t>(pthread_getspecific(selected_db_key_)));
+}
+
+DBContext::DBContext(BlackWidow* bw, uint32_t db)
+    : bw_(bw),
+      former_db_(bw->SelectedDB()) {
+  status_ = bw_->Select(db);
+}
+
+DBContext::~DBContext() {
+  if (status_.ok()) {
+    bw_->Select(former_db_);
+  }
+}
+
+Status BlackWidow::FlushDB(uint32_t db) {
+  if (IsReadOnly()) {
+    return Status::NotSupported("Not supported in read-only mode");
+  } else if (databases_ <= 1) {
+    return Status::NotSupported("Only one database");
+  } else if (db >= databases_) {
+    return Status::InvalidArgument("DB index is out of range");
+  }
+
+  // The counters of the database keys must not outlive them
+  ScopeCounterWrite cw(counter_buffer_);
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs = dataset->dbs();
+  for (const auto& type_db : dbs) {
+    Status s = type_db->DelKeyRange(DBStartKey(db), DBStartKey(db + 1));
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  return Status::OK();
+}
+
+Status BlackWidow::DBSize(uint32_t db, int64_t* count) {
+  *count = 0;
+  if (db >= databases_) {
+    return Status::InvalidArgument("DB index is out of range");
+  }
+
+  int64_t type_count;
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs = dataset->dbs();
+  for (const auto& type_db : dbs) {
+    Status s;
+    if (databases_ > 1) {
+      s = type_db->RangeKeyCount(DBStartKey(db), DBStartKey(db + 1),
+                                 &type_count);
+    } else {
+      s = type_db->RangeKeyCount("", "", &type_count);
+    }
+    if (!s.ok()) {
+      return s;
+    }
+    *count += type_count;
+  }
+  return Status::OK();
+}
+
 // HyperLogLog
 Status BlackWidow::PfAdd(const Slice& key,
                          const std::vector<std::string>& values,
@@ -1468,7 +2727,9 @@ Status BlackWidow::PfAdd(const Slice& key,
   }
 
   std::string value, registers, result = "";
-  Status s = strings_db_->Get(key, &value);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kStrings, tagged_key);
+  Status s = strings_db_->Get(tagged_key, &value);
   if (s.ok()) {
     registers = value;
   } else if (s.IsNotFound()) {
@@ -1486,7 +2747,7 @@ Status BlackWidow::PfAdd(const Slice& key,
   if (previous != now || (s.IsNotFound() && values.size() == 0)) {
     *update = true;
   }
-  s = strings_db_->Set(key, result);
+  s = strings_db_->Set(tagged_key, result);
   return s;
 }
 
@@ -1496,8 +2757,11 @@ Status BlackWidow::PfCount(const std::vector<std::string>& keys,
     return Status::InvalidArgument("Invalid the number of key");
   }
 
+  std::vector<std::string> tagged_keys;
+  const std::vector<std::string>& store_keys = TagKeys(keys, &tagged_keys);
+  FlushBufferedCounters(kStrings, store_keys);
   std::string value, first_registers;
-  Status s = strings_db_->Get(keys[0], &value);
+  Status s = strings_db_->Get(store_keys[0], &value);
   if (s.ok()) {
     first_registers = std::string(value.data(), value.size());
   } else if (s.IsNotFound()) {
@@ -1507,7 +2771,7 @@ Status BlackWidow::PfCount(const std::vector<std::string>& keys,
   HyperLogLog first_log(kPrecision, first_registers);
   for (size_t i = 1; i < keys.size(); ++i) {
     std::string value, registers;
-    s = strings_db_->Get(keys[i], &value);
+    s = strings_db_->Get(store_keys[i], &value);
     if (s.ok()) {
       registers = value;
     } else if (s.IsNotFound()) {
@@ -1527,9 +2791,12 @@ Status BlackWidow::PfMerge(const std::vector<std::string>& keys) {
     return Status::InvalidArgument("Invalid the number of key");
   }
 
+  std::vector<std::string> tagged_keys;
+  const std::vector<std::string>& store_keys = TagKeys(keys, &tagged_keys);
+  ScopeCounterWrite cw(counter_buffer_, kStrings, store_keys);
   Status s;
   std::string value, first_registers, result;
-  s = strings_db_->Get(keys[0], &value);
+  s = strings_db_->Get(store_keys[0], &value);
   if (s.ok()) {
     first_registers = std::string(value.data(), value.size());
   } else if (s.IsNotFound()) {
@@ -1540,7 +2807,7 @@ Status BlackWidow::PfMerge(const std::vector<std::string>& keys) {
   HyperLogLog first_log(kPrecision, first_registers);
   for (size_t i = 1; i < keys.size(); ++i) {
     std::string value, registers;
-    s = strings_db_->Get(keys[i], &value);
+    s = strings_db_->Get(store_keys[i], &value);
     if (s.ok()) {
       registers = std::string(value.data(), value.size());
     } else if (s.IsNotFound()) {
@@ -1551,10 +2818,60 @@ Status BlackWidow::PfMerge(const std::vector<std::string>& keys) {
     HyperLogLog log(kPrecision, registers);
     result = first_log.Merge(log);
   }
-  s = strings_db_->Set(keys[0], result);
+  s = strings_db_->Set(store_keys[0], result);
+  return s;
+}
+
+// Bloom filter
+const double BlackWidow::kBloomDefaultErrorRate = 0.01;
+
+Status BlackWidow::BfReserve(const Slice& key, double error_rate,
+                             uint64_t capacity) {
+  BloomFilter filter(capacity, error_rate);
+  if (!filter.valid()) {
+    return Status::InvalidArgument("Invalid capacity or error rate");
+  }
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kHashes, tagged_key);
+  return hashes_db_->BfReserve(tagged_key, filter);
+}
+
+Status BlackWidow::BfAdd(const Slice& key, const std::string& member,
+                         int32_t* ret) {
+  std::vector<int32_t> rets;
+  Status s = BfMAdd(key, {member}, &rets);
+  *ret = rets.empty() ? 0 : rets[0];
+  return s;
+}
+
+Status BlackWidow::BfMAdd(const Slice& key,
+                          const std::vector<std::string>& members,
+                          std::vector<int32_t>* rets) {
+  BloomFilter default_filter(kBloomDefaultCapacity, kBloomDefaultErrorRate);
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  ScopeCounterWrite cw(counter_buffer_, kHashes, tagged_key);
+  return hashes_db_->BfAdd(tagged_key, members, default_filter, rets);
+}
+
+Status BlackWidow::BfExists(const Slice& key, const std::string& member,
+                            int32_t* ret) {
+  std::vector<int32_t> rets;
+  Status s = BfMExists(key, {member}, &rets);
+  *ret = rets.empty() ? 0 : rets[0];
   return s;
 }
 
+Status BlackWidow::BfMExists(const Slice& key,
+                             const std::vector<std::string>& members,
+                             std::vector<int32_t>* rets) {
+  key_detector_->RecordAccess(kHashes, key);
+  SlotTaggedKey tagged_key = TagKey(key);
+  FlushBufferedCounter(kHashes, tagged_key);
+  return hashes_db_->BfExists(tagged_key, members, rets);
+}
+
 static void* StartBGThreadWrapper(void* arg) {
   BlackWidow* bw = reinterpret_cast<BlackWidow*>(arg);
   bw->RunBGTask();
@@ -1608,12 +2925,18 @@ Status BlackWidow::RunBGTask() {
       DoCompact(task.type);
     } else if (task.operation == kCompactKey) {
       CompactKey(task.type, task.argv);
+    } else if (task.operation == kDropExpiredFiles && is_opened_) {
+      strings_db_->DropExpiredFiles();
     }
   }
   return Status::OK();
 }
 
 Status BlackWidow::Compact(const DataType& type, bool sync) {
+  if (IsReadOnly()) {
+    return Status::NotSupported("Not supported in read-only mode");
+  }
+
   if (sync) {
     return DoCompact(type);
   } else {
@@ -1628,7 +2951,8 @@ Status BlackWidow::DoCompact(const DataType& type) {
     && type != kHashes
     && type != kSets
     && type != kZSets
-    && type != kLists) {
+    && type != kLists
+    && type != kStreams) {
     return Status::InvalidArgument("");
   }
 
@@ -1648,6 +2972,9 @@ Status BlackWidow::DoCompact(const DataType& type) {
   } else if (type == kLists) {
     current_task_type_ = Operation::kCleanLists;
     s = lists_db_->CompactRange(NULL, NULL);
+  } else if (type == kStreams) {
+    current_task_type_ = Operation::kCleanStreams;
+    s = streams_db_->CompactRange(NULL, NULL);
   } else {
     current_task_type_ = Operation::kCleanAll;
     s = strings_db_->CompactRange(NULL, NULL);
@@ -1655,16 +2982,18 @@ Status BlackWidow::DoCompact(const DataType& type) {
     s = sets_db_->CompactRange(NULL, NULL);
     s = zsets_db_->CompactRange(NULL, NULL);
     s = lists_db_->CompactRange(NULL, NULL);
+    s = streams_db_->CompactRange(NULL, NULL);
   }
   current_task_type_ = Operation::kNone;
   return s;
 }
 
 Status BlackWidow::CompactKey(const DataType& type, const std::string& key) {
+  std::string tagged_key = TagKey(key).ToString();
   std::string meta_start_key, meta_end_key;
   std::string data_start_key, data_end_key;
-  CalculateMetaStartAndEndKey(key, &meta_start_key, &meta_end_key);
-  CalculateDataStartAndEndKey(key, &data_start_key, &data_end_key);
+  CalculateMetaStartAndEndKey(tagged_key, &meta_start_key, &meta_end_key);
+  CalculateDataStartAndEndKey(tagged_key, &data_start_key, &data_end_key);
   Slice slice_meta_begin(meta_start_key);
   Slice slice_meta_end(meta_end_key);
   Slice slice_data_begin(data_start_key);
@@ -1681,12 +3010,18 @@ Status BlackWidow::CompactKey(const DataType& type, const std::string& key) {
   } else if (type == kLists) {
     lists_db_->CompactRange(&slice_meta_begin, &slice_meta_end, kMeta);
     lists_db_->CompactRange(&slice_data_begin, &slice_data_end, kData);
+  } else if (type == kStreams) {
+    streams_db_->CompactRange(&slice_meta_begin, &slice_meta_end, kMeta);
+    streams_db_->CompactRange(&slice_data_begin, &slice_data_end, kData);
   }
   return Status::OK();
 }
 
 Status BlackWidow::SetMaxCacheStatisticKeys(uint32_t max_cache_statistic_keys) {
-  std::vector<Redis*> dbs = {sets_db_, zsets_db_, hashes_db_, lists_db_};
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs = {dataset->sets_db, dataset->zsets_db,
+                             dataset->hashes_db, dataset->lists_db,
+                             dataset->streams_db};
   for (const auto& db : dbs) {
     db->SetMaxCacheStatisticKeys(max_cache_statistic_keys);
   }
@@ -1694,7 +3029,10 @@ Status BlackWidow::SetMaxCacheStatisticKeys(uint32_t max_cache_statistic_keys) {
 }
 
 Status BlackWidow::SetSmallCompactionThreshold(uint32_t small_compaction_threshold) {
-  std::vector<Redis*> dbs = {sets_db_, zsets_db_, hashes_db_, lists_db_};
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs = {dataset->sets_db, dataset->zsets_db,
+                             dataset->hashes_db, dataset->lists_db,
+                             dataset->streams_db};
   for (const auto& db : dbs) {
     db->SetSmallCompactionThreshold(small_compaction_threshold);
   }
@@ -1716,6 +3054,8 @@ std::string BlackWidow::GetCurrentTaskType() {
       return "Set";
     case kCleanLists:
       return "List";
+    case kCleanStreams:
+      return "Stream";
     case kNone:
     default:
       return "No";
@@ -1735,6 +3075,7 @@ Status BlackWidow::GetUsage(const std::string& property,
   (*type_result)[LISTS_DB]   = GetProperty(LISTS_DB,   property);
   (*type_result)[ZSETS_DB]   = GetProperty(ZSETS_DB,   property);
   (*type_result)[SETS_DB]    = GetProperty(SETS_DB,    property);
+  (*type_result)[STREAMS_DB] = GetProperty(STREAMS_DB, property);
   return Status::OK();
 }
 
@@ -1761,14 +3102,20 @@ uint64_t BlackWidow::GetProperty(const std::string& db_type,
     sets_db_->GetProperty(property, &out);
     result += out;
   }
+  if (db_type == ALL_DB || db_type == STREAMS_DB) {
+    streams_db_->GetProperty(property, &out);
+    result += out;
+  }
   return result;
 }
 
 Status BlackWidow::GetKeyNum(std::vector<KeyInfo>* key_infos) {
   KeyInfo key_info;
-  // NOTE: keep the db order with string, hash, list, zset, set
-  std::vector<Redis*> dbs = {strings_db_, hashes_db_,
-    lists_db_, zsets_db_, sets_db_};
+  // NOTE: keep the db order with string, hash, list, zset, set, stream
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs = {dataset->strings_db, dataset->hashes_db,
+    dataset->lists_db, dataset->zsets_db, dataset->sets_db,
+    dataset->streams_db};
   for (const auto& db : dbs) {
     // check the scanner was stopped or not, before scanning the next db
     if (scan_keynum_exit_) {
@@ -1784,11 +3131,719 @@ Status BlackWidow::GetKeyNum(std::vector<KeyInfo>* key_infos) {
   return Status::OK();
 }
 
+static const size_t kMaxInconsistentKeys = 1000;
+// Split each meta column family into more ranges than workers, so that
+// the workers still busy at the end have small ranges left
+static const int32_t kCheckRangesPerThread = 4;
+
+struct ConsistencyCheckRange {
+  Redis* db;
+  const rocksdb::Snapshot* snapshot;
+  std::string start_key;
+  std::string end_key;
+};
+
+Status BlackWidow::CheckConsistency(const DataType& type, int32_t threads,
+                                    bool repair, ConsistencyReport* report) {
+  *report = ConsistencyReport();
+  if (repair && IsReadOnly()) {
+    return Status::NotSupported("Not supported in read-only mode");
+  } else if (threads <= 0) {
+    return Status::InvalidArgument("threads must be positive");
+  }
+
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs;
+  switch (type) {
+    case DataType::kHashes:
+      dbs.push_back(dataset->hashes_db);
+      break;
+    case DataType::kSets:
+      dbs.push_back(dataset->sets_db);
+      break;
+    case DataType::kLists:
+      dbs.push_back(dataset->lists_db);
+      break;
+    case DataType::kZSets:
+      dbs.push_back(dataset->zsets_db);
+      break;
+    case DataType::kStreams:
+      dbs.push_back(dataset->streams_db);
+      break;
+    case DataType::kAll:
+      dbs = {dataset->hashes_db, dataset->sets_db, dataset->lists_db,
+             dataset->zsets_db, dataset->streams_db};
+      break;
+    default:
+      return Status::InvalidArgument("Unsupported data type");
+  }
+
+  if (counter_buffer_ != nullptr) {
+    counter_buffer_->FlushAll();
+  }
+  std::vector<const rocksdb::Snapshot*> snapshots;
+  std::vector<ConsistencyCheckRange> ranges;
+  for (const auto& db : dbs) {
+    const rocksdb::Snapshot* snapshot = db->GetDB()->GetSnapshot();
+    snapshots.push_back(snapshot);
+    std::vector<std::string> boundaries;
+    db->SplitMetaRanges(threads * kCheckRangesPerThread, &boundaries);
+    std::string start_key;
+    for (const auto& boundary : boundaries) {
+      ranges.push_back({db, snapshot, start_key, boundary});
+      start_key = boundary;
+    }
+    ranges.push_back({db, snapshot, start_key, ""});
+  }
+
+  Status s;
+  slash::Mutex report_mutex;
+  std::atomic<size_t> next_range(0);
+  auto check_ranges = [&]() {
+    for (size_t idx = next_range++; idx < ranges.size(); idx = next_range++) {
+      ConsistencyReport range_report = ConsistencyReport();
+      const ConsistencyCheckRange& range = ranges[idx];
+      Status range_s = range.db->CheckConsistency(range.snapshot,
+          range.start_key, range.end_key, repair, &range_report);
+
+      slash::MutexLock l(&report_mutex);
+      if (!range_s.ok() && s.ok()) {
+        s = range_s;
+      }
+      report->checked_keys += range_report.checked_keys;
+      report->inconsistent_keys += range_report.inconsistent_keys;
+      report->repaired_keys += range_report.repaired_keys;
+      for (auto& sample : range_report.samples) {
+        if (report->samples.size() >= kMaxInconsistentKeys) {
+          break;
+        }
+        report->samples.push_back(std::move(sample));
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  size_t worker_num = std::min(static_cast<size_t>(threads), ranges.size());
+  for (size_t idx = 0; idx < worker_num; ++idx) {
+    workers.push_back(std::thread(check_ranges));
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  for (size_t idx = 0; idx < dbs.size(); ++idx) {
+    dbs[idx]->GetDB()->ReleaseSnapshot(snapshots[idx]);
+  }
+
+  if (IsKeyTagged()) {
+    for (auto& sample : report->samples) {
+      sample.key.erase(0, kSlotTagLength);
+    }
+  }
+  return s;
+}
+
+Status BlackWidow::GetTieredStorageStats(TieredStorageStats* stats) {
+  stats->tiers.clear();
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs = dataset->dbs();
+  for (const auto& db : dbs) {
+    db->GetStorageTierStats(&stats->tiers);
+  }
+
+  std::shared_ptr<rocksdb::Statistics> statistics =
+    strings_db_->GetDB()->GetDBOptions().statistics;
+  if (statistics) {
+    stats->block_cache_hits =
+      statistics->getTickerCount(rocksdb::BLOCK_CACHE_HIT);
+    stats->block_cache_misses =
+      statistics->getTickerCount(rocksdb::BLOCK_CACHE_MISS);
+    stats->secondary_cache_hits =
+      statistics->getTickerCount(rocksdb::PERSISTENT_CACHE_HIT);
+    stats->secondary_cache_misses =
+      statistics->getTickerCount(rocksdb::PERSISTENT_CACHE_MISS);
+  } else {
+    stats->block_cache_hits = 0;
+    stats->block_cache_misses = 0;
+    stats->secondary_cache_hits = 0;
+    stats->secondary_cache_misses = 0;
+  }
+  return Status::OK();
+}
+
 Status BlackWidow::StopScanKeyNum() {
   scan_keynum_exit_ = true;
   return Status::OK();
 }
 
+Status BlackWidow::GetUpdatesSince(const DataType& type,
+                                   uint64_t since_sequence,
+                                   int64_t count,
+                                   std::vector<ChangeRecord>* records,
+                                   uint64_t* next_sequence) {
+  records->clear();
+  Status s;
+  switch (type) {
+    case DataType::kStrings:
+      s = strings_db_->GetUpdatesSince(since_sequence, count,
+                                       records, next_sequence);
+      break;
+    case DataType::kHashes:
+      s = hashes_db_->GetUpdatesSince(since_sequence, count,
+                                      records, next_sequence);
+      break;
+    case DataType::kLists:
+      s = lists_db_->GetUpdatesSince(since_sequence, count,
+                                     records, next_sequence);
+      break;
+    case DataType::kZSets:
+      s = zsets_db_->GetUpdatesSince(since_sequence, count,
+                                     records, next_sequence);
+      break;
+    case DataType::kSets:
+      s = sets_db_->GetUpdatesSince(since_sequence, count,
+                                    records, next_sequence);
+      break;
+    case DataType::kStreams:
+      s = streams_db_->GetUpdatesSince(since_sequence, count,
+                                       records, next_sequence);
+      break;
+    default:
+      s = Status::Corruption("Unsupported data type");
+      break;
+  }
+  if (IsKeyTagged()) {
+    // The bounds of a range deletion are left as they are in the db
+    for (auto& record : *records) {
+      if (record.operation != kChangeDeleteRange) {
+        record.key.erase(0, kSlotTagLength);
+      }
+    }
+  }
+  return s;
+}
+
+Status BlackWidow::GetLatestSequenceNumber(const DataType& type,
+                                           uint64_t* sequence) {
+  switch (type) {
+    case DataType::kStrings:
+      *sequence = strings_db_->GetDB()->GetLatestSequenceNumber();
+      break;
+    case DataType::kHashes:
+      *sequence = hashes_db_->GetDB()->GetLatestSequenceNumber();
+      break;
+    case DataType::kLists:
+      *sequence = lists_db_->GetDB()->GetLatestSequenceNumber();
+      break;
+    case DataType::kZSets:
+      *sequence = zsets_db_->GetDB()->GetLatestSequenceNumber();
+      break;
+    case DataType::kSets:
+      *sequence = sets_db_->GetDB()->GetLatestSequenceNumber();
+      break;
+    case DataType::kStreams:
+      *sequence = streams_db_->GetDB()->GetLatestSequenceNumber();
+      break;
+    default:
+      return Status::Corruption("Unsupported data type");
+  }
+  return Status::OK();
+}
+
+Status BlackWidow::GetHotKeys(const DataType& type,
+                              std::vector<KeyCount>* hot_keys) {
+  if (type != kStrings
+    && type != kHashes
+    && type != kSets
+    && type != kZSets
+    && type != kLists
+    && type != kStreams) {
+    return Status::InvalidArgument("Unsupported data type");
+  }
+  key_detector_->GetHotKeys(type, hot_keys);
+  return Status::OK();
+}
+
+Status BlackWidow::GetBigKeys(const DataType& type,
+                              std::vector<KeyCount>* big_keys) {
+  if (type != kHashes
+    && type != kSets
+    && type != kZSets
+    && type != kLists
+    && type != kStreams) {
+    return Status::InvalidArgument("Unsupported data type");
+  }
+  key_detector_->GetBigKeys(type, big_keys);
+  return Status::OK();
+}
+
+static void* StartKeyDetectorThreadWrapper(void* arg) {
+  BlackWidow* bw = reinterpret_cast<BlackWidow*>(arg);
+  bw->RunKeyDetectorTask();
+  return NULL;
+}
+
+Status BlackWidow::StartKeyDetectorThread() {
+  int result = pthread_create(&key_detector_thread_id_,
+      NULL, StartKeyDetectorThreadWrapper, this);
+  if (result != 0) {
+    char msg[128];
+    snprintf(msg, sizeof(msg), "pthread create: %s", strerror(result));
+    return Status::Corruption(msg);
+  }
+  key_detector_thread_started_ = true;
+  return Status::OK();
+}
+
+// Scan the meta keys of every collection type batch by batch, one
+// round is a complete pass over the db of that type
+Status BlackWidow::RunKeyDetectorTask() {
+  static const int64_t kBigKeyScanBatch = 100000;
+  std::vector<DataType> types = {kHashes, kSets, kLists, kZSets, kStreams};
+  std::vector<std::string> start_keys(types.size());
+  std::vector<uint64_t> rounds(types.size(), 1);
+
+  Status s;
+  std::string next_key;
+  std::vector<KeyCount> big_keys;
+  while (!key_detector_should_exit_) {
+    key_detector_mutex_.Lock();
+    if (!key_detector_should_exit_) {
+      key_detector_cond_var_.TimedWait(key_detector_interval_ms_);
+    }
+    key_detector_mutex_.Unlock();
+
+    if (key_detector_should_exit_) {
+      return Status::Incomplete("key detector return with key_detector_should_exit true");
+    }
+
+    key_detector_->Decay();
+    if (big_key_threshold_ == 0) {
+      continue;
+    }
+
+    // A swapped dataset is released by the next round
+    std::shared_ptr<Dataset> dataset = CurrentDataset();
+    std::vector<Redis*> dbs = {dataset->hashes_db, dataset->sets_db,
+                               dataset->lists_db, dataset->zsets_db,
+                               dataset->streams_db};
+    for (size_t idx = 0; idx < dbs.size() && !key_detector_should_exit_; ++idx) {
+      big_keys.clear();
+      s = dbs[idx]->ScanBigKeys(start_keys[idx], kBigKeyScanBatch,
+                                big_key_threshold_, &big_keys, &next_key);
+      if (!s.ok()) {
+        continue;
+      }
+      for (const auto& big_key : big_keys) {
+        Slice key = IsKeyTagged() ? StripSlotTag(big_key.key)
+                                  : Slice(big_key.key);
+        key_detector_->RecordBigKey(types[idx], key,
+                                    big_key.count, rounds[idx]);
+      }
+      if (next_key.empty()) {
+        key_detector_->ExpireBigKeys(types[idx], rounds[idx]);
+        rounds[idx]++;
+      }
+      start_keys[idx] = next_key;
+    }
+  }
+  return Status::OK();
+}
+
+Status BlackWidow::BufferCounter(const DataType& type, const Slice& key) {
+  if (counter_buffer_ == nullptr) {
+    return Status::NotSupported("counter buffer is disabled");
+  } else if (type != kStrings && type != kHashes && type != kZSets) {
+    return Status::InvalidArgument("Unsupported data type");
+  }
+  counter_buffer_->Designate(type, TagKey(key));
+  return Status::OK();
+}
+
+Status BlackWidow::UnbufferCounter(const DataType& type, const Slice& key) {
+  if (counter_buffer_ == nullptr) {
+    return Status::NotSupported("counter buffer is disabled");
+  } else if (type != kStrings && type != kHashes && type != kZSets) {
+    return Status::InvalidArgument("Unsupported data type");
+  }
+  counter_buffer_->Undesignate(type, TagKey(key));
+  return Status::OK();
+}
+
+Status BlackWidow::GetCounterBufferStats(CounterBufferStats* stats) {
+  if (counter_buffer_ == nullptr) {
+    return Status::NotSupported("counter buffer is disabled");
+  }
+  counter_buffer_->GetStats(stats);
+  stats->flush_interval_ms = counter_flush_interval_ms_;
+  return Status::OK();
+}
+
+static void* StartCounterBufferThreadWrapper(void* arg) {
+  BlackWidow* bw = reinterpret_cast<BlackWidow*>(arg);
+  bw->RunCounterBufferTask();
+  return NULL;
+}
+
+Status BlackWidow::StartCounterBufferThread() {
+  int result = pthread_create(&counter_buffer_thread_id_,
+      NULL, StartCounterBufferThreadWrapper, this);
+  if (result != 0) {
+    char msg[128];
+    snprintf(msg, sizeof(msg), "pthread create: %s", strerror(result));
+    return Status::Corruption(msg);
+  }
+  counter_buffer_thread_started_ = true;
+  return Status::OK();
+}
+
+// Write the buffered increments every interval, and follow the hot keys
+// of the detector when buffer_hot_counters is set
+Status BlackWidow::RunCounterBufferTask() {
+  std::vector<DataType> types = {kStrings, kHashes, kZSets};
+  std::vector<KeyCount> hot_keys;
+  std::vector<std::string> tagged_keys;
+  while (!counter_buffer_should_exit_) {
+    counter_buffer_mutex_.Lock();
+    if (!counter_buffer_should_exit_) {
+      counter_buffer_cond_var_.TimedWait(counter_flush_interval_ms_);
+    }
+    counter_buffer_mutex_.Unlock();
+
+    if (counter_buffer_should_exit_) {
+      return Status::Incomplete("counter buffer return with counter_buffer_should_exit true");
+    }
+
+    if (buffer_hot_counters_) {
+      for (const auto& type : types) {
+        hot_keys.clear();
+        tagged_keys.clear();
+        key_detector_->GetHotKeys(type, &hot_keys);
+        for (const auto& hot_key : hot_keys) {
+          tagged_keys.push_back(TagKey(hot_key.key).ToString());
+        }
+        counter_buffer_->SetDetectedKeys(type, tagged_keys);
+      }
+    }
+    counter_buffer_->FlushAll();
+  }
+  return Status::OK();
+}
+
+Status BlackWidow::GetEvictionStats(EvictionStats* stats) {
+  if (!eviction_thread_started_) {
+    return Status::NotSupported("eviction is disabled");
+  }
+  stats->max_data_size = max_data_size_;
+  stats->data_size = data_size_;
+  stats->evicted_keys = evicted_keys_;
+  stats->evicted_bytes = evicted_bytes_;
+  stats->eviction_rounds = eviction_rounds_;
+  return Status::OK();
+}
+
+static void* StartEvictionThreadWrapper(void* arg) {
+  BlackWidow* bw = reinterpret_cast<BlackWidow*>(arg);
+  bw->RunEvictionTask();
+  return NULL;
+}
+
+Status BlackWidow::StartEvictionThread() {
+  int result = pthread_create(&eviction_thread_id_,
+      NULL, StartEvictionThreadWrapper, this);
+  if (result != 0) {
+    char msg[128];
+    snprintf(msg, sizeof(msg), "pthread create: %s", strerror(result));
+    return Status::Corruption(msg);
+  }
+  eviction_thread_started_ = true;
+  return Status::OK();
+}
+
+// The deleted entries only leave the live data size once compacted away,
+// until then the bytes evicted are taken as freed already, and given back
+// as the data size shrinks
+Status BlackWidow::RunEvictionTask() {
+  std::vector<std::string> cursors(6);
+  uint64_t last_data_size = 0;
+  uint64_t pending_bytes = 0;
+  while (!eviction_should_exit_) {
+    eviction_mutex_.Lock();
+    if (!eviction_should_exit_) {
+      eviction_cond_var_.TimedWait(eviction_interval_ms_);
+    }
+    eviction_mutex_.Unlock();
+
+    if (eviction_should_exit_) {
+      return Status::Incomplete("eviction return with eviction_should_exit true");
+    }
+
+    uint64_t data_size = GetProperty(ALL_DB, "rocksdb.estimate-live-data-size")
+      + GetProperty(ALL_DB, "rocksdb.cur-size-all-mem-tables");
+    data_size_ = data_size;
+    if (data_size < last_data_size) {
+      pending_bytes -= std::min(pending_bytes, last_data_size - data_size);
+    }
+    last_data_size = data_size;
+    if (data_size <= max_data_size_ + pending_bytes) {
+      continue;
+    }
+
+    eviction_rounds_++;
+    pending_bytes += EvictKeys(data_size - max_data_size_ - pending_bytes,
+                               &cursors);
+  }
+  return Status::OK();
+}
+
+namespace {
+struct EvictionCandidate {
+  size_t db_idx;
+  std::string key;
+  uint64_t entries;
+  // The higher the sooner evicted
+  uint64_t rank;
+};
+}  // namespace
+
+// Sample every type db in turn from its cursor and keep the best victims
+// of all the samples in a small pool, as the redis approximated LRU
+uint64_t BlackWidow::EvictKeys(uint64_t bytes_to_free,
+                               std::vector<std::string>* cursors) {
+  static const size_t kEvictionPoolSize = 16;
+  static const size_t kMaxEvictionsPerRound = 10000;
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs = dataset->dbs();
+  std::vector<DataType> types = {kStrings, kHashes, kSets, kLists, kZSets,
+                                 kStreams};
+
+  // Take the entries of one db as the same size
+  std::vector<uint64_t> entry_bytes(dbs.size());
+  for (size_t idx = 0; idx < dbs.size(); ++idx) {
+    uint64_t size = 0, entries = 0, out = 0;
+    dbs[idx]->GetProperty("rocksdb.estimate-live-data-size", &out);
+    size += out;
+    dbs[idx]->GetProperty("rocksdb.cur-size-all-mem-tables", &out);
+    size += out;
+    dbs[idx]->GetProperty("rocksdb.estimate-num-keys", &out);
+    entries = out;
+    entry_bytes[idx] = size / std::max<uint64_t>(entries, 1);
+  }
+
+  Status s;
+  uint64_t freed = 0;
+  std::string next_key;
+  std::vector<KeyCount> samples;
+  std::vector<EvictionCandidate> pool;
+  for (size_t evictions = 0;
+       freed < bytes_to_free && evictions < kMaxEvictionsPerRound
+         && !eviction_should_exit_;
+       ++evictions) {
+    for (size_t idx = 0; idx < dbs.size(); ++idx) {
+      samples.clear();
+      s = dbs[idx]->SampleKeys((*cursors)[idx], eviction_samples_,
+                               &samples, &next_key);
+      if (!s.ok()) {
+        continue;
+      }
+      (*cursors)[idx] = next_key;
+      for (const auto& sample : samples) {
+        Slice key = IsKeyTagged() ? StripSlotTag(sample.key)
+                                  : Slice(sample.key);
+        uint64_t rank = access_clock_->IdleSeconds(types[idx], key);
+        if (eviction_policy_ == kEvictLFU) {
+          rank += static_cast<uint64_t>(
+              256 - access_clock_->Frequency(types[idx], key)) << 24;
+        }
+        auto iter = std::find_if(pool.begin(), pool.end(),
+            [&](const EvictionCandidate& candidate) {
+              return candidate.db_idx == idx && candidate.key == sample.key;
+            });
+        if (iter == pool.end()) {
+          pool.push_back({idx, sample.key, sample.count, rank});
+        }
+      }
+    }
+    if (pool.empty()) {
+      break;
+    }
+    std::sort(pool.begin(), pool.end(),
+        [](const EvictionCandidate& a, const EvictionCandidate& b) {
+          return a.rank > b.rank;
+        });
+    if (pool.size() > kEvictionPoolSize) {
+      pool.resize(kEvictionPoolSize);
+    }
+
+    EvictionCandidate victim = pool.front();
+    pool.erase(pool.begin());
+    ScopeCounterWrite cw(counter_buffer_, types[victim.db_idx], victim.key);
+    s = dbs[victim.db_idx]->Del(victim.key);
+    if (s.ok()) {
+      uint64_t bytes = victim.entries * entry_bytes[victim.db_idx];
+      freed += bytes;
+      evicted_keys_++;
+      evicted_bytes_ += bytes;
+    }
+  }
+  return freed;
+}
+
+Status BlackWidow::GetWritePressure(const DataType& type,
+                                    WritePressureStats* stats) {
+  if (IsReadOnly()) {
+    return Status::NotSupported("Not supported in read-only mode");
+  }
+
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs;
+  switch (type) {
+    case DataType::kStrings:
+      dbs.push_back(dataset->strings_db);
+      break;
+    case DataType::kHashes:
+      dbs.push_back(dataset->hashes_db);
+      break;
+    case DataType::kSets:
+      dbs.push_back(dataset->sets_db);
+      break;
+    case DataType::kLists:
+      dbs.push_back(dataset->lists_db);
+      break;
+    case DataType::kZSets:
+      dbs.push_back(dataset->zsets_db);
+      break;
+    case DataType::kStreams:
+      dbs.push_back(dataset->streams_db);
+      break;
+    case DataType::kAll:
+      dbs = dataset->dbs();
+      break;
+    default:
+      return Status::InvalidArgument("Unsupported data type");
+  }
+
+  *stats = WritePressureStats();
+  for (const auto& db : dbs) {
+    WritePressureStats db_stats;
+    Status s = db->GetWritePressure(&db_stats);
+    if (!s.ok()) {
+      return s;
+    }
+    if (db_stats.pressure == kWritePressureNormal
+      && db_stats.slowdown_ratio >= write_pressure_ratio_) {
+      db_stats.pressure = kWritePressureHigh;
+    }
+    stats->pressure = std::max(stats->pressure, db_stats.pressure);
+    stats->slowdown_ratio = std::max(stats->slowdown_ratio,
+                                     db_stats.slowdown_ratio);
+    stats->l0_files = std::max(stats->l0_files, db_stats.l0_files);
+    stats->pending_compaction_bytes = std::max(
+        stats->pending_compaction_bytes, db_stats.pending_compaction_bytes);
+    stats->immutable_memtables = std::max(stats->immutable_memtables,
+                                          db_stats.immutable_memtables);
+    stats->stalls += db_stats.stalls;
+  }
+  return Status::OK();
+}
+
+static void* StartCatchUpThreadWrapper(void* arg) {
+  BlackWidow* bw = reinterpret_cast<BlackWidow*>(arg);
+  bw->RunCatchUpTask();
+  return NULL;
+}
+
+Status BlackWidow::StartCatchUpThread() {
+  int result = pthread_create(&catch_up_thread_id_,
+      NULL, StartCatchUpThreadWrapper, this);
+  if (result != 0) {
+    char msg[128];
+    snprintf(msg, sizeof(msg), "pthread create: %s", strerror(result));
+    return Status::Corruption(msg);
+  }
+  catch_up_thread_started_ = true;
+  return Status::OK();
+}
+
+Status BlackWidow::RunCatchUpTask() {
+  Status s;
+  while (!catch_up_should_exit_) {
+    catch_up_mutex_.Lock();
+    if (!catch_up_should_exit_) {
+      catch_up_cond_var_.TimedWait(catch_up_interval_ms_);
+    }
+    catch_up_mutex_.Unlock();
+
+    if (catch_up_should_exit_) {
+      return Status::Incomplete("catch up return with catch_up_should_exit true");
+    }
+
+    s = TryCatchUpWithPrimary();
+    if (!s.ok()) {
+      fprintf(stderr,
+          "catch up with primary failed, %s\n", s.ToString().c_str());
+    }
+  }
+  return Status::OK();
+}
+
+Status BlackWidow::TryCatchUpWithPrimary() {
+  if (open_mode_ != kOpenSecondary) {
+    return Status::NotSupported("Not opened as secondary instance");
+  }
+
+  Status s;
+  std::shared_ptr<Dataset> dataset = CurrentDataset();
+  std::vector<Redis*> dbs = dataset->dbs();
+  for (const auto& db : dbs) {
+    s = db->TryCatchUpWithPrimary();
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  return Status::OK();
+}
+
+Status BlackWidow::SwapDataset(const std::string& db_path) {
+  if (open_mode_ != kOpenServing) {
+    return Status::NotSupported("Not opened in serving mode");
+  }
+
+  slash::MutexLock l(&serving_mutex_);
+  std::shared_ptr<Dataset> dataset = std::make_shared<Dataset>();
+  dataset->strings_db = new RedisStrings(this, kStrings);
+  dataset->hashes_db = new RedisHashes(this, kHashes);
+  dataset->sets_db = new RedisSets(this, kSets);
+  dataset->lists_db = new RedisLists(this, kLists);
+  dataset->zsets_db = new RedisZSets(this, kZSets);
+  dataset->streams_db = new RedisStreams(this, kStreams);
+  std::vector<Redis*> dbs = dataset->dbs();
+  std::vector<std::string> sub_dbs = {"strings", "hashes", "sets",
+                                      "lists", "zsets", "streams"};
+  Status s;
+  for (size_t idx = 0; idx < dbs.size() && s.ok(); ++idx) {
+    s = dbs[idx]->Open(serving_options_,
+                       AppendSubDirectory(db_path, sub_dbs[idx]));
+  }
+  if (!s.ok()) {
+    return s;
+  }
+
+  // The commands started before the swap keep the former dataset, it is
+  // closed by the last of them
+  std::atomic_store(&dataset_, dataset);
+  return Status::OK();
+}
+
+std::shared_ptr<BlackWidow::Dataset> BlackWidow::CurrentDataset() const {
+  if (open_mode_ != kOpenServing) {
+    return dataset_;
+  }
+  return std::atomic_load(&dataset_);
+}
+
+bool BlackWidow::IsReadOnly() const {
+  return open_mode_ != kOpenReadWrite;
+}
+
 rocksdb::DB* BlackWidow::GetDBByType(const std::string& type) {
   if (type == STRINGS_DB) {
     return strings_db_->GetDB();
@@ -1800,6 +3855,8 @@ rocksdb::DB* BlackWidow::GetDBByType(const std::string& type) {
     return sets_db_->GetDB();
   } else if (type == ZSETS_DB) {
     return zsets_db_->GetDB();
+  } else if (type == STREAMS_DB) {
+    return streams_db_->GetDB();
   } else {
     return NULL;
   }
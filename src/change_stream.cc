@@ -0,0 +1,148 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/change_stream.h"
+
+#include "blackwidow/util.h"
+#include "src/coding.h"
+#include "src/strings_value_format.h"
+#include "src/base_meta_value_format.h"
+#include "src/lists_meta_value_format.h"
+#include "src/base_data_key_format.h"
+#include "src/lists_data_key_format.h"
+#include "src/streams_meta_value_format.h"
+#include "src/streams_data_key_format.h"
+
+namespace blackwidow {
+
+static const uint32_t kMetaColumnFamilyId = 0;
+static const uint32_t kDataColumnFamilyId = 1;
+
+bool ChangeBatchHandler::DecodeKey(uint32_t column_family_id,
+                                   const rocksdb::Slice& key,
+                                   ChangeRecord* record) {
+  record->type = type_;
+  // The strings with ttl may live in ttl_cf
+  if (column_family_id == kMetaColumnFamilyId || type_ == kStrings) {
+    record->cf_type = kMeta;
+    record->key = key.ToString();
+    return true;
+  } else if (column_family_id != kDataColumnFamilyId) {
+    return false;
+  }
+
+  record->cf_type = kData;
+  if (type_ == kLists) {
+    ParsedListsDataKey parsed_lists_data_key(key);
+    record->key = parsed_lists_data_key.key().ToString();
+    record->version = parsed_lists_data_key.version();
+    record->field = std::to_string(parsed_lists_data_key.index());
+  } else if (type_ == kStreams) {
+    ParsedStreamsDataKey parsed_streams_data_key(key);
+    record->key = parsed_streams_data_key.key().ToString();
+    record->version = parsed_streams_data_key.version();
+    record->field = parsed_streams_data_key.id().ToString();
+  } else {
+    ParsedBaseDataKey parsed_base_data_key(key);
+    record->key = parsed_base_data_key.key().ToString();
+    record->version = parsed_base_data_key.version();
+    record->field = parsed_base_data_key.data().ToString();
+  }
+  return true;
+}
+
+void ChangeBatchHandler::DecodeValue(uint32_t column_family_id,
+                                     const rocksdb::Slice& value,
+                                     ChangeRecord* record) {
+  if (column_family_id == kMetaColumnFamilyId || type_ == kStrings) {
+    if (type_ == kStrings) {
+      ParsedStringsValue parsed_strings_value(value);
+      record->value = parsed_strings_value.user_value().ToString();
+      record->timestamp = parsed_strings_value.timestamp();
+    } else if (type_ == kLists) {
+      ParsedListsMetaValue parsed_lists_meta_value(value);
+      record->value = std::to_string(parsed_lists_meta_value.count());
+      record->version = parsed_lists_meta_value.version();
+      record->timestamp = parsed_lists_meta_value.timestamp();
+    } else if (type_ == kStreams) {
+      ParsedStreamsMetaValue parsed_streams_meta_value(value);
+      record->value = std::to_string(parsed_streams_meta_value.count());
+      record->version = parsed_streams_meta_value.version();
+      record->timestamp = parsed_streams_meta_value.timestamp();
+    } else {
+      ParsedBaseMetaValue parsed_base_meta_value(value);
+      record->value = std::to_string(parsed_base_meta_value.count());
+      record->version = parsed_base_meta_value.version();
+      record->timestamp = parsed_base_meta_value.timestamp();
+    }
+  } else if (type_ == kZSets) {
+    uint64_t tmp = DecodeFixed64(value.data());
+    const void* ptr_tmp = reinterpret_cast<const void*>(&tmp);
+    double score = *reinterpret_cast<const double*>(ptr_tmp);
+    char buf[32];
+    int len = DoubleToStr(buf, sizeof(buf), score);
+    record->value.assign(buf, len);
+  } else {
+    record->value = value.ToString();
+  }
+}
+
+void ChangeBatchHandler::Append(bool decoded, ChangeRecord* record) {
+  record->sequence = sequence_++;
+  if (decoded && record->sequence >= since_sequence_) {
+    records_->push_back(*record);
+  }
+}
+
+rocksdb::Status ChangeBatchHandler::PutCF(uint32_t column_family_id,
+                                          const rocksdb::Slice& key,
+                                          const rocksdb::Slice& value) {
+  ChangeRecord record;
+  record.operation = kChangePut;
+  bool decoded = DecodeKey(column_family_id, key, &record);
+  if (decoded) {
+    DecodeValue(column_family_id, value, &record);
+  }
+  Append(decoded, &record);
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status ChangeBatchHandler::DeleteCF(uint32_t column_family_id,
+                                             const rocksdb::Slice& key) {
+  ChangeRecord record;
+  record.operation = kChangeDelete;
+  bool decoded = DecodeKey(column_family_id, key, &record);
+  Append(decoded, &record);
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status ChangeBatchHandler::SingleDeleteCF(uint32_t column_family_id,
+                                                   const rocksdb::Slice& key) {
+  return DeleteCF(column_family_id, key);
+}
+
+// The range bounds are the raw keys of the column family
+rocksdb::Status ChangeBatchHandler::DeleteRangeCF(uint32_t column_family_id,
+                                                  const rocksdb::Slice& begin_key,
+                                                  const rocksdb::Slice& end_key) {
+  ChangeRecord record;
+  record.type = type_;
+  record.cf_type = column_family_id == kMetaColumnFamilyId
+    || type_ == kStrings ? kMeta : kData;
+  record.operation = kChangeDeleteRange;
+  record.key = begin_key.ToString();
+  record.field = end_key.ToString();
+  Append(column_family_id <= kDataColumnFamilyId, &record);
+  return rocksdb::Status::OK();
+}
+
+// Blackwidow never writes merge operands
+rocksdb::Status ChangeBatchHandler::MergeCF(uint32_t column_family_id,
+                                            const rocksdb::Slice& key,
+                                            const rocksdb::Slice& value) {
+  return rocksdb::Status::NotSupported("Merge operand in change stream");
+}
+
+}  //  namespace blackwidow
@@ -0,0 +1,64 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_CHANGE_STREAM_H_
+#define SRC_CHANGE_STREAM_H_
+
+#include <string>
+#include <vector>
+
+#include "rocksdb/status.h"
+#include "rocksdb/slice.h"
+#include "rocksdb/write_batch.h"
+
+#include "blackwidow/blackwidow.h"
+
+namespace blackwidow {
+
+// Decode the WriteBatch of one type db back into ChangeRecords,
+// every operation in the batch consumes one sequence number, the
+// operations before since_sequence have been delivered already
+class ChangeBatchHandler : public rocksdb::WriteBatch::Handler {
+ public:
+  ChangeBatchHandler(const DataType& type,
+                     uint64_t batch_sequence,
+                     uint64_t since_sequence,
+                     std::vector<ChangeRecord>* records)
+      : type_(type),
+        sequence_(batch_sequence),
+        since_sequence_(since_sequence),
+        records_(records) {}
+
+  rocksdb::Status PutCF(uint32_t column_family_id,
+                        const rocksdb::Slice& key,
+                        const rocksdb::Slice& value) override;
+  rocksdb::Status DeleteCF(uint32_t column_family_id,
+                           const rocksdb::Slice& key) override;
+  rocksdb::Status SingleDeleteCF(uint32_t column_family_id,
+                                 const rocksdb::Slice& key) override;
+  rocksdb::Status DeleteRangeCF(uint32_t column_family_id,
+                                const rocksdb::Slice& begin_key,
+                                const rocksdb::Slice& end_key) override;
+  rocksdb::Status MergeCF(uint32_t column_family_id,
+                          const rocksdb::Slice& key,
+                          const rocksdb::Slice& value) override;
+
+ private:
+  DataType type_;
+  uint64_t sequence_;
+  uint64_t since_sequence_;
+  std::vector<ChangeRecord>* records_;
+
+  // Fill the key part of record, return false if the column family
+  // only holds a redundant index (zsets score_cf)
+  bool DecodeKey(uint32_t column_family_id, const rocksdb::Slice& key,
+                 ChangeRecord* record);
+  void DecodeValue(uint32_t column_family_id, const rocksdb::Slice& value,
+                   ChangeRecord* record);
+  void Append(bool decoded, ChangeRecord* record);
+};
+
+}  //  namespace blackwidow
+#endif  //  SRC_CHANGE_STREAM_H_
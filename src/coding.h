@@ -11,6 +11,9 @@
 #define BLACKWIDOW_PLATFORM_IS_LITTLE_ENDIAN (__BYTE_ORDER == __LITTLE_ENDIAN)
 #endif
 #include <string.h>
+#include <string>
+
+#include "rocksdb/slice.h"
 
 namespace blackwidow {
   static const bool kLittleEndian = BLACKWIDOW_PLATFORM_IS_LITTLE_ENDIAN;
@@ -69,5 +72,50 @@ inline uint64_t DecodeFixed64(const char* ptr) {
   }
 }
 
+inline void PutVarint64(std::string* dst, uint64_t value) {
+  char buf[10];
+  size_t len = 0;
+  while (value >= 128) {
+    buf[len++] = static_cast<char>(value | 128);
+    value >>= 7;
+  }
+  buf[len++] = static_cast<char>(value);
+  dst->append(buf, len);
+}
+
+// Consume one varint from the front of input
+inline bool GetVarint64(rocksdb::Slice* input, uint64_t* value) {
+  uint64_t result = 0;
+  for (uint32_t shift = 0; shift <= 63 && !input->empty(); shift += 7) {
+    uint64_t byte = static_cast<unsigned char>((*input)[0]);
+    input->remove_prefix(1);
+    if (byte & 128) {
+      result |= ((byte & 127) << shift);
+    } else {
+      result |= (byte << shift);
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+inline void PutLengthPrefixedSlice(std::string* dst,
+                                   const rocksdb::Slice& value) {
+  PutVarint64(dst, value.size());
+  dst->append(value.data(), value.size());
+}
+
+inline bool GetLengthPrefixedSlice(rocksdb::Slice* input,
+                                   rocksdb::Slice* result) {
+  uint64_t len;
+  if (GetVarint64(input, &len) && input->size() >= len) {
+    *result = rocksdb::Slice(input->data(), len);
+    input->remove_prefix(len);
+    return true;
+  }
+  return false;
+}
+
 }  // namespace blackwidow
 #endif  // SRC_CODING_H_
@@ -0,0 +1,514 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/counter_buffer.h"
+
+#include <climits>
+#include <algorithm>
+#include <unordered_set>
+
+#include "rocksdb/env.h"
+#include "blackwidow/util.h"
+#include "src/murmurhash.h"
+#include "src/base_value_format.h"
+#include "src/redis_strings.h"
+#include "src/redis_hashes.h"
+#include "src/redis_zsets.h"
+
+namespace blackwidow {
+
+// The type tag keeps the same key of different types apart
+static std::string BufferKey(const DataType& type, const Slice& key) {
+  std::string buffer_key(1, DataTypeTag[type]);
+  buffer_key.append(key.data(), key.size());
+  return buffer_key;
+}
+
+static bool Overflow(int64_t ival, int64_t value) {
+  return (value >= 0 && LLONG_MAX - value < ival) ||
+         (value < 0 && LLONG_MIN - value > ival);
+}
+
+CounterBuffer::CounterBuffer(RedisStrings* strings_db,
+                             RedisHashes* hashes_db,
+                             RedisZSets* zsets_db)
+    : strings_db_(strings_db),
+      hashes_db_(hashes_db),
+      zsets_db_(zsets_db),
+      flushed_increments_(0),
+      flush_errors_(0) {
+}
+
+CounterBuffer::~CounterBuffer() {
+}
+
+CounterBuffer::Shard* CounterBuffer::GetShard(const std::string& buffer_key) {
+  uint64_t hash = MurmurHash(buffer_key.data(),
+                             static_cast<int>(buffer_key.size()), 0);
+  return &shards_[hash % kShardNum];
+}
+
+CounterBuffer::BufferedKey* CounterBuffer::FindKey(
+    Shard* shard, const std::string& buffer_key) {
+  auto iter = shard->keys.find(buffer_key);
+  if (shard->fences != 0 || iter == shard->keys.end()
+    || (!iter->second.designated && !iter->second.detected)
+    || iter->second.writers != 0) {
+    return nullptr;
+  }
+  return &iter->second;
+}
+
+bool CounterBuffer::IsExpired(const Counter& counter) {
+  if (counter.timestamp == 0) {
+    return false;
+  }
+  int64_t unix_time;
+  rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+  return counter.timestamp < unix_time;
+}
+
+// The counter is loaded with the stored value the first time, nullptr
+// when the stored value is not a number of the counter. Once the stored
+// key expired, the counter and the increments it still holds are dropped
+// with it and the counter starts over from the stored value
+CounterBuffer::Counter* CounterBuffer::LoadCounter(BufferedKey* buffered_key,
+                                                   const DataType& type,
+                                                   const Slice& key,
+                                                   const std::string& field) {
+  auto iter = buffered_key->counters.find(field);
+  if (iter != buffered_key->counters.end()) {
+    if (!IsExpired(iter->second)) {
+      return &iter->second;
+    }
+    buffered_key->counters.erase(iter);
+  }
+
+  int64_t ttl;
+  Status s;
+  Counter counter = {0, 0, 0, 0, 0, 0, 0};
+  if (type == kStrings) {
+    s = strings_db_->TTL(key, &ttl);
+  } else if (type == kHashes) {
+    s = hashes_db_->TTL(key, &ttl);
+  } else {
+    s = zsets_db_->TTL(key, &ttl);
+  }
+  if (s.ok() && ttl > 0) {
+    counter.timestamp = TimestampAfter(static_cast<int32_t>(ttl));
+  } else if (!s.ok() && !s.IsNotFound()) {
+    return nullptr;
+  }
+
+  if (type == kZSets) {
+    s = zsets_db_->ZScore(key, field, &counter.float_base);
+  } else {
+    std::string value;
+    if (type == kStrings) {
+      s = strings_db_->Get(key, &value);
+    } else {
+      s = hashes_db_->HGet(key, field, &value);
+    }
+    if (s.ok()
+      && !StrToInt64(value.data(), value.size(), &counter.base)) {
+      return nullptr;
+    }
+  }
+  if (!s.ok() && !s.IsNotFound()) {
+    return nullptr;
+  }
+  return &(buffered_key->counters[field] = counter);
+}
+
+void CounterBuffer::MarkDirty(Counter* counter) {
+  if (counter->increments++ == 0) {
+    counter->dirty_since = rocksdb::Env::Default()->NowMicros();
+  }
+}
+
+bool CounterBuffer::FlushCounter(const DataType& type, const Slice& key,
+                                 const std::string& field, Counter* counter) {
+  if (counter->increments == 0) {
+    return true;
+  } else if (IsExpired(*counter)) {
+    // The increments went to the key which expired since
+    counter->delta = 0;
+    counter->float_delta = 0;
+    counter->increments = 0;
+    return true;
+  }
+  Status s;
+  if (type == kStrings) {
+    s = strings_db_->Incrby(key, counter->delta, &counter->base);
+  } else if (type == kHashes) {
+    s = hashes_db_->HIncrby(key, field, counter->delta, &counter->base);
+  } else {
+    s = zsets_db_->ZIncrby(key, field, counter->float_delta,
+                           &counter->float_base);
+  }
+  if (!s.ok()) {
+    // Left in the buffer for the next flush, increments commute
+    flush_errors_++;
+    fprintf(stderr, "flush buffered counter failed, %s\n",
+            s.ToString().c_str());
+    return false;
+  }
+  flushed_increments_ += counter->increments;
+  counter->delta = 0;
+  counter->float_delta = 0;
+  counter->increments = 0;
+  return true;
+}
+
+bool CounterBuffer::FlushKey(const std::string& buffer_key,
+                             BufferedKey* buffered_key,
+                             bool erase_counters) {
+  DataType type = kStrings;
+  if (buffer_key[0] == DataTypeTag[kHashes]) {
+    type = kHashes;
+  } else if (buffer_key[0] == DataTypeTag[kZSets]) {
+    type = kZSets;
+  }
+  Slice key(buffer_key.data() + 1, buffer_key.size() - 1);
+
+  bool flushed = true;
+  auto iter = buffered_key->counters.begin();
+  while (iter != buffered_key->counters.end()) {
+    if (!FlushCounter(type, key, iter->first, &iter->second)) {
+      flushed = false;
+      ++iter;
+    } else if (erase_counters) {
+      iter = buffered_key->counters.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  return flushed;
+}
+
+void CounterBuffer::Designate(const DataType& type, const Slice& key) {
+  std::string buffer_key = BufferKey(type, key);
+  Shard* shard = GetShard(buffer_key);
+  slash::MutexLock l(&shard->mutex);
+  shard->keys[buffer_key].designated = true;
+}
+
+void CounterBuffer::Undesignate(const DataType& type, const Slice& key) {
+  std::string buffer_key = BufferKey(type, key);
+  Shard* shard = GetShard(buffer_key);
+  slash::MutexLock l(&shard->mutex);
+  auto iter = shard->keys.find(buffer_key);
+  if (iter == shard->keys.end()) {
+    return;
+  }
+  iter->second.designated = false;
+  if (!iter->second.detected
+    && FlushKey(buffer_key, &iter->second, true)
+    && iter->second.writers == 0) {
+    shard->keys.erase(iter);
+  }
+}
+
+void CounterBuffer::SetDetectedKeys(const DataType& type,
+                                    const std::vector<std::string>& keys) {
+  std::unordered_set<std::string> detected_keys;
+  for (const auto& key : keys) {
+    detected_keys.insert(BufferKey(type, key));
+  }
+
+  for (uint32_t idx = 0; idx < kShardNum; ++idx) {
+    slash::MutexLock l(&shards_[idx].mutex);
+    auto iter = shards_[idx].keys.begin();
+    while (iter != shards_[idx].keys.end()) {
+      if (iter->first[0] != DataTypeTag[type]
+        || !iter->second.detected
+        || detected_keys.count(iter->first)) {
+        ++iter;
+        continue;
+      }
+      iter->second.detected = false;
+      if (!iter->second.designated
+        && FlushKey(iter->first, &iter->second, true)
+        && iter->second.writers == 0) {
+        iter = shards_[idx].keys.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+  }
+
+  for (const auto& buffer_key : detected_keys) {
+    Shard* shard = GetShard(buffer_key);
+    slash::MutexLock l(&shard->mutex);
+    shard->keys[buffer_key].detected = true;
+  }
+}
+
+bool CounterBuffer::Incrby(const Slice& key, int64_t value, int64_t* ret) {
+  return IncrbyCounter(kStrings, key, Slice(), value, ret);
+}
+
+bool CounterBuffer::HIncrby(const Slice& key, const Slice& field,
+                            int64_t value, int64_t* ret) {
+  return IncrbyCounter(kHashes, key, field, value, ret);
+}
+
+bool CounterBuffer::IncrbyCounter(const DataType& type, const Slice& key,
+                                  const Slice& field, int64_t value,
+                                  int64_t* ret) {
+  std::string buffer_key = BufferKey(type, key);
+  Shard* shard = GetShard(buffer_key);
+  slash::MutexLock l(&shard->mutex);
+  BufferedKey* buffered_key = FindKey(shard, buffer_key);
+  if (buffered_key == nullptr) {
+    return false;
+  }
+  std::string counter_field = field.ToString();
+  Counter* counter = LoadCounter(buffered_key, type, key, counter_field);
+  if (counter == nullptr) {
+    return false;
+  }
+
+  // Near the limits the delta is written first, the caller reports the
+  // overflow of the stored value
+  if (Overflow(counter->base + counter->delta, value)
+    || Overflow(counter->delta, value)) {
+    if (FlushCounter(type, key, counter_field, counter)) {
+      buffered_key->counters.erase(counter_field);
+    }
+    return false;
+  }
+  counter->delta += value;
+  MarkDirty(counter);
+  *ret = counter->base + counter->delta;
+  return true;
+}
+
+bool CounterBuffer::ZIncrby(const Slice& key, const Slice& member,
+                            double increment, double* ret) {
+  std::string buffer_key = BufferKey(kZSets, key);
+  Shard* shard = GetShard(buffer_key);
+  slash::MutexLock l(&shard->mutex);
+  BufferedKey* buffered_key = FindKey(shard, buffer_key);
+  if (buffered_key == nullptr) {
+    return false;
+  }
+  Counter* counter = LoadCounter(buffered_key, kZSets,
+                                 key, member.ToString());
+  if (counter == nullptr) {
+    return false;
+  }
+  counter->float_delta += increment;
+  MarkDirty(counter);
+  *ret = counter->float_base + counter->float_delta;
+  return true;
+}
+
+bool CounterBuffer::Get(const Slice& key, std::string* value) {
+  return GetCounter(kStrings, key, Slice(), value);
+}
+
+bool CounterBuffer::HGet(const Slice& key, const Slice& field,
+                         std::string* value) {
+  return GetCounter(kHashes, key, field, value);
+}
+
+bool CounterBuffer::GetCounter(const DataType& type, const Slice& key,
+                               const Slice& field, std::string* value) {
+  std::string buffer_key = BufferKey(type, key);
+  Shard* shard = GetShard(buffer_key);
+  slash::MutexLock l(&shard->mutex);
+  BufferedKey* buffered_key = FindKey(shard, buffer_key);
+  if (buffered_key == nullptr) {
+    return false;
+  }
+  auto iter = buffered_key->counters.find(field.ToString());
+  if (iter == buffered_key->counters.end() || IsExpired(iter->second)) {
+    return false;
+  }
+  char buf[32];
+  int len = Int64ToStr(buf, sizeof(buf),
+                       iter->second.base + iter->second.delta);
+  value->assign(buf, len);
+  return true;
+}
+
+bool CounterBuffer::ZScore(const Slice& key, const Slice& member,
+                           double* score) {
+  std::string buffer_key = BufferKey(kZSets, key);
+  Shard* shard = GetShard(buffer_key);
+  slash::MutexLock l(&shard->mutex);
+  BufferedKey* buffered_key = FindKey(shard, buffer_key);
+  if (buffered_key == nullptr) {
+    return false;
+  }
+  auto iter = buffered_key->counters.find(member.ToString());
+  if (iter == buffered_key->counters.end() || IsExpired(iter->second)) {
+    return false;
+  }
+  *score = iter->second.float_base + iter->second.float_delta;
+  return true;
+}
+
+void CounterBuffer::Flush(const DataType& type, const Slice& key) {
+  if (type == kAll) {
+    Flush(kStrings, key);
+    Flush(kHashes, key);
+    Flush(kZSets, key);
+    return;
+  }
+  std::string buffer_key = BufferKey(type, key);
+  Shard* shard = GetShard(buffer_key);
+  slash::MutexLock l(&shard->mutex);
+  auto iter = shard->keys.find(buffer_key);
+  if (iter != shard->keys.end()) {
+    FlushKey(buffer_key, &iter->second, false);
+  }
+}
+
+void CounterBuffer::BeginWrite(const DataType& type, const Slice& key) {
+  if (type == kAll) {
+    BeginWrite(kStrings, key);
+    BeginWrite(kHashes, key);
+    BeginWrite(kZSets, key);
+    return;
+  }
+  std::string buffer_key = BufferKey(type, key);
+  Shard* shard = GetShard(buffer_key);
+  slash::MutexLock l(&shard->mutex);
+  // The entry is kept even if key is not buffered, key may be detected
+  // before the write is done
+  BufferedKey* buffered_key = &shard->keys[buffer_key];
+  buffered_key->writers++;
+  FlushKey(buffer_key, buffered_key, true);
+}
+
+void CounterBuffer::EndWrite(const DataType& type, const Slice& key) {
+  if (type == kAll) {
+    EndWrite(kStrings, key);
+    EndWrite(kHashes, key);
+    EndWrite(kZSets, key);
+    return;
+  }
+  std::string buffer_key = BufferKey(type, key);
+  Shard* shard = GetShard(buffer_key);
+  slash::MutexLock l(&shard->mutex);
+  auto iter = shard->keys.find(buffer_key);
+  if (iter == shard->keys.end()) {
+    return;
+  }
+  iter->second.writers--;
+  if (iter->second.writers == 0 && !iter->second.designated
+    && !iter->second.detected && iter->second.counters.empty()) {
+    shard->keys.erase(iter);
+  }
+}
+
+void CounterBuffer::BeginWriteAll() {
+  for (uint32_t idx = 0; idx < kShardNum; ++idx) {
+    slash::MutexLock l(&shards_[idx].mutex);
+    shards_[idx].fences++;
+    auto iter = shards_[idx].keys.begin();
+    while (iter != shards_[idx].keys.end()) {
+      bool active = iter->second.designated || iter->second.detected;
+      if (FlushKey(iter->first, &iter->second, true) && !active
+        && iter->second.writers == 0) {
+        iter = shards_[idx].keys.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+  }
+}
+
+void CounterBuffer::EndWriteAll() {
+  for (uint32_t idx = 0; idx < kShardNum; ++idx) {
+    slash::MutexLock l(&shards_[idx].mutex);
+    shards_[idx].fences--;
+  }
+}
+
+void CounterBuffer::FlushAll() {
+  for (uint32_t idx = 0; idx < kShardNum; ++idx) {
+    slash::MutexLock l(&shards_[idx].mutex);
+    auto iter = shards_[idx].keys.begin();
+    while (iter != shards_[idx].keys.end()) {
+      bool active = iter->second.designated || iter->second.detected;
+      if (FlushKey(iter->first, &iter->second, !active) && !active
+        && iter->second.writers == 0) {
+        iter = shards_[idx].keys.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+  }
+}
+
+void CounterBuffer::GetStats(CounterBufferStats* stats) {
+  stats->keys = 0;
+  stats->dirty_counters = 0;
+  stats->dirty_increments = 0;
+  stats->oldest_dirty_ms = 0;
+  uint64_t now = rocksdb::Env::Default()->NowMicros();
+  for (uint32_t idx = 0; idx < kShardNum; ++idx) {
+    slash::MutexLock l(&shards_[idx].mutex);
+    for (const auto& buffered_key : shards_[idx].keys) {
+      if (buffered_key.second.designated || buffered_key.second.detected) {
+        stats->keys++;
+      }
+      for (const auto& counter : buffered_key.second.counters) {
+        if (counter.second.increments == 0) {
+          continue;
+        }
+        stats->dirty_counters++;
+        stats->dirty_increments += counter.second.increments;
+        uint64_t dirty_ms = now > counter.second.dirty_since
+          ? (now - counter.second.dirty_since) / 1000 : 0;
+        stats->oldest_dirty_ms = std::max(stats->oldest_dirty_ms, dirty_ms);
+      }
+    }
+  }
+  stats->flushed_increments = flushed_increments_;
+  stats->flush_errors = flush_errors_;
+}
+
+ScopeCounterWrite::ScopeCounterWrite(CounterBuffer* buffer,
+                                     const DataType& type, const Slice& key)
+    : buffer_(buffer), all_(false), type_(type) {
+  if (buffer_ != nullptr) {
+    keys_.push_back(key.ToString());
+    buffer_->BeginWrite(type_, key);
+  }
+}
+
+ScopeCounterWrite::ScopeCounterWrite(CounterBuffer* buffer,
+                                     const DataType& type,
+                                     const std::vector<std::string>& keys)
+    : buffer_(buffer), all_(false), type_(type) {
+  if (buffer_ != nullptr) {
+    keys_ = keys;
+    for (const auto& key : keys_) {
+      buffer_->BeginWrite(type_, key);
+    }
+  }
+}
+
+ScopeCounterWrite::ScopeCounterWrite(CounterBuffer* buffer)
+    : buffer_(buffer), all_(buffer != nullptr), type_(kAll) {
+  if (all_) {
+    buffer_->BeginWriteAll();
+  }
+}
+
+ScopeCounterWrite::~ScopeCounterWrite() {
+  if (all_) {
+    buffer_->EndWriteAll();
+  }
+  for (const auto& key : keys_) {
+    buffer_->EndWrite(type_, key);
+  }
+}
+
+}  //  namespace blackwidow
@@ -0,0 +1,169 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_COUNTER_BUFFER_H_
+#define SRC_COUNTER_BUFFER_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "rocksdb/slice.h"
+#include "slash/include/slash_mutex.h"
+
+#include "blackwidow/blackwidow.h"
+
+namespace blackwidow {
+using Slice = rocksdb::Slice;
+
+// Write-behind buffer of hot counters, the increments of the strings,
+// hash fields and zset members of a buffered key are summed up in memory
+// and written as one increment per counter by Flush and FlushAll, they
+// skip the record lock, the write and the WAL append of every call.
+// The keys are the keys stored in the type dbs
+class CounterBuffer {
+ public:
+  CounterBuffer(RedisStrings* strings_db, RedisHashes* hashes_db,
+                RedisZSets* zsets_db);
+  ~CounterBuffer();
+
+  // Designated keys are buffered until they are undesignated, detected
+  // keys until SetDetectedKeys no longer reports them
+  void Designate(const DataType& type, const Slice& key);
+  void Undesignate(const DataType& type, const Slice& key);
+  void SetDetectedKeys(const DataType& type,
+                       const std::vector<std::string>& keys);
+
+  // Return false when the increment is not buffered, the caller then
+  // increments the stored value itself
+  bool Incrby(const Slice& key, int64_t value, int64_t* ret);
+  bool HIncrby(const Slice& key, const Slice& field,
+               int64_t value, int64_t* ret);
+  bool ZIncrby(const Slice& key, const Slice& member,
+               double increment, double* ret);
+
+  // The stored value merged with the buffered increments, false when
+  // the counter is not buffered
+  bool Get(const Slice& key, std::string* value);
+  bool HGet(const Slice& key, const Slice& field, std::string* value);
+  bool ZScore(const Slice& key, const Slice& member, double* score);
+
+  // Write the increments of key before another command reads it through
+  // the type dbs, kAll flushes the key of every type. The counters stay
+  // loaded and the buffered commands go on meanwhile
+  void Flush(const DataType& type, const Slice& key);
+  // Write the increments of key before another command changes it
+  // through the type dbs, kAll flushes the key of every type. Until
+  // the matching EndWrite the buffered commands of key return false, so
+  // no counter is loaded from a value about to change, see
+  // ScopeCounterWrite
+  void BeginWrite(const DataType& type, const Slice& key);
+  void EndWrite(const DataType& type, const Slice& key);
+  // BeginWrite and EndWrite for every key, before a delete of a range or
+  // pattern of keys. The counters are written and dropped, none is
+  // loaded again until the matching EndWriteAll
+  void BeginWriteAll();
+  void EndWriteAll();
+  // Write the increments of all the counters
+  void FlushAll();
+
+  void GetStats(CounterBufferStats* stats);
+
+ private:
+  static const uint32_t kShardNum = 16;
+
+  struct Counter {
+    // The stored value when the counter was loaded or last flushed,
+    // a zset member uses the float ones
+    int64_t base;
+    int64_t delta;
+    double float_base;
+    double float_delta;
+    // The increments not written yet, and when the first of them came
+    uint64_t increments;
+    uint64_t dirty_since;
+    // The expire time of the stored key when the counter was loaded, 0
+    // for none. The counter and its increments go with the key
+    int32_t timestamp;
+  };
+
+  // The counters of one key, by hash field or zset member, a string
+  // has a single counter for ""
+  struct BufferedKey {
+    bool designated;
+    bool detected;
+    // The commands writing the key through the type dbs
+    uint32_t writers;
+    std::unordered_map<std::string, Counter> counters;
+  };
+
+  struct Shard {
+    slash::Mutex mutex;
+    // The commands writing all the keys through the type dbs
+    uint32_t fences;
+    std::unordered_map<std::string, BufferedKey> keys;
+
+    Shard() : fences(0) {}
+  };
+
+  RedisStrings* strings_db_;
+  RedisHashes* hashes_db_;
+  RedisZSets* zsets_db_;
+  Shard shards_[kShardNum];
+  std::atomic<uint64_t> flushed_increments_;
+  std::atomic<uint64_t> flush_errors_;
+
+  Shard* GetShard(const std::string& buffer_key);
+  // The counters of key, nullptr when key is not buffered or written
+  // through the type dbs
+  BufferedKey* FindKey(Shard* shard, const std::string& buffer_key);
+  Counter* LoadCounter(BufferedKey* buffered_key, const DataType& type,
+                       const Slice& key, const std::string& field);
+  static bool IsExpired(const Counter& counter);
+  void MarkDirty(Counter* counter);
+  bool IncrbyCounter(const DataType& type, const Slice& key,
+                     const Slice& field, int64_t value, int64_t* ret);
+  bool GetCounter(const DataType& type, const Slice& key,
+                  const Slice& field, std::string* value);
+  // Write the increments of one counter, false when they stay buffered
+  bool FlushCounter(const DataType& type, const Slice& key,
+                    const std::string& field, Counter* counter);
+  // Flush every counter of key, erase_counters drops the flushed ones
+  // since the stored values are about to change
+  bool FlushKey(const std::string& buffer_key, BufferedKey* buffered_key,
+                bool erase_counters);
+
+  // No copying allowed
+  CounterBuffer(const CounterBuffer&);
+  void operator=(const CounterBuffer&);
+};
+
+// Flush the buffered increments of the keys and keep their counters out
+// of the buffer while the caller writes them through the type dbs, a
+// null buffer does nothing
+class ScopeCounterWrite {
+ public:
+  ScopeCounterWrite(CounterBuffer* buffer, const DataType& type,
+                    const Slice& key);
+  ScopeCounterWrite(CounterBuffer* buffer, const DataType& type,
+                    const std::vector<std::string>& keys);
+  // All the keys of every type
+  explicit ScopeCounterWrite(CounterBuffer* buffer);
+  ~ScopeCounterWrite();
+
+ private:
+  CounterBuffer* const buffer_;
+  bool all_;
+  DataType type_;
+  std::vector<std::string> keys_;
+
+  // No copying allowed
+  ScopeCounterWrite(const ScopeCounterWrite&);
+  void operator=(const ScopeCounterWrite&);
+};
+
+}  //  namespace blackwidow
+#endif  //  SRC_COUNTER_BUFFER_H_
@@ -0,0 +1,154 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_DUMP_FORMAT_H_
+#define SRC_DUMP_FORMAT_H_
+
+#include <string>
+
+#include "rocksdb/slice.h"
+#include "rocksdb/status.h"
+#include "util/crc32c.h"
+
+#include "src/coding.h"
+#include "blackwidow/blackwidow.h"
+
+namespace blackwidow {
+
+/*
+ * | type | dump version | element | element | ... | checksum |
+ *    1B        1B                                    4B
+ *
+ * Every element is a varint length prefixed string, a strings value is
+ * one element, a hashes entry is two elements (field and value), a
+ * zsets element is | score 8B | member | and a streams entry is
+ * | id 16B | packed fields |. The masked crc32c checksum covers
+ * everything before it
+ */
+const char kDumpVersion = 1;
+const size_t kDumpHeaderLength = 2;
+const size_t kDumpChecksumLength = sizeof(uint32_t);
+
+// Restore writes the elements through WriteBatches of about this size
+const size_t kRestoreBatchBytes = 4 << 20;
+
+class DumpWriter {
+ public:
+  DumpWriter(std::string* dump, size_t max_size) :
+    dump_(dump),
+    max_size_(max_size) {
+    dump_->clear();
+  }
+
+  void Begin(const DataType& type) {
+    dump_->push_back(static_cast<char>(type));
+    dump_->push_back(kDumpVersion);
+  }
+
+  // Return false once the dump grows beyond max_size, the caller stops
+  // iterating the collection
+  bool Add(const rocksdb::Slice& element) {
+    PutLengthPrefixedSlice(dump_, element);
+    return !Oversize();
+  }
+
+  bool AddScoreMember(double score, const rocksdb::Slice& member) {
+    char buf[sizeof(uint64_t)];
+    const void* ptr_score = reinterpret_cast<const void*>(&score);
+    EncodeFixed64(buf, *reinterpret_cast<const uint64_t*>(ptr_score));
+    PutVarint64(dump_, sizeof(uint64_t) + member.size());
+    dump_->append(buf, sizeof(uint64_t));
+    dump_->append(member.data(), member.size());
+    return !Oversize();
+  }
+
+  rocksdb::Status Finish() {
+    if (Oversize()) {
+      dump_->clear();
+      return rocksdb::Status::InvalidArgument("Dump too large");
+    }
+    char buf[kDumpChecksumLength];
+    EncodeFixed32(buf, rocksdb::crc32c::Mask(
+          rocksdb::crc32c::Value(dump_->data(), dump_->size())));
+    dump_->append(buf, kDumpChecksumLength);
+    return rocksdb::Status::OK();
+  }
+
+ private:
+  bool Oversize() {
+    return dump_->size() + kDumpChecksumLength > max_size_;
+  }
+
+  std::string* dump_;
+  size_t max_size_;
+};
+
+class DumpReader {
+ public:
+  explicit DumpReader(const rocksdb::Slice& dump) :
+    dump_(dump),
+    type_(kAll) {
+  }
+
+  // Check the size, the format version and the checksum, the elements
+  // are read only after Verify succeeded
+  rocksdb::Status Verify(size_t max_size) {
+    if (dump_.size() > max_size) {
+      return rocksdb::Status::InvalidArgument("Dump too large");
+    } else if (dump_.size() < kDumpHeaderLength + kDumpChecksumLength) {
+      return rocksdb::Status::Corruption("Dump too short");
+    }
+    size_t payload_size = dump_.size() - kDumpChecksumLength;
+    uint32_t checksum = rocksdb::crc32c::Unmask(
+        DecodeFixed32(dump_.data() + payload_size));
+    if (checksum != rocksdb::crc32c::Value(dump_.data(), payload_size)) {
+      return rocksdb::Status::Corruption("Dump checksum mismatch");
+    } else if (dump_[1] != kDumpVersion) {
+      return rocksdb::Status::NotSupported("Unknown dump version");
+    }
+    type_ = static_cast<DataType>(dump_[0]);
+    if (type_ < kStrings || type_ > kStreams) {
+      return rocksdb::Status::Corruption("Unknown dump data type");
+    }
+    elements_ = rocksdb::Slice(dump_.data() + kDumpHeaderLength,
+        payload_size - kDumpHeaderLength);
+    return rocksdb::Status::OK();
+  }
+
+  DataType type() {
+    return type_;
+  }
+
+  // Return false at the end of the elements
+  bool Next(rocksdb::Slice* element) {
+    return !elements_.empty() && GetLengthPrefixedSlice(&elements_, element);
+  }
+
+  bool NextScoreMember(double* score, rocksdb::Slice* member) {
+    rocksdb::Slice element;
+    if (!Next(&element) || element.size() < sizeof(uint64_t)) {
+      return false;
+    }
+    uint64_t tmp = DecodeFixed64(element.data());
+    const void* ptr_tmp = reinterpret_cast<const void*>(&tmp);
+    *score = *reinterpret_cast<const double*>(ptr_tmp);
+    *member = rocksdb::Slice(element.data() + sizeof(uint64_t),
+        element.size() - sizeof(uint64_t));
+    return true;
+  }
+
+  // The elements are well formed if all of them were consumed
+  bool Done() {
+    return elements_.empty();
+  }
+
+ private:
+  rocksdb::Slice dump_;
+  rocksdb::Slice elements_;
+  DataType type_;
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_DUMP_FORMAT_H_
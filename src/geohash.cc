@@ -0,0 +1,212 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/geohash.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace blackwidow {
+
+const double kEarthRadiusInMeters = 6372797.560856;
+const double kMercatorMax = 20037726.37;
+
+static inline double DegToRad(double deg) {
+  return deg * M_PI / 180.0;
+}
+
+static inline double RadToDeg(double rad) {
+  return rad * 180.0 / M_PI;
+}
+
+// The bits of lat are the even bits of the result and the bits of
+// lon are the odd ones
+static uint64_t Interleave(uint32_t lat, uint32_t lon) {
+  static const uint64_t B[] = {0x5555555555555555ULL, 0x3333333333333333ULL,
+                               0x0F0F0F0F0F0F0F0FULL, 0x00FF00FF00FF00FFULL,
+                               0x0000FFFF0000FFFFULL};
+  static const uint32_t S[] = {1, 2, 4, 8, 16};
+  uint64_t x = lat;
+  uint64_t y = lon;
+  for (int32_t idx = 4; idx >= 0; --idx) {
+    x = (x | (x << S[idx])) & B[idx];
+    y = (y | (y << S[idx])) & B[idx];
+  }
+  return x | (y << 1);
+}
+
+static void Deinterleave(uint64_t bits, uint32_t* lat, uint32_t* lon) {
+  static const uint64_t B[] = {0x5555555555555555ULL, 0x3333333333333333ULL,
+                               0x0F0F0F0F0F0F0F0FULL, 0x00FF00FF00FF00FFULL,
+                               0x0000FFFF0000FFFFULL, 0x00000000FFFFFFFFULL};
+  static const uint32_t S[] = {0, 1, 2, 4, 8, 16};
+  uint64_t x = bits;
+  uint64_t y = bits >> 1;
+  for (int32_t idx = 0; idx < 6; ++idx) {
+    x = (x | (x >> S[idx])) & B[idx];
+    y = (y | (y >> S[idx])) & B[idx];
+  }
+  *lat = static_cast<uint32_t>(x);
+  *lon = static_cast<uint32_t>(y);
+}
+
+// The index of the cell of value among the 2^step cells of [min, max)
+static uint32_t CellIndex(double value, double min, double max,
+                          uint32_t step) {
+  double cells = static_cast<double>(1ULL << step);
+  double index = std::floor((value - min) / (max - min) * cells);
+  return static_cast<uint32_t>(std::max(0.0, std::min(index, cells - 1)));
+}
+
+// The cells of the lowest step whose 3x3 neighborhood is still larger than
+// a circle of range meters, as estimated by redis
+static uint32_t EstimateStep(double range, double latitude) {
+  if (range == 0) {
+    return kGeoHashStep;
+  }
+  int32_t step = 1;
+  while (range < kMercatorMax) {
+    range *= 2;
+    step++;
+  }
+  step -= 2;
+  // The cells are narrower towards the poles
+  if (latitude > 66 || latitude < -66) {
+    step--;
+    if (latitude > 80 || latitude < -80) {
+      step--;
+    }
+  }
+  step = std::max(step, 1);
+  return std::min(static_cast<uint32_t>(step), kGeoHashStep);
+}
+
+bool GeoHashEncode(double longitude, double latitude, uint64_t* bits) {
+  if (!(longitude >= kGeoLongitudeMin && longitude <= kGeoLongitudeMax
+    && latitude >= kGeoLatitudeMin && latitude <= kGeoLatitudeMax)) {
+    return false;
+  }
+  *bits = Interleave(
+      CellIndex(latitude, kGeoLatitudeMin, kGeoLatitudeMax, kGeoHashStep),
+      CellIndex(longitude, kGeoLongitudeMin, kGeoLongitudeMax, kGeoHashStep));
+  return true;
+}
+
+void GeoHashDecode(uint64_t bits, double* longitude, double* latitude) {
+  uint32_t lat_index, lon_index;
+  Deinterleave(bits, &lat_index, &lon_index);
+  double cells = static_cast<double>(1ULL << kGeoHashStep);
+  double lat_unit = (kGeoLatitudeMax - kGeoLatitudeMin) / cells;
+  double lon_unit = (kGeoLongitudeMax - kGeoLongitudeMin) / cells;
+  *latitude = kGeoLatitudeMin + (lat_index + 0.5) * lat_unit;
+  *longitude = kGeoLongitudeMin + (lon_index + 0.5) * lon_unit;
+  *latitude = std::max(kGeoLatitudeMin, std::min(*latitude, kGeoLatitudeMax));
+  *longitude = std::max(kGeoLongitudeMin,
+                        std::min(*longitude, kGeoLongitudeMax));
+}
+
+double GeoHashDistance(double longitude1, double latitude1,
+                       double longitude2, double latitude2) {
+  double lat1r = DegToRad(latitude1);
+  double lat2r = DegToRad(latitude2);
+  double u = std::sin((lat2r - lat1r) / 2);
+  double v = std::sin(DegToRad(longitude2 - longitude1) / 2);
+  return 2.0 * kEarthRadiusInMeters
+    * std::asin(std::sqrt(u * u + std::cos(lat1r) * std::cos(lat2r) * v * v));
+}
+
+bool GeoHashInShape(const GeoShape& shape, double longitude,
+                    double latitude, double* distance) {
+  *distance = GeoHashDistance(shape.longitude, shape.latitude,
+                              longitude, latitude);
+  if (shape.by_radius) {
+    return *distance <= shape.radius;
+  }
+  // The width of a box is measured along the latitude of the position
+  return GeoHashDistance(shape.longitude, shape.latitude,
+                         shape.longitude, latitude) <= shape.height / 2
+    && GeoHashDistance(shape.longitude, latitude,
+                       longitude, latitude) <= shape.width / 2;
+}
+
+void GeoHashSearchRanges(const GeoShape& shape,
+                         std::vector<std::pair<uint64_t, uint64_t>>* ranges) {
+  ranges->clear();
+  double half_width = shape.by_radius ? shape.radius : shape.width / 2;
+  double half_height = shape.by_radius ? shape.radius : shape.height / 2;
+
+  // The bounding box of shape, a longitude span of 180 degrees or more
+  // around the center takes the whole circle of latitude
+  double lat_delta = RadToDeg(half_height / kEarthRadiusInMeters);
+  double min_lat = std::max(shape.latitude - lat_delta, kGeoLatitudeMin);
+  double max_lat = std::min(shape.latitude + lat_delta, kGeoLatitudeMax);
+  double pole_lat = std::max(std::fabs(min_lat), std::fabs(max_lat));
+  double lon_delta = RadToDeg(half_width / kEarthRadiusInMeters
+                              / std::cos(DegToRad(pole_lat)));
+  bool full_circle = !(lon_delta < 180);
+  double min_lon = shape.longitude - lon_delta;
+  double max_lon = shape.longitude + lon_delta;
+
+  // Coarsen the cells until the 3x3 cells around the center cover the box
+  double range = shape.by_radius ? shape.radius
+    : std::sqrt(half_width * half_width + half_height * half_height);
+  uint32_t step = EstimateStep(range, shape.latitude);
+  uint32_t lat_index, lon_index;
+  double lat_unit, lon_unit;
+  while (true) {
+    double cells = static_cast<double>(1ULL << step);
+    lat_unit = (kGeoLatitudeMax - kGeoLatitudeMin) / cells;
+    lon_unit = (kGeoLongitudeMax - kGeoLongitudeMin) / cells;
+    lat_index = CellIndex(shape.latitude,
+        kGeoLatitudeMin, kGeoLatitudeMax, step);
+    lon_index = CellIndex(shape.longitude,
+        kGeoLongitudeMin, kGeoLongitudeMax, step);
+    double cell_lat = kGeoLatitudeMin + lat_index * lat_unit;
+    double cell_lon = kGeoLongitudeMin + lon_index * lon_unit;
+    if (step == 1
+      || (min_lat >= cell_lat - lat_unit && max_lat <= cell_lat + 2 * lat_unit
+        && !full_circle && min_lon >= cell_lon - lon_unit
+        && max_lon <= cell_lon + 2 * lon_unit)) {
+      break;
+    }
+    step--;
+  }
+
+  // The neighbors out of the box are skipped, and the adjacent cells are
+  // merged into one range
+  int64_t cells = 1LL << step;
+  uint32_t shift = 2 * (kGeoHashStep - step);
+  std::vector<std::pair<uint64_t, uint64_t>> cell_ranges;
+  for (int64_t lat_offset = -1; lat_offset <= 1; ++lat_offset) {
+    int64_t lat = lat_index + lat_offset;
+    double cell_lat = kGeoLatitudeMin + lat * lat_unit;
+    if (lat < 0 || lat >= cells
+      || cell_lat + lat_unit < min_lat || cell_lat > max_lat) {
+      continue;
+    }
+    for (int64_t lon_offset = -1; lon_offset <= 1; ++lon_offset) {
+      int64_t lon = lon_index + lon_offset;
+      double cell_lon = kGeoLongitudeMin + lon * lon_unit;
+      if (!full_circle
+        && (cell_lon + lon_unit < min_lon || cell_lon > max_lon)) {
+        continue;
+      }
+      uint64_t bits = Interleave(static_cast<uint32_t>(lat),
+          static_cast<uint32_t>((lon + cells) % cells));
+      cell_ranges.push_back({bits << shift, (bits + 1) << shift});
+    }
+  }
+  std::sort(cell_ranges.begin(), cell_ranges.end());
+  for (const auto& cell_range : cell_ranges) {
+    if (!ranges->empty() && ranges->back().second >= cell_range.first) {
+      ranges->back().second = std::max(ranges->back().second,
+                                       cell_range.second);
+    } else {
+      ranges->push_back(cell_range);
+    }
+  }
+}
+
+}  // namespace blackwidow
@@ -0,0 +1,46 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_GEOHASH_H_
+#define SRC_GEOHASH_H_
+
+#include <vector>
+#include <utility>
+
+#include "blackwidow/blackwidow.h"
+
+namespace blackwidow {
+
+// The bits of longitude and of latitude in a geohash, the score of a
+// member of a geo set is the 52 bit interleaved geohash of its position
+const uint32_t kGeoHashStep = 26;
+
+const double kGeoLongitudeMin = -180;
+const double kGeoLongitudeMax = 180;
+const double kGeoLatitudeMin = -85.05112878;
+const double kGeoLatitudeMax = 85.05112878;
+
+// false if the position is outside the valid longitude and latitude
+bool GeoHashEncode(double longitude, double latitude, uint64_t* bits);
+
+// The center of the cell of bits
+void GeoHashDecode(uint64_t bits, double* longitude, double* latitude);
+
+// The great circle distance in meters
+double GeoHashDistance(double longitude1, double latitude1,
+                       double longitude2, double latitude2);
+
+// Whether the position is in shape, and its distance to the center of shape
+bool GeoHashInShape(const GeoShape& shape, double longitude,
+                    double latitude, double* distance);
+
+// The sorted and disjoint score ranges [first, second) of the cells that
+// cover shape, the members in shape all have scores in one of them
+void GeoHashSearchRanges(const GeoShape& shape,
+                         std::vector<std::pair<uint64_t, uint64_t>>* ranges);
+
+}  // namespace blackwidow
+
+#endif  // SRC_GEOHASH_H_
@@ -0,0 +1,134 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/key_detector.h"
+
+#include <algorithm>
+
+#include "src/murmurhash.h"
+#include "src/access_clock.h"
+
+namespace blackwidow {
+
+KeyDetector::KeyDetector(uint32_t sample_rate, size_t top_k)
+    : sample_rate_(sample_rate),
+      top_k_(top_k),
+      access_clock_(nullptr) {
+  sketch_ = new std::atomic<uint32_t>[kSketchDepth * kSketchWidth];
+  for (uint32_t idx = 0; idx < kSketchDepth * kSketchWidth; ++idx) {
+    sketch_[idx].store(0, std::memory_order_relaxed);
+  }
+}
+
+KeyDetector::~KeyDetector() {
+  delete[] sketch_;
+}
+
+void KeyDetector::TouchAccessClock(const DataType& type, const Slice& key) {
+  access_clock_->Touch(type, key);
+}
+
+void KeyDetector::SampleAccess(const DataType& type, const Slice& key) {
+  uint32_t estimate = UINT32_MAX;
+  for (uint32_t depth = 0; depth < kSketchDepth; ++depth) {
+    // Different data types with the same key are different keys
+    uint32_t seed = depth * kDataTypeNum + type;
+    uint64_t hash = MurmurHash(key.data(), static_cast<int>(key.size()), seed);
+    uint32_t idx = depth * kSketchWidth + (hash & (kSketchWidth - 1));
+    uint32_t count = sketch_[idx].fetch_add(1, std::memory_order_relaxed) + 1;
+    estimate = std::min(estimate, count);
+  }
+
+  slash::MutexLock l(&mutex_);
+  UpdateTopK(&hot_keys_[type], key, estimate, 0);
+}
+
+void KeyDetector::UpdateTopK(std::vector<TopKEntry>* entries,
+                             const Slice& key,
+                             uint64_t count,
+                             uint64_t round) {
+  if (top_k_ == 0) {
+    return;
+  }
+
+  TopKEntry* min_entry = nullptr;
+  for (auto& entry : *entries) {
+    if (key.compare(entry.key) == 0) {
+      entry.count = count;
+      entry.round = round;
+      return;
+    }
+    if (min_entry == nullptr || entry.count < min_entry->count) {
+      min_entry = &entry;
+    }
+  }
+
+  if (entries->size() < top_k_) {
+    entries->push_back({key.ToString(), count, round});
+  } else if (min_entry != nullptr && min_entry->count < count) {
+    min_entry->key = key.ToString();
+    min_entry->count = count;
+    min_entry->round = round;
+  }
+}
+
+void KeyDetector::RecordBigKey(const DataType& type, const Slice& key,
+                               uint64_t count, uint64_t round) {
+  slash::MutexLock l(&mutex_);
+  UpdateTopK(&big_keys_[type], key, count, round);
+}
+
+void KeyDetector::ExpireBigKeys(const DataType& type, uint64_t round) {
+  slash::MutexLock l(&mutex_);
+  std::vector<TopKEntry>* entries = &big_keys_[type];
+  entries->erase(std::remove_if(entries->begin(), entries->end(),
+        [round](const TopKEntry& entry) { return entry.round < round; }),
+      entries->end());
+}
+
+void KeyDetector::Decay() {
+  for (uint32_t idx = 0; idx < kSketchDepth * kSketchWidth; ++idx) {
+    uint32_t count = sketch_[idx].load(std::memory_order_relaxed);
+    if (count) {
+      sketch_[idx].store(count >> 1, std::memory_order_relaxed);
+    }
+  }
+
+  slash::MutexLock l(&mutex_);
+  for (uint32_t type = 0; type < kDataTypeNum; ++type) {
+    std::vector<TopKEntry>* entries = &hot_keys_[type];
+    for (auto& entry : *entries) {
+      entry.count >>= 1;
+    }
+    entries->erase(std::remove_if(entries->begin(), entries->end(),
+          [](const TopKEntry& entry) { return entry.count == 0; }),
+        entries->end());
+  }
+}
+
+void KeyDetector::DumpTopK(const std::vector<TopKEntry>& entries,
+                           uint64_t scale,
+                           std::vector<KeyCount>* keys) {
+  keys->clear();
+  for (const auto& entry : entries) {
+    keys->push_back({entry.key, entry.count * scale});
+  }
+  std::sort(keys->begin(), keys->end(),
+      [](const KeyCount& a, const KeyCount& b) { return a.count > b.count; });
+}
+
+void KeyDetector::GetHotKeys(const DataType& type,
+                             std::vector<KeyCount>* hot_keys) {
+  slash::MutexLock l(&mutex_);
+  DumpTopK(hot_keys_[type], sample_rate_, hot_keys);
+}
+
+void KeyDetector::GetBigKeys(const DataType& type,
+                             std::vector<KeyCount>* big_keys) {
+  slash::MutexLock l(&mutex_);
+  DumpTopK(big_keys_[type], 1, big_keys);
+}
+
+}  //  namespace blackwidow
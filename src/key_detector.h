@@ -0,0 +1,100 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_KEY_DETECTOR_H_
+#define SRC_KEY_DETECTOR_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "rocksdb/slice.h"
+#include "slash/include/slash_mutex.h"
+
+#include "blackwidow/blackwidow.h"
+
+namespace blackwidow {
+using Slice = rocksdb::Slice;
+
+class AccessClock;
+
+// Track the top-K hot keys and big keys of every data type,
+// hot keys come from a count-min sketch fed with sampled accesses,
+// big keys are reported by the background meta sampler
+class KeyDetector {
+ public:
+  KeyDetector(uint32_t sample_rate, size_t top_k);
+  ~KeyDetector();
+
+  // Only one of sample_rate_ accesses of a thread reaches the sketch,
+  // every access reaches the access clock of the evictor
+  void RecordAccess(const DataType& type, const Slice& key) {
+    if (access_clock_ != nullptr) {
+      TouchAccessClock(type, key);
+    }
+    if (sample_rate_ == 0) {
+      return;
+    }
+    static thread_local uint32_t access_count = 0;
+    if (++access_count < sample_rate_) {
+      return;
+    }
+    access_count = 0;
+    SampleAccess(type, key);
+  }
+
+  // The sampler calls RecordBigKey in the round-th pass over the meta
+  // keys of type, the big keys not seen in that pass are dropped by
+  // ExpireBigKeys when the pass is finished
+  void RecordBigKey(const DataType& type, const Slice& key,
+                    uint64_t count, uint64_t round);
+  void ExpireBigKeys(const DataType& type, uint64_t round);
+
+  // Halve all the access counters, so the hot keys reflect
+  // the recent workload
+  void Decay();
+
+  void GetHotKeys(const DataType& type, std::vector<KeyCount>* hot_keys);
+  void GetBigKeys(const DataType& type, std::vector<KeyCount>* big_keys);
+
+  // Not owned, nullptr when the eviction is disabled
+  void SetAccessClock(AccessClock* access_clock) {
+    access_clock_ = access_clock;
+  }
+
+ private:
+  static const uint32_t kSketchDepth = 4;
+  static const uint32_t kSketchWidth = 4096;
+  static const uint32_t kDataTypeNum = kStreams + 1;
+
+  struct TopKEntry {
+    std::string key;
+    uint64_t count;
+    uint64_t round;
+  };
+
+  uint32_t sample_rate_;
+  size_t top_k_;
+  std::atomic<uint32_t>* sketch_;
+  AccessClock* access_clock_;
+
+  slash::Mutex mutex_;
+  std::vector<TopKEntry> hot_keys_[kDataTypeNum];
+  std::vector<TopKEntry> big_keys_[kDataTypeNum];
+
+  void SampleAccess(const DataType& type, const Slice& key);
+  void TouchAccessClock(const DataType& type, const Slice& key);
+  void UpdateTopK(std::vector<TopKEntry>* entries, const Slice& key,
+                  uint64_t count, uint64_t round);
+  void DumpTopK(const std::vector<TopKEntry>& entries, uint64_t scale,
+                std::vector<KeyCount>* keys);
+
+  // No copying allowed
+  KeyDetector(const KeyDetector&);
+  void operator=(const KeyDetector&);
+};
+
+}  //  namespace blackwidow
+#endif  //  SRC_KEY_DETECTOR_H_
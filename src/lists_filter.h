@@ -13,6 +13,7 @@
 #include "src/debug.h"
 #include "src/lists_meta_value_format.h"
 #include "src/lists_data_key_format.h"
+#include "src/origin_filter.h"
 #include "rocksdb/compaction_filter.h"
 
 namespace blackwidow {
@@ -69,7 +70,8 @@ class ListsDataFilter : public rocksdb::CompactionFilter {
  public:
   ListsDataFilter(rocksdb::DB* db,
                   std::vector<rocksdb::ColumnFamilyHandle*>* cf_handles_ptr) :
-    db_(db), cf_handles_ptr_(cf_handles_ptr), meta_not_found_(false) {}
+    db_(db), cf_handles_ptr_(cf_handles_ptr), meta_not_found_(false),
+    cur_meta_has_origin_(false), origin_ref_reader_(db, cf_handles_ptr) {}
 
   bool Filter(int level, const rocksdb::Slice& key,
               const rocksdb::Slice& value,
@@ -96,6 +98,7 @@ class ListsDataFilter : public rocksdb::CompactionFilter {
         ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
         cur_meta_version_ = parsed_lists_meta_value.version();
         cur_meta_timestamp_ = parsed_lists_meta_value.timestamp();
+        cur_meta_has_origin_ = parsed_lists_meta_value.has_origin();
       } else if (s.IsNotFound()) {
         meta_not_found_ = true;
       } else {
@@ -105,25 +108,30 @@ class ListsDataFilter : public rocksdb::CompactionFilter {
       }
     }
 
-    if (meta_not_found_) {
-      Trace("Drop[Meta key not exist]");
-      return true;
-    }
-
     int64_t unix_time;
     rocksdb::Env::Default()->GetCurrentTime(&unix_time);
-    if (cur_meta_timestamp_ != 0
+    const char* drop_reason = nullptr;
+    if (meta_not_found_) {
+      drop_reason = "Drop[Meta key not exist]";
+    } else if (cur_meta_has_origin_) {
+      drop_reason = "Drop[Meta key renamed from origin]";
+    } else if (cur_meta_timestamp_ != 0
       && cur_meta_timestamp_ < static_cast<int32_t>(unix_time)) {
-      Trace("Drop[Timeout]");
-      return true;
+      drop_reason = "Drop[Timeout]";
+    } else if (cur_meta_version_ > parsed_lists_data_key.version()) {
+      drop_reason = "Drop[list_data_key_version < cur_meta_version]";
     }
 
-    if (cur_meta_version_ > parsed_lists_data_key.version()) {
-      Trace("Drop[list_data_key_version < cur_meta_version]");
-      return true;
-    } else {
+    if (drop_reason == nullptr) {
       Trace("Reserve[list_data_key_version == cur_meta_version]");
       return false;
+    } else if (origin_ref_reader_.IsReferenced(parsed_lists_data_key.key(),
+                 parsed_lists_data_key.version())) {
+      Trace("Reserve[Read by renamed key]");
+      return false;
+    } else {
+      Trace("%s", drop_reason);
+      return true;
     }
   }
 
@@ -137,6 +145,8 @@ class ListsDataFilter : public rocksdb::CompactionFilter {
   mutable bool meta_not_found_;
   mutable int32_t cur_meta_version_;
   mutable int32_t cur_meta_timestamp_;
+  mutable bool cur_meta_has_origin_;
+  mutable OriginRefReader<ParsedListsMetaValue> origin_ref_reader_;
 };
 
 class ListsDataFilterFactory : public rocksdb::CompactionFilterFactory {
@@ -159,5 +169,7 @@ class ListsDataFilterFactory : public rocksdb::CompactionFilterFactory {
   std::vector<rocksdb::ColumnFamilyHandle*>* cf_handles_ptr_;
 };
 
+typedef OriginRefFilterFactory<ParsedListsMetaValue> ListsOriginFilterFactory;
+
 }  //  namespace blackwidow
 #endif  // SRC_LISTS_FILTER_H_
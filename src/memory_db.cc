@@ -0,0 +1,815 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "src/memory_db.h"
+
+#include <limits>
+#include <algorithm>
+
+#include "rocksdb/env.h"
+#include "rocksdb/version.h"
+#include "rocksdb/comparator.h"
+#include "rocksdb/compaction_filter.h"
+
+namespace blackwidow {
+
+static const char* kNumKeysProperty = "rocksdb.estimate-num-keys";
+static const char* kMemorySizeProperty = "rocksdb.cur-size-all-mem-tables";
+
+// What a key and a version cost besides their bytes
+static const uint64_t kEntryOverhead = 64;
+static const uint64_t kVersionOverhead = 48;
+
+// Keys a compaction reads under one read lock, the filters run unlocked
+static const size_t kCompactionBatch = 1024;
+// No background compaction for a column family with fewer writes
+static const uint64_t kMinCompactionWrites = 10000;
+
+static const rocksdb::SequenceNumber kMaxSequenceNumber =
+  std::numeric_limits<rocksdb::SequenceNumber>::max();
+
+class MemoryDB::MemorySnapshot : public rocksdb::Snapshot {
+ public:
+  MemorySnapshot(rocksdb::SequenceNumber sequence, int64_t unix_time)
+    : sequence_(sequence), unix_time_(unix_time) {}
+  rocksdb::SequenceNumber GetSequenceNumber() const override {
+    return sequence_;
+  }
+#if ROCKSDB_MAJOR >= 7
+  int64_t GetUnixTime() const override {
+    return unix_time_;
+  }
+  uint64_t GetTimestamp() const override {
+    return 0;
+  }
+#endif
+
+ private:
+  rocksdb::SequenceNumber sequence_;
+  int64_t unix_time_;
+};
+
+// Positions by key and looks the key up again on every move, the map
+// may change between two calls. The versions visible at the sequence of
+// the iterator are never dropped while it is alive
+class MemoryDB::MemoryIterator : public rocksdb::Iterator {
+ public:
+  // owns_sequence releases the registered sequence on destruction
+  MemoryIterator(MemoryDB* db, Table* table,
+                 const rocksdb::ReadOptions& options,
+                 rocksdb::SequenceNumber sequence, bool owns_sequence)
+    : db_(db),
+      table_(table),
+      sequence_(sequence),
+      owns_sequence_(owns_sequence),
+      has_lower_bound_(options.iterate_lower_bound != nullptr),
+      has_upper_bound_(options.iterate_upper_bound != nullptr),
+      valid_(false) {
+    if (has_lower_bound_) {
+      lower_bound_ = options.iterate_lower_bound->ToString();
+    }
+    if (has_upper_bound_) {
+      upper_bound_ = options.iterate_upper_bound->ToString();
+    }
+  }
+
+  ~MemoryIterator() {
+    if (owns_sequence_) {
+      db_->ReleaseSequence(sequence_);
+    }
+  }
+
+  bool Valid() const override {
+    return valid_;
+  }
+
+  void SeekToFirst() override {
+    slash::RWLock l(&db_->rwlock_, false);
+    FindNext(has_lower_bound_ ? table_->entries.lower_bound(lower_bound_)
+                              : table_->entries.begin());
+  }
+
+  void SeekToLast() override {
+    slash::RWLock l(&db_->rwlock_, false);
+    FindPrev(has_upper_bound_ ? table_->entries.lower_bound(upper_bound_)
+                              : table_->entries.end());
+  }
+
+  void Seek(const Slice& target) override {
+    slash::RWLock l(&db_->rwlock_, false);
+    if (has_lower_bound_
+      && table_->comparator->Compare(target, lower_bound_) < 0) {
+      FindNext(table_->entries.lower_bound(lower_bound_));
+    } else {
+      FindNext(table_->entries.lower_bound(target.ToString()));
+    }
+  }
+
+  void SeekForPrev(const Slice& target) override {
+    slash::RWLock l(&db_->rwlock_, false);
+    if (has_upper_bound_
+      && table_->comparator->Compare(target, upper_bound_) >= 0) {
+      FindPrev(table_->entries.lower_bound(upper_bound_));
+    } else {
+      FindPrev(table_->entries.upper_bound(target.ToString()));
+    }
+  }
+
+  void Next() override {
+    slash::RWLock l(&db_->rwlock_, false);
+    FindNext(table_->entries.upper_bound(key_));
+  }
+
+  void Prev() override {
+    slash::RWLock l(&db_->rwlock_, false);
+    FindPrev(table_->entries.lower_bound(key_));
+  }
+
+  Slice key() const override {
+    return key_;
+  }
+
+  Slice value() const override {
+    return value_;
+  }
+
+  Status status() const override {
+    return Status::OK();
+  }
+
+ private:
+  // The first visible key from iter on
+  void FindNext(Entries::const_iterator iter) {
+    for (; iter != table_->entries.end(); ++iter) {
+      if (has_upper_bound_
+        && table_->comparator->Compare(iter->first, upper_bound_) >= 0) {
+        break;
+      }
+      const Version* version = Visible(iter->second, sequence_);
+      if (version != nullptr) {
+        Load(iter->first, version);
+        return;
+      }
+    }
+    valid_ = false;
+  }
+
+  // The last visible key before iter
+  void FindPrev(Entries::const_iterator iter) {
+    while (iter != table_->entries.begin()) {
+      --iter;
+      if (has_lower_bound_
+        && table_->comparator->Compare(iter->first, lower_bound_) < 0) {
+        break;
+      }
+      const Version* version = Visible(iter->second, sequence_);
+      if (version != nullptr) {
+        Load(iter->first, version);
+        return;
+      }
+    }
+    valid_ = false;
+  }
+
+  void Load(const std::string& key, const Version* version) {
+    key_ = key;
+    value_ = version->value;
+    valid_ = true;
+  }
+
+  MemoryDB* db_;
+  Table* table_;
+  rocksdb::SequenceNumber sequence_;
+  bool owns_sequence_;
+  bool has_lower_bound_;
+  bool has_upper_bound_;
+  std::string lower_bound_;
+  std::string upper_bound_;
+  bool valid_;
+  std::string key_;
+  std::string value_;
+};
+
+// Rejects a batch the applier could not apply as a whole, so no batch
+// is left half applied
+class MemoryDB::BatchChecker : public rocksdb::WriteBatch::Handler {
+ public:
+  explicit BatchChecker(MemoryDB* db) : db_(db) {}
+
+  Status PutCF(uint32_t column_family_id, const Slice& key,
+               const Slice& value) override {
+    return CheckTable(column_family_id);
+  }
+
+  Status DeleteCF(uint32_t column_family_id, const Slice& key) override {
+    return CheckTable(column_family_id);
+  }
+
+  Status SingleDeleteCF(uint32_t column_family_id,
+                        const Slice& key) override {
+    return CheckTable(column_family_id);
+  }
+
+  Status DeleteRangeCF(uint32_t column_family_id, const Slice& begin_key,
+                       const Slice& end_key) override {
+    return CheckTable(column_family_id);
+  }
+
+  Status MergeCF(uint32_t column_family_id, const Slice& key,
+                 const Slice& value) override {
+    return Status::NotSupported("Merge on the memory backend");
+  }
+
+ private:
+  Status CheckTable(uint32_t column_family_id) {
+    if (!db_->tables_by_id_.count(column_family_id)) {
+      return Status::InvalidArgument("Unknown column family");
+    }
+    return Status::OK();
+  }
+
+  MemoryDB* db_;
+};
+
+// Applies a batch with the write lock held, every operation gets its
+// own sequence
+class MemoryDB::BatchApplier : public rocksdb::WriteBatch::Handler {
+ public:
+  BatchApplier(MemoryDB* db, rocksdb::SequenceNumber sequence,
+               rocksdb::SequenceNumber oldest)
+    : db_(db), sequence_(sequence), oldest_(oldest) {}
+
+  Status PutCF(uint32_t column_family_id, const Slice& key,
+               const Slice& value) override {
+    Table* table = FindTable(column_family_id);
+    if (table == nullptr) {
+      return Status::InvalidArgument("Unknown column family");
+    }
+    db_->AddVersion(table, key, false, value, ++sequence_, oldest_);
+    table->writes_since_compaction++;
+    return Status::OK();
+  }
+
+  Status DeleteCF(uint32_t column_family_id, const Slice& key) override {
+    Table* table = FindTable(column_family_id);
+    if (table == nullptr) {
+      return Status::InvalidArgument("Unknown column family");
+    }
+    db_->AddVersion(table, key, true, Slice(), ++sequence_, oldest_);
+    table->writes_since_compaction++;
+    return Status::OK();
+  }
+
+  Status SingleDeleteCF(uint32_t column_family_id,
+                        const Slice& key) override {
+    return DeleteCF(column_family_id, key);
+  }
+
+  Status DeleteRangeCF(uint32_t column_family_id, const Slice& begin_key,
+                       const Slice& end_key) override {
+    Table* table = FindTable(column_family_id);
+    if (table == nullptr) {
+      return Status::InvalidArgument("Unknown column family");
+    }
+    db_->AddRangeDeletion(table, begin_key, end_key, ++sequence_, oldest_);
+    table->writes_since_compaction++;
+    return Status::OK();
+  }
+
+  Status MergeCF(uint32_t column_family_id, const Slice& key,
+                 const Slice& value) override {
+    return Status::NotSupported("Merge on the memory backend");
+  }
+
+  rocksdb::SequenceNumber sequence() const {
+    return sequence_;
+  }
+
+ private:
+  Table* FindTable(uint32_t column_family_id) {
+    auto iter = db_->tables_by_id_.find(column_family_id);
+    return iter == db_->tables_by_id_.end() ? nullptr : iter->second;
+  }
+
+  MemoryDB* db_;
+  rocksdb::SequenceNumber sequence_;
+  rocksdb::SequenceNumber oldest_;
+};
+
+MemoryDB::MemoryDB(rocksdb::DB* base_db,
+                   const std::vector<rocksdb::ColumnFamilyHandle*>& handles)
+    : rocksdb::StackableDB(base_db),
+      last_sequence_(0),
+      bg_cv_(&bg_mutex_),
+      bg_compaction_scheduled_(false),
+      shutting_down_(false) {
+  pthread_rwlock_init(&rwlock_, NULL);
+  std::vector<rocksdb::ColumnFamilyHandle*> column_families(handles);
+  if (column_families.empty()) {
+    column_families.push_back(base_db->DefaultColumnFamily());
+  }
+  for (const auto handle : column_families) {
+    rocksdb::Options cf_ops = base_db->GetOptions(handle);
+    Table* table = new Table(cf_ops.comparator != nullptr
+        ? cf_ops.comparator : rocksdb::BytewiseComparator());
+    table->id = handle->GetID();
+    table->filter_factory = cf_ops.compaction_filter_factory;
+    tables_.emplace_back(table);
+    tables_by_id_[table->id] = table;
+    tables_by_handle_[handle] = table;
+  }
+  // The writes without a column family go to the default one
+  tables_by_handle_[base_db->DefaultColumnFamily()] = tables_by_id_[0];
+}
+
+MemoryDB::~MemoryDB() {
+  slash::MutexLock l(&bg_mutex_);
+  shutting_down_ = true;
+  while (bg_compaction_scheduled_) {
+    bg_cv_.Wait();
+  }
+  pthread_rwlock_destroy(&rwlock_);
+}
+
+Status MemoryDB::Get(const rocksdb::ReadOptions& options,
+                     rocksdb::ColumnFamilyHandle* column_family,
+                     const Slice& key, rocksdb::PinnableSlice* value) {
+  Table* table = FindTable(column_family);
+  if (table == nullptr) {
+    return Status::InvalidArgument("Unknown column family");
+  }
+  slash::RWLock l(&rwlock_, false);
+  rocksdb::SequenceNumber sequence = options.snapshot != nullptr
+    ? options.snapshot->GetSequenceNumber() : last_sequence_.load();
+  auto iter = table->entries.find(key.ToString());
+  if (iter == table->entries.end()) {
+    return Status::NotFound();
+  }
+  const Version* version = Visible(iter->second, sequence);
+  if (version == nullptr) {
+    return Status::NotFound();
+  }
+  value->PinSelf(version->value);
+  return Status::OK();
+}
+
+bool MemoryDB::KeyMayExist(const rocksdb::ReadOptions& options,
+                           rocksdb::ColumnFamilyHandle* column_family,
+                           const Slice& key, std::string* value,
+                           bool* value_found) {
+  rocksdb::PinnableSlice pinnable_value;
+  Status s = Get(options, column_family, key, &pinnable_value);
+  if (value_found != nullptr) {
+    *value_found = s.ok();
+  }
+  if (s.ok() && value != nullptr) {
+    value->assign(pinnable_value.data(), pinnable_value.size());
+  }
+  return !s.IsNotFound();
+}
+
+Status MemoryDB::Put(const rocksdb::WriteOptions& options,
+                     rocksdb::ColumnFamilyHandle* column_family,
+                     const Slice& key, const Slice& value) {
+  Table* table = FindTable(column_family);
+  if (table == nullptr) {
+    return Status::InvalidArgument("Unknown column family");
+  }
+  bool compact;
+  {
+    slash::RWLock l(&rwlock_, true);
+    rocksdb::SequenceNumber sequence = last_sequence_.load() + 1;
+    AddVersion(table, key, false, value, sequence, OldestVisibleSequence());
+    table->writes_since_compaction++;
+    last_sequence_.store(sequence);
+    compact = NeedsCompaction();
+  }
+  if (compact) {
+    MaybeScheduleCompaction();
+  }
+  return Status::OK();
+}
+
+Status MemoryDB::Delete(const rocksdb::WriteOptions& options,
+                        rocksdb::ColumnFamilyHandle* column_family,
+                        const Slice& key) {
+  Table* table = FindTable(column_family);
+  if (table == nullptr) {
+    return Status::InvalidArgument("Unknown column family");
+  }
+  bool compact;
+  {
+    slash::RWLock l(&rwlock_, true);
+    rocksdb::SequenceNumber sequence = last_sequence_.load() + 1;
+    AddVersion(table, key, true, Slice(), sequence, OldestVisibleSequence());
+    table->writes_since_compaction++;
+    last_sequence_.store(sequence);
+    compact = NeedsCompaction();
+  }
+  if (compact) {
+    MaybeScheduleCompaction();
+  }
+  return Status::OK();
+}
+
+Status MemoryDB::SingleDelete(const rocksdb::WriteOptions& options,
+                              rocksdb::ColumnFamilyHandle* column_family,
+                              const Slice& key) {
+  return Delete(options, column_family, key);
+}
+
+Status MemoryDB::DeleteRange(const rocksdb::WriteOptions& options,
+                             rocksdb::ColumnFamilyHandle* column_family,
+                             const Slice& begin_key, const Slice& end_key) {
+  Table* table = FindTable(column_family);
+  if (table == nullptr) {
+    return Status::InvalidArgument("Unknown column family");
+  }
+  bool compact;
+  {
+    slash::RWLock l(&rwlock_, true);
+    rocksdb::SequenceNumber sequence = last_sequence_.load() + 1;
+    AddRangeDeletion(table, begin_key, end_key, sequence,
+                     OldestVisibleSequence());
+    table->writes_since_compaction++;
+    last_sequence_.store(sequence);
+    compact = NeedsCompaction();
+  }
+  if (compact) {
+    MaybeScheduleCompaction();
+  }
+  return Status::OK();
+}
+
+Status MemoryDB::Merge(const rocksdb::WriteOptions& options,
+                       rocksdb::ColumnFamilyHandle* column_family,
+                       const Slice& key, const Slice& value) {
+  return Status::NotSupported("Merge on the memory backend");
+}
+
+Status MemoryDB::Write(const rocksdb::WriteOptions& options,
+                       rocksdb::WriteBatch* updates) {
+  BatchChecker checker(this);
+  Status s = updates->Iterate(&checker);
+  if (!s.ok()) {
+    return s;
+  }
+  bool compact;
+  {
+    slash::RWLock l(&rwlock_, true);
+    BatchApplier applier(this, last_sequence_.load(),
+                         OldestVisibleSequence());
+    s = updates->Iterate(&applier);
+    last_sequence_.store(applier.sequence());
+    compact = NeedsCompaction();
+  }
+  if (compact) {
+    MaybeScheduleCompaction();
+  }
+  return s;
+}
+
+rocksdb::Iterator* MemoryDB::NewIterator(const rocksdb::ReadOptions& options,
+    rocksdb::ColumnFamilyHandle* column_family) {
+  Table* table = FindTable(column_family);
+  if (table == nullptr) {
+    return rocksdb::NewErrorIterator(
+        Status::InvalidArgument("Unknown column family"));
+  }
+  if (options.snapshot != nullptr) {
+    return new MemoryIterator(this, table, options,
+        options.snapshot->GetSequenceNumber(), false);
+  }
+  return new MemoryIterator(this, table, options, AcquireSequence(), true);
+}
+
+Status MemoryDB::NewIterators(const rocksdb::ReadOptions& options,
+    const std::vector<rocksdb::ColumnFamilyHandle*>& column_families,
+    std::vector<rocksdb::Iterator*>* iterators) {
+  iterators->clear();
+  for (const auto column_family : column_families) {
+    if (FindTable(column_family) == nullptr) {
+      return Status::InvalidArgument("Unknown column family");
+    }
+  }
+  if (options.snapshot != nullptr) {
+    for (const auto column_family : column_families) {
+      iterators->push_back(new MemoryIterator(this, FindTable(column_family),
+            options, options.snapshot->GetSequenceNumber(), false));
+    }
+    return Status::OK();
+  }
+  // All of them see the same sequence, registered once per iterator
+  rocksdb::SequenceNumber sequence = AcquireSequence();
+  for (size_t idx = 0; idx < column_families.size(); idx++) {
+    if (idx > 0) {
+      slash::MutexLock l(&snapshots_mutex_);
+      snapshots_.insert(sequence);
+    }
+    iterators->push_back(new MemoryIterator(this,
+          FindTable(column_families[idx]), options, sequence, true));
+  }
+  if (column_families.empty()) {
+    ReleaseSequence(sequence);
+  }
+  return Status::OK();
+}
+
+const rocksdb::Snapshot* MemoryDB::GetSnapshot() {
+  int64_t unix_time = 0;
+  GetEnv()->GetCurrentTime(&unix_time);
+  return new MemorySnapshot(AcquireSequence(), unix_time);
+}
+
+void MemoryDB::ReleaseSnapshot(const rocksdb::Snapshot* snapshot) {
+  if (snapshot == nullptr) {
+    return;
+  }
+  ReleaseSequence(snapshot->GetSequenceNumber());
+  delete static_cast<const MemorySnapshot*>(snapshot);
+}
+
+rocksdb::SequenceNumber MemoryDB::GetLatestSequenceNumber() const {
+  return last_sequence_.load();
+}
+
+bool MemoryDB::GetProperty(rocksdb::ColumnFamilyHandle* column_family,
+                           const Slice& property, std::string* value) {
+  uint64_t int_value;
+  if ((property == kNumKeysProperty || property == kMemorySizeProperty)
+    && GetIntProperty(column_family, property, &int_value)) {
+    *value = std::to_string(int_value);
+    return true;
+  }
+  return rocksdb::StackableDB::GetProperty(column_family, property, value);
+}
+
+bool MemoryDB::GetIntProperty(rocksdb::ColumnFamilyHandle* column_family,
+                              const Slice& property, uint64_t* value) {
+  Table* table = FindTable(column_family);
+  if (table != nullptr && property == kNumKeysProperty) {
+    slash::RWLock l(&rwlock_, false);
+    *value = table->entries.size();
+    return true;
+  } else if (table != nullptr && property == kMemorySizeProperty) {
+    slash::RWLock l(&rwlock_, false);
+    *value = table->bytes;
+    return true;
+  }
+  return rocksdb::StackableDB::GetIntProperty(column_family, property, value);
+}
+
+Status MemoryDB::CompactRange(const rocksdb::CompactRangeOptions& options,
+                              rocksdb::ColumnFamilyHandle* column_family,
+                              const Slice* begin, const Slice* end) {
+  Table* table = FindTable(column_family);
+  if (table == nullptr) {
+    return Status::InvalidArgument("Unknown column family");
+  }
+  CompactTable(table, begin, end, true);
+  return Status::OK();
+}
+
+Status MemoryDB::GetUpdatesSince(rocksdb::SequenceNumber seq_number,
+    std::unique_ptr<rocksdb::TransactionLogIterator>* iter,
+    const rocksdb::TransactionLogIterator::ReadOptions& read_options) {
+  return Status::NotSupported("No WAL on the memory backend");
+}
+
+MemoryDB::Table* MemoryDB::FindTable(
+    rocksdb::ColumnFamilyHandle* column_family) {
+  auto iter = tables_by_handle_.find(column_family);
+  return iter == tables_by_handle_.end() ? nullptr : iter->second;
+}
+
+rocksdb::SequenceNumber MemoryDB::AcquireSequence() {
+  slash::RWLock l(&rwlock_, false);
+  slash::MutexLock ml(&snapshots_mutex_);
+  rocksdb::SequenceNumber sequence = last_sequence_.load();
+  snapshots_.insert(sequence);
+  return sequence;
+}
+
+void MemoryDB::ReleaseSequence(rocksdb::SequenceNumber sequence) {
+  slash::MutexLock l(&snapshots_mutex_);
+  auto iter = snapshots_.find(sequence);
+  if (iter != snapshots_.end()) {
+    snapshots_.erase(iter);
+  }
+}
+
+rocksdb::SequenceNumber MemoryDB::OldestVisibleSequence() {
+  slash::MutexLock l(&snapshots_mutex_);
+  return snapshots_.empty() ? kMaxSequenceNumber : *snapshots_.begin();
+}
+
+const MemoryDB::Version* MemoryDB::Visible(
+    const std::vector<Version>& versions, rocksdb::SequenceNumber sequence) {
+  for (auto iter = versions.rbegin(); iter != versions.rend(); ++iter) {
+    if (iter->sequence <= sequence) {
+      return iter->deleted ? nullptr : &*iter;
+    }
+  }
+  return nullptr;
+}
+
+void MemoryDB::AddVersion(Table* table, const Slice& key, bool deleted,
+                          const Slice& value, rocksdb::SequenceNumber sequence,
+                          rocksdb::SequenceNumber oldest) {
+  std::string key_str(key.data(), key.size());
+  Entries::iterator iter = table->entries.lower_bound(key_str);
+  if (iter == table->entries.end()
+    || table->comparator->Compare(key, iter->first) != 0) {
+    // Nothing to hide from anyone
+    if (deleted) {
+      return;
+    }
+    iter = table->entries.emplace_hint(iter, std::move(key_str),
+                                       std::vector<Version>());
+    table->bytes += iter->first.size() + kEntryOverhead;
+  } else if (deleted && iter->second.back().deleted) {
+    return;
+  }
+  iter->second.push_back(Version{sequence, deleted, value.ToString()});
+  table->bytes += value.size() + kVersionOverhead;
+  TrimVersions(table, iter, oldest);
+}
+
+void MemoryDB::TrimVersions(Table* table, Entries::iterator iter,
+                            rocksdb::SequenceNumber oldest) {
+  std::vector<Version>& versions = iter->second;
+  // The newest version the oldest reader sees, the older ones are dead
+  size_t oldest_visible = 0;
+  for (size_t idx = versions.size(); idx > 0; idx--) {
+    if (versions[idx - 1].sequence <= oldest) {
+      oldest_visible = idx - 1;
+      break;
+    }
+  }
+  if (oldest_visible > 0) {
+    for (size_t idx = 0; idx < oldest_visible; idx++) {
+      table->bytes -= versions[idx].value.size() + kVersionOverhead;
+    }
+    versions.erase(versions.begin(), versions.begin() + oldest_visible);
+  }
+  if (versions.size() == 1 && versions[0].deleted
+    && versions[0].sequence <= oldest) {
+    table->bytes -= iter->first.size() + kEntryOverhead + kVersionOverhead;
+    table->entries.erase(iter);
+  }
+}
+
+void MemoryDB::AddRangeDeletion(Table* table, const Slice& begin_key,
+                                const Slice& end_key,
+                                rocksdb::SequenceNumber sequence,
+                                rocksdb::SequenceNumber oldest) {
+  std::vector<std::string> keys;
+  for (auto iter = table->entries.lower_bound(begin_key.ToString());
+       iter != table->entries.end()
+         && table->comparator->Compare(iter->first, end_key) < 0;
+       ++iter) {
+    if (!iter->second.back().deleted) {
+      keys.push_back(iter->first);
+    }
+  }
+  for (const auto& key : keys) {
+    AddVersion(table, key, true, Slice(), sequence, oldest);
+  }
+}
+
+bool MemoryDB::NeedsCompaction() {
+  for (const auto& table : tables_) {
+    if (table->filter_factory != nullptr
+      && table->writes_since_compaction >= std::max(kMinCompactionWrites,
+           static_cast<uint64_t>(table->entries.size()))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The filters read the other column families through this db, so they
+// run without the lock, a decision only applies when the key was not
+// written in between
+void MemoryDB::CompactTable(Table* table, const Slice* begin,
+                            const Slice* end, bool manual) {
+  if (table->filter_factory == nullptr) {
+    return;
+  }
+  rocksdb::CompactionFilter::Context context;
+  context.is_full_compaction = begin == nullptr && end == nullptr;
+  context.is_manual_compaction = manual;
+  context.column_family_id = table->id;
+  std::unique_ptr<rocksdb::CompactionFilter> filter =
+    table->filter_factory->CreateCompactionFilter(context);
+  if (filter == nullptr) {
+    return;
+  }
+
+  struct Candidate {
+    std::string key;
+    std::string value;
+    rocksdb::SequenceNumber sequence;
+    bool remove;
+    bool value_changed;
+    std::string new_value;
+  };
+  std::string cursor;
+  bool started = false;
+  bool finished = false;
+  while (!finished && !shutting_down_.load()) {
+    std::vector<Candidate> candidates;
+    {
+      slash::RWLock l(&rwlock_, false);
+      Entries::iterator iter;
+      if (started) {
+        iter = table->entries.upper_bound(cursor);
+      } else if (begin != nullptr) {
+        iter = table->entries.lower_bound(begin->ToString());
+      } else {
+        iter = table->entries.begin();
+      }
+      size_t scanned = 0;
+      for (; iter != table->entries.end() && scanned < kCompactionBatch;
+           ++iter, ++scanned) {
+        if (end != nullptr
+          && table->comparator->Compare(iter->first, *end) > 0) {
+          break;
+        }
+        const Version& newest = iter->second.back();
+        if (!newest.deleted) {
+          candidates.push_back(Candidate{iter->first, newest.value,
+              newest.sequence, false, false, std::string()});
+        }
+        cursor = iter->first;
+        started = true;
+      }
+      finished = iter == table->entries.end() || scanned < kCompactionBatch;
+    }
+
+    bool changed = false;
+    for (auto& candidate : candidates) {
+      candidate.remove = filter->Filter(0, candidate.key, candidate.value,
+          &candidate.new_value, &candidate.value_changed);
+      changed = changed || candidate.remove || candidate.value_changed;
+    }
+    if (!changed) {
+      continue;
+    }
+
+    slash::RWLock l(&rwlock_, true);
+    rocksdb::SequenceNumber oldest = OldestVisibleSequence();
+    rocksdb::SequenceNumber sequence = last_sequence_.load();
+    for (const auto& candidate : candidates) {
+      if (!candidate.remove && !candidate.value_changed) {
+        continue;
+      }
+      auto iter = table->entries.find(candidate.key);
+      if (iter == table->entries.end()
+        || iter->second.back().sequence != candidate.sequence) {
+        continue;
+      }
+      AddVersion(table, candidate.key, candidate.remove,
+                 candidate.new_value, ++sequence, oldest);
+    }
+    last_sequence_.store(sequence);
+  }
+}
+
+void MemoryDB::MaybeScheduleCompaction() {
+  slash::MutexLock l(&bg_mutex_);
+  if (bg_compaction_scheduled_ || shutting_down_.load()) {
+    return;
+  }
+  bg_compaction_scheduled_ = true;
+  GetEnv()->Schedule(&MemoryDB::BGWork, this, rocksdb::Env::Priority::LOW);
+}
+
+void MemoryDB::BGWork(void* arg) {
+  reinterpret_cast<MemoryDB*>(arg)->BackgroundCompaction();
+}
+
+void MemoryDB::BackgroundCompaction() {
+  for (const auto& table : tables_) {
+    bool compact;
+    {
+      slash::RWLock l(&rwlock_, true);
+      compact = table->filter_factory != nullptr
+        && table->writes_since_compaction >= std::max(kMinCompactionWrites,
+             static_cast<uint64_t>(table->entries.size()));
+      if (compact) {
+        table->writes_since_compaction = 0;
+      }
+    }
+    if (compact) {
+      CompactTable(table.get(), nullptr, nullptr, false);
+    }
+  }
+  slash::MutexLock l(&bg_mutex_);
+  bg_compaction_scheduled_ = false;
+  bg_cv_.SignalAll();
+}
+
+}  //  namespace blackwidow
@@ -0,0 +1,197 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_MEMORY_DB_H_
+#define SRC_MEMORY_DB_H_
+
+#include <map>
+#include <set>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "rocksdb/db.h"
+#include "rocksdb/utilities/stackable_db.h"
+#include "slash/include/slash_mutex.h"
+
+namespace blackwidow {
+using Status = rocksdb::Status;
+using Slice = rocksdb::Slice;
+
+// The engine of kMemoryBackend, every column family is one ordered map
+// in the order of its comparator, a write is an insert into the map, no
+// memtable, flush, table file or LSM compaction is involved. The type dbs
+// keep talking to the rocksdb::DB interface, the wrapped base db only
+// owns the column family handles and their options and never holds data.
+//
+// Reads see the newest version of a key not newer than their snapshot,
+// the older versions are dropped as soon as no snapshot can see them.
+// The compaction filters of the column families run over the maps by
+// CompactRange, and in the background once as many writes as the column
+// family has entries came in since its last run.
+//
+// The maps behind one rwlock favor correctness over speed, an arena
+// based tree could replace them behind the same interface
+class MemoryDB : public rocksdb::StackableDB {
+ public:
+  MemoryDB(rocksdb::DB* base_db,
+           const std::vector<rocksdb::ColumnFamilyHandle*>& handles);
+  ~MemoryDB();
+
+  using rocksdb::StackableDB::Get;
+  using rocksdb::StackableDB::Put;
+  using rocksdb::StackableDB::Delete;
+  using rocksdb::StackableDB::NewIterator;
+  using rocksdb::StackableDB::GetProperty;
+  using rocksdb::StackableDB::GetIntProperty;
+  using rocksdb::StackableDB::CompactRange;
+
+  Status Get(const rocksdb::ReadOptions& options,
+             rocksdb::ColumnFamilyHandle* column_family,
+             const Slice& key, rocksdb::PinnableSlice* value) override;
+  bool KeyMayExist(const rocksdb::ReadOptions& options,
+                   rocksdb::ColumnFamilyHandle* column_family,
+                   const Slice& key, std::string* value,
+                   bool* value_found = nullptr) override;
+
+  Status Put(const rocksdb::WriteOptions& options,
+             rocksdb::ColumnFamilyHandle* column_family,
+             const Slice& key, const Slice& value) override;
+  Status Delete(const rocksdb::WriteOptions& options,
+                rocksdb::ColumnFamilyHandle* column_family,
+                const Slice& key) override;
+  Status SingleDelete(const rocksdb::WriteOptions& options,
+                      rocksdb::ColumnFamilyHandle* column_family,
+                      const Slice& key) override;
+  Status DeleteRange(const rocksdb::WriteOptions& options,
+                     rocksdb::ColumnFamilyHandle* column_family,
+                     const Slice& begin_key, const Slice& end_key) override;
+  Status Merge(const rocksdb::WriteOptions& options,
+               rocksdb::ColumnFamilyHandle* column_family,
+               const Slice& key, const Slice& value) override;
+  Status Write(const rocksdb::WriteOptions& options,
+               rocksdb::WriteBatch* updates) override;
+
+  rocksdb::Iterator* NewIterator(const rocksdb::ReadOptions& options,
+      rocksdb::ColumnFamilyHandle* column_family) override;
+  Status NewIterators(const rocksdb::ReadOptions& options,
+      const std::vector<rocksdb::ColumnFamilyHandle*>& column_families,
+      std::vector<rocksdb::Iterator*>* iterators) override;
+  const rocksdb::Snapshot* GetSnapshot() override;
+  void ReleaseSnapshot(const rocksdb::Snapshot* snapshot) override;
+  rocksdb::SequenceNumber GetLatestSequenceNumber() const override;
+
+  // "rocksdb.estimate-num-keys" is the exact number of keys and
+  // "rocksdb.cur-size-all-mem-tables" the bytes of the map, the other
+  // properties are the ones of the empty base db
+  bool GetProperty(rocksdb::ColumnFamilyHandle* column_family,
+                   const Slice& property, std::string* value) override;
+  bool GetIntProperty(rocksdb::ColumnFamilyHandle* column_family,
+                      const Slice& property, uint64_t* value) override;
+
+  // Run the compaction filter of the column family over [begin, end]
+  Status CompactRange(const rocksdb::CompactRangeOptions& options,
+                      rocksdb::ColumnFamilyHandle* column_family,
+                      const Slice* begin, const Slice* end) override;
+
+  // There is no WAL to replay the writes from
+  Status GetUpdatesSince(rocksdb::SequenceNumber seq_number,
+      std::unique_ptr<rocksdb::TransactionLogIterator>* iter,
+      const rocksdb::TransactionLogIterator::ReadOptions& read_options =
+        rocksdb::TransactionLogIterator::ReadOptions()) override;
+
+ private:
+  class MemoryIterator;
+  class MemorySnapshot;
+  class BatchChecker;
+  class BatchApplier;
+
+  struct Version {
+    rocksdb::SequenceNumber sequence;
+    bool deleted;
+    std::string value;
+  };
+
+  struct KeyComparator {
+    const rocksdb::Comparator* comparator;
+    bool operator()(const std::string& a, const std::string& b) const {
+      return comparator->Compare(a, b) < 0;
+    }
+  };
+
+  // The versions of a key, oldest first
+  typedef std::map<std::string, std::vector<Version>, KeyComparator> Entries;
+
+  struct Table {
+    uint32_t id;
+    const rocksdb::Comparator* comparator;
+    std::shared_ptr<rocksdb::CompactionFilterFactory> filter_factory;
+    Entries entries;
+    uint64_t bytes;
+    uint64_t writes_since_compaction;
+    explicit Table(const rocksdb::Comparator* cmp)
+      : id(0), comparator(cmp), entries(KeyComparator{cmp}),
+        bytes(0), writes_since_compaction(0) {}
+  };
+
+  // Guards every table, readers share it and writers own it
+  pthread_rwlock_t rwlock_;
+  std::vector<std::unique_ptr<Table>> tables_;
+  std::unordered_map<uint32_t, Table*> tables_by_id_;
+  std::unordered_map<rocksdb::ColumnFamilyHandle*, Table*> tables_by_handle_;
+  std::atomic<rocksdb::SequenceNumber> last_sequence_;
+
+  // The sequences of the live snapshots and iterators, registered under
+  // the read lock so that a writer always sees them
+  slash::Mutex snapshots_mutex_;
+  std::multiset<rocksdb::SequenceNumber> snapshots_;
+
+  slash::Mutex bg_mutex_;
+  slash::CondVar bg_cv_;
+  bool bg_compaction_scheduled_;
+  std::atomic<bool> shutting_down_;
+
+  Table* FindTable(rocksdb::ColumnFamilyHandle* column_family);
+  rocksdb::SequenceNumber AcquireSequence();
+  void ReleaseSequence(rocksdb::SequenceNumber sequence);
+  // Versions older than this are invisible to every reader but the
+  // newest of them, called with the write lock held
+  rocksdb::SequenceNumber OldestVisibleSequence();
+
+  // The version of key visible at sequence, nullptr when key does not
+  // exist there
+  static const Version* Visible(const std::vector<Version>& versions,
+                                rocksdb::SequenceNumber sequence);
+  // Append a version of key and drop the ones nobody can see anymore,
+  // called with the write lock held
+  void AddVersion(Table* table, const Slice& key, bool deleted,
+                  const Slice& value, rocksdb::SequenceNumber sequence,
+                  rocksdb::SequenceNumber oldest);
+  void TrimVersions(Table* table, Entries::iterator iter,
+                    rocksdb::SequenceNumber oldest);
+  // Delete the keys of [begin_key, end_key), called with the write lock held
+  void AddRangeDeletion(Table* table, const Slice& begin_key,
+                        const Slice& end_key,
+                        rocksdb::SequenceNumber sequence,
+                        rocksdb::SequenceNumber oldest);
+  // Whether a table got enough writes for a background compaction,
+  // called with the write lock held
+  bool NeedsCompaction();
+
+  void CompactTable(Table* table, const Slice* begin, const Slice* end,
+                    bool manual);
+  void MaybeScheduleCompaction();
+  static void BGWork(void* arg);
+  void BackgroundCompaction();
+
+  // No copying allowed
+  MemoryDB(const MemoryDB&);
+  void operator=(const MemoryDB&);
+};
+
+}  //  namespace blackwidow
+#endif  //  SRC_MEMORY_DB_H_
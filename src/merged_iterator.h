@@ -0,0 +1,147 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_MERGED_ITERATOR_H_
+#define SRC_MERGED_ITERATOR_H_
+
+#include <vector>
+
+#include "rocksdb/iterator.h"
+#include "rocksdb/comparator.h"
+
+namespace blackwidow {
+
+// Iterate the column families of one db as a whole, the children must
+// be created by DB::NewIterators so they share the same view, and a
+// key can only exist in one of the column families
+class MergedIterator : public rocksdb::Iterator {
+ public:
+  MergedIterator(const rocksdb::Comparator* comparator,
+                 const std::vector<rocksdb::Iterator*>& children)
+      : comparator_(comparator),
+        children_(children),
+        current_(nullptr),
+        forward_(true) {}
+
+  ~MergedIterator() override {
+    for (auto child : children_) {
+      delete child;
+    }
+  }
+
+  bool Valid() const override {
+    return current_ != nullptr;
+  }
+
+  void SeekToFirst() override {
+    for (auto child : children_) {
+      child->SeekToFirst();
+    }
+    forward_ = true;
+    FindSmallest();
+  }
+
+  void SeekToLast() override {
+    for (auto child : children_) {
+      child->SeekToLast();
+    }
+    forward_ = false;
+    FindLargest();
+  }
+
+  void Seek(const rocksdb::Slice& target) override {
+    for (auto child : children_) {
+      child->Seek(target);
+    }
+    forward_ = true;
+    FindSmallest();
+  }
+
+  void SeekForPrev(const rocksdb::Slice& target) override {
+    for (auto child : children_) {
+      child->SeekForPrev(target);
+    }
+    forward_ = false;
+    FindLargest();
+  }
+
+  void Next() override {
+    if (!forward_) {
+      // Move the other children after the current key
+      for (auto child : children_) {
+        if (child != current_) {
+          child->Seek(current_->key());
+        }
+      }
+      forward_ = true;
+    }
+    current_->Next();
+    FindSmallest();
+  }
+
+  void Prev() override {
+    if (forward_) {
+      // Move the other children before the current key
+      for (auto child : children_) {
+        if (child != current_) {
+          child->SeekForPrev(current_->key());
+        }
+      }
+      forward_ = false;
+    }
+    current_->Prev();
+    FindLargest();
+  }
+
+  rocksdb::Slice key() const override {
+    return current_->key();
+  }
+
+  rocksdb::Slice value() const override {
+    return current_->value();
+  }
+
+  rocksdb::Status status() const override {
+    for (auto child : children_) {
+      if (!child->status().ok()) {
+        return child->status();
+      }
+    }
+    return rocksdb::Status::OK();
+  }
+
+ private:
+  const rocksdb::Comparator* comparator_;
+  std::vector<rocksdb::Iterator*> children_;
+  rocksdb::Iterator* current_;
+  bool forward_;
+
+  void FindSmallest() {
+    current_ = nullptr;
+    for (auto child : children_) {
+      if (child->Valid() && (current_ == nullptr
+        || comparator_->Compare(child->key(), current_->key()) < 0)) {
+        current_ = child;
+      }
+    }
+  }
+
+  void FindLargest() {
+    current_ = nullptr;
+    for (auto child : children_) {
+      if (child->Valid() && (current_ == nullptr
+        || comparator_->Compare(child->key(), current_->key()) > 0)) {
+        current_ = child;
+      }
+    }
+  }
+
+  // No copying allowed
+  MergedIterator(const MergedIterator&);
+  void operator=(const MergedIterator&);
+};
+
+}  //  namespace blackwidow
+#endif  //  SRC_MERGED_ITERATOR_H_
@@ -0,0 +1,159 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_ORIGIN_FILTER_H_
+#define SRC_ORIGIN_FILTER_H_
+
+#include <string>
+#include <memory>
+#include <vector>
+
+#include "src/debug.h"
+#include "src/base_data_key_format.h"
+#include "rocksdb/db.h"
+#include "rocksdb/compaction_filter.h"
+
+namespace blackwidow {
+
+// A renamed collection keeps reading the data keys of its origin key,
+// every rename records | origin_len | origin | version | referrer | in
+// origin_cf, so that the data filters reserve the data keys of
+// (origin, version) for as long as the referrer still reads them
+template <typename ParsedMetaValue>
+bool IsLiveReferrer(rocksdb::DB* db, rocksdb::ColumnFamilyHandle* meta_cf,
+                    const Slice& referrer, const Slice& origin,
+                    int32_t version) {
+  std::string meta_value;
+  Status s = db->Get(rocksdb::ReadOptions(), meta_cf, referrer, &meta_value);
+  if (s.IsNotFound()) {
+    return false;
+  } else if (!s.ok()) {
+    return true;
+  }
+  ParsedMetaValue parsed_meta_value(&meta_value);
+  return !parsed_meta_value.IsStale()
+    && parsed_meta_value.count() != 0
+    && parsed_meta_value.has_origin()
+    && parsed_meta_value.origin() == origin
+    && parsed_meta_value.version() == version;
+}
+
+// Used by the data filters for the data keys which are not read by
+// their own key anymore, the answer of the last (key, version) is cached
+template <typename ParsedMetaValue>
+class OriginRefReader {
+ public:
+  OriginRefReader(rocksdb::DB* db,
+                  std::vector<rocksdb::ColumnFamilyHandle*>* cf_handles_ptr) :
+    db_(db),
+    cf_handles_ptr_(cf_handles_ptr),
+    checked_(false),
+    cur_version_(0),
+    cur_referenced_(false) {}
+
+  bool IsReferenced(const Slice& key, int32_t version) {
+    if (checked_ && key == cur_key_ && version == cur_version_) {
+      return cur_referenced_;
+    }
+    // destroyed when close the database, Reserve Current key value
+    if (cf_handles_ptr_->size() == 0) {
+      return true;
+    }
+
+    cur_referenced_ = false;
+    OriginRefKey origin_ref_key(key, version, Slice());
+    Slice prefix = origin_ref_key.Encode();
+    rocksdb::Iterator* iter = db_->NewIterator(default_read_options_,
+        cf_handles_ptr_->back());
+    for (iter->Seek(prefix);
+         iter->Valid() && iter->key().starts_with(prefix) && !cur_referenced_;
+         iter->Next()) {
+      ParsedOriginRefKey parsed_origin_ref_key(iter->key());
+      cur_referenced_ = IsLiveReferrer<ParsedMetaValue>(db_,
+          (*cf_handles_ptr_)[0], parsed_origin_ref_key.referrer(),
+          key, version);
+    }
+    if (!iter->status().ok()) {
+      cur_referenced_ = true;
+    }
+    delete iter;
+    checked_ = true;
+    cur_key_ = key.ToString();
+    cur_version_ = version;
+    return cur_referenced_;
+  }
+
+ private:
+  rocksdb::DB* db_;
+  std::vector<rocksdb::ColumnFamilyHandle*>* cf_handles_ptr_;
+  rocksdb::ReadOptions default_read_options_;
+  bool checked_;
+  std::string cur_key_;
+  int32_t cur_version_;
+  bool cur_referenced_;
+};
+
+template <typename ParsedMetaValue>
+class OriginRefFilter : public rocksdb::CompactionFilter {
+ public:
+  OriginRefFilter(rocksdb::DB* db,
+                  std::vector<rocksdb::ColumnFamilyHandle*>* cf_handles_ptr) :
+    db_(db), cf_handles_ptr_(cf_handles_ptr) {}
+
+  bool Filter(int level, const rocksdb::Slice& key,
+              const rocksdb::Slice& value,
+              std::string* new_value, bool* value_changed) const override {
+    ParsedOriginRefKey parsed_origin_ref_key(key);
+    Trace("==========================START==========================");
+    Trace("[OriginRefFilter], origin: %s, version = %d, referrer = %s",
+          parsed_origin_ref_key.origin().ToString().c_str(),
+          parsed_origin_ref_key.version(),
+          parsed_origin_ref_key.referrer().ToString().c_str());
+
+    // destroyed when close the database, Reserve Current key value
+    if (cf_handles_ptr_->size() == 0) {
+      return false;
+    }
+    if (IsLiveReferrer<ParsedMetaValue>(db_, (*cf_handles_ptr_)[0],
+          parsed_origin_ref_key.referrer(), parsed_origin_ref_key.origin(),
+          parsed_origin_ref_key.version())) {
+      Trace("Reserve[Referrer reads origin]");
+      return false;
+    } else {
+      Trace("Drop[Referrer not reads origin]");
+      return true;
+    }
+  }
+
+  const char* Name() const override { return "OriginRefFilter"; }
+
+ private:
+  rocksdb::DB* db_;
+  std::vector<rocksdb::ColumnFamilyHandle*>* cf_handles_ptr_;
+};
+
+template <typename ParsedMetaValue>
+class OriginRefFilterFactory : public rocksdb::CompactionFilterFactory {
+ public:
+  OriginRefFilterFactory(rocksdb::DB** db_ptr,
+                         std::vector<rocksdb::ColumnFamilyHandle*>* handles_ptr)
+      : db_ptr_(db_ptr), cf_handles_ptr_(handles_ptr) {
+  }
+  std::unique_ptr<rocksdb::CompactionFilter> CreateCompactionFilter(
+    const rocksdb::CompactionFilter::Context& context) override {
+    return std::unique_ptr<rocksdb::CompactionFilter>(
+           new OriginRefFilter<ParsedMetaValue>(*db_ptr_, cf_handles_ptr_));
+  }
+  const char* Name() const override {
+    return "OriginRefFilterFactory";
+  }
+
+ private:
+  rocksdb::DB** db_ptr_;
+  std::vector<rocksdb::ColumnFamilyHandle*>* cf_handles_ptr_;
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_ORIGIN_FILTER_H_
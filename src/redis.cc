@@ -5,6 +5,26 @@
 
 #include "src/redis.h"
 
+#include <algorithm>
+#include <limits>
+
+#include "rocksdb/transaction_log.h"
+
+#include "src/memory_db.h"
+#include "src/change_stream.h"
+#include "src/scope_snapshot.h"
+#include "src/write_stall_listener.h"
+#include "src/strings_value_format.h"
+#include "src/base_meta_value_format.h"
+#include "src/lists_meta_value_format.h"
+#include "src/streams_meta_value_format.h"
+#include "src/base_data_key_format.h"
+#include "src/lists_data_key_format.h"
+#include "src/zsets_data_key_format.h"
+#include "src/scope_record_lock.h"
+#include "src/murmurhash.h"
+#include "blackwidow/util.h"
+
 namespace blackwidow {
 
 Redis::Redis(BlackWidow* const bw, const DataType& type)
@@ -12,7 +32,11 @@ Redis::Redis(BlackWidow* const bw, const DataType& type)
       type_(type),
       lock_mgr_(new LockMgr(1000, 0, std::make_shared<MutexFactoryImpl>())),
       db_(nullptr),
-      small_compaction_threshold_(5000) {
+      open_mode_(kOpenReadWrite),
+      write_stall_listener_(std::make_shared<WriteStallListener>()),
+      cf_handles_(nullptr),
+      small_compaction_threshold_(5000),
+      version_floor_(0) {
   statistics_store_ = new LRUCache<std::string, size_t>();
   scan_cursors_store_ = new LRUCache<std::string, std::string>();
   scan_cursors_store_->SetCapacity(5000);
@@ -27,6 +51,713 @@ Redis::~Redis() {
   delete scan_cursors_store_;
 }
 
+static std::string SecondaryPath(const BlackwidowOptions& bw_options,
+                                 const std::string& db_path) {
+  std::string sub_db = db_path.substr(db_path.find_last_of('/') + 1);
+  if (!bw_options.secondary_path.empty()
+    && bw_options.secondary_path.back() == '/') {
+    return bw_options.secondary_path + sub_db;
+  } else {
+    return bw_options.secondary_path + "/" + sub_db;
+  }
+}
+
+// The file numbers of different dbs would collide in one directory, every
+// type db keeps its files of a tier in the sub directory named after it
+static std::vector<rocksdb::DbPath> TierPaths(
+    const BlackwidowOptions& bw_options,
+    const std::vector<rocksdb::DbPath>& paths,
+    const std::string& db_path) {
+  std::string sub_db = db_path.substr(db_path.find_last_of('/') + 1);
+  std::vector<rocksdb::DbPath> tier_paths;
+  for (const auto& path : paths) {
+    std::string tier_path = path.path.back() == '/'
+      ? path.path + sub_db : path.path + "/" + sub_db;
+    if (bw_options.storage_backend == kRocksDBBackend
+      && bw_options.open_mode == kOpenReadWrite) {
+      mkpath(tier_path.c_str(), 0755);
+    }
+    tier_paths.push_back(rocksdb::DbPath(tier_path, path.target_size));
+  }
+  return tier_paths;
+}
+
+// The serving dataset never changes, its table files are mapped into
+// memory and all kept opened, a point lookup neither opens a file nor
+// reads a block by a system call
+static void ApplyServingOptions(rocksdb::DBOptions* db_ops) {
+  db_ops->allow_mmap_reads = true;
+  db_ops->max_open_files = -1;
+  db_ops->skip_stats_update_on_db_open = true;
+}
+
+Status Redis::OpenDB(const BlackwidowOptions& bw_options,
+                     const rocksdb::Options& options,
+                     const std::string& db_path) {
+  open_mode_ = bw_options.open_mode;
+  rocksdb::Options ops(options);
+  ops.cf_paths = TierPaths(bw_options, options.cf_paths, db_path);
+  if (open_mode_ == kOpenReadOnly) {
+    return rocksdb::DB::OpenForReadOnly(ops, db_path, &db_);
+  } else if (open_mode_ == kOpenServing) {
+    ApplyServingOptions(&ops);
+    return rocksdb::DB::OpenForReadOnly(ops, db_path, &db_);
+  } else if (open_mode_ == kOpenSecondary) {
+    rocksdb::Options secondary_ops(ops);
+    // secondary instance need to keep all the table files opened,
+    // otherwise the files deleted by primary can not be read
+    secondary_ops.max_open_files = -1;
+    return rocksdb::DB::OpenAsSecondary(secondary_ops, db_path,
+        SecondaryPath(bw_options, db_path), &db_);
+  }
+  ops.listeners.push_back(write_stall_listener_);
+  Status s = rocksdb::DB::Open(ops, db_path, &db_);
+  if (s.ok() && bw_options.storage_backend == kMemoryBackend) {
+    db_ = new MemoryDB(db_, {});
+  }
+  return s;
+}
+
+Status Redis::OpenDB(const BlackwidowOptions& bw_options,
+                     const rocksdb::DBOptions& db_ops,
+                     const std::string& db_path,
+                     const std::vector<rocksdb::ColumnFamilyDescriptor>& descriptors,
+                     std::vector<rocksdb::ColumnFamilyHandle*>* handles) {
+  open_mode_ = bw_options.open_mode;
+  cf_handles_ = handles;
+  std::vector<rocksdb::ColumnFamilyDescriptor> column_families(descriptors);
+  for (auto& column_family : column_families) {
+    column_family.options.cf_paths = TierPaths(bw_options,
+        column_family.options.cf_paths, db_path);
+  }
+  if (open_mode_ == kOpenReadOnly) {
+    return rocksdb::DB::OpenForReadOnly(db_ops, db_path,
+        column_families, handles, &db_);
+  } else if (open_mode_ == kOpenServing) {
+    rocksdb::DBOptions serving_db_ops(db_ops);
+    ApplyServingOptions(&serving_db_ops);
+    return rocksdb::DB::OpenForReadOnly(serving_db_ops, db_path,
+        column_families, handles, &db_);
+  } else if (open_mode_ == kOpenSecondary) {
+    rocksdb::DBOptions secondary_db_ops(db_ops);
+    secondary_db_ops.max_open_files = -1;
+    return rocksdb::DB::OpenAsSecondary(secondary_db_ops, db_path,
+        SecondaryPath(bw_options, db_path), column_families, handles, &db_);
+  }
+  rocksdb::DBOptions listened_db_ops(db_ops);
+  listened_db_ops.listeners.push_back(write_stall_listener_);
+  Status s = rocksdb::DB::Open(listened_db_ops, db_path,
+                               column_families, handles, &db_);
+  if (s.ok() && bw_options.storage_backend == kMemoryBackend) {
+    db_ = new MemoryDB(db_, *handles);
+  }
+  return s;
+}
+
+void Redis::ApplyColumnFamilyProfile(const ColumnFamilyProfile& profile,
+                                     rocksdb::ColumnFamilyOptions* cf_ops,
+                                     rocksdb::BlockBasedTableOptions* table_ops) {
+  if (profile.block_size > 0) {
+    table_ops->block_size = profile.block_size;
+  }
+  if (profile.filter_bits_per_key <= 0) {
+    table_ops->filter_policy.reset();
+  } else if (profile.use_ribbon_filter) {
+    table_ops->filter_policy.reset(
+        rocksdb::NewRibbonFilterPolicy(profile.filter_bits_per_key));
+  } else {
+    table_ops->filter_policy.reset(
+        rocksdb::NewBloomFilterPolicy(profile.filter_bits_per_key, false));
+  }
+  if (profile.data_block_hash_index) {
+    table_ops->data_block_index_type =
+      rocksdb::BlockBasedTableOptions::kDataBlockBinaryAndHash;
+  }
+  // index and filter blocks held in the default 8MB cache of table
+  // factory would be evicted all the time
+  if (profile.pin_l0_filter_and_index_blocks && table_ops->block_cache) {
+    table_ops->cache_index_and_filter_blocks = true;
+    table_ops->pin_l0_filter_and_index_blocks_in_cache = true;
+  }
+
+  cf_ops->optimize_filters_for_hits = profile.optimize_filters_for_hits;
+  cf_ops->cf_paths = profile.paths;
+  if (!profile.compression_per_level.empty()) {
+    cf_ops->compression_per_level = profile.compression_per_level;
+  }
+  if (profile.compression_dict_bytes > 0) {
+    cf_ops->compression = rocksdb::kZSTD;
+    for (auto& compression : cf_ops->compression_per_level) {
+      if (compression != rocksdb::kNoCompression) {
+        compression = rocksdb::kZSTD;
+      }
+    }
+    cf_ops->compression_opts.max_dict_bytes = profile.compression_dict_bytes;
+    cf_ops->compression_opts.zstd_max_train_bytes =
+      profile.compression_dict_train_bytes;
+  }
+  if (profile.memtable_bloom_size_ratio > 0) {
+    cf_ops->memtable_prefix_bloom_size_ratio = profile.memtable_bloom_size_ratio;
+    cf_ops->memtable_whole_key_filtering = true;
+  }
+}
+
+Status Redis::TryCatchUpWithPrimary() {
+  if (open_mode_ != kOpenSecondary) {
+    return Status::NotSupported("Not opened as secondary instance");
+  }
+  return db_->TryCatchUpWithPrimary();
+}
+
+Status Redis::GetUpdatesSince(uint64_t since_sequence, int64_t count,
+                              std::vector<ChangeRecord>* records,
+                              uint64_t* next_sequence) {
+  *next_sequence = since_sequence;
+  std::unique_ptr<rocksdb::TransactionLogIterator> iter;
+  Status s = db_->GetUpdatesSince(since_sequence, &iter);
+  if (!s.ok()) {
+    return s;
+  }
+
+  for (; iter->Valid()
+    && static_cast<int64_t>(records->size()) < count; iter->Next()) {
+    rocksdb::BatchResult batch = iter->GetBatch();
+    ChangeBatchHandler handler(type_, batch.sequence,
+                               since_sequence, records);
+    s = batch.writeBatchPtr->Iterate(&handler);
+    if (!s.ok()) {
+      return s;
+    }
+    *next_sequence = batch.sequence + batch.writeBatchPtr->Count();
+  }
+  return iter->status();
+}
+
+Status Redis::ScanBigKeys(const std::string& start_key, int64_t count,
+                          uint64_t threshold, std::vector<KeyCount>* big_keys,
+                          std::string* next_key) {
+  next_key->clear();
+  if (type_ == kStrings) {
+    return Status::OK();
+  }
+
+  rocksdb::ReadOptions iterator_options;
+  iterator_options.fill_cache = false;
+  rocksdb::Iterator* iter = db_->NewIterator(iterator_options);
+  for (iter->Seek(start_key);
+       iter->Valid() && count > 0;
+       iter->Next(), count--) {
+    uint64_t elements = 0;
+    if (type_ == kLists) {
+      ParsedListsMetaValue parsed_lists_meta_value(iter->value());
+      if (!parsed_lists_meta_value.IsStale()) {
+        elements = parsed_lists_meta_value.count();
+      }
+    } else if (type_ == kStreams) {
+      ParsedStreamsMetaValue parsed_streams_meta_value(iter->value());
+      if (!parsed_streams_meta_value.IsStale()) {
+        elements = parsed_streams_meta_value.count();
+      }
+    } else {
+      ParsedBaseMetaValue parsed_base_meta_value(iter->value());
+      if (!parsed_base_meta_value.IsStale()) {
+        elements = parsed_base_meta_value.count();
+      }
+    }
+    if (elements > threshold) {
+      big_keys->push_back({iter->key().ToString(), elements});
+    }
+  }
+  if (iter->Valid()) {
+    *next_key = iter->key().ToString();
+  }
+  Status s = iter->status();
+  delete iter;
+  return s;
+}
+
+Status Redis::SampleKeys(const std::string& start_key, int64_t count,
+                         std::vector<KeyCount>* keys,
+                         std::string* next_key) {
+  next_key->clear();
+  rocksdb::ReadOptions iterator_options;
+  iterator_options.fill_cache = false;
+
+  rocksdb::Iterator* iter = NewKeyIterator(iterator_options);
+  for (iter->Seek(start_key);
+       iter->Valid() && count > 0;
+       iter->Next()) {
+    if (!IsLiveKey(iter->value())) {
+      continue;
+    }
+    // The meta key and the data keys, a zset member has a score key too
+    uint64_t entries = 1;
+    if (type_ == kLists) {
+      ParsedListsMetaValue parsed_lists_meta_value(iter->value());
+      entries += parsed_lists_meta_value.count();
+    } else if (type_ == kStreams) {
+      ParsedStreamsMetaValue parsed_streams_meta_value(iter->value());
+      entries += parsed_streams_meta_value.count();
+    } else if (type_ != kStrings) {
+      ParsedBaseMetaValue parsed_base_meta_value(iter->value());
+      entries += parsed_base_meta_value.count()
+        * (type_ == kZSets ? 2 : 1);
+    }
+    keys->push_back({iter->key().ToString(), entries});
+    count--;
+  }
+  if (iter->Valid()) {
+    *next_key = iter->key().ToString();
+  }
+  Status s = iter->status();
+  delete iter;
+  return s;
+}
+
+Status Redis::GetStorageTierStats(std::vector<StorageTierStats>* tiers) {
+  std::vector<rocksdb::LiveFileMetaData> files;
+  db_->GetLiveFilesMetaData(&files);
+  for (const auto& file : files) {
+    auto iter = std::find_if(tiers->begin(), tiers->end(),
+        [&](const StorageTierStats& tier) {
+          return tier.path == file.db_path;
+        });
+    if (iter == tiers->end()) {
+      tiers->push_back({file.db_path, 0, 0, 0});
+      iter = tiers->end() - 1;
+    }
+    iter->files++;
+    iter->bytes += file.size;
+    iter->sampled_reads += file.num_reads_sampled;
+  }
+  return Status::OK();
+}
+
+void Redis::SplitMetaRanges(int32_t ranges,
+                            std::vector<std::string>* boundaries) {
+  std::vector<rocksdb::LiveFileMetaData> files;
+  db_->GetLiveFilesMetaData(&files);
+  std::vector<std::string> start_keys;
+  for (const auto& file : files) {
+    if (file.column_family_name == rocksdb::kDefaultColumnFamilyName) {
+      start_keys.push_back(file.smallestkey);
+    }
+  }
+  std::sort(start_keys.begin(), start_keys.end());
+  start_keys.erase(std::unique(start_keys.begin(), start_keys.end()),
+                   start_keys.end());
+  for (int32_t idx = 1; idx < ranges && !start_keys.empty(); ++idx) {
+    const std::string& start_key =
+      start_keys[start_keys.size() * idx / ranges];
+    if (!start_key.empty()
+      && (boundaries->empty() || boundaries->back() < start_key)) {
+      boundaries->push_back(start_key);
+    }
+  }
+}
+
+// Both column families of a zset keep the member with its encoded score,
+// the sums of the digests agree if the pairs do, whatever their order
+static uint64_t MemberScoreDigest(const Slice& member,
+                                  const Slice& encoded_score) {
+  std::string pair(member.data(), member.size());
+  pair.append(encoded_score.data(), sizeof(uint64_t));
+  return MurmurHash64A(pair.data(), static_cast<int>(pair.size()), 0);
+}
+
+Status Redis::ScanDataKeys(const rocksdb::ReadOptions& read_options,
+                           const Slice& owner, int32_t version,
+                           DataKeyStats* stats) {
+  stats->count = 0;
+  stats->min_index = std::numeric_limits<uint64_t>::max();
+  stats->max_index = 0;
+  stats->score_count = 0;
+  stats->data_digest = 0;
+  stats->score_digest = 0;
+
+  // The lists data keys end with the index, ordered by the comparator
+  std::string prefix = BaseDataKey(owner, version, Slice()).Encode().ToString();
+  std::string start_key = type_ == kLists
+    ? ListsDataKey(owner, version, 0).Encode().ToString() : prefix;
+  rocksdb::Iterator* iter = db_->NewIterator(read_options, (*cf_handles_)[1]);
+  for (iter->Seek(start_key);
+       iter->Valid() && iter->key().starts_with(prefix);
+       iter->Next()) {
+    stats->count++;
+    if (type_ == kLists) {
+      uint64_t index = DecodeFixed64(iter->key().data() + prefix.size());
+      stats->min_index = std::min(stats->min_index, index);
+      stats->max_index = std::max(stats->max_index, index);
+    } else if (type_ == kZSets && iter->value().size() >= sizeof(uint64_t)) {
+      ParsedBaseDataKey parsed_base_data_key(iter->key());
+      stats->data_digest += MemberScoreDigest(parsed_base_data_key.data(),
+                                              iter->value());
+    }
+  }
+  Status s = iter->status();
+  delete iter;
+  if (!s.ok() || type_ != kZSets) {
+    return s;
+  }
+
+  ZSetsScoreKey zsets_score_key(owner, version,
+      std::numeric_limits<double>::lowest(), Slice());
+  iter = db_->NewIterator(read_options, (*cf_handles_)[2]);
+  for (iter->Seek(zsets_score_key.Encode());
+       iter->Valid() && iter->key().starts_with(prefix);
+       iter->Next()) {
+    ParsedZSetsScoreKey parsed_zsets_score_key(iter->key());
+    Slice encoded_score(iter->key().data() + prefix.size(), sizeof(uint64_t));
+    stats->score_count++;
+    stats->score_digest += MemberScoreDigest(
+        parsed_zsets_score_key.member(), encoded_score);
+  }
+  s = iter->status();
+  delete iter;
+  return s;
+}
+
+Status Redis::CheckConsistency(const rocksdb::Snapshot* snapshot,
+                               const std::string& start_key,
+                               const std::string& end_key, bool repair,
+                               ConsistencyReport* report) {
+  if (type_ == kStrings || cf_handles_ == nullptr) {
+    return Status::OK();
+  }
+
+  Slice upper_bound(end_key);
+  rocksdb::ReadOptions read_options;
+  read_options.snapshot = snapshot;
+  read_options.fill_cache = false;
+  if (!end_key.empty()) {
+    read_options.iterate_upper_bound = &upper_bound;
+  }
+  rocksdb::ReadOptions data_read_options;
+  data_read_options.snapshot = snapshot;
+  data_read_options.fill_cache = false;
+
+  Status s;
+  DataKeyStats stats;
+  rocksdb::Iterator* iter = db_->NewIterator(read_options);
+  for (iter->Seek(start_key); iter->Valid() && s.ok(); iter->Next()) {
+    uint64_t meta_count;
+    bool consistent;
+    if (type_ == kLists) {
+      ParsedListsMetaValue parsed_lists_meta_value(iter->value());
+      if (parsed_lists_meta_value.IsStale()
+        || parsed_lists_meta_value.count() == 0) {
+        continue;
+      }
+      s = ScanDataKeys(data_read_options,
+                       parsed_lists_meta_value.data_owner(iter->key()),
+                       parsed_lists_meta_value.version(), &stats);
+      meta_count = parsed_lists_meta_value.count();
+      uint64_t left_index = parsed_lists_meta_value.left_index();
+      uint64_t right_index = parsed_lists_meta_value.right_index();
+      consistent = stats.count == meta_count
+        && right_index - left_index - 1 == meta_count
+        && stats.min_index == left_index + 1
+        && stats.max_index == right_index - 1;
+    } else if (type_ == kStreams) {
+      ParsedStreamsMetaValue parsed_streams_meta_value(iter->value());
+      if (parsed_streams_meta_value.IsStale()
+        || parsed_streams_meta_value.count() == 0) {
+        continue;
+      }
+      s = ScanDataKeys(data_read_options,
+                       parsed_streams_meta_value.data_owner(iter->key()),
+                       parsed_streams_meta_value.version(), &stats);
+      meta_count = parsed_streams_meta_value.count();
+      consistent = stats.count == meta_count;
+    } else {
+      ParsedBaseMetaValue parsed_base_meta_value(iter->value());
+      if (parsed_base_meta_value.IsStale()
+        || parsed_base_meta_value.count() == 0) {
+        continue;
+      }
+      s = ScanDataKeys(data_read_options,
+                       parsed_base_meta_value.data_owner(iter->key()),
+                       parsed_base_meta_value.version(), &stats);
+      meta_count = parsed_base_meta_value.count();
+      consistent = stats.count == meta_count;
+      if (type_ == kZSets) {
+        consistent = consistent && stats.score_count == meta_count
+          && stats.score_digest == stats.data_digest;
+      }
+    }
+    if (!s.ok()) {
+      break;
+    }
+    report->checked_keys++;
+    if (consistent) {
+      continue;
+    }
+
+    bool repaired = false;
+    if (repair) {
+      s = RepairMetaCount(iter->key(), &repaired);
+    }
+    report->inconsistent_keys++;
+    if (repaired) {
+      report->repaired_keys++;
+    }
+    report->samples.push_back({type_, iter->key().ToString(),
+                               meta_count, stats.count, repaired});
+  }
+  if (s.ok()) {
+    s = iter->status();
+  }
+  delete iter;
+  return s;
+}
+
+// Writes of the key wait for the lock, so its data keys read now
+// are exactly what the meta value has to count
+Status Redis::RepairMetaCount(const Slice& key, bool* repaired) {
+  *repaired = false;
+  ScopeRecordLock l(lock_mgr_, key);
+  std::string meta_value;
+  Status s = db_->Get(default_read_options_, key, &meta_value);
+  if (s.IsNotFound()) {
+    return Status::OK();
+  } else if (!s.ok()) {
+    return s;
+  }
+
+  DataKeyStats stats;
+  if (type_ == kLists) {
+    ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
+    if (parsed_lists_meta_value.IsStale()
+      || parsed_lists_meta_value.count() == 0) {
+      return Status::OK();
+    }
+    s = ScanDataKeys(default_read_options_,
+                     parsed_lists_meta_value.data_owner(key),
+                     parsed_lists_meta_value.version(), &stats);
+    // The elements must still be contiguous to be indexed again
+    if (!s.ok() || (stats.count != 0
+      && stats.max_index - stats.min_index + 1 != stats.count)) {
+      return s;
+    }
+    parsed_lists_meta_value.set_count(stats.count);
+    if (stats.count != 0) {
+      parsed_lists_meta_value.set_left_index(stats.min_index - 1);
+      parsed_lists_meta_value.set_right_index(stats.max_index + 1);
+    }
+  } else if (type_ == kStreams) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+    if (parsed_streams_meta_value.IsStale()
+      || parsed_streams_meta_value.count() == 0) {
+      return Status::OK();
+    }
+    s = ScanDataKeys(default_read_options_,
+                     parsed_streams_meta_value.data_owner(key),
+                     parsed_streams_meta_value.version(), &stats);
+    if (!s.ok()) {
+      return s;
+    }
+    parsed_streams_meta_value.set_count(stats.count);
+  } else {
+    ParsedBaseMetaValue parsed_base_meta_value(&meta_value);
+    if (parsed_base_meta_value.IsStale()
+      || parsed_base_meta_value.count() == 0) {
+      return Status::OK();
+    }
+    s = ScanDataKeys(default_read_options_,
+                     parsed_base_meta_value.data_owner(key),
+                     parsed_base_meta_value.version(), &stats);
+    if (!s.ok() || (type_ == kZSets && (stats.score_count != stats.count
+      || stats.score_digest != stats.data_digest))) {
+      return s;
+    }
+    parsed_base_meta_value.set_count(static_cast<int32_t>(stats.count));
+  }
+  s = db_->Put(default_write_options_, key, meta_value);
+  *repaired = s.ok();
+  return s;
+}
+
+Status Redis::GetWritePressure(WritePressureStats* stats) {
+  stats->pressure = write_stall_listener_->pressure();
+  stats->slowdown_ratio = 0;
+  stats->l0_files = 0;
+  stats->pending_compaction_bytes = 0;
+  stats->immutable_memtables = 0;
+  stats->stalls = write_stall_listener_->stalls();
+
+  std::vector<rocksdb::ColumnFamilyHandle*> cfs;
+  if (cf_handles_ != nullptr) {
+    cfs = *cf_handles_;
+  } else {
+    cfs.push_back(db_->DefaultColumnFamily());
+  }
+  for (auto cf : cfs) {
+    uint64_t l0_files = 0, pending_compaction_bytes = 0;
+    uint64_t immutable_memtables = 0;
+    db_->GetIntProperty(cf, "rocksdb.num-files-at-level0", &l0_files);
+    db_->GetIntProperty(cf, "rocksdb.estimate-pending-compaction-bytes",
+                        &pending_compaction_bytes);
+    db_->GetIntProperty(cf, "rocksdb.num-immutable-mem-table",
+                        &immutable_memtables);
+    stats->l0_files = std::max(stats->l0_files, l0_files);
+    stats->pending_compaction_bytes =
+      std::max(stats->pending_compaction_bytes, pending_compaction_bytes);
+    stats->immutable_memtables =
+      std::max(stats->immutable_memtables, immutable_memtables);
+
+    // The same triggers the write controller of rocksdb delays at,
+    // the mutable memtable counts as one of max_write_buffer_number
+    rocksdb::Options cf_ops = db_->GetOptions(cf);
+    std::vector<double> ratios;
+    if (cf_ops.level0_slowdown_writes_trigger > 0) {
+      ratios.push_back(static_cast<double>(l0_files)
+          / cf_ops.level0_slowdown_writes_trigger);
+    }
+    if (cf_ops.soft_pending_compaction_bytes_limit > 0) {
+      ratios.push_back(static_cast<double>(pending_compaction_bytes)
+          / cf_ops.soft_pending_compaction_bytes_limit);
+    }
+    if (cf_ops.max_write_buffer_number > 1) {
+      ratios.push_back(static_cast<double>(immutable_memtables + 1)
+          / cf_ops.max_write_buffer_number);
+    }
+    for (double ratio : ratios) {
+      stats->slowdown_ratio = std::max(stats->slowdown_ratio, ratio);
+    }
+  }
+  return Status::OK();
+}
+
+Status Redis::ScanRangeKeys(const std::string& range_start,
+                            const std::string& range_end,
+                            const std::string& start_key, int64_t count,
+                            std::vector<std::string>* keys,
+                            std::string* next_key) {
+  next_key->clear();
+  Slice upper_bound(range_end);
+  rocksdb::ReadOptions iterator_options;
+  const rocksdb::Snapshot* snapshot;
+  ScopeSnapshot ss(db_, &snapshot);
+  iterator_options.snapshot = snapshot;
+  iterator_options.fill_cache = false;
+  if (!range_end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
+
+  rocksdb::Iterator* iter = NewKeyIterator(iterator_options);
+  for (iter->Seek(start_key.empty() ? range_start : start_key);
+       iter->Valid() && count > 0;
+       iter->Next()) {
+    if (IsLiveKey(iter->value())) {
+      keys->push_back(iter->key().ToString());
+      count--;
+    }
+  }
+  if (iter->Valid()) {
+    *next_key = iter->key().ToString();
+  }
+  Status s = iter->status();
+  delete iter;
+  return s;
+}
+
+Status Redis::RangeKeyCount(const std::string& range_start,
+                            const std::string& range_end, int64_t* count) {
+  *count = 0;
+  Slice upper_bound(range_end);
+  rocksdb::ReadOptions iterator_options;
+  iterator_options.fill_cache = false;
+  if (!range_end.empty()) {
+    iterator_options.iterate_upper_bound = &upper_bound;
+  }
+
+  rocksdb::Iterator* iter = NewKeyIterator(iterator_options);
+  for (iter->Seek(range_start); iter->Valid(); iter->Next()) {
+    if (IsLiveKey(iter->value())) {
+      (*count)++;
+    }
+  }
+  Status s = iter->status();
+  delete iter;
+  return s;
+}
+
+// The data keys of the collections start with the key length, they are
+// dropped by the data filters once their meta keys are deleted here. Until
+// then the collections recreated in the range take versions above the
+// ones of the deleted metas, which version_floor_ is raised beyond
+Status Redis::DelKeyRange(const std::string& range_start,
+                          const std::string& range_end) {
+  if (type_ != kStrings) {
+    Slice upper_bound(range_end);
+    rocksdb::ReadOptions iterator_options;
+    iterator_options.fill_cache = false;
+    if (!range_end.empty()) {
+      iterator_options.iterate_upper_bound = &upper_bound;
+    }
+    int32_t max_version = 0;
+    rocksdb::Iterator* iter = NewKeyIterator(iterator_options);
+    for (iter->Seek(range_start); iter->Valid(); iter->Next()) {
+      max_version = std::max(max_version, MetaVersion(iter->value()));
+    }
+    Status s = iter->status();
+    delete iter;
+    if (!s.ok()) {
+      return s;
+    }
+    int32_t floor = version_floor_.load(std::memory_order_relaxed);
+    int32_t new_floor = VersionAfter(max_version, 0);
+    while (floor < new_floor
+      && !version_floor_.compare_exchange_weak(floor, new_floor,
+                                               std::memory_order_release)) {
+    }
+  }
+  return db_->DeleteRange(default_write_options_, db_->DefaultColumnFamily(),
+                          range_start, range_end);
+}
+
+rocksdb::Iterator* Redis::NewKeyIterator(
+    const rocksdb::ReadOptions& read_options) {
+  return db_->NewIterator(read_options);
+}
+
+bool Redis::IsLiveKey(const Slice& value) const {
+  if (type_ == kStrings) {
+    ParsedStringsValue parsed_strings_value(value);
+    return !parsed_strings_value.IsStale();
+  } else if (type_ == kLists) {
+    ParsedListsMetaValue parsed_lists_meta_value(value);
+    return !parsed_lists_meta_value.IsStale()
+      && parsed_lists_meta_value.count() != 0;
+  } else if (type_ == kStreams) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(value);
+    return !parsed_streams_meta_value.IsStale()
+      && parsed_streams_meta_value.count() != 0;
+  } else {
+    ParsedBaseMetaValue parsed_base_meta_value(value);
+    return !parsed_base_meta_value.IsStale()
+      && parsed_base_meta_value.count() != 0;
+  }
+}
+
+int32_t Redis::MetaVersion(const Slice& value) const {
+  if (type_ == kStrings) {
+    return 0;
+  } else if (type_ == kLists) {
+    ParsedListsMetaValue parsed_lists_meta_value(value);
+    return std::max(parsed_lists_meta_value.version(),
+                    parsed_lists_meta_value.last_own_version());
+  } else if (type_ == kStreams) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(value);
+    return std::max(parsed_streams_meta_value.version(),
+                    parsed_streams_meta_value.last_own_version());
+  } else {
+    ParsedBaseMetaValue parsed_base_meta_value(value);
+    return std::max(parsed_base_meta_value.version(),
+                    parsed_base_meta_value.last_own_version());
+  }
+}
+
 Status Redis::GetScanStartPoint(const Slice& key,
                                 const Slice& pattern,
                                 int64_t cursor,
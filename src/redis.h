@@ -7,6 +7,7 @@
 #define SRC_REDIS_H_
 
 #include <string>
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -23,6 +24,10 @@ namespace blackwidow {
 using Status = rocksdb::Status;
 using Slice = rocksdb::Slice;
 
+class DumpWriter;
+class DumpReader;
+class WriteStallListener;
+
 class Redis {
  public:
   Redis(BlackWidow* const bw, const DataType& type);
@@ -56,18 +61,85 @@ class Redis {
                           int32_t timestamp) = 0;
   virtual Status Persist(const Slice& key) = 0;
   virtual Status TTL(const Slice& key, int64_t* timestamp) = 0;
+  // Both overwrite newkey of the same data type, the caller checks
+  // newkey in the other data types. With nx, or without replace, they
+  // return Busy when newkey exists in the same data type, checked under
+  // the record locks of both keys
+  virtual Status Rename(const Slice& key, const Slice& newkey, bool nx) = 0;
+  virtual Status Copy(const Slice& key, const Slice& newkey,
+                      bool replace) = 0;
+  // Serialize the value of key through writer, Restore replaces the
+  // value of key by the elements of reader, see src/dump_format.h.
+  // Without replace, Restore returns Busy when key exists in the same
+  // data type, checked under the record lock of key
+  virtual Status Dump(const Slice& key, DumpWriter* writer) = 0;
+  virtual Status Restore(const Slice& key, DumpReader* reader,
+                         int32_t ttl, bool replace) = 0;
 
   Status SetMaxCacheStatisticKeys(size_t max_cache_statistic_keys);
   Status SetSmallCompactionThreshold(size_t small_compaction_threshold);
 
+  Status TryCatchUpWithPrimary();
+  Status GetUpdatesSince(uint64_t since_sequence, int64_t count,
+                         std::vector<ChangeRecord>* records,
+                         uint64_t* next_sequence);
+  // Scan at most count meta keys from start_key, collect the collections
+  // with more than threshold elements, next_key is empty when the scan
+  // reaches the end of the db
+  Status ScanBigKeys(const std::string& start_key, int64_t count,
+                     uint64_t threshold, std::vector<KeyCount>* big_keys,
+                     std::string* next_key);
+  // Scan at most count live keys from start_key for the evictor, with
+  // the number of entries each of them keeps in the db, next_key is
+  // empty when the scan reaches the end of the db
+  Status SampleKeys(const std::string& start_key, int64_t count,
+                    std::vector<KeyCount>* keys, std::string* next_key);
+  // The live sst files by the path they are kept in, added to tiers
+  Status GetStorageTierStats(std::vector<StorageTierStats>* tiers);
+  // Split the meta column family into up to ranges key ranges with about
+  // the same number of table files, boundaries are the start keys of all
+  // the ranges but the first one
+  void SplitMetaRanges(int32_t ranges, std::vector<std::string>* boundaries);
+  // Check the collections whose meta keys are in [start_key, end_key) of
+  // snapshot, see BlackWidow::CheckConsistency, an empty end_key goes to
+  // the last key. Inconsistent keys are added to report->samples
+  Status CheckConsistency(const rocksdb::Snapshot* snapshot,
+                          const std::string& start_key,
+                          const std::string& end_key, bool repair,
+                          ConsistencyReport* report);
+  // The stall condition and the column family closest to a stall,
+  // never kWritePressureHigh, the caller judges slowdown_ratio
+  Status GetWritePressure(WritePressureStats* stats);
+  bool IsReadOnly() const {
+    return open_mode_ != kOpenReadWrite;
+  }
+
+  // The keys of a slot or a database, between the tags range_start and
+  // range_end, see BlackwidowOptions::slot_tagged_keys and databases.
+  // start_key and the returned keys carry the tag, an empty start_key
+  // starts from range_start, an empty range_end goes to the last key
+  Status ScanRangeKeys(const std::string& range_start,
+                       const std::string& range_end,
+                       const std::string& start_key, int64_t count,
+                       std::vector<std::string>* keys, std::string* next_key);
+  Status RangeKeyCount(const std::string& range_start,
+                       const std::string& range_end, int64_t* count);
+  virtual Status DelKeyRange(const std::string& range_start,
+                             const std::string& range_end);
+
  protected:
   BlackWidow* const bw_;
   DataType type_;
   LockMgr* lock_mgr_;
   rocksdb::DB* db_;
+  OpenMode open_mode_;
   rocksdb::WriteOptions default_write_options_;
   rocksdb::ReadOptions default_read_options_;
   rocksdb::CompactRangeOptions default_compact_range_options_;
+  std::shared_ptr<WriteStallListener> write_stall_listener_;
+  // Not owned, the column family handles of the subclass, nullptr
+  // when db_ only has the default column family
+  std::vector<rocksdb::ColumnFamilyHandle*>* cf_handles_;
 
   // For Scan
   LRUCache<std::string, std::string>* scan_cursors_store_;
@@ -81,6 +153,59 @@ class Redis {
   std::atomic<size_t> small_compaction_threshold_;
   LRUCache<std::string, size_t>* statistics_store_;
 
+  // What the data column families keep for one version of a collection
+  struct DataKeyStats {
+    uint64_t count;
+    // The element indexes of a list
+    uint64_t min_index;
+    uint64_t max_index;
+    // The score_cf entries of a zset, and the digests of the member and
+    // score pairs in data_cf and in score_cf
+    uint64_t score_count;
+    uint64_t data_digest;
+    uint64_t score_digest;
+  };
+  Status ScanDataKeys(const rocksdb::ReadOptions& read_options,
+                      const Slice& owner, int32_t version,
+                      DataKeyStats* stats);
+  Status RepairMetaCount(const Slice& key, bool* repaired);
+
+  // Open db_ according to bw_options.open_mode, the secondary instance
+  // of db_path lives in the same sub directory under secondary_path
+  Status OpenDB(const BlackwidowOptions& bw_options,
+                const rocksdb::Options& options,
+                const std::string& db_path);
+  Status OpenDB(const BlackwidowOptions& bw_options,
+                const rocksdb::DBOptions& db_ops,
+                const std::string& db_path,
+                const std::vector<rocksdb::ColumnFamilyDescriptor>& descriptors,
+                std::vector<rocksdb::ColumnFamilyHandle*>* handles);
+
+  // Apply the profile to the options of one column family, before
+  // its table factory is created from table_ops
+  static void ApplyColumnFamilyProfile(const ColumnFamilyProfile& profile,
+                                       rocksdb::ColumnFamilyOptions* cf_ops,
+                                       rocksdb::BlockBasedTableOptions* table_ops);
+
+  // Iterate the column families which hold the keys, that is the meta
+  // column family of the collections
+  virtual rocksdb::Iterator* NewKeyIterator(
+      const rocksdb::ReadOptions& read_options);
+  // Whether a value of the iterator above belongs to a live key
+  bool IsLiveKey(const Slice& value) const;
+  // The highest version the data keys of a meta value of the iterator
+  // above may carry, 0 for the strings
+  int32_t MetaVersion(const Slice& value) const;
+
+  // The lowest version a new version of a collection may take. The data
+  // keys of the collections deleted by DelKeyRange stay until the data
+  // filters drop them, so a key recreated in the same second must not
+  // take a version they carry
+  int32_t version_floor() const {
+    return version_floor_.load(std::memory_order_acquire);
+  }
+  std::atomic<int32_t> version_floor_;
+
   Status UpdateSpecificKeyStatistics(const std::string& key, size_t count);
   Status AddCompactKeyTaskIfNeeded(const std::string& key, size_t total);
 };
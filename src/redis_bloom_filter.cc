@@ -0,0 +1,108 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "src/redis_bloom_filter.h"
+#include "src/coding.h"
+#include "src/murmurhash.h"
+
+namespace blackwidow {
+
+const uint32_t BLOOM_CHUNK_SEED = 0x9747b28c;
+const uint32_t BLOOM_HASH_SEED = 0x5bd1e995;
+const uint32_t BLOOM_DELTA_SEED = 0x1b873593;
+const size_t kBloomParamsLength = sizeof(uint64_t) * 2 + sizeof(uint32_t) * 3;
+
+const std::string BloomFilter::kParamsField = "";
+
+BloomFilter::BloomFilter(uint64_t capacity, double error_rate)
+    : valid_(false), capacity_(capacity), error_rate_(error_rate),
+      hash_num_(0), chunk_num_(0), chunk_bits_(0) {
+  if (capacity == 0 || !(error_rate > 0 && error_rate < 1)) {
+    return;
+  }
+  double ln2 = std::log(2.0);
+  double total_bits = std::ceil(-static_cast<double>(capacity)
+      * std::log(error_rate) / (ln2 * ln2));
+  // A small filter has one chunk of whole 64 bit words
+  if (total_bits <= kBloomChunkBits) {
+    chunk_bits_ = static_cast<uint32_t>(std::ceil(total_bits / 64)) * 64;
+    chunk_num_ = 1;
+  } else if (total_bits / kBloomChunkBits
+      < std::numeric_limits<uint32_t>::max()) {
+    chunk_bits_ = kBloomChunkBits;
+    chunk_num_ = static_cast<uint32_t>(std::ceil(total_bits / kBloomChunkBits));
+  } else {
+    return;
+  }
+  hash_num_ = static_cast<uint32_t>(std::ceil(-std::log(error_rate) / ln2));
+  valid_ = true;
+}
+
+BloomFilter::BloomFilter(const Slice& params)
+    : valid_(false), capacity_(0), error_rate_(0),
+      hash_num_(0), chunk_num_(0), chunk_bits_(0) {
+  if (params.size() != kBloomParamsLength) {
+    return;
+  }
+  const char* ptr = params.data();
+  capacity_ = DecodeFixed64(ptr);
+  ptr += sizeof(uint64_t);
+  uint64_t error_rate_bits = DecodeFixed64(ptr);
+  memcpy(&error_rate_, &error_rate_bits, sizeof(error_rate_));
+  ptr += sizeof(uint64_t);
+  hash_num_ = DecodeFixed32(ptr);
+  ptr += sizeof(uint32_t);
+  chunk_num_ = DecodeFixed32(ptr);
+  ptr += sizeof(uint32_t);
+  chunk_bits_ = DecodeFixed32(ptr);
+  valid_ = hash_num_ > 0 && chunk_num_ > 0
+    && chunk_bits_ > 0 && chunk_bits_ % 8 == 0;
+}
+
+std::string BloomFilter::Encode() const {
+  char buf[kBloomParamsLength];
+  char* dst = buf;
+  EncodeFixed64(dst, capacity_);
+  dst += sizeof(uint64_t);
+  uint64_t error_rate_bits;
+  memcpy(&error_rate_bits, &error_rate_, sizeof(error_rate_bits));
+  EncodeFixed64(dst, error_rate_bits);
+  dst += sizeof(uint64_t);
+  EncodeFixed32(dst, hash_num_);
+  dst += sizeof(uint32_t);
+  EncodeFixed32(dst, chunk_num_);
+  dst += sizeof(uint32_t);
+  EncodeFixed32(dst, chunk_bits_);
+  return std::string(buf, sizeof(buf));
+}
+
+// One hash picks the chunk, the bits in it are double hashed
+uint32_t BloomFilter::Locate(const Slice& member,
+                             std::vector<uint32_t>* bits) const {
+  int len = static_cast<int>(member.size());
+  uint64_t chunk = MurmurHash(member.data(), len, BLOOM_CHUNK_SEED);
+  uint64_t hash = MurmurHash(member.data(), len, BLOOM_HASH_SEED);
+  uint64_t delta = MurmurHash(member.data(), len, BLOOM_DELTA_SEED) | 1;
+  bits->clear();
+  for (uint32_t idx = 0; idx < hash_num_; ++idx) {
+    bits->push_back(static_cast<uint32_t>(hash % chunk_bits_));
+    hash += delta;
+  }
+  return static_cast<uint32_t>(chunk % chunk_num_);
+}
+
+std::string BloomFilter::ChunkField(uint32_t chunk) {
+  char buf[sizeof(uint32_t)];
+  for (size_t idx = 0; idx < sizeof(uint32_t); ++idx) {
+    buf[idx] = static_cast<char>(chunk >> (24 - idx * 8));
+  }
+  return std::string(buf, sizeof(buf));
+}
+
+}  // namespace blackwidow
@@ -0,0 +1,61 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_REDIS_BLOOM_FILTER_H_
+#define SRC_REDIS_BLOOM_FILTER_H_
+
+#include <string>
+#include <vector>
+
+#include "rocksdb/slice.h"
+
+namespace blackwidow {
+
+using Slice = rocksdb::Slice;
+
+// The most bits of one chunk of the bit array
+const uint32_t kBloomChunkBits = 8 * 4096;
+
+/*
+ * A Bloom filter is a hash, the field with the empty name holds the
+ * parameters:
+ *
+ * | capacity | error_rate | hash_num | chunk_num | chunk_bits |
+ *      8B          8B          4B          4B          4B
+ *
+ * and every other field is one chunk of the bit array, named by its
+ * big-endian index. All the bits of a member are in one chunk, so adding
+ * or checking a member reads the parameters and that chunk only
+ */
+class BloomFilter {
+ public:
+  BloomFilter(uint64_t capacity, double error_rate);
+  // Decode the parameters, valid() is false if they are malformed
+  explicit BloomFilter(const Slice& params);
+
+  bool valid() const { return valid_; }
+  uint32_t chunk_num() const { return chunk_num_; }
+  uint32_t chunk_bytes() const { return chunk_bits_ / 8; }
+
+  std::string Encode() const;
+
+  // The chunk of member, and the offsets of its bits in the chunk
+  uint32_t Locate(const Slice& member, std::vector<uint32_t>* bits) const;
+
+  static const std::string kParamsField;
+  static std::string ChunkField(uint32_t chunk);
+
+ private:
+  bool valid_;
+  uint64_t capacity_;
+  double error_rate_;
+  uint32_t hash_num_;
+  uint32_t chunk_num_;
+  uint32_t chunk_bits_;
+};
+
+}  // namespace blackwidow
+
+#endif  // SRC_REDIS_BLOOM_FILTER_H_
@@ -5,15 +5,21 @@
 
 #include "src/redis_hashes.h"
 
+#include <map>
 #include <memory>
 
 #include "blackwidow/util.h"
 #include "src/base_filter.h"
 #include "src/scope_record_lock.h"
 #include "src/scope_snapshot.h"
+#include "src/dump_format.h"
 
 namespace blackwidow {
 
+// The hash commands on a Bloom filter
+static const char kWrongType[] =
+  "WRONGTYPE Operation against a key holding the wrong kind of value";
+
 RedisHashes::RedisHashes(BlackWidow* const bw, const DataType& type)
     : Redis(bw, type) {
 }
@@ -32,8 +38,13 @@ Status RedisHashes::Open(const BlackwidowOptions& bw_options,
   small_compaction_threshold_ = bw_options.small_compaction_threshold;
 
   rocksdb::Options ops(bw_options.options);
-  Status s = rocksdb::DB::Open(ops, db_path, &db_);
-  if (s.ok()) {
+  Status s;
+  // read-only and secondary instance can not create column family,
+  // it must have been created by the primary instance
+  if (bw_options.open_mode == kOpenReadWrite) {
+    s = rocksdb::DB::Open(ops, db_path, &db_);
+  }
+  if (bw_options.open_mode == kOpenReadWrite && s.ok()) {
     // create column family
     rocksdb::ColumnFamilyHandle* cf;
     s = db_->CreateColumnFamily(rocksdb::ColumnFamilyOptions(),
@@ -48,6 +59,8 @@ Status RedisHashes::Open(const BlackwidowOptions& bw_options,
 
   // Open
   rocksdb::DBOptions db_ops(bw_options.options);
+  // origin_cf is missing in the db created before rename was supported
+  db_ops.create_missing_column_families = true;
   rocksdb::ColumnFamilyOptions meta_cf_ops(bw_options.options);
   rocksdb::ColumnFamilyOptions data_cf_ops(bw_options.options);
   meta_cf_ops.compaction_filter_factory =
@@ -55,9 +68,7 @@ Status RedisHashes::Open(const BlackwidowOptions& bw_options,
   data_cf_ops.compaction_filter_factory =
     std::make_shared<HashesDataFilterFactory>(&db_, &handles_);
 
-  // use the bloom filter policy to reduce disk reads
   rocksdb::BlockBasedTableOptions table_ops(bw_options.table_options);
-  table_ops.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10, true));
   rocksdb::BlockBasedTableOptions meta_cf_table_ops(table_ops);
   rocksdb::BlockBasedTableOptions data_cf_table_ops(table_ops);
   if (!bw_options.share_block_cache && bw_options.block_cache_size > 0) {
@@ -66,11 +77,23 @@ Status RedisHashes::Open(const BlackwidowOptions& bw_options,
     data_cf_table_ops.block_cache =
       rocksdb::NewLRUCache(bw_options.block_cache_size);
   }
+  // tune every column family for its access pattern
+  ApplyColumnFamilyProfile(bw_options.meta_profile,
+      &meta_cf_ops, &meta_cf_table_ops);
+  ApplyColumnFamilyProfile(bw_options.hashes_data_profile,
+      &data_cf_ops, &data_cf_table_ops);
   meta_cf_ops.table_factory.reset(
       rocksdb::NewBlockBasedTableFactory(meta_cf_table_ops));
   data_cf_ops.table_factory.reset(
       rocksdb::NewBlockBasedTableFactory(data_cf_table_ops));
 
+  // the entries of origin_cf are few and read along with the meta
+  rocksdb::ColumnFamilyOptions origin_cf_ops(bw_options.options);
+  origin_cf_ops.compaction_filter_factory =
+    std::make_shared<HashesOriginFilterFactory>(&db_, &handles_);
+  origin_cf_ops.table_factory = meta_cf_ops.table_factory;
+  origin_cf_ops.cf_paths = meta_cf_ops.cf_paths;
+
   std::vector<rocksdb::ColumnFamilyDescriptor> column_families;
   // Meta CF
   column_families.push_back(rocksdb::ColumnFamilyDescriptor(
@@ -78,7 +101,10 @@ Status RedisHashes::Open(const BlackwidowOptions& bw_options,
   // Data CF
   column_families.push_back(rocksdb::ColumnFamilyDescriptor(
       "data_cf", data_cf_ops));
-  return rocksdb::DB::Open(db_ops, db_path, column_families, &handles_, &db_);
+  // Origin CF
+  column_families.push_back(rocksdb::ColumnFamilyDescriptor(
+      "origin_cf", origin_cf_ops));
+  return OpenDB(bw_options, db_ops, db_path, column_families, &handles_);
 }
 
 Status RedisHashes::CompactRange(const rocksdb::Slice* begin,
@@ -90,6 +116,11 @@ Status RedisHashes::CompactRange(const rocksdb::Slice* begin,
   if (type == kData || type == kMetaAndData) {
     db_->CompactRange(default_compact_range_options_, handles_[1], begin, end);
   }
+  // origin_cf is compacted along with the whole db
+  if (type == kMetaAndData) {
+    db_->CompactRange(default_compact_range_options_,
+        handles_[2], nullptr, nullptr);
+  }
   return Status::OK();
 }
 
@@ -191,7 +222,7 @@ Status RedisHashes::PKPatternMatchDel(const std::string& pattern,
     if (!parsed_hashes_meta_value.IsStale()
       && parsed_hashes_meta_value.count()
       && StringMatch(pattern.data(), pattern.size(), key.data(), key.size(), 0)) {
-      parsed_hashes_meta_value.InitialMetaValue();
+      parsed_hashes_meta_value.InitialMetaValue(version_floor());
       batch.Put(handles_[0], key, meta_value);
     }
     if (static_cast<size_t>(batch.Count()) >= BATCH_DELETE_LIMIT) {
@@ -249,11 +280,14 @@ Status RedisHashes::HDel(const Slice& key,
       || parsed_hashes_meta_value.count() == 0) {
       *ret = 0;
       return Status::OK();
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       std::string data_value;
       version = parsed_hashes_meta_value.version();
+      Slice data_owner = parsed_hashes_meta_value.data_owner(key);
       for (const auto& field : filtered_fields) {
-        HashesDataKey hashes_data_key(key, version, field);
+        HashesDataKey hashes_data_key(data_owner, version, field);
         s = db_->Get(read_options, handles_[1],
                 hashes_data_key.Encode(), &data_value);
         if (s.ok()) {
@@ -301,9 +335,12 @@ Status RedisHashes::HGet(const Slice& key, const Slice& field,
       return Status::NotFound("Stale");
     } else if (parsed_hashes_meta_value.count() == 0) {
       return Status::NotFound();
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       version = parsed_hashes_meta_value.version();
-      HashesDataKey data_key(key, version, field);
+      Slice data_owner = parsed_hashes_meta_value.data_owner(key);
+      HashesDataKey data_key(data_owner, version, field);
       s = db_->Get(read_options, handles_[1], data_key.Encode(), value);
     }
   }
@@ -326,9 +363,12 @@ Status RedisHashes::HGetall(const Slice& key,
       return Status::NotFound("Stale");
     } else if (parsed_hashes_meta_value.count() == 0) {
       return Status::NotFound();
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       version = parsed_hashes_meta_value.version();
-      HashesDataKey hashes_data_key(key, version, "");
+      Slice data_owner = parsed_hashes_meta_value.data_owner(key);
+      HashesDataKey hashes_data_key(data_owner, version, "");
       Slice prefix = hashes_data_key.Encode();
       auto iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(prefix);
@@ -360,8 +400,9 @@ Status RedisHashes::HIncrby(const Slice& key, const Slice& field, int64_t value,
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
     if (parsed_hashes_meta_value.IsStale()
       || parsed_hashes_meta_value.count() == 0) {
-      version = parsed_hashes_meta_value.UpdateVersion();
+      version = parsed_hashes_meta_value.UpdateVersion(version_floor());
       parsed_hashes_meta_value.set_count(1);
+      parsed_hashes_meta_value.set_bloom(false);
       parsed_hashes_meta_value.set_timestamp(0);
       batch.Put(handles_[0], key, meta_value);
       HashesDataKey hashes_data_key(key, version, field);
@@ -369,9 +410,12 @@ Status RedisHashes::HIncrby(const Slice& key, const Slice& field, int64_t value,
       Int64ToStr(buf, 32, value);
       batch.Put(handles_[1], hashes_data_key.Encode(), buf);
       *ret = value;
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       version = parsed_hashes_meta_value.version();
-      HashesDataKey hashes_data_key(key, version, field);
+      Slice data_owner = parsed_hashes_meta_value.data_owner(key);
+      HashesDataKey hashes_data_key(data_owner, version, field);
       s = db_->Get(default_read_options_, handles_[1],
               hashes_data_key.Encode(), &old_value);
       if (s.ok()) {
@@ -403,7 +447,7 @@ Status RedisHashes::HIncrby(const Slice& key, const Slice& field, int64_t value,
     char str[4];
     EncodeFixed32(str, 1);
     HashesMetaValue hashes_meta_value(std::string(str, sizeof(int32_t)));
-    version = hashes_meta_value.UpdateVersion();
+    version = hashes_meta_value.UpdateVersion(version_floor());
     batch.Put(handles_[0], key, hashes_meta_value.Encode());
     HashesDataKey hashes_data_key(key, version, field);
 
@@ -440,17 +484,21 @@ Status RedisHashes::HIncrbyfloat(const Slice& key, const Slice& field,
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
     if (parsed_hashes_meta_value.IsStale()
       || parsed_hashes_meta_value.count() == 0) {
-      version = parsed_hashes_meta_value.UpdateVersion();
+      version = parsed_hashes_meta_value.UpdateVersion(version_floor());
       parsed_hashes_meta_value.set_count(1);
+      parsed_hashes_meta_value.set_bloom(false);
       parsed_hashes_meta_value.set_timestamp(0);
       batch.Put(handles_[0], key, meta_value);
       HashesDataKey hashes_data_key(key, version, field);
 
       LongDoubleToStr(long_double_by, new_value);
       batch.Put(handles_[1], hashes_data_key.Encode(), *new_value);
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       version = parsed_hashes_meta_value.version();
-      HashesDataKey hashes_data_key(key, version, field);
+      Slice data_owner = parsed_hashes_meta_value.data_owner(key);
+      HashesDataKey hashes_data_key(data_owner, version, field);
       s = db_->Get(default_read_options_, handles_[1],
               hashes_data_key.Encode(), &old_value_str);
       if (s.ok()) {
@@ -480,7 +528,7 @@ Status RedisHashes::HIncrbyfloat(const Slice& key, const Slice& field,
     char str[4];
     EncodeFixed32(str, 1);
     HashesMetaValue hashes_meta_value(std::string(str, sizeof(int32_t)));
-    version = hashes_meta_value.UpdateVersion();
+    version = hashes_meta_value.UpdateVersion(version_floor());
     batch.Put(handles_[0], key, hashes_meta_value.Encode());
 
     HashesDataKey hashes_data_key(key, version, field);
@@ -510,9 +558,12 @@ Status RedisHashes::HKeys(const Slice& key,
       return Status::NotFound("Stale");
     } else if (parsed_hashes_meta_value.count() == 0) {
       return Status::NotFound();
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       version = parsed_hashes_meta_value.version();
-      HashesDataKey hashes_data_key(key, version, "");
+      Slice data_owner = parsed_hashes_meta_value.data_owner(key);
+      HashesDataKey hashes_data_key(data_owner, version, "");
       Slice prefix = hashes_data_key.Encode();
       auto iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(prefix);
@@ -538,6 +589,8 @@ Status RedisHashes::HLen(const Slice& key, int32_t* ret) {
       return Status::NotFound("Stale");
     } else if (parsed_hashes_meta_value.count() == 0) {
       return Status::NotFound();
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       *ret = parsed_hashes_meta_value.count();
     }
@@ -569,10 +622,13 @@ Status RedisHashes::HMGet(const Slice& key,
         vss->push_back({std::string(), Status::NotFound()});
       }
       return Status::NotFound(is_stale ? "Stale" : "");
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       version = parsed_hashes_meta_value.version();
+      Slice data_owner = parsed_hashes_meta_value.data_owner(key);
       for (const auto& field : fields) {
-        HashesDataKey hashes_data_key(key, version, field);
+        HashesDataKey hashes_data_key(data_owner, version, field);
         s = db_->Get(read_options, handles_[1],
                 hashes_data_key.Encode(), &value);
         if (s.ok()) {
@@ -617,19 +673,22 @@ Status RedisHashes::HMSet(const Slice& key,
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
     if (parsed_hashes_meta_value.IsStale()
       || parsed_hashes_meta_value.count() == 0) {
-      version = parsed_hashes_meta_value.InitialMetaValue();
+      version = parsed_hashes_meta_value.InitialMetaValue(version_floor());
       parsed_hashes_meta_value.set_count(filtered_fvs.size());
       batch.Put(handles_[0], key, meta_value);
       for (const auto& fv : filtered_fvs) {
         HashesDataKey hashes_data_key(key, version, fv.field);
         batch.Put(handles_[1], hashes_data_key.Encode(), fv.value);
       }
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       int32_t count = 0;
       std::string data_value;
       version = parsed_hashes_meta_value.version();
+      Slice data_owner = parsed_hashes_meta_value.data_owner(key);
       for (const auto& fv : filtered_fvs) {
-        HashesDataKey hashes_data_key(key, version, fv.field);
+        HashesDataKey hashes_data_key(data_owner, version, fv.field);
         s = db_->Get(default_read_options_, handles_[1],
                 hashes_data_key.Encode(), &data_value);
         if (s.ok()) {
@@ -649,7 +708,7 @@ Status RedisHashes::HMSet(const Slice& key,
     char str[4];
     EncodeFixed32(str, filtered_fvs.size());
     HashesMetaValue hashes_meta_value(std::string(str, sizeof(int32_t)));
-    version = hashes_meta_value.UpdateVersion();
+    version = hashes_meta_value.UpdateVersion(version_floor());
     batch.Put(handles_[0], key, hashes_meta_value.Encode());
     for (const auto& fv : filtered_fvs) {
       HashesDataKey hashes_data_key(key, version, fv.field);
@@ -674,16 +733,19 @@ Status RedisHashes::HSet(const Slice& key, const Slice& field,
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
     if (parsed_hashes_meta_value.IsStale()
       || parsed_hashes_meta_value.count() == 0) {
-      version = parsed_hashes_meta_value.InitialMetaValue();
+      version = parsed_hashes_meta_value.InitialMetaValue(version_floor());
       parsed_hashes_meta_value.set_count(1);
       batch.Put(handles_[0], key, meta_value);
       HashesDataKey data_key(key, version, field);
       batch.Put(handles_[1], data_key.Encode(), value);
       *res = 1;
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       version = parsed_hashes_meta_value.version();
+      Slice data_owner = parsed_hashes_meta_value.data_owner(key);
       std::string data_value;
-      HashesDataKey hashes_data_key(key, version, field);
+      HashesDataKey hashes_data_key(data_owner, version, field);
       s = db_->Get(default_read_options_,
           handles_[1], hashes_data_key.Encode(), &data_value);
       if (s.ok()) {
@@ -707,7 +769,7 @@ Status RedisHashes::HSet(const Slice& key, const Slice& field,
     char str[4];
     EncodeFixed32(str, 1);
     HashesMetaValue meta_value(std::string(str, sizeof(int32_t)));
-    version = meta_value.UpdateVersion();
+    version = meta_value.UpdateVersion(version_floor());
     batch.Put(handles_[0], key, meta_value.Encode());
     HashesDataKey data_key(key, version, field);
     batch.Put(handles_[1], data_key.Encode(), value);
@@ -732,15 +794,18 @@ Status RedisHashes::HSetnx(const Slice& key, const Slice& field,
     ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
     if (parsed_hashes_meta_value.IsStale()
       || parsed_hashes_meta_value.count() == 0) {
-      version = parsed_hashes_meta_value.InitialMetaValue();
+      version = parsed_hashes_meta_value.InitialMetaValue(version_floor());
       parsed_hashes_meta_value.set_count(1);
       batch.Put(handles_[0], key, meta_value);
       HashesDataKey hashes_data_key(key, version, field);
       batch.Put(handles_[1], hashes_data_key.Encode(), value);
       *ret = 1;
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       version = parsed_hashes_meta_value.version();
-      HashesDataKey hashes_data_key(key, version, field);
+      Slice data_owner = parsed_hashes_meta_value.data_owner(key);
+      HashesDataKey hashes_data_key(data_owner, version, field);
       std::string data_value;
       s = db_->Get(default_read_options_, handles_[1],
               hashes_data_key.Encode(), &data_value);
@@ -759,7 +824,7 @@ Status RedisHashes::HSetnx(const Slice& key, const Slice& field,
     char str[4];
     EncodeFixed32(str, 1);
     HashesMetaValue hashes_meta_value(std::string(str, sizeof(int32_t)));
-    version = hashes_meta_value.UpdateVersion();
+    version = hashes_meta_value.UpdateVersion(version_floor());
     batch.Put(handles_[0], key, hashes_meta_value.Encode());
     HashesDataKey hashes_data_key(key, version, field);
     batch.Put(handles_[1], hashes_data_key.Encode(), value);
@@ -786,9 +851,12 @@ Status RedisHashes::HVals(const Slice& key,
       return Status::NotFound("Stale");
     } else if (parsed_hashes_meta_value.count() == 0) {
       return Status::NotFound();
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       version = parsed_hashes_meta_value.version();
-      HashesDataKey hashes_data_key(key, version, "");
+      Slice data_owner = parsed_hashes_meta_value.data_owner(key);
+      HashesDataKey hashes_data_key(data_owner, version, "");
       Slice prefix = hashes_data_key.Encode();
       auto iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(prefix);
@@ -842,10 +910,13 @@ Status RedisHashes::HScan(const Slice& key,
       || parsed_hashes_meta_value.count() == 0) {
       *next_cursor = 0;
       return Status::NotFound();
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       std::string sub_field;
       std::string start_point;
       int32_t version = parsed_hashes_meta_value.version();
+      Slice data_owner = parsed_hashes_meta_value.data_owner(key);
       s = GetScanStartPoint(key, pattern, cursor, &start_point);
       if (s.IsNotFound()) {
         cursor = 0;
@@ -857,8 +928,8 @@ Status RedisHashes::HScan(const Slice& key,
         sub_field = pattern.substr(0, pattern.size() - 1);
       }
 
-      HashesDataKey hashes_data_prefix(key, version, sub_field);
-      HashesDataKey hashes_start_data_key(key, version, start_point);
+      HashesDataKey hashes_data_prefix(data_owner, version, sub_field);
+      HashesDataKey hashes_start_data_key(data_owner, version, start_point);
       std::string prefix = hashes_data_prefix.Encode().ToString();
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(hashes_start_data_key.Encode());
@@ -913,10 +984,13 @@ Status RedisHashes::HScanx(const Slice& key,
       || parsed_hashes_meta_value.count() == 0) {
       *next_field = "";
       return Status::NotFound();
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       int32_t version = parsed_hashes_meta_value.version();
-      HashesDataKey hashes_data_prefix(key, version, Slice());
-      HashesDataKey hashes_start_data_key(key, version, start_field);
+      Slice data_owner = parsed_hashes_meta_value.data_owner(key);
+      HashesDataKey hashes_data_prefix(data_owner, version, Slice());
+      HashesDataKey hashes_start_data_key(data_owner, version, start_field);
       std::string prefix = hashes_data_prefix.Encode().ToString();
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(hashes_start_data_key.Encode());
@@ -978,10 +1052,13 @@ Status RedisHashes::PKHScanRange(const Slice& key,
     if (parsed_hashes_meta_value.IsStale()
       || parsed_hashes_meta_value.count() == 0) {
       return Status::NotFound();
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       int32_t version = parsed_hashes_meta_value.version();
-      HashesDataKey hashes_data_prefix(key, version, Slice());
-      HashesDataKey hashes_start_data_key(key, version, field_start);
+      Slice data_owner = parsed_hashes_meta_value.data_owner(key);
+      HashesDataKey hashes_data_prefix(data_owner, version, Slice());
+      HashesDataKey hashes_start_data_key(data_owner, version, field_start);
       std::string prefix = hashes_data_prefix.Encode().ToString();
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(start_no_limit ? prefix : hashes_start_data_key.Encode());
@@ -1046,14 +1123,17 @@ Status RedisHashes::PKHRScanRange(const Slice& key,
     if (parsed_hashes_meta_value.IsStale()
       || parsed_hashes_meta_value.count() == 0) {
       return Status::NotFound();
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::InvalidArgument(kWrongType);
     } else {
       int32_t version = parsed_hashes_meta_value.version();
+      Slice data_owner = parsed_hashes_meta_value.data_owner(key);
       int32_t start_key_version = start_no_limit ? version + 1 : version;
       std::string start_key_field = start_no_limit ?
         "" : field_start.ToString();
-      HashesDataKey hashes_data_prefix(key, version, Slice());
+      HashesDataKey hashes_data_prefix(data_owner, version, Slice());
       HashesDataKey hashes_start_data_key(
-          key, start_key_version, start_key_field);
+          data_owner, start_key_version, start_key_field);
       std::string prefix = hashes_data_prefix.Encode().ToString();
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->SeekForPrev(hashes_start_data_key.Encode().ToString());
@@ -1214,6 +1294,235 @@ Status RedisHashes::PKRScanRange(const Slice& key_start,
   return Status::OK();
 }
 
+Status RedisHashes::BfReserve(const Slice& key, const BloomFilter& filter) {
+  rocksdb::WriteBatch batch;
+  ScopeRecordLock l(lock_mgr_, key);
+
+  int32_t version = 0;
+  std::string meta_value;
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
+    if (!parsed_hashes_meta_value.IsStale()
+      && parsed_hashes_meta_value.count() != 0) {
+      return Status::Busy("item exists");
+    }
+    version = parsed_hashes_meta_value.InitialMetaValue(version_floor());
+  } else if (s.IsNotFound()) {
+    char str[4];
+    EncodeFixed32(str, 0);
+    HashesMetaValue hashes_meta_value(std::string(str, sizeof(int32_t)));
+    version = hashes_meta_value.UpdateVersion(version_floor());
+    meta_value = hashes_meta_value.Encode().ToString();
+  } else {
+    return s;
+  }
+  ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
+  parsed_hashes_meta_value.set_count(1);
+  parsed_hashes_meta_value.set_bloom(true);
+  batch.Put(handles_[0], key, meta_value);
+  HashesDataKey params_data_key(key, version, BloomFilter::kParamsField);
+  batch.Put(handles_[1], params_data_key.Encode(), filter.Encode());
+  return db_->Write(default_write_options_, &batch);
+}
+
+Status RedisHashes::BfAdd(const Slice& key,
+                          const std::vector<std::string>& members,
+                          const BloomFilter& default_filter,
+                          std::vector<int32_t>* rets) {
+  rets->assign(members.size(), 0);
+  rocksdb::WriteBatch batch;
+  ScopeRecordLock l(lock_mgr_, key);
+
+  int32_t version = 0;
+  bool is_new = false;
+  uint32_t statistic = 0;
+  std::string params;
+  std::string meta_value;
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.IsNotFound()) {
+    char str[4];
+    EncodeFixed32(str, 0);
+    HashesMetaValue hashes_meta_value(std::string(str, sizeof(int32_t)));
+    hashes_meta_value.UpdateVersion(version_floor());
+    meta_value = hashes_meta_value.Encode().ToString();
+  } else if (!s.ok()) {
+    return s;
+  }
+  ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
+  if (parsed_hashes_meta_value.IsStale()
+    || parsed_hashes_meta_value.count() == 0) {
+    // A missing filter is created with the default parameters
+    version = parsed_hashes_meta_value.InitialMetaValue(version_floor());
+    parsed_hashes_meta_value.set_count(1);
+    parsed_hashes_meta_value.set_bloom(true);
+    params = default_filter.Encode();
+    HashesDataKey params_data_key(key, version, BloomFilter::kParamsField);
+    batch.Put(handles_[1], params_data_key.Encode(), params);
+    is_new = true;
+  } else if (!parsed_hashes_meta_value.bloom()) {
+    return Status::InvalidArgument("Not a bloom filter");
+  } else {
+    version = parsed_hashes_meta_value.version();
+    HashesDataKey params_data_key(parsed_hashes_meta_value.data_owner(key),
+        version, BloomFilter::kParamsField);
+    s = db_->Get(default_read_options_,
+        handles_[1], params_data_key.Encode(), &params);
+    if (s.IsNotFound()) {
+      return Status::InvalidArgument("Not a bloom filter");
+    } else if (!s.ok()) {
+      return s;
+    }
+  }
+  BloomFilter filter(params);
+  if (!filter.valid()) {
+    return Status::InvalidArgument("Not a bloom filter");
+  }
+
+  // Every chunk is read and written once for all its members
+  std::vector<std::vector<uint32_t>> member_bits(members.size());
+  std::map<uint32_t, std::vector<size_t>> chunk_members;
+  for (size_t idx = 0; idx < members.size(); ++idx) {
+    chunk_members[filter.Locate(members[idx], &member_bits[idx])].push_back(idx);
+  }
+  int32_t new_chunks = 0;
+  std::string chunk_value;
+  Slice data_owner = parsed_hashes_meta_value.data_owner(key);
+  for (const auto& chunk_member : chunk_members) {
+    bool chunk_exists = false;
+    HashesDataKey chunk_data_key(data_owner, version,
+        BloomFilter::ChunkField(chunk_member.first));
+    if (!is_new) {
+      s = db_->Get(default_read_options_,
+          handles_[1], chunk_data_key.Encode(), &chunk_value);
+      if (s.ok()) {
+        chunk_exists = true;
+      } else if (!s.IsNotFound()) {
+        return s;
+      }
+    }
+    if (!chunk_exists) {
+      chunk_value.assign(filter.chunk_bytes(), '\0');
+    } else if (chunk_value.size() != filter.chunk_bytes()) {
+      return Status::Corruption("Malformed bloom filter chunk");
+    }
+
+    bool updated = false;
+    for (const auto& idx : chunk_member.second) {
+      for (const auto& bit : member_bits[idx]) {
+        char mask = static_cast<char>(1 << (bit % 8));
+        if (!(chunk_value[bit / 8] & mask)) {
+          chunk_value[bit / 8] |= mask;
+          (*rets)[idx] = 1;
+          updated = true;
+        }
+      }
+    }
+    if (updated) {
+      batch.Put(handles_[1], chunk_data_key.Encode(), chunk_value);
+      if (chunk_exists) {
+        statistic++;
+      } else {
+        new_chunks++;
+      }
+    }
+  }
+  if (is_new || new_chunks > 0) {
+    parsed_hashes_meta_value.ModifyCount(new_chunks);
+    batch.Put(handles_[0], key, meta_value);
+  }
+  if (batch.Count() == 0) {
+    return Status::OK();
+  }
+  s = db_->Write(default_write_options_, &batch);
+  UpdateSpecificKeyStatistics(key.ToString(), statistic);
+  return s;
+}
+
+Status RedisHashes::BfExists(const Slice& key,
+                             const std::vector<std::string>& members,
+                             std::vector<int32_t>* rets) {
+  rets->assign(members.size(), 0);
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot;
+
+  std::string params;
+  std::string meta_value;
+  ScopeSnapshot ss(db_, &snapshot);
+  read_options.snapshot = snapshot;
+  Status s = db_->Get(read_options, handles_[0], key, &meta_value);
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
+  if (parsed_hashes_meta_value.IsStale()) {
+    return Status::NotFound("Stale");
+  } else if (parsed_hashes_meta_value.count() == 0) {
+    return Status::NotFound();
+  } else if (!parsed_hashes_meta_value.bloom()) {
+    return Status::InvalidArgument("Not a bloom filter");
+  }
+  int32_t version = parsed_hashes_meta_value.version();
+  Slice data_owner = parsed_hashes_meta_value.data_owner(key);
+  HashesDataKey params_data_key(data_owner, version,
+      BloomFilter::kParamsField);
+  s = db_->Get(read_options, handles_[1], params_data_key.Encode(), &params);
+  if (s.IsNotFound()) {
+    return Status::InvalidArgument("Not a bloom filter");
+  } else if (!s.ok()) {
+    return s;
+  }
+  BloomFilter filter(params);
+  if (!filter.valid()) {
+    return Status::InvalidArgument("Not a bloom filter");
+  }
+
+  std::vector<std::vector<uint32_t>> member_bits(members.size());
+  std::map<uint32_t, std::vector<size_t>> chunk_members;
+  for (size_t idx = 0; idx < members.size(); ++idx) {
+    chunk_members[filter.Locate(members[idx], &member_bits[idx])].push_back(idx);
+  }
+  std::string chunk_value;
+  for (const auto& chunk_member : chunk_members) {
+    HashesDataKey chunk_data_key(data_owner, version,
+        BloomFilter::ChunkField(chunk_member.first));
+    s = db_->Get(read_options,
+        handles_[1], chunk_data_key.Encode(), &chunk_value);
+    if (s.IsNotFound()) {
+      continue;
+    } else if (!s.ok()) {
+      return s;
+    } else if (chunk_value.size() != filter.chunk_bytes()) {
+      return Status::Corruption("Malformed bloom filter chunk");
+    }
+    for (const auto& idx : chunk_member.second) {
+      (*rets)[idx] = 1;
+      for (const auto& bit : member_bits[idx]) {
+        if (!(chunk_value[bit / 8] & (1 << (bit % 8)))) {
+          (*rets)[idx] = 0;
+          break;
+        }
+      }
+    }
+  }
+  return Status::OK();
+}
+
+Status RedisHashes::IsBloomFilter(const Slice& key, bool* is_bloom) {
+  *is_bloom = false;
+  std::string meta_value;
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
+    if (parsed_hashes_meta_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (parsed_hashes_meta_value.count() == 0) {
+      return Status::NotFound();
+    }
+    *is_bloom = parsed_hashes_meta_value.bloom();
+  }
+  return s;
+}
 
 Status RedisHashes::Expire(const Slice& key, int32_t ttl) {
   std::string meta_value;
@@ -1231,7 +1540,7 @@ Status RedisHashes::Expire(const Slice& key, int32_t ttl) {
       parsed_hashes_meta_value.SetRelativeTimestamp(ttl);
       s = db_->Put(default_write_options_, handles_[0], key, meta_value);
     } else {
-      parsed_hashes_meta_value.InitialMetaValue();
+      parsed_hashes_meta_value.InitialMetaValue(version_floor());
       s = db_->Put(default_write_options_, handles_[0], key, meta_value);
     }
   }
@@ -1250,7 +1559,7 @@ Status RedisHashes::Del(const Slice& key) {
       return Status::NotFound();
     } else {
       uint32_t statistic = parsed_hashes_meta_value.count();
-      parsed_hashes_meta_value.InitialMetaValue();
+      parsed_hashes_meta_value.InitialMetaValue(version_floor());
       s = db_->Put(default_write_options_, handles_[0], key, meta_value);
       UpdateSpecificKeyStatistics(key.ToString(), statistic);
     }
@@ -1318,7 +1627,7 @@ Status RedisHashes::Expireat(const Slice& key, int32_t timestamp) {
       if (timestamp > 0) {
         parsed_hashes_meta_value.set_timestamp(timestamp);
       } else {
-        parsed_hashes_meta_value.InitialMetaValue();
+        parsed_hashes_meta_value.InitialMetaValue(version_floor());
       }
       s = db_->Put(default_write_options_, handles_[0], key, meta_value);
     }
@@ -1376,6 +1685,233 @@ Status RedisHashes::TTL(const Slice& key, int64_t* timestamp) {
   return s;
 }
 
+Status RedisHashes::Rename(const Slice& key, const Slice& newkey, bool nx) {
+  std::string meta_value;
+  MultiScopeRecordLock ml(lock_mgr_, {key.ToString(), newkey.ToString()});
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
+  if (parsed_hashes_meta_value.IsStale()) {
+    return Status::NotFound("Stale");
+  } else if (parsed_hashes_meta_value.count() == 0) {
+    return Status::NotFound();
+  } else if (key == newkey) {
+    return nx ? Status::Busy("newkey exists") : Status::OK();
+  }
+
+  // newkey reads the data keys of the origin from now on, without
+  // moving them, the versions it used before are never used again
+  int32_t last_own_version = 0;
+  std::string new_meta_value;
+  s = db_->Get(default_read_options_, handles_[0], newkey, &new_meta_value);
+  if (s.ok()) {
+    ParsedHashesMetaValue parsed_new_meta_value(&new_meta_value);
+    if (nx && !parsed_new_meta_value.IsStale()
+      && parsed_new_meta_value.count() != 0) {
+      return Status::Busy("newkey exists");
+    }
+    last_own_version = parsed_new_meta_value.last_own_version();
+  } else if (!s.IsNotFound()) {
+    return s;
+  }
+  int32_t version = parsed_hashes_meta_value.version();
+  std::string origin = parsed_hashes_meta_value.data_owner(key).ToString();
+  new_meta_value = meta_value;
+  ParsedHashesMetaValue parsed_new_meta_value(&new_meta_value);
+  parsed_new_meta_value.SetOrigin(origin, last_own_version);
+
+  rocksdb::WriteBatch batch;
+  batch.Put(handles_[0], newkey, new_meta_value);
+  OriginRefKey origin_ref_key(origin, version, newkey);
+  batch.Put(handles_.back(), origin_ref_key.Encode(), Slice());
+  // key is initialized instead of deleted, so that its new version never
+  // collides with the version read by newkey
+  parsed_hashes_meta_value.InitialMetaValue(version_floor());
+  batch.Put(handles_[0], key, meta_value);
+  return db_->Write(default_write_options_, &batch);
+}
+
+Status RedisHashes::Copy(const Slice& key, const Slice& newkey,
+                         bool replace) {
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot;
+
+  std::string meta_value;
+  MultiScopeRecordLock ml(lock_mgr_, {key.ToString(), newkey.ToString()});
+  ScopeSnapshot ss(db_, &snapshot);
+  read_options.snapshot = snapshot;
+  Status s = db_->Get(read_options, handles_[0], key, &meta_value);
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
+  if (parsed_hashes_meta_value.IsStale()) {
+    return Status::NotFound("Stale");
+  } else if (parsed_hashes_meta_value.count() == 0) {
+    return Status::NotFound();
+  } else if (key == newkey) {
+    return Status::OK();
+  }
+
+  uint32_t statistic = 0;
+  int32_t new_version = 0;
+  std::string new_meta_value;
+  s = db_->Get(read_options, handles_[0], newkey, &new_meta_value);
+  if (s.ok()) {
+    ParsedHashesMetaValue parsed_new_meta_value(&new_meta_value);
+    if (!replace && !parsed_new_meta_value.IsStale()
+      && parsed_new_meta_value.count() != 0) {
+      return Status::Busy("newkey exists");
+    }
+    if (!parsed_new_meta_value.IsStale()) {
+      statistic = parsed_new_meta_value.count();
+    }
+    new_version = parsed_new_meta_value.InitialMetaValue(version_floor());
+  } else if (s.IsNotFound()) {
+    char str[4];
+    EncodeFixed32(str, 0);
+    HashesMetaValue hashes_meta_value(Slice(str, sizeof(int32_t)));
+    new_version = hashes_meta_value.UpdateVersion(version_floor());
+    new_meta_value = hashes_meta_value.Encode().ToString();
+  } else {
+    return s;
+  }
+  // The empty meta of the new version goes first, the elements written
+  // by the batches before the last one are invisible until the last
+  // batch counts them in the meta, as Restore does
+  rocksdb::WriteBatch batch;
+  batch.Put(handles_[0], newkey, new_meta_value);
+  int32_t version = parsed_hashes_meta_value.version();
+  Slice data_owner = parsed_hashes_meta_value.data_owner(key);
+  HashesDataKey hashes_data_key(data_owner, version, Slice());
+  Slice prefix = hashes_data_key.Encode();
+  auto iter = db_->NewIterator(read_options, handles_[1]);
+  for (iter->Seek(prefix);
+       iter->Valid() && iter->key().starts_with(prefix);
+       iter->Next()) {
+    ParsedHashesDataKey parsed_hashes_data_key(iter->key());
+    HashesDataKey new_hashes_data_key(newkey, new_version,
+        parsed_hashes_data_key.field());
+    batch.Put(handles_[1], new_hashes_data_key.Encode(), iter->value());
+    if (batch.GetDataSize() >= kRestoreBatchBytes) {
+      s = db_->Write(default_write_options_, &batch);
+      if (!s.ok()) {
+        delete iter;
+        return s;
+      }
+      batch.Clear();
+    }
+  }
+  s = iter->status();
+  delete iter;
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedHashesMetaValue parsed_new_meta_value(&new_meta_value);
+  parsed_new_meta_value.set_count(parsed_hashes_meta_value.count());
+  parsed_new_meta_value.set_bloom(parsed_hashes_meta_value.bloom());
+  parsed_new_meta_value.set_timestamp(parsed_hashes_meta_value.timestamp());
+  batch.Put(handles_[0], newkey, new_meta_value);
+  s = db_->Write(default_write_options_, &batch);
+  UpdateSpecificKeyStatistics(newkey.ToString(), statistic);
+  return s;
+}
+
+Status RedisHashes::Dump(const Slice& key, DumpWriter* writer) {
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot;
+
+  std::string meta_value;
+  ScopeSnapshot ss(db_, &snapshot);
+  read_options.snapshot = snapshot;
+  read_options.fill_cache = false;
+  Status s = db_->Get(read_options, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
+    if (parsed_hashes_meta_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (parsed_hashes_meta_value.count() == 0) {
+      return Status::NotFound();
+    } else if (parsed_hashes_meta_value.bloom()) {
+      return Status::NotSupported("Dump of a bloom filter");
+    }
+    writer->Begin(kHashes);
+    int32_t version = parsed_hashes_meta_value.version();
+    Slice data_owner = parsed_hashes_meta_value.data_owner(key);
+    HashesDataKey hashes_data_key(data_owner, version, Slice());
+    Slice prefix = hashes_data_key.Encode();
+    auto iter = db_->NewIterator(read_options, handles_[1]);
+    bool within_limit = true;
+    for (iter->Seek(prefix);
+         within_limit && iter->Valid() && iter->key().starts_with(prefix);
+         iter->Next()) {
+      ParsedHashesDataKey parsed_hashes_data_key(iter->key());
+      within_limit = writer->Add(parsed_hashes_data_key.field())
+        && writer->Add(iter->value());
+    }
+    s = iter->status();
+    delete iter;
+  }
+  return s;
+}
+
+Status RedisHashes::Restore(const Slice& key, DumpReader* reader,
+                            int32_t ttl, bool replace) {
+  int32_t version = 0;
+  std::string meta_value;
+  ScopeRecordLock l(lock_mgr_, key);
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
+    if (!replace && !parsed_hashes_meta_value.IsStale()
+      && parsed_hashes_meta_value.count() != 0) {
+      return Status::Busy("Target key name already exists");
+    }
+    version = parsed_hashes_meta_value.InitialMetaValue(version_floor());
+  } else if (s.IsNotFound()) {
+    char str[4];
+    EncodeFixed32(str, 0);
+    HashesMetaValue hashes_meta_value(Slice(str, sizeof(int32_t)));
+    version = hashes_meta_value.UpdateVersion(version_floor());
+    meta_value = hashes_meta_value.Encode().ToString();
+  } else {
+    return s;
+  }
+
+  // The empty meta of the new version goes first, the elements written
+  // by the batches before the last one are invisible until the last
+  // batch counts them in the meta
+  rocksdb::WriteBatch batch;
+  batch.Put(handles_[0], key, meta_value);
+  ParsedHashesMetaValue parsed_hashes_meta_value(&meta_value);
+  Slice field, value;
+  while (reader->Next(&field)) {
+    if (!reader->Next(&value)) {
+      return Status::Corruption("Malformed hashes dump");
+    }
+    HashesDataKey hashes_data_key(key, version, field);
+    batch.Put(handles_[1], hashes_data_key.Encode(), value);
+    parsed_hashes_meta_value.ModifyCount(1);
+    if (batch.GetDataSize() >= kRestoreBatchBytes) {
+      s = db_->Write(default_write_options_, &batch);
+      if (!s.ok()) {
+        return s;
+      }
+      batch.Clear();
+    }
+  }
+  if (!reader->Done()) {
+    return Status::Corruption("Malformed hashes dump");
+  }
+  if (ttl > 0) {
+    parsed_hashes_meta_value.SetRelativeTimestamp(ttl);
+  }
+  batch.Put(handles_[0], key, meta_value);
+  return db_->Write(default_write_options_, &batch);
+}
+
 void RedisHashes::ScanDatabase() {
   rocksdb::ReadOptions iterator_options;
   const rocksdb::Snapshot* snapshot;
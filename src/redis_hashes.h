@@ -11,6 +11,7 @@
 #include <unordered_set>
 
 #include "src/redis.h"
+#include "src/redis_bloom_filter.h"
 
 namespace blackwidow {
 
@@ -81,6 +82,15 @@ class RedisHashes : public Redis {
                       const Slice& pattern, int32_t limit,
                       std::vector<std::string>* keys, std::string* next_key);
 
+  // Bloom filter Commands
+  Status BfReserve(const Slice& key, const BloomFilter& filter);
+  Status BfAdd(const Slice& key, const std::vector<std::string>& members,
+               const BloomFilter& default_filter, std::vector<int32_t>* rets);
+  Status BfExists(const Slice& key, const std::vector<std::string>& members,
+                  std::vector<int32_t>* rets);
+  // Whether key holds a Bloom filter rather than a hash, NotFound when
+  // it holds neither
+  Status IsBloomFilter(const Slice& key, bool* is_bloom);
 
   // Keys Commands
   Status Expire(const Slice& key, int32_t ttl) override;
@@ -91,11 +101,17 @@ class RedisHashes : public Redis {
   Status Expireat(const Slice& key, int32_t timestamp) override;
   Status Persist(const Slice& key) override;
   Status TTL(const Slice& key, int64_t* timestamp) override;
+  Status Rename(const Slice& key, const Slice& newkey, bool nx) override;
+  Status Copy(const Slice& key, const Slice& newkey, bool replace) override;
+  Status Dump(const Slice& key, DumpWriter* writer) override;
+  Status Restore(const Slice& key, DumpReader* reader,
+                 int32_t ttl, bool replace) override;
 
   // Iterate all data
   void ScanDatabase();
 
  private:
+  // handles_[2] is the origin_cf, it is always the last one
   std::vector<rocksdb::ColumnFamilyHandle*> handles_;
 };
 
@@ -11,9 +11,13 @@
 #include "src/lists_filter.h"
 #include "src/scope_record_lock.h"
 #include "src/scope_snapshot.h"
+#include "src/dump_format.h"
 
 namespace blackwidow {
 
+// Evicting more elements from a capped list uses a range deletion
+static const uint64_t kCappedListRangeDeleteNum = 32;
+
 const rocksdb::Comparator* ListsDataKeyComparator() {
   static ListsDataKeyComparatorImpl ldkc;
   return &ldkc;
@@ -37,8 +41,13 @@ Status RedisLists::Open(const BlackwidowOptions& bw_options,
   small_compaction_threshold_ = bw_options.small_compaction_threshold;
 
   rocksdb::Options ops(bw_options.options);
-  Status s = rocksdb::DB::Open(ops, db_path, &db_);
-  if (s.ok()) {
+  Status s;
+  // read-only and secondary instance can not create column family,
+  // it must have been created by the primary instance
+  if (bw_options.open_mode == kOpenReadWrite) {
+    s = rocksdb::DB::Open(ops, db_path, &db_);
+  }
+  if (bw_options.open_mode == kOpenReadWrite && s.ok()) {
     // Create column family
     rocksdb::ColumnFamilyHandle* cf;
     rocksdb::ColumnFamilyOptions cfo;
@@ -54,6 +63,8 @@ Status RedisLists::Open(const BlackwidowOptions& bw_options,
 
   // Open
   rocksdb::DBOptions db_ops(bw_options.options);
+  // origin_cf is missing in the db created before rename was supported
+  db_ops.create_missing_column_families = true;
   rocksdb::ColumnFamilyOptions meta_cf_ops(bw_options.options);
   rocksdb::ColumnFamilyOptions data_cf_ops(bw_options.options);
   meta_cf_ops.compaction_filter_factory =
@@ -62,9 +73,7 @@ Status RedisLists::Open(const BlackwidowOptions& bw_options,
     std::make_shared<ListsDataFilterFactory>(&db_, &handles_);
   data_cf_ops.comparator = ListsDataKeyComparator();
 
-  // use the bloom filter policy to reduce disk reads
   rocksdb::BlockBasedTableOptions table_ops(bw_options.table_options);
-  table_ops.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10, true));
   rocksdb::BlockBasedTableOptions meta_cf_table_ops(table_ops);
   rocksdb::BlockBasedTableOptions data_cf_table_ops(table_ops);
   if (!bw_options.share_block_cache && bw_options.block_cache_size > 0) {
@@ -73,11 +82,23 @@ Status RedisLists::Open(const BlackwidowOptions& bw_options,
     data_cf_table_ops.block_cache =
       rocksdb::NewLRUCache(bw_options.block_cache_size);
   }
+  // tune every column family for its access pattern
+  ApplyColumnFamilyProfile(bw_options.meta_profile,
+      &meta_cf_ops, &meta_cf_table_ops);
+  ApplyColumnFamilyProfile(bw_options.lists_data_profile,
+      &data_cf_ops, &data_cf_table_ops);
   meta_cf_ops.table_factory.reset(
       rocksdb::NewBlockBasedTableFactory(meta_cf_table_ops));
   data_cf_ops.table_factory.reset(
       rocksdb::NewBlockBasedTableFactory(data_cf_table_ops));
 
+  // the entries of origin_cf are few and read along with the meta
+  rocksdb::ColumnFamilyOptions origin_cf_ops(bw_options.options);
+  origin_cf_ops.compaction_filter_factory =
+    std::make_shared<ListsOriginFilterFactory>(&db_, &handles_);
+  origin_cf_ops.table_factory = meta_cf_ops.table_factory;
+  origin_cf_ops.cf_paths = meta_cf_ops.cf_paths;
+
   std::vector<rocksdb::ColumnFamilyDescriptor> column_families;
   // Meta CF
   column_families.push_back(rocksdb::ColumnFamilyDescriptor(
@@ -85,7 +106,10 @@ Status RedisLists::Open(const BlackwidowOptions& bw_options,
   // Data CF
   column_families.push_back(rocksdb::ColumnFamilyDescriptor(
       "data_cf", data_cf_ops));
-  return rocksdb::DB::Open(db_ops, db_path, column_families, &handles_, &db_);
+  // Origin CF
+  column_families.push_back(rocksdb::ColumnFamilyDescriptor(
+      "origin_cf", origin_cf_ops));
+  return OpenDB(bw_options, db_ops, db_path, column_families, &handles_);
 }
 
 Status RedisLists::CompactRange(const rocksdb::Slice* begin,
@@ -97,6 +121,11 @@ Status RedisLists::CompactRange(const rocksdb::Slice* begin,
   if (type == kData || type == kMetaAndData) {
     db_->CompactRange(default_compact_range_options_, handles_[1], begin, end);
   }
+  // origin_cf is compacted along with the whole db
+  if (type == kMetaAndData) {
+    db_->CompactRange(default_compact_range_options_,
+        handles_[2], nullptr, nullptr);
+  }
   return Status::OK();
 }
 
@@ -198,7 +227,7 @@ Status RedisLists::PKPatternMatchDel(const std::string& pattern,
     if (!parsed_lists_meta_value.IsStale()
       && parsed_lists_meta_value.count()
       && StringMatch(pattern.data(), pattern.size(), key.data(), key.size(), 0)) {
-      parsed_lists_meta_value.InitialMetaValue();
+      parsed_lists_meta_value.InitialMetaValue(version_floor());
       batch.Put(handles_[0], key, meta_value);
     }
     if (static_cast<size_t>(batch.Count()) >= BATCH_DELETE_LIMIT) {
@@ -238,6 +267,7 @@ Status RedisLists::LIndex(const Slice& key,
   if (s.ok()) {
     ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
     int32_t version = parsed_lists_meta_value.version();
+    Slice data_owner = parsed_lists_meta_value.data_owner(key);
     if (parsed_lists_meta_value.IsStale()) {
       return Status::NotFound("Stale");
     } else if (parsed_lists_meta_value.count() == 0) {
@@ -249,7 +279,7 @@ Status RedisLists::LIndex(const Slice& key,
             parsed_lists_meta_value.right_index() + index;
       if (parsed_lists_meta_value.left_index() < target_index
         && target_index < parsed_lists_meta_value.right_index()) {
-        ListsDataKey lists_data_key(key, version, target_index);
+        ListsDataKey lists_data_key(data_owner, version, target_index);
         s = db_->Get(read_options,
             handles_[1], lists_data_key.Encode(), &tmp_element);
         if (s.ok()) {
@@ -283,10 +313,11 @@ Status RedisLists::LInsert(const Slice& key,
       bool find_pivot = false;
       uint64_t pivot_index = 0;
       uint32_t version = parsed_lists_meta_value.version();
+      Slice data_owner = parsed_lists_meta_value.data_owner(key);
       uint64_t current_index = parsed_lists_meta_value.left_index() + 1;
       rocksdb::Iterator* iter =
         db_->NewIterator(default_read_options_, handles_[1]);
-      ListsDataKey start_data_key(key, version, current_index);
+      ListsDataKey start_data_key(data_owner, version, current_index);
       for (iter->Seek(start_data_key.Encode());
            iter->Valid()
             && current_index < parsed_lists_meta_value.right_index();
@@ -313,7 +344,7 @@ Status RedisLists::LInsert(const Slice& key,
           current_index = parsed_lists_meta_value.left_index() + 1;
           rocksdb::Iterator* first_half_iter =
             db_->NewIterator(default_read_options_, handles_[1]);
-          ListsDataKey start_data_key(key, version, current_index);
+          ListsDataKey start_data_key(data_owner, version, current_index);
           for (first_half_iter->Seek(start_data_key.Encode());
                first_half_iter->Valid() && current_index <= pivot_index;
                first_half_iter->Next(), current_index++) {
@@ -329,7 +360,7 @@ Status RedisLists::LInsert(const Slice& key,
 
           current_index = parsed_lists_meta_value.left_index();
           for (const auto& node : list_nodes) {
-            ListsDataKey lists_data_key(key, version, current_index++);
+            ListsDataKey lists_data_key(data_owner, version, current_index++);
             batch.Put(handles_[1], lists_data_key.Encode(), node);
           }
           parsed_lists_meta_value.ModifyLeftIndex(1);
@@ -339,7 +370,7 @@ Status RedisLists::LInsert(const Slice& key,
           current_index = pivot_index;
           rocksdb::Iterator* after_half_iter =
             db_->NewIterator(default_read_options_, handles_[1]);
-          ListsDataKey start_data_key(key, version, current_index);
+          ListsDataKey start_data_key(data_owner, version, current_index);
           for (after_half_iter->Seek(start_data_key.Encode());
                after_half_iter->Valid()
                 && current_index < parsed_lists_meta_value.right_index();
@@ -354,14 +385,14 @@ Status RedisLists::LInsert(const Slice& key,
 
           current_index = target_index + 1;
           for (const auto& node : list_nodes) {
-            ListsDataKey lists_data_key(key, version, current_index++);
+            ListsDataKey lists_data_key(data_owner, version, current_index++);
             batch.Put(handles_[1], lists_data_key.Encode(), node);
           }
           parsed_lists_meta_value.ModifyRightIndex(1);
         }
         parsed_lists_meta_value.ModifyCount(1);
         batch.Put(handles_[0], key, meta_value);
-        ListsDataKey lists_target_key(key, version, target_index);
+        ListsDataKey lists_target_key(data_owner, version, target_index);
         batch.Put(handles_[1], lists_target_key.Encode(), value);
         *ret = parsed_lists_meta_value.count();
         return db_->Write(default_write_options_, &batch);
@@ -405,8 +436,9 @@ Status RedisLists::LPop(const Slice& key, std::string* element) {
       return Status::NotFound();
     } else {
       int32_t version = parsed_lists_meta_value.version();
+      Slice data_owner = parsed_lists_meta_value.data_owner(key);
       uint64_t first_node_index = parsed_lists_meta_value.left_index() + 1;
-      ListsDataKey lists_data_key(key, version, first_node_index);
+      ListsDataKey lists_data_key(data_owner, version, first_node_index);
       s = db_->Get(default_read_options_,
           handles_[1], lists_data_key.Encode(), element);
       if (s.ok()) {
@@ -430,6 +462,7 @@ Status RedisLists::LPush(const Slice& key,
                          const std::vector<std::string>& values,
                          uint64_t* ret) {
   *ret = 0;
+  uint32_t statistic = 0;
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
 
@@ -441,24 +474,27 @@ Status RedisLists::LPush(const Slice& key,
     ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
     if (parsed_lists_meta_value.IsStale()
       || parsed_lists_meta_value.count() == 0) {
-      version = parsed_lists_meta_value.InitialMetaValue();
+      version = parsed_lists_meta_value.InitialMetaValue(version_floor());
     } else {
       version = parsed_lists_meta_value.version();
     }
+    Slice data_owner = parsed_lists_meta_value.data_owner(key);
     for (const auto& value : values) {
       index = parsed_lists_meta_value.left_index();
       parsed_lists_meta_value.ModifyLeftIndex(1);
       parsed_lists_meta_value.ModifyCount(1);
-      ListsDataKey lists_data_key(key, version, index);
+      ListsDataKey lists_data_key(data_owner, version, index);
       batch.Put(handles_[1], lists_data_key.Encode(), value);
     }
+    TrimCappedList(data_owner, version, false,
+                   &parsed_lists_meta_value, &batch, &statistic);
     batch.Put(handles_[0], key, meta_value);
     *ret = parsed_lists_meta_value.count();
   } else if (s.IsNotFound()) {
     char str[8];
     EncodeFixed64(str, values.size());
     ListsMetaValue lists_meta_value(Slice(str, sizeof(uint64_t)));
-    version = lists_meta_value.UpdateVersion();
+    version = lists_meta_value.UpdateVersion(version_floor());
     for (const auto& value : values) {
       index = lists_meta_value.left_index();
       lists_meta_value.ModifyLeftIndex(1);
@@ -470,11 +506,14 @@ Status RedisLists::LPush(const Slice& key,
   } else {
     return s;
   }
-  return db_->Write(default_write_options_, &batch);
+  s = db_->Write(default_write_options_, &batch);
+  UpdateSpecificKeyStatistics(key.ToString(), statistic);
+  return s;
 }
 
 Status RedisLists::LPushx(const Slice& key, const Slice& value, uint64_t* len) {
   *len = 0;
+  uint32_t statistic = 0;
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
 
@@ -488,14 +527,19 @@ Status RedisLists::LPushx(const Slice& key, const Slice& value, uint64_t* len) {
       return Status::NotFound();
     } else {
       uint32_t version = parsed_lists_meta_value.version();
+      Slice data_owner = parsed_lists_meta_value.data_owner(key);
       uint64_t index = parsed_lists_meta_value.left_index();
       parsed_lists_meta_value.ModifyCount(1);
       parsed_lists_meta_value.ModifyLeftIndex(1);
-      ListsDataKey lists_data_key(key, version, index);
-      batch.Put(handles_[0], key, meta_value);
+      ListsDataKey lists_data_key(data_owner, version, index);
       batch.Put(handles_[1], lists_data_key.Encode(), value);
+      TrimCappedList(data_owner, version, false,
+                     &parsed_lists_meta_value, &batch, &statistic);
+      batch.Put(handles_[0], key, meta_value);
       *len = parsed_lists_meta_value.count();
-      return db_->Write(default_write_options_, &batch);
+      s = db_->Write(default_write_options_, &batch);
+      UpdateSpecificKeyStatistics(key.ToString(), statistic);
+      return s;
     }
   }
   return s;
@@ -519,6 +563,7 @@ Status RedisLists::LRange(const Slice& key, int64_t start, int64_t stop,
       return Status::NotFound();
     } else {
       int32_t version = parsed_lists_meta_value.version();
+      Slice data_owner = parsed_lists_meta_value.data_owner(key);
       uint64_t origin_left_index = parsed_lists_meta_value.left_index() + 1;
       uint64_t origin_right_index = parsed_lists_meta_value.right_index() - 1;
       uint64_t sublist_left_index  = start >= 0 ?
@@ -542,7 +587,7 @@ Status RedisLists::LRange(const Slice& key, int64_t start, int64_t stop,
         rocksdb::Iterator* iter = db_->NewIterator(read_options,
                 handles_[1]);
         uint64_t current_index = sublist_left_index;
-        ListsDataKey start_data_key(key, version, current_index);
+        ListsDataKey start_data_key(data_owner, version, current_index);
         for (iter->Seek(start_data_key.Encode());
              iter->Valid() && current_index <= sublist_right_index;
              iter->Next(), current_index++) {
@@ -576,10 +621,11 @@ Status RedisLists::LRem(const Slice& key, int64_t count,
       std::vector<uint64_t> delete_index;
       uint64_t rest = (count < 0) ? -count : count;
       uint32_t version = parsed_lists_meta_value.version();
+      Slice data_owner = parsed_lists_meta_value.data_owner(key);
       uint64_t start_index = parsed_lists_meta_value.left_index() + 1;
       uint64_t stop_index = parsed_lists_meta_value.right_index() - 1;
-      ListsDataKey start_data_key(key, version, start_index);
-      ListsDataKey stop_data_key(key, version, stop_index);
+      ListsDataKey start_data_key(data_owner, version, start_index);
+      ListsDataKey stop_data_key(data_owner, version, stop_index);
       if (count >= 0) {
         current_index = start_index;
         rocksdb::Iterator* iter =
@@ -627,7 +673,8 @@ Status RedisLists::LRem(const Slice& key, int64_t count,
         if (left_part_len <= right_part_len) {
           uint64_t left = sublist_right_index;
           current_index  = sublist_right_index;
-          ListsDataKey sublist_right_key(key, version, sublist_right_index);
+          ListsDataKey sublist_right_key(data_owner, version,
+                                         sublist_right_index);
           rocksdb::Iterator* iter =
             db_->NewIterator(default_read_options_, handles_[1]);
           for (iter->Seek(sublist_right_key.Encode());
@@ -637,7 +684,7 @@ Status RedisLists::LRem(const Slice& key, int64_t count,
               && rest > 0) {
               rest--;
             } else {
-              ListsDataKey lists_data_key(key, version, left--);
+              ListsDataKey lists_data_key(data_owner, version, left--);
               batch.Put(handles_[1], lists_data_key.Encode(), iter->value());
             }
           }
@@ -650,7 +697,8 @@ Status RedisLists::LRem(const Slice& key, int64_t count,
         } else {
           uint64_t right = sublist_left_index;
           current_index = sublist_left_index;
-          ListsDataKey sublist_left_key(key, version, sublist_left_index);
+          ListsDataKey sublist_left_key(data_owner, version,
+                                        sublist_left_index);
           rocksdb::Iterator* iter =
             db_->NewIterator(default_read_options_, handles_[1]);
           for (iter->Seek(sublist_left_key.Encode());
@@ -660,7 +708,7 @@ Status RedisLists::LRem(const Slice& key, int64_t count,
               && rest > 0) {
               rest--;
             } else {
-              ListsDataKey lists_data_key(key, version, right++);
+              ListsDataKey lists_data_key(data_owner, version, right++);
               batch.Put(handles_[1], lists_data_key.Encode(), iter->value());
             }
           }
@@ -674,7 +722,7 @@ Status RedisLists::LRem(const Slice& key, int64_t count,
         parsed_lists_meta_value.ModifyCount(-target_index.size());
         batch.Put(handles_[0], key, meta_value);
         for (const auto& idx : delete_index) {
-          ListsDataKey lists_data_key(key, version, idx);
+          ListsDataKey lists_data_key(data_owner, version, idx);
           batch.Delete(handles_[1], lists_data_key.Encode());
         }
         *ret = target_index.size();
@@ -700,6 +748,7 @@ Status RedisLists::LSet(const Slice& key, int64_t index, const Slice& value) {
       return Status::NotFound();
     } else {
       uint32_t version = parsed_lists_meta_value.version();
+      Slice data_owner = parsed_lists_meta_value.data_owner(key);
       uint64_t target_index = index >= 0 ?
         parsed_lists_meta_value.left_index() + index + 1
         : parsed_lists_meta_value.right_index() + index;
@@ -707,7 +756,7 @@ Status RedisLists::LSet(const Slice& key, int64_t index, const Slice& value) {
         || target_index >= parsed_lists_meta_value.right_index()) {
         return Status::Corruption("index out of range");
       }
-      ListsDataKey lists_data_key(key, version, target_index);
+      ListsDataKey lists_data_key(data_owner, version, target_index);
       s = db_->Put(default_write_options_, handles_[1],
                    lists_data_key.Encode(), value);
       statistic++;
@@ -728,6 +777,7 @@ Status RedisLists::LTrim(const Slice& key, int64_t start, int64_t stop) {
   if (s.ok()) {
     ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
     int32_t version = parsed_lists_meta_value.version();
+    Slice data_owner = parsed_lists_meta_value.data_owner(key);
     if (parsed_lists_meta_value.IsStale()) {
       return Status::NotFound("Stale");
     } else if (parsed_lists_meta_value.count() == 0) {
@@ -749,10 +799,10 @@ Status RedisLists::LTrim(const Slice& key, int64_t start, int64_t stop) {
              idx <= origin_right_index;
              idx++) {
           statistic++;
-          ListsDataKey lists_data_key(key, version, idx);
+          ListsDataKey lists_data_key(data_owner, version, idx);
           batch.Delete(handles_[1], lists_data_key.Encode());
         }
-        parsed_lists_meta_value.InitialMetaValue();
+        parsed_lists_meta_value.InitialMetaValue(version_floor());
         batch.Put(handles_[0], key, meta_value);
       } else {
         if (sublist_left_index < origin_left_index) {
@@ -775,14 +825,14 @@ Status RedisLists::LTrim(const Slice& key, int64_t start, int64_t stop) {
              idx < sublist_left_index;
              ++idx) {
           statistic++;
-          ListsDataKey lists_data_key(key, version, idx);
+          ListsDataKey lists_data_key(data_owner, version, idx);
           batch.Delete(handles_[1], lists_data_key.Encode());
         }
         for (uint64_t idx = origin_right_index;
              idx > sublist_right_index;
              --idx) {
           statistic++;
-          ListsDataKey lists_data_key(key, version, idx);
+          ListsDataKey lists_data_key(data_owner, version, idx);
           batch.Delete(handles_[1], lists_data_key.Encode());
         }
       }
@@ -810,8 +860,9 @@ Status RedisLists::RPop(const Slice& key, std::string* element) {
       return Status::NotFound();
     } else {
       int32_t version = parsed_lists_meta_value.version();
+      Slice data_owner = parsed_lists_meta_value.data_owner(key);
       uint64_t last_node_index = parsed_lists_meta_value.right_index() - 1;
-      ListsDataKey lists_data_key(key, version, last_node_index);
+      ListsDataKey lists_data_key(data_owner, version, last_node_index);
       s = db_->Get(default_read_options_,
           handles_[1], lists_data_key.Encode(), element);
       if (s.ok()) {
@@ -852,8 +903,9 @@ Status RedisLists::RPoplpush(const Slice& source,
       } else {
         std::string target;
         int32_t version = parsed_lists_meta_value.version();
+        Slice data_owner = parsed_lists_meta_value.data_owner(source);
         uint64_t last_node_index = parsed_lists_meta_value.right_index() - 1;
-        ListsDataKey lists_data_key(source, version, last_node_index);
+        ListsDataKey lists_data_key(data_owner, version, last_node_index);
         s = db_->Get(default_read_options_,
             handles_[1], lists_data_key.Encode(), &target);
         if (s.ok()) {
@@ -862,7 +914,7 @@ Status RedisLists::RPoplpush(const Slice& source,
             return Status::OK();
           } else {
             uint64_t target_index = parsed_lists_meta_value.left_index();
-            ListsDataKey lists_target_key(source, version, target_index);
+            ListsDataKey lists_target_key(data_owner, version, target_index);
             batch.Delete(handles_[1], lists_data_key.Encode());
             batch.Put(handles_[1], lists_target_key.Encode(), target);
             statistic++;
@@ -894,8 +946,9 @@ Status RedisLists::RPoplpush(const Slice& source,
       return Status::NotFound();
     } else {
       version = parsed_lists_meta_value.version();
+      Slice data_owner = parsed_lists_meta_value.data_owner(source);
       uint64_t last_node_index = parsed_lists_meta_value.right_index() - 1;
-      ListsDataKey lists_data_key(source, version, last_node_index);
+      ListsDataKey lists_data_key(data_owner, version, last_node_index);
       s = db_->Get(default_read_options_,
           handles_[1], lists_data_key.Encode(), &target);
       if (s.ok()) {
@@ -919,12 +972,13 @@ Status RedisLists::RPoplpush(const Slice& source,
     ParsedListsMetaValue parsed_lists_meta_value(&destination_meta_value);
     if (parsed_lists_meta_value.IsStale()
       || parsed_lists_meta_value.count() == 0) {
-      version = parsed_lists_meta_value.InitialMetaValue();
+      version = parsed_lists_meta_value.InitialMetaValue(version_floor());
     } else {
       version = parsed_lists_meta_value.version();
     }
+    Slice data_owner = parsed_lists_meta_value.data_owner(destination);
     uint64_t target_index = parsed_lists_meta_value.left_index();
-    ListsDataKey lists_data_key(destination, version, target_index);
+    ListsDataKey lists_data_key(data_owner, version, target_index);
     batch.Put(handles_[1], lists_data_key.Encode(), target);
     parsed_lists_meta_value.ModifyCount(1);
     parsed_lists_meta_value.ModifyLeftIndex(1);
@@ -933,7 +987,7 @@ Status RedisLists::RPoplpush(const Slice& source,
     char str[8];
     EncodeFixed64(str, 1);
     ListsMetaValue lists_meta_value(Slice(str, sizeof(uint64_t)));
-    version = lists_meta_value.UpdateVersion();
+    version = lists_meta_value.UpdateVersion(version_floor());
     uint64_t target_index = lists_meta_value.left_index();
     ListsDataKey lists_data_key(destination, version, target_index);
     batch.Put(handles_[1], lists_data_key.Encode(), target);
@@ -955,7 +1009,9 @@ Status RedisLists::RPush(const Slice& key,
                          const std::vector<std::string>& values,
                          uint64_t* ret) {
   *ret = 0;
+  uint32_t statistic = 0;
   rocksdb::WriteBatch batch;
+  ScopeRecordLock l(lock_mgr_, key);
 
   uint64_t index = 0;
   int32_t version = 0;
@@ -965,24 +1021,27 @@ Status RedisLists::RPush(const Slice& key,
     ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
     if (parsed_lists_meta_value.IsStale()
       || parsed_lists_meta_value.count() == 0) {
-      version = parsed_lists_meta_value.InitialMetaValue();
+      version = parsed_lists_meta_value.InitialMetaValue(version_floor());
     } else {
       version = parsed_lists_meta_value.version();
     }
+    Slice data_owner = parsed_lists_meta_value.data_owner(key);
     for (const auto& value : values) {
       index = parsed_lists_meta_value.right_index();
       parsed_lists_meta_value.ModifyRightIndex(1);
       parsed_lists_meta_value.ModifyCount(1);
-      ListsDataKey lists_data_key(key, version, index);
+      ListsDataKey lists_data_key(data_owner, version, index);
       batch.Put(handles_[1], lists_data_key.Encode(), value);
     }
+    TrimCappedList(data_owner, version, true,
+                   &parsed_lists_meta_value, &batch, &statistic);
     batch.Put(handles_[0], key, meta_value);
     *ret = parsed_lists_meta_value.count();
   } else if (s.IsNotFound()) {
     char str[8];
     EncodeFixed64(str, values.size());
     ListsMetaValue lists_meta_value(Slice(str, sizeof(uint64_t)));
-    version = lists_meta_value.UpdateVersion();
+    version = lists_meta_value.UpdateVersion(version_floor());
     for (auto value : values) {
       index = lists_meta_value.right_index();
       lists_meta_value.ModifyRightIndex(1);
@@ -994,11 +1053,14 @@ Status RedisLists::RPush(const Slice& key,
   } else {
     return s;
   }
-  return db_->Write(default_write_options_, &batch);
+  s = db_->Write(default_write_options_, &batch);
+  UpdateSpecificKeyStatistics(key.ToString(), statistic);
+  return s;
 }
 
 Status RedisLists::RPushx(const Slice& key, const Slice& value, uint64_t* len) {
   *len = 0;
+  uint32_t statistic = 0;
   rocksdb::WriteBatch batch;
 
   ScopeRecordLock l(lock_mgr_, key);
@@ -1012,19 +1074,130 @@ Status RedisLists::RPushx(const Slice& key, const Slice& value, uint64_t* len) {
       return Status::NotFound();
     } else {
       uint32_t version = parsed_lists_meta_value.version();
+      Slice data_owner = parsed_lists_meta_value.data_owner(key);
       uint64_t index = parsed_lists_meta_value.right_index();
       parsed_lists_meta_value.ModifyCount(1);
       parsed_lists_meta_value.ModifyRightIndex(1);
-      ListsDataKey lists_data_key(key, version, index);
-      batch.Put(handles_[0], key, meta_value);
+      ListsDataKey lists_data_key(data_owner, version, index);
       batch.Put(handles_[1], lists_data_key.Encode(), value);
+      TrimCappedList(data_owner, version, true,
+                     &parsed_lists_meta_value, &batch, &statistic);
+      batch.Put(handles_[0], key, meta_value);
       *len = parsed_lists_meta_value.count();
-      return db_->Write(default_write_options_, &batch);
+      s = db_->Write(default_write_options_, &batch);
+      UpdateSpecificKeyStatistics(key.ToString(), statistic);
+      return s;
     }
   }
   return s;
 }
 
+Status RedisLists::LPushCapped(const Slice& key,
+                               const std::vector<std::string>& values,
+                               uint64_t cap, uint64_t* ret) {
+  return PushCapped(key, values, cap, true, ret);
+}
+
+Status RedisLists::RPushCapped(const Slice& key,
+                               const std::vector<std::string>& values,
+                               uint64_t cap, uint64_t* ret) {
+  return PushCapped(key, values, cap, false, ret);
+}
+
+Status RedisLists::PushCapped(const Slice& key,
+                              const std::vector<std::string>& values,
+                              uint64_t cap, bool left, uint64_t* ret) {
+  *ret = 0;
+  if (cap == 0) {
+    return Status::InvalidArgument("cap must be positive");
+  }
+  uint32_t statistic = 0;
+  rocksdb::WriteBatch batch;
+  ScopeRecordLock l(lock_mgr_, key);
+
+  int32_t version = 0;
+  std::string meta_value;
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.IsNotFound()) {
+    char str[8];
+    EncodeFixed64(str, 0);
+    ListsMetaValue lists_meta_value(Slice(str, sizeof(uint64_t)));
+    lists_meta_value.UpdateVersion(version_floor());
+    meta_value = lists_meta_value.Encode().ToString();
+  } else if (!s.ok()) {
+    return s;
+  }
+  ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
+  if (parsed_lists_meta_value.IsStale()
+    || parsed_lists_meta_value.count() == 0) {
+    version = parsed_lists_meta_value.InitialMetaValue(version_floor());
+  } else {
+    version = parsed_lists_meta_value.version();
+  }
+  parsed_lists_meta_value.set_cap(cap);
+  Slice data_owner = parsed_lists_meta_value.data_owner(key);
+
+  // The values this push would evict itself are never written
+  size_t pos = values.size() > cap ? values.size() - cap : 0;
+  for (; pos < values.size(); ++pos) {
+    uint64_t index;
+    if (left) {
+      index = parsed_lists_meta_value.left_index();
+      parsed_lists_meta_value.ModifyLeftIndex(1);
+    } else {
+      index = parsed_lists_meta_value.right_index();
+      parsed_lists_meta_value.ModifyRightIndex(1);
+    }
+    parsed_lists_meta_value.ModifyCount(1);
+    ListsDataKey lists_data_key(data_owner, version, index);
+    batch.Put(handles_[1], lists_data_key.Encode(), values[pos]);
+  }
+  TrimCappedList(data_owner, version, !left,
+                 &parsed_lists_meta_value, &batch, &statistic);
+  batch.Put(handles_[0], key, meta_value);
+  *ret = parsed_lists_meta_value.count();
+  s = db_->Write(default_write_options_, &batch);
+  UpdateSpecificKeyStatistics(key.ToString(), statistic);
+  return s;
+}
+
+void RedisLists::TrimCappedList(const Slice& data_owner, int32_t version,
+                                bool evict_left,
+                                ParsedListsMetaValue* parsed_lists_meta_value,
+                                rocksdb::WriteBatch* batch,
+                                uint32_t* statistic) {
+  if (!parsed_lists_meta_value->capped()
+    || parsed_lists_meta_value->count() <= parsed_lists_meta_value->cap()) {
+    return;
+  }
+  uint64_t evict_num = parsed_lists_meta_value->count()
+    - parsed_lists_meta_value->cap();
+  uint64_t start_index;
+  if (evict_left) {
+    start_index = parsed_lists_meta_value->left_index() + 1;
+    parsed_lists_meta_value->ModifyLeftIndex(-evict_num);
+  } else {
+    start_index = parsed_lists_meta_value->right_index() - evict_num;
+    parsed_lists_meta_value->ModifyRightIndex(-evict_num);
+  }
+  parsed_lists_meta_value->ModifyCount(-evict_num);
+
+  // A long evicted range is covered by one range tombstone, the data
+  // filter only drops the data keys of stale versions
+  if (evict_num > kCappedListRangeDeleteNum) {
+    ListsDataKey start_data_key(data_owner, version, start_index);
+    ListsDataKey end_data_key(data_owner, version, start_index + evict_num);
+    batch->DeleteRange(handles_[1],
+        start_data_key.Encode(), end_data_key.Encode());
+  } else {
+    for (uint64_t idx = start_index; idx < start_index + evict_num; ++idx) {
+      (*statistic)++;
+      ListsDataKey lists_data_key(data_owner, version, idx);
+      batch->Delete(handles_[1], lists_data_key.Encode());
+    }
+  }
+}
+
 Status RedisLists::PKScanRange(const Slice& key_start,
                                const Slice& key_end,
                                const Slice& pattern,
@@ -1169,7 +1342,7 @@ Status RedisLists::Expire(const Slice& key, int32_t ttl) {
       parsed_lists_meta_value.SetRelativeTimestamp(ttl);
       s = db_->Put(default_write_options_, handles_[0], key, meta_value);
     } else {
-      parsed_lists_meta_value.InitialMetaValue();
+      parsed_lists_meta_value.InitialMetaValue(version_floor());
       s = db_->Put(default_write_options_, handles_[0], key, meta_value);
     }
   }
@@ -1188,7 +1361,7 @@ Status RedisLists::Del(const Slice& key) {
       return Status::NotFound();
     } else {
       uint32_t statistic = parsed_lists_meta_value.count();
-      parsed_lists_meta_value.InitialMetaValue();
+      parsed_lists_meta_value.InitialMetaValue(version_floor());
       s = db_->Put(default_write_options_, handles_[0], key, meta_value);
       UpdateSpecificKeyStatistics(key.ToString(), statistic);
     }
@@ -1256,7 +1429,7 @@ Status RedisLists::Expireat(const Slice& key, int32_t timestamp) {
       if (timestamp > 0) {
         parsed_lists_meta_value.set_timestamp(timestamp);
       } else {
-        parsed_lists_meta_value.InitialMetaValue();
+        parsed_lists_meta_value.InitialMetaValue(version_floor());
       }
       return db_->Put(default_write_options_, handles_[0], key, meta_value);
     }
@@ -1314,6 +1487,230 @@ Status RedisLists::TTL(const Slice& key, int64_t* timestamp) {
   return s;
 }
 
+Status RedisLists::Rename(const Slice& key, const Slice& newkey, bool nx) {
+  std::string meta_value;
+  MultiScopeRecordLock ml(lock_mgr_, {key.ToString(), newkey.ToString()});
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
+  if (parsed_lists_meta_value.IsStale()) {
+    return Status::NotFound("Stale");
+  } else if (parsed_lists_meta_value.count() == 0) {
+    return Status::NotFound();
+  } else if (key == newkey) {
+    return nx ? Status::Busy("newkey exists") : Status::OK();
+  }
+
+  // newkey reads the data keys of the origin from now on, without
+  // moving them, the versions it used before are never used again
+  int32_t last_own_version = 0;
+  std::string new_meta_value;
+  s = db_->Get(default_read_options_, handles_[0], newkey, &new_meta_value);
+  if (s.ok()) {
+    ParsedListsMetaValue parsed_new_meta_value(&new_meta_value);
+    if (nx && !parsed_new_meta_value.IsStale()
+      && parsed_new_meta_value.count() != 0) {
+      return Status::Busy("newkey exists");
+    }
+    last_own_version = parsed_new_meta_value.last_own_version();
+  } else if (!s.IsNotFound()) {
+    return s;
+  }
+  int32_t version = parsed_lists_meta_value.version();
+  std::string origin = parsed_lists_meta_value.data_owner(key).ToString();
+  new_meta_value = meta_value;
+  ParsedListsMetaValue parsed_new_meta_value(&new_meta_value);
+  parsed_new_meta_value.SetOrigin(origin, last_own_version);
+
+  rocksdb::WriteBatch batch;
+  batch.Put(handles_[0], newkey, new_meta_value);
+  OriginRefKey origin_ref_key(origin, version, newkey);
+  batch.Put(handles_.back(), origin_ref_key.Encode(), Slice());
+  // key is initialized instead of deleted, so that its new version never
+  // collides with the version read by newkey
+  parsed_lists_meta_value.InitialMetaValue(version_floor());
+  batch.Put(handles_[0], key, meta_value);
+  return db_->Write(default_write_options_, &batch);
+}
+
+Status RedisLists::Copy(const Slice& key, const Slice& newkey,
+                        bool replace) {
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot;
+
+  std::string meta_value;
+  MultiScopeRecordLock ml(lock_mgr_, {key.ToString(), newkey.ToString()});
+  ScopeSnapshot ss(db_, &snapshot);
+  read_options.snapshot = snapshot;
+  Status s = db_->Get(read_options, handles_[0], key, &meta_value);
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
+  if (parsed_lists_meta_value.IsStale()) {
+    return Status::NotFound("Stale");
+  } else if (parsed_lists_meta_value.count() == 0) {
+    return Status::NotFound();
+  } else if (key == newkey) {
+    return Status::OK();
+  }
+
+  uint32_t statistic = 0;
+  int32_t new_version = 0;
+  std::string new_meta_value;
+  s = db_->Get(read_options, handles_[0], newkey, &new_meta_value);
+  if (s.ok()) {
+    ParsedListsMetaValue parsed_new_meta_value(&new_meta_value);
+    if (!replace && !parsed_new_meta_value.IsStale()
+      && parsed_new_meta_value.count() != 0) {
+      return Status::Busy("newkey exists");
+    }
+    if (!parsed_new_meta_value.IsStale()) {
+      statistic = parsed_new_meta_value.count();
+    }
+    new_version = parsed_new_meta_value.InitialMetaValue(version_floor());
+  } else if (s.IsNotFound()) {
+    char str[8];
+    EncodeFixed64(str, 0);
+    ListsMetaValue lists_meta_value(Slice(str, sizeof(uint64_t)));
+    new_version = lists_meta_value.UpdateVersion(version_floor());
+    new_meta_value = lists_meta_value.Encode().ToString();
+  } else {
+    return s;
+  }
+  // The empty meta of the new version goes first, the elements written
+  // by the batches before the last one are invisible until the last
+  // batch counts them in the meta, as Restore does
+  rocksdb::WriteBatch batch;
+  batch.Put(handles_[0], newkey, new_meta_value);
+  int32_t version = parsed_lists_meta_value.version();
+  Slice data_owner = parsed_lists_meta_value.data_owner(key);
+  uint64_t current_index = parsed_lists_meta_value.left_index() + 1;
+  uint64_t last_index = parsed_lists_meta_value.right_index() - 1;
+  ListsDataKey start_data_key(data_owner, version, current_index);
+  rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
+  for (iter->Seek(start_data_key.Encode());
+       iter->Valid() && current_index <= last_index;
+       iter->Next(), current_index++) {
+    ListsDataKey lists_data_key(newkey, new_version, current_index);
+    batch.Put(handles_[1], lists_data_key.Encode(), iter->value());
+    if (batch.GetDataSize() >= kRestoreBatchBytes) {
+      s = db_->Write(default_write_options_, &batch);
+      if (!s.ok()) {
+        delete iter;
+        return s;
+      }
+      batch.Clear();
+    }
+  }
+  s = iter->status();
+  delete iter;
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedListsMetaValue parsed_new_meta_value(&new_meta_value);
+  parsed_new_meta_value.set_count(parsed_lists_meta_value.count());
+  parsed_new_meta_value.set_timestamp(parsed_lists_meta_value.timestamp());
+  parsed_new_meta_value.set_left_index(parsed_lists_meta_value.left_index());
+  parsed_new_meta_value.set_right_index(
+      parsed_lists_meta_value.right_index());
+  batch.Put(handles_[0], newkey, new_meta_value);
+  s = db_->Write(default_write_options_, &batch);
+  UpdateSpecificKeyStatistics(newkey.ToString(), statistic);
+  return s;
+}
+
+Status RedisLists::Dump(const Slice& key, DumpWriter* writer) {
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot;
+
+  std::string meta_value;
+  ScopeSnapshot ss(db_, &snapshot);
+  read_options.snapshot = snapshot;
+  read_options.fill_cache = false;
+  Status s = db_->Get(read_options, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
+    if (parsed_lists_meta_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (parsed_lists_meta_value.count() == 0) {
+      return Status::NotFound();
+    }
+    writer->Begin(kLists);
+    int32_t version = parsed_lists_meta_value.version();
+    Slice data_owner = parsed_lists_meta_value.data_owner(key);
+    uint64_t current_index = parsed_lists_meta_value.left_index() + 1;
+    uint64_t last_index = parsed_lists_meta_value.right_index() - 1;
+    ListsDataKey start_data_key(data_owner, version, current_index);
+    rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
+    bool within_limit = true;
+    for (iter->Seek(start_data_key.Encode());
+         within_limit && iter->Valid() && current_index <= last_index;
+         iter->Next(), current_index++) {
+      within_limit = writer->Add(iter->value());
+    }
+    s = iter->status();
+    delete iter;
+  }
+  return s;
+}
+
+Status RedisLists::Restore(const Slice& key, DumpReader* reader,
+                           int32_t ttl, bool replace) {
+  int32_t version = 0;
+  std::string meta_value;
+  ScopeRecordLock l(lock_mgr_, key);
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
+    if (!replace && !parsed_lists_meta_value.IsStale()
+      && parsed_lists_meta_value.count() != 0) {
+      return Status::Busy("Target key name already exists");
+    }
+    version = parsed_lists_meta_value.InitialMetaValue(version_floor());
+  } else if (s.IsNotFound()) {
+    char str[8];
+    EncodeFixed64(str, 0);
+    ListsMetaValue lists_meta_value(Slice(str, sizeof(uint64_t)));
+    version = lists_meta_value.UpdateVersion(version_floor());
+    meta_value = lists_meta_value.Encode().ToString();
+  } else {
+    return s;
+  }
+
+  // The empty meta of the new version goes first, the elements written
+  // by the batches before the last one are invisible until the last
+  // batch counts them in the meta
+  rocksdb::WriteBatch batch;
+  batch.Put(handles_[0], key, meta_value);
+  ParsedListsMetaValue parsed_lists_meta_value(&meta_value);
+  Slice value;
+  while (reader->Next(&value)) {
+    uint64_t index = parsed_lists_meta_value.right_index();
+    ListsDataKey lists_data_key(key, version, index);
+    batch.Put(handles_[1], lists_data_key.Encode(), value);
+    parsed_lists_meta_value.ModifyRightIndex(1);
+    parsed_lists_meta_value.ModifyCount(1);
+    if (batch.GetDataSize() >= kRestoreBatchBytes) {
+      s = db_->Write(default_write_options_, &batch);
+      if (!s.ok()) {
+        return s;
+      }
+      batch.Clear();
+    }
+  }
+  if (!reader->Done()) {
+    return Status::Corruption("Malformed lists dump");
+  }
+  if (ttl > 0) {
+    parsed_lists_meta_value.SetRelativeTimestamp(ttl);
+  }
+  batch.Put(handles_[0], key, meta_value);
+  return db_->Write(default_write_options_, &batch);
+}
+
 void RedisLists::ScanDatabase() {
   rocksdb::ReadOptions iterator_options;
   const rocksdb::Snapshot* snapshot;
@@ -12,6 +12,7 @@
 
 #include "src/redis.h"
 #include "src/custom_comparator.h"
+#include "src/lists_meta_value_format.h"
 
 namespace blackwidow {
 
@@ -55,6 +56,10 @@ class RedisLists : public Redis {
   Status RPush(const Slice& key, const std::vector<std::string>& values,
                uint64_t* ret);
   Status RPushx(const Slice& key, const Slice& value, uint64_t* len);
+  Status LPushCapped(const Slice& key, const std::vector<std::string>& values,
+                     uint64_t cap, uint64_t* ret);
+  Status RPushCapped(const Slice& key, const std::vector<std::string>& values,
+                     uint64_t cap, uint64_t* ret);
   Status PKScanRange(const Slice& key_start, const Slice& key_end,
                      const Slice& pattern, int32_t limit,
                      std::vector<std::string>* keys, std::string* next_key);
@@ -71,12 +76,27 @@ class RedisLists : public Redis {
   Status Expireat(const Slice& key, int32_t timestamp) override;
   Status Persist(const Slice& key) override;
   Status TTL(const Slice& key, int64_t* timestamp) override;
+  Status Rename(const Slice& key, const Slice& newkey, bool nx) override;
+  Status Copy(const Slice& key, const Slice& newkey, bool replace) override;
+  Status Dump(const Slice& key, DumpWriter* writer) override;
+  Status Restore(const Slice& key, DumpReader* reader,
+                 int32_t ttl, bool replace) override;
 
   // Iterate all data
   void ScanDatabase();
 
  private:
+  // handles_[2] is the origin_cf, it is always the last one
   std::vector<rocksdb::ColumnFamilyHandle*> handles_;
+
+  Status PushCapped(const Slice& key, const std::vector<std::string>& values,
+                    uint64_t cap, bool left, uint64_t* ret);
+  // Evict the elements of a capped list beyond its cap, from the left
+  // end after a right push and the other way round
+  void TrimCappedList(const Slice& data_owner, int32_t version,
+                      bool evict_left,
+                      ParsedListsMetaValue* parsed_lists_meta_value,
+                      rocksdb::WriteBatch* batch, uint32_t* statistic);
 };
 
 }  //  namespace blackwidow
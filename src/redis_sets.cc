@@ -13,6 +13,7 @@
 #include "blackwidow/util.h"
 #include "src/base_filter.h"
 #include "src/scope_snapshot.h"
+#include "src/dump_format.h"
 #include "src/scope_record_lock.h"
 
 namespace blackwidow {
@@ -38,8 +39,13 @@ Status RedisSets::Open(const BlackwidowOptions& bw_options,
   small_compaction_threshold_ = bw_options.small_compaction_threshold;
 
   rocksdb::Options ops(bw_options.options);
-  Status s = rocksdb::DB::Open(ops, db_path, &db_);
-  if (s.ok()) {
+  Status s;
+  // read-only and secondary instance can not create column family,
+  // it must have been created by the primary instance
+  if (bw_options.open_mode == kOpenReadWrite) {
+    s = rocksdb::DB::Open(ops, db_path, &db_);
+  }
+  if (bw_options.open_mode == kOpenReadWrite && s.ok()) {
     // create column family
     rocksdb::ColumnFamilyHandle* cf;
     rocksdb::ColumnFamilyOptions cfo;
@@ -54,6 +60,8 @@ Status RedisSets::Open(const BlackwidowOptions& bw_options,
 
   // Open
   rocksdb::DBOptions db_ops(bw_options.options);
+  // origin_cf is missing in the db created before rename was supported
+  db_ops.create_missing_column_families = true;
   rocksdb::ColumnFamilyOptions meta_cf_ops(bw_options.options);
   rocksdb::ColumnFamilyOptions member_cf_ops(bw_options.options);
   meta_cf_ops.compaction_filter_factory =
@@ -61,9 +69,7 @@ Status RedisSets::Open(const BlackwidowOptions& bw_options,
   member_cf_ops.compaction_filter_factory =
       std::make_shared<SetsMemberFilterFactory>(&db_, &handles_);
 
-  // use the bloom filter policy to reduce disk reads
   rocksdb::BlockBasedTableOptions table_ops(bw_options.table_options);
-  table_ops.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10, true));
   rocksdb::BlockBasedTableOptions meta_cf_table_ops(table_ops);
   rocksdb::BlockBasedTableOptions member_cf_table_ops(table_ops);
   if (!bw_options.share_block_cache && bw_options.block_cache_size > 0) {
@@ -72,11 +78,23 @@ Status RedisSets::Open(const BlackwidowOptions& bw_options,
     member_cf_table_ops.block_cache =
       rocksdb::NewLRUCache(bw_options.block_cache_size);
   }
+  // tune every column family for its access pattern
+  ApplyColumnFamilyProfile(bw_options.meta_profile,
+      &meta_cf_ops, &meta_cf_table_ops);
+  ApplyColumnFamilyProfile(bw_options.sets_member_profile,
+      &member_cf_ops, &member_cf_table_ops);
   meta_cf_ops.table_factory.reset(
       rocksdb::NewBlockBasedTableFactory(meta_cf_table_ops));
   member_cf_ops.table_factory.reset(
       rocksdb::NewBlockBasedTableFactory(member_cf_table_ops));
 
+  // the entries of origin_cf are few and read along with the meta
+  rocksdb::ColumnFamilyOptions origin_cf_ops(bw_options.options);
+  origin_cf_ops.compaction_filter_factory =
+    std::make_shared<SetsOriginFilterFactory>(&db_, &handles_);
+  origin_cf_ops.table_factory = meta_cf_ops.table_factory;
+  origin_cf_ops.cf_paths = meta_cf_ops.cf_paths;
+
   std::vector<rocksdb::ColumnFamilyDescriptor> column_families;
   // Meta CF
   column_families.push_back(rocksdb::ColumnFamilyDescriptor(
@@ -84,7 +102,10 @@ Status RedisSets::Open(const BlackwidowOptions& bw_options,
   // Member CF
   column_families.push_back(rocksdb::ColumnFamilyDescriptor(
       "member_cf", member_cf_ops));
-  return rocksdb::DB::Open(db_ops, db_path, column_families, &handles_, &db_);
+  // Origin CF
+  column_families.push_back(rocksdb::ColumnFamilyDescriptor(
+      "origin_cf", origin_cf_ops));
+  return OpenDB(bw_options, db_ops, db_path, column_families, &handles_);
 }
 
 Status RedisSets::CompactRange(const rocksdb::Slice* begin,
@@ -96,6 +117,11 @@ Status RedisSets::CompactRange(const rocksdb::Slice* begin,
   if (type == kData || type == kMetaAndData) {
     db_->CompactRange(default_compact_range_options_, handles_[1], begin, end);
   }
+  // origin_cf is compacted along with the whole db
+  if (type == kMetaAndData) {
+    db_->CompactRange(default_compact_range_options_,
+        handles_[2], nullptr, nullptr);
+  }
   return Status::OK();
 }
 
@@ -197,7 +223,7 @@ Status RedisSets::PKPatternMatchDel(const std::string& pattern,
     if (!parsed_sets_meta_value.IsStale()
       && parsed_sets_meta_value.count()
       && StringMatch(pattern.data(), pattern.size(), key.data(), key.size(), 0)) {
-      parsed_sets_meta_value.InitialMetaValue();
+      parsed_sets_meta_value.InitialMetaValue(version_floor());
       batch.Put(handles_[0], key, meta_value);
     }
     if (static_cast<size_t>(batch.Count()) >= BATCH_DELETE_LIMIT) {
@@ -244,7 +270,7 @@ Status RedisSets::SAdd(const Slice& key,
     ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
     if (parsed_sets_meta_value.IsStale()
       || parsed_sets_meta_value.count() == 0) {
-      version = parsed_sets_meta_value.InitialMetaValue();
+      version = parsed_sets_meta_value.InitialMetaValue(version_floor());
       parsed_sets_meta_value.set_count(filtered_members.size());
       batch.Put(handles_[0], key, meta_value);
       for (const auto& member : filtered_members) {
@@ -256,8 +282,9 @@ Status RedisSets::SAdd(const Slice& key,
       int32_t cnt = 0;
       std::string member_value;
       version = parsed_sets_meta_value.version();
+      Slice data_owner = parsed_sets_meta_value.data_owner(key);
       for (const auto& member : filtered_members) {
-        SetsMemberKey sets_member_key(key, version, member);
+        SetsMemberKey sets_member_key(data_owner, version, member);
         s = db_->Get(default_read_options_, handles_[1],
                      sets_member_key.Encode(), &member_value);
         if (s.ok()) {
@@ -280,7 +307,7 @@ Status RedisSets::SAdd(const Slice& key,
     char str[4];
     EncodeFixed32(str, filtered_members.size());
     SetsMetaValue sets_meta_value(Slice(str, sizeof(int32_t)));
-    version = sets_meta_value.UpdateVersion();
+    version = sets_meta_value.UpdateVersion(version_floor());
     batch.Put(handles_[0], key, sets_meta_value.Encode());
     for (const auto& member : filtered_members) {
       SetsMemberKey sets_member_key(key, version, member);
@@ -333,7 +360,9 @@ Status RedisSets::SDiff(const std::vector<std::string>& keys,
       ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
       if (!parsed_sets_meta_value.IsStale()
         && parsed_sets_meta_value.count() != 0) {
-        vaild_sets.push_back({keys[idx], parsed_sets_meta_value.version()});
+        vaild_sets.push_back(
+            {parsed_sets_meta_value.data_owner(keys[idx]).ToString(),
+             parsed_sets_meta_value.version()});
       }
     } else if (!s.IsNotFound()) {
       return s;
@@ -349,7 +378,8 @@ Status RedisSets::SDiff(const std::vector<std::string>& keys,
       Slice prefix;
       std::string member_value;
       version = parsed_sets_meta_value.version();
-      SetsMemberKey sets_member_key(keys[0], version, Slice());
+      Slice data_owner = parsed_sets_meta_value.data_owner(keys[0]);
+      SetsMemberKey sets_member_key(data_owner, version, Slice());
       prefix = sets_member_key.Encode();
       auto iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(prefix);
@@ -409,7 +439,9 @@ Status RedisSets::SDiffstore(const Slice& destination,
       ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
       if (!parsed_sets_meta_value.IsStale()
         && parsed_sets_meta_value.count() != 0) {
-        vaild_sets.push_back({keys[idx], parsed_sets_meta_value.version()});
+        vaild_sets.push_back(
+            {parsed_sets_meta_value.data_owner(keys[idx]).ToString(),
+             parsed_sets_meta_value.version()});
       }
     } else if (!s.IsNotFound()) {
       return s;
@@ -425,7 +457,8 @@ Status RedisSets::SDiffstore(const Slice& destination,
       bool found;
       std::string member_value;
       version = parsed_sets_meta_value.version();
-      SetsMemberKey sets_member_key(keys[0], version, Slice());
+      Slice data_owner = parsed_sets_meta_value.data_owner(keys[0]);
+      SetsMemberKey sets_member_key(data_owner, version, Slice());
       Slice prefix = sets_member_key.Encode();
       auto iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(prefix);
@@ -463,14 +496,14 @@ Status RedisSets::SDiffstore(const Slice& destination,
   if (s.ok()) {
     ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
     statistic = parsed_sets_meta_value.count();
-    version = parsed_sets_meta_value.InitialMetaValue();
+    version = parsed_sets_meta_value.InitialMetaValue(version_floor());
     parsed_sets_meta_value.set_count(members.size());
     batch.Put(handles_[0], destination, meta_value);
   } else if (s.IsNotFound()) {
     char str[4];
     EncodeFixed32(str, members.size());
     SetsMetaValue sets_meta_value(Slice(str, sizeof(int32_t)));
-    version = sets_meta_value.UpdateVersion();
+    version = sets_meta_value.UpdateVersion(version_floor());
     batch.Put(handles_[0], destination, sets_meta_value.Encode());
   } else {
     return s;
@@ -509,7 +542,9 @@ Status RedisSets::SInter(const std::vector<std::string>& keys,
         || parsed_sets_meta_value.count() == 0) {
         return Status::OK();
       } else {
-        vaild_sets.push_back({keys[idx], parsed_sets_meta_value.version()});
+        vaild_sets.push_back(
+            {parsed_sets_meta_value.data_owner(keys[idx]).ToString(),
+             parsed_sets_meta_value.version()});
       }
     } else if (s.IsNotFound()) {
       return Status::OK();
@@ -528,7 +563,8 @@ Status RedisSets::SInter(const std::vector<std::string>& keys,
       bool reliable;
       std::string member_value;
       version = parsed_sets_meta_value.version();
-      SetsMemberKey sets_member_key(keys[0], version, Slice());
+      Slice data_owner = parsed_sets_meta_value.data_owner(keys[0]);
+      SetsMemberKey sets_member_key(data_owner, version, Slice());
       Slice prefix = sets_member_key.Encode();
       auto iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(prefix);
@@ -596,7 +632,9 @@ Status RedisSets::SInterstore(const Slice& destination,
         have_invalid_sets = true;
         break;
       } else {
-        vaild_sets.push_back({keys[idx], parsed_sets_meta_value.version()});
+        vaild_sets.push_back(
+            {parsed_sets_meta_value.data_owner(keys[idx]).ToString(),
+             parsed_sets_meta_value.version()});
       }
     } else if (s.IsNotFound()) {
       have_invalid_sets = true;
@@ -618,7 +656,8 @@ Status RedisSets::SInterstore(const Slice& destination,
         bool reliable;
         std::string member_value;
         version = parsed_sets_meta_value.version();
-        SetsMemberKey sets_member_key(keys[0], version, Slice());
+        Slice data_owner = parsed_sets_meta_value.data_owner(keys[0]);
+        SetsMemberKey sets_member_key(data_owner, version, Slice());
         Slice prefix = sets_member_key.Encode();
         auto iter = db_->NewIterator(read_options, handles_[1]);
         for (iter->Seek(prefix);
@@ -660,14 +699,14 @@ Status RedisSets::SInterstore(const Slice& destination,
   if (s.ok()) {
     ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
     statistic = parsed_sets_meta_value.count();
-    version = parsed_sets_meta_value.InitialMetaValue();
+    version = parsed_sets_meta_value.InitialMetaValue(version_floor());
     parsed_sets_meta_value.set_count(members.size());
     batch.Put(handles_[0], destination, meta_value);
   } else if (s.IsNotFound()) {
     char str[4];
     EncodeFixed32(str, members.size());
     SetsMetaValue sets_meta_value(Slice(str, sizeof(int32_t)));
-    version = sets_meta_value.UpdateVersion();
+    version = sets_meta_value.UpdateVersion(version_floor());
     batch.Put(handles_[0], destination, sets_meta_value.Encode());
   } else {
     return s;
@@ -702,7 +741,8 @@ Status RedisSets::SIsmember(const Slice& key, const Slice& member,
     } else {
       std::string member_value;
       version = parsed_sets_meta_value.version();
-      SetsMemberKey sets_member_key(key, version, member);
+      Slice data_owner = parsed_sets_meta_value.data_owner(key);
+      SetsMemberKey sets_member_key(data_owner, version, member);
       s = db_->Get(read_options, handles_[1],
               sets_member_key.Encode(), &member_value);
       *ret = s.ok() ? 1 : 0;
@@ -731,7 +771,8 @@ Status RedisSets::SMembers(const Slice& key,
       return Status::NotFound();
     } else {
       version = parsed_sets_meta_value.version();
-      SetsMemberKey sets_member_key(key, version, Slice());
+      Slice data_owner = parsed_sets_meta_value.data_owner(key);
+      SetsMemberKey sets_member_key(data_owner, version, Slice());
       Slice prefix = sets_member_key.Encode();
       auto iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(prefix);
@@ -773,7 +814,8 @@ Status RedisSets::SMove(const Slice& source, const Slice& destination,
     } else {
       std::string member_value;
       version = parsed_sets_meta_value.version();
-      SetsMemberKey sets_member_key(source, version, member);
+      Slice data_owner = parsed_sets_meta_value.data_owner(source);
+      SetsMemberKey sets_member_key(data_owner, version, member);
       s = db_->Get(default_read_options_, handles_[1],
               sets_member_key.Encode(), &member_value);
       if (s.ok()) {
@@ -801,7 +843,7 @@ Status RedisSets::SMove(const Slice& source, const Slice& destination,
     ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
     if (parsed_sets_meta_value.IsStale()
       || parsed_sets_meta_value.count() == 0) {
-      version = parsed_sets_meta_value.InitialMetaValue();
+      version = parsed_sets_meta_value.InitialMetaValue(version_floor());
       parsed_sets_meta_value.set_count(1);
       batch.Put(handles_[0], destination, meta_value);
       SetsMemberKey sets_member_key(destination, version, member);
@@ -809,7 +851,8 @@ Status RedisSets::SMove(const Slice& source, const Slice& destination,
     } else {
       std::string member_value;
       version = parsed_sets_meta_value.version();
-      SetsMemberKey sets_member_key(destination, version, member);
+      Slice data_owner = parsed_sets_meta_value.data_owner(destination);
+      SetsMemberKey sets_member_key(data_owner, version, member);
       s = db_->Get(default_read_options_, handles_[1],
               sets_member_key.Encode(), &member_value);
       if (s.IsNotFound()) {
@@ -824,7 +867,7 @@ Status RedisSets::SMove(const Slice& source, const Slice& destination,
     char str[4];
     EncodeFixed32(str, 1);
     SetsMetaValue sets_meta_value(Slice(str, sizeof(int32_t)));
-    version = sets_meta_value.UpdateVersion();
+    version = sets_meta_value.UpdateVersion(version_floor());
     batch.Put(handles_[0], destination, sets_meta_value.Encode());
     SetsMemberKey sets_member_key(destination, version, member);
     batch.Put(handles_[1], sets_member_key.Encode(), Slice());
@@ -859,8 +902,9 @@ Status RedisSets::SPop(const Slice& key,
       int32_t size = parsed_sets_meta_value.count();
       int32_t target_index = engine() % (size < 50 ? size : 50);
       int32_t version = parsed_sets_meta_value.version();
+      Slice data_owner = parsed_sets_meta_value.data_owner(key);
 
-      SetsMemberKey sets_member_key(key, version, Slice());
+      SetsMemberKey sets_member_key(data_owner, version, Slice());
       auto iter = db_->NewIterator(default_read_options_, handles_[1]);
       for (iter->Seek(sets_member_key.Encode());
            iter->Valid() && cur_index < size;
@@ -929,6 +973,7 @@ Status RedisSets::SRandmember(const Slice& key, int32_t count,
     } else {
       int32_t size = parsed_sets_meta_value.count();
       int32_t version = parsed_sets_meta_value.version();
+      Slice data_owner = parsed_sets_meta_value.data_owner(key);
       if (count > 0) {
         count = count <= size ? count : size;
         while (targets.size() < static_cast<size_t>(count)) {
@@ -951,7 +996,7 @@ Status RedisSets::SRandmember(const Slice& key, int32_t count,
       std::sort(targets.begin(), targets.end());
 
       int32_t cur_index = 0, idx = 0;
-      SetsMemberKey sets_member_key(key, version, Slice());
+      SetsMemberKey sets_member_key(data_owner, version, Slice());
       auto iter = db_->NewIterator(default_read_options_, handles_[1]);
       for (iter->Seek(sets_member_key.Encode());
            iter->Valid() && cur_index < size;
@@ -994,8 +1039,9 @@ Status RedisSets::SRem(const Slice& key,
       int32_t cnt = 0;
       std::string member_value;
       version = parsed_sets_meta_value.version();
+      Slice data_owner = parsed_sets_meta_value.data_owner(key);
       for (const auto& member : members) {
-        SetsMemberKey sets_member_key(key, version, member);
+        SetsMemberKey sets_member_key(data_owner, version, member);
         s = db_->Get(default_read_options_, handles_[1],
                 sets_member_key.Encode(), &member_value);
         if (s.ok()) {
@@ -1043,7 +1089,9 @@ Status RedisSets::SUnion(const std::vector<std::string>& keys,
       ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
       if (!parsed_sets_meta_value.IsStale() &&
         parsed_sets_meta_value.count() != 0) {
-        vaild_sets.push_back({keys[idx], parsed_sets_meta_value.version()});
+        vaild_sets.push_back(
+            {parsed_sets_meta_value.data_owner(keys[idx]).ToString(),
+             parsed_sets_meta_value.version()});
       }
     } else if (!s.IsNotFound()) {
       return s;
@@ -1097,7 +1145,9 @@ Status RedisSets::SUnionstore(const Slice& destination,
       ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
       if (!parsed_sets_meta_value.IsStale() &&
         parsed_sets_meta_value.count() != 0) {
-        vaild_sets.push_back({keys[idx], parsed_sets_meta_value.version()});
+        vaild_sets.push_back(
+            {parsed_sets_meta_value.data_owner(keys[idx]).ToString(),
+             parsed_sets_meta_value.version()});
       }
     } else if (!s.IsNotFound()) {
       return s;
@@ -1130,14 +1180,14 @@ Status RedisSets::SUnionstore(const Slice& destination,
   if (s.ok()) {
     ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
     statistic = parsed_sets_meta_value.count();
-    version = parsed_sets_meta_value.InitialMetaValue();
+    version = parsed_sets_meta_value.InitialMetaValue(version_floor());
     parsed_sets_meta_value.set_count(members.size());
     batch.Put(handles_[0], destination, meta_value);
   } else if (s.IsNotFound()) {
     char str[4];
     EncodeFixed32(str, members.size());
     SetsMetaValue sets_meta_value(Slice(str, sizeof(int32_t)));
-    version = sets_meta_value.UpdateVersion();
+    version = sets_meta_value.UpdateVersion(version_floor());
     batch.Put(handles_[0], destination, sets_meta_value.Encode());
   } else {
     return s;
@@ -1184,6 +1234,7 @@ Status RedisSets::SScan(const Slice& key,
       std::string sub_member;
       std::string start_point;
       int32_t version = parsed_sets_meta_value.version();
+      Slice data_owner = parsed_sets_meta_value.data_owner(key);
       s = GetScanStartPoint(key, pattern, cursor, &start_point);
       if (s.IsNotFound()) {
         cursor = 0;
@@ -1195,8 +1246,8 @@ Status RedisSets::SScan(const Slice& key,
         sub_member = pattern.substr(0, pattern.size() - 1);
       }
 
-      SetsMemberKey sets_member_prefix(key, version, sub_member);
-      SetsMemberKey sets_member_key(key, version, start_point);
+      SetsMemberKey sets_member_prefix(data_owner, version, sub_member);
+      SetsMemberKey sets_member_key(data_owner, version, start_point);
       std::string prefix = sets_member_prefix.Encode().ToString();
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(sets_member_key.Encode());
@@ -1374,7 +1425,7 @@ Status RedisSets::Expire(const Slice& key, int32_t ttl) {
       parsed_sets_meta_value.SetRelativeTimestamp(ttl);
       s = db_->Put(default_write_options_, handles_[0], key, meta_value);
     } else {
-      parsed_sets_meta_value.InitialMetaValue();
+      parsed_sets_meta_value.InitialMetaValue(version_floor());
       s = db_->Put(default_write_options_, handles_[0], key, meta_value);
     }
   }
@@ -1393,7 +1444,7 @@ Status RedisSets::Del(const Slice& key) {
       return Status::NotFound();
     } else {
       uint32_t statistic = parsed_sets_meta_value.count();
-      parsed_sets_meta_value.InitialMetaValue();
+      parsed_sets_meta_value.InitialMetaValue(version_floor());
       s = db_->Put(default_write_options_, handles_[0], key, meta_value);
       UpdateSpecificKeyStatistics(key.ToString(), statistic);
     }
@@ -1461,7 +1512,7 @@ Status RedisSets::Expireat(const Slice& key, int32_t timestamp) {
       if (timestamp > 0) {
         parsed_sets_meta_value.set_timestamp(timestamp);
       } else {
-        parsed_sets_meta_value.InitialMetaValue();
+        parsed_sets_meta_value.InitialMetaValue(version_floor());
       }
       return db_->Put(default_write_options_, handles_[0], key, meta_value);
     }
@@ -1519,6 +1570,226 @@ Status RedisSets::TTL(const Slice& key, int64_t* timestamp) {
   return s;
 }
 
+Status RedisSets::Rename(const Slice& key, const Slice& newkey, bool nx) {
+  std::string meta_value;
+  MultiScopeRecordLock ml(lock_mgr_, {key.ToString(), newkey.ToString()});
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
+  if (parsed_sets_meta_value.IsStale()) {
+    return Status::NotFound("Stale");
+  } else if (parsed_sets_meta_value.count() == 0) {
+    return Status::NotFound();
+  } else if (key == newkey) {
+    return nx ? Status::Busy("newkey exists") : Status::OK();
+  }
+
+  // newkey reads the data keys of the origin from now on, without
+  // moving them, the versions it used before are never used again
+  int32_t last_own_version = 0;
+  std::string new_meta_value;
+  s = db_->Get(default_read_options_, handles_[0], newkey, &new_meta_value);
+  if (s.ok()) {
+    ParsedSetsMetaValue parsed_new_meta_value(&new_meta_value);
+    if (nx && !parsed_new_meta_value.IsStale()
+      && parsed_new_meta_value.count() != 0) {
+      return Status::Busy("newkey exists");
+    }
+    last_own_version = parsed_new_meta_value.last_own_version();
+  } else if (!s.IsNotFound()) {
+    return s;
+  }
+  int32_t version = parsed_sets_meta_value.version();
+  std::string origin = parsed_sets_meta_value.data_owner(key).ToString();
+  new_meta_value = meta_value;
+  ParsedSetsMetaValue parsed_new_meta_value(&new_meta_value);
+  parsed_new_meta_value.SetOrigin(origin, last_own_version);
+
+  rocksdb::WriteBatch batch;
+  batch.Put(handles_[0], newkey, new_meta_value);
+  OriginRefKey origin_ref_key(origin, version, newkey);
+  batch.Put(handles_.back(), origin_ref_key.Encode(), Slice());
+  // key is initialized instead of deleted, so that its new version never
+  // collides with the version read by newkey
+  parsed_sets_meta_value.InitialMetaValue(version_floor());
+  batch.Put(handles_[0], key, meta_value);
+  return db_->Write(default_write_options_, &batch);
+}
+
+Status RedisSets::Copy(const Slice& key, const Slice& newkey,
+                       bool replace) {
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot;
+
+  std::string meta_value;
+  MultiScopeRecordLock ml(lock_mgr_, {key.ToString(), newkey.ToString()});
+  ScopeSnapshot ss(db_, &snapshot);
+  read_options.snapshot = snapshot;
+  Status s = db_->Get(read_options, handles_[0], key, &meta_value);
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
+  if (parsed_sets_meta_value.IsStale()) {
+    return Status::NotFound("Stale");
+  } else if (parsed_sets_meta_value.count() == 0) {
+    return Status::NotFound();
+  } else if (key == newkey) {
+    return Status::OK();
+  }
+
+  uint32_t statistic = 0;
+  int32_t new_version = 0;
+  std::string new_meta_value;
+  s = db_->Get(read_options, handles_[0], newkey, &new_meta_value);
+  if (s.ok()) {
+    ParsedSetsMetaValue parsed_new_meta_value(&new_meta_value);
+    if (!replace && !parsed_new_meta_value.IsStale()
+      && parsed_new_meta_value.count() != 0) {
+      return Status::Busy("newkey exists");
+    }
+    if (!parsed_new_meta_value.IsStale()) {
+      statistic = parsed_new_meta_value.count();
+    }
+    new_version = parsed_new_meta_value.InitialMetaValue(version_floor());
+  } else if (s.IsNotFound()) {
+    char str[4];
+    EncodeFixed32(str, 0);
+    SetsMetaValue sets_meta_value(Slice(str, sizeof(int32_t)));
+    new_version = sets_meta_value.UpdateVersion(version_floor());
+    new_meta_value = sets_meta_value.Encode().ToString();
+  } else {
+    return s;
+  }
+  // The empty meta of the new version goes first, the elements written
+  // by the batches before the last one are invisible until the last
+  // batch counts them in the meta, as Restore does
+  rocksdb::WriteBatch batch;
+  batch.Put(handles_[0], newkey, new_meta_value);
+  int32_t version = parsed_sets_meta_value.version();
+  Slice data_owner = parsed_sets_meta_value.data_owner(key);
+  SetsMemberKey sets_member_key(data_owner, version, Slice());
+  Slice prefix = sets_member_key.Encode();
+  auto iter = db_->NewIterator(read_options, handles_[1]);
+  for (iter->Seek(prefix);
+       iter->Valid() && iter->key().starts_with(prefix);
+       iter->Next()) {
+    ParsedSetsMemberKey parsed_sets_member_key(iter->key());
+    SetsMemberKey new_sets_member_key(newkey, new_version,
+        parsed_sets_member_key.member());
+    batch.Put(handles_[1], new_sets_member_key.Encode(), iter->value());
+    if (batch.GetDataSize() >= kRestoreBatchBytes) {
+      s = db_->Write(default_write_options_, &batch);
+      if (!s.ok()) {
+        delete iter;
+        return s;
+      }
+      batch.Clear();
+    }
+  }
+  s = iter->status();
+  delete iter;
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedSetsMetaValue parsed_new_meta_value(&new_meta_value);
+  parsed_new_meta_value.set_count(parsed_sets_meta_value.count());
+  parsed_new_meta_value.set_timestamp(parsed_sets_meta_value.timestamp());
+  batch.Put(handles_[0], newkey, new_meta_value);
+  s = db_->Write(default_write_options_, &batch);
+  UpdateSpecificKeyStatistics(newkey.ToString(), statistic);
+  return s;
+}
+
+Status RedisSets::Dump(const Slice& key, DumpWriter* writer) {
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot;
+
+  std::string meta_value;
+  ScopeSnapshot ss(db_, &snapshot);
+  read_options.snapshot = snapshot;
+  read_options.fill_cache = false;
+  Status s = db_->Get(read_options, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
+    if (parsed_sets_meta_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (parsed_sets_meta_value.count() == 0) {
+      return Status::NotFound();
+    }
+    writer->Begin(kSets);
+    int32_t version = parsed_sets_meta_value.version();
+    Slice data_owner = parsed_sets_meta_value.data_owner(key);
+    SetsMemberKey sets_member_key(data_owner, version, Slice());
+    Slice prefix = sets_member_key.Encode();
+    auto iter = db_->NewIterator(read_options, handles_[1]);
+    bool within_limit = true;
+    for (iter->Seek(prefix);
+         within_limit && iter->Valid() && iter->key().starts_with(prefix);
+         iter->Next()) {
+      ParsedSetsMemberKey parsed_sets_member_key(iter->key());
+      within_limit = writer->Add(parsed_sets_member_key.member());
+    }
+    s = iter->status();
+    delete iter;
+  }
+  return s;
+}
+
+Status RedisSets::Restore(const Slice& key, DumpReader* reader,
+                          int32_t ttl, bool replace) {
+  int32_t version = 0;
+  std::string meta_value;
+  ScopeRecordLock l(lock_mgr_, key);
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
+    if (!replace && !parsed_sets_meta_value.IsStale()
+      && parsed_sets_meta_value.count() != 0) {
+      return Status::Busy("Target key name already exists");
+    }
+    version = parsed_sets_meta_value.InitialMetaValue(version_floor());
+  } else if (s.IsNotFound()) {
+    char str[4];
+    EncodeFixed32(str, 0);
+    SetsMetaValue sets_meta_value(Slice(str, sizeof(int32_t)));
+    version = sets_meta_value.UpdateVersion(version_floor());
+    meta_value = sets_meta_value.Encode().ToString();
+  } else {
+    return s;
+  }
+
+  // The empty meta of the new version goes first, the elements written
+  // by the batches before the last one are invisible until the last
+  // batch counts them in the meta
+  rocksdb::WriteBatch batch;
+  batch.Put(handles_[0], key, meta_value);
+  ParsedSetsMetaValue parsed_sets_meta_value(&meta_value);
+  Slice member;
+  while (reader->Next(&member)) {
+    SetsMemberKey sets_member_key(key, version, member);
+    batch.Put(handles_[1], sets_member_key.Encode(), Slice());
+    parsed_sets_meta_value.ModifyCount(1);
+    if (batch.GetDataSize() >= kRestoreBatchBytes) {
+      s = db_->Write(default_write_options_, &batch);
+      if (!s.ok()) {
+        return s;
+      }
+      batch.Clear();
+    }
+  }
+  if (!reader->Done()) {
+    return Status::Corruption("Malformed sets dump");
+  }
+  if (ttl > 0) {
+    parsed_sets_meta_value.SetRelativeTimestamp(ttl);
+  }
+  batch.Put(handles_[0], key, meta_value);
+  return db_->Write(default_write_options_, &batch);
+}
+
 void RedisSets::ScanDatabase() {
   rocksdb::ReadOptions iterator_options;
   const rocksdb::Snapshot* snapshot;
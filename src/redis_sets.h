@@ -87,11 +87,17 @@ class RedisSets : public Redis {
   Status Expireat(const Slice& key, int32_t timestamp) override;
   Status Persist(const Slice& key) override;
   Status TTL(const Slice& key, int64_t* timestamp) override;
+  Status Rename(const Slice& key, const Slice& newkey, bool nx) override;
+  Status Copy(const Slice& key, const Slice& newkey, bool replace) override;
+  Status Dump(const Slice& key, DumpWriter* writer) override;
+  Status Restore(const Slice& key, DumpReader* reader,
+                 int32_t ttl, bool replace) override;
 
   // Iterate all data
   void ScanDatabase();
 
  private:
+  // handles_[2] is the origin_cf, it is always the last one
   std::vector<rocksdb::ColumnFamilyHandle*> handles_;
 
   // For compact in time after multiple spop
@@ -0,0 +1,1131 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <set>
+#include <memory>
+#include <limits>
+
+#include "blackwidow/util.h"
+#include "src/redis_streams.h"
+#include "src/streams_filter.h"
+#include "src/scope_record_lock.h"
+#include "src/scope_snapshot.h"
+#include "src/dump_format.h"
+
+namespace blackwidow {
+
+// Trimming more entries uses a range deletion
+static const uint64_t kStreamTrimRangeDeleteNum = 32;
+
+static const uint64_t kMaxStreamIDPart = std::numeric_limits<uint64_t>::max();
+
+static const char* kInvalidStreamID =
+  "Invalid stream ID specified as stream command argument";
+static const char* kStreamIDTooSmall =
+  "The ID specified in XADD is equal or smaller than the target stream top item";
+
+static bool StrToStreamIDPart(const std::string& str, uint64_t* value) {
+  if (str.empty()) {
+    return false;
+  }
+  uint64_t result = 0;
+  for (char c : str) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    uint64_t digit = c - '0';
+    if (result > (kMaxStreamIDPart - digit) / 10) {
+      return false;
+    }
+    result = result * 10 + digit;
+  }
+  *value = result;
+  return true;
+}
+
+// An id is "<ms>-<seq>", or "<ms>" whose sequence number is missing_seq
+static bool ParseStreamID(const std::string& str, uint64_t missing_seq,
+                          StreamID* id) {
+  size_t pos = str.find('-');
+  if (pos == std::string::npos) {
+    id->seq = missing_seq;
+    return StrToStreamIDPart(str, &id->ms);
+  }
+  return StrToStreamIDPart(str.substr(0, pos), &id->ms)
+    && StrToStreamIDPart(str.substr(pos + 1), &id->seq);
+}
+
+// "-" and "+" are the smallest and the greatest ids, a "(" prefix makes
+// the bound exclusive, *is_empty is set when nothing is beyond it
+static bool ParseRangeBound(const std::string& str, bool is_start,
+                            StreamID* id, bool* is_empty) {
+  *is_empty = false;
+  if (str == "-") {
+    *id = StreamID(0, 0);
+    return true;
+  } else if (str == "+") {
+    *id = StreamID(kMaxStreamIDPart, kMaxStreamIDPart);
+    return true;
+  }
+  bool exclusive = !str.empty() && str[0] == '(';
+  if (!ParseStreamID(exclusive ? str.substr(1) : str,
+        is_start ? 0 : kMaxStreamIDPart, id)) {
+    return false;
+  }
+  if (exclusive && is_start) {
+    if (id->seq != kMaxStreamIDPart) {
+      id->seq++;
+    } else if (id->ms != kMaxStreamIDPart) {
+      *id = StreamID(id->ms + 1, 0);
+    } else {
+      *is_empty = true;
+    }
+  } else if (exclusive) {
+    if (id->seq != 0) {
+      id->seq--;
+    } else if (id->ms != 0) {
+      *id = StreamID(id->ms - 1, kMaxStreamIDPart);
+    } else {
+      *is_empty = true;
+    }
+  }
+  return true;
+}
+
+// The id of a new entry is given as "<ms>-<seq>", or generated for "*"
+// and "<ms>-*", it must be greater than the last id of the stream
+static Status GenerateStreamID(const std::string& str,
+                               const StreamID& last_id, StreamID* id) {
+  if (str == "*") {
+    uint64_t now_ms = rocksdb::Env::Default()->NowMicros() / 1000;
+    if (now_ms > last_id.ms) {
+      *id = StreamID(now_ms, 0);
+    } else if (last_id.seq != kMaxStreamIDPart) {
+      *id = StreamID(last_id.ms, last_id.seq + 1);
+    } else if (last_id.ms != kMaxStreamIDPart) {
+      *id = StreamID(last_id.ms + 1, 0);
+    } else {
+      return Status::InvalidArgument(kStreamIDTooSmall);
+    }
+    return Status::OK();
+  }
+
+  if (str.size() > 2 && str.compare(str.size() - 2, 2, "-*") == 0) {
+    if (!StrToStreamIDPart(str.substr(0, str.size() - 2), &id->ms)) {
+      return Status::InvalidArgument(kInvalidStreamID);
+    }
+    if (id->ms > last_id.ms) {
+      id->seq = 0;
+    } else if (id->ms == last_id.ms && last_id.seq != kMaxStreamIDPart) {
+      id->seq = last_id.seq + 1;
+    } else {
+      return Status::InvalidArgument(kStreamIDTooSmall);
+    }
+  } else if (!ParseStreamID(str, 0, id)) {
+    return Status::InvalidArgument(kInvalidStreamID);
+  }
+  if (*id == StreamID(0, 0)) {
+    return Status::InvalidArgument(
+        "The ID specified in XADD must be greater than 0-0");
+  } else if (!(last_id < *id)) {
+    return Status::InvalidArgument(kStreamIDTooSmall);
+  }
+  return Status::OK();
+}
+
+RedisStreams::RedisStreams(BlackWidow* const bw, const DataType& type)
+    : Redis(bw, type) {
+}
+
+RedisStreams::~RedisStreams() {
+  std::vector<rocksdb::ColumnFamilyHandle*> tmp_handles = handles_;
+  handles_.clear();
+  for (auto handle : tmp_handles) {
+    delete handle;
+  }
+}
+
+Status RedisStreams::Open(const BlackwidowOptions& bw_options,
+                          const std::string& db_path) {
+  statistics_store_->SetCapacity(bw_options.statistics_max_size);
+  small_compaction_threshold_ = bw_options.small_compaction_threshold;
+
+  rocksdb::Options ops(bw_options.options);
+  Status s;
+  // read-only and secondary instance can not create column family,
+  // it must have been created by the primary instance
+  if (bw_options.open_mode == kOpenReadWrite) {
+    s = rocksdb::DB::Open(ops, db_path, &db_);
+  }
+  if (bw_options.open_mode == kOpenReadWrite && s.ok()) {
+    // Create column family
+    rocksdb::ColumnFamilyHandle* cf;
+    s = db_->CreateColumnFamily(rocksdb::ColumnFamilyOptions(),
+        "data_cf", &cf);
+    if (!s.ok()) {
+      return s;
+    }
+    // Close DB
+    delete cf;
+    delete db_;
+  }
+
+  // Open
+  rocksdb::DBOptions db_ops(bw_options.options);
+  db_ops.create_missing_column_families = true;
+  rocksdb::ColumnFamilyOptions meta_cf_ops(bw_options.options);
+  rocksdb::ColumnFamilyOptions data_cf_ops(bw_options.options);
+  meta_cf_ops.compaction_filter_factory =
+    std::make_shared<StreamsMetaFilterFactory>();
+  data_cf_ops.compaction_filter_factory =
+    std::make_shared<StreamsDataFilterFactory>(&db_, &handles_);
+
+  rocksdb::BlockBasedTableOptions table_ops(bw_options.table_options);
+  rocksdb::BlockBasedTableOptions meta_cf_table_ops(table_ops);
+  rocksdb::BlockBasedTableOptions data_cf_table_ops(table_ops);
+  if (!bw_options.share_block_cache && bw_options.block_cache_size > 0) {
+    meta_cf_table_ops.block_cache =
+      rocksdb::NewLRUCache(bw_options.block_cache_size);
+    data_cf_table_ops.block_cache =
+      rocksdb::NewLRUCache(bw_options.block_cache_size);
+  }
+  // tune every column family for its access pattern
+  ApplyColumnFamilyProfile(bw_options.meta_profile,
+      &meta_cf_ops, &meta_cf_table_ops);
+  ApplyColumnFamilyProfile(bw_options.streams_data_profile,
+      &data_cf_ops, &data_cf_table_ops);
+  meta_cf_ops.table_factory.reset(
+      rocksdb::NewBlockBasedTableFactory(meta_cf_table_ops));
+  data_cf_ops.table_factory.reset(
+      rocksdb::NewBlockBasedTableFactory(data_cf_table_ops));
+
+  // the entries of origin_cf are few and read along with the meta
+  rocksdb::ColumnFamilyOptions origin_cf_ops(bw_options.options);
+  origin_cf_ops.compaction_filter_factory =
+    std::make_shared<StreamsOriginFilterFactory>(&db_, &handles_);
+  origin_cf_ops.table_factory = meta_cf_ops.table_factory;
+  origin_cf_ops.cf_paths = meta_cf_ops.cf_paths;
+
+  std::vector<rocksdb::ColumnFamilyDescriptor> column_families;
+  // Meta CF
+  column_families.push_back(rocksdb::ColumnFamilyDescriptor(
+      rocksdb::kDefaultColumnFamilyName, meta_cf_ops));
+  // Data CF
+  column_families.push_back(rocksdb::ColumnFamilyDescriptor(
+      "data_cf", data_cf_ops));
+  // Origin CF
+  column_families.push_back(rocksdb::ColumnFamilyDescriptor(
+      "origin_cf", origin_cf_ops));
+  return OpenDB(bw_options, db_ops, db_path, column_families, &handles_);
+}
+
+Status RedisStreams::CompactRange(const rocksdb::Slice* begin,
+                                  const rocksdb::Slice* end,
+                                  const ColumnFamilyType& type) {
+  if (type == kMeta || type == kMetaAndData) {
+    db_->CompactRange(default_compact_range_options_, handles_[0], begin, end);
+  }
+  if (type == kData || type == kMetaAndData) {
+    db_->CompactRange(default_compact_range_options_, handles_[1], begin, end);
+  }
+  // origin_cf is compacted along with the whole db
+  if (type == kMetaAndData) {
+    db_->CompactRange(default_compact_range_options_,
+        handles_[2], nullptr, nullptr);
+  }
+  return Status::OK();
+}
+
+Status RedisStreams::GetProperty(const std::string& property, uint64_t* out) {
+  std::string value;
+  db_->GetProperty(handles_[0], property, &value);
+  *out = std::strtoull(value.c_str(), NULL, 10);
+  db_->GetProperty(handles_[1], property, &value);
+  *out += std::strtoull(value.c_str(), NULL, 10);
+  return Status::OK();
+}
+
+Status RedisStreams::ScanKeyNum(KeyInfo* key_info) {
+  uint64_t keys = 0;
+  uint64_t expires = 0;
+  uint64_t ttl_sum = 0;
+  uint64_t invaild_keys = 0;
+
+  rocksdb::ReadOptions iterator_options;
+  const rocksdb::Snapshot* snapshot;
+  ScopeSnapshot ss(db_, &snapshot);
+  iterator_options.snapshot = snapshot;
+  iterator_options.fill_cache = false;
+
+  int64_t curtime;
+  rocksdb::Env::Default()->GetCurrentTime(&curtime);
+
+  rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
+  for (iter->SeekToFirst();
+       iter->Valid();
+       iter->Next()) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(iter->value());
+    if (parsed_streams_meta_value.IsStale()
+      || parsed_streams_meta_value.count() == 0) {
+      invaild_keys++;
+    } else {
+      keys++;
+      if (!parsed_streams_meta_value.IsPermanentSurvival()) {
+        expires++;
+        ttl_sum += parsed_streams_meta_value.timestamp() - curtime;
+      }
+    }
+  }
+  delete iter;
+
+  key_info->keys = keys;
+  key_info->expires = expires;
+  key_info->avg_ttl = (expires != 0) ? ttl_sum / expires : 0;
+  key_info->invaild_keys = invaild_keys;
+  return Status::OK();
+}
+
+Status RedisStreams::ScanKeys(const std::string& pattern,
+                              std::vector<std::string>* keys) {
+  std::string key;
+  rocksdb::ReadOptions iterator_options;
+  const rocksdb::Snapshot* snapshot;
+  ScopeSnapshot ss(db_, &snapshot);
+  iterator_options.snapshot = snapshot;
+  iterator_options.fill_cache = false;
+
+  rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
+  for (iter->SeekToFirst();
+       iter->Valid();
+       iter->Next()) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(iter->value());
+    if (!parsed_streams_meta_value.IsStale()
+      && parsed_streams_meta_value.count() != 0) {
+      key = iter->key().ToString();
+      if (StringMatch(pattern.data(),
+            pattern.size(), key.data(), key.size(), 0)) {
+        keys->push_back(key);
+      }
+    }
+  }
+  delete iter;
+  return Status::OK();
+}
+
+Status RedisStreams::PKPatternMatchDel(const std::string& pattern,
+                                       int32_t* ret) {
+  rocksdb::ReadOptions iterator_options;
+  const rocksdb::Snapshot* snapshot;
+  ScopeSnapshot ss(db_, &snapshot);
+  iterator_options.snapshot = snapshot;
+  iterator_options.fill_cache = false;
+
+  std::string key;
+  std::string meta_value;
+  int32_t total_delete = 0;
+  Status s;
+  rocksdb::WriteBatch batch;
+  rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[0]);
+  iter->SeekToFirst();
+  while (iter->Valid()) {
+    key = iter->key().ToString();
+    meta_value = iter->value().ToString();
+    ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+    if (!parsed_streams_meta_value.IsStale()
+      && parsed_streams_meta_value.count()
+      && StringMatch(pattern.data(), pattern.size(), key.data(), key.size(), 0)) {
+      parsed_streams_meta_value.InitialMetaValue(version_floor());
+      batch.Put(handles_[0], key, meta_value);
+    }
+    if (static_cast<size_t>(batch.Count()) >= BATCH_DELETE_LIMIT) {
+      s = db_->Write(default_write_options_, &batch);
+      if (s.ok()) {
+        total_delete += batch.Count();
+        batch.Clear();
+      } else {
+        *ret = total_delete;
+        return s;
+      }
+    }
+    iter->Next();
+  }
+  if (batch.Count()) {
+    s = db_->Write(default_write_options_, &batch);
+    if (s.ok()) {
+      total_delete += batch.Count();
+      batch.Clear();
+    }
+  }
+
+  *ret = total_delete;
+  return s;
+}
+
+Status RedisStreams::XAdd(const Slice& key, const std::string& id,
+                          const std::vector<FieldValue>& fvs,
+                          StreamID* added_id) {
+  if (fvs.empty()) {
+    return Status::InvalidArgument("An entry needs at least one field");
+  }
+  rocksdb::WriteBatch batch;
+  ScopeRecordLock l(lock_mgr_, key);
+
+  int32_t version = 0;
+  std::string meta_value;
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.IsNotFound()) {
+    char str[8];
+    EncodeFixed64(str, 0);
+    StreamsMetaValue streams_meta_value(Slice(str, sizeof(uint64_t)));
+    streams_meta_value.UpdateVersion(version_floor());
+    meta_value = streams_meta_value.Encode().ToString();
+  } else if (!s.ok()) {
+    return s;
+  }
+  ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+  if (parsed_streams_meta_value.IsStale()) {
+    version = parsed_streams_meta_value.InitialMetaValue(version_floor());
+  } else if (parsed_streams_meta_value.count() == 0) {
+    // The stream emptied by XDel or XTrim keeps its last id, the new ids
+    // still have to be greater
+    version = parsed_streams_meta_value.UpdateVersion(version_floor());
+  } else {
+    version = parsed_streams_meta_value.version();
+  }
+
+  StreamID last_id(parsed_streams_meta_value.last_id_ms(),
+                   parsed_streams_meta_value.last_id_seq());
+  StreamID new_id;
+  s = GenerateStreamID(id, last_id, &new_id);
+  if (!s.ok()) {
+    return s;
+  }
+  std::string entry_value;
+  EncodeStreamEntryValue(fvs, &entry_value);
+  Slice data_owner = parsed_streams_meta_value.data_owner(key);
+  StreamsDataKey streams_data_key(data_owner, version, new_id);
+  batch.Put(handles_[1], streams_data_key.Encode(), entry_value);
+  parsed_streams_meta_value.ModifyCount(1);
+  parsed_streams_meta_value.set_last_id(new_id.ms, new_id.seq);
+  batch.Put(handles_[0], key, meta_value);
+  s = db_->Write(default_write_options_, &batch);
+  if (s.ok()) {
+    *added_id = new_id;
+  }
+  return s;
+}
+
+Status RedisStreams::XLen(const Slice& key, uint64_t* len) {
+  *len = 0;
+  std::string meta_value;
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+    if (parsed_streams_meta_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (parsed_streams_meta_value.count() == 0) {
+      return Status::NotFound();
+    } else {
+      *len = parsed_streams_meta_value.count();
+    }
+  }
+  return s;
+}
+
+Status RedisStreams::XRange(const Slice& key, const std::string& start,
+                            const std::string& end, int64_t count,
+                            std::vector<StreamEntry>* entries) {
+  return Range(key, start, end, count, false, entries);
+}
+
+Status RedisStreams::XRevrange(const Slice& key, const std::string& end,
+                               const std::string& start, int64_t count,
+                               std::vector<StreamEntry>* entries) {
+  return Range(key, start, end, count, true, entries);
+}
+
+Status RedisStreams::Range(const Slice& key, const std::string& start,
+                           const std::string& end, int64_t count,
+                           bool reverse, std::vector<StreamEntry>* entries) {
+  entries->clear();
+  StreamID start_id, end_id;
+  bool start_empty, end_empty;
+  if (!ParseRangeBound(start, true, &start_id, &start_empty)
+    || !ParseRangeBound(end, false, &end_id, &end_empty)) {
+    return Status::InvalidArgument(kInvalidStreamID);
+  }
+
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot;
+
+  std::string meta_value;
+  ScopeSnapshot ss(db_, &snapshot);
+  read_options.snapshot = snapshot;
+  Status s = db_->Get(read_options, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+    if (parsed_streams_meta_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (parsed_streams_meta_value.count() == 0) {
+      return Status::NotFound();
+    } else if (start_empty || end_empty || end_id < start_id) {
+      return Status::OK();
+    }
+
+    // A seek to one bound, then a scan until the other bound or count
+    int32_t version = parsed_streams_meta_value.version();
+    Slice data_owner = parsed_streams_meta_value.data_owner(key);
+    BaseDataKey prefix_key(data_owner, version, Slice());
+    Slice prefix = prefix_key.Encode();
+    StreamsDataKey start_data_key(data_owner, version,
+        reverse ? end_id : start_id);
+    rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
+    if (reverse) {
+      iter->SeekForPrev(start_data_key.Encode());
+    } else {
+      iter->Seek(start_data_key.Encode());
+    }
+    for (; iter->Valid() && iter->key().starts_with(prefix)
+           && (count <= 0 || static_cast<int64_t>(entries->size()) < count);
+         reverse ? iter->Prev() : iter->Next()) {
+      ParsedStreamsDataKey parsed_streams_data_key(iter->key());
+      StreamEntry entry;
+      entry.id = parsed_streams_data_key.id();
+      if (reverse ? entry.id < start_id : end_id < entry.id) {
+        break;
+      }
+      if (!DecodeStreamEntryValue(iter->value(), &entry.fvs)) {
+        s = Status::Corruption("Malformed stream entry");
+        break;
+      }
+      entries->push_back(entry);
+    }
+    if (s.ok()) {
+      s = iter->status();
+    }
+    delete iter;
+  }
+  return s;
+}
+
+Status RedisStreams::XDel(const Slice& key,
+                          const std::vector<std::string>& ids,
+                          int32_t* ret) {
+  *ret = 0;
+  std::set<StreamID> unique_ids;
+  for (const auto& id : ids) {
+    StreamID stream_id;
+    if (!ParseStreamID(id, 0, &stream_id)) {
+      return Status::InvalidArgument(kInvalidStreamID);
+    }
+    unique_ids.insert(stream_id);
+  }
+
+  uint32_t statistic = 0;
+  rocksdb::WriteBatch batch;
+  ScopeRecordLock l(lock_mgr_, key);
+  std::string meta_value;
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+    if (parsed_streams_meta_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (parsed_streams_meta_value.count() == 0) {
+      return Status::NotFound();
+    } else {
+      int32_t cnt = 0;
+      std::string entry_value;
+      int32_t version = parsed_streams_meta_value.version();
+      Slice data_owner = parsed_streams_meta_value.data_owner(key);
+      for (const auto& stream_id : unique_ids) {
+        StreamsDataKey streams_data_key(data_owner, version, stream_id);
+        s = db_->Get(default_read_options_, handles_[1],
+            streams_data_key.Encode(), &entry_value);
+        if (s.ok()) {
+          cnt++;
+          statistic++;
+          batch.Delete(handles_[1], streams_data_key.Encode());
+        } else if (!s.IsNotFound()) {
+          return s;
+        }
+      }
+      *ret = cnt;
+      if (cnt == 0) {
+        return Status::OK();
+      }
+      parsed_streams_meta_value.ModifyCount(-cnt);
+      batch.Put(handles_[0], key, meta_value);
+    }
+  } else {
+    return s;
+  }
+  s = db_->Write(default_write_options_, &batch);
+  UpdateSpecificKeyStatistics(key.ToString(), statistic);
+  return s;
+}
+
+Status RedisStreams::XTrim(const Slice& key, uint64_t maxlen, int64_t* ret) {
+  return TrimStream(key, maxlen,
+      StreamID(kMaxStreamIDPart, kMaxStreamIDPart), ret);
+}
+
+Status RedisStreams::XTrimMinid(const Slice& key, const std::string& min_id,
+                                int64_t* ret) {
+  *ret = 0;
+  StreamID id;
+  if (!ParseStreamID(min_id, 0, &id)) {
+    return Status::InvalidArgument(kInvalidStreamID);
+  }
+  // The entries before min_id are the ones up to its predecessor
+  if (id.seq != 0) {
+    id.seq--;
+  } else if (id.ms != 0) {
+    id = StreamID(id.ms - 1, kMaxStreamIDPart);
+  } else {
+    std::string meta_value;
+    Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+    if (s.ok()) {
+      ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+      if (parsed_streams_meta_value.IsStale()) {
+        return Status::NotFound("Stale");
+      } else if (parsed_streams_meta_value.count() == 0) {
+        return Status::NotFound();
+      }
+    }
+    return s;
+  }
+  return TrimStream(key, 0, id, ret);
+}
+
+Status RedisStreams::TrimStream(const Slice& key, uint64_t maxlen,
+                                const StreamID& max_trimmed_id,
+                                int64_t* ret) {
+  *ret = 0;
+  uint32_t statistic = 0;
+  rocksdb::WriteBatch batch;
+  ScopeRecordLock l(lock_mgr_, key);
+  std::string meta_value;
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+  if (parsed_streams_meta_value.IsStale()) {
+    return Status::NotFound("Stale");
+  } else if (parsed_streams_meta_value.count() == 0) {
+    return Status::NotFound();
+  } else if (parsed_streams_meta_value.count() <= maxlen) {
+    return Status::OK();
+  }
+
+  // The oldest entries are the first ones of the version, a seek to
+  // the version and a scan until the first kept entry
+  uint64_t evict_limit = parsed_streams_meta_value.count() - maxlen;
+  int32_t version = parsed_streams_meta_value.version();
+  Slice data_owner = parsed_streams_meta_value.data_owner(key);
+  BaseDataKey prefix_key(data_owner, version, Slice());
+  Slice prefix = prefix_key.Encode();
+  rocksdb::ReadOptions iterator_options;
+  iterator_options.fill_cache = false;
+  rocksdb::Iterator* iter = db_->NewIterator(iterator_options, handles_[1]);
+  uint64_t evict_num = 0;
+  std::vector<std::string> evicted_keys;
+  for (iter->Seek(prefix);
+       iter->Valid() && iter->key().starts_with(prefix)
+         && evict_num < evict_limit;
+       iter->Next()) {
+    ParsedStreamsDataKey parsed_streams_data_key(iter->key());
+    if (max_trimmed_id < parsed_streams_data_key.id()) {
+      break;
+    }
+    if (evict_num < kStreamTrimRangeDeleteNum) {
+      evicted_keys.push_back(iter->key().ToString());
+    }
+    evict_num++;
+  }
+  // A long trimmed range is covered by one range tombstone, which ends
+  // at the first kept entry, or behind the greatest id of the version
+  std::string end_key;
+  if (evict_num > kStreamTrimRangeDeleteNum) {
+    if (iter->Valid() && iter->key().starts_with(prefix)) {
+      end_key = iter->key().ToString();
+    } else {
+      StreamsDataKey last_data_key(data_owner, version,
+          StreamID(kMaxStreamIDPart, kMaxStreamIDPart));
+      end_key = last_data_key.Encode().ToString();
+      end_key.push_back('\0');
+    }
+  }
+  s = iter->status();
+  delete iter;
+  if (!s.ok()) {
+    return s;
+  } else if (evict_num == 0) {
+    return Status::OK();
+  }
+
+  if (evict_num > kStreamTrimRangeDeleteNum) {
+    batch.DeleteRange(handles_[1], evicted_keys.front(), end_key);
+  } else {
+    for (const auto& evicted_key : evicted_keys) {
+      statistic++;
+      batch.Delete(handles_[1], evicted_key);
+    }
+  }
+  parsed_streams_meta_value.ModifyCount(-evict_num);
+  batch.Put(handles_[0], key, meta_value);
+  s = db_->Write(default_write_options_, &batch);
+  UpdateSpecificKeyStatistics(key.ToString(), statistic);
+  if (s.ok()) {
+    *ret = evict_num;
+  }
+  return s;
+}
+
+Status RedisStreams::Expire(const Slice& key, int32_t ttl) {
+  std::string meta_value;
+  ScopeRecordLock l(lock_mgr_, key);
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+    if (parsed_streams_meta_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (parsed_streams_meta_value.count() == 0) {
+      return Status::NotFound();
+    }
+
+    if (ttl > 0) {
+      parsed_streams_meta_value.SetRelativeTimestamp(ttl);
+      s = db_->Put(default_write_options_, handles_[0], key, meta_value);
+    } else {
+      parsed_streams_meta_value.InitialMetaValue(version_floor());
+      s = db_->Put(default_write_options_, handles_[0], key, meta_value);
+    }
+  }
+  return s;
+}
+
+Status RedisStreams::Del(const Slice& key) {
+  std::string meta_value;
+  ScopeRecordLock l(lock_mgr_, key);
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+    if (parsed_streams_meta_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (parsed_streams_meta_value.count() == 0) {
+      return Status::NotFound();
+    } else {
+      uint32_t statistic = parsed_streams_meta_value.count();
+      parsed_streams_meta_value.InitialMetaValue(version_floor());
+      s = db_->Put(default_write_options_, handles_[0], key, meta_value);
+      UpdateSpecificKeyStatistics(key.ToString(), statistic);
+    }
+  }
+  return s;
+}
+
+bool RedisStreams::Scan(const std::string& start_key,
+                        const std::string& pattern,
+                        std::vector<std::string>* keys,
+                        int64_t* count,
+                        std::string* next_key) {
+  std::string meta_key;
+  bool is_finish = true;
+  rocksdb::ReadOptions iterator_options;
+  const rocksdb::Snapshot* snapshot;
+  ScopeSnapshot ss(db_, &snapshot);
+  iterator_options.snapshot = snapshot;
+  iterator_options.fill_cache = false;
+
+  rocksdb::Iterator* it = db_->NewIterator(iterator_options, handles_[0]);
+
+  it->Seek(start_key);
+  while (it->Valid() && (*count) > 0) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(it->value());
+    if (parsed_streams_meta_value.IsStale()
+      || parsed_streams_meta_value.count() == 0) {
+      it->Next();
+      continue;
+    } else {
+      meta_key = it->key().ToString();
+      if (StringMatch(pattern.data(), pattern.size(),
+                         meta_key.data(), meta_key.size(), 0)) {
+        keys->push_back(meta_key);
+      }
+      (*count)--;
+      it->Next();
+    }
+  }
+
+  std::string prefix = isTailWildcard(pattern) ?
+    pattern.substr(0, pattern.size() - 1) : "";
+  if (it->Valid()
+    && (it->key().compare(prefix) <= 0 || it->key().starts_with(prefix))) {
+    *next_key = it->key().ToString();
+    is_finish = false;
+  } else {
+    *next_key = "";
+  }
+  delete it;
+  return is_finish;
+}
+
+Status RedisStreams::Expireat(const Slice& key, int32_t timestamp) {
+  std::string meta_value;
+  ScopeRecordLock l(lock_mgr_, key);
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+    if (parsed_streams_meta_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (parsed_streams_meta_value.count() == 0) {
+      return Status::NotFound();
+    } else {
+      if (timestamp > 0) {
+        parsed_streams_meta_value.set_timestamp(timestamp);
+      } else {
+        parsed_streams_meta_value.InitialMetaValue(version_floor());
+      }
+      return db_->Put(default_write_options_, handles_[0], key, meta_value);
+    }
+  }
+  return s;
+}
+
+Status RedisStreams::Persist(const Slice& key) {
+  std::string meta_value;
+  ScopeRecordLock l(lock_mgr_, key);
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+    if (parsed_streams_meta_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (parsed_streams_meta_value.count() == 0) {
+      return Status::NotFound();
+    } else {
+      int32_t timestamp = parsed_streams_meta_value.timestamp();
+      if (timestamp == 0) {
+        return Status::NotFound("Not have an associated timeout");
+      } else {
+        parsed_streams_meta_value.set_timestamp(0);
+        return db_->Put(default_write_options_, handles_[0], key, meta_value);
+      }
+    }
+  }
+  return s;
+}
+
+Status RedisStreams::TTL(const Slice& key, int64_t* timestamp) {
+  std::string meta_value;
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+    if (parsed_streams_meta_value.IsStale()) {
+      *timestamp = -2;
+      return Status::NotFound("Stale");
+    } else if (parsed_streams_meta_value.count() == 0) {
+      *timestamp = -2;
+      return Status::NotFound();
+    } else {
+      *timestamp = parsed_streams_meta_value.timestamp();
+      if (*timestamp == 0) {
+        *timestamp = -1;
+      } else {
+        int64_t curtime;
+        rocksdb::Env::Default()->GetCurrentTime(&curtime);
+        *timestamp = *timestamp - curtime >= 0 ? *timestamp - curtime : -2;
+      }
+    }
+  } else if (s.IsNotFound()) {
+    *timestamp = -2;
+  }
+  return s;
+}
+
+Status RedisStreams::Rename(const Slice& key, const Slice& newkey, bool nx) {
+  std::string meta_value;
+  MultiScopeRecordLock ml(lock_mgr_, {key.ToString(), newkey.ToString()});
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+  if (parsed_streams_meta_value.IsStale()) {
+    return Status::NotFound("Stale");
+  } else if (parsed_streams_meta_value.count() == 0) {
+    return Status::NotFound();
+  } else if (key == newkey) {
+    return nx ? Status::Busy("newkey exists") : Status::OK();
+  }
+
+  // newkey reads the data keys of the origin from now on, without
+  // moving them, the versions it used before are never used again
+  int32_t last_own_version = 0;
+  std::string new_meta_value;
+  s = db_->Get(default_read_options_, handles_[0], newkey, &new_meta_value);
+  if (s.ok()) {
+    ParsedStreamsMetaValue parsed_new_meta_value(&new_meta_value);
+    if (nx && !parsed_new_meta_value.IsStale()
+      && parsed_new_meta_value.count() != 0) {
+      return Status::Busy("newkey exists");
+    }
+    last_own_version = parsed_new_meta_value.last_own_version();
+  } else if (!s.IsNotFound()) {
+    return s;
+  }
+  int32_t version = parsed_streams_meta_value.version();
+  std::string origin = parsed_streams_meta_value.data_owner(key).ToString();
+  new_meta_value = meta_value;
+  ParsedStreamsMetaValue parsed_new_meta_value(&new_meta_value);
+  parsed_new_meta_value.SetOrigin(origin, last_own_version);
+
+  rocksdb::WriteBatch batch;
+  batch.Put(handles_[0], newkey, new_meta_value);
+  OriginRefKey origin_ref_key(origin, version, newkey);
+  batch.Put(handles_.back(), origin_ref_key.Encode(), Slice());
+  // key is initialized instead of deleted, so that its new version never
+  // collides with the version read by newkey
+  parsed_streams_meta_value.InitialMetaValue(version_floor());
+  batch.Put(handles_[0], key, meta_value);
+  return db_->Write(default_write_options_, &batch);
+}
+
+Status RedisStreams::Copy(const Slice& key, const Slice& newkey,
+                          bool replace) {
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot;
+
+  std::string meta_value;
+  MultiScopeRecordLock ml(lock_mgr_, {key.ToString(), newkey.ToString()});
+  ScopeSnapshot ss(db_, &snapshot);
+  read_options.snapshot = snapshot;
+  Status s = db_->Get(read_options, handles_[0], key, &meta_value);
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+  if (parsed_streams_meta_value.IsStale()) {
+    return Status::NotFound("Stale");
+  } else if (parsed_streams_meta_value.count() == 0) {
+    return Status::NotFound();
+  } else if (key == newkey) {
+    return Status::OK();
+  }
+
+  uint32_t statistic = 0;
+  int32_t new_version = 0;
+  std::string new_meta_value;
+  s = db_->Get(read_options, handles_[0], newkey, &new_meta_value);
+  if (s.ok()) {
+    ParsedStreamsMetaValue parsed_new_meta_value(&new_meta_value);
+    if (!replace && !parsed_new_meta_value.IsStale()
+      && parsed_new_meta_value.count() != 0) {
+      return Status::Busy("newkey exists");
+    }
+    if (!parsed_new_meta_value.IsStale()) {
+      statistic = parsed_new_meta_value.count();
+    }
+    new_version = parsed_new_meta_value.InitialMetaValue(version_floor());
+  } else if (s.IsNotFound()) {
+    char str[8];
+    EncodeFixed64(str, 0);
+    StreamsMetaValue streams_meta_value(Slice(str, sizeof(uint64_t)));
+    new_version = streams_meta_value.UpdateVersion(version_floor());
+    new_meta_value = streams_meta_value.Encode().ToString();
+  } else {
+    return s;
+  }
+  // The empty meta of the new version goes first, the elements written
+  // by the batches before the last one are invisible until the last
+  // batch counts them in the meta, as Restore does
+  rocksdb::WriteBatch batch;
+  batch.Put(handles_[0], newkey, new_meta_value);
+  int32_t version = parsed_streams_meta_value.version();
+  Slice data_owner = parsed_streams_meta_value.data_owner(key);
+  BaseDataKey prefix_key(data_owner, version, Slice());
+  Slice prefix = prefix_key.Encode();
+  rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
+  for (iter->Seek(prefix);
+       iter->Valid() && iter->key().starts_with(prefix);
+       iter->Next()) {
+    ParsedStreamsDataKey parsed_streams_data_key(iter->key());
+    StreamsDataKey streams_data_key(newkey, new_version,
+        parsed_streams_data_key.id());
+    batch.Put(handles_[1], streams_data_key.Encode(), iter->value());
+    if (batch.GetDataSize() >= kRestoreBatchBytes) {
+      s = db_->Write(default_write_options_, &batch);
+      if (!s.ok()) {
+        delete iter;
+        return s;
+      }
+      batch.Clear();
+    }
+  }
+  s = iter->status();
+  delete iter;
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedStreamsMetaValue parsed_new_meta_value(&new_meta_value);
+  parsed_new_meta_value.set_count(parsed_streams_meta_value.count());
+  parsed_new_meta_value.set_timestamp(parsed_streams_meta_value.timestamp());
+  parsed_new_meta_value.set_last_id(parsed_streams_meta_value.last_id_ms(),
+      parsed_streams_meta_value.last_id_seq());
+  batch.Put(handles_[0], newkey, new_meta_value);
+  s = db_->Write(default_write_options_, &batch);
+  UpdateSpecificKeyStatistics(newkey.ToString(), statistic);
+  return s;
+}
+
+Status RedisStreams::Dump(const Slice& key, DumpWriter* writer) {
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot;
+
+  std::string meta_value;
+  ScopeSnapshot ss(db_, &snapshot);
+  read_options.snapshot = snapshot;
+  read_options.fill_cache = false;
+  Status s = db_->Get(read_options, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+    if (parsed_streams_meta_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (parsed_streams_meta_value.count() == 0) {
+      return Status::NotFound();
+    }
+    writer->Begin(kStreams);
+    int32_t version = parsed_streams_meta_value.version();
+    Slice data_owner = parsed_streams_meta_value.data_owner(key);
+    BaseDataKey prefix_key(data_owner, version, Slice());
+    Slice prefix = prefix_key.Encode();
+    rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
+    bool within_limit = true;
+    std::string element;
+    for (iter->Seek(prefix);
+         within_limit && iter->Valid() && iter->key().starts_with(prefix);
+         iter->Next()) {
+      element.assign(iter->key().data() + iter->key().size() - kStreamIDLength,
+          kStreamIDLength);
+      element.append(iter->value().data(), iter->value().size());
+      within_limit = writer->Add(element);
+    }
+    s = iter->status();
+    delete iter;
+  }
+  return s;
+}
+
+Status RedisStreams::Restore(const Slice& key, DumpReader* reader,
+                             int32_t ttl, bool replace) {
+  int32_t version = 0;
+  std::string meta_value;
+  ScopeRecordLock l(lock_mgr_, key);
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+    if (!replace && !parsed_streams_meta_value.IsStale()
+      && parsed_streams_meta_value.count() != 0) {
+      return Status::Busy("Target key name already exists");
+    }
+    version = parsed_streams_meta_value.InitialMetaValue(version_floor());
+  } else if (s.IsNotFound()) {
+    char str[8];
+    EncodeFixed64(str, 0);
+    StreamsMetaValue streams_meta_value(Slice(str, sizeof(uint64_t)));
+    version = streams_meta_value.UpdateVersion(version_floor());
+    meta_value = streams_meta_value.Encode().ToString();
+  } else {
+    return s;
+  }
+
+  // The empty meta of the new version goes first, the entries written
+  // by the batches before the last one are invisible until the last
+  // batch counts them in the meta
+  rocksdb::WriteBatch batch;
+  batch.Put(handles_[0], key, meta_value);
+  ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+  StreamID last_id;
+  Slice value;
+  while (reader->Next(&value)) {
+    if (value.size() < kStreamIDLength) {
+      return Status::Corruption("Malformed streams dump");
+    }
+    StreamID id = DecodeStreamID(value.data());
+    if (last_id < id) {
+      last_id = id;
+    }
+    StreamsDataKey streams_data_key(key, version, id);
+    batch.Put(handles_[1], streams_data_key.Encode(),
+        Slice(value.data() + kStreamIDLength, value.size() - kStreamIDLength));
+    parsed_streams_meta_value.ModifyCount(1);
+    if (batch.GetDataSize() >= kRestoreBatchBytes) {
+      s = db_->Write(default_write_options_, &batch);
+      if (!s.ok()) {
+        return s;
+      }
+      batch.Clear();
+    }
+  }
+  if (!reader->Done()) {
+    return Status::Corruption("Malformed streams dump");
+  }
+  parsed_streams_meta_value.set_last_id(last_id.ms, last_id.seq);
+  if (ttl > 0) {
+    parsed_streams_meta_value.SetRelativeTimestamp(ttl);
+  }
+  batch.Put(handles_[0], key, meta_value);
+  return db_->Write(default_write_options_, &batch);
+}
+
+void RedisStreams::ScanDatabase() {
+  rocksdb::ReadOptions iterator_options;
+  const rocksdb::Snapshot* snapshot;
+  ScopeSnapshot ss(db_, &snapshot);
+  iterator_options.snapshot = snapshot;
+  iterator_options.fill_cache = false;
+  int32_t current_time = time(NULL);
+
+  printf("\n***************Stream Meta Data***************\n");
+  auto meta_iter = db_->NewIterator(iterator_options, handles_[0]);
+  for (meta_iter->SeekToFirst();
+       meta_iter->Valid();
+       meta_iter->Next()) {
+    ParsedStreamsMetaValue parsed_streams_meta_value(meta_iter->value());
+    int32_t survival_time = 0;
+    if (parsed_streams_meta_value.timestamp() != 0) {
+      survival_time = parsed_streams_meta_value.timestamp() - current_time > 0 ?
+        parsed_streams_meta_value.timestamp() - current_time : -1;
+    }
+
+    printf("[key : %-30s] [count : %-10lu] [last id : %lu-%lu] [timestamp : %-10d] [version : %d] [survival_time : %d]\n",
+           meta_iter->key().ToString().c_str(),
+           parsed_streams_meta_value.count(),
+           parsed_streams_meta_value.last_id_ms(),
+           parsed_streams_meta_value.last_id_seq(),
+           parsed_streams_meta_value.timestamp(),
+           parsed_streams_meta_value.version(),
+           survival_time);
+  }
+  delete meta_iter;
+
+  printf("\n***************Stream Entry Data***************\n");
+  auto data_iter = db_->NewIterator(iterator_options, handles_[1]);
+  std::vector<FieldValue> fvs;
+  for (data_iter->SeekToFirst();
+       data_iter->Valid();
+       data_iter->Next()) {
+    ParsedStreamsDataKey parsed_streams_data_key(data_iter->key());
+    DecodeStreamEntryValue(data_iter->value(), &fvs);
+    printf("[key : %-30s] [id : %-20s] [fields : %-10zu] [version : %d]\n",
+           parsed_streams_data_key.key().ToString().c_str(),
+           parsed_streams_data_key.id().ToString().c_str(),
+           fvs.size(),
+           parsed_streams_data_key.version());
+  }
+  delete data_iter;
+}
+
+}   //  namespace blackwidow
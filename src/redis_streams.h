@@ -0,0 +1,81 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_REDIS_STREAMS_H_
+#define SRC_REDIS_STREAMS_H_
+
+#include <string>
+#include <vector>
+
+#include "src/redis.h"
+
+namespace blackwidow {
+
+class RedisStreams : public Redis {
+ public:
+  RedisStreams(BlackWidow* const bw, const DataType& type);
+  ~RedisStreams();
+
+  // Common Commands
+  Status Open(const BlackwidowOptions& bw_options,
+              const std::string& db_path) override;
+  Status CompactRange(const rocksdb::Slice* begin,
+                      const rocksdb::Slice* end,
+                      const ColumnFamilyType& type = kMetaAndData) override;
+  Status GetProperty(const std::string& property, uint64_t* out) override;
+  Status ScanKeyNum(KeyInfo* key_info) override;
+  Status ScanKeys(const std::string& pattern,
+                  std::vector<std::string>* keys) override;
+  Status PKPatternMatchDel(const std::string& pattern, int32_t* ret) override;
+
+  // Streams Commands
+  Status XAdd(const Slice& key, const std::string& id,
+              const std::vector<FieldValue>& fvs, StreamID* added_id);
+  Status XLen(const Slice& key, uint64_t* len);
+  Status XRange(const Slice& key, const std::string& start,
+                const std::string& end, int64_t count,
+                std::vector<StreamEntry>* entries);
+  Status XRevrange(const Slice& key, const std::string& end,
+                   const std::string& start, int64_t count,
+                   std::vector<StreamEntry>* entries);
+  Status XDel(const Slice& key, const std::vector<std::string>& ids,
+              int32_t* ret);
+  Status XTrim(const Slice& key, uint64_t maxlen, int64_t* ret);
+  Status XTrimMinid(const Slice& key, const std::string& min_id,
+                    int64_t* ret);
+
+  // Keys Commands
+  Status Expire(const Slice& key, int32_t ttl) override;
+  Status Del(const Slice& key) override;
+  bool Scan(const std::string& start_key, const std::string& pattern,
+            std::vector<std::string>* keys,
+            int64_t* count, std::string* next_key) override;
+  Status Expireat(const Slice& key, int32_t timestamp) override;
+  Status Persist(const Slice& key) override;
+  Status TTL(const Slice& key, int64_t* timestamp) override;
+  Status Rename(const Slice& key, const Slice& newkey, bool nx) override;
+  Status Copy(const Slice& key, const Slice& newkey, bool replace) override;
+  Status Dump(const Slice& key, DumpWriter* writer) override;
+  Status Restore(const Slice& key, DumpReader* reader,
+                 int32_t ttl, bool replace) override;
+
+  // Iterate all data
+  void ScanDatabase();
+
+ private:
+  // handles_[2] is the origin_cf, it is always the last one
+  std::vector<rocksdb::ColumnFamilyHandle*> handles_;
+
+  Status Range(const Slice& key, const std::string& start,
+               const std::string& end, int64_t count, bool reverse,
+               std::vector<StreamEntry>* entries);
+  // Delete the oldest entries of the stream down to maxlen entries,
+  // only the entries with ids up to max_trimmed_id
+  Status TrimStream(const Slice& key, uint64_t maxlen,
+                    const StreamID& max_trimmed_id, int64_t* ret);
+};
+
+}  //  namespace blackwidow
+#endif  //  SRC_REDIS_STREAMS_H_
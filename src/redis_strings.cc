@@ -12,8 +12,11 @@
 
 #include "blackwidow/util.h"
 #include "src/strings_filter.h"
+#include "src/strings_ttl_collector.h"
+#include "src/merged_iterator.h"
 #include "src/scope_record_lock.h"
 #include "src/scope_snapshot.h"
+#include "src/dump_format.h"
 
 namespace blackwidow {
 
@@ -21,32 +24,93 @@ RedisStrings::RedisStrings(BlackWidow* const bw, const DataType& type)
     : Redis(bw, type) {
 }
 
+RedisStrings::~RedisStrings() {
+  std::vector<rocksdb::ColumnFamilyHandle*> tmp_handles = handles_;
+  handles_.clear();
+  for (auto handle : tmp_handles) {
+    delete handle;
+  }
+}
+
 Status RedisStrings::Open(const BlackwidowOptions& bw_options,
     const std::string& db_path) {
   rocksdb::Options ops(bw_options.options);
   ops.compaction_filter_factory = std::make_shared<StringsFilterFactory>();
 
-  // use the bloom filter policy to reduce disk reads
   rocksdb::BlockBasedTableOptions table_ops(bw_options.table_options);
   if (!bw_options.share_block_cache && bw_options.block_cache_size > 0) {
     table_ops.block_cache = rocksdb::NewLRUCache(bw_options.block_cache_size);
   }
-  table_ops.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10, true));
+  ApplyColumnFamilyProfile(bw_options.strings_profile, &ops, &table_ops);
   ops.table_factory.reset(rocksdb::NewBlockBasedTableFactory(table_ops));
 
-  return rocksdb::DB::Open(ops, db_path, &db_);
+  if (!bw_options.strings_ttl_cf) {
+    return OpenDB(bw_options, ops, db_path);
+  }
+
+  Status s;
+  // read-only and secondary instance can not create column family,
+  // it must have been created by the primary instance
+  if (bw_options.open_mode == kOpenReadWrite) {
+    s = rocksdb::DB::Open(ops, db_path, &db_);
+  }
+  if (bw_options.open_mode == kOpenReadWrite && s.ok()) {
+    rocksdb::ColumnFamilyHandle* cf;
+    s = db_->CreateColumnFamily(rocksdb::ColumnFamilyOptions(), "ttl_cf", &cf);
+    if (!s.ok()) {
+      return s;
+    }
+    delete cf;
+    delete db_;
+  }
+
+  rocksdb::DBOptions db_ops(ops);
+  rocksdb::ColumnFamilyOptions default_cf_ops(ops);
+  rocksdb::ColumnFamilyOptions ttl_cf_ops(ops);
+  // The entries of ttl_cf expire roughly in write order, FIFO compaction
+  // keeps them in L0 without rewriting, and the size limit must never
+  // drop live entries, DropExpiredFiles deletes the expired files
+  ttl_cf_ops.compaction_style = rocksdb::kCompactionStyleFIFO;
+  // FIFO compaction only supports one path, the first tier
+  if (ttl_cf_ops.cf_paths.size() > 1) {
+    ttl_cf_ops.cf_paths.resize(1);
+  }
+  ttl_cf_ops.compaction_options_fifo.max_table_files_size =
+    std::numeric_limits<uint64_t>::max();
+  // merge the small files flushed recently to bound the L0 file count
+  ttl_cf_ops.compaction_options_fifo.allow_compaction = true;
+  ttl_cf_ops.table_properties_collector_factories.push_back(
+      std::make_shared<StringsTTLCollectorFactory>());
+  db_ops.listeners.push_back(std::make_shared<StringsTTLFlushListener>(bw_));
+
+  std::vector<rocksdb::ColumnFamilyDescriptor> column_families;
+  column_families.push_back(rocksdb::ColumnFamilyDescriptor(
+        rocksdb::kDefaultColumnFamilyName, default_cf_ops));
+  column_families.push_back(rocksdb::ColumnFamilyDescriptor(
+        "ttl_cf", ttl_cf_ops));
+  return OpenDB(bw_options, db_ops, db_path, column_families, &handles_);
 }
 
 Status RedisStrings::CompactRange(const rocksdb::Slice* begin,
                                   const rocksdb::Slice* end,
                                   const ColumnFamilyType& type) {
-  return db_->CompactRange(default_compact_range_options_, begin, end);
+  Status s = db_->CompactRange(default_compact_range_options_, begin, end);
+  // Never rewrite ttl_cf, only drop its expired files
+  if (HasTTLColumnFamily()) {
+    DropExpiredFiles();
+  }
+  return s;
 }
 
 Status RedisStrings::GetProperty(const std::string& property, uint64_t* out) {
   std::string value;
   db_->GetProperty(property, &value);
   *out = std::strtoull(value.c_str(), NULL, 10);
+  if (HasTTLColumnFamily()) {
+    value.clear();
+    db_->GetProperty(handles_[1], property, &value);
+    *out += std::strtoull(value.c_str(), NULL, 10);
+  }
   return Status::OK();
 }
 
@@ -65,9 +129,9 @@ Status RedisStrings::ScanKeyNum(KeyInfo* key_info) {
   int64_t curtime;
   rocksdb::Env::Default()->GetCurrentTime(&curtime);
 
-  // Note: This is a string type and does not need to pass the column family as
-  // a parameter, use the default column family
-  rocksdb::Iterator* iter = db_->NewIterator(iterator_options);
+  // Note: The strings with ttl may live in ttl_cf, the iterator
+  // covers both column families
+  rocksdb::Iterator* iter = NewValueIterator(iterator_options);
   for (iter->SeekToFirst();
        iter->Valid();
        iter->Next()) {
@@ -100,9 +164,9 @@ Status RedisStrings::ScanKeys(const std::string& pattern,
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
 
-  // Note: This is a string type and does not need to pass the column family as
-  // a parameter, use the default column family
-  rocksdb::Iterator* iter = db_->NewIterator(iterator_options);
+  // Note: The strings with ttl may live in ttl_cf, the iterator
+  // covers both column families
+  rocksdb::Iterator* iter = NewValueIterator(iterator_options);
   for (iter->SeekToFirst();
        iter->Valid();
        iter->Next()) {
@@ -130,9 +194,10 @@ Status RedisStrings::PKPatternMatchDel(const std::string& pattern,
   std::string key;
   std::string value;
   int32_t total_delete = 0;
+  int32_t batch_delete = 0;
   Status s;
   rocksdb::WriteBatch batch;
-  rocksdb::Iterator* iter = db_->NewIterator(iterator_options);
+  rocksdb::Iterator* iter = NewValueIterator(iterator_options);
   iter->SeekToFirst();
   while (iter->Valid()) {
     key = iter->key().ToString();
@@ -140,28 +205,32 @@ Status RedisStrings::PKPatternMatchDel(const std::string& pattern,
     ParsedStringsValue parsed_strings_value(&value);
     if (!parsed_strings_value.IsStale()
       && StringMatch(pattern.data(), pattern.size(), key.data(), key.size(), 0)) {
-      batch.Delete(key);
+      BatchDeleteValue(&batch, key);
+      batch_delete++;
     }
     // In order to be more efficient, we use batch deletion here
-    if (static_cast<size_t>(batch.Count()) >= BATCH_DELETE_LIMIT) {
+    if (static_cast<size_t>(batch_delete) >= BATCH_DELETE_LIMIT) {
       s = db_->Write(default_write_options_, &batch);
       if (s.ok()) {
-        total_delete += batch.Count();
+        total_delete += batch_delete;
+        batch_delete = 0;
         batch.Clear();
       } else {
         *ret = total_delete;
+        delete iter;
         return s;
       }
     }
     iter->Next();
   }
-  if (batch.Count()) {
+  if (batch_delete) {
     s = db_->Write(default_write_options_, &batch);
     if (s.ok()) {
-      total_delete += batch.Count();
+      total_delete += batch_delete;
       batch.Clear();
     }
   }
+  delete iter;
 
   *ret = total_delete;
   return s;
@@ -172,13 +241,13 @@ Status RedisStrings::Append(const Slice& key, const Slice& value,
   std::string old_value;
   *ret = 0;
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, &old_value);
+  Status s = GetValue(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
     if (parsed_strings_value.IsStale()) {
       *ret = value.size();
       StringsValue strings_value(value);
-      return db_->Put(default_write_options_, key, strings_value.Encode());
+      return PutValue(key, strings_value.Encode());
     } else {
       int32_t timestamp = parsed_strings_value.timestamp();
       std::string old_user_value = parsed_strings_value.value().ToString();
@@ -186,12 +255,12 @@ Status RedisStrings::Append(const Slice& key, const Slice& value,
       StringsValue strings_value(new_value);
       strings_value.set_timestamp(timestamp);
       *ret = new_value.size();
-      return db_->Put(default_write_options_, key, strings_value.Encode());
+      return PutValue(key, strings_value.Encode());
     }
   } else if (s.IsNotFound()) {
     *ret = value.size();
     StringsValue strings_value(value);
-    return db_->Put(default_write_options_, key, strings_value.Encode());
+    return PutValue(key, strings_value.Encode());
   }
   return s;
 }
@@ -226,7 +295,7 @@ Status RedisStrings::BitCount(const Slice& key,
                               int32_t* ret, bool have_range) {
   *ret = 0;
   std::string value;
-  Status s = db_->Get(default_read_options_, key, &value);
+  Status s = GetValue(default_read_options_, key, &value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&value);
     if (parsed_strings_value.IsStale()) {
@@ -328,7 +397,7 @@ Status RedisStrings::BitOp(BitOpType op,
   std::vector<std::string> src_values;
   for (size_t i = 0; i < src_keys.size(); i++) {
     std::string value;
-    s = db_->Get(default_read_options_, src_keys[i], &value);
+    s = GetValue(default_read_options_, src_keys[i], &value);
     if (s.ok()) {
       ParsedStringsValue parsed_strings_value(&value);
       if (parsed_strings_value.IsStale()) {
@@ -354,44 +423,45 @@ Status RedisStrings::BitOp(BitOpType op,
   StringsValue strings_value(Slice(dest_value.c_str(),
                                    static_cast<size_t>(max_len)));
   ScopeRecordLock l(lock_mgr_, dest_key);
-  return db_->Put(default_write_options_, dest_key, strings_value.Encode());
+  return PutValue(dest_key, strings_value.Encode());
 }
 
 Status RedisStrings::Decrby(const Slice& key, int64_t value, int64_t* ret) {
   std::string old_value;
-  std::string new_value;
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, &old_value);
+  Status s = GetValue(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
     if (parsed_strings_value.IsStale()) {
       *ret = -value;
-      new_value = std::to_string(*ret);
-      StringsValue strings_value(new_value);
-      return db_->Put(default_write_options_, key, strings_value.Encode());
+      StringsTypedValue strings_value(*ret);
+      return PutValue(key, strings_value.Encode());
     } else {
       int32_t timestamp = parsed_strings_value.timestamp();
-      std::string old_user_value = parsed_strings_value.value().ToString();
-      char* end = nullptr;
-      int64_t ival = strtoll(old_user_value.c_str(), &end, 10);
-      if (*end != 0) {
-        return Status::Corruption("Value is not a integer");
+      int64_t ival = 0;
+      if (parsed_strings_value.IsInteger()) {
+        ival = parsed_strings_value.integer_value();
+      } else {
+        std::string old_user_value = parsed_strings_value.value().ToString();
+        char* end = nullptr;
+        ival = strtoll(old_user_value.c_str(), &end, 10);
+        if (*end != 0) {
+          return Status::Corruption("Value is not a integer");
+        }
       }
       if ((value >= 0 && LLONG_MIN + value > ival) ||
           (value < 0 && LLONG_MAX + value < ival)) {
         return Status::InvalidArgument("Overflow");
       }
       *ret = ival - value;
-      new_value = std::to_string(*ret);
-      StringsValue strings_value(new_value);
+      StringsTypedValue strings_value(*ret);
       strings_value.set_timestamp(timestamp);
-      return db_->Put(default_write_options_, key, strings_value.Encode());
+      return PutValue(key, strings_value.Encode());
     }
   } else if (s.IsNotFound()) {
     *ret = -value;
-    new_value = std::to_string(*ret);
-    StringsValue strings_value(new_value);
-    return db_->Put(default_write_options_, key, strings_value.Encode());
+    StringsTypedValue strings_value(*ret);
+    return PutValue(key, strings_value.Encode());
   } else {
     return s;
   }
@@ -399,7 +469,7 @@ Status RedisStrings::Decrby(const Slice& key, int64_t value, int64_t* ret) {
 
 Status RedisStrings::Get(const Slice& key, std::string* value) {
   value->clear();
-  Status s = db_->Get(default_read_options_, key, value);
+  Status s = GetValue(default_read_options_, key, value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(value);
     if (parsed_strings_value.IsStale()) {
@@ -414,7 +484,7 @@ Status RedisStrings::Get(const Slice& key, std::string* value) {
 
 Status RedisStrings::GetBit(const Slice& key, int64_t offset, int32_t* ret) {
   std::string meta_value;
-  Status s = db_->Get(default_read_options_, key, &meta_value);
+  Status s = GetValue(default_read_options_, key, &meta_value);
   if (s.ok() || s.IsNotFound()) {
     std::string data_value;
     if (s.ok()) {
@@ -444,7 +514,7 @@ Status RedisStrings::Getrange(const Slice& key,
                               std::string* ret) {
   *ret = "";
   std::string value;
-  Status s = db_->Get(default_read_options_, key, &value);
+  Status s = GetValue(default_read_options_, key, &value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&value);
     if (parsed_strings_value.IsStale()) {
@@ -480,7 +550,7 @@ Status RedisStrings::Getrange(const Slice& key,
 Status RedisStrings::GetSet(const Slice& key, const Slice& value,
                             std::string* old_value) {
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, old_value);
+  Status s = GetValue(default_read_options_, key, old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(old_value);
     if (parsed_strings_value.IsStale()) {
@@ -492,46 +562,45 @@ Status RedisStrings::GetSet(const Slice& key, const Slice& value,
     return s;
   }
   StringsValue strings_value(value);
-  return db_->Put(default_write_options_, key, strings_value.Encode());
+  return PutValue(key, strings_value.Encode());
 }
 
 Status RedisStrings::Incrby(const Slice& key, int64_t value, int64_t* ret) {
   std::string old_value;
-  std::string new_value;
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, &old_value);
+  Status s = GetValue(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
     if (parsed_strings_value.IsStale()) {
       *ret = value;
-      char buf[32];
-      Int64ToStr(buf, 32, value);
-      StringsValue strings_value(buf);
-      return db_->Put(default_write_options_, key, strings_value.Encode());
+      StringsTypedValue strings_value(value);
+      return PutValue(key, strings_value.Encode());
     } else {
       int32_t timestamp = parsed_strings_value.timestamp();
-      std::string old_user_value = parsed_strings_value.value().ToString();
-      char* end = nullptr;
-      int64_t ival = strtoll(old_user_value.c_str(), &end, 10);
-      if (*end != 0) {
-        return Status::Corruption("Value is not a integer");
+      int64_t ival = 0;
+      if (parsed_strings_value.IsInteger()) {
+        ival = parsed_strings_value.integer_value();
+      } else {
+        std::string old_user_value = parsed_strings_value.value().ToString();
+        char* end = nullptr;
+        ival = strtoll(old_user_value.c_str(), &end, 10);
+        if (*end != 0) {
+          return Status::Corruption("Value is not a integer");
+        }
       }
       if ((value >= 0 && LLONG_MAX - value < ival) ||
           (value < 0 && LLONG_MIN - value > ival)) {
         return Status::InvalidArgument("Overflow");
       }
       *ret = ival + value;
-      new_value = std::to_string(*ret);
-      StringsValue strings_value(new_value);
+      StringsTypedValue strings_value(*ret);
       strings_value.set_timestamp(timestamp);
-      return db_->Put(default_write_options_, key, strings_value.Encode());
+      return PutValue(key, strings_value.Encode());
     }
   } else if (s.IsNotFound()) {
     *ret = value;
-    char buf[32];
-    Int64ToStr(buf, 32, value);
-    StringsValue strings_value(buf);
-    return db_->Put(default_write_options_, key, strings_value.Encode());
+    StringsTypedValue strings_value(value);
+    return PutValue(key, strings_value.Encode());
   } else {
     return s;
   }
@@ -539,42 +608,43 @@ Status RedisStrings::Incrby(const Slice& key, int64_t value, int64_t* ret) {
 
 Status RedisStrings::Incrbyfloat(const Slice& key, const Slice& value,
                                  std::string* ret) {
-  std::string old_value, new_value;
+  std::string old_value;
   long double long_double_by;
   if (StrToLongDouble(value.data(), value.size(), &long_double_by) == -1) {
     return Status::Corruption("Value is not a vaild float");
   }
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, &old_value);
+  Status s = GetValue(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
     if (parsed_strings_value.IsStale()) {
-      LongDoubleToStr(long_double_by, &new_value);
-      *ret = new_value;
-      StringsValue strings_value(new_value);
-      return db_->Put(default_write_options_, key, strings_value.Encode());
+      LongDoubleToStr(long_double_by, ret);
+      return PutFloatValue(key, long_double_by, *ret, 0);
     } else {
       int32_t timestamp = parsed_strings_value.timestamp();
-      std::string old_user_value = parsed_strings_value.value().ToString();
       long double total, old_number;
-      if (StrToLongDouble(old_user_value.data(),
-                          old_user_value.size(), &old_number) == -1) {
-        return Status::Corruption("Value is not a vaild float");
+      if (parsed_strings_value.IsInteger()) {
+        old_number = parsed_strings_value.integer_value();
+      } else if (parsed_strings_value.IsDouble()) {
+        old_number = parsed_strings_value.double_value();
+      } else {
+        std::string old_user_value = parsed_strings_value.value().ToString();
+        if (StrToLongDouble(old_user_value.data(),
+                            old_user_value.size(), &old_number) == -1) {
+          return Status::Corruption("Value is not a vaild float");
+        }
       }
       total = old_number + long_double_by;
+      std::string new_value;
       if (LongDoubleToStr(total, &new_value) == -1) {
         return Status::InvalidArgument("Overflow");
       }
       *ret = new_value;
-      StringsValue strings_value(new_value);
-      strings_value.set_timestamp(timestamp);
-      return db_->Put(default_write_options_, key, strings_value.Encode());
+      return PutFloatValue(key, total, new_value, timestamp);
     }
   } else if (s.IsNotFound()) {
-    LongDoubleToStr(long_double_by, &new_value);
-    *ret = new_value;
-    StringsValue strings_value(new_value);
-    return db_->Put(default_write_options_, key, strings_value.Encode());
+    LongDoubleToStr(long_double_by, ret);
+    return PutFloatValue(key, long_double_by, *ret, 0);
   } else {
     return s;
   }
@@ -591,7 +661,7 @@ Status RedisStrings::MGet(const std::vector<std::string>& keys,
   ScopeSnapshot ss(db_, &snapshot);
   read_options.snapshot = snapshot;
   for (const auto& key : keys) {
-    s = db_->Get(read_options, key, &value);
+    s = GetValue(read_options, key, &value);
     if (s.ok()) {
       ParsedStringsValue parsed_strings_value(&value);
       if (parsed_strings_value.IsStale()) {
@@ -620,7 +690,7 @@ Status RedisStrings::MSet(const std::vector<KeyValue>& kvs) {
   rocksdb::WriteBatch batch;
   for (const auto& kv : kvs) {
     StringsValue strings_value(kv.value);
-    batch.Put(kv.key, strings_value.Encode());
+    BatchPutValue(&batch, kv.key, strings_value.Encode());
   }
   return db_->Write(default_write_options_, &batch);
 }
@@ -632,7 +702,7 @@ Status RedisStrings::MSetnx(const std::vector<KeyValue>& kvs,
   *ret = 0;
   std::string value;
   for (size_t i = 0; i < kvs.size(); i++) {
-    s = db_->Get(default_read_options_, kvs[i].key, &value);
+    s = GetValue(default_read_options_, kvs[i].key, &value);
     if (s.ok()) {
       ParsedStringsValue parsed_strings_value(&value);
       if (!parsed_strings_value.IsStale()) {
@@ -654,7 +724,7 @@ Status RedisStrings::Set(const Slice& key,
                          const Slice& value) {
   StringsValue strings_value(value);
   ScopeRecordLock l(lock_mgr_, key);
-  return db_->Put(default_write_options_, key, strings_value.Encode());
+  return PutValue(key, strings_value.Encode());
 }
 
 Status RedisStrings::Setxx(const Slice& key,
@@ -665,7 +735,7 @@ Status RedisStrings::Setxx(const Slice& key,
   std::string old_value;
   StringsValue strings_value(value);
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, &old_value);
+  Status s = GetValue(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(old_value);
     if (!parsed_strings_value.IsStale()) {
@@ -683,7 +753,7 @@ Status RedisStrings::Setxx(const Slice& key,
     if (ttl > 0) {
       strings_value.SetRelativeTimestamp(ttl);
     }
-    return db_->Put(default_write_options_, key, strings_value.Encode());
+    return PutValue(key, strings_value.Encode());
   }
 }
 
@@ -695,7 +765,7 @@ Status RedisStrings::SetBit(const Slice& key, int64_t offset,
   }
 
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, &meta_value);
+  Status s = GetValue(default_read_options_, key, &meta_value);
   if (s.ok() || s.IsNotFound()) {
     std::string data_value;
     if (s.ok()) {
@@ -727,7 +797,7 @@ Status RedisStrings::SetBit(const Slice& key, int64_t offset,
       data_value.append(1, byte_val);
     }
     StringsValue strings_value(data_value);
-    return  db_->Put(rocksdb::WriteOptions(), key, strings_value.Encode());
+    return  PutValue(key, strings_value.Encode());
   } else {
     return s;
   }
@@ -740,7 +810,7 @@ Status RedisStrings::Setex(const Slice& key, const Slice& value, int32_t ttl) {
   StringsValue strings_value(value);
   strings_value.SetRelativeTimestamp(ttl);
   ScopeRecordLock l(lock_mgr_, key);
-  return db_->Put(default_write_options_, key, strings_value.Encode());
+  return PutValue(key, strings_value.Encode());
 }
 
 Status RedisStrings::Setnx(const Slice& key,
@@ -750,7 +820,7 @@ Status RedisStrings::Setnx(const Slice& key,
   *ret = 0;
   std::string old_value;
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, &old_value);
+  Status s = GetValue(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
     if (parsed_strings_value.IsStale()) {
@@ -758,7 +828,7 @@ Status RedisStrings::Setnx(const Slice& key,
       if (ttl > 0) {
         strings_value.SetRelativeTimestamp(ttl);
       }
-      s = db_->Put(default_write_options_, key, strings_value.Encode());
+      s = PutValue(key, strings_value.Encode());
       if (s.ok()) {
         *ret = 1;
       }
@@ -768,7 +838,7 @@ Status RedisStrings::Setnx(const Slice& key,
     if (ttl > 0) {
       strings_value.SetRelativeTimestamp(ttl);
     }
-    s = db_->Put(default_write_options_, key, strings_value.Encode());
+    s = PutValue(key, strings_value.Encode());
     if (s.ok()) {
       *ret = 1;
     }
@@ -784,7 +854,7 @@ Status RedisStrings::Setvx(const Slice& key,
   *ret = 0;
   std::string old_value;
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, &old_value);
+  Status s = GetValue(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
     if (parsed_strings_value.IsStale()) {
@@ -795,7 +865,7 @@ Status RedisStrings::Setvx(const Slice& key,
         if (ttl > 0) {
           strings_value.SetRelativeTimestamp(ttl);
         }
-        s = db_->Put(default_write_options_, key, strings_value.Encode());
+        s = PutValue(key, strings_value.Encode());
         if (!s.ok()) {
           return s;
         }
@@ -816,7 +886,7 @@ Status RedisStrings::Delvx(const Slice& key, const Slice& value, int32_t* ret) {
   *ret = 0;
   std::string old_value;
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, &old_value);
+  Status s = GetValue(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
     if (parsed_strings_value.IsStale()) {
@@ -825,7 +895,7 @@ Status RedisStrings::Delvx(const Slice& key, const Slice& value, int32_t* ret) {
     } else {
       if (!value.compare(parsed_strings_value.value())) {
         *ret = 1;
-        return db_->Delete(default_write_options_, key);
+        return DeleteValue(key);
       } else {
         *ret = -1;
       }
@@ -845,7 +915,7 @@ Status RedisStrings::Setrange(const Slice& key, int64_t start_offset,
   }
 
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, &old_value);
+  Status s = GetValue(default_read_options_, key, &old_value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&old_value);
     parsed_strings_value.StripSuffix();
@@ -868,13 +938,13 @@ Status RedisStrings::Setrange(const Slice& key, int64_t start_offset,
     }
     *ret = new_value.length();
     StringsValue strings_value(new_value);
-    return db_->Put(default_write_options_, key, strings_value.Encode());
+    return PutValue(key, strings_value.Encode());
   } else if (s.IsNotFound()) {
     std::string tmp(start_offset, '\0');
     new_value = tmp.append(value.data());
     *ret = new_value.length();
     StringsValue strings_value(new_value);
-    return db_->Put(default_write_options_, key, strings_value.Encode());
+    return PutValue(key, strings_value.Encode());
   }
   return s;
 }
@@ -940,7 +1010,7 @@ Status RedisStrings::BitPos(const Slice& key, int32_t bit,
                             int64_t* ret) {
   Status s;
   std::string value;
-  s = db_->Get(default_read_options_, key, &value);
+  s = GetValue(default_read_options_, key, &value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&value);
     if (parsed_strings_value.IsStale()) {
@@ -977,7 +1047,7 @@ Status RedisStrings::BitPos(const Slice& key, int32_t bit,
                             int64_t start_offset, int64_t* ret) {
   Status s;
   std::string value;
-  s = db_->Get(default_read_options_, key, &value);
+  s = GetValue(default_read_options_, key, &value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&value);
     if (parsed_strings_value.IsStale()) {
@@ -1028,7 +1098,7 @@ Status RedisStrings::BitPos(const Slice& key, int32_t bit,
                             int64_t* ret) {
   Status s;
   std::string value;
-  s = db_->Get(default_read_options_, key, &value);
+  s = GetValue(default_read_options_, key, &value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&value);
     if (parsed_strings_value.IsStale()) {
@@ -1083,11 +1153,213 @@ Status RedisStrings::BitPos(const Slice& key, int32_t bit,
   return Status::OK();
 }
 
+// The 64 bits of data from the bit offset on, the bits past the end of
+// data are 0
+static uint64_t GetBitFieldWord(const std::string& data, int64_t offset) {
+  size_t byte = offset >> 3;
+  uint32_t shift = offset & 0x7;
+  uint64_t word = 0;
+  for (size_t idx = byte; idx < byte + 8; ++idx) {
+    word <<= 8;
+    if (idx < data.size()) {
+      word |= static_cast<unsigned char>(data[idx]);
+    }
+  }
+  if (shift != 0 && byte + 8 < data.size()) {
+    word = (word << shift)
+      | (static_cast<unsigned char>(data[byte + 8]) >> (8 - shift));
+  } else {
+    word <<= shift;
+  }
+  return word;
+}
+
+// Stores the low bits bits of value at the bit offset of data, which holds
+// the whole field
+static void SetBitFieldWord(std::string* data, int64_t offset,
+                            uint32_t bits, uint64_t value) {
+  size_t byte = offset >> 3;
+  uint32_t shift = offset & 0x7;
+  uint64_t mask = std::numeric_limits<uint64_t>::max() << (64 - bits);
+  uint64_t word = (GetBitFieldWord(*data, offset) & ~mask)
+    | ((value << (64 - bits)) & mask);
+
+  uint64_t head = 0;
+  for (size_t idx = byte; idx < byte + 8; ++idx) {
+    head <<= 8;
+    if (idx < data->size()) {
+      head |= static_cast<unsigned char>((*data)[idx]);
+    }
+  }
+  if (shift != 0) {
+    head = (head & ~(std::numeric_limits<uint64_t>::max() >> shift))
+      | (word >> shift);
+  } else {
+    head = word;
+  }
+  for (int32_t idx = 7; idx >= 0; --idx) {
+    if (byte + idx < data->size()) {
+      (*data)[byte + idx] = static_cast<char>(head & 0xFF);
+    }
+    head >>= 8;
+  }
+  if (shift != 0 && byte + 8 < data->size()) {
+    unsigned char tail = static_cast<unsigned char>((*data)[byte + 8]);
+    tail = (tail & (0xFF >> shift))
+      | static_cast<unsigned char>(word << (8 - shift));
+    (*data)[byte + 8] = static_cast<char>(tail);
+  }
+}
+
+// The overflow checks of redis, 0 if value + incr fits in the field,
+// otherwise 1 or -1 by the direction, and limit is the wrapped or
+// saturated value
+static int32_t CheckUnsignedBitFieldOverflow(uint64_t value, int64_t incr,
+                                             uint32_t bits,
+                                             BitFieldOverflow overflow,
+                                             uint64_t* limit) {
+  uint64_t max = (1ULL << bits) - 1;
+  int64_t maxincr = max - value;
+  int64_t minincr = -value;
+  int32_t ret = 0;
+  if (value > max || (incr > 0 && incr > maxincr)) {
+    *limit = max;
+    ret = 1;
+  } else if (incr < 0 && incr < minincr) {
+    *limit = 0;
+    ret = -1;
+  }
+  if (ret != 0 && overflow == kBitFieldWrap) {
+    *limit = (value + incr) & max;
+  }
+  return ret;
+}
+
+static int32_t CheckSignedBitFieldOverflow(int64_t value, int64_t incr,
+                                           uint32_t bits,
+                                           BitFieldOverflow overflow,
+                                           int64_t* limit) {
+  int64_t max = bits == 64 ? std::numeric_limits<int64_t>::max()
+    : (1LL << (bits - 1)) - 1;
+  int64_t min = -max - 1;
+  int32_t ret = 0;
+  if (value > max || (value >= 0 && incr > 0 && incr > max - value)) {
+    *limit = max;
+    ret = 1;
+  } else if (value < min || (value < 0 && incr < 0 && incr < min - value)) {
+    *limit = min;
+    ret = -1;
+  }
+  if (ret != 0 && overflow == kBitFieldWrap) {
+    uint64_t sum = static_cast<uint64_t>(value) + static_cast<uint64_t>(incr);
+    if (bits < 64) {
+      uint64_t mask = std::numeric_limits<uint64_t>::max() << bits;
+      if (sum & (1ULL << (bits - 1))) {
+        sum |= mask;
+      } else {
+        sum &= ~mask;
+      }
+    }
+    *limit = static_cast<int64_t>(sum);
+  }
+  return ret;
+}
+
+// The field of op, sign extended if it is signed
+static int64_t GetBitField(const std::string& data, const BitFieldOp& op) {
+  uint64_t field = GetBitFieldWord(data, op.offset) >> (64 - op.bits);
+  if (op.is_signed && op.bits < 64 && (field & (1ULL << (op.bits - 1)))) {
+    field |= std::numeric_limits<uint64_t>::max() << op.bits;
+  }
+  return static_cast<int64_t>(field);
+}
+
+Status RedisStrings::BitField(const Slice& key,
+                              const std::vector<BitFieldOp>& ops,
+                              std::vector<BitFieldValue>* rets) {
+  rets->clear();
+  // The fields are within the 512MB of a string, as in redis
+  const int64_t max_bits = 512LL * 1024 * 1024 * 8;
+  for (const auto& op : ops) {
+    if (op.bits == 0 || op.bits > (op.is_signed ? 64U : 63U)) {
+      return Status::InvalidArgument("Invalid bitfield type");
+    } else if (op.offset < 0 || op.offset > max_bits - op.bits) {
+      return Status::InvalidArgument("bit offset is out of range");
+    }
+  }
+
+  // All the operations are one read and at most one write of the value
+  std::string value;
+  std::string data_value;
+  int32_t timestamp = 0;
+  ScopeRecordLock l(lock_mgr_, key);
+  Status s = GetValue(default_read_options_, key, &value);
+  if (s.ok()) {
+    ParsedStringsValue parsed_strings_value(&value);
+    if (!parsed_strings_value.IsStale()) {
+      timestamp = parsed_strings_value.timestamp();
+      data_value = parsed_strings_value.value().ToString();
+    }
+  } else if (!s.IsNotFound()) {
+    return s;
+  }
+
+  bool updated = false;
+  BitFieldValue ret;
+  for (const auto& op : ops) {
+    ret.value = GetBitField(data_value, op);
+    ret.nil = false;
+    if (op.type != kBitFieldGet) {
+      int32_t overflowed;
+      int64_t old_value = ret.value;
+      int64_t new_value;
+      if (op.is_signed) {
+        int64_t limit = 0;
+        int64_t incr = op.type == kBitFieldSet ? 0 : op.value;
+        int64_t base = op.type == kBitFieldSet ? op.value : old_value;
+        overflowed = CheckSignedBitFieldOverflow(base, incr,
+            op.bits, op.overflow, &limit);
+        new_value = overflowed != 0 ? limit
+          : static_cast<int64_t>(static_cast<uint64_t>(base) + incr);
+      } else {
+        uint64_t limit = 0;
+        int64_t incr = op.type == kBitFieldSet ? 0 : op.value;
+        uint64_t base = op.type == kBitFieldSet
+          ? static_cast<uint64_t>(op.value) : static_cast<uint64_t>(old_value);
+        overflowed = CheckUnsignedBitFieldOverflow(base, incr,
+            op.bits, op.overflow, &limit);
+        new_value = static_cast<int64_t>(overflowed != 0 ? limit
+          : base + incr);
+      }
+      if (overflowed != 0 && op.overflow == kBitFieldFail) {
+        ret.value = 0;
+        ret.nil = true;
+      } else {
+        size_t needed = (op.offset + op.bits + 7) >> 3;
+        if (data_value.size() < needed) {
+          data_value.resize(needed, '\0');
+        }
+        SetBitFieldWord(&data_value, op.offset, op.bits,
+            static_cast<uint64_t>(new_value));
+        ret.value = op.type == kBitFieldSet ? old_value : new_value;
+        updated = true;
+      }
+    }
+    rets->push_back(ret);
+  }
+  if (!updated) {
+    return Status::OK();
+  }
+  StringsValue strings_value(data_value);
+  strings_value.set_timestamp(timestamp);
+  return PutValue(key, strings_value.Encode());
+}
+
 Status RedisStrings::PKSetexAt(const Slice& key, const Slice& value, int32_t timestamp) {
   StringsValue strings_value(value);
   ScopeRecordLock l(lock_mgr_, key);
   strings_value.set_timestamp(timestamp);
-  return db_->Put(default_write_options_, key, strings_value.Encode());
+  return PutValue(key, strings_value.Encode());
 }
 
 Status RedisStrings::PKScanRange(const Slice& key_start,
@@ -1115,9 +1387,9 @@ Status RedisStrings::PKScanRange(const Slice& key_start,
     return Status::InvalidArgument("error in given range");
   }
 
-  // Note: This is a string type and does not need to pass the column family as
-  // a parameter, use the default column family
-  rocksdb::Iterator* it = db_->NewIterator(iterator_options);
+  // Note: The strings with ttl may live in ttl_cf, the iterator
+  // covers both column families
+  rocksdb::Iterator* it = NewValueIterator(iterator_options);
   if (start_no_limit) {
     it->SeekToFirst();
   } else {
@@ -1178,9 +1450,9 @@ Status RedisStrings::PKRScanRange(const Slice& key_start,
     return Status::InvalidArgument("error in given range");
   }
 
-  // Note: This is a string type and does not need to pass the column family as
-  // a parameter, use the default column family
-  rocksdb::Iterator* it = db_->NewIterator(iterator_options);
+  // Note: The strings with ttl may live in ttl_cf, the iterator
+  // covers both column families
+  rocksdb::Iterator* it = NewValueIterator(iterator_options);
   if (start_no_limit) {
     it->SeekToLast();
   } else {
@@ -1222,7 +1494,7 @@ Status RedisStrings::PKRScanRange(const Slice& key_start,
 Status RedisStrings::Expire(const Slice& key, int32_t ttl) {
   std::string value;
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, &value);
+  Status s = GetValue(default_read_options_, key, &value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&value);
     if (parsed_strings_value.IsStale()) {
@@ -1230,9 +1502,9 @@ Status RedisStrings::Expire(const Slice& key, int32_t ttl) {
     }
     if (ttl > 0) {
       parsed_strings_value.SetRelativeTimestamp(ttl);
-      return db_->Put(default_write_options_, key, value);
+      return PutValue(key, value);
     } else {
-      return db_->Delete(default_write_options_, key);
+      return DeleteValue(key);
     }
   }
   return s;
@@ -1241,13 +1513,13 @@ Status RedisStrings::Expire(const Slice& key, int32_t ttl) {
 Status RedisStrings::Del(const Slice& key) {
   std::string value;
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, &value);
+  Status s = GetValue(default_read_options_, key, &value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&value);
     if (parsed_strings_value.IsStale()) {
       return Status::NotFound("Stale");
     }
-    return db_->Delete(default_write_options_, key);
+    return DeleteValue(key);
   }
   return s;
 }
@@ -1265,9 +1537,9 @@ bool RedisStrings::Scan(const std::string& start_key,
   iterator_options.snapshot = snapshot;
   iterator_options.fill_cache = false;
 
-  // Note: This is a string type and does not need to pass the column family as
-  // a parameter, use the default column family
-  rocksdb::Iterator* it = db_->NewIterator(iterator_options);
+  // Note: The strings with ttl may live in ttl_cf, the iterator
+  // covers both column families
+  rocksdb::Iterator* it = NewValueIterator(iterator_options);
 
   it->Seek(start_key);
   while (it->Valid() && (*count) > 0) {
@@ -1302,7 +1574,7 @@ bool RedisStrings::Scan(const std::string& start_key,
 Status RedisStrings::Expireat(const Slice& key, int32_t timestamp) {
   std::string value;
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, &value);
+  Status s = GetValue(default_read_options_, key, &value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&value);
     if (parsed_strings_value.IsStale()) {
@@ -1310,9 +1582,9 @@ Status RedisStrings::Expireat(const Slice& key, int32_t timestamp) {
     } else {
       if (timestamp > 0) {
         parsed_strings_value.set_timestamp(timestamp);
-        return db_->Put(default_write_options_, key, value);
+        return PutValue(key, value);
       } else {
-        return db_->Delete(default_write_options_, key);
+        return DeleteValue(key);
       }
     }
   }
@@ -1322,7 +1594,7 @@ Status RedisStrings::Expireat(const Slice& key, int32_t timestamp) {
 Status RedisStrings::Persist(const Slice& key) {
   std::string value;
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, &value);
+  Status s = GetValue(default_read_options_, key, &value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&value);
     if (parsed_strings_value.IsStale()) {
@@ -1333,7 +1605,7 @@ Status RedisStrings::Persist(const Slice& key) {
         return Status::NotFound("Not have an associated timeout");
       } else {
         parsed_strings_value.set_timestamp(0);
-        return db_->Put(default_write_options_, key, value);
+        return PutValue(key, value);
       }
     }
   }
@@ -1343,7 +1615,7 @@ Status RedisStrings::Persist(const Slice& key) {
 Status RedisStrings::TTL(const Slice& key, int64_t* timestamp) {
   std::string value;
   ScopeRecordLock l(lock_mgr_, key);
-  Status s = db_->Get(default_read_options_, key, &value);
+  Status s = GetValue(default_read_options_, key, &value);
   if (s.ok()) {
     ParsedStringsValue parsed_strings_value(&value);
     if (parsed_strings_value.IsStale()) {
@@ -1365,6 +1637,90 @@ Status RedisStrings::TTL(const Slice& key, int64_t* timestamp) {
   return s;
 }
 
+Status RedisStrings::Rename(const Slice& key, const Slice& newkey,
+                            bool nx) {
+  std::string value;
+  MultiScopeRecordLock ml(lock_mgr_, {key.ToString(), newkey.ToString()});
+  Status s = GetValue(default_read_options_, key, &value);
+  if (s.ok()) {
+    ParsedStringsValue parsed_strings_value(&value);
+    if (parsed_strings_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (key == newkey) {
+      return nx ? Status::Busy("newkey exists") : Status::OK();
+    }
+    if (nx) {
+      s = CheckNotExists(newkey);
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    rocksdb::WriteBatch batch;
+    BatchPutValue(&batch, newkey, value);
+    BatchDeleteValue(&batch, key);
+    s = db_->Write(default_write_options_, &batch);
+  }
+  return s;
+}
+
+Status RedisStrings::Copy(const Slice& key, const Slice& newkey,
+                          bool replace) {
+  std::string value;
+  MultiScopeRecordLock ml(lock_mgr_, {key.ToString(), newkey.ToString()});
+  Status s = GetValue(default_read_options_, key, &value);
+  if (s.ok()) {
+    ParsedStringsValue parsed_strings_value(&value);
+    if (parsed_strings_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (key == newkey) {
+      return Status::OK();
+    }
+    if (!replace) {
+      s = CheckNotExists(newkey);
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    s = PutValue(newkey, value);
+  }
+  return s;
+}
+
+Status RedisStrings::Dump(const Slice& key, DumpWriter* writer) {
+  std::string value;
+  Status s = GetValue(default_read_options_, key, &value);
+  if (s.ok()) {
+    ParsedStringsValue parsed_strings_value(&value);
+    if (parsed_strings_value.IsStale()) {
+      return Status::NotFound("Stale");
+    }
+    writer->Begin(kStrings);
+    writer->Add(parsed_strings_value.user_value());
+  }
+  return s;
+}
+
+Status RedisStrings::Restore(const Slice& key, DumpReader* reader,
+                             int32_t ttl, bool replace) {
+  Slice value;
+  if (!reader->Next(&value) || !reader->Done()) {
+    return Status::Corruption("Malformed strings dump");
+  }
+  StringsValue strings_value(value);
+  if (ttl > 0) {
+    strings_value.SetRelativeTimestamp(ttl);
+  }
+  ScopeRecordLock l(lock_mgr_, key);
+  if (!replace) {
+    Status s = CheckNotExists(key);
+    if (!s.ok()) {
+      return s.IsBusy()
+        ? Status::Busy("Target key name already exists") : s;
+    }
+  }
+  return PutValue(key, strings_value.Encode());
+}
+
 void RedisStrings::ScanDatabase() {
   rocksdb::ReadOptions iterator_options;
   const rocksdb::Snapshot* snapshot;
@@ -1374,7 +1730,7 @@ void RedisStrings::ScanDatabase() {
   int32_t current_time = time(NULL);
 
   printf("\n***************String Data***************\n");
-  auto iter = db_->NewIterator(iterator_options);
+  auto iter = NewValueIterator(iterator_options);
   for (iter->SeekToFirst();
        iter->Valid();
        iter->Next()) {
@@ -1395,4 +1751,179 @@ void RedisStrings::ScanDatabase() {
   delete iter;
 }
 
+Status RedisStrings::DropExpiredFiles() {
+  if (!HasTTLColumnFamily() || IsReadOnly()) {
+    return Status::OK();
+  }
+
+  rocksdb::TablePropertiesCollection props;
+  Status s = db_->GetPropertiesOfAllTables(handles_[1], &props);
+  if (!s.ok()) {
+    return s;
+  }
+
+  std::vector<rocksdb::LiveFileMetaData> metadata;
+  std::vector<rocksdb::LiveFileMetaData> ttl_files;
+  db_->GetLiveFilesMetaData(&metadata);
+  for (const auto& file : metadata) {
+    if (file.column_family_name == "ttl_cf") {
+      ttl_files.push_back(file);
+    }
+  }
+  // Only the oldest file of L0 can be deleted, and a deletion in a
+  // newer file never needs to survive the older ones
+  std::sort(ttl_files.begin(), ttl_files.end(),
+      [](const rocksdb::LiveFileMetaData& a,
+         const rocksdb::LiveFileMetaData& b) {
+        return a.smallest_seqno < b.smallest_seqno;
+      });
+
+  int64_t unix_time;
+  rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+  for (const auto& file : ttl_files) {
+    auto iter = props.find(file.db_path + file.name);
+    int32_t max_expire;
+    if (iter == props.end()
+      || !GetStringsMaxExpire(*iter->second, &max_expire)
+      || max_expire >= unix_time) {
+      break;
+    }
+    s = db_->DeleteFile(file.name);
+    if (!s.ok()) {
+      break;
+    }
+  }
+  return s;
+}
+
+Status RedisStrings::PutFloatValue(const Slice& key, long double number,
+                                   const std::string& str_number,
+                                   int32_t timestamp) {
+  // Only keep the binary double when it holds the exact result, otherwise
+  // the next increment would lose the long double precision
+  double double_number = static_cast<double>(number);
+  if (static_cast<long double>(double_number) == number) {
+    StringsTypedValue strings_value(double_number);
+    strings_value.set_timestamp(timestamp);
+    return PutValue(key, strings_value.Encode());
+  }
+  StringsValue strings_value(str_number);
+  strings_value.set_timestamp(timestamp);
+  return PutValue(key, strings_value.Encode());
+}
+
+Status RedisStrings::GetValue(const rocksdb::ReadOptions& read_options,
+                              const Slice& key, std::string* value) {
+  Status s = db_->Get(read_options, key, value);
+  if (s.IsNotFound() && HasTTLColumnFamily()) {
+    s = db_->Get(read_options, handles_[1], key, value);
+  }
+  return s;
+}
+
+Status RedisStrings::CheckNotExists(const Slice& key) {
+  std::string value;
+  Status s = GetValue(default_read_options_, key, &value);
+  if (s.ok()) {
+    ParsedStringsValue parsed_strings_value(&value);
+    return parsed_strings_value.IsStale()
+      ? Status::OK() : Status::Busy("newkey exists");
+  }
+  return s.IsNotFound() ? Status::OK() : s;
+}
+
+Status RedisStrings::PutValue(const Slice& key, const Slice& value) {
+  if (!HasTTLColumnFamily()) {
+    return db_->Put(default_write_options_, key, value);
+  }
+  rocksdb::WriteBatch batch;
+  BatchPutValue(&batch, key, value);
+  return db_->Write(default_write_options_, &batch);
+}
+
+Status RedisStrings::DeleteValue(const Slice& key) {
+  if (!HasTTLColumnFamily()) {
+    return db_->Delete(default_write_options_, key);
+  }
+  rocksdb::WriteBatch batch;
+  BatchDeleteValue(&batch, key);
+  return db_->Write(default_write_options_, &batch);
+}
+
+void RedisStrings::BatchPutValue(rocksdb::WriteBatch* batch,
+                                 const Slice& key, const Slice& value) {
+  if (!HasTTLColumnFamily()) {
+    batch->Put(key, value);
+    return;
+  }
+  // Remove the key from the other column family, it may move
+  // between them by Expire and Persist
+  ParsedStringsValue parsed_strings_value(value);
+  if (parsed_strings_value.IsPermanentSurvival()) {
+    batch->Put(handles_[0], key, value);
+    if (ValueMayExist(handles_[1], key)) {
+      batch->Delete(handles_[1], key);
+    }
+  } else {
+    if (ValueMayExist(handles_[0], key)) {
+      batch->Delete(handles_[0], key);
+    }
+    batch->Put(handles_[1], key, value);
+  }
+}
+
+void RedisStrings::BatchDeleteValue(rocksdb::WriteBatch* batch,
+                                    const Slice& key) {
+  if (!HasTTLColumnFamily()) {
+    batch->Delete(key);
+    return;
+  }
+  for (auto handle : handles_) {
+    if (ValueMayExist(handle, key)) {
+      batch->Delete(handle, key);
+    }
+  }
+}
+
+// The memtables and the bloom filters in the block cache tell that most
+// keys are not in a column family without any io, the writers hold the
+// record lock of the key so the answer can not change before the write
+bool RedisStrings::ValueMayExist(rocksdb::ColumnFamilyHandle* handle,
+                                 const Slice& key) {
+  rocksdb::ReadOptions read_options;
+  read_options.read_tier = rocksdb::kBlockCacheTier;
+  std::string value;
+  return db_->KeyMayExist(read_options, handle, key, &value);
+}
+
+Status RedisStrings::DelKeyRange(const std::string& range_start,
+                                 const std::string& range_end) {
+  if (!HasTTLColumnFamily()) {
+    return Redis::DelKeyRange(range_start, range_end);
+  }
+  rocksdb::WriteBatch batch;
+  for (auto handle : handles_) {
+    batch.DeleteRange(handle, range_start, range_end);
+  }
+  return db_->Write(default_write_options_, &batch);
+}
+
+rocksdb::Iterator* RedisStrings::NewKeyIterator(
+    const rocksdb::ReadOptions& read_options) {
+  return NewValueIterator(read_options);
+}
+
+rocksdb::Iterator* RedisStrings::NewValueIterator(
+    const rocksdb::ReadOptions& read_options) {
+  if (!HasTTLColumnFamily()) {
+    return db_->NewIterator(read_options);
+  }
+  std::vector<rocksdb::Iterator*> iters;
+  Status s = db_->NewIterators(read_options, handles_, &iters);
+  if (!s.ok()) {
+    return rocksdb::NewErrorIterator(s);
+  }
+  return new MergedIterator(rocksdb::BytewiseComparator(), iters);
+}
+
 }  //  namespace blackwidow
@@ -17,7 +17,7 @@ namespace blackwidow {
 class RedisStrings : public Redis {
  public:
   RedisStrings(BlackWidow* const bw, const DataType& type);
-  ~RedisStrings() = default;
+  ~RedisStrings();
 
   // Common Commands
   Status Open(const BlackwidowOptions& bw_options,
@@ -70,6 +70,8 @@ class RedisStrings : public Redis {
   Status BitPos(const Slice& key, int32_t bit,
                 int64_t start_offset, int64_t end_offset,
                 int64_t* ret);
+  Status BitField(const Slice& key, const std::vector<BitFieldOp>& ops,
+                  std::vector<BitFieldValue>* rets);
   Status PKSetexAt(const Slice& key, const Slice& value, int32_t timestamp);
   Status PKScanRange(const Slice& key_start, const Slice& key_end,
                      const Slice& pattern, int32_t limit,
@@ -87,9 +89,48 @@ class RedisStrings : public Redis {
   Status Expireat(const Slice& key, int32_t timestamp) override;
   Status Persist(const Slice& key) override;
   Status TTL(const Slice& key, int64_t* timestamp) override;
+  Status Rename(const Slice& key, const Slice& newkey, bool nx) override;
+  Status Copy(const Slice& key, const Slice& newkey, bool replace) override;
+  Status Dump(const Slice& key, DumpWriter* writer) override;
+  Status Restore(const Slice& key, DumpReader* reader,
+                 int32_t ttl, bool replace) override;
 
   // Iterate all data
   void ScanDatabase();
+
+  // Delete the oldest table files of ttl_cf whose entries all expired
+  Status DropExpiredFiles();
+
+  Status DelKeyRange(const std::string& range_start,
+                     const std::string& range_end) override;
+
+ protected:
+  rocksdb::Iterator* NewKeyIterator(
+      const rocksdb::ReadOptions& read_options) override;
+
+ private:
+  // handles_[1] is the ttl_cf when strings_ttl_cf is enabled, a key
+  // lives in exactly one of the two column families
+  std::vector<rocksdb::ColumnFamilyHandle*> handles_;
+
+  bool HasTTLColumnFamily() const {
+    return handles_.size() > 1;
+  }
+  Status GetValue(const rocksdb::ReadOptions& read_options,
+                  const Slice& key, std::string* value);
+  Status PutValue(const Slice& key, const Slice& value);
+  // Busy when key holds a live value, called with the record lock of key
+  Status CheckNotExists(const Slice& key);
+  Status PutFloatValue(const Slice& key, long double number,
+                       const std::string& str_number, int32_t timestamp);
+  Status DeleteValue(const Slice& key);
+  void BatchPutValue(rocksdb::WriteBatch* batch,
+                     const Slice& key, const Slice& value);
+  void BatchDeleteValue(rocksdb::WriteBatch* batch, const Slice& key);
+  // false if the column family surely holds no entry of the key, the
+  // tombstones for the keys that never moved are skipped by it
+  bool ValueMayExist(rocksdb::ColumnFamilyHandle* handle, const Slice& key);
+  rocksdb::Iterator* NewValueIterator(const rocksdb::ReadOptions& read_options);
 };
 
 }  //  namespace blackwidow
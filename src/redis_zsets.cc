@@ -15,9 +15,16 @@
 #include "src/zsets_filter.h"
 #include "src/scope_record_lock.h"
 #include "src/scope_snapshot.h"
+#include "src/dump_format.h"
+#include "src/geohash.h"
 
 namespace blackwidow {
 
+// The order of the score keys, by score and then by member
+static bool ScoreMemberLess(const ScoreMember& a, const ScoreMember& b) {
+  return a.score != b.score ? a.score < b.score : a.member < b.member;
+}
+
 rocksdb::Comparator* ZSetsScoreKeyComparator() {
   static ZSetsScoreKeyComparatorImpl zsets_score_key_compare;
   return &zsets_score_key_compare;
@@ -41,8 +48,13 @@ Status RedisZSets::Open(const BlackwidowOptions& bw_options,
   small_compaction_threshold_ = bw_options.small_compaction_threshold;
 
   rocksdb::Options ops(bw_options.options);
-  Status s = rocksdb::DB::Open(ops, db_path, &db_);
-  if (s.ok()) {
+  Status s;
+  // read-only and secondary instance can not create column family,
+  // it must have been created by the primary instance
+  if (bw_options.open_mode == kOpenReadWrite) {
+    s = rocksdb::DB::Open(ops, db_path, &db_);
+  }
+  if (bw_options.open_mode == kOpenReadWrite && s.ok()) {
     rocksdb::ColumnFamilyHandle *dcf = nullptr, *scf = nullptr;
     s = db_->CreateColumnFamily(rocksdb::ColumnFamilyOptions(),
         "data_cf", &dcf);
@@ -61,6 +73,8 @@ Status RedisZSets::Open(const BlackwidowOptions& bw_options,
   }
 
   rocksdb::DBOptions db_ops(bw_options.options);
+  // origin_cf is missing in the db created before rename was supported
+  db_ops.create_missing_column_families = true;
   rocksdb::ColumnFamilyOptions meta_cf_ops(bw_options.options);
   rocksdb::ColumnFamilyOptions data_cf_ops(bw_options.options);
   rocksdb::ColumnFamilyOptions score_cf_ops(bw_options.options);
@@ -72,9 +86,7 @@ Status RedisZSets::Open(const BlackwidowOptions& bw_options,
     std::make_shared<ZSetsScoreFilterFactory>(&db_, &handles_);
   score_cf_ops.comparator = ZSetsScoreKeyComparator();
 
-  // use the bloom filter policy to reduce disk reads
   rocksdb::BlockBasedTableOptions table_ops(bw_options.table_options);
-  table_ops.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10, true));
   rocksdb::BlockBasedTableOptions meta_cf_table_ops(table_ops);
   rocksdb::BlockBasedTableOptions data_cf_table_ops(table_ops);
   rocksdb::BlockBasedTableOptions score_cf_table_ops(table_ops);
@@ -86,6 +98,13 @@ Status RedisZSets::Open(const BlackwidowOptions& bw_options,
     score_cf_table_ops.block_cache =
       rocksdb::NewLRUCache(bw_options.block_cache_size);
   }
+  // tune every column family for its access pattern
+  ApplyColumnFamilyProfile(bw_options.meta_profile,
+      &meta_cf_ops, &meta_cf_table_ops);
+  ApplyColumnFamilyProfile(bw_options.zsets_data_profile,
+      &data_cf_ops, &data_cf_table_ops);
+  ApplyColumnFamilyProfile(bw_options.zsets_score_profile,
+      &score_cf_ops, &score_cf_table_ops);
   meta_cf_ops.table_factory.reset(
       rocksdb::NewBlockBasedTableFactory(meta_cf_table_ops));
   data_cf_ops.table_factory.reset(
@@ -93,6 +112,13 @@ Status RedisZSets::Open(const BlackwidowOptions& bw_options,
   score_cf_ops.table_factory.reset(
       rocksdb::NewBlockBasedTableFactory(score_cf_table_ops));
 
+  // the entries of origin_cf are few and read along with the meta
+  rocksdb::ColumnFamilyOptions origin_cf_ops(bw_options.options);
+  origin_cf_ops.compaction_filter_factory =
+    std::make_shared<ZSetsOriginFilterFactory>(&db_, &handles_);
+  origin_cf_ops.table_factory = meta_cf_ops.table_factory;
+  origin_cf_ops.cf_paths = meta_cf_ops.cf_paths;
+
   std::vector<rocksdb::ColumnFamilyDescriptor> column_families;
   column_families.push_back(rocksdb::ColumnFamilyDescriptor(
         rocksdb::kDefaultColumnFamilyName, meta_cf_ops));
@@ -100,7 +126,9 @@ Status RedisZSets::Open(const BlackwidowOptions& bw_options,
         "data_cf", data_cf_ops));
   column_families.push_back(rocksdb::ColumnFamilyDescriptor(
         "score_cf", score_cf_ops));
-  return rocksdb::DB::Open(db_ops, db_path, column_families, &handles_, &db_);
+  column_families.push_back(rocksdb::ColumnFamilyDescriptor(
+        "origin_cf", origin_cf_ops));
+  return OpenDB(bw_options, db_ops, db_path, column_families, &handles_);
 }
 
 Status RedisZSets::CompactRange(const rocksdb::Slice* begin,
@@ -113,6 +141,11 @@ Status RedisZSets::CompactRange(const rocksdb::Slice* begin,
     db_->CompactRange(default_compact_range_options_, handles_[1], begin, end);
     db_->CompactRange(default_compact_range_options_, handles_[2], begin, end);
   }
+  // origin_cf is compacted along with the whole db
+  if (type == kMetaAndData) {
+    db_->CompactRange(default_compact_range_options_,
+        handles_[3], nullptr, nullptr);
+  }
   return Status::OK();
 }
 
@@ -216,7 +249,7 @@ Status RedisZSets::PKPatternMatchDel(const std::string& pattern,
     if (!parsed_zsets_meta_value.IsStale()
       && parsed_zsets_meta_value.count()
       && StringMatch(pattern.data(), pattern.size(), key.data(), key.size(), 0)) {
-      parsed_zsets_meta_value.InitialMetaValue();
+      parsed_zsets_meta_value.InitialMetaValue(version_floor());
       batch.Put(handles_[0], key, meta_value);
     }
     if (static_cast<size_t>(batch.Count()) >= BATCH_DELETE_LIMIT) {
@@ -262,7 +295,8 @@ Status RedisZSets::ZPopMax(const Slice& key,
       int32_t num = parsed_zsets_meta_value.count();
       num = num <= count ? num : count;
       int32_t version = parsed_zsets_meta_value.version();
-      ZSetsScoreKey zsets_score_key(key, version,
+      Slice data_owner = parsed_zsets_meta_value.data_owner(key);
+      ZSetsScoreKey zsets_score_key(data_owner, version,
           std::numeric_limits<double>::max(), Slice());
       rocksdb::Iterator* iter = db_->NewIterator(default_read_options_, handles_[2]);
       int32_t del_cnt = 0;
@@ -273,7 +307,7 @@ Status RedisZSets::ZPopMax(const Slice& key,
         score_members->emplace_back(
                        ScoreMember{parsed_zsets_score_key.score(), 
                                    parsed_zsets_score_key.member().ToString()});
-        ZSetsMemberKey zsets_member_key(key, version, parsed_zsets_score_key.member());
+        ZSetsMemberKey zsets_member_key(data_owner, version, parsed_zsets_score_key.member());
         ++statistic;
         ++del_cnt;
         batch.Delete(handles_[1], zsets_member_key.Encode());
@@ -310,7 +344,8 @@ Status RedisZSets::ZPopMin(const Slice& key,
       int32_t num = parsed_zsets_meta_value.count();
       num = num <= count ? num : count;
       int32_t version = parsed_zsets_meta_value.version();
-      ZSetsScoreKey zsets_score_key(key, version,
+      Slice data_owner = parsed_zsets_meta_value.data_owner(key);
+      ZSetsScoreKey zsets_score_key(data_owner, version,
                     std::numeric_limits<double>::lowest(), Slice());
       rocksdb::Iterator* iter = db_->NewIterator(default_read_options_, handles_[2]);
       int32_t del_cnt = 0;
@@ -321,7 +356,7 @@ Status RedisZSets::ZPopMin(const Slice& key,
         score_members->emplace_back(
                        ScoreMember{parsed_zsets_score_key.score(),
                                    parsed_zsets_score_key.member().ToString()} );
-        ZSetsMemberKey zsets_member_key(key, version, parsed_zsets_score_key.member());
+        ZSetsMemberKey zsets_member_key(data_owner, version, parsed_zsets_score_key.member());
         ++statistic;
         ++del_cnt;
         batch.Delete(handles_[1], zsets_member_key.Encode());
@@ -342,6 +377,22 @@ Status RedisZSets::ZPopMin(const Slice& key,
 Status RedisZSets::ZAdd(const Slice& key,
                         const std::vector<ScoreMember>& score_members,
                         int32_t* ret) {
+  return AddMembers(key, score_members, 0, ret);
+}
+
+Status RedisZSets::ZAddCapped(const Slice& key,
+                              const std::vector<ScoreMember>& score_members,
+                              int32_t cap, int32_t* ret) {
+  if (cap <= 0) {
+    *ret = 0;
+    return Status::InvalidArgument("cap must be positive");
+  }
+  return AddMembers(key, score_members, cap, ret);
+}
+
+Status RedisZSets::AddMembers(const Slice& key,
+                              const std::vector<ScoreMember>& score_members,
+                              int32_t cap, int32_t* ret) {
   *ret = 0;
   uint32_t statistic = 0;
   std::unordered_set<std::string> unique;
@@ -365,17 +416,22 @@ Status RedisZSets::ZAdd(const Slice& key,
     if (parsed_zsets_meta_value.IsStale()
       || parsed_zsets_meta_value.count() == 0) {
       vaild = false;
-      version = parsed_zsets_meta_value.InitialMetaValue();
+      version = parsed_zsets_meta_value.InitialMetaValue(version_floor());
     } else {
       vaild = true;
       version = parsed_zsets_meta_value.version();
     }
+    if (cap > 0) {
+      parsed_zsets_meta_value.set_cap(cap);
+    }
+    Slice data_owner = parsed_zsets_meta_value.data_owner(key);
 
     int32_t cnt = 0;
     std::string data_value;
+    std::vector<ScoreMember> written;
     for (const auto& sm : filtered_score_members) {
       bool not_found = true;
-      ZSetsMemberKey zsets_member_key(key, version, sm.member);
+      ZSetsMemberKey zsets_member_key(data_owner, version, sm.member);
       if (vaild) {
         s = db_->Get(default_read_options_,
             handles_[1], zsets_member_key.Encode(), &data_value);
@@ -387,7 +443,8 @@ Status RedisZSets::ZAdd(const Slice& key,
           if (old_score == sm.score) {
             continue;
           } else {
-            ZSetsScoreKey zsets_score_key(key, version, old_score, sm.member);
+            ZSetsScoreKey zsets_score_key(data_owner, version,
+                old_score, sm.member);
             batch.Delete(handles_[2], zsets_score_key.Encode());
             // delete old zsets_score_key and overwirte zsets_member_key
             // but in different column_families so we accumulative 1
@@ -403,21 +460,38 @@ Status RedisZSets::ZAdd(const Slice& key,
       batch.Put(handles_[1],
           zsets_member_key.Encode(), Slice(score_buf, sizeof(uint64_t)));
 
-      ZSetsScoreKey zsets_score_key(key, version, sm.score, sm.member);
+      ZSetsScoreKey zsets_score_key(data_owner, version,
+          sm.score, sm.member);
       batch.Put(handles_[2], zsets_score_key.Encode(), Slice());
+      written.push_back(sm);
       if (not_found) {
         cnt++;
       }
     }
     parsed_zsets_meta_value.ModifyCount(cnt);
+    s = TrimCappedZSet(data_owner, version, &written,
+                       &parsed_zsets_meta_value, &batch, &statistic);
+    if (!s.ok()) {
+      return s;
+    }
     batch.Put(handles_[0], key, meta_value);
     *ret = cnt;
   } else if (s.IsNotFound()) {
+    if (cap > 0 && filtered_score_members.size() > static_cast<size_t>(cap)) {
+      // Only the highest ranked members fit in a new capped zset
+      std::sort(filtered_score_members.begin(),
+                filtered_score_members.end(), ScoreMemberLess);
+      filtered_score_members.erase(filtered_score_members.begin(),
+                                   filtered_score_members.end() - cap);
+    }
     char buf[4];
     EncodeFixed32(buf, filtered_score_members.size());
     ZSetsMetaValue zsets_meta_value(Slice(buf, sizeof(int32_t)));
-    version = zsets_meta_value.UpdateVersion();
-    batch.Put(handles_[0], key, zsets_meta_value.Encode());
+    version = zsets_meta_value.UpdateVersion(version_floor());
+    meta_value = zsets_meta_value.Encode().ToString();
+    ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
+    parsed_zsets_meta_value.set_cap(cap);
+    batch.Put(handles_[0], key, meta_value);
     for (const auto& sm : filtered_score_members) {
       ZSetsMemberKey zsets_member_key(key, version, sm.member);
       const void* ptr_score = reinterpret_cast<const void*>(&sm.score);
@@ -481,11 +555,12 @@ Status RedisZSets::ZCount(const Slice& key,
       return Status::NotFound();
     } else {
       int32_t version = parsed_zsets_meta_value.version();
+      Slice data_owner = parsed_zsets_meta_value.data_owner(key);
       int32_t cnt = 0;
       int32_t cur_index = 0;
       int32_t stop_index = parsed_zsets_meta_value.count() - 1;
       ScoreMember score_member;
-      ZSetsScoreKey zsets_score_key(key,
+      ZSetsScoreKey zsets_score_key(data_owner,
           version, std::numeric_limits<double>::lowest(), Slice());
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[2]);
       for (iter->Seek(zsets_score_key.Encode());
@@ -524,6 +599,8 @@ Status RedisZSets::ZIncrby(const Slice& key,
   double score = 0;
   char score_buf[8];
   int32_t version = 0;
+  bool new_member = false;
+  Slice data_owner = key;
   std::string meta_value;
   rocksdb::WriteBatch batch;
   ScopeRecordLock l(lock_mgr_, key);
@@ -532,12 +609,13 @@ Status RedisZSets::ZIncrby(const Slice& key,
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
     if (parsed_zsets_meta_value.IsStale()
       || parsed_zsets_meta_value.count() == 0) {
-      version = parsed_zsets_meta_value.InitialMetaValue();
+      version = parsed_zsets_meta_value.InitialMetaValue(version_floor());
     } else {
       version = parsed_zsets_meta_value.version();
     }
+    data_owner = parsed_zsets_meta_value.data_owner(key);
     std::string data_value;
-    ZSetsMemberKey zsets_member_key(key, version, member);
+    ZSetsMemberKey zsets_member_key(data_owner, version, member);
     s = db_->Get(default_read_options_,
         handles_[1], zsets_member_key.Encode(), &data_value);
     if (s.ok()) {
@@ -545,7 +623,7 @@ Status RedisZSets::ZIncrby(const Slice& key,
       const void* ptr_tmp = reinterpret_cast<const void*>(&tmp);
       double old_score = *reinterpret_cast<const double*>(ptr_tmp);
       score = old_score + increment;
-      ZSetsScoreKey zsets_score_key(key, version, old_score, member);
+      ZSetsScoreKey zsets_score_key(data_owner, version, old_score, member);
       batch.Delete(handles_[2], zsets_score_key.Encode());
       // delete old zsets_score_key and overwirte zsets_member_key
       // but in different column_families so we accumulative 1
@@ -553,7 +631,7 @@ Status RedisZSets::ZIncrby(const Slice& key,
     } else if (s.IsNotFound()) {
       score = increment;
       parsed_zsets_meta_value.ModifyCount(1);
-      batch.Put(handles_[0], key, meta_value);
+      new_member = true;
     } else {
       return s;
     }
@@ -561,26 +639,104 @@ Status RedisZSets::ZIncrby(const Slice& key,
     char buf[8];
     EncodeFixed32(buf, 1);
     ZSetsMetaValue zsets_meta_value(Slice(buf, sizeof(int32_t)));
-    version = zsets_meta_value.UpdateVersion();
+    version = zsets_meta_value.UpdateVersion(version_floor());
     batch.Put(handles_[0], key, zsets_meta_value.Encode());
     score = increment;
   } else {
     return s;
   }
-  ZSetsMemberKey zsets_member_key(key, version, member);
+  ZSetsMemberKey zsets_member_key(data_owner, version, member);
   const void* ptr_score = reinterpret_cast<const void*>(&score);
   EncodeFixed64(score_buf, *reinterpret_cast<const uint64_t*>(ptr_score));
   batch.Put(handles_[1],
       zsets_member_key.Encode(), Slice(score_buf, sizeof(uint64_t)));
 
-  ZSetsScoreKey zsets_score_key(key, version, score, member);
+  ZSetsScoreKey zsets_score_key(data_owner, version, score, member);
   batch.Put(handles_[2], zsets_score_key.Encode(), Slice());
+  if (new_member) {
+    // Evicted after the member is put, it may be evicted itself
+    ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
+    std::vector<ScoreMember> written = {{score, member.ToString()}};
+    s = TrimCappedZSet(data_owner, version, &written,
+                       &parsed_zsets_meta_value, &batch, &statistic);
+    if (!s.ok()) {
+      return s;
+    }
+    batch.Put(handles_[0], key, meta_value);
+  }
   *ret = score;
   s = db_->Write(default_write_options_, &batch);
   UpdateSpecificKeyStatistics(key.ToString(), statistic);
   return s;
 }
 
+Status RedisZSets::TrimCappedZSet(const Slice& data_owner,
+                                  int32_t version,
+                                  std::vector<ScoreMember>* written,
+                                  ParsedZSetsMetaValue* parsed_zsets_meta_value,
+                                  rocksdb::WriteBatch* batch,
+                                  uint32_t* statistic) {
+  if (!parsed_zsets_meta_value->capped()
+    || parsed_zsets_meta_value->count() <= parsed_zsets_meta_value->cap()) {
+    return Status::OK();
+  }
+  int32_t evict_num = parsed_zsets_meta_value->count()
+    - parsed_zsets_meta_value->cap();
+
+  // The members of the db are merged with the members written by the
+  // batch, whose former score keys are skipped
+  std::unordered_set<std::string> written_members;
+  for (const auto& sm : *written) {
+    written_members.insert(sm.member);
+  }
+  std::sort(written->begin(), written->end(), ScoreMemberLess);
+  auto written_iter = written->begin();
+
+  int32_t del_cnt = 0;
+  ScoreMember score_member;
+  ZSetsScoreKey zsets_score_key(data_owner, version,
+      std::numeric_limits<double>::lowest(), Slice());
+  rocksdb::Iterator* iter =
+    db_->NewIterator(default_read_options_, handles_[2]);
+  iter->Seek(zsets_score_key.Encode());
+  while (del_cnt < evict_num) {
+    bool in_db = false;
+    for (; iter->Valid(); iter->Next()) {
+      ParsedZSetsScoreKey parsed_zsets_score_key(iter->key());
+      if (parsed_zsets_score_key.key() != data_owner
+        || parsed_zsets_score_key.version() != version) {
+        break;
+      }
+      score_member.score = parsed_zsets_score_key.score();
+      score_member.member = parsed_zsets_score_key.member().ToString();
+      if (written_members.find(score_member.member)
+        == written_members.end()) {
+        in_db = true;
+        break;
+      }
+    }
+    if (in_db && (written_iter == written->end()
+      || ScoreMemberLess(score_member, *written_iter))) {
+      iter->Next();
+    } else if (written_iter != written->end()) {
+      score_member = *written_iter++;
+    } else {
+      break;
+    }
+    ZSetsMemberKey zsets_member_key(data_owner, version, score_member.member);
+    batch->Delete(handles_[1], zsets_member_key.Encode());
+    ZSetsScoreKey evicted_score_key(data_owner, version,
+        score_member.score, score_member.member);
+    batch->Delete(handles_[2], evicted_score_key.Encode());
+    (*statistic)++;
+    del_cnt++;
+  }
+  Status s = iter->status();
+  delete iter;
+  parsed_zsets_meta_value->ModifyCount(-del_cnt);
+  return s;
+}
+
 Status RedisZSets::ZRange(const Slice& key,
                           int32_t start,
                           int32_t stop,
@@ -603,6 +759,7 @@ Status RedisZSets::ZRange(const Slice& key,
     } else {
       int32_t count = parsed_zsets_meta_value.count();
       int32_t version = parsed_zsets_meta_value.version();
+      Slice data_owner = parsed_zsets_meta_value.data_owner(key);
       int32_t start_index = start >= 0 ? start : count + start;
       int32_t stop_index  = stop  >= 0 ? stop  : count + stop;
       start_index = start_index <= 0 ? 0 : start_index;
@@ -614,7 +771,7 @@ Status RedisZSets::ZRange(const Slice& key,
       }
       int32_t cur_index = 0;
       ScoreMember score_member;
-      ZSetsScoreKey zsets_score_key(key, version,
+      ZSetsScoreKey zsets_score_key(data_owner, version,
           std::numeric_limits<double>::lowest(), Slice());
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[2]);
       for (iter->Seek(zsets_score_key.Encode());
@@ -655,10 +812,11 @@ Status RedisZSets::ZRangebyscore(const Slice& key,
       return Status::NotFound();
     } else {
       int32_t version = parsed_zsets_meta_value.version();
+      Slice data_owner = parsed_zsets_meta_value.data_owner(key);
       int32_t index = 0;
       int32_t stop_index = parsed_zsets_meta_value.count() - 1;
       ScoreMember score_member;
-      ZSetsScoreKey zsets_score_key(key, version,
+      ZSetsScoreKey zsets_score_key(data_owner, version,
           std::numeric_limits<double>::lowest(), Slice());
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[2]);
       for (iter->Seek(zsets_score_key.Encode());
@@ -710,10 +868,11 @@ Status RedisZSets::ZRank(const Slice& key,
     } else {
       bool found = false;
       int32_t version = parsed_zsets_meta_value.version();
+      Slice data_owner = parsed_zsets_meta_value.data_owner(key);
       int32_t index = 0;
       int32_t stop_index = parsed_zsets_meta_value.count() - 1;
       ScoreMember score_member;
-      ZSetsScoreKey zsets_score_key(key, version,
+      ZSetsScoreKey zsets_score_key(data_owner, version,
           std::numeric_limits<double>::lowest(), Slice());
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[2]);
       for (iter->Seek(zsets_score_key.Encode());
@@ -765,8 +924,9 @@ Status RedisZSets::ZRem(const Slice& key,
       int32_t del_cnt = 0;
       std::string data_value;
       int32_t version = parsed_zsets_meta_value.version();
+      Slice data_owner = parsed_zsets_meta_value.data_owner(key);
       for (const auto& member : filtered_members) {
-        ZSetsMemberKey zsets_member_key(key, version, member);
+        ZSetsMemberKey zsets_member_key(data_owner, version, member);
         s = db_->Get(default_read_options_,
             handles_[1], zsets_member_key.Encode(), &data_value);
         if (s.ok()) {
@@ -777,7 +937,7 @@ Status RedisZSets::ZRem(const Slice& key,
           double score = *reinterpret_cast<const double*>(ptr_tmp);
           batch.Delete(handles_[1], zsets_member_key.Encode());
 
-          ZSetsScoreKey zsets_score_key(key, version, score, member);
+          ZSetsScoreKey zsets_score_key(data_owner, version, score, member);
           batch.Delete(handles_[2], zsets_score_key.Encode());
         } else if (!s.IsNotFound()) {
           return s;
@@ -817,11 +977,12 @@ Status RedisZSets::ZRemrangebyrank(const Slice& key,
       int32_t cur_index = 0;
       int32_t count = parsed_zsets_meta_value.count();
       int32_t version = parsed_zsets_meta_value.version();
+      Slice data_owner = parsed_zsets_meta_value.data_owner(key);
       int32_t start_index = start >= 0 ? start : count + start;
       int32_t stop_index  = stop  >= 0 ? stop  : count + stop;
       start_index = start_index <= 0 ? 0 : start_index;
       stop_index = stop_index >= count ? count - 1 : stop_index;
-      ZSetsScoreKey zsets_score_key(key, version,
+      ZSetsScoreKey zsets_score_key(data_owner, version,
           std::numeric_limits<double>::lowest(), Slice());
       rocksdb::Iterator* iter =
         db_->NewIterator(default_read_options_, handles_[2]);
@@ -830,7 +991,7 @@ Status RedisZSets::ZRemrangebyrank(const Slice& key,
            iter->Next(), ++cur_index) {
         if (cur_index >= start_index) {
           ParsedZSetsScoreKey parsed_zsets_score_key(iter->key());
-          ZSetsMemberKey zsets_member_key(key, version,
+          ZSetsMemberKey zsets_member_key(data_owner, version,
               parsed_zsets_score_key.member());
           batch.Delete(handles_[1], zsets_member_key.Encode());
           batch.Delete(handles_[2], iter->key());
@@ -875,7 +1036,8 @@ Status RedisZSets::ZRemrangebyscore(const Slice& key,
       int32_t cur_index = 0;
       int32_t stop_index = parsed_zsets_meta_value.count() - 1;
       int32_t version = parsed_zsets_meta_value.version();
-      ZSetsScoreKey zsets_score_key(key, version,
+      Slice data_owner = parsed_zsets_meta_value.data_owner(key);
+      ZSetsScoreKey zsets_score_key(data_owner, version,
           std::numeric_limits<double>::lowest(), Slice());
       rocksdb::Iterator* iter =
         db_->NewIterator(default_read_options_, handles_[2]);
@@ -894,7 +1056,7 @@ Status RedisZSets::ZRemrangebyscore(const Slice& key,
           right_pass = true;
         }
         if (left_pass && right_pass) {
-          ZSetsMemberKey zsets_member_key(key, version,
+          ZSetsMemberKey zsets_member_key(data_owner, version,
               parsed_zsets_score_key.member());
           batch.Delete(handles_[1], zsets_member_key.Encode());
           batch.Delete(handles_[2], iter->key());
@@ -940,6 +1102,7 @@ Status RedisZSets::ZRevrange(const Slice& key,
     } else {
       int32_t count = parsed_zsets_meta_value.count();
       int32_t version = parsed_zsets_meta_value.version();
+      Slice data_owner = parsed_zsets_meta_value.data_owner(key);
       int32_t start_index = stop >= 0 ? count - stop - 1 : -stop - 1;
       int32_t stop_index  = start >= 0 ? count- start - 1 : -start - 1;
       start_index = start_index <= 0 ? 0 : start_index;
@@ -951,7 +1114,7 @@ Status RedisZSets::ZRevrange(const Slice& key,
       }
       int32_t cur_index = count - 1;
       ScoreMember score_member;
-      ZSetsScoreKey zsets_score_key(key, version,
+      ZSetsScoreKey zsets_score_key(data_owner, version,
           std::numeric_limits<double>::max(), Slice());
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[2]);
       for (iter->SeekForPrev(zsets_score_key.Encode());
@@ -992,9 +1155,10 @@ Status RedisZSets::ZRevrangebyscore(const Slice& key,
       return Status::NotFound();
     } else {
       int32_t version = parsed_zsets_meta_value.version();
+      Slice data_owner = parsed_zsets_meta_value.data_owner(key);
       int32_t left = parsed_zsets_meta_value.count();
       ScoreMember score_member;
-      ZSetsScoreKey zsets_score_key(key, version,
+      ZSetsScoreKey zsets_score_key(data_owner, version,
           std::numeric_limits<double>::max(), Slice());
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[2]);
       for (iter->SeekForPrev(zsets_score_key.Encode());
@@ -1049,7 +1213,8 @@ Status RedisZSets::ZRevrank(const Slice& key,
       int32_t rev_index = 0;
       int32_t left = parsed_zsets_meta_value.count();
       int32_t version = parsed_zsets_meta_value.version();
-      ZSetsScoreKey zsets_score_key(key, version,
+      Slice data_owner = parsed_zsets_meta_value.data_owner(key);
+      ZSetsScoreKey zsets_score_key(data_owner, version,
           std::numeric_limits<double>::max(), Slice());
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[2]);
       for (iter->SeekForPrev(zsets_score_key.Encode());
@@ -1087,13 +1252,14 @@ Status RedisZSets::ZScore(const Slice& key,
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
     int32_t version = parsed_zsets_meta_value.version();
+    Slice data_owner = parsed_zsets_meta_value.data_owner(key);
     if (parsed_zsets_meta_value.IsStale()) {
       return Status::NotFound("Stale");
     } else if (parsed_zsets_meta_value.count() == 0) {
       return Status::NotFound();
     } else {
       std::string data_value;
-      ZSetsMemberKey zsets_member_key(key, version, member);
+      ZSetsMemberKey zsets_member_key(data_owner, version, member);
       s = db_->Get(read_options, handles_[1],
           zsets_member_key.Encode(), &data_value);
       if (s.ok()) {
@@ -1141,7 +1307,8 @@ Status RedisZSets::ZUnionstore(const Slice& destination,
         double score = 0;
         double weight = idx < weights.size() ? weights[idx] : 1;
         version = parsed_zsets_meta_value.version();
-        ZSetsScoreKey zsets_score_key(keys[idx], version,
+        Slice data_owner = parsed_zsets_meta_value.data_owner(keys[idx]);
+        ZSetsScoreKey zsets_score_key(data_owner, version,
             std::numeric_limits<double>::lowest(), Slice());
         rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[2]);
         for (iter->Seek(zsets_score_key.Encode());
@@ -1174,14 +1341,14 @@ Status RedisZSets::ZUnionstore(const Slice& destination,
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
     statistic = parsed_zsets_meta_value.count();
-    version = parsed_zsets_meta_value.InitialMetaValue();
+    version = parsed_zsets_meta_value.InitialMetaValue(version_floor());
     parsed_zsets_meta_value.set_count(member_score_map.size());
     batch.Put(handles_[0], destination, meta_value);
   } else {
     char buf[4];
     EncodeFixed32(buf, member_score_map.size());
     ZSetsMetaValue zsets_meta_value(Slice(buf, sizeof(int32_t)));
-    version = zsets_meta_value.UpdateVersion();
+    version = zsets_meta_value.UpdateVersion(version_floor());
     batch.Put(handles_[0], destination, zsets_meta_value.Encode());
   }
 
@@ -1240,7 +1407,9 @@ Status RedisZSets::ZInterstore(const Slice& destination,
         || parsed_zsets_meta_value.count() == 0) {
         have_invalid_zsets = true;
       } else {
-        vaild_zsets.push_back({keys[idx], parsed_zsets_meta_value.version()});
+        vaild_zsets.push_back(
+            {parsed_zsets_meta_value.data_owner(keys[idx]).ToString(),
+             parsed_zsets_meta_value.version()});
         if (idx == 0) {
           stop_index = parsed_zsets_meta_value.count() - 1;
         }
@@ -1303,14 +1472,14 @@ Status RedisZSets::ZInterstore(const Slice& destination,
   if (s.ok()) {
     ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
     statistic = parsed_zsets_meta_value.count();
-    version = parsed_zsets_meta_value.InitialMetaValue();
+    version = parsed_zsets_meta_value.InitialMetaValue(version_floor());
     parsed_zsets_meta_value.set_count(final_score_members.size());
     batch.Put(handles_[0], destination, meta_value);
   } else {
     char buf[4];
     EncodeFixed32(buf, final_score_members.size());
     ZSetsMetaValue zsets_meta_value(Slice(buf, sizeof(int32_t)));
-    version = zsets_meta_value.UpdateVersion();
+    version = zsets_meta_value.UpdateVersion(version_floor());
     batch.Put(handles_[0], destination, zsets_meta_value.Encode());
   }
   char score_buf[8];
@@ -1356,9 +1525,10 @@ Status RedisZSets::ZRangebylex(const Slice& key,
       return Status::NotFound();
     } else {
       int32_t version = parsed_zsets_meta_value.version();
+      Slice data_owner = parsed_zsets_meta_value.data_owner(key);
       int32_t cur_index = 0;
       int32_t stop_index = parsed_zsets_meta_value.count() - 1;
-      ZSetsMemberKey zsets_member_key(key, version, Slice());
+      ZSetsMemberKey zsets_member_key(data_owner, version, Slice());
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(zsets_member_key.Encode());
            iter->Valid() && cur_index <= stop_index;
@@ -1431,9 +1601,10 @@ Status RedisZSets::ZRemrangebylex(const Slice& key,
       return Status::NotFound();
     } else {
       int32_t version = parsed_zsets_meta_value.version();
+      Slice data_owner = parsed_zsets_meta_value.data_owner(key);
       int32_t cur_index = 0;
       int32_t stop_index = parsed_zsets_meta_value.count() - 1;
-      ZSetsMemberKey zsets_member_key(key, version, Slice());
+      ZSetsMemberKey zsets_member_key(data_owner, version, Slice());
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(zsets_member_key.Encode());
            iter->Valid() && cur_index <= stop_index;
@@ -1458,7 +1629,7 @@ Status RedisZSets::ZRemrangebylex(const Slice& key,
           uint64_t tmp = DecodeFixed64(iter->value().data());
           const void* ptr_tmp = reinterpret_cast<const void*>(&tmp);
           double score = *reinterpret_cast<const double*>(ptr_tmp);
-          ZSetsScoreKey zsets_score_key(key, version, score, member);
+          ZSetsScoreKey zsets_score_key(data_owner, version, score, member);
           batch.Delete(handles_[2], zsets_score_key.Encode());
           del_cnt++;
           statistic++;
@@ -1482,6 +1653,68 @@ Status RedisZSets::ZRemrangebylex(const Slice& key,
   return s;
 }
 
+Status RedisZSets::GeoSearch(const Slice& key, const GeoShape& shape,
+                             int64_t count, std::vector<GeoPoint>* points) {
+  points->clear();
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot = nullptr;
+
+  std::string meta_value;
+  ScopeSnapshot ss(db_, &snapshot);
+  read_options.snapshot = snapshot;
+  Status s = db_->Get(read_options, handles_[0], key, &meta_value);
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
+  if (parsed_zsets_meta_value.IsStale()) {
+    return Status::NotFound("Stale");
+  } else if (parsed_zsets_meta_value.count() == 0) {
+    return Status::NotFound();
+  }
+
+  // Each score range of the cells around shape is one bounded seek, and
+  // only the members in shape are returned
+  std::vector<std::pair<uint64_t, uint64_t>> ranges;
+  GeoHashSearchRanges(shape, &ranges);
+  int32_t version = parsed_zsets_meta_value.version();
+  Slice data_owner = parsed_zsets_meta_value.data_owner(key);
+  GeoPoint point;
+  rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[2]);
+  for (const auto& range : ranges) {
+    ZSetsScoreKey zsets_score_key(data_owner, version,
+        static_cast<double>(range.first), Slice());
+    for (iter->Seek(zsets_score_key.Encode());
+         iter->Valid();
+         iter->Next()) {
+      ParsedZSetsScoreKey parsed_zsets_score_key(iter->key());
+      if (parsed_zsets_score_key.key() != data_owner
+        || parsed_zsets_score_key.version() != version
+        || parsed_zsets_score_key.score() >= range.second) {
+        break;
+      }
+      GeoHashDecode(static_cast<uint64_t>(parsed_zsets_score_key.score()),
+          &point.longitude, &point.latitude);
+      if (GeoHashInShape(shape, point.longitude,
+            point.latitude, &point.distance)) {
+        point.member = parsed_zsets_score_key.member().ToString();
+        points->push_back(point);
+      }
+    }
+  }
+  s = iter->status();
+  delete iter;
+
+  std::sort(points->begin(), points->end(),
+            [](const GeoPoint& a, const GeoPoint& b) {
+              return a.distance < b.distance;
+            });
+  if (count > 0 && points->size() > static_cast<size_t>(count)) {
+    points->resize(count);
+  }
+  return s;
+}
+
 Status RedisZSets::Expire(const Slice& key, int32_t ttl) {
   std::string meta_value;
   ScopeRecordLock l(lock_mgr_, key);
@@ -1497,7 +1730,7 @@ Status RedisZSets::Expire(const Slice& key, int32_t ttl) {
     if (ttl > 0) {
       parsed_zsets_meta_value.SetRelativeTimestamp(ttl);
     } else {
-      parsed_zsets_meta_value.InitialMetaValue();
+      parsed_zsets_meta_value.InitialMetaValue(version_floor());
     }
     s = db_->Put(default_write_options_, handles_[0], key, meta_value);
   }
@@ -1516,7 +1749,7 @@ Status RedisZSets::Del(const Slice& key) {
       return Status::NotFound();
     } else {
       uint32_t statistic = parsed_zsets_meta_value.count();
-      parsed_zsets_meta_value.InitialMetaValue();
+      parsed_zsets_meta_value.InitialMetaValue(version_floor());
       s = db_->Put(default_write_options_, handles_[0], key, meta_value);
       UpdateSpecificKeyStatistics(key.ToString(), statistic);
     }
@@ -1584,7 +1817,7 @@ Status RedisZSets::Expireat(const Slice& key, int32_t timestamp) {
       if (timestamp > 0) {
         parsed_zsets_meta_value.set_timestamp(timestamp);
       } else {
-        parsed_zsets_meta_value.InitialMetaValue();
+        parsed_zsets_meta_value.InitialMetaValue(version_floor());
       }
       return db_->Put(default_write_options_, handles_[0], key, meta_value);
     }
@@ -1624,6 +1857,7 @@ Status RedisZSets::ZScan(const Slice& key,
       std::string sub_member;
       std::string start_point;
       int32_t version = parsed_zsets_meta_value.version();
+      Slice data_owner = parsed_zsets_meta_value.data_owner(key);
       s = GetScanStartPoint(key, pattern, cursor, &start_point);
       if (s.IsNotFound()) {
         cursor = 0;
@@ -1635,8 +1869,8 @@ Status RedisZSets::ZScan(const Slice& key,
         sub_member = pattern.substr(0, pattern.size() - 1);
       }
 
-      ZSetsMemberKey zsets_member_prefix(key, version, sub_member);
-      ZSetsMemberKey zsets_member_key(key, version, start_point);
+      ZSetsMemberKey zsets_member_prefix(data_owner, version, sub_member);
+      ZSetsMemberKey zsets_member_key(data_owner, version, start_point);
       std::string prefix = zsets_member_prefix.Encode().ToString();
       rocksdb::Iterator* iter = db_->NewIterator(read_options, handles_[1]);
       for (iter->Seek(zsets_member_key.Encode());
@@ -1851,6 +2085,244 @@ Status RedisZSets::TTL(const Slice& key, int64_t* timestamp) {
   return s;
 }
 
+Status RedisZSets::Rename(const Slice& key, const Slice& newkey, bool nx) {
+  std::string meta_value;
+  MultiScopeRecordLock ml(lock_mgr_, {key.ToString(), newkey.ToString()});
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
+  if (parsed_zsets_meta_value.IsStale()) {
+    return Status::NotFound("Stale");
+  } else if (parsed_zsets_meta_value.count() == 0) {
+    return Status::NotFound();
+  } else if (key == newkey) {
+    return nx ? Status::Busy("newkey exists") : Status::OK();
+  }
+
+  // newkey reads the data keys of the origin from now on, without
+  // moving them, the versions it used before are never used again
+  int32_t last_own_version = 0;
+  std::string new_meta_value;
+  s = db_->Get(default_read_options_, handles_[0], newkey, &new_meta_value);
+  if (s.ok()) {
+    ParsedZSetsMetaValue parsed_new_meta_value(&new_meta_value);
+    if (nx && !parsed_new_meta_value.IsStale()
+      && parsed_new_meta_value.count() != 0) {
+      return Status::Busy("newkey exists");
+    }
+    last_own_version = parsed_new_meta_value.last_own_version();
+  } else if (!s.IsNotFound()) {
+    return s;
+  }
+  int32_t version = parsed_zsets_meta_value.version();
+  std::string origin = parsed_zsets_meta_value.data_owner(key).ToString();
+  new_meta_value = meta_value;
+  ParsedZSetsMetaValue parsed_new_meta_value(&new_meta_value);
+  parsed_new_meta_value.SetOrigin(origin, last_own_version);
+
+  rocksdb::WriteBatch batch;
+  batch.Put(handles_[0], newkey, new_meta_value);
+  OriginRefKey origin_ref_key(origin, version, newkey);
+  batch.Put(handles_.back(), origin_ref_key.Encode(), Slice());
+  // key is initialized instead of deleted, so that its new version never
+  // collides with the version read by newkey
+  parsed_zsets_meta_value.InitialMetaValue(version_floor());
+  batch.Put(handles_[0], key, meta_value);
+  return db_->Write(default_write_options_, &batch);
+}
+
+Status RedisZSets::Copy(const Slice& key, const Slice& newkey,
+                        bool replace) {
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot;
+
+  std::string meta_value;
+  MultiScopeRecordLock ml(lock_mgr_, {key.ToString(), newkey.ToString()});
+  ScopeSnapshot ss(db_, &snapshot);
+  read_options.snapshot = snapshot;
+  Status s = db_->Get(read_options, handles_[0], key, &meta_value);
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
+  if (parsed_zsets_meta_value.IsStale()) {
+    return Status::NotFound("Stale");
+  } else if (parsed_zsets_meta_value.count() == 0) {
+    return Status::NotFound();
+  } else if (key == newkey) {
+    return Status::OK();
+  }
+
+  uint32_t statistic = 0;
+  int32_t new_version = 0;
+  std::string new_meta_value;
+  s = db_->Get(read_options, handles_[0], newkey, &new_meta_value);
+  if (s.ok()) {
+    ParsedZSetsMetaValue parsed_new_meta_value(&new_meta_value);
+    if (!replace && !parsed_new_meta_value.IsStale()
+      && parsed_new_meta_value.count() != 0) {
+      return Status::Busy("newkey exists");
+    }
+    if (!parsed_new_meta_value.IsStale()) {
+      statistic = parsed_new_meta_value.count();
+    }
+    new_version = parsed_new_meta_value.InitialMetaValue(version_floor());
+  } else if (s.IsNotFound()) {
+    char str[4];
+    EncodeFixed32(str, 0);
+    ZSetsMetaValue zsets_meta_value(Slice(str, sizeof(int32_t)));
+    new_version = zsets_meta_value.UpdateVersion(version_floor());
+    new_meta_value = zsets_meta_value.Encode().ToString();
+  } else {
+    return s;
+  }
+  // The empty meta of the new version goes first, the elements written
+  // by the batches before the last one are invisible until the last
+  // batch counts them in the meta, as Restore does
+  rocksdb::WriteBatch batch;
+  batch.Put(handles_[0], newkey, new_meta_value);
+  int32_t version = parsed_zsets_meta_value.version();
+  Slice data_owner = parsed_zsets_meta_value.data_owner(key);
+  ZSetsMemberKey zsets_member_key(data_owner, version, Slice());
+  Slice prefix = zsets_member_key.Encode();
+  auto iter = db_->NewIterator(read_options, handles_[1]);
+  for (iter->Seek(prefix);
+       iter->Valid() && iter->key().starts_with(prefix);
+       iter->Next()) {
+    ParsedZSetsMemberKey parsed_zsets_member_key(iter->key());
+    ZSetsMemberKey new_zsets_member_key(newkey, new_version,
+        parsed_zsets_member_key.member());
+    batch.Put(handles_[1], new_zsets_member_key.Encode(), iter->value());
+    // The score key is rebuilt from the score stored in data_cf
+    uint64_t tmp = DecodeFixed64(iter->value().data());
+    const void* ptr_tmp = reinterpret_cast<const void*>(&tmp);
+    double score = *reinterpret_cast<const double*>(ptr_tmp);
+    ZSetsScoreKey zsets_score_key(newkey, new_version,
+        score, parsed_zsets_member_key.member());
+    batch.Put(handles_[2], zsets_score_key.Encode(), Slice());
+    if (batch.GetDataSize() >= kRestoreBatchBytes) {
+      s = db_->Write(default_write_options_, &batch);
+      if (!s.ok()) {
+        delete iter;
+        return s;
+      }
+      batch.Clear();
+    }
+  }
+  s = iter->status();
+  delete iter;
+  if (!s.ok()) {
+    return s;
+  }
+  ParsedZSetsMetaValue parsed_new_meta_value(&new_meta_value);
+  parsed_new_meta_value.set_count(parsed_zsets_meta_value.count());
+  parsed_new_meta_value.set_timestamp(parsed_zsets_meta_value.timestamp());
+  batch.Put(handles_[0], newkey, new_meta_value);
+  s = db_->Write(default_write_options_, &batch);
+  UpdateSpecificKeyStatistics(newkey.ToString(), statistic);
+  return s;
+}
+
+Status RedisZSets::Dump(const Slice& key, DumpWriter* writer) {
+  rocksdb::ReadOptions read_options;
+  const rocksdb::Snapshot* snapshot;
+
+  std::string meta_value;
+  ScopeSnapshot ss(db_, &snapshot);
+  read_options.snapshot = snapshot;
+  read_options.fill_cache = false;
+  Status s = db_->Get(read_options, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
+    if (parsed_zsets_meta_value.IsStale()) {
+      return Status::NotFound("Stale");
+    } else if (parsed_zsets_meta_value.count() == 0) {
+      return Status::NotFound();
+    }
+    writer->Begin(kZSets);
+    int32_t version = parsed_zsets_meta_value.version();
+    Slice data_owner = parsed_zsets_meta_value.data_owner(key);
+    ZSetsMemberKey zsets_member_key(data_owner, version, Slice());
+    Slice prefix = zsets_member_key.Encode();
+    auto iter = db_->NewIterator(read_options, handles_[1]);
+    bool within_limit = true;
+    for (iter->Seek(prefix);
+         within_limit && iter->Valid() && iter->key().starts_with(prefix);
+         iter->Next()) {
+      ParsedZSetsMemberKey parsed_zsets_member_key(iter->key());
+      uint64_t tmp = DecodeFixed64(iter->value().data());
+      const void* ptr_tmp = reinterpret_cast<const void*>(&tmp);
+      double score = *reinterpret_cast<const double*>(ptr_tmp);
+      within_limit = writer->AddScoreMember(score,
+          parsed_zsets_member_key.member());
+    }
+    s = iter->status();
+    delete iter;
+  }
+  return s;
+}
+
+Status RedisZSets::Restore(const Slice& key, DumpReader* reader,
+                           int32_t ttl, bool replace) {
+  int32_t version = 0;
+  std::string meta_value;
+  ScopeRecordLock l(lock_mgr_, key);
+  Status s = db_->Get(default_read_options_, handles_[0], key, &meta_value);
+  if (s.ok()) {
+    ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
+    if (!replace && !parsed_zsets_meta_value.IsStale()
+      && parsed_zsets_meta_value.count() != 0) {
+      return Status::Busy("Target key name already exists");
+    }
+    version = parsed_zsets_meta_value.InitialMetaValue(version_floor());
+  } else if (s.IsNotFound()) {
+    char str[4];
+    EncodeFixed32(str, 0);
+    ZSetsMetaValue zsets_meta_value(Slice(str, sizeof(int32_t)));
+    version = zsets_meta_value.UpdateVersion(version_floor());
+    meta_value = zsets_meta_value.Encode().ToString();
+  } else {
+    return s;
+  }
+
+  // The empty meta of the new version goes first, the elements written
+  // by the batches before the last one are invisible until the last
+  // batch counts them in the meta
+  rocksdb::WriteBatch batch;
+  batch.Put(handles_[0], key, meta_value);
+  ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
+  char score_buf[8];
+  double score;
+  Slice member;
+  while (reader->NextScoreMember(&score, &member)) {
+    const void* ptr_score = reinterpret_cast<const void*>(&score);
+    EncodeFixed64(score_buf, *reinterpret_cast<const uint64_t*>(ptr_score));
+    ZSetsMemberKey zsets_member_key(key, version, member);
+    batch.Put(handles_[1], zsets_member_key.Encode(),
+        Slice(score_buf, sizeof(uint64_t)));
+    ZSetsScoreKey zsets_score_key(key, version, score, member);
+    batch.Put(handles_[2], zsets_score_key.Encode(), Slice());
+    parsed_zsets_meta_value.ModifyCount(1);
+    if (batch.GetDataSize() >= kRestoreBatchBytes) {
+      s = db_->Write(default_write_options_, &batch);
+      if (!s.ok()) {
+        return s;
+      }
+      batch.Clear();
+    }
+  }
+  if (!reader->Done()) {
+    return Status::Corruption("Malformed zsets dump");
+  }
+  if (ttl > 0) {
+    parsed_zsets_meta_value.SetRelativeTimestamp(ttl);
+  }
+  batch.Put(handles_[0], key, meta_value);
+  return db_->Write(default_write_options_, &batch);
+}
+
 void RedisZSets::ScanDatabase() {
   rocksdb::ReadOptions iterator_options;
   const rocksdb::Snapshot* snapshot;
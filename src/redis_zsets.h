@@ -12,6 +12,7 @@
 
 #include "src/redis.h"
 #include "src/custom_comparator.h"
+#include "src/base_meta_value_format.h"
 
 namespace blackwidow {
 
@@ -36,6 +37,9 @@ class RedisZSets : public Redis {
   Status ZAdd(const Slice& key,
               const std::vector<ScoreMember>& score_members,
               int32_t* ret);
+  Status ZAddCapped(const Slice& key,
+                    const std::vector<ScoreMember>& score_members,
+                    int32_t cap, int32_t* ret);
   Status ZCard(const Slice& key, int32_t* card);
   Status ZCount(const Slice& key,
                 double min,
@@ -140,6 +144,10 @@ class RedisZSets : public Redis {
 		 const int64_t count,
  		 std::vector<ScoreMember>* score_members);
 
+  // Geo Commands
+  Status GeoSearch(const Slice& key, const GeoShape& shape,
+                   int64_t count, std::vector<GeoPoint>* points);
+
   // Keys Commands
   Status Expire(const Slice& key, int32_t ttl) override;
   Status Del(const Slice& key) override;
@@ -149,12 +157,29 @@ class RedisZSets : public Redis {
   Status Expireat(const Slice& key, int32_t timestamp) override;
   Status Persist(const Slice& key) override;
   Status TTL(const Slice& key, int64_t* timestamp) override;
+  Status Rename(const Slice& key, const Slice& newkey, bool nx) override;
+  Status Copy(const Slice& key, const Slice& newkey, bool replace) override;
+  Status Dump(const Slice& key, DumpWriter* writer) override;
+  Status Restore(const Slice& key, DumpReader* reader,
+                 int32_t ttl, bool replace) override;
 
   // Iterate all data
   void ScanDatabase();
 
  private:
+  // handles_[3] is the origin_cf, it is always the last one
   std::vector<rocksdb::ColumnFamilyHandle*> handles_;
+
+  // A cap of 0 keeps the cap the zset already has
+  Status AddMembers(const Slice& key,
+                    const std::vector<ScoreMember>& score_members,
+                    int32_t cap, int32_t* ret);
+  // Evict the lowest ranked members of a capped zset beyond its cap,
+  // written are the members batch already puts
+  Status TrimCappedZSet(const Slice& data_owner, int32_t version,
+                        std::vector<ScoreMember>* written,
+                        ParsedZSetsMetaValue* parsed_zsets_meta_value,
+                        rocksdb::WriteBatch* batch, uint32_t* statistic);
 };
 
 }  // namespace blackwidow
@@ -0,0 +1,120 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_SLOT_KEY_FORMAT_H_
+#define SRC_SLOT_KEY_FORMAT_H_
+
+#include <string>
+#include <vector>
+
+#include "rocksdb/slice.h"
+#include "blackwidow/util.h"
+
+namespace blackwidow {
+
+/*
+ * With BlackwidowOptions::slot_tagged_keys every key is stored as
+ *
+ * | slot | key |
+ *    2B
+ *
+ * the big endian slot sorts the meta keys (and the strings keys) of one
+ * hash slot next to each other, so that a slot is a key range
+ */
+const size_t kSlotTagLength = 2;
+
+inline void AppendSlotTag(uint32_t slot, std::string* dst) {
+  dst->push_back(static_cast<char>((slot >> 8) & 0xff));
+  dst->push_back(static_cast<char>(slot & 0xff));
+}
+
+// The first key of slot, the first key of slot + 1 ends the range
+inline std::string SlotStartKey(uint32_t slot) {
+  std::string start_key;
+  AppendSlotTag(slot, &start_key);
+  return start_key;
+}
+
+inline rocksdb::Slice StripSlotTag(const rocksdb::Slice& tagged_key) {
+  if (tagged_key.size() < kSlotTagLength) {
+    return rocksdb::Slice();
+  }
+  return rocksdb::Slice(tagged_key.data() + kSlotTagLength,
+                        tagged_key.size() - kSlotTagLength);
+}
+
+/*
+ * With BlackwidowOptions::databases > 1 every key is stored as
+ *
+ * | db tag | key |
+ *     2B
+ *
+ * the tag is 0x80 | the high 7 bits and 0x80 | the low 7 bits of the
+ * database id, it sorts the keys of one database next to each other and
+ * never hits a special character of the glob patterns. The tag has the
+ * length of the slot tag, so the tagged keys are stripped the same way
+ */
+// The tag of the last database + 1 bounds its range
+const uint32_t kMaxDatabases = (1 << 14) - 1;
+
+inline void AppendDBTag(uint32_t db, std::string* dst) {
+  dst->push_back(static_cast<char>(0x80 | ((db >> 7) & 0x7f)));
+  dst->push_back(static_cast<char>(0x80 | (db & 0x7f)));
+}
+
+// The first key of db, the first key of db + 1 ends the range
+inline std::string DBStartKey(uint32_t db) {
+  std::string start_key;
+  AppendDBTag(db, &start_key);
+  return start_key;
+}
+
+// Strip the keys of tagged_keys from the start_pos-th one
+inline void StripSlotTags(std::vector<std::string>* tagged_keys,
+                          size_t start_pos = 0) {
+  for (size_t idx = start_pos; idx < tagged_keys->size(); ++idx) {
+    (*tagged_keys)[idx].erase(0, kSlotTagLength);
+  }
+}
+
+// Converted to the key stored in the db, the tag is only built when
+// the layout is enabled
+class SlotTaggedKey {
+ public:
+  SlotTaggedKey(bool tagged, const rocksdb::Slice& key) :
+    tagged_(tagged),
+    key_(key) {
+    if (tagged_) {
+      tagged_key_.reserve(kSlotTagLength + key.size());
+      AppendSlotTag(KeyHashSlot(key.data(), key.size()), &tagged_key_);
+      tagged_key_.append(key.data(), key.size());
+    }
+  }
+
+  // Behind the tag of its database instead of its slot
+  SlotTaggedKey(uint32_t db, const rocksdb::Slice& key) :
+    tagged_(true),
+    key_(key) {
+    tagged_key_.reserve(kSlotTagLength + key.size());
+    AppendDBTag(db, &tagged_key_);
+    tagged_key_.append(key.data(), key.size());
+  }
+
+  operator rocksdb::Slice() const {
+    return tagged_ ? rocksdb::Slice(tagged_key_) : key_;
+  }
+
+  std::string ToString() const {
+    return tagged_ ? tagged_key_ : key_.ToString();
+  }
+
+ private:
+  bool tagged_;
+  rocksdb::Slice key_;
+  std::string tagged_key_;
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_SLOT_KEY_FORMAT_H_
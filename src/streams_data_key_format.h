@@ -0,0 +1,158 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_STREAMS_DATA_KEY_FORMAT_H_
+#define SRC_STREAMS_DATA_KEY_FORMAT_H_
+
+#include <string>
+#include <vector>
+
+#include "src/coding.h"
+#include "blackwidow/blackwidow.h"
+
+namespace blackwidow {
+
+const size_t kStreamIDLength = sizeof(uint64_t) * 2;
+
+// The ids are big-endian, so the entries of one version of a stream are
+// in id order in the bytewise ordered data_cf
+inline void EncodeStreamID(char* buf, const StreamID& id) {
+  for (size_t idx = 0; idx < sizeof(uint64_t); ++idx) {
+    buf[idx] = static_cast<char>(id.ms >> (56 - idx * 8));
+    buf[sizeof(uint64_t) + idx] = static_cast<char>(id.seq >> (56 - idx * 8));
+  }
+}
+
+inline StreamID DecodeStreamID(const char* ptr) {
+  StreamID id;
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(ptr);
+  for (size_t idx = 0; idx < sizeof(uint64_t); ++idx) {
+    id.ms = (id.ms << 8) | bytes[idx];
+    id.seq = (id.seq << 8) | bytes[sizeof(uint64_t) + idx];
+  }
+  return id;
+}
+
+// All the fields of an entry are packed in the value of its data key:
+// | field_len | field | value_len | value | ...
+// with varint lengths
+inline void EncodeStreamEntryValue(const std::vector<FieldValue>& fvs,
+                                   std::string* value) {
+  value->clear();
+  for (const auto& fv : fvs) {
+    PutLengthPrefixedSlice(value, fv.field);
+    PutLengthPrefixedSlice(value, fv.value);
+  }
+}
+
+inline bool DecodeStreamEntryValue(const Slice& value,
+                                   std::vector<FieldValue>* fvs) {
+  Slice input(value), field, field_value;
+  fvs->clear();
+  while (!input.empty()) {
+    if (!GetLengthPrefixedSlice(&input, &field)
+      || !GetLengthPrefixedSlice(&input, &field_value)) {
+      return false;
+    }
+    fvs->push_back({field.ToString(), field_value.ToString()});
+  }
+  return true;
+}
+
+/*
+ * | key_len | key | version | id_ms | id_seq |
+ *     4B             4B        8B       8B
+ */
+class StreamsDataKey {
+ public:
+  StreamsDataKey(const Slice& key, int32_t version, const StreamID& id) :
+    start_(nullptr), key_(key), version_(version), id_(id) {
+  }
+
+  ~StreamsDataKey() {
+    if (start_ != space_) {
+      delete[] start_;
+    }
+  }
+
+  const Slice Encode() {
+    size_t usize = key_.size();
+    size_t needed = usize + sizeof(int32_t) * 2 + kStreamIDLength;
+    char* dst;
+    if (needed <= sizeof(space_)) {
+      dst = space_;
+    } else {
+      dst = new char[needed];
+
+      // Need to allocate space, delete previous space
+      if (start_ != space_) {
+        delete[] start_;
+      }
+    }
+    start_ = dst;
+    EncodeFixed32(dst, key_.size());
+    dst += sizeof(int32_t);
+    memcpy(dst, key_.data(), key_.size());
+    dst += key_.size();
+    EncodeFixed32(dst, version_);
+    dst += sizeof(int32_t);
+    EncodeStreamID(dst, id_);
+    return Slice(start_, needed);
+  }
+
+ private:
+  char space_[200];
+  char* start_;
+  Slice key_;
+  int32_t version_;
+  StreamID id_;
+};
+
+class ParsedStreamsDataKey {
+ public:
+  explicit ParsedStreamsDataKey(const std::string* key) {
+    const char* ptr = key->data();
+    int32_t key_len = DecodeFixed32(ptr);
+    ptr += sizeof(int32_t);
+    key_ = Slice(ptr, key_len);
+    ptr += key_len;
+    version_ = DecodeFixed32(ptr);
+    ptr += sizeof(int32_t);
+    id_ = DecodeStreamID(ptr);
+  }
+
+  explicit ParsedStreamsDataKey(const Slice& key) {
+    const char* ptr = key.data();
+    int32_t key_len = DecodeFixed32(ptr);
+    ptr += sizeof(int32_t);
+    key_ = Slice(ptr, key_len);
+    ptr += key_len;
+    version_ = DecodeFixed32(ptr);
+    ptr += sizeof(int32_t);
+    id_ = DecodeStreamID(ptr);
+  }
+
+  virtual ~ParsedStreamsDataKey() = default;
+
+  Slice key() {
+    return key_;
+  }
+
+  int32_t version() {
+    return version_;
+  }
+
+  StreamID id() {
+    return id_;
+  }
+
+ private:
+  Slice key_;
+  int32_t version_;
+  StreamID id_;
+};
+
+}  //  namespace blackwidow
+#endif  // SRC_STREAMS_DATA_KEY_FORMAT_H_
@@ -0,0 +1,174 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_STREAMS_FILTER_H_
+#define SRC_STREAMS_FILTER_H_
+
+#include <string>
+#include <memory>
+#include <vector>
+
+#include "src/debug.h"
+#include "src/streams_meta_value_format.h"
+#include "src/streams_data_key_format.h"
+#include "src/origin_filter.h"
+#include "rocksdb/compaction_filter.h"
+
+namespace blackwidow {
+
+class StreamsMetaFilter : public rocksdb::CompactionFilter {
+ public:
+  StreamsMetaFilter() = default;
+  bool Filter(int level, const rocksdb::Slice& key,
+              const rocksdb::Slice& value,
+              std::string* new_value, bool* value_changed) const override {
+    int64_t unix_time;
+    rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+    int32_t cur_time = static_cast<int32_t>(unix_time);
+    ParsedStreamsMetaValue parsed_streams_meta_value(value);
+    Trace("==========================START==========================");
+    Trace("[StreamMetaFilter], key: %s, count = %lu, timestamp: %d, cur_time: %d, version: %d",
+          key.ToString().c_str(),
+          parsed_streams_meta_value.count(),
+          parsed_streams_meta_value.timestamp(),
+          cur_time,
+          parsed_streams_meta_value.version());
+
+    if (parsed_streams_meta_value.timestamp() != 0
+      && parsed_streams_meta_value.timestamp() < cur_time
+      && parsed_streams_meta_value.version() < cur_time) {
+      Trace("Drop[Stale & version < cur_time]");
+      return true;
+    }
+    if (parsed_streams_meta_value.count() == 0
+      && parsed_streams_meta_value.version() < cur_time) {
+      Trace("Drop[Empty & version < cur_time]");
+      return true;
+    }
+    Trace("Reserve");
+    return false;
+  }
+
+  const char* Name() const override { return "StreamsMetaFilter"; }
+};
+
+class StreamsMetaFilterFactory : public rocksdb::CompactionFilterFactory {
+ public:
+  StreamsMetaFilterFactory() = default;
+  std::unique_ptr<rocksdb::CompactionFilter> CreateCompactionFilter(
+    const rocksdb::CompactionFilter::Context& context) override {
+    return std::unique_ptr<rocksdb::CompactionFilter>(new StreamsMetaFilter());
+  }
+  const char* Name() const override {
+    return "StreamsMetaFilterFactory";
+  }
+};
+
+class StreamsDataFilter : public rocksdb::CompactionFilter {
+ public:
+  StreamsDataFilter(rocksdb::DB* db,
+                  std::vector<rocksdb::ColumnFamilyHandle*>* cf_handles_ptr) :
+    db_(db), cf_handles_ptr_(cf_handles_ptr), meta_not_found_(false),
+    cur_meta_has_origin_(false), origin_ref_reader_(db, cf_handles_ptr) {}
+
+  bool Filter(int level, const rocksdb::Slice& key,
+              const rocksdb::Slice& value,
+              std::string* new_value, bool* value_changed) const override {
+    ParsedStreamsDataKey parsed_streams_data_key(key);
+    Trace("==========================START==========================");
+    Trace("[DataFilter], key: %s, id = %s, version = %d",
+          parsed_streams_data_key.key().ToString().c_str(),
+          parsed_streams_data_key.id().ToString().c_str(),
+          parsed_streams_data_key.version());
+
+    if (parsed_streams_data_key.key().ToString() != cur_key_) {
+      cur_key_ = parsed_streams_data_key.key().ToString();
+      std::string meta_value;
+      // destroyed when close the database, Reserve Current key value
+      if (cf_handles_ptr_->size() == 0) {
+        return false;
+      }
+      Status s = db_->Get(default_read_options_,
+              (*cf_handles_ptr_)[0], cur_key_, &meta_value);
+      if (s.ok()) {
+        meta_not_found_ = false;
+        ParsedStreamsMetaValue parsed_streams_meta_value(&meta_value);
+        cur_meta_version_ = parsed_streams_meta_value.version();
+        cur_meta_timestamp_ = parsed_streams_meta_value.timestamp();
+        cur_meta_has_origin_ = parsed_streams_meta_value.has_origin();
+      } else if (s.IsNotFound()) {
+        meta_not_found_ = true;
+      } else {
+        cur_key_ = "";
+        Trace("Reserve[Get meta_key faild]");
+        return false;
+      }
+    }
+
+    int64_t unix_time;
+    rocksdb::Env::Default()->GetCurrentTime(&unix_time);
+    const char* drop_reason = nullptr;
+    if (meta_not_found_) {
+      drop_reason = "Drop[Meta key not exist]";
+    } else if (cur_meta_has_origin_) {
+      drop_reason = "Drop[Meta key renamed from origin]";
+    } else if (cur_meta_timestamp_ != 0
+      && cur_meta_timestamp_ < static_cast<int32_t>(unix_time)) {
+      drop_reason = "Drop[Timeout]";
+    } else if (cur_meta_version_ > parsed_streams_data_key.version()) {
+      drop_reason = "Drop[stream_data_key_version < cur_meta_version]";
+    }
+
+    if (drop_reason == nullptr) {
+      Trace("Reserve[stream_data_key_version == cur_meta_version]");
+      return false;
+    } else if (origin_ref_reader_.IsReferenced(parsed_streams_data_key.key(),
+                 parsed_streams_data_key.version())) {
+      Trace("Reserve[Read by renamed key]");
+      return false;
+    } else {
+      Trace("%s", drop_reason);
+      return true;
+    }
+  }
+
+  const char* Name() const override { return "StreamsDataFilter"; }
+
+ private:
+  rocksdb::DB* db_;
+  std::vector<rocksdb::ColumnFamilyHandle*>* cf_handles_ptr_;
+  rocksdb::ReadOptions default_read_options_;
+  mutable std::string cur_key_;
+  mutable bool meta_not_found_;
+  mutable int32_t cur_meta_version_;
+  mutable int32_t cur_meta_timestamp_;
+  mutable bool cur_meta_has_origin_;
+  mutable OriginRefReader<ParsedStreamsMetaValue> origin_ref_reader_;
+};
+
+class StreamsDataFilterFactory : public rocksdb::CompactionFilterFactory {
+ public:
+  StreamsDataFilterFactory(rocksdb::DB** db_ptr,
+                         std::vector<rocksdb::ColumnFamilyHandle*>* handles_ptr)
+    : db_ptr_(db_ptr), cf_handles_ptr_(handles_ptr) {}
+
+  std::unique_ptr<rocksdb::CompactionFilter> CreateCompactionFilter(
+      const rocksdb::CompactionFilter::Context& context) override {
+    return std::unique_ptr<rocksdb::CompactionFilter>(
+      new StreamsDataFilter(*db_ptr_, cf_handles_ptr_));
+  }
+  const char* Name() const override {
+    return "StreamsDataFilterFactory";
+  }
+
+ private:
+  rocksdb::DB** db_ptr_;
+  std::vector<rocksdb::ColumnFamilyHandle*>* cf_handles_ptr_;
+};
+
+typedef OriginRefFilterFactory<ParsedStreamsMetaValue> StreamsOriginFilterFactory;
+
+}  //  namespace blackwidow
+#endif  // SRC_STREAMS_FILTER_H_
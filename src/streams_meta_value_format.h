@@ -0,0 +1,107 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_STREAMS_META_VALUE_FORMAT_H_
+#define SRC_STREAMS_META_VALUE_FORMAT_H_
+
+#include <string>
+
+#include "src/base_meta_value_format.h"
+
+namespace blackwidow {
+
+/*
+ * | count | version | timestamp | last_id_ms | last_id_seq |
+ *     8B       4B         4B           8B            8B
+ *
+ * The last id is the greatest id ever added to the stream, the id of
+ * the next entry must be greater than it even after the entries with
+ * the greatest ids were deleted
+ */
+class StreamsMetaValue
+    : public MetaValue<StreamsMetaValue, 2 * sizeof(int64_t)> {
+ public:
+  explicit StreamsMetaValue(const Slice& user_value) :
+    MetaValue(user_value),
+    last_id_ms_(0),
+    last_id_seq_(0) {
+  }
+
+  void AppendExtra(char* dst) {
+    EncodeFixed64(dst, last_id_ms_);
+    dst += sizeof(int64_t);
+    EncodeFixed64(dst, last_id_seq_);
+  }
+
+ private:
+  uint64_t last_id_ms_;
+  uint64_t last_id_seq_;
+};
+
+class ParsedStreamsMetaValue : public ParsedMetaValue<ParsedStreamsMetaValue,
+    uint64_t, 2 * sizeof(int64_t), false> {
+ public:
+  // Use this constructor after rocksdb::DB::Get();
+  explicit ParsedStreamsMetaValue(std::string* internal_value_str) :
+    ParsedMetaValue(internal_value_str),
+    last_id_ms_(0),
+    last_id_seq_(0) {
+  }
+
+  // Use this constructor in rocksdb::CompactionFilter::Filter();
+  explicit ParsedStreamsMetaValue(const Slice& internal_value_slice) :
+    ParsedMetaValue(internal_value_slice),
+    last_id_ms_(0),
+    last_id_seq_(0) {
+  }
+
+  static const size_t kStreamsMetaValueSuffixLength = kMetaValueSuffixLength;
+
+  void DecodeExtra() {
+    if (decoded_ & kExtraDecoded) {
+      return;
+    }
+    decoded_ |= kExtraDecoded;
+    const char* extra = Extra();
+    if (extra != nullptr) {
+      last_id_ms_ = DecodeFixed64(extra);
+      last_id_seq_ = DecodeFixed64(extra + sizeof(int64_t));
+    }
+  }
+
+  void InitialExtra() {
+    set_last_id(0, 0);
+  }
+
+  uint64_t last_id_ms() {
+    DecodeExtra();
+    return last_id_ms_;
+  }
+
+  uint64_t last_id_seq() {
+    DecodeExtra();
+    return last_id_seq_;
+  }
+
+  void set_last_id(uint64_t ms, uint64_t seq) {
+    decoded_ |= kExtraDecoded;
+    last_id_ms_ = ms;
+    last_id_seq_ = seq;
+    if (value_ != nullptr) {
+      char* dst = const_cast<char*>(value_->data()) + value_->size() -
+        2 * sizeof(int64_t);
+      EncodeFixed64(dst, last_id_ms_);
+      dst += sizeof(int64_t);
+      EncodeFixed64(dst, last_id_seq_);
+    }
+  }
+
+ private:
+  uint64_t last_id_ms_;
+  uint64_t last_id_seq_;
+};
+
+}  //  namespace blackwidow
+#endif  //  SRC_STREAMS_META_VALUE_FORMAT_H_
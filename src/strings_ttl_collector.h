@@ -0,0 +1,109 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_STRINGS_TTL_COLLECTOR_H_
+#define SRC_STRINGS_TTL_COLLECTOR_H_
+
+#include <string>
+#include <limits>
+
+#include "rocksdb/listener.h"
+#include "rocksdb/table_properties.h"
+
+#include "src/coding.h"
+#include "src/strings_value_format.h"
+#include "blackwidow/blackwidow.h"
+
+namespace blackwidow {
+
+// The latest expire time of all the entries in the table file, the
+// file can be dropped as a whole once it is in the past
+const std::string kStringsMaxExpireProperty = "blackwidow.strings.max-expire";
+
+class StringsTTLCollector : public rocksdb::TablePropertiesCollector {
+ public:
+  StringsTTLCollector() : max_expire_(0) {}
+
+  rocksdb::Status AddUserKey(const rocksdb::Slice& key,
+                             const rocksdb::Slice& value,
+                             rocksdb::EntryType type,
+                             rocksdb::SequenceNumber seq,
+                             uint64_t file_size) override {
+    // Deletions only shadow the entries in older files, which are
+    // always dropped before this one
+    if (type != rocksdb::kEntryPut) {
+      return rocksdb::Status::OK();
+    }
+    ParsedStringsValue parsed_strings_value(value);
+    if (parsed_strings_value.timestamp() == 0) {
+      max_expire_ = std::numeric_limits<int32_t>::max();
+    } else if (parsed_strings_value.timestamp() > max_expire_) {
+      max_expire_ = parsed_strings_value.timestamp();
+    }
+    return rocksdb::Status::OK();
+  }
+
+  rocksdb::Status Finish(rocksdb::UserCollectedProperties* properties) override {
+    char buf[sizeof(int32_t)];
+    EncodeFixed32(buf, max_expire_);
+    properties->insert({kStringsMaxExpireProperty,
+                        std::string(buf, sizeof(int32_t))});
+    return rocksdb::Status::OK();
+  }
+
+  rocksdb::UserCollectedProperties GetReadableProperties() const override {
+    return {{kStringsMaxExpireProperty, std::to_string(max_expire_)}};
+  }
+
+  const char* Name() const override { return "StringsTTLCollector"; }
+
+ private:
+  int32_t max_expire_;
+};
+
+class StringsTTLCollectorFactory
+  : public rocksdb::TablePropertiesCollectorFactory {
+ public:
+  StringsTTLCollectorFactory() = default;
+  rocksdb::TablePropertiesCollector* CreateTablePropertiesCollector(
+    rocksdb::TablePropertiesCollectorFactory::Context context) override {
+    return new StringsTTLCollector();
+  }
+  const char* Name() const override {
+    return "StringsTTLCollectorFactory";
+  }
+};
+
+// Return false if the table file is not collected by StringsTTLCollector
+inline bool GetStringsMaxExpire(const rocksdb::TableProperties& props,
+                                int32_t* max_expire) {
+  auto iter = props.user_collected_properties.find(kStringsMaxExpireProperty);
+  if (iter == props.user_collected_properties.end()
+    || iter->second.size() != sizeof(int32_t)) {
+    return false;
+  }
+  *max_expire = DecodeFixed32(iter->second.data());
+  return true;
+}
+
+// Every flush of the ttl column family may push the oldest table
+// file out of date, schedule a background check for it
+class StringsTTLFlushListener : public rocksdb::EventListener {
+ public:
+  explicit StringsTTLFlushListener(BlackWidow* const bw) : bw_(bw) {}
+
+  void OnFlushCompleted(rocksdb::DB* db,
+                        const rocksdb::FlushJobInfo& info) override {
+    if (info.cf_name == "ttl_cf") {
+      bw_->AddBGTask({kStrings, kDropExpiredFiles});
+    }
+  }
+
+ private:
+  BlackWidow* const bw_;
+};
+
+}  //  namespace blackwidow
+#endif  //  SRC_STRINGS_TTL_COLLECTOR_H_
@@ -9,72 +9,235 @@
 #include <string>
 
 #include "src/base_value_format.h"
+#include "blackwidow/util.h"
 
 namespace blackwidow {
 
-class StringsValue : public InternalValue {
+/*
+ * | value | timestamp |
+ *
+ * Counters written by the INCR-family commands keep the number in binary
+ * and are marked by the highest bit of the timestamp. A negative timestamp
+ * is stored as kStringsExpiredTimestamp, so that the bit is only ever set
+ * by the typed values, whose type byte is checked as well
+ *
+ * | number | type | timestamp(with kStringsTypedValueFlag) |
+ *      8       1                   4 Bytes
+ */
+enum StringsValueType {
+  kStringsRawValue = 0,
+  kStringsIntegerValue = 1,
+  kStringsDoubleValue = 2
+};
+
+static const uint32_t kStringsTypedValueFlag = 0x80000000;
+static const size_t kStringsTypedValueLength =
+  sizeof(uint64_t) + sizeof(uint8_t) + sizeof(int32_t);
+// Any timestamp in the past expires the value the same way
+static const int32_t kStringsExpiredTimestamp = 1;
+
+inline uint32_t EncodeStringsTimestamp(int32_t timestamp) {
+  return timestamp < 0 ? kStringsExpiredTimestamp
+    : static_cast<uint32_t>(timestamp);
+}
+
+class StringsValue : public InternalValue<StringsValue> {
  public:
   explicit StringsValue(const Slice& user_value) :
     InternalValue(user_value) {
   }
-  size_t AppendTimestampAndVersion() override {
+  static const size_t kValueSuffixLength = sizeof(int32_t);
+  size_t AppendTimestampAndVersion() {
     size_t usize = user_value_.size();
     char* dst = start_;
     memcpy(dst, user_value_.data(), usize);
     dst += usize;
-    EncodeFixed32(dst, timestamp_);
+    EncodeFixed32(dst, EncodeStringsTimestamp(timestamp_));
     return usize + sizeof(int32_t);
   }
 };
 
-class ParsedStringsValue : public ParsedInternalValue {
+class StringsTypedValue : public InternalValue<StringsTypedValue> {
+ public:
+  explicit StringsTypedValue(int64_t integer_value) :
+    InternalValue(Slice()),
+    type_(kStringsIntegerValue),
+    number_(static_cast<uint64_t>(integer_value)) {
+  }
+  explicit StringsTypedValue(double double_value) :
+    InternalValue(Slice()),
+    type_(kStringsDoubleValue) {
+    const void* ptr_tmp = reinterpret_cast<const void*>(&double_value);
+    number_ = *reinterpret_cast<const uint64_t*>(ptr_tmp);
+  }
+  static const size_t kValueSuffixLength = kStringsTypedValueLength;
+  size_t AppendTimestampAndVersion() {
+    char* dst = start_;
+    EncodeFixed64(dst, number_);
+    dst += sizeof(uint64_t);
+    *dst = static_cast<char>(type_);
+    dst += sizeof(uint8_t);
+    EncodeFixed32(dst,
+        EncodeStringsTimestamp(timestamp_) | kStringsTypedValueFlag);
+    return kStringsTypedValueLength;
+  }
+
+ private:
+  StringsValueType type_;
+  uint64_t number_;
+};
+
+class ParsedStringsValue : public ParsedInternalValue<ParsedStringsValue> {
  public:
   // Use this constructor after rocksdb::DB::Get();
   explicit ParsedStringsValue(std::string* internal_value_str) :
-    ParsedInternalValue(internal_value_str) {
-    if (internal_value_str->size() >= kStringsValueSuffixLength) {
-      user_value_ = Slice(internal_value_str->data(),
-          internal_value_str->size() - kStringsValueSuffixLength);
-      timestamp_ = DecodeFixed32(internal_value_str->data() +
-            internal_value_str->size() - kStringsValueSuffixLength);
-    }
+    ParsedInternalValue(internal_value_str),
+    type_(kStringsRawValue),
+    number_(0) {
   }
 
   // Use this constructor in rocksdb::CompactionFilter::Filter();
   explicit ParsedStringsValue(const Slice& internal_value_slice) :
-    ParsedInternalValue(internal_value_slice) {
-    if (internal_value_slice.size() >= kStringsValueSuffixLength) {
-      user_value_ = Slice(internal_value_slice.data(),
-          internal_value_slice.size() - kStringsValueSuffixLength);
-      timestamp_ = DecodeFixed32(internal_value_slice.data() +
-            internal_value_slice.size() - kStringsValueSuffixLength);
-    }
+    ParsedInternalValue(internal_value_slice),
+    type_(kStringsRawValue),
+    number_(0) {
   }
 
-  void StripSuffix() override {
+  void StripSuffix() {
+    DecodeSuffix();
     if (value_ != nullptr) {
-      value_->erase(value_->size() - kStringsValueSuffixLength,
-          kStringsValueSuffixLength);
+      if (type_ == kStringsRawValue) {
+        value_->erase(value_->size() - kStringsValueSuffixLength,
+            kStringsValueSuffixLength);
+      } else {
+        FormatNumber();
+        value_->assign(formatted_value_);
+      }
+      user_value_ = Slice(*value_);
     }
   }
 
   // Strings type do not have version field;
-  void SetVersionToValue() override {
+  int32_t DecodeVersion() {
+    return 0;
+  }
+
+  void SetVersionToValue() {
+  }
+
+  int32_t DecodeTimestamp() {
+    DecodeSuffix();
+    return timestamp_;
   }
 
-  void SetTimestampToValue() override {
+  void SetTimestampToValue() {
+    DecodeSuffix();
     if (value_ != nullptr) {
       char* dst = const_cast<char*>(value_->data()) + value_->size() -
         kStringsValueSuffixLength;
-      EncodeFixed32(dst, timestamp_);
+      if (type_ == kStringsRawValue) {
+        EncodeFixed32(dst, EncodeStringsTimestamp(timestamp_));
+      } else {
+        EncodeFixed32(dst,
+            EncodeStringsTimestamp(timestamp_) | kStringsTypedValueFlag);
+      }
     }
   }
 
-  Slice value() {
+  // Typed numbers are only formatted here, when the caller really
+  // needs the string representation
+  Slice user_value() {
+    DecodeSuffix();
+    if (type_ != kStringsRawValue) {
+      FormatNumber();
+      return Slice(formatted_value_);
+    }
     return user_value_;
   }
 
+  Slice value() {
+    return user_value();
+  }
+
+  StringsValueType type() {
+    DecodeSuffix();
+    return type_;
+  }
+
+  bool IsInteger() {
+    return type() == kStringsIntegerValue;
+  }
+
+  bool IsDouble() {
+    return type() == kStringsDoubleValue;
+  }
+
+  int64_t integer_value() {
+    DecodeSuffix();
+    return static_cast<int64_t>(number_);
+  }
+
+  double double_value() {
+    DecodeSuffix();
+    const void* ptr_tmp = reinterpret_cast<const void*>(&number_);
+    return *reinterpret_cast<const double*>(ptr_tmp);
+  }
+
   static const size_t kStringsValueSuffixLength = sizeof(int32_t);
+
+ private:
+  enum {
+    kSuffixDecoded = kFormatDecoded
+  };
+
+  // The suffix is one word, the type and the timestamp are decoded
+  // together from it unless the timestamp was set already
+  void DecodeSuffix() {
+    if (decoded_ & kSuffixDecoded) {
+      return;
+    }
+    decoded_ |= kSuffixDecoded;
+    Slice encoded = Encoded();
+    if (encoded.size() < kStringsValueSuffixLength) {
+      return;
+    }
+    const char* ptr = encoded.data() + encoded.size()
+      - kStringsValueSuffixLength;
+    uint32_t suffix = DecodeFixed32(ptr);
+    uint8_t type = encoded.size() == kStringsTypedValueLength
+      ? static_cast<uint8_t>(encoded.data()[sizeof(uint64_t)]) : 0;
+    if ((suffix & kStringsTypedValueFlag)
+      && (type == kStringsIntegerValue || type == kStringsDoubleValue)) {
+      type_ = static_cast<StringsValueType>(type);
+      number_ = DecodeFixed64(encoded.data());
+      suffix &= ~kStringsTypedValueFlag;
+    } else {
+      user_value_ = Slice(encoded.data(),
+          encoded.size() - kStringsValueSuffixLength);
+    }
+    if (!(decoded_ & kTimestampDecoded)) {
+      timestamp_ = static_cast<int32_t>(suffix);
+      decoded_ |= kTimestampDecoded;
+    }
+  }
+
+  void FormatNumber() {
+    if (!formatted_value_.empty()) {
+      return;
+    }
+    if (type_ == kStringsIntegerValue) {
+      char buf[32];
+      int len = Int64ToStr(buf, sizeof(buf), integer_value());
+      formatted_value_.assign(buf, len);
+    } else {
+      LongDoubleToStr(double_value(), &formatted_value_);
+    }
+  }
+
+  Slice user_value_;
+  StringsValueType type_;
+  uint64_t number_;
+  std::string formatted_value_;
 };
 
 }  //  namespace blackwidow
@@ -5,8 +5,12 @@
 
 #include <ctype.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <limits.h>
 
+#include <limits>
+
 #include "src/coding.h"
 #include "blackwidow/util.h"
 
@@ -298,20 +302,530 @@ int StringMatch(const char *pattern, int pattern_len, const char* str,
     return 0;
 }
 
+/* A decimal number split into its parts, the value is
+ * (negative ? -1 : 1) * significand * 10^exponent */
+struct DecimalNumber {
+  bool negative;
+  uint64_t significand;
+  int exponent;
+};
+
+/* At most 19 significant digits always fit in an uint64_t */
+static const int kMaxSignificantDigits = 19;
+static const int kMaxParsedExponent = 100000;
+
+/* Split a plain decimal number ([+-]digits[.digits][(e|E)[+-]digits]) into
+ * its parts. Returns false for anything else (hex, inf, nan, whitespace) and
+ * for numbers with too many significant digits, the caller should fall back
+ * to the libc parser then. */
+static bool ParseDecimal(const char* s, size_t slen, DecimalNumber* number) {
+  const char* p = s;
+  const char* end = s + slen;
+  bool has_digit = false;
+  int digits = 0;
+  number->negative = false;
+  number->significand = 0;
+  number->exponent = 0;
+
+  if (p < end && (*p == '-' || *p == '+')) {
+    number->negative = (*p == '-');
+    p++;
+  }
+  while (p < end && *p >= '0' && *p <= '9') {
+    has_digit = true;
+    if (number->significand != 0 || *p != '0') {
+      if (digits == kMaxSignificantDigits) return false;
+      number->significand = number->significand * 10 + (*p - '0');
+      digits++;
+    }
+    p++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && *p >= '0' && *p <= '9') {
+      has_digit = true;
+      if (number->significand != 0 || *p != '0') {
+        if (digits == kMaxSignificantDigits) return false;
+        number->significand = number->significand * 10 + (*p - '0');
+        digits++;
+      }
+      number->exponent--;
+      p++;
+    }
+  }
+  if (!has_digit) return false;
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool exponent_negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      exponent_negative = (*p == '-');
+      p++;
+    }
+    if (p == end || *p < '0' || *p > '9') return false;
+    int exponent = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+      if (exponent > kMaxParsedExponent) return false;
+      exponent = exponent * 10 + (*p - '0');
+      p++;
+    }
+    number->exponent += exponent_negative ? -exponent : exponent;
+  }
+  return p == end;
+}
+
+/* Powers of ten that are exactly representable in a long double with
+ * a 64 bit mantissa (5^27 < 2^64) */
+static const long double kExactPowersOfTen[] = {
+  1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L,
+  1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L,
+  1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L
+};
+
+/* When both the significand and the power of ten are exact in T, a single
+ * multiplication or division is correctly rounded, which is what strtod
+ * returns as well (Clinger's fast path). */
+template <typename T>
+static bool FastDecimalToFloat(const DecimalNumber& number, T* value) {
+  int mantissa_digits = std::numeric_limits<T>::digits;
+  int max_exponent = mantissa_digits >= 64 ? 27 : 22;
+  if (mantissa_digits < 64
+    && number.significand > (static_cast<uint64_t>(1) << mantissa_digits)) {
+    return false;
+  }
+  if (number.exponent > max_exponent || number.exponent < -max_exponent) {
+    return false;
+  }
+  T result = static_cast<T>(number.significand);
+  if (number.exponent >= 0) {
+    result *= static_cast<T>(kExactPowersOfTen[number.exponent]);
+  } else {
+    result /= static_cast<T>(kExactPowersOfTen[-number.exponent]);
+  }
+  *value = number.negative ? -result : result;
+  return true;
+}
+
+/* strtod and strtold need a null terminated string */
+class NullTerminatedString {
+ public:
+  NullTerminatedString(const char* s, size_t slen) {
+    if (slen < sizeof(space_)) {
+      memcpy(space_, s, slen);
+      space_[slen] = '\0';
+      str_ = space_;
+    } else {
+      buffer_.assign(s, slen);
+      str_ = buffer_.c_str();
+    }
+  }
+  const char* c_str() const { return str_; }
+
+ private:
+  char space_[64];
+  std::string buffer_;
+  const char* str_;
+};
+
 int StrToLongDouble(const char* s, size_t slen, long double* ldval) {
-    char *pEnd;
-    std::string t(s, slen);
-    if (t.find(" ") != std::string::npos) {
+    long double d;
+    DecimalNumber number;
+    if (ParseDecimal(s, slen, &number) && FastDecimalToFloat(number, &d)) {
+      if (ldval != NULL) *ldval = d;
+      return 0;
+    }
+
+    if (memchr(s, ' ', slen) != NULL) {
       return -1;
     }
-    long double d = strtold(s, &pEnd);
-    if (pEnd != s + slen)
+    char *pEnd;
+    NullTerminatedString str(s, slen);
+    d = strtold(str.c_str(), &pEnd);
+    if (pEnd != str.c_str() + slen)
         return -1;
 
     if (ldval != NULL) *ldval = d;
     return 0;
 }
 
+int StrToDouble(const char* s, size_t slen, double* dval) {
+    double d;
+    DecimalNumber number;
+    if (ParseDecimal(s, slen, &number) && FastDecimalToFloat(number, &d)) {
+      if (dval != NULL) *dval = d;
+      return 0;
+    }
+
+    if (memchr(s, ' ', slen) != NULL) {
+      return -1;
+    }
+    char *pEnd;
+    NullTerminatedString str(s, slen);
+    d = strtod(str.c_str(), &pEnd);
+    if (pEnd != str.c_str() + slen)
+        return -1;
+
+    if (dval != NULL) *dval = d;
+    return 0;
+}
+
+/* Grisu3, from Florian Loitsch, "Printing Floating-Point Numbers Quickly
+ * and Accurately with Integers". It generates the shortest digits that
+ * read back to the same double, and reports failure for the ~0.5% of
+ * doubles where it can not prove the result is the shortest. */
+struct DiyFp {
+  uint64_t f;
+  int e;
+};
+
+struct CachedPower {
+  uint64_t f;
+  int16_t e;
+  int16_t k;
+};
+
+/* Normalized 10^k for k in [-348, 340] with step 8, as f * 2^e */
+static const CachedPower kCachedPowers[] = {
+  {0xfa8fd5a0081c0288ULL, -1220, -348}, {0xbaaee17fa23ebf76ULL, -1193, -340},
+  {0x8b16fb203055ac76ULL, -1166, -332}, {0xcf42894a5dce35eaULL, -1140, -324},
+  {0x9a6bb0aa55653b2dULL, -1113, -316}, {0xe61acf033d1a45dfULL, -1087, -308},
+  {0xab70fe17c79ac6caULL, -1060, -300}, {0xff77b1fcbebcdc4fULL, -1034, -292},
+  {0xbe5691ef416bd60cULL, -1007, -284}, {0x8dd01fad907ffc3cULL, -980, -276},
+  {0xd3515c2831559a83ULL, -954, -268}, {0x9d71ac8fada6c9b5ULL, -927, -260},
+  {0xea9c227723ee8bcbULL, -901, -252}, {0xaecc49914078536dULL, -874, -244},
+  {0x823c12795db6ce57ULL, -847, -236}, {0xc21094364dfb5637ULL, -821, -228},
+  {0x9096ea6f3848984fULL, -794, -220}, {0xd77485cb25823ac7ULL, -768, -212},
+  {0xa086cfcd97bf97f4ULL, -741, -204}, {0xef340a98172aace5ULL, -715, -196},
+  {0xb23867fb2a35b28eULL, -688, -188}, {0x84c8d4dfd2c63f3bULL, -661, -180},
+  {0xc5dd44271ad3cdbaULL, -635, -172}, {0x936b9fcebb25c996ULL, -608, -164},
+  {0xdbac6c247d62a584ULL, -582, -156}, {0xa3ab66580d5fdaf6ULL, -555, -148},
+  {0xf3e2f893dec3f126ULL, -529, -140}, {0xb5b5ada8aaff80b8ULL, -502, -132},
+  {0x87625f056c7c4a8bULL, -475, -124}, {0xc9bcff6034c13053ULL, -449, -116},
+  {0x964e858c91ba2655ULL, -422, -108}, {0xdff9772470297ebdULL, -396, -100},
+  {0xa6dfbd9fb8e5b88fULL, -369, -92}, {0xf8a95fcf88747d94ULL, -343, -84},
+  {0xb94470938fa89bcfULL, -316, -76}, {0x8a08f0f8bf0f156bULL, -289, -68},
+  {0xcdb02555653131b6ULL, -263, -60}, {0x993fe2c6d07b7facULL, -236, -52},
+  {0xe45c10c42a2b3b06ULL, -210, -44}, {0xaa242499697392d3ULL, -183, -36},
+  {0xfd87b5f28300ca0eULL, -157, -28}, {0xbce5086492111aebULL, -130, -20},
+  {0x8cbccc096f5088ccULL, -103, -12}, {0xd1b71758e219652cULL, -77, -4},
+  {0x9c40000000000000ULL, -50, 4}, {0xe8d4a51000000000ULL, -24, 12},
+  {0xad78ebc5ac620000ULL, 3, 20}, {0x813f3978f8940984ULL, 30, 28},
+  {0xc097ce7bc90715b3ULL, 56, 36}, {0x8f7e32ce7bea5c70ULL, 83, 44},
+  {0xd5d238a4abe98068ULL, 109, 52}, {0x9f4f2726179a2245ULL, 136, 60},
+  {0xed63a231d4c4fb27ULL, 162, 68}, {0xb0de65388cc8ada8ULL, 189, 76},
+  {0x83c7088e1aab65dbULL, 216, 84}, {0xc45d1df942711d9aULL, 242, 92},
+  {0x924d692ca61be758ULL, 269, 100}, {0xda01ee641a708deaULL, 295, 108},
+  {0xa26da3999aef774aULL, 322, 116}, {0xf209787bb47d6b85ULL, 348, 124},
+  {0xb454e4a179dd1877ULL, 375, 132}, {0x865b86925b9bc5c2ULL, 402, 140},
+  {0xc83553c5c8965d3dULL, 428, 148}, {0x952ab45cfa97a0b3ULL, 455, 156},
+  {0xde469fbd99a05fe3ULL, 481, 164}, {0xa59bc234db398c25ULL, 508, 172},
+  {0xf6c69a72a3989f5cULL, 534, 180}, {0xb7dcbf5354e9beceULL, 561, 188},
+  {0x88fcf317f22241e2ULL, 588, 196}, {0xcc20ce9bd35c78a5ULL, 614, 204},
+  {0x98165af37b2153dfULL, 641, 212}, {0xe2a0b5dc971f303aULL, 667, 220},
+  {0xa8d9d1535ce3b396ULL, 694, 228}, {0xfb9b7cd9a4a7443cULL, 720, 236},
+  {0xbb764c4ca7a44410ULL, 747, 244}, {0x8bab8eefb6409c1aULL, 774, 252},
+  {0xd01fef10a657842cULL, 800, 260}, {0x9b10a4e5e9913129ULL, 827, 268},
+  {0xe7109bfba19c0c9dULL, 853, 276}, {0xac2820d9623bf429ULL, 880, 284},
+  {0x80444b5e7aa7cf85ULL, 907, 292}, {0xbf21e44003acdd2dULL, 933, 300},
+  {0x8e679c2f5e44ff8fULL, 960, 308}, {0xd433179d9c8cb841ULL, 986, 316},
+  {0x9e19db92b4e31ba9ULL, 1013, 324}, {0xeb96bf6ebadf77d9ULL, 1039, 332},
+  {0xaf87023b9bf0ee6bULL, 1066, 340},
+};
+
+static const int kCachedPowersMinExponent = -348;
+static const int kCachedPowersExponentStep = 8;
+static const int kDiyFpSignificandSize = 64;
+static const int kMinimalTargetExponent = -60;
+static const uint64_t kDoubleSignMask = 0x8000000000000000ULL;
+static const uint64_t kDoubleExponentMask = 0x7FF0000000000000ULL;
+static const uint64_t kDoubleSignificandMask = 0x000FFFFFFFFFFFFFULL;
+static const uint64_t kDoubleHiddenBit = 0x0010000000000000ULL;
+static const int kDoubleSignificandSize = 52;
+static const int kDoubleExponentBias = 0x3FF + kDoubleSignificandSize;
+
+static uint64_t DoubleToBits(double d) {
+  const void* ptr_tmp = reinterpret_cast<const void*>(&d);
+  return *reinterpret_cast<const uint64_t*>(ptr_tmp);
+}
+
+static DiyFp DiyFpFromDouble(double d) {
+  DiyFp fp;
+  uint64_t bits = DoubleToBits(d);
+  if ((bits & kDoubleExponentMask) == 0) {
+    fp.f = bits & kDoubleSignificandMask;
+    fp.e = 1 - kDoubleExponentBias;
+  } else {
+    fp.f = (bits & kDoubleSignificandMask) + kDoubleHiddenBit;
+    fp.e = static_cast<int>((bits & kDoubleExponentMask)
+        >> kDoubleSignificandSize) - kDoubleExponentBias;
+  }
+  return fp;
+}
+
+static DiyFp Normalize(DiyFp fp) {
+  while (!(fp.f & 0xFFC0000000000000ULL)) {
+    fp.f <<= 10;
+    fp.e -= 10;
+  }
+  while (!(fp.f & kDoubleSignMask)) {
+    fp.f <<= 1;
+    fp.e--;
+  }
+  return fp;
+}
+
+static DiyFp Minus(DiyFp x, DiyFp y) {
+  DiyFp r = {x.f - y.f, x.e};
+  return r;
+}
+
+static DiyFp Multiply(DiyFp x, DiyFp y) {
+  const uint64_t kMask32 = 0xFFFFFFFFULL;
+  uint64_t a = x.f >> 32, b = x.f & kMask32;
+  uint64_t c = y.f >> 32, d = y.f & kMask32;
+  uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+  uint64_t tmp = (bd >> 32) + (ad & kMask32) + (bc & kMask32);
+  tmp += 1ULL << 31;  // round
+  DiyFp r = {ac + (ad >> 32) + (bc >> 32) + (tmp >> 32),
+             x.e + y.e + kDiyFpSignificandSize};
+  return r;
+}
+
+/* Returns k of the cached power 10^k, so that the binary exponent of
+ * w * 10^k lands in [kMinimalTargetExponent, kMinimalTargetExponent + 3] */
+static int GetCachedPower(int e, DiyFp* power) {
+  static const double kD1Log2Of10 = 0.30102999566398114;  // 1 / lg(10)
+  int k = static_cast<int>(ceil((kMinimalTargetExponent
+          - kDiyFpSignificandSize - e + kDiyFpSignificandSize - 1)
+        * kD1Log2Of10));
+  int index = (k - kCachedPowersMinExponent - 1)
+    / kCachedPowersExponentStep + 1;
+  power->f = kCachedPowers[index].f;
+  power->e = kCachedPowers[index].e;
+  return kCachedPowers[index].k;
+}
+
+static uint32_t LargestPowerOfTen(uint32_t n, int n_bits, int* exponent) {
+  static const uint32_t kPowersOfTen[] = {
+    0, 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+    1000000000
+  };
+  int guess = ((n_bits + 1) * 1233 >> 12) + 1;
+  if (n < kPowersOfTen[guess]) {
+    guess--;
+  }
+  *exponent = guess;
+  return kPowersOfTen[guess];
+}
+
+static bool RoundWeed(char* buffer, int length, uint64_t distance_too_high_w,
+                      uint64_t unsafe_interval, uint64_t rest,
+                      uint64_t ten_kappa, uint64_t unit) {
+  uint64_t small_distance = distance_too_high_w - unit;
+  uint64_t big_distance = distance_too_high_w + unit;
+  while (rest < small_distance
+    && unsafe_interval - rest >= ten_kappa
+    && (rest + ten_kappa < small_distance
+      || small_distance - rest >= rest + ten_kappa - small_distance)) {
+    buffer[length - 1]--;
+    rest += ten_kappa;
+  }
+  if (rest < big_distance
+    && unsafe_interval - rest >= ten_kappa
+    && (rest + ten_kappa < big_distance
+      || big_distance - rest > rest + ten_kappa - big_distance)) {
+    return false;
+  }
+  return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+}
+
+static bool DigitGen(DiyFp low, DiyFp w, DiyFp high,
+                     char* buffer, int* length, int* kappa) {
+  uint64_t unit = 1;
+  DiyFp too_low = {low.f - unit, low.e};
+  DiyFp too_high = {high.f + unit, high.e};
+  DiyFp unsafe_interval = Minus(too_high, too_low);
+  DiyFp one = {1ULL << -w.e, w.e};
+  uint32_t integrals = static_cast<uint32_t>(too_high.f >> -one.e);
+  uint64_t fractionals = too_high.f & (one.f - 1);
+  uint32_t divisor = LargestPowerOfTen(integrals,
+      kDiyFpSignificandSize - (-one.e), kappa);
+  *length = 0;
+
+  while (*kappa > 0) {
+    buffer[(*length)++] = static_cast<char>('0' + integrals / divisor);
+    integrals %= divisor;
+    (*kappa)--;
+    uint64_t rest = (static_cast<uint64_t>(integrals) << -one.e)
+      + fractionals;
+    if (rest < unsafe_interval.f) {
+      return RoundWeed(buffer, *length, Minus(too_high, w).f,
+          unsafe_interval.f, rest,
+          static_cast<uint64_t>(divisor) << -one.e, unit);
+    }
+    divisor /= 10;
+  }
+
+  for (;;) {
+    fractionals *= 10;
+    unit *= 10;
+    unsafe_interval.f *= 10;
+    buffer[(*length)++] = static_cast<char>('0' + (fractionals >> -one.e));
+    fractionals &= one.f - 1;
+    (*kappa)--;
+    if (fractionals < unsafe_interval.f) {
+      return RoundWeed(buffer, *length, Minus(too_high, w).f * unit,
+          unsafe_interval.f, fractionals, one.f, unit);
+    }
+  }
+}
+
+/* v must be positive and finite */
+static bool Grisu3(double v, char* buffer, int* length, int* exponent) {
+  DiyFp fp = DiyFpFromDouble(v);
+  DiyFp w = Normalize(fp);
+
+  // Boundaries m- and m+ between v and its neighbours
+  DiyFp upper = {(fp.f << 1) + 1, fp.e - 1};
+  upper = Normalize(upper);
+  DiyFp lower;
+  uint64_t bits = DoubleToBits(v);
+  if ((bits & kDoubleSignificandMask) == 0
+    && (bits & kDoubleExponentMask) != 0) {
+    // The lower boundary is closer
+    lower.f = (fp.f << 2) - 1;
+    lower.e = fp.e - 2;
+  } else {
+    lower.f = (fp.f << 1) - 1;
+    lower.e = fp.e - 1;
+  }
+  lower.f <<= lower.e - upper.e;
+  lower.e = upper.e;
+
+  DiyFp cached_power;
+  int mk = GetCachedPower(w.e, &cached_power);
+  w = Multiply(w, cached_power);
+  lower = Multiply(lower, cached_power);
+  upper = Multiply(upper, cached_power);
+
+  int kappa;
+  bool success = DigitGen(lower, w, upper, buffer, length, &kappa);
+  *exponent = kappa - mk;
+  return success;
+}
+
+/* Shortest digits d1d2...dn (without trailing zeros) and exponent, such that
+ * d1d2...dn * 10^exponent reads back as v. v must be positive and finite,
+ * buffer must have room for 18 chars */
+static int ShortestDigits(double v, char* buffer, int* exponent) {
+  int length;
+  if (!Grisu3(v, buffer, &length, exponent)) {
+    // Rare case, search for the shortest precision with the libc
+    char buf[32];
+    for (int precision = 1; precision <= 17; precision++) {
+      snprintf(buf, sizeof(buf), "%.*e", precision - 1, v);
+      if (strtod(buf, NULL) == v) {
+        break;
+      }
+    }
+    // buf is d[.ddd]e[+-]xx
+    char* exp_pos = strchr(buf, 'e');
+    length = 0;
+    for (char* p = buf; p < exp_pos; p++) {
+      if (*p != '.') {
+        buffer[length++] = *p;
+      }
+    }
+    *exponent = atoi(exp_pos + 1) - (length - 1);
+  }
+  while (length > 1 && buffer[length - 1] == '0') {
+    length--;
+    (*exponent)++;
+  }
+  return length;
+}
+
+/* Lay out the digits as [-]ddd[.ddd], switching to [-]d[.ddd]e[+-]xx for
+ * very large and very small numbers unless fixed is set, returns the length */
+static int FormatDigits(bool negative, const char* digits, int length,
+                        int exponent, bool fixed, char* dst) {
+  char* p = dst;
+  int point = length + exponent;
+  if (negative) {
+    *p++ = '-';
+  }
+  if (length <= point && (point <= 21 || fixed)) {
+    memcpy(p, digits, length);
+    p += length;
+    memset(p, '0', point - length);
+    p += point - length;
+  } else if (0 < point && point <= 21) {
+    memcpy(p, digits, point);
+    p += point;
+    *p++ = '.';
+    memcpy(p, digits + point, length - point);
+    p += length - point;
+  } else if (point <= 0 && (point > -6 || fixed)) {
+    *p++ = '0';
+    *p++ = '.';
+    memset(p, '0', -point);
+    p += -point;
+    memcpy(p, digits, length);
+    p += length;
+  } else {
+    *p++ = digits[0];
+    if (length > 1) {
+      *p++ = '.';
+      memcpy(p, digits + 1, length - 1);
+      p += length - 1;
+    }
+    *p++ = 'e';
+    p += snprintf(p, 8, "%+d", point - 1);
+  }
+  return p - dst;
+}
+
+/* Convert a double into the shortest string that reads back to the same
+ * double. Returns the length of the string, or 0 if the buffer is not big
+ * enough. Large and small numbers use exponent notation, like 1e+21 */
+int DoubleToStr(char* dst, size_t dstlen, double dval) {
+    char buf[64];
+    int len;
+    if (std::isnan(dval)) {
+      memcpy(buf, "nan", 3);
+      len = 3;
+    } else if (std::isinf(dval)) {
+      if (dval > 0) {
+        memcpy(buf, "inf", 3);
+        len = 3;
+      } else {
+        memcpy(buf, "-inf", 4);
+        len = 4;
+      }
+    } else if (dval == 0) {
+      if (std::signbit(dval)) {
+        memcpy(buf, "-0", 2);
+        len = 2;
+      } else {
+        buf[0] = '0';
+        len = 1;
+      }
+    } else {
+      char digits[18];
+      int exponent;
+      int length = ShortestDigits(std::fabs(dval), digits, &exponent);
+      len = FormatDigits(dval < 0, digits, length, exponent, false, buf);
+    }
+    if (static_cast<size_t>(len) >= dstlen) return 0;
+    memcpy(dst, buf, len);
+    dst[len] = '\0';
+    return len;
+}
+
+static const int kFractionBits = 17;
+static const long double kFractionScale = 131072.0L;  // 2^17
+static const uint64_t kFractionScaleFivePower = 762939453125ULL;  // 5^17
+
 int LongDoubleToStr(long double ldval, std::string* value) {
     char buf[256];
     int len;
@@ -328,25 +842,59 @@ int LongDoubleToStr(long double ldval, std::string* value) {
         len = 4;
       }
       return -1;
-    } else {
-      /* We use 17 digits precision since with 128 bit floats that precision
-       * after rounding is able to represent most small decimal numbers in a
-       * way that is "non surprising" for the user (that is, most small
-       * decimal numbers will be represented in a way that when converted
-       * back into a string are exactly the same as what the user typed.) */
-      len = snprintf(buf, sizeof(buf), "%.17Lf", ldval);
-      /* Now remove trailing zeroes after the '.' */
-      if (strchr(buf, '.') != NULL) {
-          char *p = buf+len-1;
-          while (*p == '0') {
-              p--;
-              len--;
-          }
-          if (*p == '.') len--;
+    }
+
+    /* Values with at most 17 binary fractional digits, like integers and
+     * the results of most counters, have an exact decimal expansion with at
+     * most 17 fractional digits, which is what snprintf would print below.
+     * Build it with integer arithmetic instead */
+    long double abs_ldval = std::fabs(ldval);
+    long double scaled = abs_ldval * kFractionScale;
+    if (abs_ldval < 9223372036854775808.0L && scaled == std::floor(scaled)) {
+      uint64_t integral = static_cast<uint64_t>(abs_ldval);
+      uint64_t fraction = static_cast<uint64_t>(
+          scaled - static_cast<long double>(integral) * kFractionScale);
+      char* p = buf;
+      if (std::signbit(ldval)) {
+        *p++ = '-';
       }
-      value->assign(buf, len);
+      p += Int64ToStr(p, sizeof(buf) - 1, static_cast<int64_t>(integral));
+      if (fraction != 0) {
+        // fraction / 2^17 == fraction * 5^17 / 10^17
+        uint64_t decimals = fraction * kFractionScaleFivePower;
+        int digits = kFractionBits;
+        while (decimals % 10 == 0) {
+          decimals /= 10;
+          digits--;
+        }
+        *p++ = '.';
+        for (int i = digits - 1; i >= 0; i--) {
+          p[i] = static_cast<char>('0' + decimals % 10);
+          decimals /= 10;
+        }
+        p += digits;
+      }
+      value->assign(buf, p - buf);
       return 0;
     }
+
+    /* We use 17 digits precision since with 128 bit floats that precision
+     * after rounding is able to represent most small decimal numbers in a
+     * way that is "non surprising" for the user (that is, most small
+     * decimal numbers will be represented in a way that when converted
+     * back into a string are exactly the same as what the user typed.) */
+    len = snprintf(buf, sizeof(buf), "%.17Lf", ldval);
+    /* Now remove trailing zeroes after the '.' */
+    if (strchr(buf, '.') != NULL) {
+        char *p = buf+len-1;
+        while (*p == '0') {
+            p--;
+            len--;
+        }
+        if (*p == '.') len--;
+    }
+    value->assign(buf, len);
+    return 0;
 }
 
 int do_mkdir(const char *path, mode_t mode) {
@@ -502,4 +1050,69 @@ bool isTailWildcard(const std::string& pattern) {
   return true;
 }
 
+/* CRC16 XMODEM, the checksum used by redis cluster to map keys to slots,
+ * crc16("123456789") is 0x31c3 */
+static const uint16_t crc16tab[256] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+  0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+  0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+  0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+  0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+  0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+  0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+  0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+  0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+  0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+  0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+  0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+  0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+  0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+  0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+  0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+  0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+  0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+  0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+  0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+  0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+  0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+  0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+  0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+  0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+  0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+  0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+  0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+  0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+  0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+  0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+  0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
+};
+
+uint16_t Crc16(const char* buf, size_t len) {
+  uint16_t crc = 0;
+  for (size_t idx = 0; idx < len; idx++) {
+    crc = (crc << 8) ^ crc16tab[((crc >> 8) ^ *buf++) & 0x00ff];
+  }
+  return crc;
+}
+
+/* Same as keyHashSlot() of redis cluster, only the part of the key between
+ * the first '{' and the next '}' is hashed if it is not empty, so that the
+ * keys with the same hash tag are in the same slot */
+uint32_t KeyHashSlot(const char* key, size_t len) {
+  size_t s, e;
+  for (s = 0; s < len; s++) {
+    if (key[s] == '{') break;
+  }
+  if (s == len) {
+    return Crc16(key, len) & (kClusterSlots - 1);
+  }
+  for (e = s + 1; e < len; e++) {
+    if (key[e] == '}') break;
+  }
+  if (e == len || e == s + 1) {
+    return Crc16(key, len) & (kClusterSlots - 1);
+  }
+  return Crc16(key + s + 1, e - s - 1) & (kClusterSlots - 1);
+}
+
 }  //  namespace blackwidow
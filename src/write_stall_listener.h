@@ -0,0 +1,58 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#ifndef SRC_WRITE_STALL_LISTENER_H_
+#define SRC_WRITE_STALL_LISTENER_H_
+
+#include <atomic>
+
+#include "rocksdb/listener.h"
+
+#include "blackwidow/blackwidow.h"
+
+namespace blackwidow {
+
+// Count the column families of a type db whose writes are delayed or
+// stopped, rocksdb reports every change of their stall condition
+class WriteStallListener : public rocksdb::EventListener {
+ public:
+  WriteStallListener() : delayed_cfs_(0), stopped_cfs_(0), stalls_(0) {}
+
+  void OnStallConditionsChanged(const rocksdb::WriteStallInfo& info) override {
+    if (info.condition.prev == rocksdb::WriteStallCondition::kDelayed) {
+      delayed_cfs_--;
+    } else if (info.condition.prev == rocksdb::WriteStallCondition::kStopped) {
+      stopped_cfs_--;
+    }
+    if (info.condition.cur == rocksdb::WriteStallCondition::kDelayed) {
+      delayed_cfs_++;
+      stalls_++;
+    } else if (info.condition.cur == rocksdb::WriteStallCondition::kStopped) {
+      stopped_cfs_++;
+      stalls_++;
+    }
+  }
+
+  WritePressure pressure() const {
+    if (stopped_cfs_.load() > 0) {
+      return kWritePressureStopped;
+    } else if (delayed_cfs_.load() > 0) {
+      return kWritePressureDelayed;
+    }
+    return kWritePressureNormal;
+  }
+
+  uint64_t stalls() const {
+    return stalls_.load();
+  }
+
+ private:
+  std::atomic<int32_t> delayed_cfs_;
+  std::atomic<int32_t> stopped_cfs_;
+  std::atomic<uint64_t> stalls_;
+};
+
+}  //  namespace blackwidow
+#endif  //  SRC_WRITE_STALL_LISTENER_H_
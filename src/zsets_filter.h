@@ -23,7 +23,8 @@ class ZSetsScoreFilter : public rocksdb::CompactionFilter {
  public:
   ZSetsScoreFilter(rocksdb::DB* db,
                    std::vector<rocksdb::ColumnFamilyHandle*>* handles_ptr) :
-    db_(db), cf_handles_ptr_(handles_ptr), meta_not_found_(false) {}
+    db_(db), cf_handles_ptr_(handles_ptr), meta_not_found_(false),
+    cur_meta_has_origin_(false), origin_ref_reader_(db, handles_ptr) {}
 
   bool Filter(int level, const rocksdb::Slice& key,
               const rocksdb::Slice& value,
@@ -51,6 +52,7 @@ class ZSetsScoreFilter : public rocksdb::CompactionFilter {
         ParsedZSetsMetaValue parsed_zsets_meta_value(&meta_value);
         cur_meta_version_ = parsed_zsets_meta_value.version();
         cur_meta_timestamp_ = parsed_zsets_meta_value.timestamp();
+        cur_meta_has_origin_ = parsed_zsets_meta_value.has_origin();
       } else if (s.IsNotFound()) {
         meta_not_found_ = true;
       } else {
@@ -60,24 +62,30 @@ class ZSetsScoreFilter : public rocksdb::CompactionFilter {
       }
     }
 
-    if (meta_not_found_) {
-      Trace("Drop[Meta key not exist]");
-      return true;
-    }
-
     int64_t unix_time;
     rocksdb::Env::Default()->GetCurrentTime(&unix_time);
-    if (cur_meta_timestamp_ != 0 &&
+    const char* drop_reason = nullptr;
+    if (meta_not_found_) {
+      drop_reason = "Drop[Meta key not exist]";
+    } else if (cur_meta_has_origin_) {
+      drop_reason = "Drop[Meta key renamed from origin]";
+    } else if (cur_meta_timestamp_ != 0 &&
         cur_meta_timestamp_ < static_cast<int32_t>(unix_time)) {
-      Trace("Drop[Timeout]");
-      return true;
+      drop_reason = "Drop[Timeout]";
+    } else if (cur_meta_version_ > parsed_zsets_score_key.version()) {
+      drop_reason = "Drop[score_key_version < cur_meta_version]";
     }
-    if (cur_meta_version_ > parsed_zsets_score_key.version()) {
-      Trace("Drop[score_key_version < cur_meta_version]");
-      return true;
-    } else {
+
+    if (drop_reason == nullptr) {
       Trace("Reserve[score_key_version == cur_meta_version]");
       return false;
+    } else if (origin_ref_reader_.IsReferenced(parsed_zsets_score_key.key(),
+                 parsed_zsets_score_key.version())) {
+      Trace("Reserve[Read by renamed key]");
+      return false;
+    } else {
+      Trace("%s", drop_reason);
+      return true;
     }
   }
 
@@ -91,6 +99,8 @@ class ZSetsScoreFilter : public rocksdb::CompactionFilter {
   mutable bool meta_not_found_;
   mutable int32_t cur_meta_version_;
   mutable int32_t cur_meta_timestamp_;
+  mutable bool cur_meta_has_origin_;
+  mutable OriginRefReader<ParsedZSetsMetaValue> origin_ref_reader_;
 };
 
 class ZSetsScoreFilterFactory : public rocksdb::CompactionFilterFactory {
@@ -0,0 +1,211 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <iostream>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+class BloomFilterTest : public ::testing::Test {
+ public:
+  BloomFilterTest() {
+    std::string path = "./db/bloom_filter";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~BloomFilterTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+// BfReserve
+TEST_F(BloomFilterTest, BfReserveTest) {
+  int32_t ret = 0;
+  std::map<blackwidow::DataType, Status> type_status;
+
+  s = db.BfReserve("BF_RESERVE_KEY", 0.01, 1000);
+  ASSERT_TRUE(s.ok());
+  std::string type;
+  s = db.Type("BF_RESERVE_KEY", &type);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(type, "MBbloom--");
+
+  // Reserving an existing filter fails
+  s = db.BfReserve("BF_RESERVE_KEY", 0.01, 1000);
+  ASSERT_TRUE(s.IsBusy());
+
+  // Invalid parameters
+  s = db.BfReserve("BF_RESERVE_INVALID_KEY", 0.01, 0);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.BfReserve("BF_RESERVE_INVALID_KEY", 0, 1000);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.BfReserve("BF_RESERVE_INVALID_KEY", 1, 1000);
+  ASSERT_TRUE(s.IsInvalidArgument());
+
+  // A deleted filter can be reserved again
+  db.Del({"BF_RESERVE_KEY"}, &type_status);
+  s = db.BfReserve("BF_RESERVE_KEY", 0.001, 10);
+  ASSERT_TRUE(s.ok());
+  s = db.BfAdd("BF_RESERVE_KEY", "MEMBER", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+
+  // A plain hash is not a Bloom filter
+  int32_t res = 0;
+  s = db.HSet("BF_RESERVE_HASH_KEY", "FIELD", "VALUE", &res);
+  ASSERT_TRUE(s.ok());
+  s = db.BfReserve("BF_RESERVE_HASH_KEY", 0.01, 1000);
+  ASSERT_TRUE(s.IsBusy());
+  s = db.BfAdd("BF_RESERVE_HASH_KEY", "MEMBER", &ret);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.BfExists("BF_RESERVE_HASH_KEY", "MEMBER", &ret);
+  ASSERT_TRUE(s.IsInvalidArgument());
+}
+
+// BfAdd & BfExists
+TEST_F(BloomFilterTest, BfAddTest) {
+  int32_t ret = 0;
+
+  // A missing filter reports nothing present
+  s = db.BfExists("BF_ADD_KEY", "MEMBER", &ret);
+  ASSERT_TRUE(s.IsNotFound());
+  ASSERT_EQ(ret, 0);
+
+  // A missing filter is created by BfAdd
+  s = db.BfAdd("BF_ADD_KEY", "MEMBER", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  s = db.BfAdd("BF_ADD_KEY", "MEMBER", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 0);
+
+  s = db.BfExists("BF_ADD_KEY", "MEMBER", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  s = db.BfExists("BF_ADD_KEY", "OTHER_MEMBER", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 0);
+}
+
+// BfMAdd & BfMExists
+TEST_F(BloomFilterTest, BfMAddTest) {
+  std::vector<int32_t> rets;
+
+  s = db.BfReserve("BF_MADD_KEY", 0.001, 1000);
+  ASSERT_TRUE(s.ok());
+
+  // A repeated member is reported present the second time
+  s = db.BfMAdd("BF_MADD_KEY", {"M1", "M2", "M1", "M3"}, &rets);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(rets, std::vector<int32_t>({1, 1, 0, 1}));
+
+  s = db.BfMAdd("BF_MADD_KEY", {"M3", "M4"}, &rets);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(rets, std::vector<int32_t>({0, 1}));
+
+  s = db.BfMExists("BF_MADD_KEY", {"M1", "M2", "M3", "M4", "M5"}, &rets);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(rets, std::vector<int32_t>({1, 1, 1, 1, 0}));
+}
+
+// A filter of many chunks has no false negatives and about the expected
+// false positives
+TEST_F(BloomFilterTest, ChunksTest) {
+  const int32_t capacity = 20000;
+  std::vector<int32_t> rets;
+  std::vector<std::string> members;
+  for (int32_t i = 0; i < capacity; ++i) {
+    members.push_back("MEMBER_" + std::to_string(i));
+  }
+
+  s = db.BfReserve("BF_CHUNKS_KEY", 0.01, capacity);
+  ASSERT_TRUE(s.ok());
+  s = db.BfMAdd("BF_CHUNKS_KEY", members, &rets);
+  ASSERT_TRUE(s.ok());
+
+
+  s = db.BfMExists("BF_CHUNKS_KEY", members, &rets);
+  ASSERT_TRUE(s.ok());
+  for (const auto& ret : rets) {
+    ASSERT_EQ(ret, 1);
+  }
+
+  std::vector<std::string> others;
+  for (int32_t i = 0; i < capacity; ++i) {
+    others.push_back("OTHER_" + std::to_string(i));
+  }
+  s = db.BfMExists("BF_CHUNKS_KEY", others, &rets);
+  ASSERT_TRUE(s.ok());
+  int32_t false_positives = 0;
+  for (const auto& ret : rets) {
+    false_positives += ret;
+  }
+  ASSERT_LT(false_positives, capacity / 100 * 2);
+}
+
+// The hash commands leave a Bloom filter alone
+TEST_F(BloomFilterTest, WrongTypeTest) {
+  int32_t ret = 0;
+  int64_t num = 0;
+  std::string type;
+  std::vector<std::string> fields;
+  std::vector<blackwidow::FieldValue> fvs;
+  std::map<blackwidow::DataType, Status> type_status;
+
+  s = db.BfReserve("BF_WRONGTYPE_KEY", 0.01, 1000);
+  ASSERT_TRUE(s.ok());
+  s = db.BfAdd("BF_WRONGTYPE_KEY", "MEMBER", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+
+  s = db.HSet("BF_WRONGTYPE_KEY", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.HIncrby("BF_WRONGTYPE_KEY", "FIELD", 1, &num);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.HDel("BF_WRONGTYPE_KEY", {"FIELD"}, &ret);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.HLen("BF_WRONGTYPE_KEY", &ret);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.HKeys("BF_WRONGTYPE_KEY", &fields);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.HGetall("BF_WRONGTYPE_KEY", &fvs);
+  ASSERT_TRUE(s.IsInvalidArgument());
+
+  // The filter is untouched and still reported as one
+  s = db.BfExists("BF_WRONGTYPE_KEY", "MEMBER", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  s = db.Type("BF_WRONGTYPE_KEY", &type);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(type, "MBbloom--");
+  ASSERT_EQ(db.Exists({"BF_WRONGTYPE_KEY"}, &type_status), 1);
+
+  // Once deleted the key can hold a hash again
+  ASSERT_EQ(db.Del({"BF_WRONGTYPE_KEY"}, &type_status), 1);
+  s = db.HSet("BF_WRONGTYPE_KEY", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  s = db.Type("BF_WRONGTYPE_KEY", &type);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(type, "hash");
+  s = db.BfExists("BF_WRONGTYPE_KEY", "MEMBER", &ret);
+  ASSERT_TRUE(s.IsInvalidArgument());
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,217 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <iostream>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+class CappedTest : public ::testing::Test {
+ public:
+  CappedTest() {
+    std::string path = "./db/capped";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~CappedTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+static bool elements_match(blackwidow::BlackWidow* const db,
+                           const Slice& key,
+                           const std::vector<std::string>& expect_elements) {
+  std::vector<std::string> elements_out;
+  Status s = db->LRange(key, 0, -1, &elements_out);
+  if (!s.ok() && !s.IsNotFound()) {
+    return false;
+  }
+  return elements_out == expect_elements;
+}
+
+static bool score_members_match(blackwidow::BlackWidow* const db,
+                                const Slice& key,
+                                const std::vector<ScoreMember>& expect_sm) {
+  std::vector<ScoreMember> sm_out;
+  Status s = db->ZRange(key, 0, -1, &sm_out);
+  if (!s.ok() && !s.IsNotFound()) {
+    return false;
+  }
+  if (sm_out.size() != expect_sm.size()) {
+    return false;
+  }
+  for (size_t idx = 0; idx < sm_out.size(); ++idx) {
+    if (!(sm_out[idx] == expect_sm[idx])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// LPushCapped and RPushCapped
+TEST_F(CappedTest, ListPushCappedTest) {
+  uint64_t len;
+
+  // A recent activity feed
+  s = db.LPushCapped("FEED_KEY", {"a", "b", "c"}, 3, &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 3);
+  s = db.LPushCapped("FEED_KEY", {"d"}, 3, &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 3);
+  ASSERT_TRUE(elements_match(&db, "FEED_KEY", {"d", "c", "b"}));
+
+  // More values than the cap
+  s = db.LPushCapped("FEED_KEY", {"e", "f", "g", "h"}, 3, &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 3);
+  ASSERT_TRUE(elements_match(&db, "FEED_KEY", {"h", "g", "f"}));
+
+  // A lower cap evicts the excess at once
+  s = db.RPushCapped("FEED_KEY", {"i"}, 2, &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 2);
+  ASSERT_TRUE(elements_match(&db, "FEED_KEY", {"f", "i"}));
+
+  // Evictions longer than one range deletion
+  std::vector<std::string> values;
+  for (int32_t idx = 0; idx < 100; ++idx) {
+    values.push_back(std::to_string(idx));
+  }
+  s = db.RPush("LONG_FEED_KEY", values, &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 100);
+  s = db.RPushCapped("LONG_FEED_KEY", {"100"}, 10, &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 10);
+  ASSERT_TRUE(elements_match(&db, "LONG_FEED_KEY", {"91", "92", "93", "94",
+        "95", "96", "97", "98", "99", "100"}));
+  std::string element;
+  s = db.LIndex("LONG_FEED_KEY", 0, &element);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(element, "91");
+
+  s = db.LPushCapped("FEED_KEY", {"j"}, 0, &len);
+  ASSERT_TRUE(s.IsInvalidArgument());
+}
+
+// The plain pushes keep the cap
+TEST_F(CappedTest, ListCapKeptTest) {
+  uint64_t len;
+  s = db.LPushCapped("KEPT_LIST_KEY", {"a", "b"}, 3, &len);
+  ASSERT_TRUE(s.ok());
+
+  s = db.LPush("KEPT_LIST_KEY", {"c", "d"}, &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 3);
+  ASSERT_TRUE(elements_match(&db, "KEPT_LIST_KEY", {"d", "c", "b"}));
+
+  s = db.RPushx("KEPT_LIST_KEY", "e", &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 3);
+  ASSERT_TRUE(elements_match(&db, "KEPT_LIST_KEY", {"c", "b", "e"}));
+
+  s = db.LPushx("KEPT_LIST_KEY", "f", &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 3);
+  ASSERT_TRUE(elements_match(&db, "KEPT_LIST_KEY", {"f", "c", "b"}));
+
+  // Renamed lists keep the cap
+  std::map<DataType, Status> type_status;
+  s = db.Rename("KEPT_LIST_KEY", "RENAMED_LIST_KEY");
+  ASSERT_TRUE(s.ok());
+  s = db.RPush("RENAMED_LIST_KEY", {"g"}, &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 3);
+  ASSERT_TRUE(elements_match(&db, "RENAMED_LIST_KEY", {"c", "b", "g"}));
+
+  // The cap is dropped with the list
+  ASSERT_EQ(db.Del({"RENAMED_LIST_KEY"}, &type_status), 1);
+  s = db.RPush("RENAMED_LIST_KEY", {"a", "b", "c", "d"}, &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 4);
+}
+
+// ZAddCapped
+TEST_F(CappedTest, ZAddCappedTest) {
+  int32_t ret;
+
+  s = db.ZAddCapped("TOP_KEY", {{1, "a"}, {5, "e"}, {3, "c"},
+                    {4, "d"}, {2, "b"}}, 3, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 3);
+  ASSERT_TRUE(score_members_match(&db, "TOP_KEY",
+        {{3, "c"}, {4, "d"}, {5, "e"}}));
+  s = db.ZCard("TOP_KEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 3);
+
+  // A member lower than all is evicted at once
+  s = db.ZAdd("TOP_KEY", {{0, "z"}}, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(score_members_match(&db, "TOP_KEY",
+        {{3, "c"}, {4, "d"}, {5, "e"}}));
+
+  // Equal scores are ordered by member
+  s = db.ZAdd("TOP_KEY", {{3, "b"}, {6, "f"}}, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(score_members_match(&db, "TOP_KEY",
+        {{4, "d"}, {5, "e"}, {6, "f"}}));
+
+  // An updated member is ranked by its new score
+  s = db.ZAdd("TOP_KEY", {{7, "d"}, {4.5, "g"}}, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  ASSERT_TRUE(score_members_match(&db, "TOP_KEY",
+        {{5, "e"}, {6, "f"}, {7, "d"}}));
+  double score;
+  s = db.ZScore("TOP_KEY", "g", &score);
+  ASSERT_TRUE(s.IsNotFound());
+
+  s = db.ZAddCapped("TOP_KEY", {{1, "a"}}, 0, &ret);
+  ASSERT_TRUE(s.IsInvalidArgument());
+}
+
+// ZIncrby keeps the cap
+TEST_F(CappedTest, ZIncrbyCappedTest) {
+  int32_t ret;
+  double score;
+
+  s = db.ZAddCapped("INCR_TOP_KEY", {{1, "a"}, {2, "b"}}, 2, &ret);
+  ASSERT_TRUE(s.ok());
+
+  s = db.ZIncrby("INCR_TOP_KEY", "c", 3, &score);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(score, 3);
+  ASSERT_TRUE(score_members_match(&db, "INCR_TOP_KEY", {{2, "b"}, {3, "c"}}));
+
+  s = db.ZIncrby("INCR_TOP_KEY", "d", 1, &score);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(score_members_match(&db, "INCR_TOP_KEY", {{2, "b"}, {3, "c"}}));
+
+  s = db.ZIncrby("INCR_TOP_KEY", "b", 5, &score);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(score, 7);
+  ASSERT_TRUE(score_members_match(&db, "INCR_TOP_KEY", {{3, "c"}, {7, "b"}}));
+  s = db.ZCard("INCR_TOP_KEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 2);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
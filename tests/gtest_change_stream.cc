@@ -0,0 +1,119 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <iostream>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+class ChangeStreamTest : public ::testing::Test {
+ public:
+  ChangeStreamTest() {
+    std::string path = "./db/change_stream";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~ChangeStreamTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+// Strings
+TEST_F(ChangeStreamTest, StringsTest) {
+  uint64_t since_sequence, next_sequence;
+  std::vector<ChangeRecord> records;
+  s = db.GetLatestSequenceNumber(DataType::kStrings, &since_sequence);
+  ASSERT_TRUE(s.ok());
+  since_sequence++;
+
+  s = db.Setex("CDC_STRING_KEY", "VALUE", 100);
+  ASSERT_TRUE(s.ok());
+  std::map<DataType, Status> type_status;
+  db.Del({"CDC_STRING_KEY"}, &type_status);
+
+  s = db.GetUpdatesSince(DataType::kStrings, since_sequence, 100,
+                         &records, &next_sequence);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(records.size(), 2);
+  ASSERT_EQ(records[0].type, DataType::kStrings);
+  ASSERT_EQ(records[0].operation, kChangePut);
+  ASSERT_EQ(records[0].sequence, since_sequence);
+  ASSERT_EQ(records[0].key, "CDC_STRING_KEY");
+  ASSERT_EQ(records[0].value, "VALUE");
+  ASSERT_GT(records[0].timestamp, 0);
+  ASSERT_EQ(records[1].operation, kChangeDelete);
+  ASSERT_EQ(records[1].key, "CDC_STRING_KEY");
+  ASSERT_EQ(next_sequence, since_sequence + 2);
+
+  // Resume from next_sequence, nothing new
+  s = db.GetUpdatesSince(DataType::kStrings, next_sequence, 100,
+                         &records, &next_sequence);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(records.size(), 0);
+}
+
+// Hashes
+TEST_F(ChangeStreamTest, HashesTest) {
+  int32_t ret;
+  uint64_t since_sequence, next_sequence;
+  std::vector<ChangeRecord> records;
+  s = db.GetLatestSequenceNumber(DataType::kHashes, &since_sequence);
+  ASSERT_TRUE(s.ok());
+  since_sequence++;
+
+  s = db.HSet("CDC_HASH_KEY", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+
+  s = db.GetUpdatesSince(DataType::kHashes, since_sequence, 100,
+                         &records, &next_sequence);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(records.size(), 2);
+  ASSERT_EQ(records[0].cf_type, kMeta);
+  ASSERT_EQ(records[0].key, "CDC_HASH_KEY");
+  ASSERT_EQ(records[0].value, "1");
+  ASSERT_EQ(records[1].cf_type, kData);
+  ASSERT_EQ(records[1].key, "CDC_HASH_KEY");
+  ASSERT_EQ(records[1].field, "FIELD");
+  ASSERT_EQ(records[1].value, "VALUE");
+  ASSERT_EQ(records[1].version, records[0].version);
+}
+
+// ZSets, the score_cf index is not part of the stream
+TEST_F(ChangeStreamTest, ZSetsTest) {
+  int32_t ret;
+  uint64_t since_sequence, next_sequence;
+  std::vector<ChangeRecord> records;
+  s = db.GetLatestSequenceNumber(DataType::kZSets, &since_sequence);
+  ASSERT_TRUE(s.ok());
+  since_sequence++;
+
+  s = db.ZAdd("CDC_ZSET_KEY", {{3.5, "MEMBER"}}, &ret);
+  ASSERT_TRUE(s.ok());
+
+  s = db.GetUpdatesSince(DataType::kZSets, since_sequence, 100,
+                         &records, &next_sequence);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(records.size(), 2);
+  ASSERT_EQ(records[1].cf_type, kData);
+  ASSERT_EQ(records[1].field, "MEMBER");
+  ASSERT_EQ(records[1].value, "3.5");
+  ASSERT_EQ(next_sequence, since_sequence + 3);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
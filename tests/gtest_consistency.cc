@@ -0,0 +1,129 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <iostream>
+
+#include "blackwidow/blackwidow.h"
+#include "src/base_meta_value_format.h"
+#include "src/lists_meta_value_format.h"
+
+using namespace blackwidow;
+
+class ConsistencyTest : public ::testing::Test {
+ public:
+  ConsistencyTest() {
+    std::string path = "./db/consistency";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~ConsistencyTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+TEST_F(ConsistencyTest, HashesTest) {
+  int32_t ret;
+  ASSERT_TRUE(s.ok());
+  for (int32_t idx = 0; idx < 100; ++idx) {
+    s = db.HSet("CONSISTENCY_HASH_" + std::to_string(idx),
+                "field", "value", &ret);
+    ASSERT_TRUE(s.ok());
+  }
+  s = db.HMSet("CONSISTENCY_HASH_0", {{"a", "1"}, {"b", "2"}});
+  ASSERT_TRUE(s.ok());
+
+  ConsistencyReport report;
+  s = db.CheckConsistency(DataType::kHashes, 4, false, &report);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(report.checked_keys, 100);
+  ASSERT_EQ(report.inconsistent_keys, 0);
+
+  // Break the field count of one hash
+  rocksdb::DB* hashes_db = db.GetDBByType(HASHES_DB);
+  std::string meta_value;
+  s = hashes_db->Get(rocksdb::ReadOptions(), "CONSISTENCY_HASH_0",
+                     &meta_value);
+  ASSERT_TRUE(s.ok());
+  ParsedHashesMetaValue(&meta_value).set_count(10);
+  s = hashes_db->Put(rocksdb::WriteOptions(), "CONSISTENCY_HASH_0",
+                     meta_value);
+  ASSERT_TRUE(s.ok());
+
+  s = db.CheckConsistency(DataType::kHashes, 4, false, &report);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(report.checked_keys, 100);
+  ASSERT_EQ(report.inconsistent_keys, 1);
+  ASSERT_EQ(report.repaired_keys, 0);
+  ASSERT_EQ(report.samples.size(), 1);
+  ASSERT_EQ(report.samples[0].type, DataType::kHashes);
+  ASSERT_EQ(report.samples[0].key, "CONSISTENCY_HASH_0");
+  ASSERT_EQ(report.samples[0].meta_count, 10);
+  ASSERT_EQ(report.samples[0].data_count, 3);
+
+  s = db.CheckConsistency(DataType::kHashes, 4, true, &report);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(report.inconsistent_keys, 1);
+  ASSERT_EQ(report.repaired_keys, 1);
+  ASSERT_TRUE(report.samples[0].repaired);
+  s = db.HLen("CONSISTENCY_HASH_0", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 3);
+
+  s = db.CheckConsistency(DataType::kAll, 2, false, &report);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(report.inconsistent_keys, 0);
+}
+
+TEST_F(ConsistencyTest, ListsTest) {
+  uint64_t len;
+  ASSERT_TRUE(s.ok());
+  s = db.RPush("CONSISTENCY_LIST", {"a", "b", "c"}, &len);
+  ASSERT_TRUE(s.ok());
+
+  rocksdb::DB* lists_db = db.GetDBByType(LISTS_DB);
+  std::string meta_value;
+  s = lists_db->Get(rocksdb::ReadOptions(), "CONSISTENCY_LIST", &meta_value);
+  ASSERT_TRUE(s.ok());
+  ParsedListsMetaValue(&meta_value).set_count(5);
+  s = lists_db->Put(rocksdb::WriteOptions(), "CONSISTENCY_LIST", meta_value);
+  ASSERT_TRUE(s.ok());
+
+  ConsistencyReport report;
+  s = db.CheckConsistency(DataType::kLists, 1, true, &report);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(report.inconsistent_keys, 1);
+  ASSERT_EQ(report.repaired_keys, 1);
+  s = db.LLen("CONSISTENCY_LIST", &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 3);
+  std::vector<std::string> values;
+  s = db.LRange("CONSISTENCY_LIST", 0, -1, &values);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(values, std::vector<std::string>({"a", "b", "c"}));
+}
+
+TEST_F(ConsistencyTest, InvalidTest) {
+  ConsistencyReport report;
+  ASSERT_TRUE(s.ok());
+  s = db.CheckConsistency(DataType::kStrings, 1, false, &report);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.CheckConsistency(DataType::kHashes, 0, false, &report);
+  ASSERT_TRUE(s.IsInvalidArgument());
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,325 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <chrono>
+#include <iostream>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+class CounterBufferTest : public ::testing::Test {
+ public:
+  CounterBufferTest() {
+    std::string path = "./db/counter_buffer";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    // Long enough that only the commands flush during a test
+    bw_options.counter_flush_interval_ms = 600000;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~CounterBufferTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+// Incrby, Decrby and Get
+TEST_F(CounterBufferTest, StringCounterTest) {
+  int64_t ret;
+  std::string value;
+  CounterBufferStats stats;
+
+  s = db.Set("PV_KEY", "10");
+  ASSERT_TRUE(s.ok());
+  s = db.BufferCounter(kStrings, "PV_KEY");
+  ASSERT_TRUE(s.ok());
+
+  for (int32_t idx = 0; idx < 100; ++idx) {
+    s = db.Incrby("PV_KEY", 2, &ret);
+    ASSERT_TRUE(s.ok());
+  }
+  ASSERT_EQ(ret, 210);
+  s = db.Decrby("PV_KEY", 10, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 200);
+  s = db.Get("PV_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "200");
+
+  s = db.GetCounterBufferStats(&stats);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(stats.keys, 1);
+  ASSERT_EQ(stats.dirty_counters, 1);
+  ASSERT_EQ(stats.dirty_increments, 101);
+  ASSERT_EQ(stats.flush_interval_ms, 600000);
+
+  // Any other command of the key writes the increments first
+  int32_t len;
+  s = db.Strlen("PV_KEY", &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 3);
+  s = db.GetCounterBufferStats(&stats);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(stats.dirty_counters, 0);
+  ASSERT_EQ(stats.flushed_increments, 101);
+
+  // A counter created in the buffer
+  s = db.BufferCounter(kStrings, "NEW_PV_KEY");
+  ASSERT_TRUE(s.ok());
+  s = db.Incrby("NEW_PV_KEY", 5, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 5);
+  std::map<DataType, Status> type_status;
+  ASSERT_EQ(db.Exists({"NEW_PV_KEY"}, &type_status), 1);
+
+  // Not a number, left to the stored value
+  s = db.Set("TEXT_KEY", "text");
+  ASSERT_TRUE(s.ok());
+  s = db.BufferCounter(kStrings, "TEXT_KEY");
+  ASSERT_TRUE(s.ok());
+  s = db.Incrby("TEXT_KEY", 1, &ret);
+  ASSERT_TRUE(s.IsCorruption());
+
+  s = db.BufferCounter(kSets, "PV_KEY");
+  ASSERT_TRUE(s.IsInvalidArgument());
+}
+
+// HIncrby and HGet
+TEST_F(CounterBufferTest, HashCounterTest) {
+  int64_t ret;
+  std::string value;
+
+  s = db.BufferCounter(kHashes, "STAT_KEY");
+  ASSERT_TRUE(s.ok());
+  for (int32_t idx = 0; idx < 10; ++idx) {
+    s = db.HIncrby("STAT_KEY", "click", 1, &ret);
+    ASSERT_TRUE(s.ok());
+    s = db.HIncrby("STAT_KEY", "view", 3, &ret);
+    ASSERT_TRUE(s.ok());
+  }
+  s = db.HGet("STAT_KEY", "click", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "10");
+  s = db.HGet("STAT_KEY", "view", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "30");
+
+  // An overflow is reported as without the buffer
+  s = db.HIncrby("STAT_KEY", "click", LLONG_MAX, &ret);
+  ASSERT_TRUE(s.IsInvalidArgument());
+
+  std::vector<FieldValue> fvs;
+  s = db.HGetall("STAT_KEY", &fvs);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(fvs.size(), 2);
+
+  // Undesignated keys write their increments
+  s = db.HIncrby("STAT_KEY", "click", 5, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.UnbufferCounter(kHashes, "STAT_KEY");
+  ASSERT_TRUE(s.ok());
+  CounterBufferStats stats;
+  s = db.GetCounterBufferStats(&stats);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(stats.dirty_counters, 0);
+  s = db.HGet("STAT_KEY", "click", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "15");
+}
+
+// The reads through the type dbs see the buffered increments, which go
+// on being buffered after them
+TEST_F(CounterBufferTest, ReadTest) {
+  int32_t len;
+  int64_t ret;
+  std::vector<FieldValue> fvs;
+  CounterBufferStats stats;
+
+  s = db.BufferCounter(kHashes, "READ_STAT_KEY");
+  ASSERT_TRUE(s.ok());
+  s = db.HIncrby("READ_STAT_KEY", "click", 5, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.HGetall("READ_STAT_KEY", &fvs);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(fvs.size(), 1);
+  ASSERT_EQ(fvs[0].value, "5");
+  s = db.GetCounterBufferStats(&stats);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(stats.dirty_counters, 0);
+
+  s = db.HIncrby("READ_STAT_KEY", "click", 2, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 7);
+  s = db.GetCounterBufferStats(&stats);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(stats.dirty_counters, 1);
+  s = db.HLen("READ_STAT_KEY", &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 1);
+  s = db.HStrlen("READ_STAT_KEY", "click", &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 1);
+  s = db.HGetall("READ_STAT_KEY", &fvs);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(fvs[0].value, "7");
+}
+
+// ZIncrby and ZScore
+TEST_F(CounterBufferTest, ZSetCounterTest) {
+  int32_t ret;
+  double score;
+
+  s = db.ZAdd("RANK_KEY", {{1, "a"}, {2, "b"}}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.BufferCounter(kZSets, "RANK_KEY");
+  ASSERT_TRUE(s.ok());
+  for (int32_t idx = 0; idx < 4; ++idx) {
+    s = db.ZIncrby("RANK_KEY", "a", 0.5, &score);
+    ASSERT_TRUE(s.ok());
+  }
+  ASSERT_EQ(score, 3);
+  s = db.ZScore("RANK_KEY", "a", &score);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(score, 3);
+
+  std::vector<ScoreMember> sm_out;
+  s = db.ZRange("RANK_KEY", 0, -1, &sm_out);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(sm_out.size(), 2);
+  ASSERT_EQ(sm_out[0].member, "b");
+  ASSERT_EQ(sm_out[1].member, "a");
+  ASSERT_EQ(sm_out[1].score, 3);
+}
+
+// Del drops the buffered increments together with the key
+TEST_F(CounterBufferTest, DelTest) {
+  int64_t ret;
+  std::string value;
+  std::map<DataType, Status> type_status;
+
+  s = db.BufferCounter(kStrings, "DEL_PV_KEY");
+  ASSERT_TRUE(s.ok());
+  s = db.Incrby("DEL_PV_KEY", 7, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(db.Del({"DEL_PV_KEY"}, &type_status), 1);
+  s = db.Get("DEL_PV_KEY", &value);
+  ASSERT_TRUE(s.IsNotFound());
+  s = db.Incrby("DEL_PV_KEY", 1, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+}
+
+// PKPatternMatchDel drops the buffered counters of the deleted keys
+TEST_F(CounterBufferTest, PatternDelTest) {
+  int64_t ret;
+  int32_t delete_count;
+  std::string value;
+
+  s = db.BufferCounter(kStrings, "PATTERN_PV_KEY");
+  ASSERT_TRUE(s.ok());
+  s = db.BufferCounter(kHashes, "PATTERN_HASH_KEY");
+  ASSERT_TRUE(s.ok());
+  s = db.Incrby("PATTERN_PV_KEY", 7, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.HIncrby("PATTERN_HASH_KEY", "pv", 5, &ret);
+  ASSERT_TRUE(s.ok());
+
+  s = db.PKPatternMatchDel(kStrings, "PATTERN_*", &delete_count);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(delete_count, 1);
+  s = db.PKPatternMatchDel(kHashes, "PATTERN_*", &delete_count);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(delete_count, 1);
+
+  s = db.Incrby("PATTERN_PV_KEY", 2, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 2);
+  s = db.HIncrby("PATTERN_HASH_KEY", "pv", 3, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 3);
+  s = db.Get("PATTERN_PV_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "2");
+}
+
+// A buffered counter goes away with the expired key, the rate limiter
+// pattern of INCR and EXPIRE
+TEST_F(CounterBufferTest, ExpireTest) {
+  int64_t ret;
+  std::string value;
+  std::map<DataType, Status> type_status;
+
+  s = db.BufferCounter(kStrings, "LIMIT_KEY");
+  ASSERT_TRUE(s.ok());
+  s = db.Incrby("LIMIT_KEY", 1, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(db.Expire("LIMIT_KEY", 1, &type_status), 1);
+  s = db.Incrby("LIMIT_KEY", 1, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 2);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+  s = db.Get("LIMIT_KEY", &value);
+  ASSERT_TRUE(s.IsNotFound());
+  s = db.Incrby("LIMIT_KEY", 1, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  std::map<DataType, int64_t> ttl = db.TTL("LIMIT_KEY", &type_status);
+  ASSERT_EQ(ttl[kStrings], -1);
+  s = db.Get("LIMIT_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "1");
+}
+
+// The increments buffered while Set writes the key never read the value
+// Set replaces
+TEST_F(CounterBufferTest, SetRaceTest) {
+  int64_t ret;
+  std::string value, stored_value;
+
+  s = db.BufferCounter(kStrings, "RACE_PV_KEY");
+  ASSERT_TRUE(s.ok());
+  for (int32_t round = 0; round < 50; ++round) {
+    std::vector<std::thread> threads;
+    threads.emplace_back([&]() {
+      for (int32_t idx = 0; idx < 100; ++idx) {
+        db.Set("RACE_PV_KEY", "1000");
+      }
+    });
+    for (int32_t thread = 0; thread < 3; ++thread) {
+      threads.emplace_back([&]() {
+        int64_t incr_ret;
+        for (int32_t idx = 0; idx < 100; ++idx) {
+          db.Incrby("RACE_PV_KEY", 1, &incr_ret);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    s = db.Incrby("RACE_PV_KEY", 1, &ret);
+    ASSERT_TRUE(s.ok());
+    int32_t len;
+    s = db.Strlen("RACE_PV_KEY", &len);
+    ASSERT_TRUE(s.ok());
+    s = db.Get("RACE_PV_KEY", &stored_value);
+    ASSERT_TRUE(s.ok());
+    ASSERT_EQ(std::to_string(ret), stored_value);
+  }
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
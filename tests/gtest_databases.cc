@@ -0,0 +1,250 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <iostream>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+class DatabasesTest : public ::testing::Test {
+ public:
+  DatabasesTest() {
+    std::string path = "./db/databases";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    bw_options.databases = 16;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~DatabasesTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+// The same key in different databases are different keys
+TEST_F(DatabasesTest, SelectTest) {
+  int32_t ret;
+  std::string value;
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(db.SelectedDB(), 0);
+  s = db.Set("SELECT_KEY", "db0");
+  ASSERT_TRUE(s.ok());
+  s = db.HSet("SELECT_HASH_KEY", "field", "db0", &ret);
+  ASSERT_TRUE(s.ok());
+
+  s = db.Select(1);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(db.SelectedDB(), 1);
+  s = db.Get("SELECT_KEY", &value);
+  ASSERT_TRUE(s.IsNotFound());
+  s = db.HGet("SELECT_HASH_KEY", "field", &value);
+  ASSERT_TRUE(s.IsNotFound());
+  s = db.Set("SELECT_KEY", "db1");
+  ASSERT_TRUE(s.ok());
+
+  std::vector<std::string> keys;
+  s = db.Keys(DataType::kAll, "SELECT_*", &keys);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(keys.size(), 1);
+  ASSERT_EQ(keys[0], "SELECT_KEY");
+  keys.clear();
+  int64_t cursor = db.Scan(DataType::kAll, 0, "*", 100, &keys);
+  ASSERT_EQ(cursor, 0);
+  ASSERT_EQ(keys.size(), 1);
+
+  // Another thread starts from database 0
+  std::thread thread([&]() {
+    std::string thread_value;
+    Status thread_s = db.Get("SELECT_KEY", &thread_value);
+    ASSERT_TRUE(thread_s.ok());
+    ASSERT_EQ(thread_value, "db0");
+  });
+  thread.join();
+
+  s = db.Get("SELECT_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "db1");
+
+  s = db.Select(16);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  ASSERT_EQ(db.SelectedDB(), 1);
+}
+
+TEST_F(DatabasesTest, FlushDBTest) {
+  int32_t ret;
+  int64_t count;
+  ASSERT_TRUE(s.ok());
+  for (uint32_t idx = 2; idx < 4; ++idx) {
+    s = db.Select(idx);
+    ASSERT_TRUE(s.ok());
+    s = db.Set("FLUSHDB_KEY", "value");
+    ASSERT_TRUE(s.ok());
+    s = db.SAdd("FLUSHDB_SET_KEY", {"a", "b"}, &ret);
+    ASSERT_TRUE(s.ok());
+    s = db.ZAdd("FLUSHDB_ZSET_KEY", {{1, "a"}}, &ret);
+    ASSERT_TRUE(s.ok());
+  }
+  s = db.DBSize(2, &count);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(count, 3);
+
+  s = db.FlushDB(2);
+  ASSERT_TRUE(s.ok());
+  s = db.DBSize(2, &count);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(count, 0);
+  s = db.DBSize(3, &count);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(count, 3);
+
+  s = db.Select(2);
+  ASSERT_TRUE(s.ok());
+  std::vector<std::string> members;
+  s = db.SMembers("FLUSHDB_SET_KEY", &members);
+  ASSERT_TRUE(s.IsNotFound());
+  // A key created again after the flush starts empty
+  s = db.SAdd("FLUSHDB_SET_KEY", {"c"}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.SMembers("FLUSHDB_SET_KEY", &members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(members.size(), 1);
+
+  s = db.FlushDB(16);
+  ASSERT_TRUE(s.IsInvalidArgument());
+}
+
+// FLUSHDB, HSET and HGETALL within the same second, the hash does not
+// get the fields written before the flush back
+TEST_F(DatabasesTest, FlushDBRecreateTest) {
+  int32_t ret;
+  std::vector<FieldValue> fvs;
+  std::map<DataType, Status> type_status;
+  ASSERT_TRUE(s.ok());
+  s = db.Select(4);
+  ASSERT_TRUE(s.ok());
+
+  // Deleted and written again, the version runs ahead of the time
+  for (int32_t round = 0; round < 5; ++round) {
+    s = db.HMSet("RECREATE_HASH_KEY",
+                 {{"FIELD_1", "VALUE"}, {"FIELD_2", "VALUE"}});
+    ASSERT_TRUE(s.ok());
+    if (round != 4) {
+      ASSERT_EQ(db.Del({"RECREATE_HASH_KEY"}, &type_status), 1);
+    }
+  }
+  s = db.FlushDB(4);
+  ASSERT_TRUE(s.ok());
+  s = db.HSet("RECREATE_HASH_KEY", "FIELD_3", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.HGetall("RECREATE_HASH_KEY", &fvs);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(fvs.size(), 1);
+  ASSERT_EQ(fvs[0].field, "FIELD_3");
+}
+
+// FlushDB drops the buffered counters of the database keys
+TEST_F(DatabasesTest, FlushDBCounterTest) {
+  BlackwidowOptions options;
+  options.options.create_if_missing = true;
+  options.databases = 16;
+  options.counter_flush_interval_ms = 600000;
+  blackwidow::BlackWidow counter_db;
+  s = counter_db.Open(options, "./db/databases_counter");
+  ASSERT_TRUE(s.ok());
+
+  int64_t ret;
+  std::string value;
+  DBContext context(&counter_db, 7);
+  ASSERT_TRUE(context.status().ok());
+  s = counter_db.BufferCounter(kStrings, "FLUSH_PV_KEY");
+  ASSERT_TRUE(s.ok());
+  s = counter_db.Incrby("FLUSH_PV_KEY", 7, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 7);
+
+  s = counter_db.FlushDB(7);
+  ASSERT_TRUE(s.ok());
+  s = counter_db.Incrby("FLUSH_PV_KEY", 2, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 2);
+  s = counter_db.Get("FLUSH_PV_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "2");
+}
+
+// DBContext selects a database for a scope
+TEST_F(DatabasesTest, DBContextTest) {
+  std::string value;
+  ASSERT_TRUE(s.ok());
+  s = db.Select(5);
+  ASSERT_TRUE(s.ok());
+  s = db.Set("CONTEXT_KEY", "db5");
+  ASSERT_TRUE(s.ok());
+  {
+    DBContext context(&db, 6);
+    ASSERT_TRUE(context.status().ok());
+    ASSERT_EQ(db.SelectedDB(), 6);
+    s = db.Get("CONTEXT_KEY", &value);
+    ASSERT_TRUE(s.IsNotFound());
+    s = db.Set("CONTEXT_KEY", "db6");
+    ASSERT_TRUE(s.ok());
+  }
+  ASSERT_EQ(db.SelectedDB(), 5);
+  s = db.Get("CONTEXT_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "db5");
+
+  {
+    DBContext context(&db, 16);
+    ASSERT_TRUE(context.status().IsInvalidArgument());
+    ASSERT_EQ(db.SelectedDB(), 5);
+  }
+  ASSERT_EQ(db.SelectedDB(), 5);
+
+  // The selection belongs to the thread
+  std::thread thread([&]() {
+    DBContext context(&db, 6);
+    std::string thread_value;
+    Status st = db.Get("CONTEXT_KEY", &thread_value);
+    ASSERT_TRUE(st.ok());
+    ASSERT_EQ(thread_value, "db6");
+  });
+  thread.join();
+  ASSERT_EQ(db.SelectedDB(), 5);
+}
+
+TEST_F(DatabasesTest, OptionsTest) {
+  blackwidow::BlackWidow invalid_db;
+  BlackwidowOptions invalid_options;
+  invalid_options.options.create_if_missing = true;
+  invalid_options.databases = 16;
+  invalid_options.slot_tagged_keys = true;
+  s = invalid_db.Open(invalid_options, "./db/databases_invalid");
+  ASSERT_TRUE(s.IsInvalidArgument());
+
+  blackwidow::BlackWidow single_db;
+  BlackwidowOptions single_options;
+  single_options.options.create_if_missing = true;
+  s = single_db.Open(single_options, "./db/databases_single");
+  ASSERT_TRUE(s.ok());
+  s = single_db.Select(1);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = single_db.FlushDB(0);
+  ASSERT_TRUE(s.IsNotSupported());
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,294 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <atomic>
+#include <iostream>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+class DumpTest : public ::testing::Test {
+ public:
+  DumpTest() {
+    std::string path = "./db/dump";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    bw_options.max_dump_size = 64 << 20;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~DumpTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+// Dump and restore every data type
+TEST_F(DumpTest, RoundTripTest) {
+  int32_t ret;
+  uint64_t len;
+  std::string dump;
+  std::string value;
+  std::vector<FieldValue> fvs;
+  std::vector<std::string> members;
+  std::vector<ScoreMember> score_members;
+
+  s = db.Set("DUMP_STRING_KEY", "VALUE");
+  ASSERT_TRUE(s.ok());
+  s = db.Dump("DUMP_STRING_KEY", &dump);
+  ASSERT_TRUE(s.ok());
+  s = db.Restore("RESTORE_STRING_KEY", dump, 0, false);
+  ASSERT_TRUE(s.ok());
+  s = db.Get("RESTORE_STRING_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE");
+
+  // A counter is dumped as its string representation
+  int64_t counter;
+  s = db.Incrby("DUMP_COUNTER_KEY", 42, &counter);
+  ASSERT_TRUE(s.ok());
+  s = db.Dump("DUMP_COUNTER_KEY", &dump);
+  ASSERT_TRUE(s.ok());
+  s = db.Restore("RESTORE_COUNTER_KEY", dump, 0, false);
+  ASSERT_TRUE(s.ok());
+  s = db.Get("RESTORE_COUNTER_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "42");
+
+  s = db.HMSet("DUMP_HASH_KEY", {{"F1", "V1"}, {"F2", "V2"}});
+  ASSERT_TRUE(s.ok());
+  s = db.Dump("DUMP_HASH_KEY", &dump);
+  ASSERT_TRUE(s.ok());
+  s = db.Restore("RESTORE_HASH_KEY", dump, 0, false);
+  ASSERT_TRUE(s.ok());
+  s = db.HGetall("RESTORE_HASH_KEY", &fvs);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(fvs.size(), 2);
+  ASSERT_EQ(fvs[0].field, "F1");
+  ASSERT_EQ(fvs[0].value, "V1");
+  ASSERT_EQ(fvs[1].field, "F2");
+  ASSERT_EQ(fvs[1].value, "V2");
+  s = db.HLen("RESTORE_HASH_KEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 2);
+
+  s = db.SAdd("DUMP_SET_KEY", {"a", "b", "c"}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.Dump("DUMP_SET_KEY", &dump);
+  ASSERT_TRUE(s.ok());
+  s = db.Restore("RESTORE_SET_KEY", dump, 0, false);
+  ASSERT_TRUE(s.ok());
+  s = db.SMembers("RESTORE_SET_KEY", &members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(members, std::vector<std::string>({"a", "b", "c"}));
+  s = db.SCard("RESTORE_SET_KEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 3);
+
+  s = db.RPush("DUMP_LIST_KEY", {"a", "b", "c"}, &len);
+  ASSERT_TRUE(s.ok());
+  s = db.LPush("DUMP_LIST_KEY", {"z"}, &len);
+  ASSERT_TRUE(s.ok());
+  s = db.Dump("DUMP_LIST_KEY", &dump);
+  ASSERT_TRUE(s.ok());
+  s = db.Restore("RESTORE_LIST_KEY", dump, 0, false);
+  ASSERT_TRUE(s.ok());
+  s = db.LRange("RESTORE_LIST_KEY", 0, -1, &members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(members, std::vector<std::string>({"z", "a", "b", "c"}));
+  s = db.LPush("RESTORE_LIST_KEY", {"y"}, &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 5);
+
+  s = db.ZAdd("DUMP_ZSET_KEY", {{-1.5, "a"}, {2, "b"}}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.Dump("DUMP_ZSET_KEY", &dump);
+  ASSERT_TRUE(s.ok());
+  s = db.Restore("RESTORE_ZSET_KEY", dump, 0, false);
+  ASSERT_TRUE(s.ok());
+  s = db.ZRange("RESTORE_ZSET_KEY", 0, -1, &score_members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(score_members.size(), 2);
+  ASSERT_EQ(score_members[0].score, -1.5);
+  ASSERT_EQ(score_members[0].member, "a");
+  ASSERT_EQ(score_members[1].score, 2);
+  ASSERT_EQ(score_members[1].member, "b");
+  double score;
+  s = db.ZScore("RESTORE_ZSET_KEY", "b", &score);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(score, 2);
+
+  // Not exist
+  s = db.Dump("DUMP_NOT_EXIST_KEY", &dump);
+  ASSERT_TRUE(s.IsNotFound());
+}
+
+// The timeout and the existing target key
+TEST_F(DumpTest, RestoreTargetTest) {
+  int32_t ret;
+  std::string dump;
+  std::vector<std::string> members;
+  std::map<DataType, Status> type_status;
+
+  s = db.SAdd("TARGET_SET_KEY", {"a", "b"}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.Dump("TARGET_SET_KEY", &dump);
+  ASSERT_TRUE(s.ok());
+
+  s = db.Restore("TARGET_TTL_KEY", dump, 100, false);
+  ASSERT_TRUE(s.ok());
+  std::map<DataType, int64_t> ttl = db.TTL("TARGET_TTL_KEY", &type_status);
+  ASSERT_GT(ttl[DataType::kSets], 0);
+  ASSERT_LE(ttl[DataType::kSets], 100);
+
+  s = db.Set("TARGET_EXIST_KEY", "VALUE");
+  ASSERT_TRUE(s.ok());
+  s = db.Restore("TARGET_EXIST_KEY", dump, 0, false);
+  ASSERT_TRUE(s.IsBusy());
+
+  // Replace removes the key from the other data types
+  s = db.Restore("TARGET_EXIST_KEY", dump, 0, true);
+  ASSERT_TRUE(s.ok());
+  std::string value;
+  s = db.Get("TARGET_EXIST_KEY", &value);
+  ASSERT_TRUE(s.IsNotFound());
+  s = db.SMembers("TARGET_EXIST_KEY", &members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(members, std::vector<std::string>({"a", "b"}));
+
+  // Replace a collection of the same data type
+  s = db.SAdd("TARGET_SAME_KEY", {"x", "y", "z"}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.Restore("TARGET_SAME_KEY", dump, 0, true);
+  ASSERT_TRUE(s.ok());
+  s = db.SMembers("TARGET_SAME_KEY", &members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(members, std::vector<std::string>({"a", "b"}));
+}
+
+// Concurrent restores without replace, exactly one of them creates the key
+TEST_F(DumpTest, RestoreRaceTest) {
+  int32_t ret;
+  std::string hash_dump, value_dump;
+  s = db.HSet("RACE_HASH_KEY", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.Dump("RACE_HASH_KEY", &hash_dump);
+  ASSERT_TRUE(s.ok());
+  s = db.Set("RACE_STRING_KEY", "VALUE");
+  ASSERT_TRUE(s.ok());
+  s = db.Dump("RACE_STRING_KEY", &value_dump);
+  ASSERT_TRUE(s.ok());
+
+  for (const std::string* dump : {&hash_dump, &value_dump}) {
+    for (int32_t round = 0; round < 50; ++round) {
+      std::string key = "RACE_RESTORE_KEY_" + std::to_string(round);
+      std::atomic<int32_t> restored(0);
+      std::atomic<int32_t> busy(0);
+      std::vector<std::thread> threads;
+      for (int32_t idx = 0; idx < 4; ++idx) {
+        threads.emplace_back([&]() {
+          Status st = db.Restore(key, *dump, 0, false);
+          if (st.ok()) {
+            restored++;
+          } else if (st.IsBusy()) {
+            busy++;
+          }
+        });
+      }
+      for (auto& thread : threads) {
+        thread.join();
+      }
+      ASSERT_EQ(restored, 1);
+      ASSERT_EQ(busy, 3);
+      std::map<DataType, Status> type_status;
+      ASSERT_EQ(db.Del({key}, &type_status), 1);
+    }
+  }
+}
+
+// Corrupted dumps are refused
+TEST_F(DumpTest, CorruptionTest) {
+  int32_t ret;
+  std::string dump;
+
+  s = db.HSet("CORRUPTION_HASH_KEY", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.Dump("CORRUPTION_HASH_KEY", &dump);
+  ASSERT_TRUE(s.ok());
+
+  for (size_t idx = 0; idx < dump.size(); ++idx) {
+    std::string corrupted = dump;
+    corrupted[idx] ^= 0x01;
+    s = db.Restore("CORRUPTION_RESTORE_KEY", corrupted, 0, false);
+    ASSERT_FALSE(s.ok());
+  }
+  s = db.Restore("CORRUPTION_RESTORE_KEY", dump.substr(0, dump.size() - 1),
+                 0, false);
+  ASSERT_TRUE(s.IsCorruption());
+  s = db.Restore("CORRUPTION_RESTORE_KEY", "", 0, false);
+  ASSERT_TRUE(s.IsCorruption());
+
+  std::vector<FieldValue> fvs;
+  s = db.HGetall("CORRUPTION_RESTORE_KEY", &fvs);
+  ASSERT_TRUE(s.IsNotFound());
+}
+
+// A collection bigger than one restore batch, and the size limit
+TEST_F(DumpTest, BigCollectionTest) {
+  int32_t ret;
+  std::string dump;
+  std::vector<FieldValue> fvs;
+  std::string value(256, 'v');
+  for (int32_t idx = 0; idx < 30000; ++idx) {
+    fvs.push_back({"FIELD_" + std::to_string(idx), value});
+  }
+  s = db.HMSet("BIG_HASH_KEY", fvs);
+  ASSERT_TRUE(s.ok());
+  s = db.Dump("BIG_HASH_KEY", &dump);
+  ASSERT_TRUE(s.ok());
+  ASSERT_GT(dump.size(), 30000 * value.size());
+
+  s = db.Restore("BIG_RESTORE_KEY", dump, 0, false);
+  ASSERT_TRUE(s.ok());
+  s = db.HLen("BIG_RESTORE_KEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 30000);
+  s = db.HGet("BIG_RESTORE_KEY", "FIELD_29999", &value);
+  ASSERT_TRUE(s.ok());
+
+  std::string small_path = "./db/dump_small";
+  if (access(small_path.c_str(), F_OK)) {
+    mkdir(small_path.c_str(), 0755);
+  }
+  BlackwidowOptions options;
+  options.options.create_if_missing = true;
+  options.max_dump_size = 1 << 20;
+  blackwidow::BlackWidow small_db;
+  s = small_db.Open(options, small_path);
+  ASSERT_TRUE(s.ok());
+  s = small_db.HMSet("BIG_HASH_KEY", fvs);
+  ASSERT_TRUE(s.ok());
+  s = small_db.Dump("BIG_HASH_KEY", &dump);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  ASSERT_TRUE(dump.empty());
+
+  s = db.Dump("BIG_HASH_KEY", &dump);
+  ASSERT_TRUE(s.ok());
+  s = small_db.Restore("BIG_RESTORE_KEY", dump, 0, false);
+  ASSERT_TRUE(s.IsInvalidArgument());
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
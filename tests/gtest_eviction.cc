@@ -0,0 +1,90 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <iostream>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+class EvictionTest : public ::testing::Test {
+ public:
+  EvictionTest() {
+    std::string path = "./db/eviction";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    // Any data is beyond the budget
+    bw_options.max_data_size = 1;
+    bw_options.eviction_interval_ms = 100;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~EvictionTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+// Keys of every type are evicted
+TEST_F(EvictionTest, EvictTest) {
+  int32_t ret;
+  uint64_t len;
+  std::vector<std::string> keys;
+  for (int32_t idx = 0; idx < 100; ++idx) {
+    keys.push_back("EVICT_KEY_" + std::to_string(idx));
+    s = db.Set(keys.back(), "value");
+    ASSERT_TRUE(s.ok());
+  }
+  s = db.HSet("EVICT_HASH_KEY", "field", "value", &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.SAdd("EVICT_SET_KEY", {"a", "b"}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.RPush("EVICT_LIST_KEY", {"a", "b"}, &len);
+  ASSERT_TRUE(s.ok());
+  s = db.ZAdd("EVICT_ZSET_KEY", {{1, "a"}}, &ret);
+  ASSERT_TRUE(s.ok());
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+  EvictionStats stats;
+  s = db.GetEvictionStats(&stats);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(stats.max_data_size, 1);
+  ASSERT_GT(stats.data_size, 1);
+  ASSERT_GT(stats.eviction_rounds, 0);
+  ASSERT_EQ(stats.evicted_keys, 104);
+
+  std::map<DataType, Status> type_status;
+  keys.push_back("EVICT_HASH_KEY");
+  keys.push_back("EVICT_SET_KEY");
+  keys.push_back("EVICT_LIST_KEY");
+  keys.push_back("EVICT_ZSET_KEY");
+  ASSERT_EQ(db.Exists(keys, &type_status), 0);
+}
+
+// Disabled without max_data_size
+TEST_F(EvictionTest, DisabledTest) {
+  blackwidow::BlackWidow unbounded_db;
+  BlackwidowOptions unbounded_options;
+  unbounded_options.options.create_if_missing = true;
+  s = unbounded_db.Open(unbounded_options, "./db/eviction_unbounded");
+  ASSERT_TRUE(s.ok());
+
+  EvictionStats stats;
+  s = unbounded_db.GetEvictionStats(&stats);
+  ASSERT_TRUE(s.IsNotSupported());
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
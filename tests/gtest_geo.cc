@@ -0,0 +1,196 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <iostream>
+#include <algorithm>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+class GeoTest : public ::testing::Test {
+ public:
+  GeoTest() {
+    std::string path = "./db/geo";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~GeoTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+static std::vector<std::string> Members(const std::vector<GeoPoint>& points) {
+  std::vector<std::string> members;
+  for (const auto& point : points) {
+    members.push_back(point.member);
+  }
+  return members;
+}
+
+// GeoAdd
+TEST_F(GeoTest, GeoAddTest) {
+  int32_t ret = 0;
+  s = db.GeoAdd("GEO_ADD_KEY", {{"Palermo", 13.361389, 38.115556, 0},
+                                {"Catania", 15.087269, 37.502669, 0}}, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 2);
+
+  // The score is the 52 bit geohash, the same as redis
+  double score;
+  s = db.ZScore("GEO_ADD_KEY", "Palermo", &score);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(static_cast<uint64_t>(score), 3479099956230698ULL);
+
+  s = db.GeoAdd("GEO_ADD_KEY", {{"Palermo", 13.361389, 38.115556, 0}}, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 0);
+
+  // Nothing is added if a position is invalid
+  s = db.GeoAdd("GEO_ADD_KEY", {{"Rome", 12.496366, 41.902782, 0},
+                                {"Pole", 0, 89, 0}}, &ret);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.GeoAdd("GEO_ADD_KEY", {{"Nowhere", 181, 0, 0}}, &ret);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  int32_t card = 0;
+  s = db.ZCard("GEO_ADD_KEY", &card);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(card, 2);
+}
+
+// GeoPos & GeoDist
+TEST_F(GeoTest, GeoPosTest) {
+  int32_t ret = 0;
+  s = db.GeoAdd("GEO_POS_KEY", {{"Palermo", 13.361389, 38.115556, 0},
+                                {"Catania", 15.087269, 37.502669, 0}}, &ret);
+  ASSERT_TRUE(s.ok());
+
+  std::vector<GeoPosStatus> positions;
+  s = db.GeoPos("GEO_POS_KEY", {"Palermo", "Missing"}, &positions);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(positions.size(), 2);
+  ASSERT_TRUE(positions[0].status.ok());
+  ASSERT_NEAR(positions[0].longitude, 13.361389, 0.00001);
+  ASSERT_NEAR(positions[0].latitude, 38.115556, 0.00001);
+  ASSERT_TRUE(positions[1].status.IsNotFound());
+
+  double distance = 0;
+  s = db.GeoDist("GEO_POS_KEY", "Palermo", "Catania", &distance);
+  ASSERT_TRUE(s.ok());
+  ASSERT_NEAR(distance, 166274.15, 1);
+  s = db.GeoDist("GEO_POS_KEY", "Palermo", "Missing", &distance);
+  ASSERT_TRUE(s.IsNotFound());
+}
+
+// GeoSearch
+TEST_F(GeoTest, GeoSearchTest) {
+  int32_t ret = 0;
+  std::vector<GeoPoint> points;
+  s = db.GeoAdd("GEO_SEARCH_KEY", {{"Palermo", 13.361389, 38.115556, 0},
+                                   {"Catania", 15.087269, 37.502669, 0},
+                                   {"edge1", 12.758489, 38.788135, 0},
+                                   {"edge2", 17.241510, 38.788135, 0}}, &ret);
+  ASSERT_TRUE(s.ok());
+
+  // Radius
+  s = db.GeoSearch("GEO_SEARCH_KEY",
+      {15, 37, true, 200 * 1000, 0, 0}, 0, &points);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(Members(points),
+            std::vector<std::string>({"Catania", "Palermo"}));
+  ASSERT_NEAR(points[0].distance, 56441.26, 1);
+  ASSERT_NEAR(points[1].distance, 190442.43, 1);
+
+  // Count keeps the nearest ones
+  s = db.GeoSearch("GEO_SEARCH_KEY",
+      {15, 37, true, 200 * 1000, 0, 0}, 1, &points);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(Members(points), std::vector<std::string>({"Catania"}));
+
+  // Box
+  s = db.GeoSearch("GEO_SEARCH_KEY",
+      {15, 37, false, 0, 400 * 1000, 400 * 1000}, 0, &points);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(Members(points),
+            std::vector<std::string>({"Catania", "Palermo", "edge2", "edge1"}));
+
+  // Nothing around
+  s = db.GeoSearch("GEO_SEARCH_KEY",
+      {-73.9, 40.7, true, 1000, 0, 0}, 0, &points);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(points.empty());
+
+  s = db.GeoSearch("GEO_SEARCH_KEY",
+      {15, 37, true, -1, 0, 0}, 0, &points);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.GeoSearch("GEO_SEARCH_MISSING_KEY",
+      {15, 37, true, 1000, 0, 0}, 0, &points);
+  ASSERT_TRUE(s.IsNotFound());
+}
+
+// Every member in the radius is found, on both sides of the antimeridian
+TEST_F(GeoTest, GeoSearchCoverTest) {
+  int32_t ret = 0;
+  std::vector<GeoPoint> grid;
+  std::vector<std::string> members;
+  for (int32_t lon = -10; lon <= 10; ++lon) {
+    for (int32_t lat = -10; lat <= 10; ++lat) {
+      double longitude = 180 + lon * 0.01;
+      if (longitude > 180) {
+        longitude -= 360;
+      }
+      members.push_back(std::to_string(lon) + "," + std::to_string(lat));
+      grid.push_back({members.back(), longitude, 10 + lat * 0.01, 0});
+    }
+  }
+  grid.push_back({"center", 180, 10, 0});
+  s = db.GeoAdd("GEO_COVER_KEY", grid, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 442);
+
+  std::vector<GeoPosStatus> positions;
+  s = db.GeoPos("GEO_COVER_KEY", {"center"}, &positions);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(positions[0].status.ok());
+
+  std::vector<std::string> expected = {"center"};
+  for (const auto& member : members) {
+    double distance = 0;
+    s = db.GeoDist("GEO_COVER_KEY", "center", member, &distance);
+    ASSERT_TRUE(s.ok());
+    if (distance <= 5000) {
+      expected.push_back(member);
+    }
+  }
+  ASSERT_LT(expected.size(), members.size());
+
+  std::vector<GeoPoint> points;
+  GeoShape shape = {positions[0].longitude, positions[0].latitude,
+                    true, 5000, 0, 0};
+  s = db.GeoSearch("GEO_COVER_KEY", shape, 0, &points);
+  ASSERT_TRUE(s.ok());
+  for (size_t idx = 1; idx < points.size(); ++idx) {
+    ASSERT_LE(points[idx - 1].distance, points[idx].distance);
+  }
+  std::vector<std::string> found = Members(points);
+  std::sort(found.begin(), found.end());
+  std::sort(expected.begin(), expected.end());
+  ASSERT_EQ(found, expected);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
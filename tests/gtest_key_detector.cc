@@ -0,0 +1,93 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+
+#include "blackwidow/blackwidow.h"
+#include "src/key_detector.h"
+
+using namespace blackwidow;
+
+TEST(KeyDetectorTest, HotKeysTest) {
+  std::vector<KeyCount> hot_keys;
+  blackwidow::KeyDetector key_detector(1, 2);
+
+  for (int32_t idx = 0; idx < 100; ++idx) {
+    key_detector.RecordAccess(kStrings, "HOT_KEY");
+  }
+  for (int32_t idx = 0; idx < 50; ++idx) {
+    key_detector.RecordAccess(kStrings, "WARM_KEY");
+  }
+  for (int32_t idx = 0; idx < 10; ++idx) {
+    key_detector.RecordAccess(kStrings, "COLD_KEY_" + std::to_string(idx));
+  }
+  key_detector.RecordAccess(kHashes, "HOT_KEY");
+
+  key_detector.GetHotKeys(kStrings, &hot_keys);
+  ASSERT_EQ(hot_keys.size(), 2);
+  ASSERT_EQ(hot_keys[0].key, "HOT_KEY");
+  ASSERT_GE(hot_keys[0].count, 100);
+  ASSERT_EQ(hot_keys[1].key, "WARM_KEY");
+  ASSERT_GE(hot_keys[1].count, 50);
+
+  key_detector.GetHotKeys(kHashes, &hot_keys);
+  ASSERT_EQ(hot_keys.size(), 1);
+  ASSERT_EQ(hot_keys[0].key, "HOT_KEY");
+
+  // The access counters are halved, the single access one is gone
+  key_detector.Decay();
+  key_detector.GetHotKeys(kStrings, &hot_keys);
+  ASSERT_EQ(hot_keys.size(), 2);
+  ASSERT_GE(hot_keys[0].count, 50);
+  ASSERT_LT(hot_keys[0].count, 100);
+  key_detector.GetHotKeys(kHashes, &hot_keys);
+  ASSERT_EQ(hot_keys.size(), 0);
+}
+
+TEST(KeyDetectorTest, SampleRateTest) {
+  std::vector<KeyCount> hot_keys;
+  blackwidow::KeyDetector key_detector(10, 4);
+  for (int32_t idx = 0; idx < 1000; ++idx) {
+    key_detector.RecordAccess(kSets, "HOT_KEY");
+  }
+  key_detector.GetHotKeys(kSets, &hot_keys);
+  ASSERT_EQ(hot_keys.size(), 1);
+  ASSERT_EQ(hot_keys[0].count, 1000);
+
+  // Disabled
+  blackwidow::KeyDetector disabled_key_detector(0, 4);
+  disabled_key_detector.RecordAccess(kSets, "HOT_KEY");
+  disabled_key_detector.GetHotKeys(kSets, &hot_keys);
+  ASSERT_EQ(hot_keys.size(), 0);
+}
+
+TEST(KeyDetectorTest, BigKeysTest) {
+  std::vector<KeyCount> big_keys;
+  blackwidow::KeyDetector key_detector(0, 2);
+
+  key_detector.RecordBigKey(kHashes, "BIG_KEY_1", 1000, 1);
+  key_detector.RecordBigKey(kHashes, "BIG_KEY_2", 3000, 1);
+  key_detector.RecordBigKey(kHashes, "BIG_KEY_3", 2000, 1);
+  key_detector.ExpireBigKeys(kHashes, 1);
+  key_detector.GetBigKeys(kHashes, &big_keys);
+  ASSERT_EQ(big_keys.size(), 2);
+  ASSERT_EQ(big_keys[0].key, "BIG_KEY_2");
+  ASSERT_EQ(big_keys[0].count, 3000);
+  ASSERT_EQ(big_keys[1].key, "BIG_KEY_3");
+  ASSERT_EQ(big_keys[1].count, 2000);
+
+  // BIG_KEY_2 was not seen in the second round
+  key_detector.RecordBigKey(kHashes, "BIG_KEY_3", 2500, 2);
+  key_detector.ExpireBigKeys(kHashes, 2);
+  key_detector.GetBigKeys(kHashes, &big_keys);
+  ASSERT_EQ(big_keys.size(), 1);
+  ASSERT_EQ(big_keys[0].key, "BIG_KEY_3");
+  ASSERT_EQ(big_keys[0].count, 2500);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -5,6 +5,7 @@
 
 #include <gtest/gtest.h>
 #include <thread>
+#include <limits>
 #include <iostream>
 
 #include "blackwidow/blackwidow.h"
@@ -5360,6 +5361,46 @@ TEST_F(KeysTest, TTLTest) {
   }
 }
 
+// A ttl beyond the int32 timestamps saturates instead of wrapping into
+// the past and expiring the key at once
+TEST_F(KeysTest, ExpireOverflowTest) {
+  int32_t ret = 0;
+  uint64_t llen;
+  std::map<blackwidow::DataType, Status> type_status;
+  std::map<blackwidow::DataType, int64_t> ttl_ret;
+
+  s = db.HSet("EXPIRE_OVERFLOW_KEY", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.SAdd("EXPIRE_OVERFLOW_KEY", {"MEMBER"}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.RPush("EXPIRE_OVERFLOW_KEY", {"NODE"}, &llen);
+  ASSERT_TRUE(s.ok());
+  s = db.ZAdd("EXPIRE_OVERFLOW_KEY", {{1, "MEMBER"}}, &ret);
+  ASSERT_TRUE(s.ok());
+
+  ret = db.Expire("EXPIRE_OVERFLOW_KEY",
+                  std::numeric_limits<int32_t>::max(), &type_status);
+  ASSERT_EQ(ret, 4);
+  ttl_ret = db.TTL("EXPIRE_OVERFLOW_KEY", &type_status);
+  ASSERT_GT(ttl_ret[kHashes], 0);
+  ASSERT_GT(ttl_ret[kSets], 0);
+  ASSERT_GT(ttl_ret[kLists], 0);
+  ASSERT_GT(ttl_ret[kZSets], 0);
+
+  s = db.HLen("EXPIRE_OVERFLOW_KEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  s = db.SCard("EXPIRE_OVERFLOW_KEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  s = db.LLen("EXPIRE_OVERFLOW_KEY", &llen);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(llen, 1);
+  s = db.ZCard("EXPIRE_OVERFLOW_KEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
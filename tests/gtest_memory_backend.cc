@@ -0,0 +1,207 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <limits>
+#include <iostream>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+class MemoryBackendTest : public ::testing::Test {
+ public:
+  MemoryBackendTest() {
+    std::string path = "./db/memory_backend";
+    bw_options.storage_backend = kMemoryBackend;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~MemoryBackendTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+// Open
+TEST_F(MemoryBackendTest, OpenTest) {
+  ASSERT_TRUE(s.ok());
+  // Nothing is written to the real filesystem
+  ASSERT_NE(access("./db/memory_backend", F_OK), 0);
+}
+
+// Commands of every data type work on the memory backend
+TEST_F(MemoryBackendTest, CommandsTest) {
+  int32_t ret;
+  uint64_t len;
+  std::string value;
+  std::vector<std::string> members;
+
+  s = db.Set("MEMORY_STRING_KEY", "VALUE");
+  ASSERT_TRUE(s.ok());
+  s = db.Get("MEMORY_STRING_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE");
+
+  s = db.HSet("MEMORY_HASH_KEY", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.HGet("MEMORY_HASH_KEY", "FIELD", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE");
+
+  s = db.SAdd("MEMORY_SET_KEY", {"a", "b", "c"}, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 3);
+  s = db.SCard("MEMORY_SET_KEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 3);
+
+  s = db.RPush("MEMORY_LIST_KEY", {"a", "b", "c"}, &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 3);
+  s = db.LRange("MEMORY_LIST_KEY", 0, -1, &members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(members.size(), 3);
+
+  s = db.ZAdd("MEMORY_ZSET_KEY", {{1, "a"}, {2, "b"}}, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 2);
+  s = db.ZCard("MEMORY_ZSET_KEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 2);
+
+  s = db.Compact(DataType::kAll, true);
+  ASSERT_TRUE(s.ok());
+  s = db.Get("MEMORY_STRING_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE");
+}
+
+// The data lives in the maps of the memory engine, the memtables of
+// the underlying rocksdb stay empty
+TEST_F(MemoryBackendTest, EngineTest) {
+  int32_t ret;
+  for (int i = 0; i < 100; i++) {
+    s = db.Set("MEMORY_ENGINE_KEY_" + std::to_string(i), "VALUE");
+    ASSERT_TRUE(s.ok());
+  }
+  s = db.HMSet("MEMORY_ENGINE_HASH_KEY",
+               {{"FIELD_1", "VALUE_1"}, {"FIELD_2", "VALUE_2"}});
+  ASSERT_TRUE(s.ok());
+  s = db.SAdd("MEMORY_ENGINE_SET_KEY", {"a", "b"}, &ret);
+  ASSERT_TRUE(s.ok());
+
+  ASSERT_EQ(db.GetProperty(STRINGS_DB, "rocksdb.estimate-num-keys"), 100);
+  // One meta key and two fields
+  ASSERT_EQ(db.GetProperty(HASHES_DB, "rocksdb.estimate-num-keys"), 3);
+  ASSERT_EQ(db.GetProperty(ALL_DB, "rocksdb.num-entries-active-mem-table"), 0);
+  ASSERT_GT(db.GetProperty(ALL_DB, "rocksdb.cur-size-all-mem-tables"), 0);
+}
+
+// Compact runs the compaction filters over the maps
+TEST_F(MemoryBackendTest, CompactTest) {
+  int32_t ret;
+  std::string value;
+  for (int i = 0; i < 100; i++) {
+    s = db.HSet("MEMORY_COMPACT_HASH_KEY",
+                "FIELD_" + std::to_string(i), "VALUE", &ret);
+    ASSERT_TRUE(s.ok());
+  }
+  ASSERT_EQ(db.GetProperty(HASHES_DB, "rocksdb.estimate-num-keys"), 101);
+
+  std::map<DataType, Status> type_status;
+  db.Del({"MEMORY_COMPACT_HASH_KEY"}, &type_status);
+  ASSERT_TRUE(type_status[DataType::kHashes].ok());
+  s = db.Compact(DataType::kHashes, true);
+  ASSERT_TRUE(s.ok());
+  // The fields are gone, at most the empty meta key is left
+  ASSERT_LE(db.GetProperty(HASHES_DB, "rocksdb.estimate-num-keys"), 1);
+
+  s = db.Setex("MEMORY_COMPACT_STRING_KEY", "VALUE", 1);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(db.GetProperty(STRINGS_DB, "rocksdb.estimate-num-keys"), 1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+  s = db.Compact(DataType::kStrings, true);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(db.GetProperty(STRINGS_DB, "rocksdb.estimate-num-keys"), 0);
+  s = db.Get("MEMORY_COMPACT_STRING_KEY", &value);
+  ASSERT_TRUE(s.IsNotFound());
+}
+
+// A batch the engine can not apply as a whole changes nothing
+TEST_F(MemoryBackendTest, BatchTest) {
+  std::string value;
+  rocksdb::DB* strings_db = db.GetDBByType(STRINGS_DB);
+  ASSERT_TRUE(strings_db != nullptr);
+
+  rocksdb::WriteBatch batch;
+  batch.Put("MEMORY_BATCH_KEY", "VALUE");
+  batch.Merge("MEMORY_BATCH_KEY", "VALUE");
+  s = strings_db->Write(rocksdb::WriteOptions(), &batch);
+  ASSERT_TRUE(s.IsNotSupported());
+  s = strings_db->Get(rocksdb::ReadOptions(), "MEMORY_BATCH_KEY", &value);
+  ASSERT_TRUE(s.IsNotFound());
+
+  batch.Clear();
+  batch.Put("MEMORY_BATCH_KEY", "VALUE");
+  s = strings_db->Write(rocksdb::WriteOptions(), &batch);
+  ASSERT_TRUE(s.ok());
+  s = strings_db->Get(rocksdb::ReadOptions(), "MEMORY_BATCH_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE");
+}
+
+// The maps keep the order of the custom comparators
+TEST_F(MemoryBackendTest, OrderTest) {
+  int32_t ret;
+  uint64_t len;
+  std::vector<std::string> values;
+  std::vector<ScoreMember> score_members;
+
+  s = db.ZAdd("MEMORY_ORDER_ZSET_KEY",
+              {{3.5, "c"}, {-1, "b"}, {-20, "a"}, {0, "z"}, {100, "d"}},
+              &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 5);
+  s = db.ZRangebyscore("MEMORY_ORDER_ZSET_KEY",
+                       std::numeric_limits<double>::lowest(),
+                       std::numeric_limits<double>::max(),
+                       true, true, &score_members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(score_members.size(), 5);
+  ASSERT_EQ(score_members[0].member, "a");
+  ASSERT_EQ(score_members[1].member, "b");
+  ASSERT_EQ(score_members[2].member, "z");
+  ASSERT_EQ(score_members[3].member, "c");
+  ASSERT_EQ(score_members[4].member, "d");
+
+  s = db.RPush("MEMORY_ORDER_LIST_KEY", {"c", "d"}, &len);
+  ASSERT_TRUE(s.ok());
+  s = db.LPush("MEMORY_ORDER_LIST_KEY", {"b", "a"}, &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 4);
+  s = db.LRange("MEMORY_ORDER_LIST_KEY", 0, -1, &values);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(values, std::vector<std::string>({"a", "b", "c", "d"}));
+}
+
+// Only the read-write open mode is allowed
+TEST_F(MemoryBackendTest, OpenModeTest) {
+  BlackwidowOptions options;
+  options.storage_backend = kMemoryBackend;
+  options.open_mode = kOpenReadOnly;
+  blackwidow::BlackWidow other_db;
+  s = other_db.Open(options, "./db/memory_backend");
+  ASSERT_TRUE(s.IsInvalidArgument());
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,417 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <atomic>
+#include <iostream>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+class RenameTest : public ::testing::Test {
+ public:
+  RenameTest() {
+    std::string path = "./db/rename";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~RenameTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+static bool HashMatch(blackwidow::BlackWidow* const db,
+                      const Slice& key,
+                      const std::vector<FieldValue>& expect) {
+  std::vector<FieldValue> fvs;
+  Status s = db->HGetall(key, &fvs);
+  if (!s.ok() && !s.IsNotFound()) {
+    return false;
+  }
+  if (fvs.size() != expect.size()) {
+    return false;
+  }
+  for (size_t idx = 0; idx < fvs.size(); ++idx) {
+    if (fvs[idx].field != expect[idx].field
+      || fvs[idx].value != expect[idx].value) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool ListMatch(blackwidow::BlackWidow* const db,
+                      const Slice& key,
+                      const std::vector<std::string>& expect) {
+  std::vector<std::string> values;
+  Status s = db->LRange(key, 0, -1, &values);
+  if (!s.ok() && !s.IsNotFound()) {
+    return false;
+  }
+  return values == expect;
+}
+
+static bool ZSetMatch(blackwidow::BlackWidow* const db,
+                      const Slice& key,
+                      const std::vector<ScoreMember>& expect) {
+  std::vector<ScoreMember> score_members;
+  Status s = db->ZRange(key, 0, -1, &score_members);
+  if (!s.ok() && !s.IsNotFound()) {
+    return false;
+  }
+  if (score_members.size() != expect.size()) {
+    return false;
+  }
+  for (size_t idx = 0; idx < score_members.size(); ++idx) {
+    if (score_members[idx].score != expect[idx].score
+      || score_members[idx].member != expect[idx].member) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Rename of every data type
+TEST_F(RenameTest, RenameTest) {
+  int32_t ret;
+  uint64_t len;
+  std::string value;
+  std::vector<std::string> members;
+
+  s = db.Set("RENAME_STRING_KEY", "VALUE");
+  ASSERT_TRUE(s.ok());
+  s = db.Rename("RENAME_STRING_KEY", "RENAME_STRING_NEWKEY");
+  ASSERT_TRUE(s.ok());
+  s = db.Get("RENAME_STRING_KEY", &value);
+  ASSERT_TRUE(s.IsNotFound());
+  s = db.Get("RENAME_STRING_NEWKEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE");
+
+  s = db.HSet("RENAME_HASH_KEY", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.Rename("RENAME_HASH_KEY", "RENAME_HASH_NEWKEY");
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(HashMatch(&db, "RENAME_HASH_KEY", {}));
+  ASSERT_TRUE(HashMatch(&db, "RENAME_HASH_NEWKEY", {{"FIELD", "VALUE"}}));
+
+  s = db.SAdd("RENAME_SET_KEY", {"a", "b", "c"}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.Rename("RENAME_SET_KEY", "RENAME_SET_NEWKEY");
+  ASSERT_TRUE(s.ok());
+  s = db.SCard("RENAME_SET_KEY", &ret);
+  ASSERT_TRUE(s.IsNotFound());
+  s = db.SMembers("RENAME_SET_NEWKEY", &members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(members.size(), 3);
+
+  s = db.RPush("RENAME_LIST_KEY", {"a", "b", "c"}, &len);
+  ASSERT_TRUE(s.ok());
+  s = db.Rename("RENAME_LIST_KEY", "RENAME_LIST_NEWKEY");
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(ListMatch(&db, "RENAME_LIST_KEY", {}));
+  ASSERT_TRUE(ListMatch(&db, "RENAME_LIST_NEWKEY", {"a", "b", "c"}));
+
+  s = db.ZAdd("RENAME_ZSET_KEY", {{1, "a"}, {2, "b"}}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.Rename("RENAME_ZSET_KEY", "RENAME_ZSET_NEWKEY");
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(ZSetMatch(&db, "RENAME_ZSET_KEY", {}));
+  ASSERT_TRUE(ZSetMatch(&db, "RENAME_ZSET_NEWKEY", {{1, "a"}, {2, "b"}}));
+
+  // The renamed collections are still readable and writable after
+  // the origin data keys went through compaction
+  s = db.Compact(DataType::kAll, true);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(HashMatch(&db, "RENAME_HASH_NEWKEY", {{"FIELD", "VALUE"}}));
+  ASSERT_TRUE(ListMatch(&db, "RENAME_LIST_NEWKEY", {"a", "b", "c"}));
+  ASSERT_TRUE(ZSetMatch(&db, "RENAME_ZSET_NEWKEY", {{1, "a"}, {2, "b"}}));
+  s = db.SIsmember("RENAME_SET_NEWKEY", "b", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+
+  s = db.HSet("RENAME_HASH_NEWKEY", "FIELD2", "VALUE2", &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.LPush("RENAME_LIST_NEWKEY", {"z"}, &len);
+  ASSERT_TRUE(s.ok());
+  double score;
+  s = db.ZIncrby("RENAME_ZSET_NEWKEY", "a", 2, &score);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(score, 3);
+  ASSERT_TRUE(HashMatch(&db, "RENAME_HASH_NEWKEY",
+        {{"FIELD", "VALUE"}, {"FIELD2", "VALUE2"}}));
+  ASSERT_TRUE(ListMatch(&db, "RENAME_LIST_NEWKEY", {"z", "a", "b", "c"}));
+  ASSERT_TRUE(ZSetMatch(&db, "RENAME_ZSET_NEWKEY", {{2, "b"}, {3, "a"}}));
+
+  // Not exist
+  s = db.Rename("RENAME_NOT_EXIST_KEY", "RENAME_NOT_EXIST_NEWKEY");
+  ASSERT_TRUE(s.IsNotFound());
+}
+
+// The old key is created again after rename
+TEST_F(RenameTest, RecreateTest) {
+  int32_t ret;
+  uint64_t len;
+
+  s = db.HSet("RECREATE_HASH_KEY", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.RPush("RECREATE_LIST_KEY", {"a", "b"}, &len);
+  ASSERT_TRUE(s.ok());
+  s = db.Rename("RECREATE_HASH_KEY", "RECREATE_HASH_NEWKEY");
+  ASSERT_TRUE(s.ok());
+  s = db.Rename("RECREATE_LIST_KEY", "RECREATE_LIST_NEWKEY");
+  ASSERT_TRUE(s.ok());
+
+  s = db.HSet("RECREATE_HASH_KEY", "FIELD", "NEW_VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  s = db.RPush("RECREATE_LIST_KEY", {"c"}, &len);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(len, 1);
+
+  s = db.Compact(DataType::kAll, true);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(HashMatch(&db, "RECREATE_HASH_KEY", {{"FIELD", "NEW_VALUE"}}));
+  ASSERT_TRUE(HashMatch(&db, "RECREATE_HASH_NEWKEY", {{"FIELD", "VALUE"}}));
+  ASSERT_TRUE(ListMatch(&db, "RECREATE_LIST_KEY", {"c"}));
+  ASSERT_TRUE(ListMatch(&db, "RECREATE_LIST_NEWKEY", {"a", "b"}));
+}
+
+// Rename over an existing key, a chain of renames and rename back
+TEST_F(RenameTest, OverwriteTest) {
+  int32_t ret;
+
+  s = db.HSet("OVERWRITE_HASH_A", "FIELD_A", "VALUE_A", &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.HSet("OVERWRITE_HASH_B", "FIELD_B", "VALUE_B", &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.Rename("OVERWRITE_HASH_A", "OVERWRITE_HASH_B");
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(HashMatch(&db, "OVERWRITE_HASH_B", {{"FIELD_A", "VALUE_A"}}));
+
+  s = db.Rename("OVERWRITE_HASH_B", "OVERWRITE_HASH_C");
+  ASSERT_TRUE(s.ok());
+  s = db.Rename("OVERWRITE_HASH_C", "OVERWRITE_HASH_A");
+  ASSERT_TRUE(s.ok());
+  s = db.Compact(DataType::kAll, true);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(HashMatch(&db, "OVERWRITE_HASH_A", {{"FIELD_A", "VALUE_A"}}));
+  ASSERT_TRUE(HashMatch(&db, "OVERWRITE_HASH_B", {}));
+  ASSERT_TRUE(HashMatch(&db, "OVERWRITE_HASH_C", {}));
+
+  // A new version of the renamed key does not read the origin
+  s = db.HDel("OVERWRITE_HASH_A", {"FIELD_A"}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.HSet("OVERWRITE_HASH_A", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(HashMatch(&db, "OVERWRITE_HASH_A", {{"FIELD", "VALUE"}}));
+
+  // The timeout is kept
+  s = db.HSet("OVERWRITE_TTL_KEY", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  std::map<DataType, Status> type_status;
+  ret = db.Expire("OVERWRITE_TTL_KEY", 100, &type_status);
+  ASSERT_EQ(ret, 1);
+  s = db.Rename("OVERWRITE_TTL_KEY", "OVERWRITE_TTL_NEWKEY");
+  ASSERT_TRUE(s.ok());
+  std::map<DataType, int64_t> ttl = db.TTL("OVERWRITE_TTL_NEWKEY",
+                                           &type_status);
+  ASSERT_GT(ttl[DataType::kHashes], 0);
+  ASSERT_LE(ttl[DataType::kHashes], 100);
+}
+
+// RenameNx
+TEST_F(RenameTest, RenameNxTest) {
+  int32_t ret;
+
+  s = db.Set("RENAMENX_KEY", "VALUE");
+  ASSERT_TRUE(s.ok());
+  s = db.SAdd("RENAMENX_EXIST_KEY", {"a"}, &ret);
+  ASSERT_TRUE(s.ok());
+
+  s = db.RenameNx("RENAMENX_KEY", "RENAMENX_EXIST_KEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 0);
+  s = db.RenameNx("RENAMENX_KEY", "RENAMENX_NEWKEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  s = db.RenameNx("RENAMENX_KEY", "RENAMENX_OTHER_KEY", &ret);
+  ASSERT_TRUE(s.IsNotFound());
+}
+
+// newkey of another data type is overwritten
+TEST_F(RenameTest, CrossTypeTest) {
+  int32_t ret;
+  uint64_t len;
+  std::string type;
+  std::string value;
+  std::map<DataType, Status> type_status;
+
+  s = db.Set("CROSS_TYPE_KEY", "VALUE");
+  ASSERT_TRUE(s.ok());
+  s = db.HSet("CROSS_TYPE_NEWKEY", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.RPush("CROSS_TYPE_NEWKEY", {"a"}, &len);
+  ASSERT_TRUE(s.ok());
+
+  s = db.Rename("CROSS_TYPE_KEY", "CROSS_TYPE_NEWKEY");
+  ASSERT_TRUE(s.ok());
+  s = db.Get("CROSS_TYPE_NEWKEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE");
+  ASSERT_TRUE(HashMatch(&db, "CROSS_TYPE_NEWKEY", {}));
+  ASSERT_TRUE(ListMatch(&db, "CROSS_TYPE_NEWKEY", {}));
+  s = db.Type("CROSS_TYPE_NEWKEY", &type);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(type, "string");
+  ASSERT_EQ(db.Exists({"CROSS_TYPE_NEWKEY"}, &type_status), 1);
+
+  // RenameNx leaves newkey of another data type alone
+  s = db.ZAdd("CROSS_TYPE_NX_KEY", {{1, "a"}}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.RenameNx("CROSS_TYPE_NX_KEY", "CROSS_TYPE_NEWKEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 0);
+  ASSERT_TRUE(ZSetMatch(&db, "CROSS_TYPE_NX_KEY", {{1, "a"}}));
+  s = db.Get("CROSS_TYPE_NEWKEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE");
+
+  // Copy with replace overwrites it as well
+  s = db.Copy("CROSS_TYPE_NX_KEY", "CROSS_TYPE_NEWKEY", true, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  ASSERT_TRUE(ZSetMatch(&db, "CROSS_TYPE_NEWKEY", {{1, "a"}}));
+  s = db.Get("CROSS_TYPE_NEWKEY", &value);
+  ASSERT_TRUE(s.IsNotFound());
+  s = db.Type("CROSS_TYPE_NEWKEY", &type);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(type, "zset");
+}
+
+// Copy
+TEST_F(RenameTest, CopyTest) {
+  int32_t ret;
+  uint64_t len;
+  std::string value;
+
+  s = db.Set("COPY_STRING_KEY", "VALUE");
+  ASSERT_TRUE(s.ok());
+  s = db.Copy("COPY_STRING_KEY", "COPY_STRING_NEWKEY", false, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  s = db.Get("COPY_STRING_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE");
+  s = db.Get("COPY_STRING_NEWKEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE");
+
+  s = db.ZAdd("COPY_ZSET_KEY", {{1, "a"}, {2, "b"}}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.ZAdd("COPY_ZSET_NEWKEY", {{5, "c"}}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.Copy("COPY_ZSET_KEY", "COPY_ZSET_NEWKEY", false, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 0);
+  s = db.Copy("COPY_ZSET_KEY", "COPY_ZSET_NEWKEY", true, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  ASSERT_TRUE(ZSetMatch(&db, "COPY_ZSET_NEWKEY", {{1, "a"}, {2, "b"}}));
+
+  // The copy is independent of the source
+  int32_t removed;
+  s = db.ZRem("COPY_ZSET_KEY", {"a"}, &removed);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(ZSetMatch(&db, "COPY_ZSET_KEY", {{2, "b"}}));
+  ASSERT_TRUE(ZSetMatch(&db, "COPY_ZSET_NEWKEY", {{1, "a"}, {2, "b"}}));
+
+  // Copy of a renamed collection
+  s = db.RPush("COPY_LIST_KEY", {"a", "b"}, &len);
+  ASSERT_TRUE(s.ok());
+  s = db.Rename("COPY_LIST_KEY", "COPY_LIST_RENAMED");
+  ASSERT_TRUE(s.ok());
+  s = db.Copy("COPY_LIST_RENAMED", "COPY_LIST_NEWKEY", false, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  s = db.RPush("COPY_LIST_NEWKEY", {"c"}, &len);
+  ASSERT_TRUE(s.ok());
+  s = db.Compact(DataType::kAll, true);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(ListMatch(&db, "COPY_LIST_RENAMED", {"a", "b"}));
+  ASSERT_TRUE(ListMatch(&db, "COPY_LIST_NEWKEY", {"a", "b", "c"}));
+
+  // Not exist, and the same key
+  s = db.Copy("COPY_NOT_EXIST_KEY", "COPY_NOT_EXIST_NEWKEY", false, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 0);
+  s = db.Copy("COPY_STRING_KEY", "COPY_STRING_KEY", true, &ret);
+  ASSERT_TRUE(s.IsInvalidArgument());
+}
+
+// Copy of a collection larger than one write batch
+TEST_F(RenameTest, CopyLargeTest) {
+  int32_t ret;
+  std::string value;
+  std::vector<FieldValue> fvs;
+  std::string field_value(1024, 'v');
+  for (int i = 0; i < 6000; i++) {
+    fvs.push_back({"FIELD_" + std::to_string(i), field_value});
+  }
+  s = db.HMSet("COPY_LARGE_HASH_KEY", fvs);
+  ASSERT_TRUE(s.ok());
+
+  s = db.Copy("COPY_LARGE_HASH_KEY", "COPY_LARGE_HASH_NEWKEY", false, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  s = db.HLen("COPY_LARGE_HASH_NEWKEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 6000);
+  s = db.HGet("COPY_LARGE_HASH_NEWKEY", "FIELD_5999", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, field_value);
+}
+
+// Concurrent RenameNx to the same newkey, only one of them renames
+TEST_F(RenameTest, RenameNxRaceTest) {
+  for (int round = 0; round < 50; round++) {
+    std::string newkey = "RENAMENX_RACE_NEWKEY_" + std::to_string(round);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 4; i++) {
+      keys.push_back("RENAMENX_RACE_KEY_" + std::to_string(round)
+          + "_" + std::to_string(i));
+      s = db.Set(keys.back(), std::to_string(i));
+      ASSERT_TRUE(s.ok());
+    }
+    std::atomic<int32_t> renamed(0);
+    std::vector<std::thread> threads;
+    for (const auto& key : keys) {
+      threads.push_back(std::thread([this, key, newkey, &renamed]() {
+        int32_t ret = 0;
+        db.RenameNx(key, newkey, &ret);
+        renamed += ret;
+      }));
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    ASSERT_EQ(renamed.load(), 1);
+  }
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
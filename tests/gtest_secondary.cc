@@ -0,0 +1,93 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <iostream>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+class SecondaryTest : public ::testing::Test {
+ public:
+  SecondaryTest() {
+    std::string path = "./db/secondary";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~SecondaryTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+// Secondary instance follows the primary by TryCatchUpWithPrimary
+TEST_F(SecondaryTest, CatchUpTest) {
+  int32_t ret;
+  std::string value;
+  s = db.Set("SECONDARY_KEY", "VALUE_1");
+  ASSERT_TRUE(s.ok());
+  s = db.HSet("SECONDARY_HASH_KEY", "FIELD", "VALUE_1", &ret);
+  ASSERT_TRUE(s.ok());
+
+  BlackwidowOptions secondary_options;
+  secondary_options.open_mode = kOpenSecondary;
+  secondary_options.secondary_path = "./db/secondary_instance";
+  secondary_options.catch_up_interval_ms = 0;
+  blackwidow::BlackWidow secondary_db;
+  s = secondary_db.Open(secondary_options, "./db/secondary");
+  ASSERT_TRUE(s.ok());
+
+  s = secondary_db.Get("SECONDARY_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE_1");
+
+  s = db.Set("SECONDARY_KEY", "VALUE_2");
+  ASSERT_TRUE(s.ok());
+  s = db.HSet("SECONDARY_HASH_KEY", "FIELD", "VALUE_2", &ret);
+  ASSERT_TRUE(s.ok());
+
+  s = secondary_db.TryCatchUpWithPrimary();
+  ASSERT_TRUE(s.ok());
+  s = secondary_db.Get("SECONDARY_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE_2");
+  s = secondary_db.HGet("SECONDARY_HASH_KEY", "FIELD", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE_2");
+}
+
+// Write commands are rejected by the secondary instance
+TEST_F(SecondaryTest, WriteRejectTest) {
+  int32_t ret;
+  BlackwidowOptions secondary_options;
+  secondary_options.open_mode = kOpenSecondary;
+  secondary_options.secondary_path = "./db/secondary_instance";
+  blackwidow::BlackWidow secondary_db;
+  s = secondary_db.Open(secondary_options, "./db/secondary");
+  ASSERT_TRUE(s.ok());
+
+  s = secondary_db.Set("SECONDARY_WRITE_KEY", "VALUE");
+  ASSERT_TRUE(s.IsNotSupported());
+  s = secondary_db.SAdd("SECONDARY_WRITE_KEY", {"MEMBER"}, &ret);
+  ASSERT_TRUE(s.IsNotSupported());
+  s = secondary_db.Compact(DataType::kAll, true);
+  ASSERT_TRUE(s.IsNotSupported());
+  s = db.TryCatchUpWithPrimary();
+  ASSERT_TRUE(s.IsNotSupported());
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
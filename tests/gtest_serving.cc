@@ -0,0 +1,163 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <atomic>
+#include <iostream>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+// Build a dataset offline the way a bulk loading job does
+static Status BuildDataset(const std::string& path, const std::string& value) {
+  BlackwidowOptions bw_options;
+  bw_options.options.create_if_missing = true;
+  blackwidow::BlackWidow builder;
+  Status s = builder.Open(bw_options, path);
+  if (!s.ok()) {
+    return s;
+  }
+  int32_t ret;
+  s = builder.Set("SERVING_STRING_KEY", value);
+  if (s.ok()) {
+    s = builder.HSet("SERVING_HASH_KEY", "field", value, &ret);
+  }
+  if (s.ok()) {
+    s = builder.ZAdd("SERVING_ZSET_KEY", {{1, value}}, &ret);
+  }
+  if (s.ok()) {
+    s = builder.Compact(DataType::kAll, true);
+  }
+  return s;
+}
+
+class ServingTest : public ::testing::Test {
+ public:
+  ServingTest() {
+    s = BuildDataset("./db/serving/v1", "v1");
+    if (s.ok()) {
+      bw_options.open_mode = kOpenServing;
+      s = db.Open(bw_options, "./db/serving/v1");
+    }
+  }
+  virtual ~ServingTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+TEST_F(ServingTest, ReadTest) {
+  ASSERT_TRUE(s.ok());
+  std::string value;
+  s = db.Get("SERVING_STRING_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "v1");
+  s = db.HGet("SERVING_HASH_KEY", "field", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "v1");
+  double score;
+  s = db.ZScore("SERVING_ZSET_KEY", "v1", &score);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(score, 1);
+
+  // The dataset is immutable
+  s = db.Set("SERVING_STRING_KEY", "v2");
+  ASSERT_TRUE(s.IsNotSupported());
+}
+
+TEST_F(ServingTest, SwapTest) {
+  ASSERT_TRUE(s.ok());
+  s = BuildDataset("./db/serving/v2", "v2");
+  ASSERT_TRUE(s.ok());
+  s = db.SwapDataset("./db/serving/v2");
+  ASSERT_TRUE(s.ok());
+
+  std::string value;
+  s = db.Get("SERVING_STRING_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "v2");
+  s = db.HGet("SERVING_HASH_KEY", "field", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "v2");
+
+  // A broken dataset keeps the current one
+  s = db.SwapDataset("./db/serving/not_exist");
+  ASSERT_FALSE(s.ok());
+  s = db.Get("SERVING_STRING_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "v2");
+}
+
+// The commands reading a dataset while it is swapped out keep reading it
+TEST_F(ServingTest, ConcurrentSwapTest) {
+  ASSERT_TRUE(s.ok());
+  s = BuildDataset("./db/serving/v2", "v2");
+  ASSERT_TRUE(s.ok());
+
+  std::atomic<bool> stop(false);
+  std::atomic<int32_t> errors(0);
+  std::vector<std::thread> readers;
+  for (int32_t idx = 0; idx < 4; ++idx) {
+    readers.emplace_back([&]() {
+      std::string value;
+      std::vector<std::string> keys;
+      std::map<DataType, Status> type_status;
+      while (!stop) {
+        Status st = db.Get("SERVING_STRING_KEY", &value);
+        if (!st.ok() || (value != "v1" && value != "v2")) {
+          errors++;
+        }
+        st = db.HGet("SERVING_HASH_KEY", "field", &value);
+        if (!st.ok() || (value != "v1" && value != "v2")) {
+          errors++;
+        }
+        if (db.Exists({"SERVING_ZSET_KEY"}, &type_status) != 1) {
+          errors++;
+        }
+        keys.clear();
+        db.Scan(DataType::kAll, 0, "*", 10, &keys);
+        if (keys.size() != 3) {
+          errors++;
+        }
+      }
+    });
+  }
+  for (int32_t round = 0; round < 20; ++round) {
+    s = db.SwapDataset(round % 2 ? "./db/serving/v1" : "./db/serving/v2");
+    ASSERT_TRUE(s.ok());
+  }
+  stop = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  ASSERT_EQ(errors, 0);
+
+  std::string value;
+  s = db.Get("SERVING_STRING_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "v1");
+}
+
+// Only available in serving mode
+TEST_F(ServingTest, DisabledTest) {
+  blackwidow::BlackWidow rw_db;
+  BlackwidowOptions rw_options;
+  rw_options.options.create_if_missing = true;
+  s = rw_db.Open(rw_options, "./db/serving_rw");
+  ASSERT_TRUE(s.ok());
+  s = rw_db.SwapDataset("./db/serving/v1");
+  ASSERT_TRUE(s.IsNotSupported());
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,317 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <iostream>
+#include <algorithm>
+
+#include "blackwidow/blackwidow.h"
+#include "blackwidow/util.h"
+
+using namespace blackwidow;
+
+class SlotTest : public ::testing::Test {
+ public:
+  SlotTest() {
+    std::string path = "./db/slot";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    bw_options.slot_tagged_keys = true;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~SlotTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+static uint32_t Slot(const std::string& key) {
+  return KeyHashSlot(key.data(), key.size());
+}
+
+// The commands see the plain keys
+TEST_F(SlotTest, CommandsTest) {
+  int32_t ret;
+  std::string value;
+  std::vector<std::string> keys;
+  std::map<DataType, Status> type_status;
+
+  ASSERT_EQ(Slot("123456789"), 0x31c3 & (kClusterSlots - 1));
+  ASSERT_EQ(Slot("{user1000}.following"), Slot("user1000"));
+  ASSERT_NE(Slot("{}user1000"), Slot("user1000"));
+
+  s = db.Set("COMMANDS_STRING_KEY", "VALUE");
+  ASSERT_TRUE(s.ok());
+  s = db.Get("COMMANDS_STRING_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE");
+  s = db.HSet("COMMANDS_HASH_KEY", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.SAdd("COMMANDS_SET_KEY", {"MEMBER"}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.MSet({{"COMMANDS_MSET_KEY1", "V1"}, {"COMMANDS_MSET_KEY2", "V2"}});
+  ASSERT_TRUE(s.ok());
+
+  std::vector<ValueStatus> vss;
+  s = db.MGet({"COMMANDS_MSET_KEY1", "COMMANDS_MSET_KEY2"}, &vss);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(vss.size(), 2);
+  ASSERT_EQ(vss[0].value, "V1");
+  ASSERT_EQ(vss[1].value, "V2");
+
+  s = db.Keys(DataType::kAll, "COMMANDS_*", &keys);
+  ASSERT_TRUE(s.ok());
+  std::sort(keys.begin(), keys.end());
+  ASSERT_EQ(keys, std::vector<std::string>({"COMMANDS_HASH_KEY",
+        "COMMANDS_MSET_KEY1", "COMMANDS_MSET_KEY2",
+        "COMMANDS_SET_KEY", "COMMANDS_STRING_KEY"}));
+
+  std::vector<std::string> scan_keys;
+  int64_t cursor = 0;
+  do {
+    cursor = db.Scan(DataType::kAll, cursor, "COMMANDS_*", 2, &keys);
+    scan_keys.insert(scan_keys.end(), keys.begin(), keys.end());
+  } while (cursor != 0);
+  std::sort(scan_keys.begin(), scan_keys.end());
+  ASSERT_EQ(scan_keys, std::vector<std::string>({"COMMANDS_HASH_KEY",
+        "COMMANDS_MSET_KEY1", "COMMANDS_MSET_KEY2",
+        "COMMANDS_SET_KEY", "COMMANDS_STRING_KEY"}));
+
+  // Scanx continues from the plain next_key
+  std::string next_key;
+  scan_keys.clear();
+  s = db.Scanx(DataType::kStrings, "", "COMMANDS_*", 1, &keys, &next_key);
+  ASSERT_TRUE(s.ok());
+  scan_keys.insert(scan_keys.end(), keys.begin(), keys.end());
+  while (!next_key.empty()) {
+    s = db.Scanx(DataType::kStrings, next_key, "COMMANDS_*", 1,
+                 &keys, &next_key);
+    ASSERT_TRUE(s.ok());
+    scan_keys.insert(scan_keys.end(), keys.begin(), keys.end());
+  }
+  std::sort(scan_keys.begin(), scan_keys.end());
+  ASSERT_EQ(scan_keys, std::vector<std::string>({"COMMANDS_MSET_KEY1",
+        "COMMANDS_MSET_KEY2", "COMMANDS_STRING_KEY"}));
+
+  ASSERT_EQ(db.Exists({"COMMANDS_STRING_KEY", "COMMANDS_HASH_KEY"},
+                      &type_status), 2);
+  ASSERT_EQ(db.Del({"COMMANDS_SET_KEY"}, &type_status), 1);
+  ASSERT_EQ(db.Exists({"COMMANDS_SET_KEY"}, &type_status), 0);
+
+  std::vector<KeyValue> kvs;
+  s = db.PKScanRange(DataType::kStrings, "", "", "*", 10,
+                     &keys, &kvs, &next_key);
+  ASSERT_TRUE(s.IsNotSupported());
+}
+
+// Slot scan, count and delete
+TEST_F(SlotTest, SlotCommandsTest) {
+  int32_t ret;
+  uint64_t len;
+  std::string value;
+  std::vector<std::string> keys;
+  uint32_t slot = Slot("slot_tag");
+
+  s = db.Set("{slot_tag}STRING_KEY", "VALUE");
+  ASSERT_TRUE(s.ok());
+  s = db.Setex("{slot_tag}STRING_TTL_KEY", "VALUE", 100);
+  ASSERT_TRUE(s.ok());
+  s = db.HSet("{slot_tag}HASH_KEY", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.RPush("{slot_tag}LIST_KEY", {"a", "b"}, &len);
+  ASSERT_TRUE(s.ok());
+  s = db.ZAdd("{slot_tag}ZSET_KEY", {{1, "a"}}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.SAdd("{slot_tag}SET_KEY", {"a"}, &ret);
+  ASSERT_TRUE(s.ok());
+  for (int32_t idx = 0; idx < 10; ++idx) {
+    s = db.HSet("{slot_tag}HASH_KEY_" + std::to_string(idx),
+                "FIELD", "VALUE", &ret);
+    ASSERT_TRUE(s.ok());
+  }
+  // Expired keys are not counted
+  s = db.HSet("{slot_tag}EXPIRED_KEY", "FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  std::map<DataType, Status> type_status;
+  ASSERT_EQ(db.Expire("{slot_tag}EXPIRED_KEY", 1, &type_status), 1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+
+  // A key of another slot
+  ASSERT_NE(Slot("OTHER_SLOT_KEY"), slot);
+  s = db.Set("OTHER_SLOT_KEY", "VALUE");
+  ASSERT_TRUE(s.ok());
+
+  int64_t count;
+  s = db.SlotKeyCount(slot, &count);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(count, 16);
+
+  s = db.SlotScan(DataType::kStrings, slot, "", 10, &keys, &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(keys, std::vector<std::string>({"{slot_tag}STRING_KEY",
+        "{slot_tag}STRING_TTL_KEY"}));
+  ASSERT_TRUE(value.empty());
+
+  std::string next_key;
+  std::vector<std::string> scan_keys;
+  s = db.SlotScan(DataType::kHashes, slot, "", 4, &keys, &next_key);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(keys.size(), 4);
+  scan_keys.insert(scan_keys.end(), keys.begin(), keys.end());
+  while (!next_key.empty()) {
+    s = db.SlotScan(DataType::kHashes, slot, next_key, 4, &keys, &next_key);
+    ASSERT_TRUE(s.ok());
+    scan_keys.insert(scan_keys.end(), keys.begin(), keys.end());
+  }
+  ASSERT_EQ(scan_keys.size(), 11);
+  ASSERT_EQ(scan_keys[0], "{slot_tag}HASH_KEY");
+  ASSERT_EQ(std::count(scan_keys.begin(), scan_keys.end(),
+                       "{slot_tag}EXPIRED_KEY"), 0);
+
+  s = db.DelSlot(slot);
+  ASSERT_TRUE(s.ok());
+  s = db.SlotKeyCount(slot, &count);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(count, 0);
+  s = db.Get("{slot_tag}STRING_KEY", &value);
+  ASSERT_TRUE(s.IsNotFound());
+  s = db.HGet("{slot_tag}HASH_KEY", "FIELD", &value);
+  ASSERT_TRUE(s.IsNotFound());
+  s = db.LLen("{slot_tag}LIST_KEY", &len);
+  ASSERT_TRUE(s.IsNotFound());
+  s = db.Get("OTHER_SLOT_KEY", &value);
+  ASSERT_TRUE(s.ok());
+
+  // The slot can be written again
+  s = db.HSet("{slot_tag}HASH_KEY", "NEW_FIELD", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  s = db.HLen("{slot_tag}HASH_KEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+
+  s = db.SlotKeyCount(kClusterSlots, &count);
+  ASSERT_TRUE(s.IsInvalidArgument());
+}
+
+// The collections recreated right after DelSlot do not see the elements
+// of the deleted ones, even when they were recreated within the second
+TEST_F(SlotTest, RecreateTest) {
+  int32_t ret;
+  uint64_t len;
+  std::vector<std::string> members;
+  std::vector<FieldValue> fvs;
+  std::vector<ScoreMember> score_members;
+  std::map<DataType, Status> type_status;
+  uint32_t slot = Slot("recreate_tag");
+
+  // Delete and write the keys a few times, their versions run ahead of
+  // the current time
+  for (int32_t round = 0; round < 5; ++round) {
+    s = db.HMSet("{recreate_tag}HASH_KEY",
+                 {{"FIELD_1", "VALUE"}, {"FIELD_2", "VALUE"}});
+    ASSERT_TRUE(s.ok());
+    s = db.SAdd("{recreate_tag}SET_KEY", {"MEMBER_1", "MEMBER_2"}, &ret);
+    ASSERT_TRUE(s.ok());
+    s = db.ZAdd("{recreate_tag}ZSET_KEY",
+                {{1, "MEMBER_1"}, {2, "MEMBER_2"}}, &ret);
+    ASSERT_TRUE(s.ok());
+    s = db.RPush("{recreate_tag}LIST_KEY", {"NODE_1", "NODE_2"}, &len);
+    ASSERT_TRUE(s.ok());
+    if (round != 4) {
+      ASSERT_EQ(db.Del({"{recreate_tag}HASH_KEY", "{recreate_tag}SET_KEY",
+                        "{recreate_tag}ZSET_KEY", "{recreate_tag}LIST_KEY"},
+                       &type_status), 4);
+    }
+  }
+
+  s = db.DelSlot(slot);
+  ASSERT_TRUE(s.ok());
+
+  s = db.HSet("{recreate_tag}HASH_KEY", "FIELD_3", "VALUE", &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.HGetall("{recreate_tag}HASH_KEY", &fvs);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(fvs.size(), 1);
+  ASSERT_EQ(fvs[0].field, "FIELD_3");
+
+  s = db.SAdd("{recreate_tag}SET_KEY", {"MEMBER_3"}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.SMembers("{recreate_tag}SET_KEY", &members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(members, std::vector<std::string>({"MEMBER_3"}));
+
+  s = db.ZAdd("{recreate_tag}ZSET_KEY", {{3, "MEMBER_3"}}, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.ZRange("{recreate_tag}ZSET_KEY", 0, -1, &score_members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(score_members.size(), 1);
+  ASSERT_EQ(score_members[0].member, "MEMBER_3");
+
+  s = db.RPush("{recreate_tag}LIST_KEY", {"NODE_3"}, &len);
+  ASSERT_TRUE(s.ok());
+  s = db.LRange("{recreate_tag}LIST_KEY", 0, -1, &members);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(members, std::vector<std::string>({"NODE_3"}));
+}
+
+// DelSlot drops the buffered counters of the slot keys
+TEST_F(SlotTest, CounterTest) {
+  BlackwidowOptions options;
+  options.options.create_if_missing = true;
+  options.slot_tagged_keys = true;
+  options.counter_flush_interval_ms = 600000;
+  blackwidow::BlackWidow counter_db;
+  s = counter_db.Open(options, "./db/slot_counter");
+  ASSERT_TRUE(s.ok());
+
+  int64_t ret;
+  std::string value;
+  s = counter_db.BufferCounter(kStrings, "{counter_tag}PV_KEY");
+  ASSERT_TRUE(s.ok());
+  s = counter_db.Incrby("{counter_tag}PV_KEY", 7, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 7);
+
+  s = counter_db.DelSlot(Slot("counter_tag"));
+  ASSERT_TRUE(s.ok());
+  s = counter_db.Incrby("{counter_tag}PV_KEY", 2, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 2);
+  s = counter_db.Get("{counter_tag}PV_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "2");
+}
+
+// The slot commands need the slot tagged layout
+TEST_F(SlotTest, DisabledTest) {
+  BlackwidowOptions options;
+  options.options.create_if_missing = true;
+  blackwidow::BlackWidow plain_db;
+  s = plain_db.Open(options, "./db/slot_plain");
+  ASSERT_TRUE(s.ok());
+
+  int64_t count;
+  std::string next_key;
+  std::vector<std::string> keys;
+  s = plain_db.SlotKeyCount(0, &count);
+  ASSERT_TRUE(s.IsNotSupported());
+  s = plain_db.SlotScan(DataType::kStrings, 0, "", 10, &keys, &next_key);
+  ASSERT_TRUE(s.IsNotSupported());
+  s = plain_db.DelSlot(0);
+  ASSERT_TRUE(s.IsNotSupported());
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,350 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <iostream>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+static bool ids_match(const std::vector<StreamEntry>& entries,
+                      const std::vector<std::string>& expect_ids) {
+  if (entries.size() != expect_ids.size()) {
+    return false;
+  }
+  for (size_t idx = 0; idx < entries.size(); ++idx) {
+    if (entries[idx].id.ToString() != expect_ids[idx]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool len_match(blackwidow::BlackWidow *const db,
+                      const Slice& key,
+                      uint64_t expect_len) {
+  uint64_t len = 0;
+  Status s = db->XLen(key, &len);
+  if (!s.ok() && !s.IsNotFound()) {
+    return false;
+  }
+  if (s.IsNotFound() && !expect_len) {
+    return true;
+  }
+  return len == expect_len;
+}
+
+class StreamsTest : public ::testing::Test {
+ public:
+  StreamsTest() {
+    std::string path = "./db/streams";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    s = db.Open(bw_options, path);
+    if (!s.ok()) {
+      printf("Open db failed, exit...\n");
+      exit(1);
+    }
+  }
+  virtual ~StreamsTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+// XAdd
+TEST_F(StreamsTest, XAddTest) {
+  StreamID id;
+  std::vector<FieldValue> fvs {{"name", "blackwidow"}, {"type", "stream"}};
+
+  // ***************** Group 1 Test *****************
+  // Explicit ids must keep increasing
+  s = db.XAdd("GP1_XADD_KEY", "5-1", fvs, &id);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(id, StreamID(5, 1));
+  s = db.XAdd("GP1_XADD_KEY", "5-1", fvs, &id);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.XAdd("GP1_XADD_KEY", "4-9", fvs, &id);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.XAdd("GP1_XADD_KEY", "5-*", fvs, &id);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(id, StreamID(5, 2));
+  s = db.XAdd("GP1_XADD_KEY", "6", fvs, &id);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(id, StreamID(6, 0));
+  ASSERT_TRUE(len_match(&db, "GP1_XADD_KEY", 3));
+
+  // ***************** Group 2 Test *****************
+  // Generated ids
+  s = db.XAdd("GP2_XADD_KEY", "*", fvs, &id);
+  ASSERT_TRUE(s.ok());
+  ASSERT_GT(id.ms, 0);
+  StreamID last_id = id;
+  s = db.XAdd("GP2_XADD_KEY", "*", fvs, &id);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(last_id < id);
+  s = db.XAdd("GP2_XADD_KEY", "0-*", fvs, &id);
+  ASSERT_TRUE(s.IsInvalidArgument());
+
+  // ***************** Group 3 Test *****************
+  // Invalid arguments
+  s = db.XAdd("GP3_XADD_KEY", "0-0", fvs, &id);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.XAdd("GP3_XADD_KEY", "1-x", fvs, &id);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.XAdd("GP3_XADD_KEY", "1", {}, &id);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.XAdd("GP3_XADD_KEY", "0-*", fvs, &id);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(id, StreamID(0, 1));
+
+  // ***************** Group 4 Test *****************
+  // The fields of an entry are kept in order
+  std::vector<StreamEntry> entries;
+  s = db.XRange("GP1_XADD_KEY", "5-2", "5-2", 0, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(entries.size(), 1);
+  ASSERT_EQ(entries[0].fvs, fvs);
+}
+
+// XRange
+TEST_F(StreamsTest, XRangeTest) {
+  StreamID id;
+  std::vector<StreamEntry> entries;
+  std::vector<FieldValue> fvs {{"f", "v"}};
+  for (const auto& entry_id : {"1-1", "1-2", "2-0", "3-5", "4-0"}) {
+    s = db.XAdd("GP1_XRANGE_KEY", entry_id, fvs, &id);
+    ASSERT_TRUE(s.ok());
+  }
+
+  s = db.XRange("GP1_XRANGE_KEY", "-", "+", 0, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(ids_match(entries, {"1-1", "1-2", "2-0", "3-5", "4-0"}));
+
+  // A millisecond covers all its sequence numbers
+  s = db.XRange("GP1_XRANGE_KEY", "1", "3", 0, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(ids_match(entries, {"1-1", "1-2", "2-0", "3-5"}));
+
+  // Exclusive bounds
+  s = db.XRange("GP1_XRANGE_KEY", "(1-2", "(4-0", 0, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(ids_match(entries, {"2-0", "3-5"}));
+
+  s = db.XRange("GP1_XRANGE_KEY", "-", "+", 2, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(ids_match(entries, {"1-1", "1-2"}));
+
+  s = db.XRange("GP1_XRANGE_KEY", "5", "+", 0, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(entries.empty());
+
+  s = db.XRange("GP1_XRANGE_KEY", "3", "2", 0, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(entries.empty());
+
+  s = db.XRange("GP1_XRANGE_KEY", "x", "+", 0, &entries);
+  ASSERT_TRUE(s.IsInvalidArgument());
+
+  s = db.XRange("GP2_XRANGE_KEY", "-", "+", 0, &entries);
+  ASSERT_TRUE(s.IsNotFound());
+}
+
+// XRevrange
+TEST_F(StreamsTest, XRevrangeTest) {
+  StreamID id;
+  std::vector<StreamEntry> entries;
+  std::vector<FieldValue> fvs {{"f", "v"}};
+  for (const auto& entry_id : {"1-1", "1-2", "2-0", "3-5", "4-0"}) {
+    s = db.XAdd("GP1_XREVRANGE_KEY", entry_id, fvs, &id);
+    ASSERT_TRUE(s.ok());
+  }
+
+  s = db.XRevrange("GP1_XREVRANGE_KEY", "+", "-", 0, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(ids_match(entries, {"4-0", "3-5", "2-0", "1-2", "1-1"}));
+
+  s = db.XRevrange("GP1_XREVRANGE_KEY", "3", "(1-1", 0, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(ids_match(entries, {"3-5", "2-0", "1-2"}));
+
+  s = db.XRevrange("GP1_XREVRANGE_KEY", "+", "-", 1, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(ids_match(entries, {"4-0"}));
+
+  // The entries of another key are never reached
+  s = db.XAdd("GP1_XREVRANGE_KEZ", "9-9", fvs, &id);
+  ASSERT_TRUE(s.ok());
+  s = db.XRevrange("GP1_XREVRANGE_KEY", "+", "-", 0, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(entries.size(), 5);
+}
+
+// XDel
+TEST_F(StreamsTest, XDelTest) {
+  int32_t ret;
+  StreamID id;
+  std::vector<StreamEntry> entries;
+  std::vector<FieldValue> fvs {{"f", "v"}};
+  for (const auto& entry_id : {"1-1", "1-2", "2-0"}) {
+    s = db.XAdd("GP1_XDEL_KEY", entry_id, fvs, &id);
+    ASSERT_TRUE(s.ok());
+  }
+
+  s = db.XDel("GP1_XDEL_KEY", {"1-2", "1-2", "9-9"}, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  ASSERT_TRUE(len_match(&db, "GP1_XDEL_KEY", 2));
+  s = db.XRange("GP1_XDEL_KEY", "-", "+", 0, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(ids_match(entries, {"1-1", "2-0"}));
+
+  // The deleted greatest id is still the last id
+  s = db.XDel("GP1_XDEL_KEY", {"2-0"}, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  s = db.XAdd("GP1_XDEL_KEY", "2-0", fvs, &id);
+  ASSERT_TRUE(s.IsInvalidArgument());
+
+  // So is the last id of the emptied stream
+  s = db.XDel("GP1_XDEL_KEY", {"1-1"}, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  ASSERT_TRUE(len_match(&db, "GP1_XDEL_KEY", 0));
+  s = db.XAdd("GP1_XDEL_KEY", "1-5", fvs, &id);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.XAdd("GP1_XDEL_KEY", "*", fvs, &id);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(StreamID(2, 0) < id);
+  s = db.XRange("GP1_XDEL_KEY", "-", "+", 0, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(entries.size(), 1);
+
+  // The generated ids follow the last id of the emptied stream even when
+  // it is ahead of the clock
+  s = db.XAdd("GP3_XDEL_KEY", "99999999999999-5", fvs, &id);
+  ASSERT_TRUE(s.ok());
+  s = db.XDel("GP3_XDEL_KEY", {"99999999999999-5"}, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 1);
+  s = db.XAdd("GP3_XDEL_KEY", "*", fvs, &id);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(id, StreamID(99999999999999, 6));
+
+  s = db.XDel("GP1_XDEL_KEY", {"bad"}, &ret);
+  ASSERT_TRUE(s.IsInvalidArgument());
+
+  s = db.XDel("GP2_XDEL_KEY", {"1-1"}, &ret);
+  ASSERT_TRUE(s.IsNotFound());
+}
+
+// XTrim
+TEST_F(StreamsTest, XTrimTest) {
+  int64_t ret;
+  StreamID id;
+  std::vector<StreamEntry> entries;
+  std::vector<FieldValue> fvs {{"f", "v"}};
+
+  // ***************** Group 1 Test *****************
+  for (uint64_t ms = 1; ms <= 5; ++ms) {
+    s = db.XAdd("GP1_XTRIM_KEY", std::to_string(ms), fvs, &id);
+    ASSERT_TRUE(s.ok());
+  }
+  s = db.XTrim("GP1_XTRIM_KEY", 3, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 2);
+  s = db.XRange("GP1_XTRIM_KEY", "-", "+", 0, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(ids_match(entries, {"3-0", "4-0", "5-0"}));
+
+  s = db.XTrim("GP1_XTRIM_KEY", 10, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 0);
+
+  s = db.XTrimMinid("GP1_XTRIM_KEY", "5", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 2);
+  ASSERT_TRUE(len_match(&db, "GP1_XTRIM_KEY", 1));
+
+  s = db.XTrimMinid("GP1_XTRIM_KEY", "0-0", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 0);
+
+  // ***************** Group 2 Test *****************
+  // A long trimmed range is deleted by one range tombstone
+  for (uint64_t ms = 1; ms <= 100; ++ms) {
+    s = db.XAdd("GP2_XTRIM_KEY", std::to_string(ms), fvs, &id);
+    ASSERT_TRUE(s.ok());
+  }
+  s = db.XAdd("GP2_XTRIM_KEZ", "1", fvs, &id);
+  ASSERT_TRUE(s.ok());
+  s = db.XTrim("GP2_XTRIM_KEY", 10, &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 90);
+  s = db.XRange("GP2_XTRIM_KEY", "-", "+", 0, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(entries.size(), 10);
+  ASSERT_EQ(entries[0].id, StreamID(91, 0));
+
+  // Trim everything
+  s = db.XTrimMinid("GP2_XTRIM_KEY", "1000", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 10);
+  ASSERT_TRUE(len_match(&db, "GP2_XTRIM_KEY", 0));
+  ASSERT_TRUE(len_match(&db, "GP2_XTRIM_KEZ", 1));
+}
+
+// Keys commands on streams
+TEST_F(StreamsTest, KeysTest) {
+  StreamID id;
+  std::string type, dump;
+  std::vector<StreamEntry> entries;
+  std::vector<FieldValue> fvs {{"f", "v"}};
+  for (const auto& entry_id : {"1-1", "2-2"}) {
+    s = db.XAdd("GP1_KEYS_KEY", entry_id, fvs, &id);
+    ASSERT_TRUE(s.ok());
+  }
+  s = db.Type("GP1_KEYS_KEY", &type);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(type, "stream");
+
+  s = db.Rename("GP1_KEYS_KEY", "GP1_KEYS_NEWKEY");
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(len_match(&db, "GP1_KEYS_KEY", 0));
+  s = db.XRange("GP1_KEYS_NEWKEY", "-", "+", 0, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(ids_match(entries, {"1-1", "2-2"}));
+  s = db.XAdd("GP1_KEYS_NEWKEY", "2-2", fvs, &id);
+  ASSERT_TRUE(s.IsInvalidArgument());
+
+  s = db.Dump("GP1_KEYS_NEWKEY", &dump);
+  ASSERT_TRUE(s.ok());
+  s = db.Restore("GP1_KEYS_RESTORED", dump, 0, false);
+  ASSERT_TRUE(s.ok());
+  s = db.XRange("GP1_KEYS_RESTORED", "-", "+", 0, &entries);
+  ASSERT_TRUE(s.ok());
+  ASSERT_TRUE(ids_match(entries, {"1-1", "2-2"}));
+  ASSERT_EQ(entries[1].fvs, fvs);
+  s = db.XAdd("GP1_KEYS_RESTORED", "*", fvs, &id);
+  ASSERT_TRUE(s.ok());
+
+  std::map<DataType, Status> type_status;
+  int64_t count = db.Del({"GP1_KEYS_NEWKEY"}, &type_status);
+  ASSERT_EQ(count, 1);
+  ASSERT_TRUE(len_match(&db, "GP1_KEYS_NEWKEY", 0));
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -5,6 +5,7 @@
 
 #include <gtest/gtest.h>
 #include <thread>
+#include <limits>
 #include <iostream>
 
 #include "blackwidow/blackwidow.h"
@@ -491,6 +492,84 @@ TEST_F(StringsTest, IncrbyfloatTest) {
   ASSERT_EQ(value, "111.111");
 }
 
+// Counter Encoding
+TEST_F(StringsTest, CounterEncodingTest) {
+  int32_t ret;
+  int64_t number;
+  std::string value;
+  std::vector<blackwidow::ValueStatus> vss;
+  std::map<DataType, Status> type_status;
+  std::map<DataType, int64_t> type_ttl;
+
+  // ***************** Group 1 Test *****************
+  // Counters kept in binary read back as decimal strings
+  s = db.Incrby("GP1_COUNTER_ENCODING_KEY", 10, &number);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(number, 10);
+  s = db.Decrby("GP1_COUNTER_ENCODING_KEY", 25, &number);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(number, -15);
+  s = db.Get("GP1_COUNTER_ENCODING_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "-15");
+  s = db.Strlen("GP1_COUNTER_ENCODING_KEY", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 3);
+  s = db.MGet({"GP1_COUNTER_ENCODING_KEY"}, &vss);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(vss[0].value, "-15");
+
+  // String commands turn the counter back into a plain string
+  s = db.Append("GP1_COUNTER_ENCODING_KEY", "0", &ret);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(ret, 4);
+  s = db.Incrby("GP1_COUNTER_ENCODING_KEY", 1, &number);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(number, -149);
+
+  // ***************** Group 2 Test *****************
+  // Integer counters and float counters mix like decimal strings
+  s = db.Incrby("GP2_COUNTER_ENCODING_KEY", 3, &number);
+  ASSERT_TRUE(s.ok());
+  s = db.Incrbyfloat("GP2_COUNTER_ENCODING_KEY", "1.5", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "4.5");
+  s = db.Incrby("GP2_COUNTER_ENCODING_KEY", 1, &number);
+  ASSERT_TRUE(s.IsCorruption());
+  s = db.Incrbyfloat("GP2_COUNTER_ENCODING_KEY", "0.5", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "5");
+  s = db.Incrby("GP2_COUNTER_ENCODING_KEY", 1, &number);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(number, 6);
+  s = db.Get("GP2_COUNTER_ENCODING_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "6");
+
+  // ***************** Group 3 Test *****************
+  // The expire time survives on binary counters
+  s = db.Incrby("GP3_COUNTER_ENCODING_KEY", 100, &number);
+  ASSERT_TRUE(s.ok());
+  ret = db.Expire("GP3_COUNTER_ENCODING_KEY", 100, &type_status);
+  ASSERT_EQ(ret, 1);
+  s = db.Incrby("GP3_COUNTER_ENCODING_KEY", 1, &number);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(number, 101);
+  type_status.clear();
+  type_ttl = db.TTL("GP3_COUNTER_ENCODING_KEY", &type_status);
+  ASSERT_LE(type_ttl[kStrings], 100);
+  ASSERT_GE(type_ttl[kStrings], 0);
+
+  ret = db.Persist("GP3_COUNTER_ENCODING_KEY", &type_status);
+  ASSERT_EQ(ret, 1);
+  type_status.clear();
+  type_ttl = db.TTL("GP3_COUNTER_ENCODING_KEY", &type_status);
+  ASSERT_EQ(type_ttl[kStrings], -1);
+  s = db.Get("GP3_COUNTER_ENCODING_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "101");
+}
+
 // MGet
 TEST_F(StringsTest, MGetTest) {
   std::vector<blackwidow::ValueStatus> vss;
@@ -964,6 +1043,109 @@ TEST_F(StringsTest, BitPosTest) {
   ASSERT_EQ(ret, -1);
 }
 
+// BitField
+TEST_F(StringsTest, BitFieldTest) {
+  int32_t ret;
+  std::string value;
+  std::vector<BitFieldValue> rets;
+  std::map<DataType, Status> type_status;
+  std::map<DataType, int64_t> type_ttl;
+
+  // ***************** Group 1 Test *****************
+  // The example of redis
+  s = db.BitField("GP1_BITFIELD_KEY",
+      {{kBitFieldIncrby, true, 5, 100, 1, kBitFieldWrap},
+       {kBitFieldGet, false, 4, 0, 0, kBitFieldWrap}}, &rets);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(rets, std::vector<BitFieldValue>({{1, false}, {0, false}}));
+  s = db.Get("GP1_BITFIELD_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value.size(), 14);
+
+  // ***************** Group 2 Test *****************
+  // SET returns the old value, and the fields are big-endian across bytes
+  s = db.BitField("GP2_BITFIELD_KEY",
+      {{kBitFieldSet, false, 8, 0, 255, kBitFieldWrap},
+       {kBitFieldSet, false, 16, 4, 0x1234, kBitFieldWrap},
+       {kBitFieldGet, false, 8, 0, 0, kBitFieldWrap},
+       {kBitFieldGet, true, 8, 0, 0, kBitFieldWrap},
+       {kBitFieldGet, false, 24, 0, 0, kBitFieldWrap}}, &rets);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(rets, std::vector<BitFieldValue>({{0, false}, {0xF000, false},
+      {0xF1, false}, {-15, false}, {0xF12340, false}}));
+  s = db.Get("GP2_BITFIELD_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, std::string("\xF1\x23\x40", 3));
+
+  // The fields agree with GetBit and SetBit
+  s = db.SetBit("GP2_BITFIELD_KEY", 30, 1, &ret);
+  ASSERT_TRUE(s.ok());
+  s = db.BitField("GP2_BITFIELD_KEY",
+      {{kBitFieldGet, false, 63, 0, 0, kBitFieldWrap},
+       {kBitFieldGet, true, 64, 0, 0, kBitFieldWrap}}, &rets);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(rets[0].value, 0x7891A00100000000LL);
+  ASSERT_EQ(rets[1].value, static_cast<int64_t>(0xF123400200000000ULL));
+
+  // ***************** Group 3 Test *****************
+  // Overflow
+  s = db.BitField("GP3_BITFIELD_KEY",
+      {{kBitFieldIncrby, false, 2, 0, 1, kBitFieldWrap},
+       {kBitFieldIncrby, false, 2, 0, 5, kBitFieldWrap},
+       {kBitFieldIncrby, false, 2, 0, 5, kBitFieldSat},
+       {kBitFieldIncrby, false, 2, 0, -5, kBitFieldSat},
+       {kBitFieldIncrby, false, 2, 0, 5, kBitFieldFail},
+       {kBitFieldIncrby, false, 2, 0, 2, kBitFieldFail},
+       {kBitFieldSet, true, 8, 8, 127, kBitFieldFail},
+       {kBitFieldIncrby, true, 8, 8, 1, kBitFieldWrap},
+       {kBitFieldIncrby, true, 8, 8, -1, kBitFieldSat},
+       {kBitFieldSet, true, 8, 8, -1000, kBitFieldSat},
+       {kBitFieldSet, true, 8, 8, -1000, kBitFieldFail},
+       {kBitFieldGet, true, 8, 8, 0, kBitFieldWrap}}, &rets);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(rets, std::vector<BitFieldValue>({{1, false}, {2, false},
+      {3, false}, {0, false}, {0, true}, {2, false}, {0, false},
+      {-128, false}, {-128, false}, {-128, false}, {0, true},
+      {-128, false}}));
+
+  // ***************** Group 4 Test *****************
+  // A failed or read only call writes nothing, and the ttl is kept
+  s = db.BitField("GP4_BITFIELD_KEY",
+      {{kBitFieldGet, false, 8, 0, 0, kBitFieldWrap},
+       {kBitFieldIncrby, false, 8, 0, 300, kBitFieldFail}}, &rets);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(rets, std::vector<BitFieldValue>({{0, false}, {0, true}}));
+  s = db.Get("GP4_BITFIELD_KEY", &value);
+  ASSERT_TRUE(s.IsNotFound());
+
+  s = db.Set("GP4_BITFIELD_KEY", "a");
+  ASSERT_TRUE(s.ok());
+  ret = db.Expire("GP4_BITFIELD_KEY", 100, &type_status);
+  ASSERT_EQ(ret, 1);
+  s = db.BitField("GP4_BITFIELD_KEY",
+      {{kBitFieldIncrby, false, 8, 0, 1, kBitFieldWrap}}, &rets);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(rets, std::vector<BitFieldValue>({{'b', false}}));
+  s = db.Get("GP4_BITFIELD_KEY", &value);
+  ASSERT_EQ(value, "b");
+  type_status.clear();
+  type_ttl = db.TTL("GP4_BITFIELD_KEY", &type_status);
+  ASSERT_LE(type_ttl[kStrings], 100);
+  ASSERT_GE(type_ttl[kStrings], 0);
+
+  // ***************** Group 5 Test *****************
+  // Invalid types and offsets
+  s = db.BitField("GP5_BITFIELD_KEY",
+      {{kBitFieldGet, false, 64, 0, 0, kBitFieldWrap}}, &rets);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.BitField("GP5_BITFIELD_KEY",
+      {{kBitFieldGet, true, 0, 0, 0, kBitFieldWrap}}, &rets);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  s = db.BitField("GP5_BITFIELD_KEY",
+      {{kBitFieldGet, true, 8, -1, 0, kBitFieldWrap}}, &rets);
+  ASSERT_TRUE(s.IsInvalidArgument());
+}
+
 // PKSetexAt
 TEST_F(StringsTest, PKSetexAtTest) {
   int64_t unix_time;
@@ -1033,6 +1215,34 @@ TEST_F(StringsTest, PKSetexAtTest) {
   type_status.clear();
   ttl_ret = db.TTL("GP6_PKSETEX_KEY", &type_status);
   ASSERT_EQ(ttl_ret[DataType::kStrings], -2);
+
+
+  // ***************** Group 7 Test *****************
+  // A 9 byte value with a negative timestamp is as long as a typed
+  // counter, it must stay an expired plain string
+  std::string value;
+  s = db.PKSetexAt("GP7_PKSETEX_KEY", "123456789", -1);
+  ASSERT_TRUE(s.ok());
+  s = db.Get("GP7_PKSETEX_KEY", &value);
+  ASSERT_TRUE(s.IsNotFound());
+
+  type_status.clear();
+  ttl_ret = db.TTL("GP7_PKSETEX_KEY", &type_status);
+  ASSERT_EQ(ttl_ret[DataType::kStrings], -2);
+
+
+  // ***************** Group 8 Test *****************
+  // A ttl beyond the int32 timestamps saturates instead of expiring
+  s = db.Setex("GP8_PKSETEX_KEY", "123456789",
+               std::numeric_limits<int32_t>::max());
+  ASSERT_TRUE(s.ok());
+  s = db.Get("GP8_PKSETEX_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "123456789");
+
+  type_status.clear();
+  ttl_ret = db.TTL("GP8_PKSETEX_KEY", &type_status);
+  ASSERT_GT(ttl_ret[DataType::kStrings], 0);
 }
 
 int main(int argc, char** argv) {
@@ -0,0 +1,160 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <iostream>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+class StringsTTLTest : public ::testing::Test {
+ public:
+  StringsTTLTest() {
+    std::string path = "./db/strings_ttl";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    bw_options.strings_ttl_cf = true;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~StringsTTLTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+// The key moves between the two column families
+TEST_F(StringsTTLTest, MoveTest) {
+  int32_t ret;
+  std::string value;
+  std::map<DataType, Status> type_status;
+
+  s = db.Setex("MOVE_KEY", "VALUE_1", 100);
+  ASSERT_TRUE(s.ok());
+  s = db.Get("MOVE_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE_1");
+
+  ret = db.Persist("MOVE_KEY", &type_status);
+  ASSERT_EQ(ret, 1);
+  std::map<DataType, int64_t> ttl_ret = db.TTL("MOVE_KEY", &type_status);
+  ASSERT_EQ(ttl_ret[kStrings], -1);
+
+  ret = db.Expire("MOVE_KEY", 100, &type_status);
+  ASSERT_EQ(ret, 1);
+  ttl_ret = db.TTL("MOVE_KEY", &type_status);
+  ASSERT_GT(ttl_ret[kStrings], 0);
+  ASSERT_LE(ttl_ret[kStrings], 100);
+
+  s = db.Set("MOVE_KEY", "VALUE_2");
+  ASSERT_TRUE(s.ok());
+  s = db.Get("MOVE_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE_2");
+  ttl_ret = db.TTL("MOVE_KEY", &type_status);
+  ASSERT_EQ(ttl_ret[kStrings], -1);
+
+  ret = db.Del({"MOVE_KEY"}, &type_status);
+  ASSERT_EQ(ret, 1);
+  s = db.Get("MOVE_KEY", &value);
+  ASSERT_TRUE(s.IsNotFound());
+}
+
+// The keys that never had a ttl write no tombstone into ttl_cf
+TEST_F(StringsTTLTest, TombstoneTest) {
+  std::string value;
+  uint64_t deletes = db.GetProperty(STRINGS_DB,
+      "rocksdb.num-deletes-active-mem-table");
+  for (int32_t idx = 0; idx < 100; ++idx) {
+    s = db.Set("TOMBSTONE_KEY_" + std::to_string(idx), "VALUE");
+    ASSERT_TRUE(s.ok());
+  }
+  ASSERT_EQ(db.GetProperty(STRINGS_DB,
+        "rocksdb.num-deletes-active-mem-table"), deletes);
+
+  // A key that moved still leaves nothing behind
+  s = db.Setex("TOMBSTONE_KEY_0", "VALUE_1", 100);
+  ASSERT_TRUE(s.ok());
+  s = db.Set("TOMBSTONE_KEY_0", "VALUE_2");
+  ASSERT_TRUE(s.ok());
+  s = db.Get("TOMBSTONE_KEY_0", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE_2");
+  std::map<DataType, Status> type_status;
+  std::map<DataType, int64_t> ttl_ret = db.TTL("TOMBSTONE_KEY_0",
+                                               &type_status);
+  ASSERT_EQ(ttl_ret[kStrings], -1);
+}
+
+// Scan the keys of both column families in order
+TEST_F(StringsTTLTest, ScanTest) {
+  std::string next_key;
+  std::vector<std::string> keys;
+  std::vector<KeyValue> kvs;
+  s = db.Set("SCAN_KEY_1", "VALUE_1");
+  ASSERT_TRUE(s.ok());
+  s = db.Setex("SCAN_KEY_2", "VALUE_2", 100);
+  ASSERT_TRUE(s.ok());
+  s = db.Set("SCAN_KEY_3", "VALUE_3");
+  ASSERT_TRUE(s.ok());
+  s = db.Setex("SCAN_KEY_4", "VALUE_4", 100);
+  ASSERT_TRUE(s.ok());
+
+  s = db.PKScanRange(DataType::kStrings, "SCAN_KEY_1", "SCAN_KEY_4",
+                     "*", 3, &keys, &kvs, &next_key);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(kvs.size(), 3);
+  ASSERT_EQ(kvs[0].key, "SCAN_KEY_1");
+  ASSERT_EQ(kvs[1].key, "SCAN_KEY_2");
+  ASSERT_EQ(kvs[2].key, "SCAN_KEY_3");
+  ASSERT_EQ(next_key, "SCAN_KEY_4");
+
+  kvs.clear();
+  s = db.PKRScanRange(DataType::kStrings, "SCAN_KEY_4", "SCAN_KEY_1",
+                      "*", 3, &keys, &kvs, &next_key);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(kvs.size(), 3);
+  ASSERT_EQ(kvs[0].key, "SCAN_KEY_4");
+  ASSERT_EQ(kvs[1].key, "SCAN_KEY_3");
+  ASSERT_EQ(kvs[2].key, "SCAN_KEY_2");
+  ASSERT_EQ(next_key, "SCAN_KEY_1");
+
+  keys.clear();
+  s = db.Keys(DataType::kStrings, "SCAN_KEY_*", &keys);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(keys.size(), 4);
+}
+
+// The expired data is invisible before and after its file is dropped
+TEST_F(StringsTTLTest, ExpireTest) {
+  std::string value;
+  s = db.Setex("EXPIRE_KEY", "VALUE", 1);
+  ASSERT_TRUE(s.ok());
+  s = db.Set("PERMANENT_KEY", "VALUE");
+  ASSERT_TRUE(s.ok());
+  std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+
+  s = db.Get("EXPIRE_KEY", &value);
+  ASSERT_TRUE(s.IsNotFound());
+  s = db.Compact(DataType::kStrings, true);
+  ASSERT_TRUE(s.ok());
+  s = db.Get("EXPIRE_KEY", &value);
+  ASSERT_TRUE(s.IsNotFound());
+  s = db.Get("PERMANENT_KEY", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "VALUE");
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,96 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <iostream>
+
+#include "rocksdb/statistics.h"
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+static const uint64_t kTierSize = 1ULL << 40;
+
+class TieredStorageTest : public ::testing::Test {
+ public:
+  TieredStorageTest() {
+    std::string path = "./db/tiered_storage";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    bw_options.options.statistics = rocksdb::CreateDBStatistics();
+    // The meta column families on the fast tier, the hash fields on
+    // the capacity tier
+    bw_options.meta_profile.paths.push_back(
+        rocksdb::DbPath("./db/tiered_storage_fast", kTierSize));
+    bw_options.hashes_data_profile.paths.push_back(
+        rocksdb::DbPath("./db/tiered_storage_capacity", kTierSize));
+    bw_options.secondary_cache_path = "./db/tiered_storage_cache";
+    bw_options.secondary_cache_size = 64 << 20;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~TieredStorageTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+static const StorageTierStats* FindTier(const TieredStorageStats& stats,
+                                        const std::string& path) {
+  for (const auto& tier : stats.tiers) {
+    if (tier.path == path) {
+      return &tier;
+    }
+  }
+  return nullptr;
+}
+
+TEST_F(TieredStorageTest, PlacementTest) {
+  int32_t ret;
+  ASSERT_TRUE(s.ok());
+  for (int32_t idx = 0; idx < 100; ++idx) {
+    s = db.HSet("TIER_HASH_KEY", "field_" + std::to_string(idx),
+                "value", &ret);
+    ASSERT_TRUE(s.ok());
+  }
+  s = db.Set("TIER_STRING_KEY", "value");
+  ASSERT_TRUE(s.ok());
+  db.Compact(DataType::kAll, true);
+
+  TieredStorageStats stats;
+  s = db.GetTieredStorageStats(&stats);
+  ASSERT_TRUE(s.ok());
+  const StorageTierStats* meta_tier =
+    FindTier(stats, "./db/tiered_storage_fast/hashes");
+  ASSERT_TRUE(meta_tier != nullptr);
+  ASSERT_GT(meta_tier->files, 0);
+  ASSERT_GT(meta_tier->bytes, 0);
+  const StorageTierStats* data_tier =
+    FindTier(stats, "./db/tiered_storage_capacity/hashes");
+  ASSERT_TRUE(data_tier != nullptr);
+  ASSERT_GT(data_tier->files, 0);
+  // Without paths the files stay in the db directory
+  ASSERT_TRUE(FindTier(stats, "./db/tiered_storage/strings") != nullptr);
+
+  std::string value;
+  s = db.HGet("TIER_HASH_KEY", "field_0", &value);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(value, "value");
+  s = db.GetTieredStorageStats(&stats);
+  ASSERT_TRUE(s.ok());
+  ASSERT_GT(stats.block_cache_hits + stats.block_cache_misses, 0);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,231 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <cstring>
+#include <iostream>
+
+#include "blackwidow/util.h"
+
+using namespace blackwidow;
+
+// The implementations before the fast paths, used as reference
+static int ReferenceStrToLongDouble(const char* s, size_t slen,
+                                    long double* ldval) {
+  char *pEnd;
+  std::string t(s, slen);
+  if (t.find(" ") != std::string::npos) {
+    return -1;
+  }
+  long double d = strtold(t.c_str(), &pEnd);
+  if (pEnd != t.c_str() + slen)
+    return -1;
+  if (ldval != NULL) *ldval = d;
+  return 0;
+}
+
+static int ReferenceLongDoubleToStr(long double ldval, std::string* value) {
+  char buf[256];
+  int len;
+  if (std::isnan(ldval) || std::isinf(ldval)) {
+    return -1;
+  }
+  len = snprintf(buf, sizeof(buf), "%.17Lf", ldval);
+  if (strchr(buf, '.') != NULL) {
+    char *p = buf+len-1;
+    while (*p == '0') {
+      p--;
+      len--;
+    }
+    if (*p == '.') len--;
+  }
+  value->assign(buf, len);
+  return 0;
+}
+
+// Number of significant digits of the shortest string that reads back to d
+static int ReferenceShortestDigits(double d) {
+  char buf[64];
+  for (int precision = 1; precision < 17; precision++) {
+    snprintf(buf, sizeof(buf), "%.*e", precision - 1, d);
+    if (strtod(buf, NULL) == d) {
+      return precision;
+    }
+  }
+  return 17;
+}
+
+static int SignificantDigits(const char* str) {
+  std::string digits;
+  for (const char* p = str; *p != '\0' && *p != 'e'; p++) {
+    if (*p >= '0' && *p <= '9') {
+      digits.push_back(*p);
+    }
+  }
+  size_t first = digits.find_first_not_of('0');
+  size_t last = digits.find_last_not_of('0');
+  if (first == std::string::npos) {
+    return 1;
+  }
+  return last - first + 1;
+}
+
+static std::string RandomDecimal(std::mt19937_64* rng) {
+  std::string str;
+  if ((*rng)() & 1) {
+    str.push_back('-');
+  }
+  int length = (*rng)() % 25 + 1;
+  int dot = (*rng)() % (length + 1);
+  for (int i = 0; i < length; i++) {
+    if (i == dot) {
+      str.push_back('.');
+    }
+    str.push_back('0' + (*rng)() % 10);
+  }
+  if ((*rng)() % 3 == 0) {
+    str.push_back('e');
+    str.append(std::to_string(static_cast<int>((*rng)() % 81) - 40));
+  }
+  return str;
+}
+
+// StrToLongDouble
+TEST(UtilTest, StrToLongDoubleTest) {
+  std::mt19937_64 rng(2017);
+  for (int i = 0; i < 100000; i++) {
+    std::string str = RandomDecimal(&rng);
+    long double value, reference;
+    int ret = StrToLongDouble(str.data(), str.size(), &value);
+    ASSERT_EQ(ret, ReferenceStrToLongDouble(str.data(), str.size(),
+                                            &reference));
+    if (ret == 0) {
+      ASSERT_TRUE(value == reference);
+    }
+  }
+
+  std::vector<std::string> strs = {"", "0", "-0", "+5", ".5", "5.", ".",
+    "1e", "e5", " 1", "1 ", "1\t", "abc", "inf", "-inf", "0x10",
+    "1e400", "1.5e-400", "1234567890123456789012345",
+    "0.000000000000000000000000001"};
+  for (const auto& str : strs) {
+    long double value, reference;
+    int ret = StrToLongDouble(str.data(), str.size(), &value);
+    ASSERT_EQ(ret, ReferenceStrToLongDouble(str.data(), str.size(),
+                                            &reference));
+    if (ret == 0) {
+      ASSERT_TRUE(value == reference);
+    }
+  }
+
+  // Does not read past slen
+  long double value;
+  ASSERT_EQ(StrToLongDouble("12.5abc", 4, &value), 0);
+  ASSERT_TRUE(value == 12.5L);
+}
+
+// StrToDouble
+TEST(UtilTest, StrToDoubleTest) {
+  std::mt19937_64 rng(2018);
+  for (int i = 0; i < 100000; i++) {
+    std::string str = RandomDecimal(&rng);
+    double value;
+    char* end;
+    double reference = strtod(str.c_str(), &end);
+    int ret = StrToDouble(str.data(), str.size(), &value);
+    ASSERT_EQ(ret, end == str.c_str() + str.size() ? 0 : -1);
+    if (ret == 0) {
+      ASSERT_TRUE(value == reference);
+    }
+  }
+}
+
+// LongDoubleToStr
+TEST(UtilTest, LongDoubleToStrTest) {
+  std::string str, reference;
+  std::mt19937_64 rng(2019);
+  for (int i = 0; i < 100000; i++) {
+    std::string decimal = RandomDecimal(&rng);
+    long double value;
+    if (StrToLongDouble(decimal.data(), decimal.size(), &value) == 0) {
+      ASSERT_EQ(LongDoubleToStr(value, &str),
+                ReferenceLongDoubleToStr(value, &reference));
+      ASSERT_EQ(str, reference);
+    }
+  }
+
+  // Counters
+  for (int64_t i = -10000; i <= 10000; i++) {
+    for (long double fraction : {0.0L, 0.5L, 0.25L, 0.125L, 0.1L}) {
+      long double value = i + fraction;
+      ASSERT_EQ(LongDoubleToStr(value, &str), 0);
+      ReferenceLongDoubleToStr(value, &reference);
+      ASSERT_EQ(str, reference);
+    }
+  }
+
+  std::vector<long double> values = {0.0L, -0.0L, 1e18L, -1e18L,
+    9223372036854775807.0L, 1e30L, 1e-20L, 3.0517578125e-05L};
+  for (const auto& value : values) {
+    ASSERT_EQ(LongDoubleToStr(value, &str), 0);
+    ReferenceLongDoubleToStr(value, &reference);
+    ASSERT_EQ(str, reference);
+  }
+  ASSERT_EQ(LongDoubleToStr(std::numeric_limits<long double>::infinity(),
+                            &str), -1);
+  ASSERT_EQ(LongDoubleToStr(std::numeric_limits<long double>::quiet_NaN(),
+                            &str), -1);
+}
+
+// DoubleToStr
+TEST(UtilTest, DoubleToStrTest) {
+  char buf[32];
+  std::mt19937_64 rng(2020);
+  for (int i = 0; i < 100000; i++) {
+    uint64_t bits = rng();
+    double value;
+    memcpy(&value, &bits, sizeof(double));
+    if (!std::isfinite(value)) {
+      continue;
+    }
+    int len = DoubleToStr(buf, sizeof(buf), value);
+    ASSERT_GT(len, 0);
+    ASSERT_EQ(static_cast<size_t>(len), strlen(buf));
+    // Round trip with the shortest number of digits
+    ASSERT_TRUE(strtod(buf, NULL) == value);
+    ASSERT_EQ(SignificantDigits(buf), ReferenceShortestDigits(value));
+  }
+
+  DoubleToStr(buf, sizeof(buf), 0.1);
+  ASSERT_STREQ(buf, "0.1");
+  DoubleToStr(buf, sizeof(buf), 0.1 + 0.2);
+  ASSERT_STREQ(buf, "0.30000000000000004");
+  DoubleToStr(buf, sizeof(buf), -3.5);
+  ASSERT_STREQ(buf, "-3.5");
+  DoubleToStr(buf, sizeof(buf), 100);
+  ASSERT_STREQ(buf, "100");
+  DoubleToStr(buf, sizeof(buf), 1e21);
+  ASSERT_STREQ(buf, "1e+21");
+  DoubleToStr(buf, sizeof(buf), 1e-7);
+  ASSERT_STREQ(buf, "1e-7");
+  DoubleToStr(buf, sizeof(buf), 5e-324);
+  ASSERT_STREQ(buf, "5e-324");
+  DoubleToStr(buf, sizeof(buf), 0.0);
+  ASSERT_STREQ(buf, "0");
+  DoubleToStr(buf, sizeof(buf), std::numeric_limits<double>::infinity());
+  ASSERT_STREQ(buf, "inf");
+  DoubleToStr(buf, sizeof(buf), -std::numeric_limits<double>::infinity());
+  ASSERT_STREQ(buf, "-inf");
+
+  // Buffer too small
+  ASSERT_EQ(DoubleToStr(buf, 3, 123.456), 0);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,76 @@
+//  Copyright (c) 2017-present The blackwidow Authors.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <iostream>
+
+#include "blackwidow/blackwidow.h"
+
+using namespace blackwidow;
+
+class WritePressureTest : public ::testing::Test {
+ public:
+  WritePressureTest() {
+    std::string path = "./db/write_pressure";
+    if (access(path.c_str(), F_OK)) {
+      mkdir(path.c_str(), 0755);
+    }
+    bw_options.options.create_if_missing = true;
+    // Every big value is flushed into its own L0 file, which stays there
+    bw_options.options.write_buffer_size = 64 << 10;
+    bw_options.options.disable_auto_compactions = true;
+    bw_options.options.level0_slowdown_writes_trigger = 4;
+    bw_options.options.level0_stop_writes_trigger = 100;
+    s = db.Open(bw_options, path);
+  }
+  virtual ~WritePressureTest() { }
+
+  static void SetUpTestCase() { }
+  static void TearDownTestCase() { }
+
+  BlackwidowOptions bw_options;
+  blackwidow::BlackWidow db;
+  blackwidow::Status s;
+};
+
+TEST_F(WritePressureTest, PressureTest) {
+  ASSERT_TRUE(s.ok());
+  WritePressureStats stats;
+  s = db.GetWritePressure(DataType::kStrings, &stats);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(stats.pressure, kWritePressureNormal);
+  ASSERT_EQ(stats.l0_files, 0);
+
+  std::string value(128 << 10, 'a');
+  for (int32_t idx = 0; idx < 8; ++idx) {
+    s = db.Set("PRESSURE_KEY_" + std::to_string(idx), value);
+    ASSERT_TRUE(s.ok());
+  }
+  for (int32_t idx = 0; idx < 50; ++idx) {
+    s = db.GetWritePressure(DataType::kStrings, &stats);
+    ASSERT_TRUE(s.ok());
+    if (stats.l0_files >= 4) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  ASSERT_GE(stats.l0_files, 4);
+  ASSERT_GE(stats.slowdown_ratio, 1);
+  ASSERT_GE(stats.pressure, kWritePressureHigh);
+
+  // The highest pressure of all the type dbs
+  s = db.GetWritePressure(DataType::kAll, &stats);
+  ASSERT_TRUE(s.ok());
+  ASSERT_GE(stats.pressure, kWritePressureHigh);
+  s = db.GetWritePressure(DataType::kHashes, &stats);
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ(stats.pressure, kWritePressureNormal);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}